@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2002-2016 BalaBit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "ack_tracker.h"
+#include "logpipe.h"
+
+/*
+ * Batched acknowledgement processing.
+ *
+ * When a LogWriter finishes a flush it acks the entire consumed backlog in
+ * one go, message by message.  Each of those acks used to end up in the
+ * tracker's manage_msg_ack() individually: one flow-control window
+ * adjustment per message for the early tracker, one mutex acquisition and
+ * continuous-range scan per message for the late tracker.
+ *
+ * The functions below let the caller bracket such a loop with
+ * ack_tracker_batch_begin()/_end().  While a batch is open on the current
+ * thread, trackers call ack_tracker_batch_collect() from their
+ * manage_msg_ack() to defer the per-tracker work; at _end() each tracker
+ * seen during the batch gets a single batch_flush() callback with the
+ * number of messages collected, so the window is replenished and the
+ * bookmark advanced once per batch instead of once per message.
+ *
+ * Batches are strictly per-thread and must not be nested.  A batch
+ * typically covers messages of a single source; a few distinct trackers
+ * are accommodated and any tracker above that simply falls back to the
+ * unbatched path.
+ */
+
+#define ACK_BATCH_MAX_TRACKERS 4
+
+typedef struct _AckBatch
+{
+  gboolean active;
+  gint num_trackers;
+  AckTracker *trackers[ACK_BATCH_MAX_TRACKERS];
+  gint counts[ACK_BATCH_MAX_TRACKERS];
+  AckType ack_types[ACK_BATCH_MAX_TRACKERS];
+} AckBatch;
+
+static GStaticPrivate ack_batch_key = G_STATIC_PRIVATE_INIT;
+
+void
+ack_tracker_batch_begin(void)
+{
+  AckBatch *batch = g_static_private_get(&ack_batch_key);
+
+  if (!batch)
+    {
+      batch = g_new0(AckBatch, 1);
+      g_static_private_set(&ack_batch_key, batch, g_free);
+    }
+
+  g_assert(!batch->active);
+  batch->active = TRUE;
+  batch->num_trackers = 0;
+}
+
+/*
+ * Called by tracker implementations from manage_msg_ack().  Returns TRUE
+ * if a batch is open on this thread and the ack was recorded for deferred
+ * processing, in which case the tracker must skip its per-message work.
+ */
+gboolean
+ack_tracker_batch_collect(AckTracker *self, AckType ack_type)
+{
+  AckBatch *batch = g_static_private_get(&ack_batch_key);
+  gint i;
+
+  if (!batch || !batch->active)
+    return FALSE;
+
+  for (i = 0; i < batch->num_trackers; i++)
+    {
+      if (batch->trackers[i] == self)
+        {
+          batch->counts[i]++;
+          if (ack_type != AT_PROCESSED)
+            batch->ack_types[i] = ack_type;
+          return TRUE;
+        }
+    }
+
+  if (batch->num_trackers == ACK_BATCH_MAX_TRACKERS)
+    return FALSE;
+
+  /* NOTE: the per-message references on the source may all be dropped by
+   * the time the batch is flushed, so the batch holds one of its own;
+   * manage_msg_ack() is still holding the current message's reference at
+   * this point, making the ref below safe */
+  log_pipe_ref((LogPipe *) self->source);
+
+  batch->trackers[batch->num_trackers] = self;
+  batch->counts[batch->num_trackers] = 1;
+  batch->ack_types[batch->num_trackers] = ack_type;
+  batch->num_trackers++;
+  return TRUE;
+}
+
+void
+ack_tracker_batch_end(void)
+{
+  AckBatch *batch = g_static_private_get(&ack_batch_key);
+  gint i;
+
+  g_assert(batch && batch->active);
+
+  /* close the batch first so the flush callbacks go through the normal,
+   * unbatched code paths */
+  batch->active = FALSE;
+
+  for (i = 0; i < batch->num_trackers; i++)
+    {
+      AckTracker *tracker = batch->trackers[i];
+
+      tracker->batch_flush(tracker, batch->counts[i], batch->ack_types[i]);
+      log_pipe_unref((LogPipe *) tracker->source);
+    }
+  batch->num_trackers = 0;
+}
@@ -35,6 +35,9 @@ struct _AckTracker
   Bookmark* (*request_bookmark)(AckTracker *self);
   void (*track_msg)(AckTracker *self, LogMessage *msg);
   void (*manage_msg_ack)(AckTracker *self, LogMessage *msg, AckType ack_type);
+  /* process @count acks collected while a batch was open on this thread,
+   * see ack_tracker_batch_begin() */
+  void (*batch_flush)(AckTracker *self, gint count, AckType ack_type);
 };
 
 struct _AckRecord
@@ -48,6 +51,10 @@ AckTracker* early_ack_tracker_new(LogSource *source);
 void late_ack_tracker_free(AckTracker *self);
 void early_ack_tracker_free(AckTracker *self);
 
+void ack_tracker_batch_begin(void);
+void ack_tracker_batch_end(void);
+gboolean ack_tracker_batch_collect(AckTracker *self, AckType ack_type);
+
 static inline void
 ack_tracker_free(AckTracker *self)
 {
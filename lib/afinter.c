@@ -28,13 +28,24 @@
 #include "messages.h"
 #include "apphook.h"
 #include "mainloop.h"
+#include "syslog-names.h"
 
 typedef struct _AFInterSource AFInterSource;
 
+/* bound on the number of internal messages waiting for the internal()
+ * source; a stalled or missing consumer must not let diagnostic traffic
+ * accumulate without limit, messages over the bound are shed and
+ * accounted in the per-severity tally below */
+#define INTERNAL_MSG_QUEUE_DEPTH 10000
+
 static GStaticMutex internal_msg_lock = G_STATIC_MUTEX_INIT;
 static GQueue *internal_msg_queue;
 static AFInterSource *current_internal_source;
 static StatsCounterItem *internal_queue_length;
+static StatsCounterItem *internal_queue_dropped;
+/* number of messages shed per severity since the last report, protected
+ * by internal_msg_lock */
+static guint32 internal_queue_dropped_severity[8];
 
 /* the expiration timer of the next MARK message */
 static struct timespec next_mark_target = { -1, 0 };
@@ -99,6 +110,39 @@ struct _AFInterSource
 
 static void afinter_source_update_watches(AFInterSource *self);
 
+/*
+ * Report the messages shed by afinter_message_posted() while the queue
+ * was saturated.  Runs in the main thread after the queue has been
+ * drained, so the report itself has room and cannot be shed in turn.
+ */
+static void
+afinter_report_dropped_messages(void)
+{
+  guint32 dropped[8];
+  guint32 total = 0;
+  gint i;
+
+  g_static_mutex_lock(&internal_msg_lock);
+  for (i = 0; i < 8; i++)
+    {
+      dropped[i] = internal_queue_dropped_severity[i];
+      internal_queue_dropped_severity[i] = 0;
+      total += dropped[i];
+    }
+  g_static_mutex_unlock(&internal_msg_lock);
+
+  if (!total)
+    return;
+  for (i = 0; i < 8; i++)
+    {
+      if (dropped[i])
+        msg_warning("Internal messages were dropped, the internal() source could not keep up",
+                    evt_tag_str("severity", syslog_name_lookup_name_by_value(i, sl_levels)),
+                    evt_tag_int("dropped", dropped[i]),
+                    NULL);
+    }
+}
+
 static void
 afinter_source_post(gpointer s)
 {
@@ -116,6 +160,7 @@ afinter_source_post(gpointer s)
       stats_counter_dec(internal_queue_length);
       log_source_post(&self->super, msg);
     }
+  afinter_report_dropped_messages();
   afinter_source_update_watches(self);
 }
 
@@ -290,6 +335,11 @@ afinter_source_init(LogPipe *s)
   current_internal_source = self;
   g_static_mutex_unlock(&internal_msg_lock);
 
+  /* publish the severities any log path acting on internal() accepts, so
+   * the diagnostic macros can skip unconsumed messages before formatting
+   * them; fatal->warning stay enabled, they can reach stderr without us */
+  msg_set_enabled_severities(self->super.options->accepted_severities | 0x1f);
+
   return TRUE;
 }
 
@@ -297,7 +347,9 @@ static gboolean
 afinter_source_deinit(LogPipe *s)
 {
   AFInterSource *self = (AFInterSource *) s;
-  
+
+  msg_set_enabled_severities(0xffffffff);
+
   g_static_mutex_lock(&internal_msg_lock);
   current_internal_source = NULL;
   g_static_mutex_unlock(&internal_msg_lock);
@@ -429,9 +481,19 @@ afinter_message_posted(LogMessage *msg)
 
       stats_lock();
       stats_register_counter(0, SCS_GLOBAL, "internal_queue_length", NULL, SC_TYPE_PROCESSED, &internal_queue_length);
+      stats_register_counter(0, SCS_GLOBAL, "internal_queue_dropped", NULL, SC_TYPE_DROPPED, &internal_queue_dropped);
       stats_unlock();
     }
 
+  if (g_queue_get_length(internal_msg_queue) >= INTERNAL_MSG_QUEUE_DEPTH)
+    {
+      internal_queue_dropped_severity[msg->pri & LOG_PRIMASK]++;
+      stats_counter_inc(internal_queue_dropped);
+      g_static_mutex_unlock(&internal_msg_lock);
+      log_msg_unref(msg);
+      return;
+    }
+
   g_queue_push_tail(internal_msg_queue, msg);
   stats_counter_inc(internal_queue_length);
 
@@ -30,6 +30,7 @@
 #include "stats/stats-registry.h"
 #include "tags.h"
 #include "logmsg.h"
+#include "logmatcher.h"
 #include "timeutils.h"
 #include "logsource.h"
 #include "logwriter.h"
@@ -40,6 +41,8 @@
 #include "mainloop-call.h"
 #include "service-management.h"
 #include "crypto.h"
+#include "syslog-names.h"
+#include "cfg-include-cache.h"
 
 #include <iv.h>
 #include <iv_work.h>
@@ -131,6 +134,7 @@ app_startup(void)
   tzset();
   log_msg_global_init();
   log_tags_global_init();
+  syslog_names_global_init();
   log_source_global_init();
   log_template_global_init();
   service_management_init();
@@ -161,6 +165,7 @@ app_shutdown(void)
   run_application_hook(AH_SHUTDOWN);
   log_template_global_deinit();
   log_tags_global_deinit();
+  log_msg_thread_deinit();
   log_msg_global_deinit();
 
   stats_destroy();
@@ -169,6 +174,7 @@ app_shutdown(void)
   g_list_free(application_hooks);
   dns_cache_thread_deinit();
   dns_cache_global_deinit();
+  cfg_include_cache_clear();
   hostname_global_deinit();
   crypto_deinit();
   msg_deinit();
@@ -201,4 +207,6 @@ app_thread_stop(void)
   dns_cache_thread_deinit();
   scratch_buffers_free();
   main_loop_call_thread_deinit();
+  log_msg_thread_deinit();
+  log_matcher_thread_deinit();
 }
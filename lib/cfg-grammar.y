@@ -181,6 +181,8 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_STATS_FREQ                  10072
 %token KW_STATS_LEVEL                 10073
 %token KW_STATS_LIFETIME	      10074
+%token KW_STATS_MAX_DYNAMICS          10175
+%token KW_STATS_PERSIST_FREQ          10176
 %token KW_FLUSH_LINES                 10075
 %token KW_SUPPRESS                    10076
 %token KW_FLUSH_TIMEOUT               10077
@@ -190,6 +192,9 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_MARK_MODE                   10081
 %token KW_ENCODING                    10082
 %token KW_TYPE                        10083
+%token KW_FORMAT_THREADS              10084
+%token KW_SPIN_TIMEOUT                10085
+%token KW_POS_SYNC_FREQ               10086
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -211,6 +216,8 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_DNS_CACHE_HOSTS             10132
 
 %token KW_PERSIST_ONLY                10140
+%token KW_ASYNC                       10176
+%token KW_FLUSH_TARGET_LATENCY        10177
 %token KW_USE_RCPTID                  10141
 %token KW_USE_UNIQID                  10142
 
@@ -227,7 +234,16 @@ extern struct _StatsOptions *last_stats_options;
 
 %token KW_THROTTLE                    10170
 %token KW_THREADED                    10171
+%token KW_DEST_WORKER_POOL_SIZE       10172
+%token KW_LATENCY_SAMPLE_FREQ         10173
+%token KW_DYNAMIC_WINDOW_SIZE         10174
 %token KW_PASS_UNIX_CREDENTIALS       10231
+%token KW_SUPPRESS_DUPLICATES         10232
+%token KW_SHED_BELOW_SEVERITY         10233
+%token KW_MULTI_LINE_TIMEOUT          10234
+%token KW_PARSE_ERRORS_MAX            10235
+%token KW_SKIP_UNCHANGED_RELOADS      10236
+%token KW_LOG_DISK_FIFO_SIZE          10237
 
 /* log statement options */
 %token KW_FLAGS                       10190
@@ -326,6 +342,8 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_ON_ERROR                    10510
 
 %token KW_RETRIES                     10511
+%token KW_PIPELINE                    10512
+%token KW_PRIORITY_TAG                10513
 
 /* END_DECLS */
 
@@ -899,7 +917,10 @@ options_item
 	| KW_TIME_SLEEP '(' LL_NUMBER ')'	{}
 	| KW_SUPPRESS '(' LL_NUMBER ')'		{ configuration->suppress = $3; }
 	| KW_THREADED '(' yesno ')'		{ configuration->threaded = $3; }
+	| KW_DEST_WORKER_POOL_SIZE '(' LL_NUMBER ')' { configuration->dest_worker_pool_size = $3; }
+	| KW_LATENCY_SAMPLE_FREQ '(' LL_NUMBER ')' { configuration->latency_sample_freq = $3; }
 	| KW_PASS_UNIX_CREDENTIALS '(' yesno ')' { configuration->pass_unix_credentials = $3; }
+	| KW_SKIP_UNCHANGED_RELOADS '(' yesno ')' { configuration->skip_unchanged_reloads = $3; }
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_LOG_FIFO_SIZE '(' LL_NUMBER ')'	{ configuration->log_fifo_size = $3; }
@@ -938,6 +959,8 @@ stat_option
 	: KW_STATS_FREQ '(' LL_NUMBER ')'          { last_stats_options->log_freq = $3; }
 	| KW_STATS_LEVEL '(' LL_NUMBER ')'         { last_stats_options->level = $3; }
 	| KW_STATS_LIFETIME '(' LL_NUMBER ')'      { last_stats_options->lifetime = $3; }
+	| KW_STATS_MAX_DYNAMICS '(' LL_NUMBER ')'  { last_stats_options->max_dynamics = $3; }
+	| KW_STATS_PERSIST_FREQ '(' LL_NUMBER ')'  { last_stats_options->persist_freq = $3; }
 	;
 
 /* START_RULES */
@@ -957,6 +980,7 @@ yesno
 dnsmode
 	: yesno					{ $$ = $1; }
 	| KW_PERSIST_ONLY                       { $$ = 2; }
+	| KW_ASYNC                              { $$ = 3; }
 	;
 
 string_or_number
@@ -1018,6 +1042,13 @@ parser_opt
 source_option
         /* NOTE: plugins need to set "last_source_options" in order to incorporate this rule in their grammar */
 	: KW_LOG_IW_SIZE '(' LL_NUMBER ')'	{ last_source_options->init_window_size = $3; }
+	| KW_DYNAMIC_WINDOW_SIZE '(' LL_NUMBER ')' { last_source_options->dynamic_window_size = $3; }
+	| KW_SUPPRESS_DUPLICATES '(' yesno ')'	{ last_source_options->suppress_duplicates = $3; }
+	| KW_SHED_BELOW_SEVERITY '(' string ')'
+	  {
+	    CHECK_ERROR(log_source_options_set_shed_below_severity(last_source_options, $3), @3, "Unknown severity level \"%s\"", $3);
+	    free($3);
+	  }
 	| KW_CHAIN_HOSTNAMES '(' yesno ')'	{ last_source_options->chain_hostnames = $3; }
 	| KW_KEEP_HOSTNAME '(' yesno ')'	{ last_source_options->keep_hostname = $3; }
 	| KW_PROGRAM_OVERRIDE '(' string ')'	{ last_source_options->program_override = g_strdup($3); free($3); }
@@ -1037,6 +1068,8 @@ source_proto_option
             free($3);
           }
 	| KW_LOG_MSG_SIZE '(' LL_NUMBER ')'	{ last_proto_server_options->max_msg_size = $3; }
+	| KW_POS_SYNC_FREQ '(' LL_NUMBER ')'	{ last_proto_server_options->pos_sync_freq = $3; }
+	| KW_MULTI_LINE_TIMEOUT '(' LL_NUMBER ')'	{ last_proto_server_options->multi_line_timeout = $3; }
         ;
 
 source_reader_options
@@ -1074,6 +1107,7 @@ source_reader_option
 	: KW_CHECK_HOSTNAME '(' yesno ')'	{ last_reader_options->check_hostname = $3; }
 	| KW_FLAGS '(' source_reader_option_flags ')'
 	| KW_LOG_FETCH_LIMIT '(' LL_NUMBER ')'	{ last_reader_options->fetch_limit = $3; }
+	| KW_PARSE_ERRORS_MAX '(' LL_NUMBER ')'	{ last_reader_options->parse_errors_max = $3; }
         | KW_FORMAT '(' string ')'              { last_reader_options->parse_options.format = g_strdup($3); free($3); }
         | { last_source_options = &last_reader_options->super; } source_option
         | { last_proto_server_options = &last_reader_options->proto_options.super; } source_proto_option
@@ -1091,12 +1125,25 @@ threaded_dest_driver_option
         {
           log_threaded_dest_driver_set_max_retries(last_driver, $3);
         }
+	| KW_PIPELINE '(' LL_NUMBER ')'
+        {
+          log_threaded_dest_driver_set_pipeline_depth(last_driver, $3);
+        }
 
 dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' LL_NUMBER ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_DISK_FIFO_SIZE '(' LL_NUMBER ')' { ((LogDestDriver *) last_driver)->log_disk_fifo_size = $3; }
 	| KW_THROTTLE '(' LL_NUMBER ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
+	| KW_PRIORITY_TAG '(' string ')'
+	  {
+	    LogDestDriver *driver = (LogDestDriver *) last_driver;
+
+	    g_free(driver->prio_tag);
+	    driver->prio_tag = g_strdup($3);
+	    free($3);
+	  }
         | LL_IDENTIFIER
           {
             Plugin *p;
@@ -1128,6 +1175,9 @@ dest_writer_option
 	: KW_FLAGS '(' dest_writer_options_flags ')' { last_writer_options->options = $3; }
 	| KW_FLUSH_LINES '(' LL_NUMBER ')'		{ last_writer_options->flush_lines = $3; }
 	| KW_FLUSH_TIMEOUT '(' LL_NUMBER ')'	{ last_writer_options->flush_timeout = $3; }
+	| KW_FORMAT_THREADS '(' LL_NUMBER ')'	{ last_writer_options->format_threads = $3; }
+	| KW_SPIN_TIMEOUT '(' LL_NUMBER ')'	{ last_writer_options->spin_timeout = $3; }
+	| KW_FLUSH_TARGET_LATENCY '(' LL_NUMBER ')'	{ last_writer_options->flush_target_latency = $3; }
         | KW_SUPPRESS '(' LL_NUMBER ')'            { last_writer_options->suppress = $3; }
 	| KW_TEMPLATE '(' string ')'       	{
                                                   GError *error = NULL;
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "cfg-include-cache.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* refuse to cache unreasonably large include files, the lexer falls back
+ * to reading those through stdio */
+#define CFG_INCLUDE_CACHE_MAX_FILE_SIZE (4 * 1024 * 1024)
+
+typedef struct _CfgIncludeCacheEntry
+{
+  gchar *content;
+  gsize content_length;
+  time_t mtime;
+  off_t size;
+} CfgIncludeCacheEntry;
+
+static GHashTable *cfg_include_cache;
+
+static void
+cfg_include_cache_entry_free(gpointer s)
+{
+  CfgIncludeCacheEntry *entry = (CfgIncludeCacheEntry *) s;
+
+  g_free(entry->content);
+  g_free(entry);
+}
+
+static gboolean
+cfg_include_cache_entry_is_fresh(CfgIncludeCacheEntry *entry, const struct stat *st)
+{
+  return entry->mtime == st->st_mtime && entry->size == st->st_size;
+}
+
+/*
+ * Look up the contents of an include file, (re)reading it from disk if
+ * this is the first time we see this path or the file changed since it
+ * was cached.  Returns NULL if the file cannot be read or is too large to
+ * be cached.  The returned pointer is owned by the cache and remains
+ * valid until the next lookup of the same path, the caller must not
+ * modify or free it.  Note that flex modifies the buffer it scans, so the
+ * lexer always works from a private copy.
+ */
+const gchar *
+cfg_include_cache_lookup(const gchar *filename, gsize *content_length)
+{
+  CfgIncludeCacheEntry *entry;
+  struct stat st;
+  gchar *content;
+  gsize length;
+
+  if (stat(filename, &st) < 0)
+    return NULL;
+  if (st.st_size > CFG_INCLUDE_CACHE_MAX_FILE_SIZE)
+    return NULL;
+
+  if (!cfg_include_cache)
+    cfg_include_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, cfg_include_cache_entry_free);
+
+  entry = g_hash_table_lookup(cfg_include_cache, filename);
+  if (entry && cfg_include_cache_entry_is_fresh(entry, &st))
+    {
+      *content_length = entry->content_length;
+      return entry->content;
+    }
+
+  if (!g_file_get_contents(filename, &content, &length, NULL))
+    {
+      if (entry)
+        g_hash_table_remove(cfg_include_cache, filename);
+      return NULL;
+    }
+
+  if (!entry)
+    {
+      entry = g_new0(CfgIncludeCacheEntry, 1);
+      g_hash_table_insert(cfg_include_cache, g_strdup(filename), entry);
+    }
+  else
+    {
+      g_free(entry->content);
+    }
+  entry->content = content;
+  entry->content_length = length;
+  entry->mtime = st.st_mtime;
+  entry->size = st.st_size;
+
+  *content_length = entry->content_length;
+  return entry->content;
+}
+
+void
+cfg_include_cache_clear(void)
+{
+  if (cfg_include_cache)
+    {
+      g_hash_table_destroy(cfg_include_cache);
+      cfg_include_cache = NULL;
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CFG_INCLUDE_CACHE_H_INCLUDED
+#define CFG_INCLUDE_CACHE_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/* Process-wide cache of include file contents used by the config lexer.
+ * Entries are validated against the mtime & size of the file on every
+ * lookup, so a reload only hits the disk for includes that have actually
+ * changed since the previous parse.  The cache is only used by the main
+ * thread while a configuration is being parsed, thus it needs no locking.
+ */
+
+const gchar *cfg_include_cache_lookup(const gchar *filename, gsize *content_length);
+void cfg_include_cache_clear(void);
+
+#endif
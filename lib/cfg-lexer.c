@@ -24,6 +24,7 @@
 
 #include "cfg-lexer.h"
 #include "cfg-lexer-subst.h"
+#include "cfg-include-cache.h"
 #include "cfg-lex.h"
 #include "cfg-grammar.h"
 #include "block-ref-parser.h"
@@ -251,7 +252,11 @@ cfg_lexer_start_next_include(CfgLexer *self)
       if (level->file.include_file)
         {
           fclose(level->file.include_file);
+          level->file.include_file = NULL;
         }
+      g_free(level->file.content);
+      level->file.content = NULL;
+      level->file.content_length = 0;
     }
 
   if ((level->include_type == CFGI_BUFFER && buffer_processed) ||
@@ -279,20 +284,39 @@ cfg_lexer_start_next_include(CfgLexer *self)
     }
   else if (level->include_type == CFGI_FILE)
     {
-      FILE *include_file;
+      const gchar *cached_content;
+      gsize cached_length;
 
       filename = (gchar *) level->file.files->data;
       level->file.files = g_slist_delete_link(level->file.files, level->file.files);
 
-      include_file = fopen(filename, "r");
-      if (!include_file)
+      cached_content = cfg_include_cache_lookup(filename, &cached_length);
+      if (cached_content)
         {
-          msg_error("Error opening include file",
-                    evt_tag_str("filename", filename),
-                    evt_tag_int("depth", self->include_depth),
-                    NULL);
-          g_free(filename);
-          return FALSE;
+          /* flex requires two NUL characters at the end of the input and
+           * modifies the buffer while scanning, so work from a private
+           * copy of the cached contents */
+          level->file.content_length = cached_length + 2;
+          level->file.content = g_malloc(level->file.content_length);
+          memcpy(level->file.content, cached_content, cached_length);
+          level->file.content[cached_length] = 0;
+          level->file.content[cached_length + 1] = 0;
+        }
+      else
+        {
+          FILE *include_file;
+
+          include_file = fopen(filename, "r");
+          if (!include_file)
+            {
+              msg_error("Error opening include file",
+                        evt_tag_str("filename", filename),
+                        evt_tag_int("depth", self->include_depth),
+                        NULL);
+              g_free(filename);
+              return FALSE;
+            }
+          level->file.include_file = include_file;
         }
       msg_debug("Starting to read include file",
                 evt_tag_str("filename", filename),
@@ -301,8 +325,10 @@ cfg_lexer_start_next_include(CfgLexer *self)
       g_free(level->name);
       level->name = filename;
 
-      level->file.include_file = include_file;
-      level->yybuf = _cfg_lexer__create_buffer(level->file.include_file, YY_BUF_SIZE, self->state);
+      if (level->file.content)
+        level->yybuf = _cfg_lexer__scan_buffer(level->file.content, level->file.content_length, self->state);
+      else
+        level->yybuf = _cfg_lexer__create_buffer(level->file.include_file, YY_BUF_SIZE, self->state);
     }
   else
     {
@@ -1001,6 +1027,7 @@ cfg_lexer_free(CfgLexer *self)
         {
           if (level->file.include_file)
             fclose(level->file.include_file);
+          g_free(level->file.content);
           g_slist_foreach(level->file.files, (GFunc) g_free, NULL);
           g_slist_free(level->file.files);
         }
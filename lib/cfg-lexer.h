@@ -110,6 +110,10 @@ struct _CfgIncludeLevel
     {
       GSList *files;
       FILE *include_file;
+      /* private copy of the cached file contents handed to the flex
+       * scanner, NULL when the file is read through stdio */
+      gchar *content;
+      gsize content_length;
     } file;
     struct
     {
@@ -83,10 +83,15 @@ static CfgLexerKeyword main_keywords[] = {
   { "mark_mode",          KW_MARK_MODE },
   { "stats_freq",         KW_STATS_FREQ },
   { "stats_lifetime",     KW_STATS_LIFETIME },
+  { "stats_max_dynamics", KW_STATS_MAX_DYNAMICS },
+  { "stats_persist_freq", KW_STATS_PERSIST_FREQ },
   { "stats_level",        KW_STATS_LEVEL },
   { "stats",              KW_STATS_FREQ, KWS_OBSOLETE, "stats_freq" },
   { "flush_lines",        KW_FLUSH_LINES },
   { "flush_timeout",      KW_FLUSH_TIMEOUT },
+  { "format_threads",     KW_FORMAT_THREADS },
+  { "spin_timeout",       KW_SPIN_TIMEOUT },
+  { "flush_target_latency", KW_FLUSH_TARGET_LATENCY },
   { "suppress",           KW_SUPPRESS },
   { "sync_freq",          KW_FLUSH_LINES, KWS_OBSOLETE, "flush_lines" },
   { "sync",               KW_FLUSH_LINES, KWS_OBSOLETE, "flush_lines" },
@@ -118,17 +123,27 @@ static CfgLexerKeyword main_keywords[] = {
   { "default_priority",   KW_DEFAULT_LEVEL },
   { "default_facility",   KW_DEFAULT_FACILITY },
   { "threaded",           KW_THREADED },
+  { "dest_worker_pool_size", KW_DEST_WORKER_POOL_SIZE },
+  { "latency_sample_freq", KW_LATENCY_SAMPLE_FREQ },
   { "use_rcptid",         KW_USE_RCPTID, KWS_OBSOLETE, "This has been deprecated since " VERSION_3_7  ", try use_uniqid() instead" },
   { "use_uniqid",         KW_USE_UNIQID },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "log_disk_fifo_size", KW_LOG_DISK_FIFO_SIZE },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
   { "log_iw_size",        KW_LOG_IW_SIZE },
+  { "dynamic_window_size", KW_DYNAMIC_WINDOW_SIZE },
+  { "suppress_duplicates", KW_SUPPRESS_DUPLICATES },
+  { "shed_below_severity", KW_SHED_BELOW_SEVERITY },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
+  { "pos_sync_freq",      KW_POS_SYNC_FREQ },
+  { "multi_line_timeout", KW_MULTI_LINE_TIMEOUT },
+  { "parse_errors_max",   KW_PARSE_ERRORS_MAX },
   { "log_prefix",         KW_LOG_PREFIX, KWS_OBSOLETE, "program_override" },
   { "program_override",   KW_PROGRAM_OVERRIDE },
   { "host_override",      KW_HOST_OVERRIDE },
   { "throttle",           KW_THROTTLE },
+  { "priority_tag",       KW_PRIORITY_TAG },
 
   { "create_dirs",        KW_CREATE_DIRS },
   { "optional",           KW_OPTIONAL },
@@ -144,14 +159,17 @@ static CfgLexerKeyword main_keywords[] = {
   { "template_function",  KW_TEMPLATE_FUNCTION },
   { "on_error",           KW_ON_ERROR },
   { "persist_only",       KW_PERSIST_ONLY },
+  { "async",              KW_ASYNC },
   { "dns_cache_hosts",    KW_DNS_CACHE_HOSTS },
   { "dns_cache",          KW_DNS_CACHE },
   { "dns_cache_size",     KW_DNS_CACHE_SIZE },
   { "dns_cache_expire",   KW_DNS_CACHE_EXPIRE },
   { "dns_cache_expire_failed", KW_DNS_CACHE_EXPIRE_FAILED },
   { "pass_unix_credentials", KW_PASS_UNIX_CREDENTIALS },
+  { "skip_unchanged_reloads", KW_SKIP_UNCHANGED_RELOADS },
 
   { "retries",            KW_RETRIES },
+  { "pipeline",           KW_PIPELINE },
 
   /* filter items */
   { "type",               KW_TYPE },
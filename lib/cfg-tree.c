@@ -26,6 +26,9 @@
 #include "messages.h"
 #include "afinter.h"
 #include "logmpx.h"
+#include "logmsg.h"
+#include "filter/filter-pipe.h"
+#include "tls-support.h"
 
 #include <string.h>
 
@@ -372,6 +375,10 @@ log_expr_node_lookup_flag(const gchar *flag)
     return LC_FINAL;
   else if (strcmp(flag, "flow_control") == 0 || strcmp(flag, "flow-control") == 0)
     return LC_FLOW_CONTROL;
+  else if (strcmp(flag, "threaded") == 0)
+    return LC_THREADED;
+  else if (strcmp(flag, "passthrough") == 0)
+    return LC_PASSTHROUGH;
   msg_error("Unknown log statement flag", evt_tag_str("flag", flag), NULL);
   return 0;
 }
@@ -606,7 +613,7 @@ cfg_tree_compile_reference(CfgTree *self, LogExprNode *node,
 }
 
 static void
-cfg_tree_propagate_expr_node_properties_to_pipe(LogExprNode *node, LogPipe *pipe)
+cfg_tree_propagate_expr_node_properties_to_pipe(CfgTree *self, LogExprNode *node, LogPipe *pipe)
 {
   if (node->flags & LC_FALLBACK)
     pipe->flags |= PIF_BRANCH_FALLBACK;
@@ -615,7 +622,13 @@ cfg_tree_propagate_expr_node_properties_to_pipe(LogExprNode *node, LogPipe *pipe
     pipe->flags |= PIF_BRANCH_FINAL;
 
   if (node->flags & LC_FLOW_CONTROL)
-    pipe->flags |= PIF_HARD_FLOW_CONTROL;
+    {
+      pipe->flags |= PIF_HARD_FLOW_CONTROL;
+      self->flow_control_used = TRUE;
+    }
+
+  if (node->flags & LC_THREADED)
+    pipe->flags |= PIF_BRANCH_THREADED;
 
   if (!pipe->expr_node)
     pipe->expr_node = node;
@@ -702,7 +715,7 @@ cfg_tree_compile_sequence(CfgTree *self, LogExprNode *node,
         {
           if (!node_properties_propagated)
             {
-              cfg_tree_propagate_expr_node_properties_to_pipe(node, sub_pipe_head);
+              cfg_tree_propagate_expr_node_properties_to_pipe(self, node, sub_pipe_head);
               node_properties_propagated = TRUE;
             }
           if (!first_pipe && !last_pipe)
@@ -781,7 +794,7 @@ cfg_tree_compile_sequence(CfgTree *self, LogExprNode *node,
        * pipe_next list and is not forked off at a LogMultiplexer.
        * */
 
-      cfg_tree_propagate_expr_node_properties_to_pipe(node, last_pipe);
+      cfg_tree_propagate_expr_node_properties_to_pipe(self, node, last_pipe);
       node_properties_propagated = TRUE;
     }
 
@@ -1025,6 +1038,9 @@ cfg_tree_check_inline_template(CfgTree *self, const gchar *template_or_name, GEr
 {
   LogTemplate *template = cfg_tree_lookup_template(self, template_or_name);
 
+  if (template == NULL)
+    template = log_template_ref(g_hash_table_lookup(self->inline_templates, template_or_name));
+
   if (template == NULL)
     {
       template = log_template_new(self->cfg, NULL);
@@ -1034,10 +1050,386 @@ cfg_tree_check_inline_template(CfgTree *self, const gchar *template_or_name, GEr
           return NULL;
         }
       template->def_inline = TRUE;
+      g_hash_table_insert(self->inline_templates, template->template, log_template_ref(template));
+    }
+  else if (template->ref_cnt > 2)
+    {
+      /* besides our fresh reference and the one owned by the registry
+       * above, the template has at least one other consumer, so fan-out
+       * paths will expand it repeatedly for the same message; let the
+       * repeated expansions be served from the result cache whenever the
+       * template qualifies for it */
+      log_template_enable_result_cache(template);
     }
   return template;
 }
 
+typedef struct _CfgTreePriMask
+{
+  guint32 severities;
+  guint32 facilities;
+} CfgTreePriMask;
+
+static FilterExprNode *
+cfg_tree_get_filter_expr(CfgTree *self, LogExprNode *node)
+{
+  LogExprNode *child;
+
+  if (node->layout == ENL_REFERENCE)
+    node = cfg_tree_get_object(self, ENC_FILTER, node->name);
+  if (!node)
+    return NULL;
+
+  /* a filter rule contains a single LogFilterPipe, see the NOTE in
+   * cfg-grammar.y near the filter statement and filter_call_init() */
+  child = node->children;
+  if (child && !child->next && child->content == ENC_PIPE && child->object)
+    return ((LogFilterPipe *) child->object)->expr;
+  return NULL;
+}
+
+/*
+ * Accumulate the set of PRI values that can trigger any observable effect
+ * while traversing this log expression.  Filters narrow the gate for the
+ * elements behind them, everything else (destinations, parsers, rewrite
+ * rules and constructs we do not recognize) is conservatively treated as
+ * an effect that the gate collected so far can reach.
+ */
+static void
+log_expr_node_walk_accepted_pri(CfgTree *self, LogExprNode *node, guint32 gate_severities, guint32 gate_facilities, CfgTreePriMask *mask)
+{
+  LogExprNode *child;
+
+  for (child = node->children; child; child = child->next)
+    {
+      if (child->content == ENC_SOURCE)
+        continue;
+
+      if (child->content == ENC_FILTER)
+        {
+          FilterExprNode *expr = cfg_tree_get_filter_expr(self, child);
+          guint32 expr_severities = 0xff, expr_facilities = 0xffffffff;
+
+          if (expr)
+            filter_expr_get_accepted_pri(expr, &expr_severities, &expr_facilities);
+
+          /* messages rejected here never reach the elements behind us */
+          gate_severities &= expr_severities;
+          gate_facilities &= expr_facilities;
+        }
+      else if (child->layout == ENL_SEQUENCE || child->layout == ENL_JUNCTION)
+        {
+          /* embedded log statement or junction: the branches start with
+           * the gate collected so far, the main chain continues with the
+           * gate unchanged as branch filters do not affect it */
+          log_expr_node_walk_accepted_pri(self, child, gate_severities, gate_facilities, mask);
+        }
+      else
+        {
+          mask->severities |= gate_severities;
+          mask->facilities |= gate_facilities;
+        }
+    }
+}
+
+/*
+ * Collect every source referenced anywhere within this log expression
+ * (embedded log statements can reference sources too) and union the mask
+ * of the containing rule into their entries.
+ */
+static void
+cfg_tree_collect_source_pri_masks(CfgTree *self, LogExprNode *node, const CfgTreePriMask *rule_mask)
+{
+  LogExprNode *child;
+
+  for (child = node->children; child; child = child->next)
+    {
+      if (child->content == ENC_SOURCE)
+        {
+          CfgTreePriMask *mask;
+          gchar *name;
+
+          if (child->name)
+            name = g_strdup(child->name);
+          else if (child->children)
+            name = cfg_tree_get_rule_name(self, ENC_SOURCE, child->children);
+          else
+            continue;
+
+          mask = g_hash_table_lookup(self->source_pri_masks, name);
+          if (!mask)
+            {
+              mask = g_new0(CfgTreePriMask, 1);
+              g_hash_table_insert(self->source_pri_masks, name, mask);
+            }
+          else
+            g_free(name);
+          mask->severities |= rule_mask->severities;
+          mask->facilities |= rule_mask->facilities;
+        }
+      else if (child->children)
+        {
+          cfg_tree_collect_source_pri_masks(self, child, rule_mask);
+        }
+    }
+}
+
+/*
+ * Compute, for every source, the union of PRI values accepted by the log
+ * statements referencing it, so the sources can drop messages that no log
+ * path would act upon without parsing and queueing them first, see
+ * log_source_post().  Must run after cfg_tree_compile() so that catch-all
+ * rules have their source references expanded.
+ */
+static void
+cfg_tree_compile_source_pri_masks(CfgTree *self)
+{
+  gint i;
+
+  self->source_pri_masks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  for (i = 0; i < self->rules->len; i++)
+    {
+      LogExprNode *rule = (LogExprNode *) g_ptr_array_index(self->rules, i);
+      CfgTreePriMask rule_mask = { 0, 0 };
+
+      log_expr_node_walk_accepted_pri(self, rule, 0xff, 0xffffffff, &rule_mask);
+      cfg_tree_collect_source_pri_masks(self, rule, &rule_mask);
+    }
+}
+
+gboolean
+cfg_tree_get_source_accepted_pri(CfgTree *self, const gchar *source_name, guint32 *severities, guint32 *facilities)
+{
+  CfgTreePriMask *mask;
+
+  if (!self->source_pri_masks)
+    return FALSE;
+  mask = g_hash_table_lookup(self->source_pri_masks, source_name);
+  if (!mask)
+    return FALSE;
+  *severities = mask->severities;
+  *facilities = mask->facilities;
+  return TRUE;
+}
+
+/*
+ * Count the queue entries a message traversing this log expression may
+ * occupy at the same time: one per destination driver, destinations
+ * referenced by name are resolved and their drivers counted.  Filters
+ * and flags(final) can only lower the real number, so this is an upper
+ * bound.
+ */
+static gint
+log_expr_node_count_fanout(CfgTree *self, LogExprNode *node)
+{
+  gint fanout = 0;
+  LogExprNode *child;
+
+  for (child = node->children; child; child = child->next)
+    {
+      if (child->content == ENC_DESTINATION)
+        {
+          LogExprNode *dest = child;
+          LogExprNode *driver;
+          gint drivers = 0;
+
+          if (child->layout == ENL_REFERENCE)
+            dest = cfg_tree_get_object(self, ENC_DESTINATION, child->name);
+          if (!dest)
+            continue;
+          for (driver = dest->children; driver; driver = driver->next)
+            drivers++;
+          fanout += drivers ? drivers : 1;
+        }
+      else if (child->children)
+        {
+          fanout += log_expr_node_count_fanout(self, child);
+        }
+    }
+  return fanout;
+}
+
+/*
+ * Seed the number of LogMessageQueueNodes embedded into LogMessage
+ * allocations from the widest log statement of the configuration.
+ * log_msg_alloc_queue_node() adapts the same limit at runtime when a
+ * message overflows into heap allocated nodes, the seed merely spares
+ * the warmup where early messages of a wide fan-out config all take the
+ * overflow path.
+ */
+static void
+cfg_tree_compile_queue_node_seed(CfgTree *self)
+{
+  gint i;
+
+  for (i = 0; i < self->rules->len; i++)
+    {
+      LogExprNode *rule = (LogExprNode *) g_ptr_array_index(self->rules, i);
+      gint fanout = MIN(log_expr_node_count_fanout(self, rule), 32);
+
+      if (fanout > logmsg_queue_node_max)
+        logmsg_queue_node_max = fanout;
+    }
+}
+
+/*
+ * Validate and mark flags(passthrough) log statements.  Such a statement
+ * promises that it is a pure relay path: it may only contain source and
+ * destination references, nothing that would parse, filter or modify the
+ * message.  The destinations of qualifying statements get
+ * PIF_PASSTHROUGH on their pipes, which enables the verbatim forwarding
+ * fast path in the LogWriter for messages still carrying their raw frame
+ * (see LF_RAW_FRAME).  Since the mark is per destination while the flag
+ * is per statement, a passthrough destination must not be referenced
+ * from ordinary statements, that is validated here as well.  Must run
+ * after cfg_tree_compile() so the referenced objects have their compiled
+ * pipes in place.
+ */
+static gboolean
+cfg_tree_compile_passthrough_marks(CfgTree *self)
+{
+  GHashTable *passthrough_destinations = g_hash_table_new(g_str_hash, g_str_equal);
+  gboolean success = FALSE;
+  LogExprNode *child;
+  gint i;
+
+  for (i = 0; i < self->rules->len; i++)
+    {
+      LogExprNode *rule = (LogExprNode *) g_ptr_array_index(self->rules, i);
+
+      if (!(rule->flags & LC_PASSTHROUGH))
+        continue;
+
+      for (child = rule->children; child; child = child->next)
+        {
+          if (child->layout != ENL_REFERENCE ||
+              (child->content != ENC_SOURCE && child->content != ENC_DESTINATION))
+            {
+              msg_error("Only source and destination references are allowed in a flags(passthrough) log statement",
+                        log_expr_node_location_tag(child),
+                        NULL);
+              goto exit;
+            }
+          if (child->content == ENC_DESTINATION)
+            g_hash_table_insert(passthrough_destinations, child->name, child->name);
+        }
+    }
+
+  for (i = 0; i < self->rules->len; i++)
+    {
+      LogExprNode *rule = (LogExprNode *) g_ptr_array_index(self->rules, i);
+
+      if ((rule->flags & LC_PASSTHROUGH))
+        continue;
+
+      for (child = rule->children; child; child = child->next)
+        {
+          if (child->layout == ENL_REFERENCE && child->content == ENC_DESTINATION &&
+              child->name && g_hash_table_lookup(passthrough_destinations, child->name))
+            {
+              msg_error("Destinations used in a flags(passthrough) log statement must not be referenced from ordinary log statements",
+                        evt_tag_str("destination", child->name),
+                        log_expr_node_location_tag(child),
+                        NULL);
+              goto exit;
+            }
+        }
+    }
+
+  for (i = 0; i < self->rules->len; i++)
+    {
+      LogExprNode *rule = (LogExprNode *) g_ptr_array_index(self->rules, i);
+
+      if (!(rule->flags & LC_PASSTHROUGH))
+        continue;
+
+      for (child = rule->children; child; child = child->next)
+        {
+          LogExprNode *referenced_node;
+          LogPipe *pipe;
+
+          if (child->content != ENC_DESTINATION)
+            continue;
+
+          referenced_node = cfg_tree_get_object(self, ENC_DESTINATION, child->name);
+          if (!referenced_node || !referenced_node->aux)
+            continue;
+
+          /* mark the whole driver chain of the destination */
+          for (pipe = (LogPipe *) referenced_node->aux; pipe; pipe = pipe->pipe_next)
+            pipe->flags |= PIF_PASSTHROUGH;
+
+          msg_debug("Passthrough destination, raw frames are forwarded verbatim",
+                    evt_tag_str("destination", child->name),
+                    NULL);
+        }
+    }
+  success = TRUE;
+ exit:
+  g_hash_table_destroy(passthrough_destinations);
+  return success;
+}
+
+/*
+ * Determine whether @pipe is a plain glue LogPipe whose queue method does
+ * nothing but forward to pipe_next.  Such pipes are created by the
+ * compilation above as junction join points, source attachment points and
+ * placeholders for empty sequences; configurations generated from scl/
+ * blocks contain long chains of them, each costing a virtual queue() call
+ * with LogPathOptions bookkeeping per message.
+ *
+ * A pipe only qualifies if it has no methods of its own (only a bare
+ * log_pipe_new() instance satisfies this) and carries no flags, since
+ * flags on a chained pipe are observed by others: branch properties are
+ * collected by log_multiplexer_init() walking pipe_next and flow control
+ * is applied in log_pipe_queue() itself.
+ */
+static gboolean
+cfg_tree_pipe_is_glue(LogPipe *pipe)
+{
+  return pipe->queue == NULL &&
+         pipe->init == NULL &&
+         pipe->deinit == NULL &&
+         pipe->notify == NULL &&
+         pipe->clone == NULL &&
+         pipe->free_fn == NULL &&
+         pipe->flags == 0;
+}
+
+/*
+ * Short-circuit linear chains of glue pipes by pointing pipe_next past
+ * them.  The glue pipes themselves are left in initialized_pipes with
+ * their own pipe_next intact, so lifetime management and any other
+ * reference to them remain valid, they merely stop being visited by
+ * messages.  Must run after cfg_tree_compile() built all the chains and
+ * before the pipes are initialized.
+ */
+static void
+cfg_tree_fuse_pipes(CfgTree *self)
+{
+  gint eliminated = 0;
+  gint i;
+
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogPipe *pipe = g_ptr_array_index(self->initialized_pipes, i);
+
+      while (pipe->pipe_next && cfg_tree_pipe_is_glue(pipe->pipe_next))
+        {
+          msg_debug("Fusing pipeline, skipping do-nothing pipe",
+                    log_pipe_location_tag(pipe),
+                    NULL);
+          pipe->pipe_next = pipe->pipe_next->pipe_next;
+          eliminated++;
+        }
+    }
+
+  if (eliminated)
+    msg_verbose("Pipeline fusion eliminated message hops",
+                evt_tag_int("hops", eliminated),
+                NULL);
+}
+
 gboolean
 cfg_tree_compile(CfgTree *self)
 {
@@ -1065,6 +1457,183 @@ cfg_tree_compile(CfgTree *self)
   return TRUE;
 }
 
+/* Config profiling
+ * ================
+ *
+ * When enabled via the CONFIG_PROFILE control command, log_pipe_queue()
+ * detours through log_pipe_queue_profiled() below for every pipe that
+ * belongs to a config element.  Invocations are counted exactly, the
+ * cost of one call in every 16 is measured in cycles, and nested
+ * element costs are subtracted through a per-thread accumulator, so
+ * each element is charged for its own work only, not for everything
+ * behind it in the log path.
+ */
+
+volatile gboolean cfg_tree_profile_enabled;
+
+/* sample the cost of one call in this many on each element */
+#define CFG_TREE_PROFILE_SAMPLE_MASK 0x0f
+
+TLS_BLOCK_START
+{
+  /* cycles consumed by profiled elements nested below the one currently
+   * being sampled on this thread */
+  guint64 profile_child_cycles;
+  /* depth of enclosing sampled calls; while non-zero every profiled
+   * element must measure itself, that is what makes the subtraction of
+   * nested costs exact */
+  gint profile_sampling_depth;
+}
+TLS_BLOCK_END;
+
+#define profile_child_cycles __tls_deref(profile_child_cycles)
+#define profile_sampling_depth __tls_deref(profile_sampling_depth)
+
+static inline guint64
+cfg_tree_profile_get_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  guint32 lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((guint64) hi << 32) | lo;
+#else
+  /* no cheap cycle counter on this arch, account microseconds instead;
+   * the report is only used for relative ordering anyway */
+  GTimeVal now;
+
+  g_get_current_time(&now);
+  return (guint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+#endif
+}
+
+void
+log_pipe_queue_profiled(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogExprNode *node = s->expr_node;
+  guint64 start, total, saved_child_cycles;
+
+  node->prof_calls++;
+
+  if (profile_sampling_depth == 0 &&
+      (node->prof_calls & CFG_TREE_PROFILE_SAMPLE_MASK) != 0)
+    {
+      /* not sampled, only the invocation count is maintained */
+      if (s->queue)
+        s->queue(s, msg, path_options, s->queue_data);
+      else
+        log_pipe_forward_msg(s, msg, path_options);
+      return;
+    }
+
+  profile_sampling_depth++;
+  saved_child_cycles = profile_child_cycles;
+  profile_child_cycles = 0;
+  start = cfg_tree_profile_get_cycles();
+
+  if (s->queue)
+    s->queue(s, msg, path_options, s->queue_data);
+  else
+    log_pipe_forward_msg(s, msg, path_options);
+
+  total = cfg_tree_profile_get_cycles() - start;
+  node->prof_sampled_calls++;
+  node->prof_cycles += total > profile_child_cycles ? total - profile_child_cycles : 0;
+  profile_child_cycles = saved_child_cycles + total;
+  profile_sampling_depth--;
+}
+
+static void
+cfg_tree_profile_reset_counters(CfgTree *self)
+{
+  gint i;
+
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogExprNode *node = ((LogPipe *) g_ptr_array_index(self->initialized_pipes, i))->expr_node;
+
+      if (node)
+        {
+          node->prof_calls = 0;
+          node->prof_sampled_calls = 0;
+          node->prof_cycles = 0;
+        }
+    }
+}
+
+void
+cfg_tree_profile_start(CfgTree *self)
+{
+  cfg_tree_profile_reset_counters(self);
+  cfg_tree_profile_enabled = TRUE;
+}
+
+void
+cfg_tree_profile_stop(CfgTree *self)
+{
+  cfg_tree_profile_enabled = FALSE;
+}
+
+/* total cost of an element over the profiled period, extrapolated from
+ * the sampled calls to all of its calls */
+static guint64
+cfg_tree_profile_estimated_cost(LogExprNode *node)
+{
+  if (!node->prof_sampled_calls)
+    return 0;
+  return node->prof_cycles / node->prof_sampled_calls * node->prof_calls;
+}
+
+static gint
+cfg_tree_profile_compare_cost(gconstpointer a, gconstpointer b)
+{
+  guint64 cost_a = cfg_tree_profile_estimated_cost(*(LogExprNode **) a);
+  guint64 cost_b = cfg_tree_profile_estimated_cost(*(LogExprNode **) b);
+
+  if (cost_a == cost_b)
+    return 0;
+  return cost_a < cost_b ? 1 : -1;
+}
+
+void
+cfg_tree_format_profile(CfgTree *self, GString *result)
+{
+  GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  GPtrArray *nodes = g_ptr_array_new();
+  gchar buf[256];
+  gint i;
+
+  /* several pipes may share one element (clones across log paths), the
+   * counters live on the element so each is reported once */
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogExprNode *node = ((LogPipe *) g_ptr_array_index(self->initialized_pipes, i))->expr_node;
+
+      if (node && node->prof_calls && !g_hash_table_lookup(seen, node))
+        {
+          g_hash_table_insert(seen, node, node);
+          g_ptr_array_add(nodes, node);
+        }
+    }
+  g_ptr_array_sort(nodes, cfg_tree_profile_compare_cost);
+
+  g_string_append(result, "Location;Type;Name;Calls;AvgCycles;EstTotalCycles\n");
+  for (i = 0; i < nodes->len; i++)
+    {
+      LogExprNode *node = g_ptr_array_index(nodes, i);
+
+      g_string_append_printf(result, "%s;%s;%s;%" G_GUINT64_FORMAT ";%" G_GUINT64_FORMAT ";%" G_GUINT64_FORMAT "\n",
+                             log_expr_node_format_location(node, buf, sizeof(buf)),
+                             log_expr_node_get_content_name(node->content),
+                             node->name ? node->name : "-",
+                             node->prof_calls,
+                             node->prof_sampled_calls ? node->prof_cycles / node->prof_sampled_calls : 0,
+                             cfg_tree_profile_estimated_cost(node));
+    }
+  g_ptr_array_free(nodes, TRUE);
+  g_hash_table_destroy(seen);
+}
+
 gboolean
 cfg_tree_start(CfgTree *self)
 {
@@ -1073,6 +1642,13 @@ cfg_tree_start(CfgTree *self)
   if (!cfg_tree_compile(self))
     return FALSE;
 
+  cfg_tree_fuse_pipes(self);
+  cfg_tree_compile_source_pri_masks(self);
+  cfg_tree_compile_queue_node_seed(self);
+
+  if (!cfg_tree_compile_passthrough_marks(self))
+    return FALSE;
+
   /*
    *   As there are pipes that are dynamically created during init, these
    *   pipes must be deinited before destroying the configuration, otherwise
@@ -1114,6 +1690,7 @@ cfg_tree_init_instance(CfgTree *self, GlobalConfig *cfg)
   self->initialized_pipes = g_ptr_array_new();
   self->objects = g_hash_table_new_full(cfg_tree_objects_hash, cfg_tree_objects_equal, NULL, (GDestroyNotify) log_expr_node_free);
   self->templates = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) log_template_unref);
+  self->inline_templates = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) log_template_unref);
   self->rules = g_ptr_array_new();
   self->cfg = cfg;
 }
@@ -1129,5 +1706,11 @@ cfg_tree_free_instance(CfgTree *self)
 
   g_hash_table_destroy(self->objects);
   g_hash_table_destroy(self->templates);
+  g_hash_table_destroy(self->inline_templates);
+  if (self->source_pri_masks)
+    {
+      g_hash_table_destroy(self->source_pri_masks);
+      self->source_pri_masks = NULL;
+    }
   self->cfg = NULL;
 }
@@ -36,6 +36,8 @@ const gchar *log_expr_node_get_content_name(gint content);
 #define LC_FALLBACK 2
 #define LC_FINAL    4
 #define LC_FLOW_CONTROL 8
+#define LC_THREADED    16
+#define LC_PASSTHROUGH 32
 
 enum
 {
@@ -120,6 +122,13 @@ struct _LogExprNode
   gchar *filename;
   gint line, column;
   gint child_id;
+
+  /* per-element execution profile, maintained by log_pipe_queue_profiled()
+   * while config profiling is enabled.  Updated racily from all threads
+   * traversing the element, a lost update only skews a sample. */
+  guint64 prof_calls;
+  guint64 prof_sampled_calls;
+  guint64 prof_cycles;
 };
 
 gint log_expr_node_lookup_flag(const gchar *flag);
@@ -157,6 +166,15 @@ typedef struct _CfgTree
   /* list of top-level rules */
   GPtrArray *rules;
   GHashTable *templates;
+  /* inline template() strings interned by content, so destinations
+   * spelling out the same template share one compiled instance, see
+   * cfg_tree_check_inline_template() */
+  GHashTable *inline_templates;
+  /* set during compilation if any log statement uses flags(flow-control) */
+  gboolean flow_control_used;
+  /* per-source union of the PRI values accepted by the referencing log
+   * statements, computed in cfg_tree_start() */
+  GHashTable *source_pri_masks;
 } CfgTree;
 
 gboolean cfg_tree_add_object(CfgTree *self, LogExprNode *rule);
@@ -166,9 +184,20 @@ gboolean cfg_tree_add_template(CfgTree *self, LogTemplate *template);
 LogTemplate *cfg_tree_lookup_template(CfgTree *self, const gchar *name);
 LogTemplate *cfg_tree_check_inline_template(CfgTree *self, const gchar *template_or_name, GError **error);
 
+gboolean cfg_tree_get_source_accepted_pri(CfgTree *self, const gchar *source_name, guint32 *severities, guint32 *facilities);
 gchar *cfg_tree_get_rule_name(CfgTree *self, gint content, LogExprNode *node);
 gchar *cfg_tree_get_child_id(CfgTree *self, gint content, LogExprNode *node);
 
+/* config profiling (the CONFIG_PROFILE control command): when enabled,
+ * log_pipe_queue() routes messages through log_pipe_queue_profiled(),
+ * which counts invocations per config element and samples their CPU
+ * cost, attributed to the element's config location */
+extern volatile gboolean cfg_tree_profile_enabled;
+
+void cfg_tree_profile_start(CfgTree *self);
+void cfg_tree_profile_stop(CfgTree *self);
+void cfg_tree_format_profile(CfgTree *self, GString *result);
+
 gboolean cfg_tree_start(CfgTree *self);
 gboolean cfg_tree_stop(CfgTree *self);
 
@@ -33,7 +33,9 @@
 #include "serialize.h"
 #include "plugin.h"
 #include "cfg-parser.h"
+#include "filter/filter-re.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-persist.h"
 #include "logproto/logproto-builtins.h"
 #include "reloc.h"
 #include "hostname.h"
@@ -224,7 +226,9 @@ gboolean
 cfg_init(GlobalConfig *cfg)
 {
   gint regerr;
-  
+  GTimeVal modules_start, tree_start, tree_end;
+  gboolean result;
+
   if (cfg->file_template_name && !(cfg->file_template = cfg_tree_lookup_template(&cfg->tree, cfg->file_template_name)))
     msg_error("Error resolving file template",
                evt_tag_str("name", cfg->file_template_name),
@@ -255,21 +259,35 @@ cfg_init(GlobalConfig *cfg)
     return FALSE;
 
   stats_reinit(&cfg->stats_options);
+  stats_persist_reinit(cfg->state, cfg->stats_options.persist_freq > 0);
   log_tags_reinit_stats(cfg);
 
   dns_cache_set_params(cfg->dns_cache_size, cfg->dns_cache_expire, cfg->dns_cache_expire_failed, cfg->dns_cache_hosts);
   hostname_reinit(cfg->custom_domain);
   host_resolve_options_init(&cfg->host_resolve_options, cfg);
   log_template_options_init(&cfg->template_options, cfg);
+  g_get_current_time(&modules_start);
   if (!cfg_init_modules(cfg))
     return FALSE;
-  return cfg_tree_start(&cfg->tree);
+  g_get_current_time(&tree_start);
+  result = cfg_tree_start(&cfg->tree);
+  g_get_current_time(&tree_end);
+  msg_verbose("Configuration initialization phase timings",
+              evt_tag_long("module_init_usec",
+                           (tree_start.tv_sec - modules_start.tv_sec) * G_USEC_PER_SEC + (tree_start.tv_usec - modules_start.tv_usec)),
+              evt_tag_long("tree_start_usec",
+                           (tree_end.tv_sec - tree_start.tv_sec) * G_USEC_PER_SEC + (tree_end.tv_usec - tree_start.tv_usec)),
+              NULL);
+  return result;
 }
 
 gboolean
 cfg_deinit(GlobalConfig *cfg)
 {
   cfg_deinit_modules(cfg);
+  /* final checkpoint with the counters still in place, so a restart
+   * continues from the values at shutdown and not the last timer tick */
+  stats_persist_deinit();
   rcptid_deinit();
   return cfg_tree_stop(&cfg->tree);
 }
@@ -368,7 +386,10 @@ cfg_new(gint version)
   self->dns_cache_expire = 3600;
   self->dns_cache_expire_failed = 60;
   self->threaded = TRUE;
+  self->dest_worker_pool_size = 0;
+  self->latency_sample_freq = 0;
   self->pass_unix_credentials = TRUE;
+  self->skip_unchanged_reloads = FALSE;
   
   log_template_options_defaults(&self->template_options);
   self->template_options.ts_format = TS_FMT_BSD;
@@ -439,6 +460,25 @@ cfg_load_candidate_modules(GlobalConfig *self)
     }
 }
 
+/* 64 bit FNV-1a over the preprocessed configuration text.  The
+ * preprocessed output is produced by the lexer and covers all included
+ * files and expanded blocks, so two configs hashing the same are the
+ * same as far as the running instance is concerned. */
+static guint64
+cfg_hash_preprocessed_config(GString *preprocess_output)
+{
+  guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+  gsize i;
+
+  for (i = 0; i < preprocess_output->len; i++)
+    {
+      hash ^= (guchar) preprocess_output->str[i];
+      hash *= G_GUINT64_CONSTANT(0x100000001b3);
+    }
+  /* zero is reserved for "unknown" */
+  return hash ? hash : 1;
+}
+
 static void
 cfg_dump_processed_config(GString *preprocess_output, gchar *output_filename)
 {
@@ -467,6 +507,8 @@ cfg_load_config(GlobalConfig *self, gchar *config_string, gboolean syntax_only,
     {
       cfg_dump_processed_config(preprocess_output, preprocess_into);
     }
+  if (res)
+    self->preprocess_config_hash = cfg_hash_preprocessed_config(preprocess_output);
   g_string_free(preprocess_output, TRUE);
   if (res)
     {
@@ -495,6 +537,8 @@ cfg_read_config(GlobalConfig *self, const gchar *fname, gboolean syntax_only, gc
         {
           cfg_dump_processed_config(preprocess_output, preprocess_into);
         }
+      if (res)
+        self->preprocess_config_hash = cfg_hash_preprocessed_config(preprocess_output);
       g_string_free(preprocess_output, TRUE);
       if (res)
         {
@@ -535,6 +579,8 @@ cfg_free(GlobalConfig *self)
   plugin_free_plugins(self);
   plugin_free_candidate_modules(self);
   cfg_tree_free_instance(&self->tree);
+  if (self->program_dispatch)
+    filter_program_dispatch_free(self->program_dispatch);
   g_hash_table_unref(self->module_config);
   g_free(self);
 }
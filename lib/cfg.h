@@ -63,6 +63,15 @@ struct _GlobalConfig
    * multiple times if the user uses @version multiple times */
   gint parsed_version;
   const gchar *filename;
+  /* hash of the preprocessed configuration text, used to recognize
+   * reloads that do not actually change anything; 0 when unknown */
+  guint64 preprocess_config_hash;
+  /* opt-in: short-circuit reloads whose preprocessed text hashes the
+   * same as the running config.  Off by default, as a HUP has
+   * side-effects beyond applying config changes: file destinations are
+   * reopened (which logrotate depends on) and file backed resources
+   * like pattern databases and TLS certificates are re-read */
+  gboolean skip_unchanged_reloads;
   GList *plugins;
   GList *candidate_plugins;
   gboolean autoload_compiled_modules;
@@ -74,6 +83,12 @@ struct _GlobalConfig
   gint mark_mode;
   gint flush_timeout;
   gboolean threaded;
+  /* number of threads shared by threaded destinations, 0 spawns a dedicated
+   * thread per driver */
+  gint dest_worker_pool_size;
+  /* stamp every Nth message at the source and publish latency histograms
+   * at the destinations, 0 disables the tracer */
+  gint latency_sample_freq;
   gboolean pass_unix_credentials;
   gboolean chain_hostnames;
   gboolean keep_hostname;
@@ -118,7 +133,15 @@ struct _GlobalConfig
   PersistConfig *persist;
   PersistState *state;
   GHashTable *module_config;
-  
+
+  /* number of per-message memoization slots already handed out to shared
+   * filter expressions, see log_filter_pipe_init() */
+  gint filter_memo_slots;
+
+  /* lookup table of exact program() filter literals, built lazily in
+   * log_filter_pipe_init(), see filter-re.c */
+  struct _FilterProgramDispatch *program_dispatch;
+
   CfgTree tree;
 
 };
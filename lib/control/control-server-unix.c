@@ -39,6 +39,103 @@ typedef struct _ControlConnectionUnix
   gint fd;
 } ControlConnectionUnix;
 
+gboolean
+control_connection_send_fd(ControlConnection *s, const gchar *name, gint fd)
+{
+  ControlConnectionUnix *self = (ControlConnectionUnix *)s;
+  struct msghdr msg;
+  struct iovec iov[2];
+  gchar cmsg_buf[CMSG_SPACE(sizeof(gint))];
+  struct cmsghdr *cmsg;
+
+  memset(&msg, 0, sizeof(msg));
+  iov[0].iov_base = (gpointer) name;
+  iov[0].iov_len = strlen(name);
+  iov[1].iov_base = (gpointer) "\n";
+  iov[1].iov_len = 1;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  memset(cmsg_buf, 0, sizeof(cmsg_buf));
+  msg.msg_control = cmsg_buf;
+  msg.msg_controllen = sizeof(cmsg_buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(gint));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(gint));
+
+  /* the fd-bearing records bypass the buffered reply path on purpose:
+   * ancillary data cannot be queued in the output buffer, and the
+   * records are small enough to fit the socket buffer of a freshly
+   * accepted connection */
+  return sendmsg(self->control_io.fd, &msg, 0) >= 0;
+}
+
+gboolean
+control_client_receive_handover_fds(const gchar *control_name,
+                                    void (*deliver)(const gchar *name, gint fd, gpointer user_data),
+                                    gpointer user_data)
+{
+  GSockAddr *saddr;
+  gint sock;
+  static const gchar request[] = "HANDOVER\n";
+
+  sock = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1)
+    return FALSE;
+  saddr = g_sockaddr_unix_new(control_name);
+  if (g_connect(sock, saddr) != G_IO_STATUS_NORMAL)
+    {
+      g_sockaddr_unref(saddr);
+      close(sock);
+      return FALSE;
+    }
+  g_sockaddr_unref(saddr);
+
+  if (write(sock, request, sizeof(request) - 1) != sizeof(request) - 1)
+    {
+      close(sock);
+      return FALSE;
+    }
+
+  for (;;)
+    {
+      gchar buf[512];
+      gchar cmsg_buf[CMSG_SPACE(sizeof(gint))];
+      struct msghdr msg;
+      struct iovec iov;
+      struct cmsghdr *cmsg;
+      gint fd;
+      gssize rc;
+
+      memset(&msg, 0, sizeof(msg));
+      iov.iov_base = buf;
+      iov.iov_len = sizeof(buf) - 1;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = cmsg_buf;
+      msg.msg_controllen = sizeof(cmsg_buf);
+
+      rc = recvmsg(sock, &msg, 0);
+      if (rc <= 0)
+        break;
+      /* recvmsg() does not merge payload across ancillary data
+       * boundaries, each fd record arrives on its own; the plain status
+       * line ending the reply carries no ancillary data */
+      cmsg = CMSG_FIRSTHDR(&msg);
+      if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        break;
+      buf[rc] = 0;
+      if (rc > 0 && buf[rc - 1] == '\n')
+        buf[rc - 1] = 0;
+      memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+      deliver(buf, fd, user_data);
+    }
+  close(sock);
+  return TRUE;
+}
+
 gint
 control_connection_unix_write(ControlConnection *s, gpointer buffer, gsize size)
 {
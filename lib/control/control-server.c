@@ -37,9 +37,31 @@ control_server_init_instance(ControlServer *self, const gchar *path, GList *cont
   self->control_commands = control_commands;
 }
 
+void
+control_connection_set_response_generator(ControlConnection *self,
+                                          gboolean (*generate_response)(ControlConnection *self),
+                                          gpointer generator_state,
+                                          GDestroyNotify generator_state_free)
+{
+  self->generate_response = generate_response;
+  self->generator_state = generator_state;
+  self->generator_state_free = generator_state_free;
+}
+
+static void
+control_connection_clear_response_generator(ControlConnection *self)
+{
+  if (self->generator_state_free)
+    self->generator_state_free(self->generator_state);
+  self->generate_response = NULL;
+  self->generator_state = NULL;
+  self->generator_state_free = NULL;
+}
+
 void
 control_connection_free(ControlConnection *self)
 {
+  control_connection_clear_response_generator(self);
   if (self->free_fn)
     {
       self->free_fn(self);
@@ -49,11 +71,33 @@ control_connection_free(ControlConnection *self)
   g_free(self);
 }
 
+/* the output buffer drained, reuse it for the next chunk of the
+ * streamed reply, or terminate the reply once the generator is done */
+static void
+control_connection_fill_output_from_generator(ControlConnection *self)
+{
+  g_string_truncate(self->output_buffer, 0);
+  self->pos = 0;
+
+  if (!self->generate_response(self))
+    {
+      control_connection_clear_response_generator(self);
+      if (self->output_buffer->len > 0 &&
+          self->output_buffer->str[self->output_buffer->len - 1] != '\n')
+        {
+          g_string_append_c(self->output_buffer, '\n');
+        }
+      g_string_append(self->output_buffer, ".\n");
+    }
+}
+
 static void
 control_connection_send_reply(ControlConnection *self, GString *reply)
 {
-  g_string_assign(self->output_buffer, reply->str);
-  g_string_free(reply, TRUE);
+  /* take ownership of the reply instead of copying it, replies can run
+   * to considerable sizes */
+  g_string_free(self->output_buffer, TRUE);
+  self->output_buffer = reply;
 
   self->pos = 0;
 
@@ -89,6 +133,8 @@ control_connection_io_output(gpointer s)
     {
       self->pos += rc;
     }
+  if (self->pos >= self->output_buffer->len && self->generate_response)
+    control_connection_fill_output_from_generator(self);
   control_connection_update_watches(self);
 }
 
@@ -165,8 +211,18 @@ control_connection_io_input(void *s)
     {
       if (strncmp(((ControlCommand*)iter->data)->command_name, command->str, strlen(((ControlCommand*)iter->data)->command_name)) == 0)
         {
-          reply = ((ControlCommand*)iter->data)->func(command);
-          control_connection_send_reply(self, reply);
+          reply = ((ControlCommand*)iter->data)->func(self, command);
+          if (reply)
+            {
+              control_connection_send_reply(self, reply);
+            }
+          else
+            {
+              /* the command installed a response generator instead of
+               * returning a complete reply, produce the first chunk */
+              g_assert(self->generate_response);
+              control_connection_fill_output_from_generator(self);
+            }
           break;
         }
     }
@@ -50,6 +50,15 @@ struct _ControlConnection
   void (*handle_input)(gpointer s);
   void (*handle_output)(gpointer s);
   void (*free_fn)(ControlConnection *self);
+
+  /* streaming replies: invoked with a drained output buffer to append
+   * the next chunk, returns FALSE once the reply is complete; the
+   * buffer is reused across chunks, so large replies never exist in
+   * memory in one piece and a slow peer applies backpressure instead of
+   * ballooning the buffer */
+  gboolean (*generate_response)(ControlConnection *self);
+  gpointer generator_state;
+  GDestroyNotify generator_state_free;
 };
 
 struct _ControlServer
@@ -67,6 +76,19 @@ void control_server_free(ControlServer *self);
 void control_server_init_instance(ControlServer *self, const gchar *path, GList *control_commands);
 
 
+void control_connection_set_response_generator(ControlConnection *self,
+                                               gboolean (*generate_response)(ControlConnection *self),
+                                               gpointer generator_state,
+                                               GDestroyNotify generator_state_free);
+
+/* fd passing for the HANDOVER command: each fd travels in its own
+ * SCM_RIGHTS message carrying the registered name as payload, the plain
+ * status line that follows terminates the stream on the receiving side */
+gboolean control_connection_send_fd(ControlConnection *self, const gchar *name, gint fd);
+gboolean control_client_receive_handover_fds(const gchar *control_name,
+                                             void (*deliver)(const gchar *name, gint fd, gpointer user_data),
+                                             gpointer user_data);
+
 void control_connection_start_watches(ControlConnection *self);
 void control_connection_update_watches(ControlConnection *self);
 void control_connection_stop_watches(ControlConnection *self);
@@ -30,6 +30,10 @@
 #include "stats/stats-counter.h"
 #include "misc.h"
 #include "mainloop.h"
+#include "debugger/tap.h"
+#include "logqueue.h"
+#include "profiler.h"
+#include "cfg.h"
 
 #include <errno.h>
 #include <string.h>
@@ -39,6 +43,43 @@
 static ControlServer *control_server;
 static GList *command_list = NULL;
 
+/* live listening fds offered to a successor process, keyed by the same
+ * persist name the fds are kept under across reloads; values are fd + 1
+ * as the table cannot store NULL.  SCM_RIGHTS duplicates the fd into the
+ * receiver, so entries stay registered after a handover and this process
+ * keeps serving until it is stopped. */
+static GHashTable *handover_fds;
+
+void
+control_register_handover_fd(const gchar *name, gint fd)
+{
+  if (!handover_fds)
+    handover_fds = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_replace(handover_fds, g_strdup(name), GUINT_TO_POINTER(fd + 1));
+}
+
+void
+control_unregister_handover_fd(const gchar *name)
+{
+  if (handover_fds)
+    g_hash_table_remove(handover_fds, name);
+}
+
+/* removes the entry: a fetched fd is owned by the caller from here on */
+gint
+control_lookup_handover_fd(const gchar *name)
+{
+  gpointer value;
+
+  if (!handover_fds)
+    return -1;
+  value = g_hash_table_lookup(handover_fds, name);
+  if (!value)
+    return -1;
+  g_hash_table_remove(handover_fds, name);
+  return GPOINTER_TO_UINT(value) - 1;
+}
+
 void
 control_register_command(const gchar *command_name, const gchar *description, CommandFunction function)
 {
@@ -49,17 +90,94 @@ control_register_command(const gchar *command_name, const gchar *description, Co
   command_list = g_list_append(command_list, new_command);
 };
 
+/* number of clusters rendered into the output buffer per chunk of a
+ * streamed STATS reply, roughly 16-64k of CSV */
+#define STATS_RESPONSE_CLUSTERS_PER_CHUNK 256
+
+typedef struct _StatsResponseState
+{
+  GPtrArray *clusters;
+  guint pos;
+  gboolean header_sent;
+} StatsResponseState;
+
+static void
+stats_response_state_free(gpointer s)
+{
+  StatsResponseState *state = (StatsResponseState *) s;
+
+  g_ptr_array_free(state->clusters, TRUE);
+  g_free(state);
+}
+
+static gboolean
+control_connection_append_stats_chunk(ControlConnection *conn)
+{
+  StatsResponseState *state = (StatsResponseState *) conn->generator_state;
+  guint chunk_end = MIN(state->pos + STATS_RESPONSE_CLUSTERS_PER_CHUNK, state->clusters->len);
+
+  if (!state->header_sent)
+    {
+      stats_csv_format_header(conn->output_buffer);
+      state->header_sent = TRUE;
+    }
+  for (; state->pos < chunk_end; state->pos++)
+    stats_csv_format_cluster(g_ptr_array_index(state->clusters, state->pos), conn->output_buffer);
+  return state->pos < state->clusters->len;
+}
+
 static GString *
-control_connection_send_stats(GString *command)
+control_connection_send_stats(ControlConnection *conn, GString *command)
 {
-  gchar *stats = stats_generate_csv();
-  GString *result = g_string_new(stats);
-  g_free(stats);
+  StatsResponseState *state;
+
+  if (!conn)
+    {
+      /* no connection to stream to, render the reply in one piece */
+      gchar *stats = stats_generate_csv();
+      GString *result = g_string_new(stats);
+      g_free(stats);
+      return result;
+    }
+
+  /* a large stats dump is streamed into the reused output buffer of the
+   * connection as it drains, instead of materializing the whole CSV
+   * upfront; a slow reader thus exerts backpressure through ivykis
+   * rather than ballooning our memory usage */
+  state = g_new0(StatsResponseState, 1);
+  state->clusters = stats_csv_get_cluster_snapshot();
+  control_connection_set_response_generator(conn, control_connection_append_stats_chunk,
+                                            state, stats_response_state_free);
+  return NULL;
+}
+
+static void
+_append_queue_info(gpointer data, gpointer user_data)
+{
+  LogQueue *queue = (LogQueue *) data;
+  GString *result = (GString *) user_data;
+
+  /* all fields are either atomically maintained counters or racy
+   * approximations, no queue locks are taken */
+  g_string_append_printf(result, "%s;%" G_GINT64_FORMAT ";%" G_GINT64_FORMAT ";%u\n",
+                         queue->persist_name ? queue->persist_name : "-",
+                         log_queue_get_length(queue),
+                         queue->max_length,
+                         stats_counter_get(queue->dropped_messages));
+}
+
+static GString *
+control_connection_show_queues(ControlConnection *conn, GString *command)
+{
+  GString *result = g_string_sized_new(256);
+
+  g_string_append(result, "QueueName;Length;HighWatermark;Dropped\n");
+  log_queue_registry_foreach(_append_queue_info, result);
   return result;
 }
 
 static GString *
-control_connection_reset_stats(GString *command)
+control_connection_reset_stats(ControlConnection *conn, GString *command)
 {
   GString *result = g_string_new("The statistics of syslog-ng have been reset to 0.");
   stats_reset_non_stored_counters();
@@ -67,7 +185,7 @@ control_connection_reset_stats(GString *command)
 }
 
 static GString *
-control_connection_message_log(GString *command)
+control_connection_message_log(ControlConnection *conn, GString *command)
 {
   gchar **cmds = g_strsplit(command->str, " ", 3);
   gboolean on;
@@ -113,7 +231,97 @@ exit:
 }
 
 static GString *
-control_connection_stop_process(GString *command)
+control_connection_tap(ControlConnection *conn, GString *command)
+{
+  gchar **cmds = g_strsplit(command->str, " ", 5);
+  GString *result = g_string_sized_new(128);
+
+  if (!cmds[1])
+    g_string_assign(result, "FAIL Expected TAP START <location> [<freq> [<bytes>]], TAP FETCH or TAP STOP");
+  else if (g_str_equal(cmds[1], "START"))
+    {
+      if (!cmds[2])
+        g_string_assign(result, "FAIL Expected a location (filename:line:column) to attach to");
+      else
+        msg_tap_start(main_loop_get_current_config(), cmds[2],
+                      cmds[3] ? atoi(cmds[3]) : 1,
+                      cmds[3] && cmds[4] ? atoi(cmds[4]) : 0,
+                      result);
+    }
+  else if (g_str_equal(cmds[1], "FETCH"))
+    msg_tap_fetch(result);
+  else if (g_str_equal(cmds[1], "STOP"))
+    msg_tap_stop(result);
+  else
+    g_string_assign(result, "FAIL Invalid arguments received");
+  g_strfreev(cmds);
+  return result;
+}
+
+static GString *
+control_connection_profile(ControlConnection *conn, GString *command)
+{
+  gchar **cmds = g_strsplit(command->str, " ", 3);
+  GString *result = g_string_sized_new(128);
+
+  if (!cmds[1])
+    g_string_assign(result, "FAIL Expected PROFILE START [<freq>] or PROFILE STOP");
+  else if (g_str_equal(cmds[1], "START"))
+    {
+      /* a prime default frequency avoids sampling in lockstep with
+       * timer driven work */
+      profiler_start(cmds[2] ? atoi(cmds[2]) : 97, result);
+    }
+  else if (g_str_equal(cmds[1], "STOP"))
+    profiler_stop(result);
+  else
+    g_string_assign(result, "FAIL Invalid arguments received");
+  g_strfreev(cmds);
+  return result;
+}
+
+static GString *
+control_connection_config_profile(ControlConnection *conn, GString *command)
+{
+  gchar **cmds = g_strsplit(command->str, " ", 2);
+  GString *result = g_string_sized_new(128);
+  CfgTree *tree = &main_loop_get_current_config()->tree;
+
+  if (!cmds[1] || g_str_equal(cmds[1], "DUMP"))
+    {
+      if (!cfg_tree_profile_enabled)
+        g_string_assign(result, "FAIL Config profiling is not running");
+      else
+        cfg_tree_format_profile(tree, result);
+    }
+  else if (g_str_equal(cmds[1], "START"))
+    {
+      if (cfg_tree_profile_enabled)
+        g_string_assign(result, "FAIL Config profiling is already running");
+      else
+        {
+          cfg_tree_profile_start(tree);
+          g_string_assign(result, "OK Config profiling started");
+        }
+    }
+  else if (g_str_equal(cmds[1], "STOP"))
+    {
+      if (!cfg_tree_profile_enabled)
+        g_string_assign(result, "FAIL Config profiling is not running");
+      else
+        {
+          cfg_tree_profile_stop(tree);
+          cfg_tree_format_profile(tree, result);
+        }
+    }
+  else
+    g_string_assign(result, "FAIL Expected CONFIG_PROFILE [START|STOP|DUMP]");
+  g_strfreev(cmds);
+  return result;
+}
+
+static GString *
+control_connection_stop_process(ControlConnection *conn, GString *command)
 {
   GString *result = g_string_new("OK Shutdown initiated");
   main_loop_exit();
@@ -121,19 +329,91 @@ control_connection_stop_process(GString *command)
 }
 
 static GString *
-control_connection_reload(GString *command)
+control_connection_reload(ControlConnection *conn, GString *command)
 {
   GString *result = g_string_new("OK Config reload initiated");
   main_loop_reload_config();
   return result;
 }
 
+typedef struct _HandoverState
+{
+  ControlConnection *conn;
+  gint sent;
+  gint failed;
+} HandoverState;
+
+static void
+_send_handover_fd(gpointer key, gpointer value, gpointer user_data)
+{
+  HandoverState *state = (HandoverState *) user_data;
+  gint fd = GPOINTER_TO_UINT(value) - 1;
+
+  if (control_connection_send_fd(state->conn, (const gchar *) key, fd))
+    state->sent++;
+  else
+    state->failed++;
+}
+
+static GString *
+control_connection_handover(ControlConnection *conn, GString *command)
+{
+  HandoverState state = { conn, 0, 0 };
+  GString *result = g_string_sized_new(64);
+
+  if (!conn)
+    {
+      g_string_assign(result, "FAIL HANDOVER needs a connection to pass fds on");
+      return result;
+    }
+
+  if (handover_fds)
+    g_hash_table_foreach(handover_fds, _send_handover_fd, &state);
+  msg_notice("Listener fds passed to a successor process",
+             evt_tag_int("count", state.sent),
+             evt_tag_int("failed", state.failed),
+             NULL);
+  g_string_printf(result, "OK HANDOVER %d fds passed", state.sent);
+  return result;
+}
+
+static void
+control_fetch_handover_fd(const gchar *name, gint fd, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  msg_verbose("Received handed over listener fd",
+              evt_tag_str("name", name),
+              evt_tag_int("fd", fd),
+              NULL);
+  control_register_handover_fd(name, fd);
+  (*count)++;
+}
+
+gboolean
+control_fetch_handover_fds(const gchar *control_name)
+{
+  gint count = 0;
+
+  if (!control_client_receive_handover_fds(control_name, control_fetch_handover_fd, &count))
+    return FALSE;
+  msg_notice("Listener fds handed over from the running instance",
+             evt_tag_int("count", count),
+             NULL);
+  return TRUE;
+}
+
 ControlCommand default_commands[] = {
   { "STATS", NULL, control_connection_send_stats },
+  { "SHOW_QUEUES", NULL, control_connection_show_queues },
   { "RESET_STATS", NULL, control_connection_reset_stats },
   { "LOG", NULL, control_connection_message_log },
+  { "TAP", NULL, control_connection_tap },
   { "STOP", NULL, control_connection_stop_process },
   { "RELOAD", NULL, control_connection_reload },
+  { "HANDOVER", NULL, control_connection_handover },
+  { "PROFILE", NULL, control_connection_profile },
+  { "CONFIG_PROFILE", NULL, control_connection_config_profile },
   { NULL, NULL, NULL },
 };
 
@@ -162,4 +442,10 @@ void
 control_destroy(void)
 {
   control_server_free(control_server);
+  if (handover_fds)
+    {
+      /* the registered fds are owned by their drivers, only the names are ours */
+      g_hash_table_destroy(handover_fds);
+      handover_fds = NULL;
+    }
 }
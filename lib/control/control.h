@@ -27,10 +27,25 @@
 
 #include "syslog-ng.h"
 
-typedef GString* (*CommandFunction)(GString *);
+struct _ControlConnection;
+
+/* NOTE: commands either return the complete reply, or return NULL after
+ * installing a response generator on @conn that streams the reply in
+ * chunks as the output buffer drains.  @conn is NULL when the command is
+ * invoked without a connection (unit tests), in which case the complete
+ * reply must be returned. */
+typedef GString* (*CommandFunction)(struct _ControlConnection *conn, GString *command);
 
 void  control_init(const gchar *control_name);
 void control_destroy(void);
 void control_register_command(const gchar *command_name, const gchar *description, CommandFunction function);
 
+/* registry of live listening fds that a successor process can fetch over
+ * the control socket (HANDOVER command, --handover option); the names are
+ * the same persist names the fds are stored under across reloads */
+void control_register_handover_fd(const gchar *name, gint fd);
+void control_unregister_handover_fd(const gchar *name);
+gint control_lookup_handover_fd(const gchar *name);
+gboolean control_fetch_handover_fds(const gchar *control_name);
+
 #endif
@@ -12,12 +12,12 @@ test_log()
   GString *reply;
 
   g_string_assign(command,"LOG");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "Invalid arguments received, expected at least one argument", "Bad reply");
   g_string_free(reply, TRUE);
 
   g_string_assign(command,"LOG fakelog");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "Invalid arguments received", "Bad reply");
   g_string_free(reply, TRUE);
 
@@ -25,18 +25,18 @@ test_log()
   debug_flag = 1;
   trace_flag = 1;
   g_string_assign(command,"LOG VERBOSE");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "VERBOSE=0", "Bad reply");
   g_string_free(reply, TRUE);
 
   g_string_assign(command,"LOG VERBOSE ON");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "OK", "Bad reply");
   assert_gint(verbose_flag,1,"Flag isn't changed");
   g_string_free(reply, TRUE);
 
   g_string_assign(command,"LOG VERBOSE OFF");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "OK", "Bad reply");
   assert_gint(verbose_flag,0,"Flag isn't changed");
   g_string_free(reply, TRUE);
@@ -45,7 +45,7 @@ test_log()
   verbose_flag = 1;
   trace_flag = 1;
   g_string_assign(command,"LOG DEBUG");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "DEBUG=0", "Bad reply");
   g_string_free(reply, TRUE);
 
@@ -53,7 +53,7 @@ test_log()
   verbose_flag = 1;
   debug_flag = 1;
   g_string_assign(command,"LOG TRACE");
-  reply = control_connection_message_log(command);
+  reply = control_connection_message_log(NULL, command);
   assert_string(reply->str, "TRACE=0", "Bad reply");
   g_string_free(reply, TRUE);
 
@@ -76,7 +76,7 @@ test_stats()
 
   g_string_assign(command,"STATS");
 
-  reply = control_connection_send_stats(command);
+  reply = control_connection_send_stats(NULL, command);
   stats_result = g_strsplit(reply->str, "\n", 2);
   assert_string(stats_result[0], "SourceName;SourceId;SourceInstance;State;Type;Number",
                 "Bad reply");
@@ -102,12 +102,12 @@ test_reset_stats()
   stats_unlock();
 
   g_string_assign(command, "RESET_STATS");
-  reply = control_connection_reset_stats(command);
+  reply = control_connection_reset_stats(NULL, command);
   assert_string(reply->str, "The statistics of syslog-ng have been reset to 0.", "Bad reply");
   g_string_free(reply, TRUE);
 
   g_string_assign(command, "STATS");
-  reply = control_connection_send_stats(command);
+  reply = control_connection_send_stats(NULL, command);
   assert_string(reply->str, "SourceName;SourceId;SourceInstance;State;Type;Number\ncenter;id;received;a;processed;0\n", "Bad reply");
   g_string_free(reply, TRUE);
 
@@ -111,7 +111,7 @@ control_connection_moc_new(ControlServer *server)
 }
 
 GString *
-test_command(GString *command)
+test_command(ControlConnection *conn, GString *command)
 {
   assert_string(command->str,"test command", "Bad command handling");
   return g_string_new("OK");
@@ -123,6 +123,31 @@ ControlCommand command = {
    .func = test_command
 };
 
+static gint streamed_chunks;
+
+static gboolean
+test_streaming_generator(ControlConnection *conn)
+{
+  g_string_append_printf(conn->output_buffer, "chunk%d\n", streamed_chunks);
+  streamed_chunks++;
+  return streamed_chunks < 3;
+}
+
+GString *
+test_streaming_command(ControlConnection *conn, GString *command)
+{
+  assert_string(command->str, "stream command", "Bad command handling");
+  streamed_chunks = 0;
+  control_connection_set_response_generator(conn, test_streaming_generator, NULL, NULL);
+  return NULL;
+}
+
+ControlCommand streaming_command = {
+   .command_name = "stream",
+   .description = NULL,
+   .func = test_streaming_command
+};
+
 void
 control_connection_update_watches(ControlConnection *s)
 {
@@ -169,18 +194,30 @@ test_control_connection(gsize transaction_size)
   assert_string(result_string->str, "OK\n.\n", "BAD Behaviour transaction_size: %d",transaction_size);
 }
 
+void
+test_control_connection_streaming(void)
+{
+  moc_connection = (ControlConnectionMoc *)control_connection_moc_new(&moc_server);
+  g_string_assign(moc_connection->source_buffer->buffer,"stream command\n");
+  control_connection_start_watches((ControlConnection *)moc_connection);
+  assert_string(result_string->str, "chunk0\nchunk1\nchunk2\n.\n", "BAD streamed reply");
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
   GList *commands = g_list_append(NULL, &command);
-  moc_server.control_commands = commands;
   gsize  i = 0;
-  
+
+  commands = g_list_append(commands, &streaming_command);
+  moc_server.control_commands = commands;
+
   app_startup();
   for (i = 0; i < 100; i++)
     {
       test_control_connection(i);
     }
+  test_control_connection_streaming();
   app_shutdown();
   g_list_free(commands);
   return 0;
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * A production-safe message tap: unlike the interactive debugger that
+ * stops the pipeline at breakpoints, the tap copies a bounded sample of
+ * the messages passing a given LogPipe into a fixed size buffer, which is
+ * then drained by "syslog-ng-ctl" over the control socket.  The hot path
+ * never blocks: if the buffer is full or momentarily contended, the
+ * sample is counted as dropped and the message flows on untouched.
+ */
+
+#include "debugger/tap.h"
+#include "logpipe.h"
+#include "logmsg.h"
+#include "cfg.h"
+#include "cfg-tree.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define MSG_TAP_RING_SLOTS 256
+#define MSG_TAP_RECORD_SIZE 1024
+
+typedef struct _MsgTapSlot
+{
+  guint32 len;
+  gchar record[MSG_TAP_RECORD_SIZE];
+} MsgTapSlot;
+
+static LogPipe *tap_pipe;
+static gint tap_sample_freq = 1;
+static gint tap_record_bytes = MSG_TAP_RECORD_SIZE;
+/* racy per-thread increments only shift which message gets sampled */
+static gint tap_sample_counter;
+static guint64 tap_dropped;
+static GStaticMutex tap_lock = G_STATIC_MUTEX_INIT;
+static MsgTapSlot tap_ring[MSG_TAP_RING_SLOTS];
+static gint tap_ring_count;
+
+static gsize
+_append(gchar *buf, gsize pos, gsize limit, const gchar *value, gssize len)
+{
+  if (len < 0)
+    len = strlen(value);
+  if (pos + len > limit)
+    len = limit - pos;
+  memcpy(buf + pos, value, len);
+  return pos + len;
+}
+
+static void
+msg_tap_record(LogMessage *msg)
+{
+  MsgTapSlot *slot;
+  const gchar *value;
+  gssize value_len;
+  gchar pri[8];
+  gsize pos = 0;
+
+  /* never block the message path: a contended lock or a full buffer just
+   * drops the sample */
+  if (!g_static_mutex_trylock(&tap_lock))
+    {
+      tap_dropped++;
+      return;
+    }
+  if (tap_ring_count >= MSG_TAP_RING_SLOTS)
+    {
+      tap_dropped++;
+      g_static_mutex_unlock(&tap_lock);
+      return;
+    }
+  slot = &tap_ring[tap_ring_count];
+
+  g_snprintf(pri, sizeof(pri), "<%d>", msg->pri);
+  pos = _append(slot->record, pos, tap_record_bytes, pri, -1);
+  value = log_msg_get_value(msg, LM_V_HOST, &value_len);
+  pos = _append(slot->record, pos, tap_record_bytes, value, value_len);
+  pos = _append(slot->record, pos, tap_record_bytes, " ", 1);
+  value = log_msg_get_value(msg, LM_V_PROGRAM, &value_len);
+  pos = _append(slot->record, pos, tap_record_bytes, value, value_len);
+  pos = _append(slot->record, pos, tap_record_bytes, ": ", 2);
+  value = log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
+  pos = _append(slot->record, pos, tap_record_bytes, value, value_len);
+  slot->len = pos;
+
+  tap_ring_count++;
+  g_static_mutex_unlock(&tap_lock);
+}
+
+static gboolean
+msg_tap_hook(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (G_UNLIKELY(s == tap_pipe))
+    {
+      if ((tap_sample_counter++ % tap_sample_freq) == 0)
+        msg_tap_record(msg);
+    }
+  return TRUE;
+}
+
+gboolean
+msg_tap_start(GlobalConfig *cfg, const gchar *location, gint sample_freq, gint max_record_bytes, GString *result)
+{
+  gint i;
+
+  if (tap_pipe)
+    {
+      g_string_assign(result, "FAIL A tap is already active, stop it first");
+      return FALSE;
+    }
+  if (pipe_single_step_hook)
+    {
+      g_string_assign(result, "FAIL The single step hook is in use (interactive debugger?)");
+      return FALSE;
+    }
+
+  for (i = 0; i < cfg->tree.initialized_pipes->len; i++)
+    {
+      LogPipe *pipe = g_ptr_array_index(cfg->tree.initialized_pipes, i);
+      gchar buf[128];
+
+      if (!pipe->expr_node)
+        continue;
+      if (strcmp(log_expr_node_format_location(pipe->expr_node, buf, sizeof(buf)), location) == 0)
+        {
+          tap_pipe = log_pipe_ref(pipe);
+          break;
+        }
+    }
+  if (!tap_pipe)
+    {
+      g_string_printf(result, "FAIL No pipe found at location %s", location);
+      return FALSE;
+    }
+
+  tap_sample_freq = sample_freq < 1 ? 1 : sample_freq;
+  tap_record_bytes = max_record_bytes;
+  if (tap_record_bytes < 64 || tap_record_bytes > MSG_TAP_RECORD_SIZE)
+    tap_record_bytes = MSG_TAP_RECORD_SIZE;
+  tap_sample_counter = 0;
+  tap_ring_count = 0;
+  tap_dropped = 0;
+  pipe_single_step_hook = msg_tap_hook;
+
+  g_string_printf(result, "OK Tap attached, sampling 1 in %d messages, %d bytes each", tap_sample_freq, tap_record_bytes);
+  return TRUE;
+}
+
+void
+msg_tap_fetch(GString *result)
+{
+  gint i;
+
+  if (!tap_pipe)
+    {
+      g_string_assign(result, "FAIL No tap is active");
+      return;
+    }
+
+  g_static_mutex_lock(&tap_lock);
+  g_string_printf(result, "OK %d sampled, %" G_GUINT64_FORMAT " dropped\n", tap_ring_count, tap_dropped);
+  for (i = 0; i < tap_ring_count; i++)
+    {
+      g_string_append_len(result, tap_ring[i].record, tap_ring[i].len);
+      g_string_append_c(result, '\n');
+    }
+  tap_ring_count = 0;
+  g_static_mutex_unlock(&tap_lock);
+}
+
+void
+msg_tap_stop(GString *result)
+{
+  if (!tap_pipe)
+    {
+      g_string_assign(result, "FAIL No tap is active");
+      return;
+    }
+
+  pipe_single_step_hook = NULL;
+  /* NOTE: worker threads may still be executing the hook, but it only
+   * compares the pipe pointer and takes the trylock, both of which remain
+   * valid until the pipe reference below is dropped */
+  log_pipe_unref(tap_pipe);
+  tap_pipe = NULL;
+  g_string_assign(result, "OK Tap detached");
+}
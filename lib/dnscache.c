@@ -26,6 +26,7 @@
 #include "messages.h"
 #include "timeutils.h"
 #include "tls-support.h"
+#include "fasthash.h"
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -61,6 +62,11 @@ struct _DNSCacheEntry
   gsize hostname_len;
   /* whether this entry is a positive (successful DNS lookup) or negative (failed DNS lookup, contains an IP address) match */
   gboolean positive;
+  /* lazily memoized transformed forms of @hostname (see
+   * dns_cache_lookup_applied()); only ever filled on thread-local
+   * entries, so no locking is needed */
+  gchar *applied[DNS_CACHE_MAX_APPLIED_VARIANTS];
+  gsize applied_len[DNS_CACHE_MAX_APPLIED_VARIANTS];
 };
 
 
@@ -71,7 +77,7 @@ TLS_BLOCK_START
   DNSCacheEntry cache_last;
   DNSCacheEntry persist_first;
   DNSCacheEntry persist_last;
-  time_t cache_hosts_mtime;
+  guint cache_hosts_generation;
   time_t cache_hosts_checktime;
 }
 TLS_BLOCK_END;
@@ -81,7 +87,7 @@ TLS_BLOCK_END;
 #define cache_last __tls_deref(cache_last)
 #define persist_first __tls_deref(persist_first)
 #define persist_last __tls_deref(persist_last)
-#define cache_hosts_mtime __tls_deref(cache_hosts_mtime)
+#define cache_hosts_generation __tls_deref(cache_hosts_generation)
 #define cache_hosts_checktime __tls_deref(cache_hosts_checktime)
 
 static gint dns_cache_size = 1007;
@@ -90,6 +96,53 @@ static gint dns_cache_expire_failed = 60;
 static gint dns_cache_persistent_count = 0;
 static gchar *dns_cache_hosts = NULL;
 
+/* process-wide snapshot of the parsed hosts() file.  The text file is
+ * parsed once, by whichever thread first notices a new mtime, without
+ * holding the snapshot lock; every other thread keeps serving from its
+ * previous persistent entries (or the regular miss path) until the new
+ * generation is published and then bulk copies the pre-parsed entries
+ * instead of re-reading the text itself.  With large hosts files the
+ * per-thread parse used to stall the first message of every worker. */
+
+typedef struct _DNSCacheHostsEntry
+{
+  DNSCacheKey key;
+  gchar *hostname;
+} DNSCacheHostsEntry;
+
+static GStaticMutex dns_cache_hosts_lock = G_STATIC_MUTEX_INIT;
+static GPtrArray *dns_cache_hosts_entries = NULL;
+static guint dns_cache_hosts_current_generation = 0;
+static gboolean dns_cache_hosts_loading = FALSE;
+static time_t dns_cache_hosts_mtime = -1;
+
+/* Process-wide, sharded second level cache behind the thread-local ones.
+ * A thread that misses locally consults the shard under a short per-shard
+ * lock and copies a hit into its own cache, so the pointers returned by
+ * dns_cache_lookup() are always owned by the calling thread.  Lookups
+ * that miss here too register an in-flight marker, making concurrent
+ * lookups for the same address wait for the single resolver call instead
+ * of all hitting the DNS server at once. */
+
+#define DNS_CACHE_SHARDS 16
+
+typedef struct _DNSCacheFlight
+{
+  DNSCacheKey key;
+  GThread *owner;
+} DNSCacheFlight;
+
+typedef struct _DNSCacheShard
+{
+  GMutex *lock;
+  GCond *flight_cond;
+  GHashTable *cache;
+  GHashTable *flights;
+  DNSCacheEntry first, last;
+} DNSCacheShard;
+
+static DNSCacheShard dns_cache_shards[DNS_CACHE_SHARDS];
+
 static gboolean
 dns_cache_key_equal(DNSCacheKey *e1, DNSCacheKey *e2)
 {
@@ -108,15 +161,17 @@ dns_cache_key_equal(DNSCacheKey *e1, DNSCacheKey *e2)
 static guint
 dns_cache_key_hash(DNSCacheKey *e)
 {
+  /* hash the raw address bytes: sequentially allocated addresses would
+   * cluster in the same shards/buckets if the address value was used
+   * directly */
   if (e->family == AF_INET)
     {
-      return ntohl(e->addr.ip.s_addr);
+      return fast_hash(&e->addr.ip.s_addr, sizeof(e->addr.ip.s_addr));
     }
 #if SYSLOG_NG_ENABLE_IPV6
   else if (e->family == AF_INET6)
     {
-      guint32 *a32 = (guint32 *) &e->addr.ip6.s6_addr;
-      return (0x80000000 | (a32[0] ^ a32[1] ^ a32[2] ^ a32[3]));
+      return 0x80000000 | fast_hash(&e->addr.ip6.s6_addr, sizeof(e->addr.ip6.s6_addr));
     }
 #endif
   else
@@ -138,9 +193,13 @@ dns_cache_entry_insert_before(DNSCacheEntry *elem, DNSCacheEntry *new_elem)
 static void
 dns_cache_entry_free(DNSCacheEntry *e)
 {
+  gint i;
+
   e->prev->next = e->next;
   e->next->prev = e->prev;
 
+  for (i = 0; i < DNS_CACHE_MAX_APPLIED_VARIANTS; i++)
+    g_free(e->applied[i]);
   g_free(e->hostname);
   g_free(e);
 }
@@ -165,6 +224,27 @@ dns_cache_fill_key(DNSCacheKey *key, gint family, void *addr)
     }
 }
 
+static inline DNSCacheShard *
+dns_cache_get_shard(DNSCacheKey *key)
+{
+  return &dns_cache_shards[dns_cache_key_hash(key) % DNS_CACHE_SHARDS];
+}
+
+static inline gboolean
+dns_cache_entry_is_valid(DNSCacheEntry *entry, time_t now)
+{
+  if (entry->resolved &&
+      ((entry->positive && entry->resolved < now - dns_cache_expire) ||
+       (!entry->positive && entry->resolved < now - dns_cache_expire_failed)))
+    {
+      /* the entry is not persistent and is too old */
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static DNSCacheEntry *dns_cache_store_local(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved);
+
 static void
 dns_cache_cleanup_persistent_hosts(void)
 {
@@ -175,6 +255,88 @@ dns_cache_cleanup_persistent_hosts(void)
     }
 }
 
+static void
+dns_cache_hosts_entries_free(GPtrArray *entries)
+{
+  guint i;
+
+  for (i = 0; i < entries->len; i++)
+    {
+      DNSCacheHostsEntry *e = (DNSCacheHostsEntry *) g_ptr_array_index(entries, i);
+
+      g_free(e->hostname);
+      g_free(e);
+    }
+  g_ptr_array_free(entries, TRUE);
+}
+
+static GPtrArray *
+dns_cache_hosts_parse(const gchar *filename)
+{
+  GPtrArray *entries = g_ptr_array_new();
+  FILE *hosts;
+
+  hosts = fopen(filename, "r");
+  if (hosts)
+    {
+      gchar buf[4096];
+      char *strtok_saveptr;
+
+      while (fgets(buf, sizeof(buf), hosts))
+        {
+          DNSCacheHostsEntry *e;
+          gchar *p, *ip;
+          gint len;
+          gint family;
+          union
+          {
+            struct in_addr ip4;
+#if SYSLOG_NG_ENABLE_IPV6
+            struct in6_addr ip6;
+#endif
+          } ia;
+
+          if (buf[0] == 0 || buf[0] == '\n' || buf[0] == '#')
+            continue;
+
+          len = strlen(buf);
+          if (buf[len - 1] == '\n')
+            buf[len-1] = 0;
+
+          p = strtok_r(buf, " \t", &strtok_saveptr);
+          if (!p)
+            continue;
+          ip = p;
+
+#if SYSLOG_NG_ENABLE_IPV6
+          if (strchr(ip, ':') != NULL)
+            family = AF_INET6;
+          else
+#endif
+            family = AF_INET;
+
+          p = strtok_r(NULL, " \t", &strtok_saveptr);
+          if (!p)
+            continue;
+          inet_pton(family, ip, &ia);
+
+          e = g_new(DNSCacheHostsEntry, 1);
+          dns_cache_fill_key(&e->key, family, &ia);
+          e->hostname = g_strdup(p);
+          g_ptr_array_add(entries, e);
+        }
+      fclose(hosts);
+    }
+  else
+    {
+      msg_error("Error loading dns cache hosts file",
+                evt_tag_str("filename", filename),
+                evt_tag_errno("error", errno),
+                NULL);
+    }
+  return entries;
+}
+
 static void
 dns_cache_check_hosts(glong t)
 {
@@ -191,80 +353,87 @@ dns_cache_check_hosts(glong t)
       return;
     }
 
-  if (cache_hosts_mtime == -1 || st.st_mtime > cache_hosts_mtime)
+  g_static_mutex_lock(&dns_cache_hosts_lock);
+  if ((dns_cache_hosts_mtime == -1 || st.st_mtime > dns_cache_hosts_mtime) && !dns_cache_hosts_loading)
+    {
+      GPtrArray *entries;
+
+      /* this thread parses the file, everybody else keeps serving from
+       * the previous snapshot until the new one is published */
+      dns_cache_hosts_loading = TRUE;
+      dns_cache_hosts_mtime = st.st_mtime;
+      g_static_mutex_unlock(&dns_cache_hosts_lock);
+
+      entries = dns_cache_hosts_parse(dns_cache_hosts);
+
+      g_static_mutex_lock(&dns_cache_hosts_lock);
+      if (dns_cache_hosts_entries)
+        dns_cache_hosts_entries_free(dns_cache_hosts_entries);
+      dns_cache_hosts_entries = entries;
+      dns_cache_hosts_current_generation++;
+      dns_cache_hosts_loading = FALSE;
+    }
+
+  if (cache_hosts_generation != dns_cache_hosts_current_generation && !dns_cache_hosts_loading)
     {
-      FILE *hosts;
-      cache_hosts_mtime = st.st_mtime;
+      guint i;
+
+      /* copy the pre-parsed entries into the thread-local cache; this is
+       * a bulk copy, the expensive text parse happened only once above */
       dns_cache_cleanup_persistent_hosts();
-      hosts = fopen(dns_cache_hosts, "r");
-      if (hosts)
+      for (i = 0; i < dns_cache_hosts_entries->len; i++)
         {
-          gchar buf[4096];
-          char *strtok_saveptr;
+          DNSCacheHostsEntry *e = (DNSCacheHostsEntry *) g_ptr_array_index(dns_cache_hosts_entries, i);
 
-          while (fgets(buf, sizeof(buf), hosts))
-            {
-              gchar *p, *ip;
-              gint len;
-              gint family;
-              union
-              {
-                struct in_addr ip4;
-#if SYSLOG_NG_ENABLE_IPV6
-                struct in6_addr ip6;
-#endif
-              } ia;
+          dns_cache_store_local(&e->key, e->hostname, TRUE, 0);
+        }
+      cache_hosts_generation = dns_cache_hosts_current_generation;
+    }
+  g_static_mutex_unlock(&dns_cache_hosts_lock);
+}
 
-              if (buf[0] == 0 || buf[0] == '\n' || buf[0] == '#')
-                continue;
+/* store an entry into the thread-local cache, @resolved == 0 makes the
+ * entry persistent; returns the stored entry, owned by this thread */
+static DNSCacheEntry *
+dns_cache_store_local(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved)
+{
+  DNSCacheEntry *entry;
+  guint hash_size;
 
-              len = strlen(buf);
-              if (buf[len - 1] == '\n')
-                buf[len-1] = 0;
+  entry = g_new0(DNSCacheEntry, 1);
 
-              p = strtok_r(buf, " \t", &strtok_saveptr);
-              if (!p)
-                continue;
-              ip = p;
+  entry->key = *key;
+  entry->hostname = g_strdup(hostname);
+  entry->hostname_len = strlen(hostname);
+  entry->positive = positive;
+  entry->resolved = resolved;
+  if (resolved)
+    dns_cache_entry_insert_before(&cache_last, entry);
+  else
+    dns_cache_entry_insert_before(&persist_last, entry);
 
-#if SYSLOG_NG_ENABLE_IPV6
-              if (strchr(ip, ':') != NULL)
-                family = AF_INET6;
-              else
-#endif
-                family = AF_INET;
+  hash_size = g_hash_table_size(cache);
+  g_hash_table_replace(cache, &entry->key, entry);
 
-              p = strtok_r(NULL, " \t", &strtok_saveptr);
-              if (!p)
-                continue;
-              inet_pton(family, ip, &ia);
-              dns_cache_store_persistent(family, &ia, p);
-            }
-          fclose(hosts);
-        }
-      else
-        {
-          msg_error("Error loading dns cache hosts file",
-                    evt_tag_str("filename", dns_cache_hosts),
-                    evt_tag_errno("error", errno),
-                    NULL);
-        }
+  if (!resolved && hash_size != g_hash_table_size(cache))
+    dns_cache_persistent_count++;
 
+  /* persistent elements are not counted */
+  if ((gint) (g_hash_table_size(cache) - dns_cache_persistent_count) > dns_cache_size)
+    {
+      /* remove oldest element */
+      g_hash_table_remove(cache, &cache_first.next->key);
     }
+  return entry;
 }
 
-/*
- * @hostname        is set to the stored hostname,
- * @positive        is set whether the match was a DNS match or failure
- *
- * Returns TRUE if the cache was able to serve the request (e.g. had a
- * matching entry at all).
- */
-gboolean
-dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+static DNSCacheEntry *
+dns_cache_lookup_entry(gint family, void *addr, gboolean wait_for_flight)
 {
   DNSCacheKey key;
   DNSCacheEntry *entry;
+  DNSCacheShard *shard;
+  DNSCacheFlight *flight;
   time_t now;
 
   now = cached_g_current_time_sec();
@@ -272,73 +441,186 @@ dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize *hostnam
 
   dns_cache_fill_key(&key, family, addr);
   entry = g_hash_table_lookup(cache, &key);
-  if (entry)
+  if (entry && dns_cache_entry_is_valid(entry, now))
+    return entry;
+
+  /* local miss, consult the process-wide cache */
+  shard = dns_cache_get_shard(&key);
+  g_mutex_lock(shard->lock);
+  while (1)
     {
-      if (entry->resolved &&
-          ((entry->positive && entry->resolved < now - dns_cache_expire) ||
-           (!entry->positive && entry->resolved < now - dns_cache_expire_failed)))
+      entry = g_hash_table_lookup(shard->cache, &key);
+      if (entry)
+        {
+          if (dns_cache_entry_is_valid(entry, now))
+            {
+              /* promote the hit into the thread-local cache, so the
+               * returned pointers stay valid without further locking */
+              entry = dns_cache_store_local(&key, entry->hostname, entry->positive, entry->resolved);
+              g_mutex_unlock(shard->lock);
+              return entry;
+            }
+          g_hash_table_remove(shard->cache, &key);
+        }
+
+      if (!wait_for_flight)
+        {
+          /* the caller resolves asynchronously, neither flight
+           * registration nor waiting is wanted here */
+          break;
+        }
+
+      flight = g_hash_table_lookup(shard->flights, &key);
+      if (!flight)
         {
-          /* the entry is not persistent and is too old */
+          /* this thread resolves the address, concurrent lookups wait
+           * until the result is stored */
+          flight = g_new(DNSCacheFlight, 1);
+          flight->key = key;
+          flight->owner = g_thread_self();
+          g_hash_table_insert(shard->flights, &flight->key, flight);
+          break;
+        }
+      if (flight->owner == g_thread_self())
+        {
+          /* we registered this flight earlier but never stored a result
+           * (e.g. resolving is disabled), resolve it again ourselves */
+          break;
         }
       else
         {
-          *hostname = entry->hostname;
-          *hostname_len = entry->hostname_len;
-          *positive = entry->positive;
-          return TRUE;
+          GTimeVal abs_time;
+
+          g_get_current_time(&abs_time);
+          g_time_val_add(&abs_time, G_USEC_PER_SEC);
+          if (!g_cond_timed_wait(shard->flight_cond, shard->lock, &abs_time))
+            {
+              /* the resolving thread seems to be stuck, take the flight over */
+              flight->owner = g_thread_self();
+              break;
+            }
         }
     }
-  *hostname = NULL;
-  *positive = FALSE;
-  return FALSE;
+  g_mutex_unlock(shard->lock);
+
+  return NULL;
 }
 
-static void
-dns_cache_store(gboolean persistent, gint family, void *addr, const gchar *hostname, gboolean positive)
+static gboolean
+dns_cache_fill_result(DNSCacheEntry *entry, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+{
+  if (!entry)
+    {
+      *hostname = NULL;
+      *positive = FALSE;
+      return FALSE;
+    }
+  *hostname = entry->hostname;
+  *hostname_len = entry->hostname_len;
+  *positive = entry->positive;
+  return TRUE;
+}
+
+/*
+ * @hostname        is set to the stored hostname,
+ * @positive        is set whether the match was a DNS match or failure
+ *
+ * Returns TRUE if the cache was able to serve the request (e.g. had a
+ * matching entry at all).
+ */
+gboolean
+dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+{
+  return dns_cache_fill_result(dns_cache_lookup_entry(family, addr, TRUE), hostname, hostname_len, positive);
+}
+
+/* like dns_cache_lookup() but never blocks: a miss returns immediately
+ * instead of waiting for a concurrent lookup of the same address */
+gboolean
+dns_cache_lookup_no_wait(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+{
+  return dns_cache_fill_result(dns_cache_lookup_entry(family, addr, FALSE), hostname, hostname_len, positive);
+}
+
+static gboolean
+dns_cache_lookup_applied_full(gint family, void *addr, guint variant, DNSCacheApplyHostnameFunc apply, gpointer user_data, const gchar **hostname, gsize *hostname_len, gboolean *positive, gboolean wait_for_flight)
 {
   DNSCacheEntry *entry;
-  guint hash_size;
 
-  entry = g_new(DNSCacheEntry, 1);
+  entry = dns_cache_lookup_entry(family, addr, wait_for_flight);
+  if (!entry || variant == 0)
+    return dns_cache_fill_result(entry, hostname, hostname_len, positive);
 
-  dns_cache_fill_key(&entry->key, family, addr);
-  entry->hostname = g_strdup(hostname);
-  entry->hostname_len = strlen(hostname);
-  entry->positive = positive;
-  if (!persistent)
+  g_assert(variant < DNS_CACHE_MAX_APPLIED_VARIANTS);
+  if (!entry->applied[variant])
     {
-      entry->resolved = cached_g_current_time_sec();
-      dns_cache_entry_insert_before(&cache_last, entry);
+      /* the entry is thread-local, filling the slot needs no locking */
+      entry->applied[variant] = apply(entry->hostname, entry->positive, user_data);
+      entry->applied_len[variant] = strlen(entry->applied[variant]);
     }
-  else
-    {
-      entry->resolved = 0;
-      dns_cache_entry_insert_before(&persist_last, entry);
-    }
-  hash_size = g_hash_table_size(cache);
-  g_hash_table_replace(cache, &entry->key, entry);
+  *hostname = entry->applied[variant];
+  *hostname_len = entry->applied_len[variant];
+  *positive = entry->positive;
+  return TRUE;
+}
 
-  if (persistent && hash_size != g_hash_table_size(cache))
-    dns_cache_persistent_count++;
+/* like dns_cache_lookup(), but returns the memoized transformed form of
+ * the stored hostname, computing it through @apply on the first request */
+gboolean
+dns_cache_lookup_applied(gint family, void *addr, guint variant, DNSCacheApplyHostnameFunc apply, gpointer user_data, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+{
+  return dns_cache_lookup_applied_full(family, addr, variant, apply, user_data, hostname, hostname_len, positive, TRUE);
+}
 
-  /* persistent elements are not counted */
-  if ((gint) (g_hash_table_size(cache) - dns_cache_persistent_count) > dns_cache_size)
-    {
-      /* remove oldest element */
-      g_hash_table_remove(cache, &cache_first.next->key);
-    }
+gboolean
+dns_cache_lookup_applied_no_wait(gint family, void *addr, guint variant, DNSCacheApplyHostnameFunc apply, gpointer user_data, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+{
+  return dns_cache_lookup_applied_full(family, addr, variant, apply, user_data, hostname, hostname_len, positive, FALSE);
 }
 
 void
 dns_cache_store_persistent(gint family, void *addr, const gchar *hostname)
 {
-  dns_cache_store(TRUE, family, addr, hostname, TRUE);
+  DNSCacheKey key;
+
+  dns_cache_fill_key(&key, family, addr);
+  dns_cache_store_local(&key, hostname, TRUE, 0);
 }
 
 void
 dns_cache_store_dynamic(gint family, void *addr, const gchar *hostname, gboolean positive)
 {
-  dns_cache_store(FALSE, family, addr, hostname, positive);
+  DNSCacheKey key;
+  DNSCacheEntry *entry;
+  DNSCacheShard *shard;
+  time_t now;
+
+  now = cached_g_current_time_sec();
+  dns_cache_fill_key(&key, family, addr);
+  dns_cache_store_local(&key, hostname, positive, now);
+
+  /* publish the result and wake up lookups waiting for this address */
+  shard = dns_cache_get_shard(&key);
+  g_mutex_lock(shard->lock);
+
+  entry = g_new0(DNSCacheEntry, 1);
+  entry->key = key;
+  entry->hostname = g_strdup(hostname);
+  entry->hostname_len = strlen(hostname);
+  entry->positive = positive;
+  entry->resolved = now;
+  dns_cache_entry_insert_before(&shard->last, entry);
+  g_hash_table_replace(shard->cache, &entry->key, entry);
+
+  if ((gint) g_hash_table_size(shard->cache) > dns_cache_size / DNS_CACHE_SHARDS + 1)
+    {
+      /* remove oldest element */
+      g_hash_table_remove(shard->cache, &shard->first.next->key);
+    }
+
+  if (g_hash_table_remove(shard->flights, &key))
+    g_cond_broadcast(shard->flight_cond);
+  g_mutex_unlock(shard->lock);
 }
 
 void
@@ -362,7 +644,7 @@ dns_cache_thread_init(void)
   cache_first.prev = NULL;
   cache_last.prev = &cache_first;
   cache_last.next = NULL;
-  cache_hosts_mtime = -1;
+  cache_hosts_generation = 0;
   cache_hosts_checktime = 0;
 
   persist_first.next = &persist_last;
@@ -382,15 +664,54 @@ dns_cache_thread_deinit(void)
 void
 dns_cache_global_init(void)
 {
+  gint i;
+
   dns_cache_size = 1007;
   dns_cache_expire = 3600;
   dns_cache_expire_failed = 60;
   dns_cache_persistent_count = 0;
+  dns_cache_hosts_mtime = -1;
+  dns_cache_hosts_current_generation = 0;
+  dns_cache_hosts_loading = FALSE;
+
+  for (i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      shard->lock = g_mutex_new();
+      shard->flight_cond = g_cond_new();
+      shard->cache = g_hash_table_new_full((GHashFunc) dns_cache_key_hash, (GEqualFunc) dns_cache_key_equal, NULL, (GDestroyNotify) dns_cache_entry_free);
+      shard->flights = g_hash_table_new_full((GHashFunc) dns_cache_key_hash, (GEqualFunc) dns_cache_key_equal, NULL, g_free);
+      shard->first.next = &shard->last;
+      shard->first.prev = NULL;
+      shard->last.prev = &shard->first;
+      shard->last.next = NULL;
+    }
 }
 
 void
 dns_cache_global_deinit(void)
 {
+  gint i;
+
+  for (i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_hash_table_destroy(shard->cache);
+      g_hash_table_destroy(shard->flights);
+      g_cond_free(shard->flight_cond);
+      g_mutex_free(shard->lock);
+      shard->cache = NULL;
+      shard->flights = NULL;
+      shard->flight_cond = NULL;
+      shard->lock = NULL;
+    }
+
+  if (dns_cache_hosts_entries)
+    dns_cache_hosts_entries_free(dns_cache_hosts_entries);
+  dns_cache_hosts_entries = NULL;
+
   if (dns_cache_hosts)
     g_free(dns_cache_hosts);
   dns_cache_hosts = NULL;
@@ -29,6 +29,21 @@
 #include "syslog-ng.h"
 
 gboolean dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive);
+gboolean dns_cache_lookup_no_wait(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive);
+
+/* The caller may memoize a transformed (e.g. shortened and/or lowercased)
+ * form of the cached hostname on the cache entry itself, so the
+ * transformation runs once per distinct address instead of once per
+ * message.  @variant identifies the transformation the caller wants
+ * (variant 0 is the identity and returns the stored hostname itself),
+ * @apply produces the transformed form, in a newly allocated string, the
+ * first time the given variant is requested for an entry. */
+#define DNS_CACHE_MAX_APPLIED_VARIANTS 4
+
+typedef gchar *(*DNSCacheApplyHostnameFunc)(const gchar *hostname, gboolean positive, gpointer user_data);
+
+gboolean dns_cache_lookup_applied(gint family, void *addr, guint variant, DNSCacheApplyHostnameFunc apply, gpointer user_data, const gchar **hostname, gsize *hostname_len, gboolean *positive);
+gboolean dns_cache_lookup_applied_no_wait(gint family, void *addr, guint variant, DNSCacheApplyHostnameFunc apply, gpointer user_data, const gchar **hostname, gsize *hostname_len, gboolean *positive);
 
 void dns_cache_store_persistent(gint family, void *addr, const gchar *hostname);
 void dns_cache_store_dynamic(gint family, void *addr, const gchar *hostname, gboolean positive);
@@ -24,8 +24,10 @@
   
 #include "driver.h"
 #include "logqueue-fifo.h"
+#include "logqueue-disk.h"
 #include "afinter.h"
 #include "cfg-tree.h"
+#include "reloc.h"
 
 #include <string.h>
 
@@ -188,6 +190,27 @@ log_src_driver_free(LogPipe *s)
 
 /* LogDestDriver */
 
+/* the spill file lives next to the persist file and is named after the
+ * queue's persist name, so it stays associated with this driver across
+ * restarts; slashes (file destinations embed their path in the persist
+ * name) are flattened to keep it a single path component */
+static gchar *
+log_dest_driver_format_disk_queue_filename(const gchar *persist_name)
+{
+  gchar *base = g_strdup(persist_name);
+  gchar *filename;
+  gchar *p;
+
+  for (p = base; *p; p++)
+    {
+      if (*p == '/')
+        *p = '_';
+    }
+  filename = g_strdup_printf("%s/%s.qf", get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR), base);
+  g_free(base);
+  return filename;
+}
+
 /* returns a reference */
 static LogQueue *
 log_dest_driver_acquire_queue_method(LogDestDriver *self, gchar *persist_name, gpointer user_data)
@@ -200,11 +223,28 @@ log_dest_driver_acquire_queue_method(LogDestDriver *self, gchar *persist_name, g
   if (persist_name)
     queue = cfg_persist_config_fetch(cfg, persist_name);
 
+  if (!queue && self->log_disk_fifo_size > 0 && persist_name)
+    {
+      gchar *filename = log_dest_driver_format_disk_queue_filename(persist_name);
+
+      queue = log_queue_disk_new(self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size,
+                                 self->log_disk_fifo_size, filename, persist_name);
+      g_free(filename);
+      /* ring positions live in the persist file, the same way file
+       * sources store their read position */
+      if (queue && cfg->state)
+        log_queue_load_state(queue, cfg->state);
+    }
+
   if (!queue)
     {
+      /* no disk based queue was requested, or creating one failed and
+       * falling back to a memory fifo beats dropping everything */
       queue = log_queue_fifo_new(self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size, persist_name);
-      log_queue_set_throttle(queue, self->throttle);
+      if (self->prio_tag)
+        log_queue_fifo_set_prio_tag(queue, self->prio_tag);
     }
+  log_queue_set_throttle(queue, self->throttle);
   return queue;
 }
 
@@ -214,6 +254,11 @@ log_dest_driver_release_queue_method(LogDestDriver *self, LogQueue *q, gpointer
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super);
 
+  /* flush the disk ring positions of disk backed queues; the persist
+   * file itself is committed by the main loop */
+  if (cfg->state)
+    log_queue_save_state(q, cfg->state);
+
   /* we only save the LogQueue instance if it contains data */
   if (q->persist_name && log_queue_keep_on_reload(q) > 0)
     {
@@ -297,7 +342,76 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->acquire_queue = log_dest_driver_acquire_queue_method;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_disk_fifo_size = 0;
   self->throttle = 0;
+  self->prio_tag = NULL;
+}
+
+/* Reconnect backoff & storm damping */
+
+/* cap the exponential backoff at 16 * time_reopen() */
+#define RECONNECT_BACKOFF_MAX_SHIFT 4
+
+/* upper bound on the number of reconnect attempts in flight in the whole
+ * process; everyone else waits for a slot with a short random delay */
+#define RECONNECT_MAX_CONCURRENT 8
+
+static GStaticMutex reconnect_slot_lock = G_STATIC_MUTEX_INIT;
+static gint reconnect_slots_used;
+
+/* record a failed attempt and return the delay until the next one. The
+ * delay doubles with each consecutive failure up to the cap, and the
+ * upper half of it is random ("equal jitter"), so the first retry still
+ * happens within time_reopen() but drivers that lost the same
+ * destination in the same instant drift apart instead of hammering it
+ * in lockstep. */
+glong
+log_driver_reconnect_next_delay_msec(LogDriverReconnect *self, gint time_reopen)
+{
+  glong base;
+
+  base = (glong) time_reopen * 1000L << MIN(self->failures, RECONNECT_BACKOFF_MAX_SHIFT);
+  if (self->failures < G_MAXINT)
+    self->failures++;
+  return base / 2 + g_random_int_range(1, MAX(base / 2, 2));
+}
+
+void
+log_driver_reconnect_reset(LogDriverReconnect *self)
+{
+  self->failures = 0;
+}
+
+gboolean
+log_driver_reconnect_slot_acquire(void)
+{
+  gboolean acquired = FALSE;
+
+  g_static_mutex_lock(&reconnect_slot_lock);
+  if (reconnect_slots_used < RECONNECT_MAX_CONCURRENT)
+    {
+      reconnect_slots_used++;
+      acquired = TRUE;
+    }
+  g_static_mutex_unlock(&reconnect_slot_lock);
+  return acquired;
+}
+
+void
+log_driver_reconnect_slot_release(void)
+{
+  g_static_mutex_lock(&reconnect_slot_lock);
+  g_assert(reconnect_slots_used > 0);
+  reconnect_slots_used--;
+  g_static_mutex_unlock(&reconnect_slot_lock);
+}
+
+/* how long to wait before re-checking for a free reconnect slot; random
+ * so the waiters don't all wake up at once either */
+glong
+log_driver_reconnect_slot_retry_msec(void)
+{
+  return g_random_int_range(100, 1000);
 }
 
 void
@@ -311,5 +425,6 @@ log_dest_driver_free(LogPipe *s)
       log_queue_unref((LogQueue *) l->data);
     }
   g_list_free(self->queues);
+  g_free(self->prio_tag);
   log_driver_free(s);
 }
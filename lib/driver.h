@@ -160,7 +160,14 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  /* when set, the destination queue is backed by an on-disk ring of this
+   * many bytes that messages spill into once the in-memory window runs
+   * full, see log-disk-fifo-size(); 0 keeps the plain memory fifo */
+  gint64 log_disk_fifo_size;
   gint throttle;
+  /* when set, messages carrying this tag take the low-latency lane of
+   * the destination fifo (see log_queue_fifo_set_prio_tag) */
+  gchar *prio_tag;
   StatsCounterItem *queued_global_messages;
 };
 
@@ -200,5 +207,36 @@ void log_dest_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOpti
 void log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg);
 void log_dest_driver_free(LogPipe *s);
 
+/* Reconnect backoff & storm damping
+ * =================================
+ *
+ * time_reopen() is a fixed delay, so when a destination goes down every
+ * driver pointed at it retries on the same cadence, and when it comes
+ * back all of them reconnect in the same instant.  These helpers let
+ * reconnect scheduling
+ *
+ *   - grow the retry delay exponentially (with jitter) while a
+ *     destination keeps failing, embedding a LogDriverReconnect in
+ *     whatever object drives the retry timer, and
+ *
+ *   - bound the number of reconnect attempts in flight across the whole
+ *     process, so a recovering destination is not stampeded; callers
+ *     that do not get a slot re-arm their timer with
+ *     log_driver_reconnect_slot_retry_msec() and try again shortly.
+ */
+
+typedef struct _LogDriverReconnect
+{
+  /* consecutive failed reconnect attempts since the last working connection */
+  gint failures;
+} LogDriverReconnect;
+
+glong log_driver_reconnect_next_delay_msec(LogDriverReconnect *self, gint time_reopen);
+void log_driver_reconnect_reset(LogDriverReconnect *self);
+
+gboolean log_driver_reconnect_slot_acquire(void);
+void log_driver_reconnect_slot_release(void);
+glong log_driver_reconnect_slot_retry_msec(void);
+
 
 #endif
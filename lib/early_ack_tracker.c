@@ -61,11 +61,18 @@ early_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_typ
 {
   EarlyAckTracker *self = (EarlyAckTracker *)s;
 
-  log_source_flow_control_adjust(self->super.source, 1);
+  if (!ack_tracker_batch_collect(s, ack_type))
+    log_source_flow_control_adjust(self->super.source, 1);
   log_msg_unref(msg);
   log_pipe_unref((LogPipe *)self->super.source);
 }
 
+static void
+early_ack_tracker_batch_flush(AckTracker *s, gint count, AckType ack_type)
+{
+  log_source_flow_control_adjust(s->source, count);
+}
+
 static void
 early_ack_tracker_init_instance(EarlyAckTracker *self, LogSource *source)
 {
@@ -75,6 +82,7 @@ early_ack_tracker_init_instance(EarlyAckTracker *self, LogSource *source)
   self->super.request_bookmark = early_ack_tracker_request_bookmark;
   self->super.track_msg = early_ack_tracker_track_msg;
   self->super.manage_msg_ack = early_ack_tracker_manage_msg_ack;
+  self->super.batch_flush = early_ack_tracker_batch_flush;
   self->ack_record_storage.super.tracker = (AckTracker *)self;
 }
 
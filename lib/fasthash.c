@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "fasthash.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define FAST_HASH_HAVE_CRC32_IMPL 1
+
+/* CRC32C through the SSE4.2 instruction; the mnemonics are emitted
+ * directly so no -msse4.2 compiler flag is needed, availability is
+ * checked at runtime via cpuid */
+static guint32
+fast_hash_crc32c(const void *data, gsize length)
+{
+  const guchar *p = (const guchar *) data;
+  guint32 crc = 0xffffffff ^ (guint32) length;
+
+  while (length >= 4)
+    {
+      guint32 v;
+
+      memcpy(&v, p, 4);
+      __asm__ __volatile__("crc32l %1, %0" : "+r" (crc) : "rm" (v));
+      p += 4;
+      length -= 4;
+    }
+  while (length)
+    {
+      guint8 v = *p++;
+
+      __asm__ __volatile__("crc32b %1, %0" : "+r" (crc) : "qm" (v));
+      length--;
+    }
+  return crc ^ 0xffffffff;
+}
+
+static gboolean
+fast_hash_crc32_available(void)
+{
+  guint eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return FALSE;
+  return !!(ecx & (1 << 20));
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FAST_HASH_HAVE_CRC32_IMPL 1
+
+/* the compiler was told the target supports the ARMv8 CRC32 extension,
+ * no runtime check is needed */
+static guint32
+fast_hash_crc32c(const void *data, gsize length)
+{
+  const guchar *p = (const guchar *) data;
+  guint32 crc = 0xffffffff ^ (guint32) length;
+
+  while (length >= 4)
+    {
+      guint32 v;
+
+      memcpy(&v, p, 4);
+      crc = __crc32cw(crc, v);
+      p += 4;
+      length -= 4;
+    }
+  while (length)
+    {
+      crc = __crc32cb(crc, *p++);
+      length--;
+    }
+  return crc ^ 0xffffffff;
+}
+
+static gboolean
+fast_hash_crc32_available(void)
+{
+  return TRUE;
+}
+
+#endif
+
+/* portable word-at-a-time fallback (the XXH32 algorithm), still
+ * considerably faster than byte-wise DJB hashing on longer keys */
+
+#define FAST_HASH_PRIME32_1 2654435761U
+#define FAST_HASH_PRIME32_2 2246822519U
+#define FAST_HASH_PRIME32_3 3266489917U
+#define FAST_HASH_PRIME32_4  668265263U
+#define FAST_HASH_PRIME32_5  374761393U
+
+static inline guint32
+fast_hash_rotl32(guint32 value, gint count)
+{
+  return (value << count) | (value >> (32 - count));
+}
+
+static inline guint32
+fast_hash_read32(const guchar *p)
+{
+  guint32 v;
+
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline guint32
+fast_hash_xx32_round(guint32 acc, guint32 input)
+{
+  acc += input * FAST_HASH_PRIME32_2;
+  acc = fast_hash_rotl32(acc, 13);
+  acc *= FAST_HASH_PRIME32_1;
+  return acc;
+}
+
+static guint32
+fast_hash_xx32(const void *data, gsize length)
+{
+  const guchar *p = (const guchar *) data;
+  const guchar *end = p + length;
+  guint32 h;
+
+  if (length >= 16)
+    {
+      const guchar *limit = end - 16;
+      guint32 v1 = FAST_HASH_PRIME32_1 + FAST_HASH_PRIME32_2;
+      guint32 v2 = FAST_HASH_PRIME32_2;
+      guint32 v3 = 0;
+      guint32 v4 = (guint32) -(gint32) FAST_HASH_PRIME32_1;
+
+      do
+        {
+          v1 = fast_hash_xx32_round(v1, fast_hash_read32(p)); p += 4;
+          v2 = fast_hash_xx32_round(v2, fast_hash_read32(p)); p += 4;
+          v3 = fast_hash_xx32_round(v3, fast_hash_read32(p)); p += 4;
+          v4 = fast_hash_xx32_round(v4, fast_hash_read32(p)); p += 4;
+        }
+      while (p <= limit);
+
+      h = fast_hash_rotl32(v1, 1) + fast_hash_rotl32(v2, 7) + fast_hash_rotl32(v3, 12) + fast_hash_rotl32(v4, 18);
+    }
+  else
+    {
+      h = FAST_HASH_PRIME32_5;
+    }
+
+  h += (guint32) length;
+
+  while (p + 4 <= end)
+    {
+      h += fast_hash_read32(p) * FAST_HASH_PRIME32_3;
+      h = fast_hash_rotl32(h, 17) * FAST_HASH_PRIME32_4;
+      p += 4;
+    }
+  while (p < end)
+    {
+      h += (*p++) * FAST_HASH_PRIME32_5;
+      h = fast_hash_rotl32(h, 11) * FAST_HASH_PRIME32_1;
+    }
+
+  h ^= h >> 15;
+  h *= FAST_HASH_PRIME32_2;
+  h ^= h >> 13;
+  h *= FAST_HASH_PRIME32_3;
+  h ^= h >> 16;
+  return h;
+}
+
+typedef guint32 (*FastHashFunc)(const void *data, gsize length);
+
+static FastHashFunc fast_hash_impl;
+
+static gpointer
+fast_hash_detect_impl(gpointer user_data)
+{
+#ifdef FAST_HASH_HAVE_CRC32_IMPL
+  if (fast_hash_crc32_available())
+    fast_hash_impl = fast_hash_crc32c;
+  else
+    fast_hash_impl = fast_hash_xx32;
+#else
+  fast_hash_impl = fast_hash_xx32;
+#endif
+  return NULL;
+}
+
+guint32
+fast_hash(const void *data, gsize length)
+{
+  static GOnce detect_once = G_ONCE_INIT;
+
+  g_once(&detect_once, fast_hash_detect_impl, NULL);
+  return fast_hash_impl(data, length);
+}
+
+guint32
+fast_hash_str(const gchar *str)
+{
+  return fast_hash(str, strlen(str));
+}
+
+guint
+fast_hash_g_str(gconstpointer key)
+{
+  return fast_hash_str((const gchar *) key);
+}
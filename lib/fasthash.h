@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef FASTHASH_H_INCLUDED
+#define FASTHASH_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* Fast non-cryptographic hash for hot-path hash tables (name registries,
+ * correlation state, caches).  Uses the CRC32 instruction where the CPU
+ * provides it, with a portable word-at-a-time fallback otherwise; the
+ * implementation is picked once at runtime.  NOTE: the value depends on
+ * the CPU the process runs on, it must never be persisted or compared
+ * across hosts. */
+
+guint32 fast_hash(const void *data, gsize length);
+guint32 fast_hash_str(const gchar *str);
+
+/* GHashFunc compatible adapter for NUL terminated string keys */
+guint fast_hash_g_str(gconstpointer key);
+
+#endif
@@ -36,18 +36,30 @@ static gboolean
 filter_call_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterCall *self = (FilterCall *) s;
+  guint32 memo_bit;
+  LogMessage *msg = msgs[num_msg - 1];
+  gboolean res;
 
-  if (self->filter_expr)
-    {
-      /* rule is assumed to contain a single filter pipe */
-
-      return filter_expr_eval_with_context(self->filter_expr, msgs, num_msg) ^ s->comp;
-    }
-  else
+  if (!self->filter_expr)
     {
       /* an unreferenced filter() expression never matches unless explicitly negated */
       return (0 ^ s->comp);
     }
+
+  /* rule is assumed to contain a single filter pipe */
+
+  memo_bit = (num_msg == 1 && self->filter_expr->memo_slot) ? (1U << (self->filter_expr->memo_slot - 1)) : 0;
+  if (!memo_bit || !log_msg_filter_memo_lookup(msg, memo_bit, &res))
+    {
+      res = filter_expr_eval_with_context(self->filter_expr, msgs, num_msg);
+      if (memo_bit)
+        {
+          /* threaded branches may fan the same uncloned message out to
+           * several workers, the publish is atomic to stay safe there */
+          log_msg_filter_memo_publish(msg, memo_bit, res ? memo_bit : 0);
+        }
+    }
+  return res ^ s->comp;
 }
 
 static void
@@ -69,6 +81,15 @@ filter_call_init(FilterExprNode *s, GlobalConfig *cfg)
       self->filter_expr = filter_expr_ref(filter_pipe->expr);
       filter_expr_init(self->filter_expr, cfg);
       self->super.modify = self->filter_expr->modify;
+
+      /* a named filter referenced from several filter()/condition()
+       * expressions shares a single FilterExprNode; hand out a
+       * per-message memoization bit to it, so e.g. dozens of rewrite
+       * conditions reusing the same program match evaluate it once per
+       * message, the rest only test their bit */
+      if (self->filter_expr->ref_cnt > 1 && !self->filter_expr->modify &&
+          !self->filter_expr->memo_slot && cfg->filter_memo_slots < LOG_MSG_FILTER_MEMO_SLOTS)
+        self->filter_expr->memo_slot = ++cfg->filter_memo_slots;
     }
   else
     {
@@ -96,6 +117,7 @@ filter_call_new(gchar *rule, GlobalConfig *cfg)
   filter_expr_node_init_instance(&self->super);
   self->super.init = filter_call_init;
   self->super.eval = filter_call_eval;
+  self->super.cost = FILTER_COST_EXPENSIVE;
   self->super.free_fn = filter_call_free;
   self->super.type = g_strdup_printf("filter(%s)", rule);
   self->rule = g_strdup(rule);
@@ -25,6 +25,7 @@
 #include "filter/filter-cmp.h"
 #include "filter/filter-expr-grammar.h"
 #include "scratch-buffers.h"
+#include "parse-number.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -34,20 +35,65 @@
 #define FCMP_GT  0x0004
 #define FCMP_NUM 0x0010
 
+typedef struct _FilterCmpOperand
+{
+  /* single value reference (e.g. "$SEQNUM"), zero if the template is
+   * more complicated than that */
+  NVHandle value_handle;
+  /* constant numeric operand, parsed once at compile time */
+  gboolean is_literal;
+  gint64 literal;
+} FilterCmpOperand;
+
 typedef struct _FilterCmp
 {
   FilterExprNode super;
   LogTemplate *left, *right;
+  FilterCmpOperand left_operand, right_operand;
   gint cmp_op;
 } FilterCmp;
 
-gboolean
-fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+static gboolean
+_eval_operand_as_int64(FilterCmpOperand *operand, LogMessage *msg, gint64 *value)
+{
+  if (operand->is_literal)
+    {
+      *value = operand->literal;
+      return TRUE;
+    }
+  if (operand->value_handle)
+    return log_msg_get_value_as_int64(msg, operand->value_handle, value);
+  return FALSE;
+}
+
+/* serve numeric comparisons of trivial operands from the parsed-integer
+ * cache of the message instead of formatting both sides into scratch
+ * buffers and atoi()-ing them for every filter evaluation.  Only
+ * strictly numeric values take this path, anything else falls back to
+ * the generic variant below which retains the old atoi() semantics. */
+static gboolean
+_eval_numeric_fast_path(FilterCmp *self, LogMessage *msg, gint *cmp)
+{
+  gint64 l, r;
+
+  if (!_eval_operand_as_int64(&self->left_operand, msg, &l) ||
+      !_eval_operand_as_int64(&self->right_operand, msg, &r))
+    return FALSE;
+
+  if (l == r)
+    *cmp = 0;
+  else if (l < r)
+    *cmp = -1;
+  else
+    *cmp = 1;
+  return TRUE;
+}
+
+static gint
+_eval_generic(FilterCmp *self, LogMessage **msgs, gint num_msg)
 {
-  FilterCmp *self = (FilterCmp *) s;
   SBGString *left_buf = sb_gstring_acquire();
   SBGString *right_buf = sb_gstring_acquire();
-  gboolean result = FALSE;
   gint cmp;
 
   log_template_format_with_context(self->left, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, sb_gstring_string(left_buf));
@@ -71,6 +117,22 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
       cmp = strcmp(sb_gstring_string(left_buf)->str, sb_gstring_string(right_buf)->str);
     }
 
+  sb_gstring_release(left_buf);
+  sb_gstring_release(right_buf);
+  return cmp;
+}
+
+gboolean
+fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterCmp *self = (FilterCmp *) s;
+  gboolean result = FALSE;
+  gint cmp;
+
+  if (!(self->cmp_op & FCMP_NUM) ||
+      !_eval_numeric_fast_path(self, msgs[num_msg - 1], &cmp))
+    cmp = _eval_generic(self, msgs, num_msg);
+
   if (cmp == 0)
     {
       result = self->cmp_op & FCMP_EQ;
@@ -84,11 +146,20 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
       result = self->cmp_op & FCMP_GT || self->cmp_op == 0;
     }
 
-  sb_gstring_release(left_buf);
-  sb_gstring_release(right_buf);
   return result ^ s->comp;
 }
 
+static void
+_compile_operand(LogTemplate *template, FilterCmpOperand *operand)
+{
+  const gchar *literal;
+
+  operand->value_handle = log_template_get_trivial_value_handle(template);
+  literal = log_template_get_literal_value(template);
+  if (literal)
+    operand->is_literal = parse_number(literal, &operand->literal);
+}
+
 void
 fop_cmp_free(FilterExprNode *s)
 {
@@ -160,5 +231,11 @@ fop_cmp_new(LogTemplate *left, LogTemplate *right, gint op)
                   NULL);
       self->cmp_op &= ~FCMP_NUM;
     }
+
+  if (self->cmp_op & FCMP_NUM)
+    {
+      _compile_operand(self->left, &self->left_operand);
+      _compile_operand(self->right, &self->right_operand);
+    }
   return &self->super;
 }
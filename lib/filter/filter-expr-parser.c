@@ -54,8 +54,11 @@ static CfgLexerKeyword filter_expr_keywords[] = {
   { "message",            KW_MESSAGE },
   { "match",		  KW_MATCH },
   { "netmask",		  KW_NETMASK },
+  { "netmask_list",       KW_NETMASK_LIST },
+  { "netmask_list_file",  KW_NETMASK_LIST_FILE },
   { "tags",		  KW_TAGS },
   { "in_list",            KW_IN_LIST },
+  { "sample",             KW_SAMPLE },
 #if SYSLOG_NG_ENABLE_IPV6
   { "netmask6",     KW_NETMASK6 },
 #endif
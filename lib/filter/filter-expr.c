@@ -33,6 +33,22 @@ void
 filter_expr_node_init_instance(FilterExprNode *self)
 {
   self->ref_cnt = 1;
+  self->cost = FILTER_COST_DEFAULT;
+}
+
+/*
+ * Returns a conservative superset of the severity and facility values this
+ * expression may accept: a cleared bit guarantees a reject, a set bit makes
+ * no promise.  Expressions without a get_accepted_pri implementation are
+ * treated as if they could accept anything.
+ */
+void
+filter_expr_get_accepted_pri(FilterExprNode *self, guint32 *severities, guint32 *facilities)
+{
+  *severities = 0xff;
+  *facilities = 0xffffffff;
+  if (self->get_accepted_pri)
+    self->get_accepted_pri(self, severities, facilities);
 }
 
 /*
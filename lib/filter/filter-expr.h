@@ -31,14 +31,38 @@
 struct _GlobalConfig;
 typedef struct _FilterExprNode FilterExprNode;
 
+/* rough static evaluation cost of a node, used to order the operands of
+ * flattened and/or chains so cheap predicates short-circuit the
+ * expensive ones, see filter-op.c */
+enum
+{
+  FILTER_COST_TRIVIAL = 0,       /* bitmask tests */
+  FILTER_COST_CHEAP = 1,         /* tag lookups, address compares */
+  FILTER_COST_DEFAULT = 2,
+  FILTER_COST_REGEXP = 3,
+  FILTER_COST_EXPENSIVE = 4,     /* embedded filter calls */
+};
+
 struct _FilterExprNode
 {
   guint32 ref_cnt;
-  guint32 comp:1,   /* this not is negated */
-          modify:1; /* this filter changes the log message */
+  guint32 comp:1,       /* this not is negated */
+          modify:1,     /* this filter changes the log message */
+          dispatchable:1; /* exact program() literal, eligible for the
+                           * shared lookup table, see filter-re.c */
+  guint8 cost;
+  /* 1-based index of the per-message memoization bit assigned to this
+   * expression in log_filter_pipe_init(), 0 if the verdict is not cached */
+  guint8 memo_slot;
   const gchar *type;
   void (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg);
+  /* optional: narrow the set of PRI values this expression may accept,
+   * used by the config analysis that pushes severity/facility checks into
+   * the sources.  The masks arrive filled with all bits set and may only
+   * be narrowed conservatively: it must never clear a bit for a message
+   * the expression would accept. */
+  void (*get_accepted_pri)(FilterExprNode *self, guint32 *severities, guint32 *facilities);
   void (*free_fn)(FilterExprNode *self);
 };
 
@@ -49,6 +73,7 @@ filter_expr_init(FilterExprNode *self, GlobalConfig *cfg)
     self->init(self, cfg);
 }
 
+void filter_expr_get_accepted_pri(FilterExprNode *self, guint32 *severities, guint32 *facilities);
 gboolean filter_expr_eval(FilterExprNode *self, LogMessage *msg);
 gboolean filter_expr_eval_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg);
 gboolean filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptions *path_options);
@@ -29,40 +29,82 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+
+/* Length delimited key into the list hash; lookups use a stack allocated
+ * instance pointing straight into the NV table, stored keys embed the
+ * string right after the struct. */
+typedef struct _FilterInListKey
+{
+  const gchar *value;
+  gsize len;
+} FilterInListKey;
+
+/* A loaded list file, shared by every in-list() filter that references the
+ * same path.  Sets survive config reloads through the process global cache
+ * below, so a reload does not re-read (and duplicate) multi-million entry
+ * lists as long as the file is unchanged. */
+typedef struct _FilterInListSet
+{
+  /* protected by list_sets_lock */
+  gint ref_cnt;
+  gchar *file_name;
+  time_t mtime;
+  off_t size;
+  GHashTable *entries;
+} FilterInListSet;
+
+static GStaticMutex list_sets_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *list_sets;
 
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  FilterInListSet *set;
 } FilterInList;
 
-static gboolean
-filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+static guint
+filter_in_list_key_hash(gconstpointer k)
 {
-  FilterInList *self = (FilterInList *)s;
-  LogMessage *msg = msgs[0];
-  const gchar *value;
-  gssize len = 0;
+  const FilterInListKey *key = (const FilterInListKey *) k;
+  guint hash = 5381;
+  gsize i;
 
-  value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
+  for (i = 0; i < key->len; i++)
+    hash = (hash << 5) + hash + (guchar) key->value[i];
+  return hash;
+}
 
-  return (g_tree_lookup(self->tree, value) != NULL) ^ s->comp;
+static gboolean
+filter_in_list_key_equal(gconstpointer a, gconstpointer b)
+{
+  const FilterInListKey *key_a = (const FilterInListKey *) a;
+  const FilterInListKey *key_b = (const FilterInListKey *) b;
+
+  return key_a->len == key_b->len &&
+         memcmp(key_a->value, key_b->value, key_a->len) == 0;
 }
 
 static void
-filter_in_list_free(FilterExprNode *s)
+filter_in_list_set_insert(FilterInListSet *set, const gchar *line, gsize len)
 {
-  FilterInList *self = (FilterInList *)s;
+  FilterInListKey *key;
+  gchar *data;
 
-  g_tree_destroy(self->tree);
+  key = g_malloc(sizeof(FilterInListKey) + len + 1);
+  data = (gchar *) (key + 1);
+  memcpy(data, line, len);
+  data[len] = '\0';
+  key->value = data;
+  key->len = len;
+  g_hash_table_insert(set->entries, key, GINT_TO_POINTER(1));
 }
 
-FilterExprNode *
-filter_in_list_new(const gchar *list_file, const gchar *property)
+static FilterInListSet *
+filter_in_list_set_load(const gchar *list_file, const struct stat *st)
 {
-  FilterInList *self;
+  FilterInListSet *set;
   FILE *stream;
   gchar line[16384];
 
@@ -76,18 +118,117 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
       return NULL;
     }
 
-  self = g_new0(FilterInList, 1);
-  filter_expr_node_init_instance(&self->super);
-  self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
+  set = g_new0(FilterInListSet, 1);
+  set->ref_cnt = 1;
+  set->file_name = g_strdup(list_file);
+  set->mtime = st->st_mtime;
+  set->size = st->st_size;
+  set->entries = g_hash_table_new_full(filter_in_list_key_hash,
+                                       filter_in_list_key_equal,
+                                       g_free, NULL);
 
   while (fgets(line, sizeof(line), stream) != NULL)
     {
       line[strlen(line) - 1] = '\0';
       if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
+        filter_in_list_set_insert(set, line, strlen(line));
     }
   fclose(stream);
+  return set;
+}
+
+/* NOTE: takes list_sets_lock, list loading happens during config
+ * compilation in the main thread, so blocking on file I/O with the lock
+ * held is not an issue */
+static FilterInListSet *
+filter_in_list_set_acquire(const gchar *list_file)
+{
+  FilterInListSet *set;
+  struct stat st;
+
+  if (stat(list_file, &st) < 0)
+    {
+      msg_error("Error opening in-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_errno("errno", errno),
+                NULL);
+      return NULL;
+    }
+
+  g_static_mutex_lock(&list_sets_lock);
+  if (!list_sets)
+    list_sets = g_hash_table_new(g_str_hash, g_str_equal);
+
+  set = g_hash_table_lookup(list_sets, list_file);
+  if (set && set->mtime == st.st_mtime && set->size == st.st_size)
+    {
+      set->ref_cnt++;
+      g_static_mutex_unlock(&list_sets_lock);
+      return set;
+    }
+
+  /* not cached or the file has changed; the stale set stays alive for its
+   * current users, it is merely detached from the cache */
+  set = filter_in_list_set_load(list_file, &st);
+  if (set)
+    g_hash_table_replace(list_sets, set->file_name, set);
+  g_static_mutex_unlock(&list_sets_lock);
+  return set;
+}
+
+static void
+filter_in_list_set_release(FilterInListSet *set)
+{
+  g_static_mutex_lock(&list_sets_lock);
+  if (--set->ref_cnt == 0)
+    {
+      if (g_hash_table_lookup(list_sets, set->file_name) == set)
+        g_hash_table_remove(list_sets, set->file_name);
+      g_hash_table_destroy(set->entries);
+      g_free(set->file_name);
+      g_free(set);
+    }
+  g_static_mutex_unlock(&list_sets_lock);
+}
+
+static gboolean
+filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterInList *self = (FilterInList *)s;
+  LogMessage *msg = msgs[0];
+  FilterInListKey key;
+  gssize len = 0;
+
+  /* the lookup is length delimited, no need to copy the value out of the
+   * NV table just to zero terminate it */
+  key.value = log_msg_get_value(msg, self->value_handle, &len);
+  key.len = (gsize) len;
+
+  return (g_hash_table_lookup(self->set->entries, &key) != NULL) ^ s->comp;
+}
+
+static void
+filter_in_list_free(FilterExprNode *s)
+{
+  FilterInList *self = (FilterInList *)s;
+
+  filter_in_list_set_release(self->set);
+}
+
+FilterExprNode *
+filter_in_list_new(const gchar *list_file, const gchar *property)
+{
+  FilterInList *self;
+  FilterInListSet *set;
+
+  set = filter_in_list_set_acquire(list_file);
+  if (!set)
+    return NULL;
+
+  self = g_new0(FilterInList, 1);
+  filter_expr_node_init_instance(&self->super);
+  self->value_handle = log_msg_get_value_handle(property);
+  self->set = set;
 
   self->super.eval = filter_in_list_eval;
   self->super.free_fn = filter_in_list_free;
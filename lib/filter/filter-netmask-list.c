@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2002-2014 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter-netmask-list.h"
+#include "gsocket.h"
+#include "logmsg.h"
+#include "messages.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/* Binary trie over the bits of the network byte order address, most
+ * significant bit first.  A terminal node marks the end of a configured
+ * prefix, so matching a message costs a single walk of at most
+ * address-length steps, independent of the number of prefixes. */
+typedef struct _FilterNetmaskListNode
+{
+  struct _FilterNetmaskListNode *children[2];
+  gboolean terminal;
+} FilterNetmaskListNode;
+
+typedef struct _FilterNetmaskList
+{
+  FilterExprNode super;
+  FilterNetmaskListNode *root_v4;
+  FilterNetmaskListNode *root_v6;
+} FilterNetmaskList;
+
+static inline guint
+_address_bit(const guint8 *address, gint i)
+{
+  return (address[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static void
+filter_netmask_list_insert(FilterNetmaskListNode **root, const guint8 *address, gint prefix_len)
+{
+  FilterNetmaskListNode *node;
+  gint i;
+
+  if (!*root)
+    *root = g_new0(FilterNetmaskListNode, 1);
+
+  node = *root;
+  for (i = 0; i < prefix_len; i++)
+    {
+      guint bit;
+
+      if (node->terminal)
+        {
+          /* a shorter prefix already covers this one */
+          return;
+        }
+      bit = _address_bit(address, i);
+      if (!node->children[bit])
+        node->children[bit] = g_new0(FilterNetmaskListNode, 1);
+      node = node->children[bit];
+    }
+  node->terminal = TRUE;
+}
+
+static gboolean
+filter_netmask_list_lookup(FilterNetmaskListNode *node, const guint8 *address, gint address_len)
+{
+  gint i;
+
+  for (i = 0; node && i < address_len; i++)
+    {
+      if (node->terminal)
+        return TRUE;
+      node = node->children[_address_bit(address, i)];
+    }
+  return node && node->terminal;
+}
+
+static void
+filter_netmask_list_node_free(FilterNetmaskListNode *node)
+{
+  if (!node)
+    return;
+  filter_netmask_list_node_free(node->children[0]);
+  filter_netmask_list_node_free(node->children[1]);
+  g_free(node);
+}
+
+static gint
+_netmask_to_prefix_len(struct in_addr netmask)
+{
+  guint32 mask = g_ntohl(netmask.s_addr);
+  gint prefix_len = 0;
+
+  while (mask & 0x80000000)
+    {
+      prefix_len++;
+      mask <<= 1;
+    }
+  return prefix_len;
+}
+
+static gboolean
+filter_netmask_list_add_prefix(FilterNetmaskList *self, const gchar *cidr)
+{
+  gchar buf[64];
+  const gchar *slash;
+  gsize address_len;
+
+  slash = strchr(cidr, '/');
+  address_len = slash ? (gsize) (slash - cidr) : strlen(cidr);
+  if (address_len >= sizeof(buf))
+    return FALSE;
+  memcpy(buf, cidr, address_len);
+  buf[address_len] = '\0';
+
+  if (strchr(buf, ':'))
+    {
+#if SYSLOG_NG_ENABLE_IPV6
+      struct in6_addr address;
+      gint prefix_len = slash ? atoi(slash + 1) : 128;
+
+      if (inet_pton(AF_INET6, buf, &address) != 1 ||
+          prefix_len <= 0 || prefix_len > 128)
+        return FALSE;
+      filter_netmask_list_insert(&self->root_v6, address.s6_addr, prefix_len);
+      return TRUE;
+#else
+      msg_warning("Ignoring IPv6 prefix in netmask-list(), IPv6 support is disabled",
+                  evt_tag_str("prefix", cidr),
+                  NULL);
+      return TRUE;
+#endif
+    }
+  else
+    {
+      struct in_addr address;
+      gint prefix_len = 32;
+
+      if (!g_inet_aton(buf, &address))
+        return FALSE;
+      if (slash)
+        {
+          if (strchr(slash + 1, '.'))
+            {
+              struct in_addr netmask;
+              gchar mask_buf[32];
+
+              g_strlcpy(mask_buf, slash + 1, sizeof(mask_buf));
+              if (!g_inet_aton(mask_buf, &netmask))
+                return FALSE;
+              prefix_len = _netmask_to_prefix_len(netmask);
+            }
+          else
+            {
+              prefix_len = atoi(slash + 1);
+            }
+          if (prefix_len <= 0 || prefix_len > 32)
+            return FALSE;
+        }
+      filter_netmask_list_insert(&self->root_v4, (const guint8 *) &address.s_addr, prefix_len);
+      return TRUE;
+    }
+}
+
+static gboolean
+filter_netmask_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+  LogMessage *msg = msgs[0];
+  struct in_addr addr;
+
+  if (msg->saddr && g_sockaddr_inet_check(msg->saddr))
+    {
+      addr = ((struct sockaddr_in *) &msg->saddr->sa)->sin_addr;
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  else if (msg->saddr && g_sockaddr_inet6_check(msg->saddr))
+    {
+      struct in6_addr *addr6 = &((struct sockaddr_in6 *) &msg->saddr->sa)->sin6_addr;
+
+      return filter_netmask_list_lookup(self->root_v6, addr6->s6_addr, 128) ^ s->comp;
+    }
+#endif
+  else if (!msg->saddr || msg->saddr->sa.sa_family == AF_UNIX)
+    {
+      addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+  else
+    {
+      /* no address information, return FALSE */
+      return s->comp;
+    }
+  return filter_netmask_list_lookup(self->root_v4, (const guint8 *) &addr.s_addr, 32) ^ s->comp;
+}
+
+static void
+filter_netmask_list_free(FilterExprNode *s)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+
+  filter_netmask_list_node_free(self->root_v4);
+  filter_netmask_list_node_free(self->root_v6);
+}
+
+static FilterNetmaskList *
+filter_netmask_list_init_instance(void)
+{
+  FilterNetmaskList *self = g_new0(FilterNetmaskList, 1);
+
+  filter_expr_node_init_instance(&self->super);
+  self->super.cost = FILTER_COST_CHEAP;
+  self->super.eval = filter_netmask_list_eval;
+  self->super.free_fn = filter_netmask_list_free;
+  return self;
+}
+
+/* NOTE: consumes @prefixes, like filter_tags_new() does with its list */
+FilterExprNode *
+filter_netmask_list_new(GList *prefixes)
+{
+  FilterNetmaskList *self = filter_netmask_list_init_instance();
+  GList *l;
+  gboolean valid = TRUE;
+
+  for (l = prefixes; l; l = l->next)
+    {
+      if (!filter_netmask_list_add_prefix(self, (const gchar *) l->data))
+        {
+          msg_error("Error parsing netmask-list() prefix",
+                    evt_tag_str("prefix", (const gchar *) l->data),
+                    NULL);
+          valid = FALSE;
+        }
+      g_free(l->data);
+    }
+  g_list_free(prefixes);
+
+  if (!valid)
+    {
+      filter_expr_unref(&self->super);
+      return NULL;
+    }
+  return &self->super;
+}
+
+FilterExprNode *
+filter_netmask_list_new_from_file(const gchar *list_file)
+{
+  FilterNetmaskList *self;
+  FILE *stream;
+  gchar line[256];
+  gboolean valid = TRUE;
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening netmask-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_errno("errno", errno),
+                NULL);
+      return NULL;
+    }
+
+  self = filter_netmask_list_init_instance();
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (!line[0] || line[0] == '#')
+        continue;
+      if (!filter_netmask_list_add_prefix(self, line))
+        {
+          msg_error("Error parsing netmask-list() prefix",
+                    evt_tag_str("file", list_file),
+                    evt_tag_str("prefix", line),
+                    NULL);
+          valid = FALSE;
+        }
+    }
+  fclose(stream);
+
+  if (!valid)
+    {
+      filter_expr_unref(&self->super);
+      return NULL;
+    }
+  return &self->super;
+}
@@ -68,6 +68,7 @@ filter_netmask_new(gchar *cidr)
   gchar *slash;
 
   filter_expr_node_init_instance(&self->super);
+  self->super.cost = FILTER_COST_CHEAP;
   slash = strchr(cidr, '/');
   if (strlen(cidr) >= sizeof(buf) || !slash)
     {
@@ -27,8 +27,67 @@ typedef struct _FilterOp
 {
   FilterExprNode super;
   FilterExprNode *left, *right;
+  /* same-operator subtrees flattened into a linear operand list (built
+   * in init, references are borrowed from the tree); operands are
+   * ordered cheapest first when none of them have side effects, so
+   * bitmask/tag tests short-circuit ahead of regexps */
+  GPtrArray *operands;
 } FilterOp;
 
+/* collect the operands of a chain of identical, non-negated operators
+ * into a flat list, e.g.  (a and (b and c)) becomes [a, b, c] */
+static void
+fop_flatten_operands(FilterOp *self, FilterExprNode *node, GPtrArray *operands)
+{
+  if (node->eval == self->super.eval && !node->comp)
+    {
+      FilterOp *op = (FilterOp *) node;
+
+      fop_flatten_operands(self, op->left, operands);
+      fop_flatten_operands(self, op->right, operands);
+      return;
+    }
+  g_ptr_array_add(operands, node);
+}
+
+static void
+fop_build_operands(FilterOp *self)
+{
+  GPtrArray *operands = g_ptr_array_new();
+  gboolean reorderable = TRUE;
+  gint i, j;
+
+  fop_flatten_operands(self, self->left, operands);
+  fop_flatten_operands(self, self->right, operands);
+
+  for (i = 0; i < operands->len; i++)
+    {
+      FilterExprNode *node = g_ptr_array_index(operands, i);
+
+      if (node->modify)
+        reorderable = FALSE;
+      if (node->cost > self->super.cost)
+        self->super.cost = node->cost;
+    }
+
+  if (reorderable)
+    {
+      /* stable insertion sort by cost, the lists are short and equal
+       * cost operands must keep their configuration order */
+      for (i = 1; i < operands->len; i++)
+        {
+          FilterExprNode *node = g_ptr_array_index(operands, i);
+
+          for (j = i; j > 0 && ((FilterExprNode *) g_ptr_array_index(operands, j - 1))->cost > node->cost; j--)
+            g_ptr_array_index(operands, j) = g_ptr_array_index(operands, j - 1);
+          g_ptr_array_index(operands, j) = node;
+        }
+    }
+  if (self->operands)
+    g_ptr_array_free(self->operands, TRUE);
+  self->operands = operands;
+}
+
 static void
 fop_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -39,6 +98,7 @@ fop_init(FilterExprNode *s, GlobalConfig *cfg)
   if (self->right && self->right->init)
     self->right->init(self->right, cfg);
   self->super.modify = self->left->modify || self->right->modify;
+  fop_build_operands(self);
 }
 
 static void
@@ -46,6 +106,8 @@ fop_free(FilterExprNode *s)
 {
   FilterOp *self = (FilterOp *) s;
 
+  if (self->operands)
+    g_ptr_array_free(self->operands, TRUE);
   filter_expr_unref(self->left);
   filter_expr_unref(self->right);
 }
@@ -62,10 +124,37 @@ static gboolean
 fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterOp *self = (FilterOp *) s;
+  gint i;
+
+  if (G_LIKELY(self->operands))
+    {
+      for (i = 0; i < self->operands->len; i++)
+        {
+          if (filter_expr_eval_with_context(g_ptr_array_index(self->operands, i), msgs, num_msg))
+            return TRUE ^ s->comp;
+        }
+      return FALSE ^ s->comp;
+    }
 
   return (filter_expr_eval_with_context(self->left, msgs, num_msg) || filter_expr_eval_with_context(self->right, msgs, num_msg)) ^ s->comp;
 }
 
+static void
+fop_or_get_accepted_pri(FilterExprNode *s, guint32 *severities, guint32 *facilities)
+{
+  FilterOp *self = (FilterOp *) s;
+  guint32 left_sev, left_fac, right_sev, right_fac;
+
+  /* a negated OR accepts whatever its operands reject, no useful bound */
+  if (s->comp)
+    return;
+
+  filter_expr_get_accepted_pri(self->left, &left_sev, &left_fac);
+  filter_expr_get_accepted_pri(self->right, &right_sev, &right_fac);
+  *severities = left_sev | right_sev;
+  *facilities = left_fac | right_fac;
+}
+
 FilterExprNode *
 fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 {
@@ -73,6 +162,7 @@ fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_or_eval;
+  self->super.get_accepted_pri = fop_or_get_accepted_pri;
   self->left = e1;
   self->right = e2;
   self->super.type = "OR";
@@ -83,10 +173,37 @@ static gboolean
 fop_and_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterOp *self = (FilterOp *) s;
+  gint i;
+
+  if (G_LIKELY(self->operands))
+    {
+      for (i = 0; i < self->operands->len; i++)
+        {
+          if (!filter_expr_eval_with_context(g_ptr_array_index(self->operands, i), msgs, num_msg))
+            return FALSE ^ s->comp;
+        }
+      return TRUE ^ s->comp;
+    }
 
   return (filter_expr_eval_with_context(self->left, msgs, num_msg) && filter_expr_eval_with_context(self->right, msgs, num_msg)) ^ s->comp;
 }
 
+static void
+fop_and_get_accepted_pri(FilterExprNode *s, guint32 *severities, guint32 *facilities)
+{
+  FilterOp *self = (FilterOp *) s;
+  guint32 left_sev, left_fac, right_sev, right_fac;
+
+  /* a negated AND accepts whatever one of its operands rejects */
+  if (s->comp)
+    return;
+
+  filter_expr_get_accepted_pri(self->left, &left_sev, &left_fac);
+  filter_expr_get_accepted_pri(self->right, &right_sev, &right_fac);
+  *severities = left_sev & right_sev;
+  *facilities = left_fac & right_fac;
+}
+
 FilterExprNode *
 fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 {
@@ -94,6 +211,7 @@ fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_and_eval;
+  self->super.get_accepted_pri = fop_and_get_accepted_pri;
   self->left = e1;
   self->right = e2;
   self->super.type = "AND";
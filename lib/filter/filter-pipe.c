@@ -23,6 +23,7 @@
  */
 
 #include "filter/filter-pipe.h"
+#include "filter/filter-re.h"
 
 /*******************************************************************
  * LogFilterPipe
@@ -37,6 +38,25 @@ log_filter_pipe_init(LogPipe *s)
   filter_expr_init(self->expr, log_pipe_get_config(s));
   if (!self->name)
     self->name = cfg_tree_get_rule_name(&cfg->tree, ENC_FILTER, s->expr_node);
+
+  /* a named filter referenced from multiple log statements shares a single
+   * FilterExprNode between the cloned pipes.  Hand out a per-message
+   * memoization bit to such expressions so the verdict is computed only
+   * once per message, no matter how many log paths reference the filter.
+   * Filters with side effects (e.g. match() with store-matches) are never
+   * memoized as skipping their evaluation would skip the side effect too. */
+  if (self->expr->dispatchable && cfg->filter_memo_slots < LOG_MSG_FILTER_MEMO_SLOTS)
+    {
+      /* exact program() filters get a slot even without sharing: the
+       * dispatch table computes the verdict of all of them in one hash
+       * lookup and publishes it through the memo bits */
+      if (!self->expr->memo_slot)
+        self->expr->memo_slot = ++cfg->filter_memo_slots;
+      filter_program_dispatch_register(cfg, (FilterRE *) self->expr);
+    }
+  else if (self->expr->ref_cnt > 1 && !self->expr->modify &&
+           !self->expr->memo_slot && cfg->filter_memo_slots < LOG_MSG_FILTER_MEMO_SLOTS)
+    self->expr->memo_slot = ++cfg->filter_memo_slots;
   return TRUE;
 }
 
@@ -44,6 +64,7 @@ static void
 log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
 {
   LogFilterPipe *self = (LogFilterPipe *) s;
+  guint32 memo_bit = self->expr->memo_slot ? (1U << (self->expr->memo_slot - 1)) : 0;
   gboolean res;
 
   msg_debug("Filter rule evaluation begins",
@@ -51,7 +72,16 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
             log_pipe_location_tag(s),
             NULL);
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  if (!memo_bit || !log_msg_filter_memo_lookup(msg, memo_bit, &res))
+    {
+      res = filter_expr_eval_root(self->expr, &msg, path_options);
+      if (memo_bit)
+        {
+          /* threaded branches may fan the same uncloned message out to
+           * several workers, the publish is atomic to stay safe there */
+          log_msg_filter_memo_publish(msg, memo_bit, res ? memo_bit : 0);
+        }
+    }
   msg_debug("Filter rule evaluation result",
             evt_tag_str("result", res ? "match" : "not-match"),
             evt_tag_str("rule", self->name),
@@ -51,6 +51,25 @@ filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return self->super.comp;
 }
 
+static void
+filter_facility_get_accepted_pri(FilterExprNode *s, guint32 *severities, guint32 *facilities)
+{
+  FilterPri *self = (FilterPri *) s;
+
+  if (G_UNLIKELY(self->valid & 0x80000000))
+    {
+      guint32 fac_num = self->valid & ~0x80000000;
+
+      /* facilities above 31 do not fit the bitmask, leave it untouched */
+      if (fac_num < 32)
+        *facilities = s->comp ? ~(1 << fac_num) : (1 << fac_num);
+    }
+  else
+    {
+      *facilities = s->comp ? ~self->valid : self->valid;
+    }
+}
+
 FilterExprNode *
 filter_facility_new(guint32 facilities)
 {
@@ -58,6 +77,8 @@ filter_facility_new(guint32 facilities)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_facility_eval;
+  self->super.get_accepted_pri = filter_facility_get_accepted_pri;
+  self->super.cost = FILTER_COST_TRIVIAL;
   self->valid = facilities;
   self->super.type = "facility";
   return &self->super;
@@ -74,6 +95,14 @@ filter_level_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return !!((1 << pri) & self->valid) ^ self->super.comp;
 }
 
+static void
+filter_level_get_accepted_pri(FilterExprNode *s, guint32 *severities, guint32 *facilities)
+{
+  FilterPri *self = (FilterPri *) s;
+
+  *severities = (s->comp ? ~self->valid : self->valid) & 0xff;
+}
+
 FilterExprNode *
 filter_level_new(guint32 levels)
 {
@@ -81,6 +110,8 @@ filter_level_new(guint32 levels)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_level_eval;
+  self->super.get_accepted_pri = filter_level_get_accepted_pri;
+  self->super.cost = FILTER_COST_TRIVIAL;
   self->valid = levels;
   self->super.type = "level";
   return &self->super;
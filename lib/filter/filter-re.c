@@ -24,9 +24,108 @@
 
 #include "filter-re.h"
 #include "misc.h"
+#include "cfg.h"
 
 #include <string.h>
 
+/*
+ * Program name dispatch table.
+ *
+ * Configurations that fan out on the sending application typically
+ * contain dozens of program("^appname$") filters, and every message
+ * used to be matched against each of these regexps in turn even though
+ * a single one can match.  Filters whose pattern is recognized as an
+ * exact literal are collected into a per-configuration hash table
+ * keyed by the literal; the first such filter a message hits performs
+ * one lookup of $PROGRAM and publishes the verdict of *every*
+ * registered filter through the per-message memoization bits, so the
+ * remaining ones are never evaluated for that message.
+ *
+ * Only exact matches participate: substring semantics of bare regexp
+ * literals and prefix matching cannot be expressed as a hash lookup.
+ */
+struct _FilterProgramDispatch
+{
+  /* literal -> NULL; the key is the interned string the members point to */
+  GHashTable *literals;
+  /* all registered FilterRE instances, each holding a memo slot */
+  GPtrArray *members;
+};
+
+static gboolean
+filter_program_dispatch_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterRE *self = (FilterRE *) s;
+  FilterProgramDispatch *dispatch = self->dispatch;
+  LogMessage *msg = msgs[0];
+  const gchar *value;
+  gssize len = 0;
+  gpointer matched_key = NULL;
+  gint i;
+
+  value = log_msg_get_value(msg, LM_V_PROGRAM, &len);
+  APPEND_ZERO(value, value, len);
+  g_hash_table_lookup_extended(dispatch->literals, value, &matched_key, NULL);
+
+  /* one lookup decides all registered program() filters; verdicts are
+   * published through the memo bits checked in log_filter_pipe_queue()
+   * with a single atomic publish, so concurrent workers chewing on the
+   * same uncloned message cannot lose each other's updates */
+  {
+    guint32 mask_bits = 0, value_bits = 0;
+
+    for (i = 0; i < dispatch->members->len; i++)
+      {
+        FilterRE *member = (FilterRE *) g_ptr_array_index(dispatch->members, i);
+        guint32 memo_bit = 1U << (member->super.memo_slot - 1);
+
+        mask_bits |= memo_bit;
+        if ((member->dispatch_literal == (const gchar *) matched_key) ^ member->super.comp)
+          value_bits |= memo_bit;
+      }
+    log_msg_filter_memo_publish(msg, mask_bits, value_bits);
+  }
+  return (self->dispatch_literal == (const gchar *) matched_key) ^ self->super.comp;
+}
+
+/* called from log_filter_pipe_init() for dispatchable filters that were
+ * granted a memo slot; swaps the regexp eval for the table lookup */
+void
+filter_program_dispatch_register(GlobalConfig *cfg, FilterRE *self)
+{
+  FilterProgramDispatch *dispatch = cfg->program_dispatch;
+  gpointer interned = NULL;
+
+  if (self->dispatch)
+    return;
+
+  if (!dispatch)
+    {
+      dispatch = g_new0(FilterProgramDispatch, 1);
+      dispatch->literals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+      dispatch->members = g_ptr_array_new();
+      cfg->program_dispatch = dispatch;
+    }
+
+  if (!g_hash_table_lookup_extended(dispatch->literals, self->literal_pattern, &interned, NULL))
+    {
+      interned = g_strdup(self->literal_pattern);
+      g_hash_table_insert(dispatch->literals, interned, NULL);
+    }
+  self->dispatch_literal = (const gchar *) interned;
+  self->dispatch = dispatch;
+  self->super.eval = filter_program_dispatch_eval;
+  g_ptr_array_add(dispatch->members, self);
+}
+
+void
+filter_program_dispatch_free(FilterProgramDispatch *self)
+{
+  g_hash_table_destroy(self->literals);
+  g_ptr_array_free(self->members, TRUE);
+  g_free(self);
+}
+
 static gboolean
 filter_re_eval_string(FilterExprNode *s, LogMessage *msg, gint value_handle, const gchar *str, gssize str_len)
 {
@@ -59,6 +158,35 @@ filter_re_free(FilterExprNode *s)
 
   log_matcher_unref(self->matcher);
   log_matcher_options_destroy(&self->matcher_options);
+  g_free(self->literal_pattern);
+}
+
+/* returns the literal string @re matches exactly, or NULL if it is a
+ * real pattern.  Only trivially anchored regexps ("^literal$" without
+ * metacharacters) and exact string matchers qualify: a bare regexp
+ * literal has substring semantics and substring/prefix/icase matching
+ * cannot be replaced by a hash lookup. */
+static gchar *
+filter_re_extract_literal_pattern(FilterRE *self, const gchar *re)
+{
+  gsize len;
+
+  if (self->matcher_options.flags & (LMF_ICASE | LMF_STORE_MATCHES | LMF_SUBSTRING | LMF_PREFIX))
+    return NULL;
+
+  if (strcmp(self->matcher_options.type, "string") == 0)
+    return g_strdup(re);
+
+  if (strcmp(self->matcher_options.type, "posix") != 0 &&
+      strcmp(self->matcher_options.type, "pcre") != 0)
+    return NULL;
+
+  len = strlen(re);
+  if (len < 2 || re[0] != '^' || re[len - 1] != '$')
+    return NULL;
+  if (strcspn(re + 1, ".[]{}()\\*+?|^$") < len - 2)
+    return NULL;
+  return g_strndup(re + 1, len - 2);
 }
 
 static void
@@ -75,6 +203,9 @@ filter_re_compile_pattern(FilterRE *self, GlobalConfig *cfg, gchar *re, GError *
 {
   log_matcher_options_init(&self->matcher_options, cfg);
   self->matcher = log_matcher_new(&self->matcher_options);
+  self->literal_pattern = filter_re_extract_literal_pattern(self, re);
+  if (self->literal_pattern && self->value_handle == LM_V_PROGRAM)
+    self->super.dispatchable = TRUE;
   return log_matcher_compile(self->matcher, re, error);
 }
 
@@ -85,6 +216,7 @@ filter_re_init_instance(FilterRE *self, NVHandle value_handle)
   self->value_handle = value_handle;
   self->super.init = filter_re_init;
   self->super.eval = filter_re_eval;
+  self->super.cost = FILTER_COST_REGEXP;
   self->super.free_fn = filter_re_free;
   log_matcher_options_defaults(&self->matcher_options);
   self->matcher_options.flags |= LMF_MATCH_ONLY;
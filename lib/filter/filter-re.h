@@ -28,17 +28,28 @@
 #include "filter-expr.h"
 #include "logmatcher.h"
 
+typedef struct _FilterProgramDispatch FilterProgramDispatch;
+
 typedef struct _FilterRE
 {
   FilterExprNode super;
   NVHandle value_handle;
   LogMatcherOptions matcher_options;
   LogMatcher *matcher;
+  /* the single literal string the pattern matches exactly, or NULL if
+   * the pattern is a real regexp; owned by this node */
+  gchar *literal_pattern;
+  /* interned copy of literal_pattern owned by the dispatch table, valid
+   * once registered; compared by pointer in the dispatch eval */
+  const gchar *dispatch_literal;
+  FilterProgramDispatch *dispatch;
 } FilterRE;
 
 typedef struct _FilterMatch FilterMatch;
 
 gboolean filter_re_compile_pattern(FilterRE *self, GlobalConfig *cfg, gchar *re, GError **error);
+void filter_program_dispatch_register(GlobalConfig *cfg, FilterRE *self);
+void filter_program_dispatch_free(FilterProgramDispatch *self);
 
 FilterRE *filter_re_new(NVHandle value_handle);
 FilterRE *filter_source_new(void);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016 BalaBit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter-sample.h"
+#include "scratch-buffers.h"
+#include "stats/stats-registry.h"
+
+/*
+ * Hash-based sampling filter.  sample(N key("...")) matches 1-in-N
+ * messages, selected by hashing the expanded key template, so the same
+ * key is consistently kept or dropped; with a key like "$HOST$PROGRAM"
+ * every node of a cluster samples the same subset of senders.  Without
+ * an explicit key the decision hashes $MESSAGE.
+ *
+ * NOTE: the key is hashed with plain FNV-1a instead of fast_hash(),
+ * because fast_hash() values are CPU dependent (see fasthash.h) and the
+ * whole point of keyed sampling is that independent nodes agree on the
+ * verdict.  The cost is one template expansion (or a direct value
+ * lookup for trivial keys) plus a hash and a compare per message.
+ */
+
+typedef struct _FilterSample
+{
+  FilterExprNode super;
+  gint rate;
+  LogTemplate *key;
+  /* single value reference (e.g. "$HOST"), zero if the key template is
+   * more complicated than that */
+  NVHandle key_handle;
+  StatsCounterItem *sampled;
+  StatsCounterItem *dropped;
+} FilterSample;
+
+static guint32
+_sample_hash(const gchar *key, gssize key_len)
+{
+  guint32 hash = 2166136261U;
+  gssize i;
+
+  for (i = 0; i < key_len; i++)
+    {
+      hash ^= (guchar) key[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static gboolean
+filter_sample_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterSample *self = (FilterSample *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  guint32 hash;
+  gboolean selected;
+
+  if (self->key_handle)
+    {
+      const gchar *key;
+      gssize key_len = 0;
+
+      key = log_msg_get_value(msg, self->key_handle, &key_len);
+      hash = _sample_hash(key, key_len);
+    }
+  else
+    {
+      SBGString *key_buf = sb_gstring_acquire();
+
+      log_template_format(self->key, msg, NULL, LTZ_LOCAL, 0, NULL, sb_gstring_string(key_buf));
+      hash = _sample_hash(sb_gstring_string(key_buf)->str, sb_gstring_string(key_buf)->len);
+      sb_gstring_release(key_buf);
+    }
+
+  selected = ((hash % self->rate) == 0);
+  if (selected)
+    stats_counter_inc(self->sampled);
+  else
+    stats_counter_inc(self->dropped);
+
+  return selected ^ s->comp;
+}
+
+static void
+filter_sample_init(FilterExprNode *s, GlobalConfig *cfg)
+{
+  FilterSample *self = (FilterSample *) s;
+  gchar instance[32];
+
+  g_snprintf(instance, sizeof(instance), "sample(%d)", self->rate);
+  stats_lock();
+  stats_register_counter(1, SCS_GLOBAL, "filter", instance, SC_TYPE_PROCESSED, &self->sampled);
+  stats_register_counter(1, SCS_GLOBAL, "filter", instance, SC_TYPE_DROPPED, &self->dropped);
+  stats_unlock();
+}
+
+static void
+filter_sample_free(FilterExprNode *s)
+{
+  FilterSample *self = (FilterSample *) s;
+  gchar instance[32];
+
+  g_snprintf(instance, sizeof(instance), "sample(%d)", self->rate);
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "filter", instance, SC_TYPE_PROCESSED, &self->sampled);
+  stats_unregister_counter(SCS_GLOBAL, "filter", instance, SC_TYPE_DROPPED, &self->dropped);
+  stats_unlock();
+
+  log_template_unref(self->key);
+}
+
+FilterExprNode *
+filter_sample_new(gint rate, LogTemplate *key)
+{
+  FilterSample *self = g_new0(FilterSample, 1);
+
+  filter_expr_node_init_instance(&self->super);
+  g_assert(rate > 0);
+  self->rate = rate;
+  if (key)
+    {
+      self->key = key;
+      self->key_handle = log_template_get_trivial_value_handle(key);
+    }
+  else
+    {
+      self->key_handle = LM_V_MESSAGE;
+    }
+
+  self->super.init = filter_sample_init;
+  self->super.eval = filter_sample_eval;
+  self->super.cost = FILTER_COST_CHEAP;
+  self->super.free_fn = filter_sample_free;
+  self->super.type = "sample";
+  return &self->super;
+}
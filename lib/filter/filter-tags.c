@@ -4,23 +4,20 @@
 typedef struct _FilterTags
 {
   FilterExprNode super;
-  GArray *tags;
+
+  /* bitfield of the tags we match, laid out the same way as the
+   * per-message tags array, so evaluation is a word-wise AND instead of
+   * testing the candidate ids one by one */
+  gulong *mask;
+  gint mask_words;
 } FilterTags;
 
 static gboolean
 filter_tags_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterTags *self = (FilterTags *)s;
-  LogMessage *msg = msgs[0];
-  gint i;
-
-  for (i = 0; i < self->tags->len; i++)
-    {
-      if (log_msg_is_tag_by_id(msg, g_array_index(self->tags, LogTagId, i)))
-        return TRUE ^ s->comp;
-    }
 
-  return FALSE ^ s->comp;
+  return log_msg_tags_intersect(msgs[0], self->mask, self->mask_words) ^ s->comp;
 }
 
 void
@@ -34,7 +31,7 @@ filter_tags_add(FilterExprNode *s, GList *tags)
       id = log_tags_get_by_name((gchar *) tags->data);
       g_free(tags->data);
       tags = g_list_delete_link(tags, tags);
-      g_array_append_val(self->tags, id);
+      log_msg_tags_mask_add(&self->mask, &self->mask_words, id);
     }
 }
 
@@ -43,7 +40,7 @@ filter_tags_free(FilterExprNode *s)
 {
   FilterTags *self = (FilterTags *)s;
 
-  g_array_free(self->tags, TRUE);
+  g_free(self->mask);
 }
 
 FilterExprNode *
@@ -52,11 +49,11 @@ filter_tags_new(GList *tags)
   FilterTags *self = g_new0(FilterTags, 1);
 
   filter_expr_node_init_instance(&self->super);
-  self->tags = g_array_new(FALSE, FALSE, sizeof(LogTagId));
 
   filter_tags_add(&self->super, tags);
 
   self->super.eval = filter_tags_eval;
+  self->super.cost = FILTER_COST_CHEAP;
   self->super.free_fn = filter_tags_free;
   return &self->super;
 }
@@ -7,6 +7,7 @@
 #include "filter/filter-tags.h"
 #include "filter/filter-re.h"
 #include "filter/filter-pri.h"
+#include "filter/filter-sample.h"
 #include "cfg.h"
 #include "messages.h"
 #include "syslog-names.h"
@@ -440,6 +441,22 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase_with_backref_chk("<15>Oct 15 16:17:01 host openvpn[2499]: al fa", create_pcre_regexp_filter(LM_V_MESSAGE, "(a)(l) (fa)", LMF_STORE_MATCHES), 1, "0","al fa");
   testcase_with_backref_chk("<15>Oct 15 16:17:01 host openvpn[2499]: al fa", create_pcre_regexp_filter(LM_V_MESSAGE, "(a)(l) (fa)", LMF_STORE_MATCHES), 1, "233",NULL);
 
+  /* sample(): a rate of 1 keeps everything, higher rates must at least be
+     deterministic for the same key */
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", filter_sample_new(1, NULL), 1);
+  {
+    const gchar *raw = "<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized";
+    FilterExprNode *f1 = filter_sample_new(10, NULL);
+    FilterExprNode *f2 = filter_sample_new(10, NULL);
+    LogMessage *logmsg;
+
+    logmsg = log_msg_new(raw, strlen(raw), NULL, &parse_options);
+    TEST_ASSERT(filter_expr_eval(f1, logmsg) == filter_expr_eval(f2, logmsg));
+    log_msg_unref(logmsg);
+    filter_expr_unref(f1);
+    filter_expr_unref(f2);
+  }
+
   app_shutdown();
   return 0;
 }
@@ -116,6 +116,23 @@ test_filter_with_long_line(const char* top_srcdir)
   g_free(list_file_with_long_line);
 }
 
+void
+test_list_is_shared_between_filters(const char* top_srcdir)
+{
+  gchar* list_file_with_one_line = g_strdup_printf(LIST_FILE_DIR "test.list", top_srcdir);
+  FilterExprNode *sharing_filter = filter_in_list_new(list_file_with_one_line, "PROGRAM");
+
+  assert_gboolean(evaluate_testcase(MSG_1, filter_in_list_new(list_file_with_one_line, "PROGRAM")),
+                  TRUE,
+                  "in-list filter matches");
+  /* the first filter must stay functional after the other user of the
+   * shared list is freed */
+  assert_gboolean(evaluate_testcase(MSG_1, sharing_filter),
+                  TRUE,
+                  "in-list filter matches");
+  g_free(list_file_with_one_line);
+}
+
 void
 run_testcases(const char* top_srcdir)
 {
@@ -127,6 +144,7 @@ run_testcases(const char* top_srcdir)
   test_list_file_contains_lot_of_lines(top_srcdir);
   test_filter_with_ip_address(top_srcdir);
   test_filter_with_long_line(top_srcdir);
+  test_list_is_shared_between_filters(top_srcdir);
 }
 
 int
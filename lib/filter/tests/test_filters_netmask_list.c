@@ -0,0 +1,114 @@
+#include "apphook.h"
+#include "logmsg.h"
+#include "gsocket.h"
+#include "filter/filter-netmask-list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "testutils.h"
+
+static GList *
+prefix_list(const gchar *first, ...)
+{
+  va_list args;
+  const gchar *prefix = first;
+  GList *list = NULL;
+
+  va_start(args, first);
+  while (prefix)
+    {
+      list = g_list_append(list, g_strdup(prefix));
+      prefix = va_arg(args, const gchar *);
+    }
+  va_end(args);
+  return list;
+}
+
+static gboolean
+evaluate(FilterExprNode *filter, const gchar *saddr_ip)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gboolean result;
+
+  if (saddr_ip)
+    msg->saddr = g_sockaddr_inet_new(saddr_ip, 0);
+  result = filter_expr_eval(filter, msg);
+  log_msg_unref(msg);
+  return result;
+}
+
+static void
+test_address_matching_a_listed_prefix(void)
+{
+  FilterExprNode *filter = filter_netmask_list_new(prefix_list("10.10.0.0/16", "192.168.1.0/24", NULL));
+
+  assert_gboolean(evaluate(filter, "10.10.12.34"), TRUE, "address inside a listed prefix");
+  assert_gboolean(evaluate(filter, "192.168.1.1"), TRUE, "address inside a listed prefix");
+  assert_gboolean(evaluate(filter, "192.168.2.1"), FALSE, "address outside every listed prefix");
+  assert_gboolean(evaluate(filter, "11.10.12.34"), FALSE, "address outside every listed prefix");
+  filter_expr_unref(filter);
+}
+
+static void
+test_exact_host_entry(void)
+{
+  FilterExprNode *filter = filter_netmask_list_new(prefix_list("172.16.5.4", NULL));
+
+  assert_gboolean(evaluate(filter, "172.16.5.4"), TRUE, "exact host entry matches");
+  assert_gboolean(evaluate(filter, "172.16.5.5"), FALSE, "neighbouring host does not match");
+  filter_expr_unref(filter);
+}
+
+static void
+test_shorter_prefix_covers_longer_one(void)
+{
+  FilterExprNode *filter = filter_netmask_list_new(prefix_list("10.0.0.0/8", "10.1.2.0/24", NULL));
+
+  assert_gboolean(evaluate(filter, "10.1.2.3"), TRUE, "address inside both prefixes");
+  assert_gboolean(evaluate(filter, "10.200.0.1"), TRUE, "address covered only by the short prefix");
+  filter_expr_unref(filter);
+}
+
+static void
+test_dotted_netmask_notation(void)
+{
+  FilterExprNode *filter = filter_netmask_list_new(prefix_list("192.168.1.0/255.255.255.0", NULL));
+
+  assert_gboolean(evaluate(filter, "192.168.1.99"), TRUE, "address inside a dotted netmask prefix");
+  assert_gboolean(evaluate(filter, "192.168.2.99"), FALSE, "address outside a dotted netmask prefix");
+  filter_expr_unref(filter);
+}
+
+static void
+test_message_without_address_counts_as_loopback(void)
+{
+  FilterExprNode *filter = filter_netmask_list_new(prefix_list("127.0.0.0/8", NULL));
+
+  assert_gboolean(evaluate(filter, NULL), TRUE, "local message matches the loopback prefix");
+  filter_expr_unref(filter);
+}
+
+static void
+test_invalid_prefix_fails(void)
+{
+  assert_null(filter_netmask_list_new(prefix_list("10.0.0.0/33", NULL)), "out of range prefix length");
+  assert_null(filter_netmask_list_new(prefix_list("not-an-address/8", NULL)), "unparsable address");
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+
+  test_address_matching_a_listed_prefix();
+  test_exact_host_entry();
+  test_shorter_prefix_covers_longer_one();
+  test_dotted_netmask_notation();
+  test_message_without_address_counts_as_loopback();
+  test_invalid_prefix_fails();
+
+  app_shutdown();
+
+  return 0;
+}
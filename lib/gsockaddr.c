@@ -102,6 +102,38 @@ g_sockaddr_format(GSockAddr *a, gchar *text, gulong n, gint format)
   return a->sa_funcs->format(a, text, n, format);
 }
 
+/**
+ * g_sockaddr_get_address_str:
+ * @a        instance pointer of a GSockAddr
+ *
+ * Return the GSA_ADDRESS_ONLY formatted form of @a, caching the result
+ * on the instance: the peer address of a connection never changes, so
+ * the inet_ntop() style conversion only needs to run once per
+ * connection instead of once per message.  Safe to call from multiple
+ * threads, the first one to finish publishes the cached string.
+ *
+ * Returns: the cached address string, valid as long as a reference to
+ * @a is held.
+ **/
+const gchar *
+g_sockaddr_get_address_str(GSockAddr *a)
+{
+  gchar buf[MAX_SOCKADDR_STRING];
+  gchar *ip;
+
+  if (a->cached_ip)
+    return a->cached_ip;
+
+  g_sockaddr_format(a, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+  ip = g_strdup(buf);
+  if (!g_atomic_pointer_compare_and_exchange((gpointer *) &a->cached_ip, NULL, ip))
+    {
+      /* somebody else got here first, use theirs */
+      g_free(ip);
+    }
+  return a->cached_ip;
+}
+
 guint16
 g_sockaddr_get_port(GSockAddr *a)
 {
@@ -157,6 +189,7 @@ g_sockaddr_unref(GSockAddr *a)
     {
       if (g_atomic_counter_dec_and_test(&a->refcnt))
         {
+          g_free(a->cached_ip);
           g_slice_free1(g_sockaddr_len(a), a);
         }
     }
@@ -175,6 +208,7 @@ typedef struct _GSockAddrInet
   guint32 flags;
   GSockAddrFuncs *sa_funcs;
   int salen;
+  gchar *cached_ip;
   struct sockaddr_in sin;
 } GSockAddrInet;
 
@@ -324,6 +358,7 @@ typedef struct _GSockAddrInet6
   guint32 flags;
   GSockAddrFuncs *sa_funcs;
   int salen;
+  gchar *cached_ip;
   struct sockaddr_in6 sin6;
 } GSockAddrInet6;
 
@@ -465,6 +500,7 @@ typedef struct _GSockAddrUnix
   guint32 flags;
   GSockAddrFuncs *sa_funcs;
   int salen;
+  gchar *cached_ip;
   struct sockaddr_un saun;
 } GSockAddrUnix;
 
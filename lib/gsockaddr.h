@@ -51,6 +51,10 @@ typedef struct _GSockAddr
   guint32 flags;
   GSockAddrFuncs *sa_funcs;
   int salen;
+  /* GSA_ADDRESS_ONLY form, filled lazily by g_sockaddr_get_address_str();
+   * mutate the address (e.g. g_sockaddr_inet_set_address) only before the
+   * first format, the cache is never invalidated */
+  gchar *cached_ip;
   struct sockaddr sa;
 } GSockAddr;
 
@@ -64,6 +68,7 @@ struct _GSockAddrFuncs
 };
 
 gchar *g_sockaddr_format(GSockAddr *a, gchar *text, gulong n, gint format);
+const gchar *g_sockaddr_get_address_str(GSockAddr *a);
 guint16 g_sockaddr_get_port(GSockAddr *a);
 void g_sockaddr_set_port(GSockAddr *a, guint16 port);
 
@@ -96,6 +96,29 @@ hostname_apply_options_fqdn(gssize result_len_orig, gsize *result_len, const gch
   return hostname_apply_options(result_len_orig, result_len, hname, host_resolve_options);
 }
 
+/* the options-applied form of a cached hostname only depends on the
+ * use_fqdn and normalize_hostnames bits, encode those into the dnscache
+ * variant index so the lowercasing/domain chopping runs once per distinct
+ * peer instead of once per message; variant 0 (fqdn, no normalization) is
+ * the stored hostname itself */
+static guint
+host_resolve_options_to_dnscache_variant(const HostResolveOptions *host_resolve_options)
+{
+  return (host_resolve_options->normalize_hostnames ? 1 : 0) |
+         (host_resolve_options->use_fqdn ? 0 : 2);
+}
+
+static gchar *
+apply_options_to_cached_hostname(const gchar *hostname, gboolean positive, gpointer user_data)
+{
+  const HostResolveOptions *host_resolve_options = (const HostResolveOptions *) user_data;
+  const gchar *hname;
+  gsize hname_len;
+
+  hname = hostname_apply_options_fqdn(-1, &hname_len, hostname, positive, host_resolve_options);
+  return g_strndup(hname, hname_len);
+}
+
 /****************************************************************************
  * Convert a GSockAddr instance to a hostname
  ****************************************************************************/
@@ -295,6 +318,125 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
 #endif
 }
 
+/****************************************************************************
+ * Asynchronous resolver threads for use_dns(async)
+ *
+ * With use_dns(async), a reader thread never calls the resolver library
+ * itself.  On a cache miss the address is queued for a couple of
+ * background threads that perform the lookup and publish the result into
+ * the DNS cache; the message that triggered the miss (and any further
+ * ones arriving before the answer) carries the numeric address.  This
+ * trades hostnames on the first few messages of an unknown peer for a
+ * reader that cannot be stalled by a dead or slow DNS server.  Messages
+ * are never parked, so the per-connection ordering is trivially kept.
+ ****************************************************************************/
+
+#define DNS_RESOLVER_THREADS 2
+#define DNS_RESOLVER_MAX_PENDING 1024
+
+typedef struct _DNSResolveRequest
+{
+  GSockAddr *saddr;
+  gchar *addr_name;
+} DNSResolveRequest;
+
+static GStaticMutex dns_resolver_lock = G_STATIC_MUTEX_INIT;
+static GCond *dns_resolver_cond;
+static GQueue *dns_resolver_queue;
+static GHashTable *dns_resolver_pending;
+static gboolean dns_resolver_started;
+
+static void
+dns_resolve_request_free(DNSResolveRequest *req)
+{
+  g_sockaddr_unref(req->saddr);
+  g_free(req->addr_name);
+  g_free(req);
+}
+
+static gpointer
+dns_resolver_thread(gpointer arg)
+{
+  dns_cache_thread_init();
+  while (1)
+    {
+      DNSResolveRequest *req;
+      const gchar *hname;
+      gboolean positive;
+      gchar buf[256];
+
+      g_static_mutex_lock(&dns_resolver_lock);
+      while (g_queue_is_empty(dns_resolver_queue))
+        g_cond_wait(dns_resolver_cond, g_static_mutex_get_mutex(&dns_resolver_lock));
+      req = (DNSResolveRequest *) g_queue_pop_head(dns_resolver_queue);
+      g_static_mutex_unlock(&dns_resolver_lock);
+
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+      hname = resolve_address_using_getnameinfo(req->saddr, buf, sizeof(buf));
+#else
+      hname = resolve_address_using_gethostbyaddr(req->saddr, buf, sizeof(buf));
+#endif
+      positive = (hname != NULL);
+      if (!hname)
+        hname = req->addr_name;
+
+      /* negative results are published too, their shorter expiry keeps
+       * the address from being queued again for every message */
+      dns_cache_store_dynamic(req->saddr->sa.sa_family, sockaddr_to_dnscache_key(req->saddr), hname, positive);
+
+      g_static_mutex_lock(&dns_resolver_lock);
+      g_hash_table_remove(dns_resolver_pending, req->addr_name);
+      g_static_mutex_unlock(&dns_resolver_lock);
+      dns_resolve_request_free(req);
+    }
+  return NULL;
+}
+
+/* called with dns_resolver_lock held */
+static void
+dns_resolver_start_threads(void)
+{
+  gint i;
+
+  dns_resolver_cond = g_cond_new();
+  dns_resolver_queue = g_queue_new();
+  dns_resolver_pending = g_hash_table_new(g_str_hash, g_str_equal);
+  for (i = 0; i < DNS_RESOLVER_THREADS; i++)
+    {
+      if (!g_thread_create(dns_resolver_thread, NULL, FALSE, NULL))
+        {
+          msg_error("Error starting DNS resolver thread", NULL);
+          break;
+        }
+    }
+  dns_resolver_started = TRUE;
+}
+
+static void
+dns_resolve_sockaddr_in_background(GSockAddr *saddr)
+{
+  const gchar *addr_name = g_sockaddr_get_address_str(saddr);
+  DNSResolveRequest *req;
+
+  g_static_mutex_lock(&dns_resolver_lock);
+  if (!dns_resolver_started)
+    dns_resolver_start_threads();
+
+  /* one in-flight request per address; the cap bounds the queue under an
+   * address flood, dropped requests simply retry on a later message */
+  if (!g_hash_table_lookup(dns_resolver_pending, addr_name) &&
+      g_hash_table_size(dns_resolver_pending) < DNS_RESOLVER_MAX_PENDING)
+    {
+      req = g_new0(DNSResolveRequest, 1);
+      req->saddr = g_sockaddr_ref(saddr);
+      req->addr_name = g_strdup(addr_name);
+      g_hash_table_insert(dns_resolver_pending, req->addr_name, req);
+      g_queue_push_tail(dns_resolver_queue, req);
+      g_cond_signal(dns_resolver_cond);
+    }
+  g_static_mutex_unlock(&dns_resolver_lock);
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr, const HostResolveOptions *host_resolve_options)
 {
@@ -310,8 +452,30 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
 
   if (host_resolve_options->use_dns_cache)
     {
-      if (dns_cache_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive))
-        return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
+      guint variant = host_resolve_options_to_dnscache_variant(host_resolve_options);
+      gboolean cached;
+
+      /* the cache serves the options-applied form directly, memoized on
+       * the entry, so cache hits skip hostname_apply_options_fqdn() */
+      if (host_resolve_options->use_dns == 3)
+        cached = dns_cache_lookup_applied_no_wait(saddr->sa.sa_family, dnscache_key, variant, apply_options_to_cached_hostname, (gpointer) host_resolve_options, (const gchar **) &hname, &hname_len, &positive);
+      else
+        cached = dns_cache_lookup_applied(saddr->sa.sa_family, dnscache_key, variant, apply_options_to_cached_hostname, (gpointer) host_resolve_options, (const gchar **) &hname, &hname_len, &positive);
+      if (cached)
+        {
+          *result_len = hname_len;
+          return hname;
+        }
+    }
+
+  if (!hname && host_resolve_options->use_dns == 3)
+    {
+      /* async mode: hand the lookup to the resolver threads and use the
+       * numeric address until the cache is filled; the result is not
+       * cached here, that would mask the asynchronously stored answer */
+      dns_resolve_sockaddr_in_background(saddr);
+      hname = g_sockaddr_get_address_str(saddr);
+      return hostname_apply_options_fqdn(-1, result_len, hname, FALSE, host_resolve_options);
     }
 
   if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
@@ -326,7 +490,7 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
 
   if (!hname)
     {
-      hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
+      hname = g_sockaddr_get_address_str(saddr);
       positive = FALSE;
     }
   if (host_resolve_options->use_dns_cache)
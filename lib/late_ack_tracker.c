@@ -118,15 +118,11 @@ late_ack_tracker_track_msg(AckTracker *s, LogMessage *msg)
 }
 
 static void
-late_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type)
+_process_acked_range(LateAckTracker *self, AckType ack_type)
 {
-  LateAckTracker *self = (LateAckTracker *)s;
-  LateAckRecord *ack_rec = (LateAckRecord *)msg->ack_record;
   LateAckRecord *last_in_range = NULL;
   guint32 ack_range_length = 0;
 
-  ack_rec->acked = TRUE;
-
   _late_tracker_lock(self);
     {
       ack_range_length = _get_continuous_range_length(self);
@@ -143,11 +139,32 @@ late_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type
         }
     }
   _late_tracker_unlock(self);
+}
+
+static void
+late_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type)
+{
+  LateAckTracker *self = (LateAckTracker *)s;
+  LateAckRecord *ack_rec = (LateAckRecord *)msg->ack_record;
+
+  ack_rec->acked = TRUE;
+
+  /* while a batch is open on this thread only the acked flag is recorded
+   * above, the continuous-range scan and the bookmark save are done once
+   * for the whole batch from late_ack_tracker_batch_flush() */
+  if (!ack_tracker_batch_collect(s, ack_type))
+    _process_acked_range(self, ack_type);
 
   log_msg_unref(msg);
   log_pipe_unref((LogPipe *)self->super.source);
 }
 
+static void
+late_ack_tracker_batch_flush(AckTracker *s, gint count, AckType ack_type)
+{
+  _process_acked_range((LateAckTracker *)s, ack_type);
+}
+
 static Bookmark *
 late_ack_tracker_request_bookmark(AckTracker *s)
 {
@@ -180,6 +197,7 @@ late_ack_tracker_init_instance(LateAckTracker *self, LogSource *source)
   self->super.request_bookmark = late_ack_tracker_request_bookmark;
   self->super.track_msg = late_ack_tracker_track_msg;
   self->super.manage_msg_ack = late_ack_tracker_manage_msg_ack;
+  self->super.batch_flush = late_ack_tracker_batch_flush;
   ring_buffer_alloc(&self->ack_record_storage, sizeof(LateAckRecord), log_source_get_init_window_size(source));
   g_static_mutex_init(&self->storage_mutex);
 }
@@ -26,6 +26,9 @@
 #include "messages.h"
 #include "cfg.h"
 #include "misc.h"
+#include "utf8utils.h"
+#include "stats/stats-registry.h"
+#include "tls-support.h"
 #include "compat/string.h"
 
 #include <pcre.h>
@@ -418,7 +421,7 @@ log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const
 {
   LogMatcherGlob *self =  (LogMatcherGlob *) s;
   
-  if (G_LIKELY((msg->flags & LF_UTF8) || g_utf8_validate(value, value_len, NULL)))
+  if (G_LIKELY((msg->flags & LF_UTF8) || validate_utf8(value, value_len)))
     {
       static gboolean warned = FALSE;
       gchar *buf;
@@ -471,8 +474,57 @@ typedef struct _LogMatcherPcreRe
   pcre *pattern;
   pcre_extra *extra;
   gint match_options;
+  /* capture count queried once at compile time, clamped to RE_MAX_MATCHES */
+  gint capture_count;
+  gboolean jit_compiled;
 } LogMatcherPcreRe;
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+
+/* number of pcre_exec() calls running JIT compiled code */
+static StatsCounterItem *count_pcre_jit_matches;
+
+TLS_BLOCK_START
+{
+  pcre_jit_stack *pcre_thread_jit_stack;
+}
+TLS_BLOCK_END;
+
+#define pcre_thread_jit_stack  __tls_deref(pcre_thread_jit_stack)
+
+/* one persistent JIT stack per thread is enough, a pattern only uses it
+ * for the duration of a pcre_exec() call; the default machine stack
+ * frame is a mere 32k, which makes complex patterns bail out of JIT on
+ * long messages */
+static pcre_jit_stack *
+log_matcher_pcre_re_get_jit_stack(void *arg)
+{
+  if (!pcre_thread_jit_stack)
+    pcre_thread_jit_stack = pcre_jit_stack_alloc(32 * 1024, 512 * 1024);
+  return pcre_thread_jit_stack;
+}
+
+/* ivykis reaps idle worker threads, releasing the JIT stack here keeps
+ * its reserved address space from being stranded with them */
+void
+log_matcher_thread_deinit(void)
+{
+  if (pcre_thread_jit_stack)
+    {
+      pcre_jit_stack_free(pcre_thread_jit_stack);
+      pcre_thread_jit_stack = NULL;
+    }
+}
+
+#else
+
+void
+log_matcher_thread_deinit(void)
+{
+}
+
+#endif
+
 static gboolean
 log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
 {
@@ -536,6 +588,33 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
       return FALSE;
     }
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (self->extra)
+    {
+      gint jit = 0;
+
+      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_JIT, &jit);
+      self->jit_compiled = !!jit;
+      if (self->jit_compiled)
+        {
+          pcre_assign_jit_stack(self->extra, log_matcher_pcre_re_get_jit_stack, NULL);
+          if (!count_pcre_jit_matches)
+            {
+              stats_lock();
+              stats_register_counter(0, SCS_GLOBAL, "pcre_jit_matches", NULL, SC_TYPE_PROCESSED, &count_pcre_jit_matches);
+              stats_unlock();
+            }
+        }
+    }
+#endif
+
+  /* cache the capture count so the match path doesn't have to query it
+   * for every message */
+  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &self->capture_count) < 0)
+    g_assert_not_reached();
+  if (self->capture_count > RE_MAX_MATCHES)
+    self->capture_count = RE_MAX_MATCHES;
+
   return TRUE;
 }
 
@@ -600,16 +679,16 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
   if (value_len == -1)
     value_len = strlen(value);
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
+  num_matches = self->capture_count;
   matches_size = 3 * (num_matches + 1);
   matches = g_alloca(matches_size * sizeof(gint));
 
   rc = pcre_exec(self->pattern, self->extra,
                  value, value_len, 0, self->match_options, matches, matches_size);
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (self->jit_compiled)
+    stats_counter_inc(count_pcre_jit_matches);
+#endif
   if (rc < 0)
     {
       switch (rc)
@@ -654,11 +733,7 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
   gint options;
   gboolean last_match_was_empty;
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
+  num_matches = self->capture_count;
   matches_size = 3 * (num_matches + 1);
   matches = g_alloca(matches_size * sizeof(gint));
 
@@ -712,6 +787,10 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
       rc = pcre_exec(self->pattern, self->extra,
                      value, value_len,
                      start_offset, (self->match_options | options), matches, matches_size);
+#ifdef PCRE_STUDY_JIT_COMPILE
+      if (self->jit_compiled)
+        stats_counter_inc(count_pcre_jit_matches);
+#endif
       if (rc < 0 && rc != PCRE_ERROR_NOMATCH)
         {
           msg_error("Error while matching regexp",
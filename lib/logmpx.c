@@ -23,7 +23,110 @@
  */
 
 #include "logmpx.h"
+#include "cfg.h"
+#include "cfg-tree.h"
+#include "logqueue-fifo.h"
+#include "mainloop.h"
+#include "mainloop-call.h"
+#include "mainloop-io-worker.h"
+#include "messages.h"
+#include "stats/stats-registry.h"
 
+/*
+ * State of a branch that was forked off to the worker thread pool with
+ * flags(threaded).  Messages are queued into a per-branch fifo by
+ * whichever thread runs the multiplexer and drained in order by a single
+ * outstanding worker job, so independent log paths get their
+ * filter/rewrite/template work spread across cores while per-branch
+ * ordering is retained.
+ */
+typedef struct _LogMultiplexerBranch
+{
+  LogMultiplexer *mpx;
+  LogPipe *head;
+  LogQueue *queue;
+  MainLoopIOWorkerJob job;
+} LogMultiplexerBranch;
+
+static void log_multiplexer_branch_schedule(LogMultiplexerBranch *branch);
+
+/* runs in a worker thread of the main loop I/O pool */
+static void
+log_multiplexer_branch_work(gpointer user_data)
+{
+  LogMultiplexerBranch *branch = (LogMultiplexerBranch *) user_data;
+  LogMessage *msg;
+
+  for (;;)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+      msg = log_queue_pop_head(branch->queue, &path_options);
+      if (!msg)
+        break;
+
+      /* cache ref/ack updates for the duration of the branch traversal,
+       * the worker thread has no refcache window of its own */
+      log_msg_refcache_start_consumer(msg, &path_options);
+      log_pipe_queue(branch->head, msg, &path_options);
+      log_msg_refcache_stop();
+    }
+}
+
+/* invoked via main_loop_call() whenever the branch queue goes
+ * non-empty; runs in the main thread */
+static void
+log_multiplexer_branch_wakeup(LogMultiplexerBranch *branch)
+{
+  log_multiplexer_branch_schedule(branch);
+}
+
+static void
+log_multiplexer_branch_notify(gpointer user_data)
+{
+  main_loop_call((MainLoopTaskFunc) log_multiplexer_branch_wakeup, user_data, FALSE);
+}
+
+/* NOTE: runs in the main thread, either from the queue wakeup above or
+ * as the completion callback of the previous drain job */
+static void
+log_multiplexer_branch_schedule(LogMultiplexerBranch *branch)
+{
+  gint timeout_msec = 0;
+
+  main_loop_assert_main_thread();
+
+  if (!(branch->mpx->super.flags & PIF_INITIALIZED))
+    return;
+  if (branch->job.working)
+    return;
+
+  if (log_queue_check_items(branch->queue, &timeout_msec,
+                            log_multiplexer_branch_notify, branch, NULL))
+    main_loop_io_worker_job_submit(&branch->job);
+}
+
+static LogMultiplexerBranch *
+log_multiplexer_branch_new(LogMultiplexer *mpx, LogPipe *head)
+{
+  LogMultiplexerBranch *branch = g_new0(LogMultiplexerBranch, 1);
+
+  branch->mpx = mpx;
+  branch->head = head;
+  branch->queue = log_queue_fifo_new(mpx->super.cfg->log_fifo_size, NULL);
+  main_loop_io_worker_job_init(&branch->job);
+  branch->job.work = log_multiplexer_branch_work;
+  branch->job.completion = (void (*)(gpointer)) log_multiplexer_branch_schedule;
+  branch->job.user_data = branch;
+  return branch;
+}
+
+static void
+log_multiplexer_branch_free(LogMultiplexerBranch *branch)
+{
+  log_queue_unref(branch->queue);
+  g_free(branch);
+}
 
 void
 log_multiplexer_add_next_hop(LogMultiplexer *self, LogPipe *next_hop)
@@ -31,6 +134,115 @@ log_multiplexer_add_next_hop(LogMultiplexer *self, LogPipe *next_hop)
   g_ptr_array_add(self->next_hops, next_hop);
 }
 
+/*
+ * Per-path byte throughput accounting (stats level 2).
+ *
+ * Each next-hop of the multiplexer is attributed to the log statement it
+ * belongs to and the bytes of every message delivered into that branch
+ * are accumulated in a (center, <rule>, queued_bytes) cluster.  The same
+ * named path referenced from several sources shares a single cluster
+ * through the usual registration refcounting.  The counters are sharded,
+ * as the multiplexer runs in every reader thread and the per-message
+ * atomic adds of many threads would bounce the same cache line around.
+ *
+ * The accounted size is the name-value payload in use (msg->payload->used),
+ * which covers all stored values (MESSAGE, HOST, PROGRAM, SDATA, ...) and
+ * is available without rendering the message.
+ */
+
+typedef struct _LogMultiplexerBranchStats
+{
+  gchar *stats_id;
+  StatsCounterItem *queued_bytes;
+  StatsCounterShards *queued_bytes_shards;
+} LogMultiplexerBranchStats;
+
+static gchar *
+log_multiplexer_get_branch_stats_id(LogPipe *branch_head)
+{
+  LogExprNode *rule;
+  gchar buf[128];
+
+  if (!branch_head->expr_node)
+    return NULL;
+
+  /* the topmost ENC_PIPE ancestor is the log statement this branch
+   * belongs to; anonymous log statements are identified by their
+   * location in the configuration */
+  rule = log_expr_node_get_container_rule(branch_head->expr_node, ENC_PIPE);
+  if (!rule)
+    rule = branch_head->expr_node;
+  if (rule->name)
+    return g_strdup(rule->name);
+  return g_strdup(log_expr_node_format_location(rule, buf, sizeof(buf)));
+}
+
+static void
+log_multiplexer_register_branch_stats(LogMultiplexer *self)
+{
+  gint i;
+
+  g_ptr_array_set_size(self->branch_stats, self->next_hops->len);
+  stats_lock();
+  for (i = 0; i < self->next_hops->len; i++)
+    {
+      LogPipe *branch_head = g_ptr_array_index(self->next_hops, i);
+      LogMultiplexerBranchStats *stats;
+      gchar *stats_id;
+
+      if (g_ptr_array_index(self->branch_stats, i))
+        continue;
+
+      stats_id = log_multiplexer_get_branch_stats_id(branch_head);
+      if (!stats_id)
+        continue;
+
+      stats = g_new0(LogMultiplexerBranchStats, 1);
+      stats->stats_id = stats_id;
+      stats_register_counter(2, SCS_CENTER, stats->stats_id, "queued_bytes", SC_TYPE_PROCESSED, &stats->queued_bytes);
+      if (stats->queued_bytes)
+        stats->queued_bytes_shards = stats_counter_shards_new(stats->queued_bytes);
+      g_ptr_array_index(self->branch_stats, i) = stats;
+    }
+  stats_unlock();
+}
+
+static void
+log_multiplexer_unregister_branch_stats(LogMultiplexer *self)
+{
+  gint i;
+
+  stats_lock();
+  for (i = 0; i < self->branch_stats->len; i++)
+    {
+      LogMultiplexerBranchStats *stats = g_ptr_array_index(self->branch_stats, i);
+
+      if (!stats)
+        continue;
+
+      stats_counter_shards_free(stats->queued_bytes_shards);
+      stats->queued_bytes_shards = NULL;
+      stats_unregister_counter(SCS_CENTER, stats->stats_id, "queued_bytes", SC_TYPE_PROCESSED, &stats->queued_bytes);
+      g_free(stats->stats_id);
+      g_free(stats);
+      g_ptr_array_index(self->branch_stats, i) = NULL;
+    }
+  stats_unlock();
+}
+
+static inline void
+log_multiplexer_count_branch_bytes(LogMultiplexer *self, gint i, gsize msg_size)
+{
+  LogMultiplexerBranchStats *stats;
+
+  if (self->branch_stats->len <= i)
+    return;
+
+  stats = g_ptr_array_index(self->branch_stats, i);
+  if (stats)
+    stats_counter_shards_add(stats->queued_bytes_shards, msg_size);
+}
+
 static gboolean
 log_multiplexer_init(LogPipe *s)
 {
@@ -46,18 +258,63 @@ log_multiplexer_init(LogPipe *s)
         {
           branch_head->flags |= (p->flags & PIF_BRANCH_PROPERTIES);
         }
-          
+
       if (branch_head->flags & PIF_BRANCH_FALLBACK)
         {
           self->fallback_exists = TRUE;
         }
     }
+
+  g_ptr_array_set_size(self->threaded_branches, self->next_hops->len);
+  for (i = 0; i < self->next_hops->len; i++)
+    {
+      LogPipe *branch_head = g_ptr_array_index(self->next_hops, i);
+
+      if ((branch_head->flags & PIF_BRANCH_THREADED) == 0)
+        continue;
+
+      /* final/fallback need the synchronous match result of the branch,
+       * which an asynchronously processed branch cannot provide */
+      if (self->fallback_exists || (branch_head->flags & PIF_BRANCH_PROPERTIES))
+        {
+          msg_warning("flags(threaded) cannot be combined with final/fallback branches, processing synchronously",
+                      NULL);
+          continue;
+        }
+
+      if (g_ptr_array_index(self->threaded_branches, i) == NULL)
+        g_ptr_array_index(self->threaded_branches, i) = log_multiplexer_branch_new(self, branch_head);
+
+      /* wake up the drain job on the first message making the queue
+       * non-empty, log_queue_check_items() re-registers this callback
+       * whenever the job runs out of work */
+      log_queue_set_parallel_push(((LogMultiplexerBranch *) g_ptr_array_index(self->threaded_branches, i))->queue,
+                                  log_multiplexer_branch_notify,
+                                  g_ptr_array_index(self->threaded_branches, i), NULL);
+    }
+  log_multiplexer_register_branch_stats(self);
   return TRUE;
 }
 
-static gboolean 
-log_multiplexer_deinit(LogPipe *self)
+static gboolean
+log_multiplexer_deinit(LogPipe *s)
 {
+  LogMultiplexer *self = (LogMultiplexer *) s;
+  gint i;
+
+  /* NOTE: worker jobs have finished by the time the configuration is
+   * deinitialized, only the queue wakeups are unregistered here; the
+   * branch state itself is kept until the pipe is freed so that a
+   * pending wakeup posted right before deinit finds valid memory (it
+   * bails out on the missing PIF_INITIALIZED flag) */
+  for (i = 0; i < self->threaded_branches->len; i++)
+    {
+      LogMultiplexerBranch *branch = g_ptr_array_index(self->threaded_branches, i);
+
+      if (branch)
+        log_queue_reset_parallel_push(branch->queue);
+    }
+  log_multiplexer_unregister_branch_stats(self);
   return TRUE;
 }
 
@@ -70,9 +327,22 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
   gboolean matched;
   gboolean delivered = FALSE;
   gboolean last_delivery;
+  gboolean refcache_started = FALSE;
   gint fallback;
-  
+  gsize msg_size = msg->payload->used;
+
   local_options.matched = &matched;
+
+  /* each delivery below performs a ref/add_ack pair on the message; when
+   * the caller hasn't established a refcache window (e.g. messages
+   * injected outside of the reader fastpath), open a consumer window so
+   * the whole fan-out folds into a single atomic update instead of one
+   * per branch */
+  if (self->next_hops->len > 1 && !log_msg_refcache_is_active())
+    {
+      log_msg_refcache_start_consumer(msg, path_options);
+      refcache_started = TRUE;
+    }
   for (fallback = 0; (fallback == 0) || (fallback == 1 && self->fallback_exists && !delivered); fallback++)
     {
       for (i = 0; i < self->next_hops->len; i++)
@@ -88,9 +358,28 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
               continue;
             }
 
+          if (G_UNLIKELY(self->threaded_branches->len > i &&
+                         g_ptr_array_index(self->threaded_branches, i)))
+            {
+              LogMultiplexerBranch *branch = g_ptr_array_index(self->threaded_branches, i);
+              LogPathOptions branch_options = *path_options;
+
+              /* the branch is processed asynchronously: its match result
+               * cannot influence the fallback logic (checked at init
+               * time) and the message is left write protected so that
+               * concurrent branches trigger copy-on-write */
+              branch_options.matched = NULL;
+              log_msg_add_ack(msg, &branch_options);
+              log_msg_write_protect(msg);
+              log_queue_push_tail(branch->queue, log_msg_ref(msg), &branch_options);
+              log_multiplexer_count_branch_bytes(self, i, msg_size);
+              delivered = TRUE;
+              continue;
+            }
+
           matched = TRUE;
           log_msg_add_ack(msg, &local_options);
-          
+
           /* NOTE: this variable indicates that the upcoming message
            * delivery is the last one, thus we don't need to retain an an
            * unmodified copy to be sent to further paths.  The current
@@ -106,6 +395,7 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
           log_pipe_queue(next_hop, log_msg_ref(msg), &local_options);
           if (!last_delivery)
             log_msg_write_unprotect(msg);
+          log_multiplexer_count_branch_bytes(self, i, msg_size);
           
           if (matched)
             {
@@ -116,13 +406,25 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
         }
     }
   log_pipe_forward_msg(s, msg, path_options);
+  if (refcache_started)
+    log_msg_refcache_stop();
 }
 
 static void
 log_multiplexer_free(LogPipe *s)
 {
   LogMultiplexer *self = (LogMultiplexer *) s;
+  gint i;
 
+  for (i = 0; i < self->threaded_branches->len; i++)
+    {
+      LogMultiplexerBranch *branch = g_ptr_array_index(self->threaded_branches, i);
+
+      if (branch)
+        log_multiplexer_branch_free(branch);
+    }
+  g_ptr_array_free(self->threaded_branches, TRUE);
+  g_ptr_array_free(self->branch_stats, TRUE);
   g_ptr_array_free(self->next_hops, TRUE);
   log_pipe_free_method(s);
 }
@@ -138,5 +440,7 @@ log_multiplexer_new(GlobalConfig *cfg)
   self->super.queue = log_multiplexer_queue;
   self->super.free_fn = log_multiplexer_free;
   self->next_hops = g_ptr_array_new();
+  self->threaded_branches = g_ptr_array_new();
+  self->branch_stats = g_ptr_array_new();
   return self;
 }
@@ -40,6 +40,12 @@ typedef struct _LogMultiplexer
 {
   LogPipe super;
   GPtrArray *next_hops;
+  /* per next-hop state for branches forked off to the worker thread
+   * pool, NULL entries mean the branch is processed synchronously */
+  GPtrArray *threaded_branches;
+  /* per next-hop byte throughput counters, indexed in parallel with
+   * next_hops; empty unless the stats level enables them */
+  GPtrArray *branch_stats;
   gboolean fallback_exists;
 } LogMultiplexer;
 
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg.h"
+#include "serialize.h"
+#include "nvtable.h"
+#include "memusage.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * On-disk representation of a LogMessage, used by the disk based queue
+ * and potentially by any other component that needs to move messages
+ * across a process restart.
+ *
+ * The frame starts with a version byte so the layout can evolve without
+ * breaking queue files written by earlier binaries.  All scalar fields
+ * are stored as varints (see serialize_write_varint()), which makes the
+ * typical frame dominated by the actual name-value payload instead of
+ * fixed width headers.
+ *
+ * The NVTable payload is written as a single block copy: its internal
+ * references are offsets relative to the end of the table, so the stored
+ * bytes are valid in any process once the table header is recreated
+ * around them.  The only components that do NOT survive a block copy are
+ * NVHandle values and tag ids, both of which are assigned in registration
+ * order and thus differ between processes (and even between two runs of
+ * the same binary with a different config).  Tags are therefore stored by
+ * name, and dynamic handles are remapped on read using the entry names
+ * that already travel inside the payload block.
+ */
+
+#define LOG_MSG_SERIALIZE_VERSION 2
+
+static guint64
+_zigzag_encode(gint64 value)
+{
+  return ((guint64) value << 1) ^ (guint64) (value >> 63);
+}
+
+static gint64
+_zigzag_decode(guint64 value)
+{
+  return (gint64) (value >> 1) ^ -((gint64) (value & 1));
+}
+
+static gboolean
+log_msg_write_stamp(LogStamp *stamp, SerializeArchive *sa)
+{
+  /* tv_sec is zigzag encoded as unset stamps carry -1 */
+  return serialize_write_varint(sa, _zigzag_encode(stamp->tv_sec)) &&
+         serialize_write_varint(sa, stamp->tv_usec) &&
+         serialize_write_varint(sa, _zigzag_encode(stamp->zone_offset));
+}
+
+static gboolean
+log_msg_read_stamp(LogStamp *stamp, SerializeArchive *sa)
+{
+  guint64 sec, usec, zone;
+
+  if (!serialize_read_varint(sa, &sec) ||
+      !serialize_read_varint(sa, &usec) ||
+      !serialize_read_varint(sa, &zone))
+    return FALSE;
+  stamp->tv_sec = _zigzag_decode(sec);
+  stamp->tv_usec = usec;
+  stamp->zone_offset = _zigzag_decode(zone);
+  return TRUE;
+}
+
+static gboolean
+log_msg_write_sockaddr(GSockAddr *addr, SerializeArchive *sa)
+{
+  if (!addr)
+    return serialize_write_uint8(sa, AF_UNSPEC);
+
+  switch (addr->sa.sa_family)
+    {
+    case AF_INET:
+      {
+        struct sockaddr_in *sin = (struct sockaddr_in *) &addr->sa;
+
+        return serialize_write_uint8(sa, AF_INET) &&
+               serialize_write_blob(sa, &sin->sin_addr, sizeof(sin->sin_addr)) &&
+               serialize_write_uint16(sa, ntohs(sin->sin_port));
+      }
+#if SYSLOG_NG_ENABLE_IPV6
+    case AF_INET6:
+      {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &addr->sa;
+
+        return serialize_write_uint8(sa, AF_INET6) &&
+               serialize_write_blob(sa, &sin6->sin6_addr, sizeof(sin6->sin6_addr)) &&
+               serialize_write_uint16(sa, ntohs(sin6->sin6_port));
+      }
+#endif
+    default:
+      /* AF_UNIX peers are meaningless once the connection is gone */
+      return serialize_write_uint8(sa, AF_UNSPEC);
+    }
+}
+
+static gboolean
+log_msg_read_sockaddr(GSockAddr **addr, SerializeArchive *sa)
+{
+  guint8 family;
+  guint16 port;
+
+  if (!serialize_read_uint8(sa, &family))
+    return FALSE;
+  switch (family)
+    {
+    case AF_UNSPEC:
+      *addr = NULL;
+      return TRUE;
+    case AF_INET:
+      {
+        struct sockaddr_in sin;
+
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        if (!serialize_read_blob(sa, &sin.sin_addr, sizeof(sin.sin_addr)) ||
+            !serialize_read_uint16(sa, &port))
+          return FALSE;
+        sin.sin_port = htons(port);
+        *addr = g_sockaddr_inet_new2(&sin);
+        return TRUE;
+      }
+    case AF_INET6:
+      {
+#if SYSLOG_NG_ENABLE_IPV6
+        struct sockaddr_in6 sin6;
+
+        memset(&sin6, 0, sizeof(sin6));
+        sin6.sin6_family = AF_INET6;
+        if (!serialize_read_blob(sa, &sin6.sin6_addr, sizeof(sin6.sin6_addr)) ||
+            !serialize_read_uint16(sa, &port))
+          return FALSE;
+        sin6.sin6_port = htons(port);
+        *addr = g_sockaddr_inet6_new2(&sin6);
+        return TRUE;
+#else
+        gchar addr_bytes[16];
+
+        /* written by an ipv6 enabled binary, skip the address */
+        if (!serialize_read_blob(sa, addr_bytes, sizeof(addr_bytes)) ||
+            !serialize_read_uint16(sa, &port))
+          return FALSE;
+        *addr = NULL;
+        return TRUE;
+#endif
+      }
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+log_msg_write_tag_cb(const LogMessage *self, LogTagId tag_id, const gchar *name, gpointer user_data)
+{
+  SerializeArchive *sa = (SerializeArchive *) user_data;
+
+  serialize_write_cstring(sa, name, -1);
+  return FALSE;
+}
+
+static gboolean
+log_msg_count_tag_cb(const LogMessage *self, LogTagId tag_id, const gchar *name, gpointer user_data)
+{
+  guint64 *count = (guint64 *) user_data;
+
+  (*count)++;
+  return FALSE;
+}
+
+static gboolean
+log_msg_write_tags(LogMessage *self, SerializeArchive *sa)
+{
+  guint64 count = 0;
+
+  /* tag ids are assigned in registration order and do not survive a
+   * restart, so the names are stored instead of the bit vector */
+  log_msg_tags_foreach(self, log_msg_count_tag_cb, &count);
+  if (!serialize_write_varint(sa, count))
+    return FALSE;
+  log_msg_tags_foreach(self, log_msg_write_tag_cb, sa);
+  return sa->error == NULL;
+}
+
+static gboolean
+log_msg_read_tags(LogMessage *self, SerializeArchive *sa)
+{
+  guint64 count;
+  gchar *name;
+
+  if (!serialize_read_varint(sa, &count))
+    return FALSE;
+  while (count--)
+    {
+      if (!serialize_read_cstring(sa, &name, NULL))
+        return FALSE;
+      log_msg_set_tag_by_name(self, name);
+      g_free(name);
+    }
+  return TRUE;
+}
+
+static gboolean
+log_msg_write_payload(NVTable *payload, SerializeArchive *sa)
+{
+  NVDynValue *dyn_entries = nv_table_get_dyn_entries(payload);
+  NVHandle prev_handle = 0;
+  gint i;
+
+  serialize_write_uint8(sa, payload->num_static_entries);
+  serialize_write_varint(sa, payload->num_dyn_entries);
+  serialize_write_varint(sa, payload->used);
+
+  for (i = 0; i < payload->num_static_entries; i++)
+    serialize_write_varint(sa, payload->static_entries[i]);
+
+  /* the array is sorted by handle, so the deltas stay small */
+  for (i = 0; i < payload->num_dyn_entries; i++)
+    {
+      serialize_write_varint(sa, dyn_entries[i].handle - prev_handle);
+      serialize_write_varint(sa, dyn_entries[i].ofs);
+      prev_handle = dyn_entries[i].handle;
+    }
+
+  return serialize_write_blob(sa, nv_table_get_top(payload) - payload->used, payload->used);
+}
+
+static gint
+_dyn_value_cmp(const void *p1, const void *p2)
+{
+  const NVDynValue *dv1 = (const NVDynValue *) p1;
+  const NVDynValue *dv2 = (const NVDynValue *) p2;
+
+  if (dv1->handle < dv2->handle)
+    return -1;
+  return dv1->handle == dv2->handle ? 0 : 1;
+}
+
+/* look up the handle @old got remapped to; @old_handles is ascending as
+ * it was saved in the sorted order of the writer process */
+static NVHandle
+log_msg_remap_handle(NVHandle old, NVHandle *old_handles, NVHandle *new_handles, gint num)
+{
+  gint lo = 0, hi = num - 1;
+
+  while (lo <= hi)
+    {
+      gint mid = (lo + hi) >> 1;
+
+      if (old_handles[mid] < old)
+        lo = mid + 1;
+      else if (old_handles[mid] > old)
+        hi = mid - 1;
+      else
+        return new_handles[mid];
+    }
+  return 0;
+}
+
+/* interned entries reference the string pool of the writer process, their
+ * id means nothing here; log_msg_write() inlines them, so one only shows
+ * up if that copy failed (or the frame is corrupt), degrade it to an
+ * empty value instead of interpreting the id as string bytes */
+static void
+log_msg_read_demote_interned_entry(NVEntry *entry)
+{
+  if (G_LIKELY(!entry->interned))
+    return;
+  entry->interned = 0;
+  memmove(entry->vdirect.data, entry->vinterned.name, entry->name_len + 1);
+  entry->vdirect.value_len = 0;
+  entry->vdirect.data[entry->name_len + 1] = 0;
+}
+
+/*
+ * Rewrite the registration order dependent NVHandle values stored in
+ * @payload to the ones valid in this process.  The names needed for the
+ * translation are already present in the copied block: each dynamic
+ * NVEntry carries its own name.  Indirect entries additionally reference
+ * the entry they borrow their value from by handle, those references are
+ * translated through the same map.
+ */
+static gboolean
+log_msg_read_remap_payload(NVTable *payload, NVHandle *old_handles, NVHandle *new_handles)
+{
+  NVDynValue *dyn_entries = nv_table_get_dyn_entries(payload);
+  gint num_dyn = payload->num_dyn_entries;
+  NVEntry *entry;
+  gint i;
+
+  for (i = 0; i < num_dyn; i++)
+    {
+      entry = nv_table_get_entry_at_ofs(payload, dyn_entries[i].ofs);
+      if (!entry)
+        return FALSE;
+      log_msg_read_demote_interned_entry(entry);
+      old_handles[i] = dyn_entries[i].handle;
+      new_handles[i] = log_msg_get_value_handle(nv_entry_get_name(entry));
+      if (!new_handles[i])
+        return FALSE;
+    }
+
+  for (i = 0; i < num_dyn; i++)
+    dyn_entries[i].handle = new_handles[i];
+
+  /* remapping may change the relative order of the handles */
+  qsort(dyn_entries, num_dyn, sizeof(dyn_entries[0]), _dyn_value_cmp);
+
+  for (i = 0; i < payload->num_static_entries; i++)
+    {
+      entry = nv_table_get_entry_at_ofs(payload, payload->static_entries[i]);
+      if (entry)
+        log_msg_read_demote_interned_entry(entry);
+      if (entry && entry->indirect && entry->vindirect.handle > payload->num_static_entries)
+        {
+          entry->vindirect.handle = log_msg_remap_handle(entry->vindirect.handle, old_handles, new_handles, num_dyn);
+          if (!entry->vindirect.handle)
+            return FALSE;
+        }
+    }
+  for (i = 0; i < num_dyn; i++)
+    {
+      entry = nv_table_get_entry_at_ofs(payload, dyn_entries[i].ofs);
+      if (entry->indirect && entry->vindirect.handle > payload->num_static_entries)
+        {
+          entry->vindirect.handle = log_msg_remap_handle(entry->vindirect.handle, old_handles, new_handles, num_dyn);
+          if (!entry->vindirect.handle)
+            return FALSE;
+        }
+    }
+  return TRUE;
+}
+
+static NVTable *
+log_msg_read_payload(SerializeArchive *sa)
+{
+  NVTable *payload;
+  NVDynValue *dyn_entries;
+  guint8 num_static_entries;
+  guint64 num_dyn_entries, used, ofs, handle_delta;
+  NVHandle prev_handle = 0;
+  gsize size;
+  gint i;
+
+  if (!serialize_read_uint8(sa, &num_static_entries) ||
+      !serialize_read_varint(sa, &num_dyn_entries) ||
+      !serialize_read_varint(sa, &used))
+    return NULL;
+
+  /* the static part of the layout is compiled in, a frame written with a
+   * different set of builtin values cannot be block copied */
+  if (num_static_entries != LM_V_MAX ||
+      num_dyn_entries > G_MAXUINT16 ||
+      used > NV_TABLE_MAX_BYTES)
+    return NULL;
+
+  size = NV_TABLE_BOUND(used) +
+         NV_TABLE_BOUND(sizeof(NVTable) + num_static_entries * sizeof(payload->static_entries[0]) + num_dyn_entries * sizeof(NVDynValue));
+  if (size < 128)
+    size = 128;
+  if (size > NV_TABLE_MAX_BYTES)
+    return NULL;
+  payload = g_malloc(size);
+  memusage_count_alloc(MEMUSAGE_NVTABLE, size);
+  payload->size = size;
+  payload->used = used;
+  payload->num_dyn_entries = num_dyn_entries;
+  payload->num_static_entries = num_static_entries;
+  payload->ref_cnt = 1;
+  payload->borrowed = FALSE;
+
+  for (i = 0; i < num_static_entries; i++)
+    {
+      if (!serialize_read_varint(sa, &ofs) || ofs > used)
+        goto error;
+      payload->static_entries[i] = ofs;
+    }
+
+  dyn_entries = nv_table_get_dyn_entries(payload);
+  for (i = 0; i < num_dyn_entries; i++)
+    {
+      if (!serialize_read_varint(sa, &handle_delta) ||
+          !serialize_read_varint(sa, &ofs) ||
+          ofs == 0 || ofs > used || (ofs & 0x3))
+        goto error;
+      dyn_entries[i].handle = prev_handle + handle_delta;
+      dyn_entries[i].ofs = ofs;
+      prev_handle = dyn_entries[i].handle;
+    }
+
+  if (!serialize_read_blob(sa, nv_table_get_top(payload) - used, used))
+    goto error;
+  return payload;
+
+ error:
+  nv_table_unref(payload);
+  return NULL;
+}
+
+gboolean
+log_msg_write(LogMessage *self, SerializeArchive *sa)
+{
+  NVTable *payload, *materialized;
+  gboolean success;
+  gint i;
+
+  /* an unmerged payload overlay would be invisible to
+   * log_msg_write_payload(), fold it into an owned payload first */
+  if (self->payload_overlay)
+    log_msg_merge_overlay(self);
+
+  serialize_write_uint8(sa, LOG_MSG_SERIALIZE_VERSION);
+  serialize_write_varint(sa, self->flags & ~LF_STATE_MASK);
+  serialize_write_varint(sa, self->pri);
+  serialize_write_varint(sa, self->host_id);
+  serialize_write_varint(sa, self->rcptid);
+  serialize_write_uint8(sa, self->num_matches);
+
+  for (i = 0; i < LM_TS_MAX; i++)
+    {
+      if (!log_msg_write_stamp(&self->timestamps[i], sa))
+        return FALSE;
+    }
+
+  if (!log_msg_write_sockaddr(self->saddr, sa))
+    return FALSE;
+  if (!log_msg_write_tags(self, sa))
+    return FALSE;
+
+  /* sdata entries are saved by their handle in the writer process, the
+   * reader translates them through the same map it uses for the payload */
+  serialize_write_varint(sa, self->num_sdata);
+  for (i = 0; i < self->num_sdata; i++)
+    serialize_write_varint(sa, self->sdata[i]);
+
+  /* interned entries reference the process-wide string pool by id, which
+   * the reader cannot resolve, write a copy with the values inlined */
+  payload = self->payload;
+  materialized = nv_table_materialize_interned(payload);
+  if (materialized)
+    payload = materialized;
+
+  success = log_msg_write_payload(payload, sa);
+  if (materialized)
+    nv_table_unref(materialized);
+  return success;
+}
+
+gboolean
+log_msg_read(LogMessage *self, SerializeArchive *sa)
+{
+  NVTable *payload;
+  NVHandle *old_handles, *new_handles;
+  guint64 flags, pri, host_id, rcptid, num_sdata, handle;
+  guint8 version, num_matches;
+  gboolean success;
+  gint i;
+
+  if (!serialize_read_uint8(sa, &version) || version != LOG_MSG_SERIALIZE_VERSION)
+    return FALSE;
+
+  if (!serialize_read_varint(sa, &flags) ||
+      !serialize_read_varint(sa, &pri) ||
+      !serialize_read_varint(sa, &host_id) ||
+      !serialize_read_varint(sa, &rcptid) ||
+      !serialize_read_uint8(sa, &num_matches))
+    return FALSE;
+
+  self->flags = flags | LF_STATE_OWN_MASK;
+  self->pri = pri;
+  self->host_id = host_id;
+  self->rcptid = rcptid;
+  self->num_matches = num_matches;
+
+  for (i = 0; i < LM_TS_MAX; i++)
+    {
+      if (!log_msg_read_stamp(&self->timestamps[i], sa))
+        return FALSE;
+    }
+
+  if (self->saddr)
+    {
+      g_sockaddr_unref(self->saddr);
+      self->saddr = NULL;
+    }
+  if (!log_msg_read_sockaddr(&self->saddr, sa))
+    return FALSE;
+  if (!log_msg_read_tags(self, sa))
+    return FALSE;
+
+  if (!serialize_read_varint(sa, &num_sdata) || num_sdata > 255)
+    return FALSE;
+  self->sdata = g_realloc(self->sdata, num_sdata * sizeof(self->sdata[0]));
+  self->alloc_sdata = num_sdata;
+  self->num_sdata = num_sdata;
+  for (i = 0; i < num_sdata; i++)
+    {
+      if (!serialize_read_varint(sa, &handle))
+        return FALSE;
+      self->sdata[i] = handle;
+    }
+
+  payload = log_msg_read_payload(sa);
+  if (!payload)
+    return FALSE;
+
+  old_handles = g_new(NVHandle, 2 * payload->num_dyn_entries);
+  new_handles = old_handles + payload->num_dyn_entries;
+  success = log_msg_read_remap_payload(payload, old_handles, new_handles);
+  for (i = 0; success && i < self->num_sdata; i++)
+    {
+      self->sdata[i] = log_msg_remap_handle(self->sdata[i], old_handles, new_handles, payload->num_dyn_entries);
+      if (!self->sdata[i])
+        success = FALSE;
+    }
+  g_free(old_handles);
+
+  if (!success)
+    {
+      nv_table_unref(payload);
+      return FALSE;
+    }
+
+  nv_table_unref(self->payload);
+  self->payload = payload;
+  return TRUE;
+}
@@ -32,8 +32,11 @@
 #include "stats/stats-registry.h"
 #include "template/templates.h"
 #include "tls-support.h"
+#include "memusage.h"
 #include "compat/string.h"
 #include "rcptid.h"
+#include "parse-number.h"
+#include "fasthash.h"
 #include "template/macros.h"
 #include "lib/host-id.h"
 
@@ -113,10 +116,59 @@
  * stuff, but that shouldn't have that much of an overhead.
  */
 
+/* Per-thread free list of fixed size LogMessage blocks.  Most messages
+ * (LogMessage + embedded queue nodes + initial NVTable payload) fit into
+ * a single LOGMSG_FREELIST_BLOCK_SIZE sized allocation, such blocks are
+ * recycled on a thread-local list instead of being handed back to
+ * malloc.  Oversized messages keep using plain g_malloc()/g_free().
+ * Blocks may migrate between threads (allocated on a reader thread,
+ * freed on a writer thread), the per-thread cap just bounds how much
+ * memory can pool up in any one of them. */
+#define LOGMSG_FREELIST_BLOCK_SIZE 2048
+#define LOGMSG_FREELIST_MAX_LEN    128
+
+typedef struct _LogMessageFreeListBlock
+{
+  struct _LogMessageFreeListBlock *next;
+} LogMessageFreeListBlock;
+
+/* Per-thread free list of overflow LogMessageQueueNodes.  Fan-outs wider
+ * than the embedded node array fall back to heap allocated nodes, which
+ * then churn the allocator at fan-out rate; freed overflow nodes are
+ * parked on a thread-local list instead and reused for the next wide
+ * fan-out.  g_slice provides the slab backing underneath, the list in
+ * front of it keeps the hot path free of its locking.  Like LogMessage
+ * blocks, nodes may migrate between threads (allocated in the source
+ * thread, freed where the queue is drained), the cap below just bounds
+ * the memory parked in any one thread. */
+#define LOGMSG_NODE_POOL_MAX_LEN 256
+
+/* Per-thread memoization of name -> NVHandle lookups.  Static names
+ * (templates, filters) resolve their handles once at config parse time,
+ * but dynamically constructed names (value-pairs globs, transport aux
+ * values, key=value parsers) go through the registry hash and its global
+ * lock per message.  A small direct-mapped thread-local cache makes the
+ * repeated lookups of the same few dynamic names lock-free. */
+#define LOGMSG_HANDLE_CACHE_SIZE 64   /* must be a power of two */
+
+typedef struct _LogMessageHandleCacheEntry
+{
+  gchar *name;
+  NVHandle handle;
+} LogMessageHandleCacheEntry;
+
 TLS_BLOCK_START
 {
   /* message that is being processed by the current thread. Its ack/ref changes are cached */
   LogMessage *logmsg_current;
+  /* free list of recyclable LogMessage blocks owned by the current thread */
+  LogMessageFreeListBlock *logmsg_free_list;
+  gint logmsg_free_list_len;
+  /* free list of recyclable overflow queue nodes owned by the current thread */
+  LogMessageFreeListBlock *logmsg_node_pool;
+  gint logmsg_node_pool_len;
+  /* name -> handle lookup cache of the current thread */
+  LogMessageHandleCacheEntry logmsg_handle_cache[LOGMSG_HANDLE_CACHE_SIZE];
   /* whether the consumer is flow-controlled, (the producer always is) */
   gboolean logmsg_cached_ack_needed;
 
@@ -131,6 +183,11 @@ TLS_BLOCK_START
 TLS_BLOCK_END;
 
 #define logmsg_current              __tls_deref(logmsg_current)
+#define logmsg_free_list            __tls_deref(logmsg_free_list)
+#define logmsg_free_list_len        __tls_deref(logmsg_free_list_len)
+#define logmsg_node_pool            __tls_deref(logmsg_node_pool)
+#define logmsg_node_pool_len        __tls_deref(logmsg_node_pool_len)
+#define logmsg_handle_cache         __tls_deref(logmsg_handle_cache)
 #define logmsg_cached_refs          __tls_deref(logmsg_cached_refs)
 #define logmsg_cached_acks          __tls_deref(logmsg_cached_acks)
 #define logmsg_cached_ack_needed    __tls_deref(logmsg_cached_ack_needed)
@@ -191,10 +248,15 @@ const gchar *builtin_value_names[] =
   "MSGID",
   "SOURCE",
   "LEGACY_MSGHDR",
+  "RAWSD",
   NULL,
 };
 
 static NVHandle match_handles[256];
+
+/* hidden entry caching the composed $MSGHDR value, filled in by
+ * log_macro_expand() and dropped here whenever PROGRAM or PID change */
+static NVHandle handle_cached_msghdr;
 NVRegistry *logmsg_registry;
 const char logmsg_sd_prefix[] = ".SDATA.";
 const gint logmsg_sd_prefix_len = sizeof(logmsg_sd_prefix) - 1;
@@ -204,6 +266,7 @@ static StatsCounterItem *count_msg_clones;
 static StatsCounterItem *count_payload_reallocs;
 static StatsCounterItem *count_sdata_updates;
 static GStaticPrivate priv_macro_value = G_STATIC_PRIVATE_INIT;
+static GStaticPrivate priv_sdata_value = G_STATIC_PRIVATE_INIT;
 
 static inline gboolean
 log_msg_is_write_protected(const LogMessage *self)
@@ -214,6 +277,13 @@ log_msg_is_write_protected(const LogMessage *self)
 void
 log_msg_write_protect(LogMessage *self)
 {
+  /* a shared message must present a single, consistent payload: clones
+   * reference self->payload only, so any pending overlay entries have to
+   * be folded in before the first clone can be taken.  This also
+   * maintains the invariant that write protected messages never carry an
+   * overlay, which the various read paths rely on. */
+  if (G_UNLIKELY(self->payload_overlay != NULL))
+    log_msg_merge_overlay(self);
   self->protect_cnt++;
 }
 
@@ -234,6 +304,12 @@ log_msg_make_writable(LogMessage **pself, const LogPathOptions *path_options)
       log_msg_unref(*pself);
       *pself = new;
     }
+
+  /* the caller is about to change the message, cached filter verdicts are
+   * no longer valid and the payload can no longer be assumed to be the
+   * raw frame */
+  (*pself)->filter_memo = 0;
+  (*pself)->flags &= ~LF_RAW_FRAME;
   return *pself;
 }
 
@@ -334,8 +410,13 @@ log_msg_update_sdata(LogMessage *self, NVHandle handle, const gchar *name, gssiz
 NVHandle
 log_msg_get_value_handle(const gchar *value_name)
 {
+  LogMessageHandleCacheEntry *entry;
   NVHandle handle;
 
+  entry = &logmsg_handle_cache[g_str_hash(value_name) & (LOGMSG_HANDLE_CACHE_SIZE - 1)];
+  if (entry->name && strcmp(entry->name, value_name) == 0)
+    return entry->handle;
+
   handle = nv_registry_alloc_handle(logmsg_registry, value_name);
 
   /* check if name starts with sd_prefix and has at least one additional character */
@@ -344,6 +425,12 @@ log_msg_get_value_handle(const gchar *value_name)
       nv_registry_set_handle_flags(logmsg_registry, handle, LM_VF_SDATA);
     }
 
+  if (handle)
+    {
+      g_free(entry->name);
+      entry->name = g_strdup(value_name);
+      entry->handle = handle;
+    }
   return handle;
 }
 
@@ -428,6 +515,21 @@ log_msg_is_handle_match(NVHandle handle)
   return (match_handles[0] <= handle && handle <= match_handles[255]);
 }
 
+static LogMessageQueueNode *
+log_msg_queue_node_alloc(void)
+{
+  LogMessageFreeListBlock *block = logmsg_node_pool;
+
+  if (block)
+    {
+      logmsg_node_pool = block->next;
+      logmsg_node_pool_len--;
+      return (LogMessageQueueNode *) block;
+    }
+  memusage_count_alloc(MEMUSAGE_QUEUE, sizeof(LogMessageQueueNode));
+  return g_slice_new(LogMessageQueueNode);
+}
+
 static void
 log_msg_init_queue_node(LogMessage *msg, LogMessageQueueNode *node, const LogPathOptions *path_options)
 {
@@ -469,7 +571,7 @@ log_msg_alloc_queue_node(LogMessage *msg, const LogPathOptions *path_options)
        */
       if (nodes < 32 && nodes <= msg->num_nodes)
         logmsg_queue_node_max = msg->num_nodes + 1;
-      node = g_slice_new(LogMessageQueueNode);
+      node = log_msg_queue_node_alloc();
       node->embedded = FALSE;
     }
   log_msg_init_queue_node(msg, node, path_options);
@@ -480,7 +582,7 @@ LogMessageQueueNode *
 log_msg_alloc_dynamic_queue_node(LogMessage *msg, const LogPathOptions *path_options)
 {
   LogMessageQueueNode *node;
-  node = g_slice_new(LogMessageQueueNode);
+  node = log_msg_queue_node_alloc();
   node->embedded = FALSE;
   log_msg_init_queue_node(msg, node, path_options);
   return node;
@@ -490,7 +592,76 @@ void
 log_msg_free_queue_node(LogMessageQueueNode *node)
 {
   if (!node->embedded)
-    g_slice_free(LogMessageQueueNode, node);
+    {
+      if (logmsg_node_pool_len < LOGMSG_NODE_POOL_MAX_LEN)
+        {
+          LogMessageFreeListBlock *block = (LogMessageFreeListBlock *) node;
+
+          /* pooled nodes stay accounted for, they are still memory held
+           * by the queueing subsystem */
+          block->next = logmsg_node_pool;
+          logmsg_node_pool = block;
+          logmsg_node_pool_len++;
+        }
+      else
+        {
+          memusage_count_free(MEMUSAGE_QUEUE, sizeof(LogMessageQueueNode));
+          g_slice_free(LogMessageQueueNode, node);
+        }
+    }
+}
+
+static gboolean
+log_msg_merge_overlay_entry(NVHandle handle, const gchar *name, const gchar *value, gssize value_len, gpointer user_data)
+{
+  LogMessage *self = (LogMessage *) user_data;
+  gssize name_len;
+  gboolean new_entry = FALSE;
+
+  name = log_msg_get_value_name(handle, &name_len);
+  while (!nv_table_add_value(self->payload, handle, name, name_len, value, value_len, &new_entry))
+    {
+      if (!nv_table_realloc(self->payload, &self->payload))
+        {
+          msg_info("Cannot store value for this log message, maximum size has been reached",
+                   evt_tag_str("name", name),
+                   NULL);
+          break;
+        }
+      stats_counter_inc(count_payload_reallocs);
+    }
+  /* NOTE: no log_msg_update_sdata() here: SDATA handles first set through
+   * the overlay were recorded in self->sdata right away, the others were
+   * inherited from the original message */
+  return FALSE;
+}
+
+/*
+ * Fold the private overlay of a cloned message back into an exclusively
+ * owned payload.  This is the deferred half of the payload copy-on-write:
+ * writes to a shared payload are staged in a small overlay table and only
+ * merged when the split would become observable, i.e. on write
+ * protection, iteration, serialization and indirect value writes.
+ */
+void
+log_msg_merge_overlay(LogMessage *self)
+{
+  NVTable *overlay = self->payload_overlay;
+
+  if (!overlay)
+    return;
+
+  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+    {
+      self->payload = nv_table_clone(self->payload, overlay->used);
+      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+    }
+
+  /* clear the pointer first, lookups performed while re-adding the
+   * entries must not be diverted to the overlay anymore */
+  self->payload_overlay = NULL;
+  nv_table_foreach(overlay, logmsg_registry, log_msg_merge_overlay_entry, self);
+  nv_table_unref(overlay);
 }
 
 void
@@ -499,12 +670,19 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
   const gchar *name;
   gssize name_len;
   gboolean new_entry = FALSE;
-  
+  NVTable **payload;
+  gboolean (*add_value)(NVTable *, NVHandle, const gchar *, gsize, const gchar *, gsize, gboolean *);
+
   g_assert(!log_msg_is_write_protected(self));
 
   if (handle == LM_V_NONE)
     return;
 
+  /* overwriting a lazy SDATA entry must not leave the stale raw form
+   * around, materialize everything first */
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_LAZY_SDATA)) && log_msg_is_handle_sdata(handle))
+    log_msg_materialize_sdata(self);
+
   name = log_msg_get_value_name(handle, &name_len);
 
   if (value_len < 0)
@@ -512,17 +690,32 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+      /* the payload is still shared with the message this one was cloned
+       * from; instead of duplicating the whole table just to change a
+       * single value, the write is staged in a small private overlay
+       * that shadows the shared payload until log_msg_merge_overlay() */
+      if (!self->payload_overlay)
+        self->payload_overlay = nv_table_new(LM_V_MAX, 4, MAX(name_len + value_len + 2, 256));
+      payload = &self->payload_overlay;
     }
+  else
+    payload = &self->payload;
+
+  /* high-repetition values (hostnames, program names) are stored as
+   * references into the process-wide intern pool instead of copied into
+   * every payload */
+  if (G_UNLIKELY(nv_registry_get_handle_flags(logmsg_registry, handle) & LM_VF_INTERNED))
+    add_value = nv_table_add_value_interned;
+  else
+    add_value = nv_table_add_value;
 
   /* we need a loop here as a single realloc may not be enough. Might help
    * if we pass how much bytes we need though. */
 
-  while (!nv_table_add_value(self->payload, handle, name, name_len, value, value_len, &new_entry))
+  while (!add_value(*payload, handle, name, name_len, value, value_len, &new_entry))
     {
       /* error allocating string in payload, reallocate */
-      if (!nv_table_realloc(self->payload, &self->payload))
+      if (!nv_table_realloc(*payload, payload))
         {
           /* can't grow the payload, it has reached the maximum size */
           msg_info("Cannot store value for this log message, maximum size has been reached",
@@ -534,10 +727,23 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
       stats_counter_inc(count_payload_reallocs);
     }
 
+  /* a handle that is new to the overlay may well be present in the shared
+   * payload, in which case it is already in the sdata array copied at
+   * clone time */
+  if (new_entry && payload == &self->payload_overlay)
+    new_entry = !nv_table_is_value_set(self->payload, handle);
   if (new_entry)
     log_msg_update_sdata(self, handle, name, name_len);
+  if (handle == self->num_cache_handle)
+    self->num_cache_handle = 0;
+  self->suppress_digest = 0;
   if (handle == LM_V_PROGRAM || handle == LM_V_PID)
-    log_msg_unset_flag(self, LF_LEGACY_MSGHDR);
+    {
+      log_msg_unset_flag(self, LF_LEGACY_MSGHDR);
+      if (nv_table_is_value_set(*payload, handle_cached_msghdr) ||
+          (payload != &self->payload && nv_table_is_value_set(self->payload, handle_cached_msghdr)))
+        log_msg_set_value(self, handle_cached_msghdr, "", 0);
+    }
 }
 
 void
@@ -554,12 +760,22 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
 
   g_assert(handle >= LM_V_MAX);
 
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_LAZY_SDATA)) && log_msg_is_handle_sdata(handle))
+    log_msg_materialize_sdata(self);
+
   name = log_msg_get_value_name(handle, &name_len);
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+      /* indirect entries resolve their referenced value within their own
+       * table, so they cannot be staged in the overlay; fold any
+       * outstanding overlay entries and take over the payload instead */
+      log_msg_merge_overlay(self);
+      if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+        {
+          self->payload = nv_table_clone(self->payload, name_len + 1);
+          log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+        }
     }
 
   while (!nv_table_add_value_indirect(self->payload, handle, name, name_len, ref_handle, type, ofs, len, &new_entry))
@@ -579,11 +795,99 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
 
   if (new_entry)
     log_msg_update_sdata(self, handle, name, name_len);
+  if (handle == self->num_cache_handle)
+    self->num_cache_handle = 0;
+  self->suppress_digest = 0;
+}
+
+/**
+ * log_msg_get_suppress_digest:
+ *
+ * Return a digest of the fields the writer's suppress() feature compares
+ * (MESSAGE, HOST, PROGRAM, PID), computing and caching it on first use.
+ * Two messages with different digests are guaranteed to differ in at
+ * least one of these fields; equal digests still need a string
+ * comparison as collisions are possible.  NOTE: built on fast_hash(),
+ * the digest is only meaningful within this process.
+ **/
+guint64
+log_msg_get_suppress_digest(LogMessage *self)
+{
+  static const NVHandle handles[] = { LM_V_MESSAGE, LM_V_HOST, LM_V_PROGRAM, LM_V_PID };
+  guint64 digest = self->suppress_digest;
+  gint i;
+
+  if (digest)
+    return digest;
+
+  digest = G_GUINT64_CONSTANT(0xcbf29ce484222325);
+  for (i = 0; i < G_N_ELEMENTS(handles); i++)
+    {
+      const gchar *value;
+      gssize len = 0;
+
+      value = log_msg_get_value(self, handles[i], &len);
+      digest = (digest << 32) | (digest >> 32);
+      digest ^= (((guint64) len + 1) << 32) | fast_hash(value, len);
+      digest *= G_GUINT64_CONSTANT(1099511628211);
+    }
+  if (!digest)
+    digest = 1;
+  self->suppress_digest = digest;
+  return digest;
+}
+
+/**
+ * log_msg_get_value_as_int64:
+ *
+ * Fetch a value and parse it as an integer, serving repeated requests
+ * for the same entry from the one-slot numeric cache, so a battery of
+ * numeric filters matching on the same field only parses it once.
+ * Returns FALSE if the value is not a syntactically valid number, in
+ * which case the caller is expected to fall back to its string based
+ * code path.
+ **/
+gboolean
+log_msg_get_value_as_int64(const LogMessage *self, NVHandle handle, gint64 *value)
+{
+  const gchar *str;
+  gssize len = 0;
+  gint64 parsed;
+
+  if (self->num_cache_handle == handle)
+    {
+      *value = self->num_cache_value;
+      return TRUE;
+    }
+
+  str = log_msg_get_value(self, handle, &len);
+  if (len == 0 || !parse_number(str, &parsed))
+    return FALSE;
+
+  *value = parsed;
+  /* shared messages are left alone, they simply reparse */
+  if (!log_msg_is_write_protected(self))
+    {
+      ((LogMessage *) self)->num_cache_handle = handle;
+      ((LogMessage *) self)->num_cache_value = parsed;
+    }
+  return TRUE;
 }
 
 gboolean
 log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data)
 {
+  /* iteration only sees real NVTable entries; materialize lazy SDATA
+   * while we still can, shared messages are left as they are and their
+   * unmaterialized entries stay invisible to the callback */
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_LAZY_SDATA)) && !log_msg_is_write_protected(self))
+    log_msg_materialize_sdata((LogMessage *) self);
+
+  /* an overlay can only be present on messages we exclusively own, write
+   * protection implies it has been merged already */
+  if (G_UNLIKELY(self->payload_overlay != NULL))
+    log_msg_merge_overlay((LogMessage *) self);
+
   return nv_table_foreach(self->payload, logmsg_registry, func, user_data);
 }
 
@@ -791,8 +1095,322 @@ log_msg_is_tag_by_name(LogMessage *self, const gchar *name)
   return log_msg_is_tag_by_id(self, log_tags_get_by_name(name));
 }
 
+/* Add @id to a standalone tag bitfield that uses the same word layout as
+ * the per-message tags array.  The mask is grown as needed, so callers that
+ * know their tag set at config time (e.g.  tags() filters) can precompute
+ * it once and match against messages with log_msg_tags_intersect(). */
+void
+log_msg_tags_mask_add(gulong **mask, gint *mask_words, LogTagId id)
+{
+  gint words = (id / LOGMSG_TAGS_BITS) + 1;
+
+  if (words > *mask_words)
+    {
+      *mask = g_realloc(*mask, sizeof((*mask)[0]) * words);
+      memset(&(*mask)[*mask_words], 0, (words - *mask_words) * sizeof((*mask)[0]));
+      *mask_words = words;
+    }
+  log_msg_set_bit(*mask, id, TRUE);
+}
+
+/* Check whether any tag in @mask is set on @self, a word at a time instead
+ * of testing the candidate ids one by one. */
+gboolean
+log_msg_tags_intersect(const LogMessage *self, const gulong *mask, gint mask_words)
+{
+  const gulong *tags;
+  gint num_words, i;
+
+  if (self->num_tags == 0)
+    {
+      /* inline storage, the tags pointer itself holds the bits */
+      tags = (const gulong *) &self->tags;
+      num_words = 1;
+    }
+  else
+    {
+      tags = self->tags;
+      num_words = self->num_tags;
+    }
+  if (num_words > mask_words)
+    num_words = mask_words;
+  for (i = 0; i < num_words; i++)
+    {
+      if (tags[i] & mask[i])
+        return TRUE;
+    }
+  return FALSE;
+}
+
 /* structured data elements */
 
+/* Lazy structured data (see LP_LAZY_SDATA): the syslogformat parser
+ * validated the STRUCTURED-DATA part but stored it as a single raw value
+ * ($RAWSD) instead of creating the individual .SDATA.* entries.  The
+ * helpers below walk that raw form; they can be lenient about malformed
+ * input because the parser only ever stores structurally valid SD
+ * strings. */
+
+static gboolean
+log_msg_raw_sd_next_element(const gchar **src, gsize *left,
+                            const gchar **id, gsize *id_len,
+                            const gchar **params, gsize *params_len)
+{
+  const gchar *p = *src;
+  gsize n = *left;
+  gboolean quoted = FALSE;
+
+  if (n == 0 || *p != '[')
+    return FALSE;
+  p++;
+  n--;
+  *id = p;
+  while (n && *p != ' ' && *p != ']')
+    {
+      p++;
+      n--;
+    }
+  *id_len = p - *id;
+  *params = p;
+  while (n)
+    {
+      if (quoted)
+        {
+          if (*p == '\\' && n > 1)
+            {
+              p++;
+              n--;
+            }
+          else if (*p == '"')
+            quoted = FALSE;
+        }
+      else if (*p == '"')
+        quoted = TRUE;
+      else if (*p == ']')
+        break;
+      p++;
+      n--;
+    }
+  *params_len = p - *params;
+  if (n)
+    {
+      /* closing ']' */
+      p++;
+      n--;
+    }
+  *src = p;
+  *left = n;
+  return TRUE;
+}
+
+static gboolean
+log_msg_raw_sd_next_param(const gchar **params, gsize *left,
+                          const gchar **name, gsize *name_len,
+                          const gchar **value, gsize *value_len)
+{
+  const gchar *p = *params;
+  gsize n = *left;
+
+  while (n && *p == ' ')
+    {
+      p++;
+      n--;
+    }
+  if (n == 0)
+    return FALSE;
+  *name = p;
+  while (n && *p != '=')
+    {
+      p++;
+      n--;
+    }
+  *name_len = p - *name;
+  if (n)
+    {
+      /* '=' */
+      p++;
+      n--;
+    }
+  if (n && *p == '"')
+    {
+      p++;
+      n--;
+    }
+  *value = p;
+  while (n && *p != '"')
+    {
+      if (*p == '\\' && n > 1)
+        {
+          p++;
+          n--;
+        }
+      p++;
+      n--;
+    }
+  *value_len = p - *value;
+  if (n)
+    {
+      /* closing '"' */
+      p++;
+      n--;
+    }
+  *params = p;
+  *left = n;
+  return TRUE;
+}
+
+/* undo the PARAM-VALUE escaping rules the same way the tokenizing parser
+ * does: a backslash quotes '"', ']' and '\', in front of anything else
+ * both characters are kept */
+static void
+log_msg_raw_sd_append_unescaped(GString *result, const gchar *value, gsize value_len)
+{
+  gsize i;
+
+  for (i = 0; i < value_len; i++)
+    {
+      if (value[i] == '\\' && i + 1 < value_len)
+        {
+          i++;
+          if (value[i] != '"' && value[i] != ']' && value[i] != '\\')
+            g_string_append_c(result, '\\');
+          g_string_append_c(result, value[i]);
+        }
+      else
+        g_string_append_c(result, value[i]);
+    }
+}
+
+void
+log_msg_materialize_sdata(LogMessage *self)
+{
+  GString *raw, *unescaped;
+  const gchar *raw_value, *src, *id, *params, *name, *value;
+  gssize raw_len;
+  gsize left, id_len, params_len, name_len, value_len;
+  gchar value_name[128];
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  if (!log_msg_chk_flag(self, LF_LAZY_SDATA))
+    return;
+  log_msg_unset_flag(self, LF_LAZY_SDATA);
+
+  /* the raw value lives in the payload which log_msg_set_value() may
+   * reallocate under us, take a copy first */
+  raw_value = log_msg_get_value(self, LM_V_RAWSD, &raw_len);
+  raw = g_string_new_len(raw_value, raw_len);
+  log_msg_set_value(self, LM_V_RAWSD, "", 0);
+
+  unescaped = g_string_sized_new(64);
+  src = raw->str;
+  left = raw->len;
+  while (log_msg_raw_sd_next_element(&src, &left, &id, &id_len, &params, &params_len))
+    {
+      const gchar *p = params;
+      gsize pn = params_len;
+
+      if (logmsg_sd_prefix_len + id_len + 1 >= sizeof(value_name))
+        continue;
+      memcpy(value_name, logmsg_sd_prefix, logmsg_sd_prefix_len);
+      memcpy(value_name + logmsg_sd_prefix_len, id, id_len);
+      if (params_len == 0)
+        {
+          value_name[logmsg_sd_prefix_len + id_len] = 0;
+          log_msg_set_value_by_name(self, value_name, "", 0);
+          continue;
+        }
+      value_name[logmsg_sd_prefix_len + id_len] = '.';
+      while (log_msg_raw_sd_next_param(&p, &pn, &name, &name_len, &value, &value_len))
+        {
+          if (logmsg_sd_prefix_len + id_len + 1 + name_len >= sizeof(value_name))
+            continue;
+          memcpy(value_name + logmsg_sd_prefix_len + id_len + 1, name, name_len);
+          value_name[logmsg_sd_prefix_len + id_len + 1 + name_len] = 0;
+          g_string_truncate(unescaped, 0);
+          log_msg_raw_sd_append_unescaped(unescaped, value, value_len);
+          log_msg_set_value_by_name(self, value_name, unescaped->str, unescaped->len);
+        }
+    }
+  g_string_free(unescaped, TRUE);
+  g_string_free(raw, TRUE);
+}
+
+static void
+__free_sdata_value(void *val)
+{
+  g_string_free((GString *) val, TRUE);
+}
+
+const gchar *
+log_msg_get_lazy_sdata_value(const LogMessage *self, NVHandle handle, gssize *value_len)
+{
+  GString *result;
+  const gchar *target_name, *raw, *src, *id, *params, *name, *value;
+  gssize target_name_len, raw_len;
+  gsize left, id_len, params_len, name_len, param_value_len;
+
+  if (!log_msg_is_write_protected(self))
+    {
+      /* the message is still exclusively owned by this thread, create
+       * the real entries and serve all further lookups from those */
+      log_msg_materialize_sdata((LogMessage *) self);
+      /* NOTE: materialized entries may land in the payload overlay if the
+       * payload itself is shared, go through the overlay aware getter */
+      return log_msg_get_value(self, handle, value_len);
+    }
+
+  /* the message is shared between threads, the payload must not be
+   * touched; look the value up in the raw SD string and hand it back in
+   * a per-thread buffer instead */
+
+  target_name = log_msg_get_value_name(handle, &target_name_len);
+  raw = __nv_table_get_value(self->payload, LM_V_RAWSD, LM_V_MAX, &raw_len);
+  src = raw;
+  left = raw_len;
+  while (log_msg_raw_sd_next_element(&src, &left, &id, &id_len, &params, &params_len))
+    {
+      const gchar *p = params;
+      gsize pn = params_len;
+
+      if (target_name_len < (gssize) (logmsg_sd_prefix_len + id_len) ||
+          memcmp(target_name + logmsg_sd_prefix_len, id, id_len) != 0)
+        continue;
+      if (params_len == 0)
+        {
+          if (target_name_len != (gssize) (logmsg_sd_prefix_len + id_len))
+            continue;
+          if (value_len)
+            *value_len = 0;
+          return null_string;
+        }
+      if (target_name_len <= (gssize) (logmsg_sd_prefix_len + id_len) ||
+          target_name[logmsg_sd_prefix_len + id_len] != '.')
+        continue;
+      while (log_msg_raw_sd_next_param(&p, &pn, &name, &name_len, &value, &param_value_len))
+        {
+          if (target_name_len != (gssize) (logmsg_sd_prefix_len + id_len + 1 + name_len) ||
+              memcmp(target_name + logmsg_sd_prefix_len + id_len + 1, name, name_len) != 0)
+            continue;
+
+          result = g_static_private_get(&priv_sdata_value);
+          if (!result)
+            {
+              result = g_string_sized_new(64);
+              g_static_private_set(&priv_sdata_value, result, __free_sdata_value);
+            }
+          g_string_truncate(result, 0);
+          log_msg_raw_sd_append_unescaped(result, value, param_value_len);
+          if (value_len)
+            *value_len = result->len;
+          return result->str;
+        }
+    }
+  if (value_len)
+    *value_len = 0;
+  return null_string;
+}
+
 static void
 log_msg_sdata_append_escaped(GString *result, const gchar *sstr, gssize len)
 {
@@ -811,6 +1429,56 @@ log_msg_sdata_append_escaped(GString *result, const gchar *sstr, gssize len)
     }
 }
 
+/* emit an unmaterialized SD string: it is already in the on-wire format,
+ * the only transformation needed is injecting sequenceId into the meta
+ * block the same way the tokenized path below does */
+static void
+log_msg_append_raw_sdata(const LogMessage *self, GString *result, guint32 seq_num)
+{
+  const gchar *raw, *src, *id, *params, *name, *value;
+  gssize raw_len;
+  gsize left, id_len, params_len, name_len, value_len;
+  gboolean has_seq_num = FALSE;
+
+  raw = log_msg_get_value(self, LM_V_RAWSD, &raw_len);
+
+  if (seq_num == 0)
+    {
+      g_string_append_len(result, raw, raw_len);
+      return;
+    }
+
+  src = raw;
+  left = raw_len;
+  while (log_msg_raw_sd_next_element(&src, &left, &id, &id_len, &params, &params_len))
+    {
+      g_string_append_c(result, '[');
+      g_string_append_len(result, id, id_len);
+      if (!has_seq_num && params_len != 0 && id_len == 4 && memcmp(id, "meta", 4) == 0)
+        {
+          const gchar *p = params;
+          gsize pn = params_len;
+          gboolean has_seq_id_param = FALSE;
+
+          while (log_msg_raw_sd_next_param(&p, &pn, &name, &name_len, &value, &value_len))
+            {
+              if (name_len == 10 && memcmp(name, "sequenceId", 10) == 0)
+                {
+                  has_seq_id_param = TRUE;
+                  break;
+                }
+            }
+          if (!has_seq_id_param)
+            g_string_append_printf(result, " sequenceId=\"%d\"", seq_num);
+          has_seq_num = TRUE;
+        }
+      g_string_append_len(result, params, params_len);
+      g_string_append_c(result, ']');
+    }
+  if (!has_seq_num)
+    g_string_append_printf(result, "[meta sequenceId=\"%d\"]", seq_num);
+}
+
 void
 log_msg_append_format_sdata(const LogMessage *self, GString *result,  guint32 seq_num)
 {
@@ -823,6 +1491,12 @@ log_msg_append_format_sdata(const LogMessage *self, GString *result,  guint32 se
   gboolean has_seq_num = FALSE;
   const gchar *seqid;
 
+  if (G_UNLIKELY(log_msg_chk_flag(self, LF_LAZY_SDATA)))
+    {
+      log_msg_append_raw_sdata(self, result, seq_num);
+      return;
+    }
+
   if (!meta_seqid)
     meta_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
 
@@ -995,7 +1669,7 @@ log_msg_init(LogMessage *self, GSockAddr *saddr)
   cached_g_current_time(&tv);
   self->timestamps[LM_TS_RECVD].tv_sec = tv.tv_sec;
   self->timestamps[LM_TS_RECVD].tv_usec = tv.tv_usec;
-  self->timestamps[LM_TS_RECVD].zone_offset = get_local_timezone_ofs(self->timestamps[LM_TS_RECVD].tv_sec);
+  self->timestamps[LM_TS_RECVD].zone_offset = cached_get_local_timezone_ofs(self->timestamps[LM_TS_RECVD].tv_sec);
   self->timestamps[LM_TS_STAMP].tv_sec = -1;
   self->timestamps[LM_TS_STAMP].zone_offset = -1;
  
@@ -1017,6 +1691,14 @@ log_msg_clear(LogMessage *self)
   else
     self->payload = nv_table_new(LM_V_MAX, 16, 256);
 
+  if (self->payload_overlay)
+    {
+      nv_table_unref(self->payload_overlay);
+      self->payload_overlay = NULL;
+    }
+  self->num_cache_handle = 0;
+  self->suppress_digest = 0;
+
   if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->tags)
     {
       gboolean inline_tags = self->num_tags == 0;
@@ -1069,9 +1751,33 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
 
-  memset(msg, 0, sizeof(LogMessage));
+  if (alloc_size <= LOGMSG_FREELIST_BLOCK_SIZE)
+    {
+      LogMessageFreeListBlock *block = logmsg_free_list;
+
+      if (block)
+        {
+          logmsg_free_list = block->next;
+          logmsg_free_list_len--;
+          msg = (LogMessage *) block;
+        }
+      else
+        {
+          msg = g_malloc(LOGMSG_FREELIST_BLOCK_SIZE);
+          memusage_count_alloc(MEMUSAGE_LOGMSG, LOGMSG_FREELIST_BLOCK_SIZE);
+        }
+      memset(msg, 0, sizeof(LogMessage));
+      msg->recyclable = TRUE;
+      msg->alloc_size = LOGMSG_FREELIST_BLOCK_SIZE;
+    }
+  else
+    {
+      msg = g_malloc(alloc_size);
+      memusage_count_alloc(MEMUSAGE_LOGMSG, alloc_size);
+      memset(msg, 0, sizeof(LogMessage));
+      msg->alloc_size = alloc_size;
+    }
 
   if (payload_size)
     msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
@@ -1085,7 +1791,9 @@ _merge_value(NVHandle handle, const gchar *name, const gchar *value, gssize valu
 {
   LogMessage *msg = (LogMessage *) user_data;
 
-  if (!nv_table_is_value_set(msg->payload, handle))
+  /* a value only present in the payload overlay is set all the same */
+  if (!nv_table_is_value_set(msg->payload, handle) &&
+      (!msg->payload_overlay || !nv_table_is_value_set(msg->payload_overlay, handle)))
     log_msg_set_value(msg, handle, value, value_len);
   return FALSE;
 }
@@ -1117,13 +1825,30 @@ log_msg_new(const gchar *msg, gint length,
             GSockAddr *saddr,
             MsgFormatOptions *parse_options)
 {
-  LogMessage *self = log_msg_alloc(length == 0 ? 256 : length * 2);
+  /* the format parsers store substrings of the incoming line (message
+   * body, host, program, pid, sdata), so the combined payload is bounded
+   * by the line length plus per-entry bookkeeping; sizing the table
+   * tightly instead of 2x keeps more messages within the free list block
+   * size and halves the memory carried by large messages.  If a parser
+   * expands the input (e.g. sanitize-utf8), the realloc loop in
+   * log_msg_set_value() still grows the table as needed.  When the
+   * source's payload size histogram indicates that messages regularly
+   * end up larger than the line based estimate, its sizing hint takes
+   * over, so the common case never reallocates. */
+  LogMessage *self;
+  gint init_size = (length == 0 ? 256 : length + 256);
+  gint size_hint = msg_format_options_get_init_payload_size(parse_options);
+
+  if (size_hint > init_size)
+    init_size = size_hint;
+  self = log_msg_alloc(init_size);
 
   log_msg_init(self, saddr);
 
-  if (G_LIKELY(parse_options->format_handler))
+  if (G_LIKELY(parse_options->parse))
     {
-      parse_options->format_handler->parse(parse_options, (guchar *) msg, length, self);
+      parse_options->parse(parse_options, (guchar *) msg, length, self);
+      msg_format_options_note_payload_size(parse_options, self->payload->used);
     }
   else
     {
@@ -1162,7 +1887,10 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
   LogMessage *self = log_msg_alloc(0);
 
   stats_counter_inc(count_msg_clones);
-  if ((msg->flags & LF_STATE_OWN_MASK) == 0 || ((msg->flags & LF_STATE_OWN_MASK) == LF_STATE_OWN_TAGS && msg->num_tags == 0))
+  /* NOTE: a message whose changes only live in its payload overlay has no
+   * owned state flags yet, but it does have content of its own */
+  if (!msg->payload_overlay &&
+      ((msg->flags & LF_STATE_OWN_MASK) == 0 || ((msg->flags & LF_STATE_OWN_MASK) == LF_STATE_OWN_TAGS && msg->num_tags == 0)))
     {
       /* the message we're cloning has no original content, everything
        * is referenced from its "original", use that with this clone
@@ -1172,7 +1900,12 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
     }
   log_msg_write_protect(msg);
 
-  memcpy(self, msg, sizeof(*msg));
+  {
+    guint8 recyclable = self->recyclable;
+
+    memcpy(self, msg, sizeof(*msg));
+    self->recyclable = recyclable;
+  }
 
   /* every field _must_ be initialized explicitly if its direct
    * copying would cause problems (like copying a pointer by value) */
@@ -1254,6 +1987,9 @@ log_msg_free(LogMessage *self)
 {
   if (log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD) && self->payload)
     nv_table_unref(self->payload);
+  /* the overlay is always privately owned */
+  if (self->payload_overlay)
+    nv_table_unref(self->payload_overlay);
   if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->tags && self->num_tags > 0)
     g_free(self->tags);
 
@@ -1265,7 +2001,21 @@ log_msg_free(LogMessage *self)
   if (self->original)
     log_msg_unref(self->original);
 
-  g_free(self);
+  if (self->recyclable && logmsg_free_list_len < LOGMSG_FREELIST_MAX_LEN)
+    {
+      LogMessageFreeListBlock *block = (LogMessageFreeListBlock *) self;
+
+      block->next = logmsg_free_list;
+      logmsg_free_list = block;
+      logmsg_free_list_len++;
+    }
+  else
+    {
+      /* blocks parked on the free list stay accounted for, they are
+       * still memory held by the logmsg subsystem */
+      memusage_count_free(MEMUSAGE_LOGMSG, self->alloc_size);
+      g_free(self);
+    }
 }
 
 /**
@@ -1509,6 +2259,19 @@ log_msg_refcache_start_consumer(LogMessage *self, const LogPathOptions *path_opt
   logmsg_cached_abort = FALSE;
 }
 
+/*
+ * Return whether the current thread has a refcache window open.  Pipe
+ * elements that fan a message out to multiple branches use this to open a
+ * consumer window of their own when their caller didn't, without
+ * interfering with an already established window (the refcache supports a
+ * single current message per thread).
+ */
+gboolean
+log_msg_refcache_is_active(void)
+{
+  return logmsg_current != NULL;
+}
+
 /*
  * Stop caching ref/unref/ack/add-ack operations in the current thread for
  * the message specified by the log_msg_refcache_start() function.
@@ -1616,6 +2379,12 @@ log_msg_registry_init(void)
   nv_registry_add_alias(logmsg_registry, LM_V_HOST, "FULLHOST");
   nv_registry_add_alias(logmsg_registry, LM_V_HOST_FROM, "FULLHOST_FROM");
 
+  /* a deployment sees the same couple of thousand hostnames and program
+   * names over and over, share their bytes via the intern pool */
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_HOST, LM_VF_INTERNED);
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_HOST_FROM, LM_VF_INTERNED);
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_PROGRAM, LM_VF_INTERNED);
+
   for (i = 0; macros[i].name; i++)
     {
       if (nv_registry_get_handle(logmsg_registry, macros[i].name) == 0)
@@ -1635,6 +2404,8 @@ log_msg_registry_init(void)
       g_snprintf(buf, sizeof(buf), "%d", i);
       match_handles[i] = nv_registry_alloc_handle(logmsg_registry, buf);
     }
+
+  handle_cached_msghdr = nv_registry_alloc_handle(logmsg_registry, ".msghdr");
 }
 
 void
@@ -1654,6 +2425,7 @@ void
 log_msg_global_init(void)
 {
   log_msg_registry_init();
+  memusage_global_init();
   stats_lock();
   stats_register_counter(0, SCS_GLOBAL, "msg_clones", NULL, SC_TYPE_PROCESSED, &count_msg_clones);
   stats_register_counter(0, SCS_GLOBAL, "payload_reallocs", NULL, SC_TYPE_PROCESSED, &count_payload_reallocs);
@@ -1667,6 +2439,42 @@ log_msg_get_handle_name(NVHandle handle, gssize *length)
   return nv_registry_get_handle_name(logmsg_registry, handle, length);
 }
 
+/* Free the recycled blocks pooled up in the calling thread.  Idle I/O
+ * worker threads are reaped by ivykis, so without this teardown every
+ * exiting worker would strand its pools on the heap. */
+void
+log_msg_thread_deinit(void)
+{
+  gint i;
+
+  for (i = 0; i < LOGMSG_HANDLE_CACHE_SIZE; i++)
+    {
+      g_free(logmsg_handle_cache[i].name);
+      logmsg_handle_cache[i].name = NULL;
+      logmsg_handle_cache[i].handle = 0;
+    }
+
+  while (logmsg_free_list)
+    {
+      LogMessageFreeListBlock *block = logmsg_free_list;
+
+      logmsg_free_list = block->next;
+      memusage_count_free(MEMUSAGE_LOGMSG, LOGMSG_FREELIST_BLOCK_SIZE);
+      g_free(block);
+    }
+  logmsg_free_list_len = 0;
+
+  while (logmsg_node_pool)
+    {
+      LogMessageFreeListBlock *block = logmsg_node_pool;
+
+      logmsg_node_pool = block->next;
+      memusage_count_free(MEMUSAGE_QUEUE, sizeof(LogMessageQueueNode));
+      g_slice_free1(sizeof(LogMessageQueueNode), block);
+    }
+  logmsg_node_pool_len = 0;
+}
+
 void
 log_msg_global_deinit(void)
 {
@@ -75,6 +75,7 @@ enum
   LM_V_MSGID,
   LM_V_SOURCE,
   LM_V_LEGACY_MSGHDR,
+  LM_V_RAWSD,
 
   /* NOTE: this is used as the number of "statically" allocated elements in
    * an NVTable.  NVTable may impose restrictions on this value (for
@@ -90,6 +91,9 @@ enum
   LM_VF_SDATA = 0x0001,
   LM_VF_MATCH = 0x0002,
   LM_VF_MACRO = 0x0004,
+  /* values of this handle repeat heavily across messages (hostnames,
+   * program names), store them interned, see nv_intern_string() */
+  LM_VF_INTERNED = 0x0008,
 };
 
 enum
@@ -122,6 +126,26 @@ enum
    * message header intact in a value named LEGACY_MSGHDR.
    */
   LF_LEGACY_MSGHDR    = 0x00020000,
+
+  /* the parser validated the RFC5424 STRUCTURED-DATA part but stored it
+   * as a single raw value named RAWSD instead of tokenizing it into
+   * individual .SDATA.* entries (see LP_LAZY_SDATA).  The entries are
+   * materialized on first access while the message is still exclusively
+   * owned; shared, write protected messages are served straight from
+   * the raw form without touching the payload.
+   */
+  LF_LAZY_SDATA       = 0x00040000,
+
+  /* $MSG still holds the message frame exactly as it was received, set
+   * by no-parse sources and cleared as soon as somebody makes the
+   * message writable; enables verbatim forwarding on passthrough
+   * relay paths */
+  LF_RAW_FRAME        = 0x00080000,
+
+  /* the incoming line could not be parsed and the message was replaced
+   * by an error report, set by msg_format_inject_parse_error(); lets
+   * the reader account parse errors without peeking into the values */
+  LF_PARSE_ERROR      = 0x00100000,
 };
 
 typedef struct _LogMessageQueueNode
@@ -186,9 +210,53 @@ struct _LogMessage
   guint8 num_nodes;
   guint8 cur_node;
   guint8 protect_cnt;
+  /* whether this message was carved out of a fixed size block that can
+   * go back to the per-thread free list on the last unref */
+  guint8 recyclable:1;
+
+  /* size of the block this message was allocated in, including the
+   * embedded queue nodes and the initial payload, used for the memory
+   * accounting when the block is freed */
+  guint32 alloc_size;
 
   guint64 rcptid;
 
+  /* wall clock timestamp in microseconds taken by the source for sampled
+   * messages when latency-sample-freq() is set, zero for untraced
+   * messages; carried over to clones so the destination side can compute
+   * end-to-end deltas */
+  guint64 latency_stamp;
+
+  /* memoized verdicts of shared, non-modifying filter expressions, one slot
+   * per expression handed out in log_filter_pipe_init().  The bits are only
+   * valid as long as the message is unchanged, thus log_msg_make_writable()
+   * clears them.  The low 16 bits tell which slots have been evaluated, the
+   * high 16 bits hold the verdicts; both live in a single word so the memo
+   * can be read and published atomically -- an uncloned message fanned out
+   * by the multiplexer may hit the same filter from several worker threads
+   * at once, see log_msg_filter_memo_publish(). */
+  gint filter_memo;
+
+  /* one-slot cache of the last NV entry parsed as an integer through
+   * log_msg_get_value_as_int64(); a zero handle means empty.  Dropped
+   * whenever the cached entry is rewritten, so repeated numeric filters
+   * against the same field parse the string only once. */
+  NVHandle num_cache_handle;
+  gint64 num_cache_value;
+
+  /* cached digest of the fields compared by the writer's suppress()
+   * feature (MESSAGE, HOST, PROGRAM, PID), filled on first use by
+   * log_msg_get_suppress_digest().  Zero means not yet computed; reset
+   * whenever a value is written so it can never go stale. */
+  guint64 suppress_digest;
+
+  /* values written while the payload is still shared with the original
+   * message are stored in this small private table instead of duplicating
+   * the whole payload; entries here shadow the shared payload and are
+   * folded into an owned payload by log_msg_merge_overlay().  NULL unless
+   * a shared payload has been written to. */
+  NVTable *payload_overlay;
+
   /* preallocated LogQueueNodes used to insert this message into a LogQueue */
   LogMessageQueueNode nodes[0];
 
@@ -198,7 +266,7 @@ struct _LogMessage
 extern NVRegistry *logmsg_registry;
 extern const char logmsg_sd_prefix[];
 extern const gint logmsg_sd_prefix_len;
-extern gint logmsg_node_max;
+extern gint logmsg_queue_node_max;
 
 LogMessage *log_msg_ref(LogMessage *m);
 void log_msg_unref(LogMessage *m);
@@ -225,7 +293,10 @@ log_msg_is_handle_settable_with_an_indirect_value(NVHandle handle)
   return (handle >= LM_V_MAX);
 }
 
+gboolean log_msg_get_value_as_int64(const LogMessage *self, NVHandle handle, gint64 *value);
 const gchar *log_msg_get_macro_value(const LogMessage *self, gint id, gssize *value_len);
+const gchar *log_msg_get_lazy_sdata_value(const LogMessage *self, NVHandle handle, gssize *value_len);
+void log_msg_materialize_sdata(LogMessage *self);
 
 static inline const gchar *
 log_msg_get_value(const LogMessage *self, NVHandle handle, gssize *value_len)
@@ -233,8 +304,15 @@ log_msg_get_value(const LogMessage *self, NVHandle handle, gssize *value_len)
   guint16 flags;
 
   flags = nv_registry_get_handle_flags(logmsg_registry, handle);
+  if (G_UNLIKELY((self->flags & LF_LAZY_SDATA) && (flags & LM_VF_SDATA)))
+    return log_msg_get_lazy_sdata_value(self, handle, value_len);
   if ((flags & LM_VF_MACRO) == 0)
-    return __nv_table_get_value(self->payload, handle, LM_V_MAX, value_len);
+    {
+      if (G_UNLIKELY(self->payload_overlay != NULL) &&
+          nv_table_is_value_set(self->payload_overlay, handle))
+        return __nv_table_get_value(self->payload_overlay, handle, LM_V_MAX, value_len);
+      return __nv_table_get_value(self->payload, handle, LM_V_MAX, value_len);
+    }
   else
     return log_msg_get_macro_value(self, flags >> 8, value_len);
 }
@@ -246,14 +324,54 @@ log_msg_get_value_by_name(const LogMessage *self, const gchar *name, gssize *val
   return log_msg_get_value(self, handle, value_len);
 }
 
+/* number of filter memoization slots; mask and verdict bits share one
+ * 32 bit word, see the filter_memo member */
+#define LOG_MSG_FILTER_MEMO_SLOTS 16
+
+/* returns whether slot @memo_bit has been evaluated already, storing the
+ * memoized verdict in @res; a single atomic load makes sure the mask and
+ * the verdict are from the same publish */
+static inline gboolean
+log_msg_filter_memo_lookup(LogMessage *msg, guint32 memo_bit, gboolean *res)
+{
+  guint32 memo = (guint32) g_atomic_int_get(&msg->filter_memo);
+
+  if (!(memo & memo_bit))
+    return FALSE;
+  *res = !!(memo & (memo_bit << LOG_MSG_FILTER_MEMO_SLOTS));
+  return TRUE;
+}
+
+/* publish the verdicts in @value_bits for the slots in @mask_bits
+ * (value_bits must be a subset of mask_bits), leaving other slots alone.
+ * A compare-and-swap loop keeps concurrent publishes from different
+ * worker threads from losing each other's bits; the racing threads have
+ * computed the same verdict from the same unchanged message, so either
+ * order yields the same state */
+static inline void
+log_msg_filter_memo_publish(LogMessage *msg, guint32 mask_bits, guint32 value_bits)
+{
+  gint old_memo, new_memo;
+
+  do
+    {
+      old_memo = g_atomic_int_get(&msg->filter_memo);
+      new_memo = (gint) ((((guint32) old_memo) | mask_bits | (value_bits << LOG_MSG_FILTER_MEMO_SLOTS)) &
+                         ~((mask_bits & ~value_bits) << LOG_MSG_FILTER_MEMO_SLOTS));
+    }
+  while (!g_atomic_int_compare_and_exchange(&msg->filter_memo, old_memo, new_memo));
+}
+
 typedef gboolean (*LogMessageTagsForeachFunc)(const LogMessage *self, LogTagId tag_id, const gchar *name, gpointer user_data);
 
+void log_msg_merge_overlay(LogMessage *self);
 void log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *new_value, gssize length);
 void log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handle, guint8 type, guint16 ofs, guint16 len);
 gboolean log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data);
 void log_msg_set_match(LogMessage *self, gint index, const gchar *value, gssize value_len);
 void log_msg_set_match_indirect(LogMessage *self, gint index, NVHandle ref_handle, guint8 type, guint16 ofs, guint16 len);
 void log_msg_clear_matches(LogMessage *self);
+guint64 log_msg_get_suppress_digest(LogMessage *self);
 
 static inline void
 log_msg_set_value_by_name(LogMessage *self, const gchar *name, const gchar *value, gssize length)
@@ -272,6 +390,8 @@ void log_msg_clear_tag_by_id(LogMessage *self, LogTagId id);
 void log_msg_clear_tag_by_name(LogMessage *self, const gchar *name);
 gboolean log_msg_is_tag_by_id(LogMessage *self, LogTagId id);
 gboolean log_msg_is_tag_by_name(LogMessage *self, const gchar *name);
+void log_msg_tags_mask_add(gulong **mask, gint *mask_words, LogTagId id);
+gboolean log_msg_tags_intersect(const LogMessage *self, const gulong *mask, gint mask_words);
 void log_msg_tags_foreach(const LogMessage *self, LogMessageTagsForeachFunc callback, gpointer user_data);
 void log_msg_print_tags(const LogMessage *self, GString *result);
 
@@ -296,12 +416,14 @@ const LogPathOptions *log_msg_break_ack(LogMessage *msg, const LogPathOptions *p
 
 void log_msg_refcache_start_producer(LogMessage *self);
 void log_msg_refcache_start_consumer(LogMessage *self, const LogPathOptions *path_options);
+gboolean log_msg_refcache_is_active(void);
 void log_msg_refcache_stop(void);
 
 void log_msg_registry_init(void);
 void log_msg_registry_deinit(void);
 void log_msg_global_init(void);
 void log_msg_global_deinit(void);
+void log_msg_thread_deinit(void);
 void log_msg_registry_foreach(GHFunc func, gpointer user_data);
 
 gint log_msg_lookup_time_stamp_name(const gchar *name);
@@ -30,6 +30,7 @@
 #include "cfg.h"
 #include "atomic.h"
 #include "messages.h"
+#include "mainloop-watchdog.h"
 
 /* notify code values */
 #define NC_CLOSE       1
@@ -61,6 +62,15 @@
 
 #define PIF_SOURCE            0x0020
 
+/* branch starting with this pipe is to be processed on the worker
+ * thread pool instead of the thread delivering the message */
+#define PIF_BRANCH_THREADED   0x0040
+
+/* the pipe is a destination only referenced by flags(passthrough) log
+ * statements, messages that still carry their raw frame may be written
+ * out verbatim, see cfg_tree_compile_passthrough_marks() */
+#define PIF_PASSTHROUGH       0x0080
+
 /* private flags range, to be used by other LogPipe instances for their own purposes */
 
 #define PIF_PRIVATE(x)       ((x) << 16)
@@ -240,6 +250,10 @@ void log_pipe_init_instance(LogPipe *self, GlobalConfig *cfg);
 void log_pipe_forward_notify(LogPipe *self, gint notify_code, gpointer user_data);
 EVTTAG *log_pipe_location_tag(LogPipe *pipe);
 
+/* the slow path of log_pipe_queue() while config profiling is enabled,
+ * implemented in cfg-tree.c next to the rest of the profile machinery */
+void log_pipe_queue_profiled(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options);
+
 static inline GlobalConfig *
 log_pipe_get_config(LogPipe *s)
 {
@@ -307,6 +321,8 @@ log_pipe_forward_msg(LogPipe *self, LogMessage *msg, const LogPathOptions *path_
 static inline void
 log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
+  LogPipe *wd_prev;
+
   g_assert((s->flags & PIF_INITIALIZED) != 0);
 
   if (G_UNLIKELY(pipe_single_step_hook))
@@ -332,7 +348,14 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
         }
     }
 
-  if (s->queue)
+  /* mark this pipe as the one being executed by this thread, so the
+   * watchdog can name it if the thread stops making progress in here */
+  wd_prev = main_loop_watchdog_pipe_enter(s);
+  if (G_UNLIKELY(cfg_tree_profile_enabled && s->expr_node))
+    {
+      log_pipe_queue_profiled(s, msg, path_options);
+    }
+  else if (s->queue)
     {
       s->queue(s, msg, path_options, s->queue_data);
     }
@@ -340,6 +363,7 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
     {
       log_pipe_forward_msg(s, msg, path_options);
     }
+  main_loop_watchdog_pipe_leave(wd_prev);
 }
 
 static inline LogPipe *
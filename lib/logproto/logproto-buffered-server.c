@@ -23,7 +23,9 @@
  */
 #include "logproto-buffered-server.h"
 #include "messages.h"
+#include "memusage.h"
 #include "serialize.h"
+#include "timeutils.h"
 #include "compat/string.h"
 
 #include <sys/stat.h>
@@ -35,8 +37,197 @@ typedef struct _BufferedServerBookmarkData
   gint32 pending_buffer_pos;
   gint64 pending_raw_stream_pos;
   gint32 pending_raw_buffer_size;
+  gint pos_sync_freq;
 } BufferedServerBookmarkData;
 
+/* Coalesced position persistence.
+ *
+ * Confirmed positions used to be written into the persist file entry for
+ * every acked message (or ack batch), which on busy file sources means
+ * thousands of tiny updates per second, each dirtying the mapped persist
+ * file and hitting the global persist mapping lock.  Instead, the
+ * furthest confirmed position is tracked here in memory and only written
+ * back when pos-sync-freq() seconds have elapsed since the last write,
+ * or when the stream position advanced by more than a fixed byte delta.
+ * After a crash we restart from the last written position, so the
+ * trade-off is re-reading (and duplicating) at most this window's worth
+ * of messages; pos-sync-freq(0) restores write-per-confirmation.
+ *
+ * The trackers deliberately do not point back to the LogProtoServer
+ * instance: bookmark saves are triggered by message acks, which can
+ * arrive after the proto that filled the bookmark is gone (e.g. a file
+ * got reopened on rotation).  They are keyed by the persist entry
+ * handle, which -- like the PersistState itself -- outlives the proto.
+ */
+#define BUFFERED_SERVER_POS_SYNC_MAX_DELTA (1024 * 1024)
+
+typedef struct _BufferedServerPosTracker
+{
+  PersistState *persist_state;
+  gint32 unflushed_buffer_pos;
+  gint64 unflushed_raw_stream_pos;
+  gint32 unflushed_raw_buffer_size;
+  gint64 flushed_raw_stream_pos;
+  time_t last_sync_time;
+  gboolean dirty;
+} BufferedServerPosTracker;
+
+static GStaticMutex buffered_server_pos_trackers_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *buffered_server_pos_trackers;
+
+/* NOTE: requires buffered_server_pos_trackers_lock to be held */
+static BufferedServerPosTracker *
+_pos_tracker_lookup(PersistState *persist_state, PersistEntryHandle handle)
+{
+  BufferedServerPosTracker *tracker;
+
+  if (!buffered_server_pos_trackers)
+    buffered_server_pos_trackers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+  tracker = g_hash_table_lookup(buffered_server_pos_trackers, GUINT_TO_POINTER(handle));
+  if (!tracker)
+    {
+      tracker = g_new0(BufferedServerPosTracker, 1);
+      tracker->persist_state = persist_state;
+      g_hash_table_insert(buffered_server_pos_trackers, GUINT_TO_POINTER(handle), tracker);
+    }
+  else if (tracker->persist_state != persist_state)
+    {
+      /* same handle value in a different persist state, the one this
+       * tracker belonged to is gone */
+      memset(tracker, 0, sizeof(*tracker));
+      tracker->persist_state = persist_state;
+    }
+  return tracker;
+}
+
+/* NOTE: requires buffered_server_pos_trackers_lock to be held */
+static void
+_pos_tracker_write_back(BufferedServerPosTracker *tracker, PersistState *persist_state, PersistEntryHandle handle)
+{
+  LogProtoBufferedServerState *state = persist_state_map_entry(persist_state, handle);
+
+  state->buffer_pos = tracker->unflushed_buffer_pos;
+  state->raw_stream_pos = tracker->unflushed_raw_stream_pos;
+  state->raw_buffer_size = tracker->unflushed_raw_buffer_size;
+
+  msg_trace("Confirmed position written to persistent state",
+            evt_tag_int("raw_stream_pos", state->raw_stream_pos),
+            evt_tag_int("raw_buffer_len", state->raw_buffer_size),
+            evt_tag_int("buffer_pos", state->buffer_pos),
+            NULL);
+  persist_state_unmap_entry(persist_state, handle);
+
+  tracker->flushed_raw_stream_pos = tracker->unflushed_raw_stream_pos;
+  tracker->last_sync_time = cached_g_current_time_sec();
+  tracker->dirty = FALSE;
+}
+
+/* forget coalescing state for an entry whose contents were reloaded
+ * behind our back (restart_with_state) */
+static void
+_pos_tracker_forget(PersistState *persist_state, PersistEntryHandle handle)
+{
+  g_static_mutex_lock(&buffered_server_pos_trackers_lock);
+  if (buffered_server_pos_trackers)
+    g_hash_table_remove(buffered_server_pos_trackers, GUINT_TO_POINTER(handle));
+  g_static_mutex_unlock(&buffered_server_pos_trackers_lock);
+}
+
+/* write back any coalesced position still sitting in memory; called when
+ * the proto is freed so a graceful shutdown does not lose the window */
+static void
+_pos_tracker_flush_pending(PersistState *persist_state, PersistEntryHandle handle)
+{
+  BufferedServerPosTracker *tracker;
+
+  g_static_mutex_lock(&buffered_server_pos_trackers_lock);
+  if (buffered_server_pos_trackers)
+    {
+      tracker = g_hash_table_lookup(buffered_server_pos_trackers, GUINT_TO_POINTER(handle));
+      if (tracker && tracker->persist_state == persist_state && tracker->dirty)
+        _pos_tracker_write_back(tracker, persist_state, handle);
+    }
+  g_static_mutex_unlock(&buffered_server_pos_trackers_lock);
+}
+
+/* Shared pool of read buffers, keyed by buffer size.
+ *
+ * With tens of thousands of mostly idle connections, giving each one a
+ * private buffer for its entire lifetime wastes a lot of memory: the
+ * buffer only holds live data between the read() that filled it and the
+ * point all complete messages were extracted from it.  Instead, buffers
+ * are borrowed from this pool when a connection becomes readable (see
+ * log_proto_buffered_server_allocate_buffer) and are given back when a
+ * fetch returns to the poll loop with the buffer completely drained (see
+ * log_proto_buffered_server_release_buffer_if_idle).  Connections
+ * holding a partial message keep their buffer until it drains.
+ *
+ * The pool retains at most LOG_PROTO_BUFFER_POOL_MAX_PER_SIZE buffers
+ * per size class, anything above that is freed outright, so a burst of
+ * concurrent activity does not leave an oversized pool behind.
+ */
+#define LOG_PROTO_BUFFER_POOL_MAX_PER_SIZE 64
+
+static GStaticMutex log_proto_buffer_pool_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *log_proto_buffer_pool;
+
+static guchar *
+log_proto_buffer_pool_acquire(gsize buffer_size)
+{
+  guchar *buffer = NULL;
+
+  g_static_mutex_lock(&log_proto_buffer_pool_lock);
+  if (log_proto_buffer_pool)
+    {
+      GPtrArray *buffers;
+
+      buffers = g_hash_table_lookup(log_proto_buffer_pool, GSIZE_TO_POINTER(buffer_size));
+      if (buffers && buffers->len > 0)
+        {
+          buffer = g_ptr_array_index(buffers, buffers->len - 1);
+          g_ptr_array_set_size(buffers, buffers->len - 1);
+        }
+    }
+  g_static_mutex_unlock(&log_proto_buffer_pool_lock);
+
+  if (!buffer)
+    {
+      buffer = g_malloc(buffer_size);
+      memusage_count_alloc(MEMUSAGE_PROTO_BUFFER, buffer_size);
+    }
+  return buffer;
+}
+
+static void
+log_proto_buffer_pool_release(guchar *buffer, gsize buffer_size)
+{
+  GPtrArray *buffers;
+
+  g_static_mutex_lock(&log_proto_buffer_pool_lock);
+  if (!log_proto_buffer_pool)
+    log_proto_buffer_pool = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  buffers = g_hash_table_lookup(log_proto_buffer_pool, GSIZE_TO_POINTER(buffer_size));
+  if (!buffers)
+    {
+      buffers = g_ptr_array_new();
+      g_hash_table_insert(log_proto_buffer_pool, GSIZE_TO_POINTER(buffer_size), buffers);
+    }
+  if (buffers->len < LOG_PROTO_BUFFER_POOL_MAX_PER_SIZE)
+    {
+      g_ptr_array_add(buffers, buffer);
+      buffer = NULL;
+    }
+  g_static_mutex_unlock(&log_proto_buffer_pool_lock);
+
+  if (buffer)
+    {
+      memusage_count_free(MEMUSAGE_PROTO_BUFFER, buffer_size);
+      g_free(buffer);
+    }
+}
+
 LogProtoBufferedServerState *
 log_proto_buffered_server_get_state(LogProtoBufferedServer *self)
 {
@@ -127,6 +318,8 @@ log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const g
                     state->buffer_size = self->super.options->max_buffer_size;
 
                   self->buffer = g_realloc(self->buffer, state->buffer_size);
+                  memusage_count_alloc(MEMUSAGE_PROTO_BUFFER, state->buffer_size - self->buffer_alloc_size);
+                  self->buffer_alloc_size = state->buffer_size;
 
                   /* recalculate the out pointer, and add what we have now */
                   ret = -1;
@@ -181,7 +374,8 @@ log_proto_buffered_server_apply_state(LogProtoBufferedServer *self, PersistEntry
 
   if (!self->buffer)
     {
-      self->buffer = g_malloc(state->buffer_size);
+      self->buffer = log_proto_buffer_pool_acquire(state->buffer_size);
+      self->buffer_alloc_size = state->buffer_size;
     }
   state->pending_buffer_end = 0;
 
@@ -315,6 +509,11 @@ log_proto_buffered_server_apply_state(LogProtoBufferedServer *self, PersistEntry
 
   state = NULL;
   log_proto_buffered_server_put_state(self);
+
+  /* the entry was rewritten from scratch, any coalesced position still
+   * held for it in memory is stale */
+  if (self->persist_state)
+    _pos_tracker_forget(self->persist_state, handle);
 }
 
 static PersistEntryHandle
@@ -406,6 +605,8 @@ log_proto_buffered_server_convert_state(LogProtoBufferedServer *self, guint8 per
         {
           gsize buffer_size = MAX(self->super.options->init_buffer_size, buffer_len);
           self->buffer = g_realloc(self->buffer, buffer_size);
+          memusage_count_alloc(MEMUSAGE_PROTO_BUFFER, buffer_size - self->buffer_alloc_size);
+          self->buffer_alloc_size = buffer_size;
         }
       serialize_archive_free(archive);
 
@@ -605,7 +806,8 @@ static inline void
 log_proto_buffered_server_allocate_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
 {
   state->buffer_size = self->super.options->init_buffer_size;
-  self->buffer = g_malloc(state->buffer_size);
+  self->buffer = log_proto_buffer_pool_acquire(state->buffer_size);
+  self->buffer_alloc_size = state->buffer_size;
 }
 
 static inline gint
@@ -732,23 +934,46 @@ _buffered_server_update_pos(LogProtoServer *s)
   log_proto_buffered_server_put_state(self);
 }
 
+/* called when fetch returns to the poll loop without a message in
+ * flight; if the buffer holds no unprocessed data, give it back to the
+ * shared pool so idle connections do not pin buffer memory.  It is
+ * reacquired by the next fetch_into_buffer call. */
+static void
+log_proto_buffered_server_release_buffer_if_idle(LogProtoBufferedServer *self)
+{
+  LogProtoBufferedServerState *state;
+
+  if (!self->buffer)
+    return;
+
+  state = log_proto_buffered_server_get_state(self);
+  if (state->pending_buffer_pos == 0 && state->pending_buffer_end == 0)
+    {
+      log_proto_buffer_pool_release(self->buffer, state->buffer_size);
+      self->buffer = NULL;
+    }
+  log_proto_buffered_server_put_state(self);
+}
+
 static void
 _buffered_server_bookmark_save(Bookmark *bookmark)
 {
   BufferedServerBookmarkData *bookmark_data = (BufferedServerBookmarkData *)(&bookmark->container);
-  LogProtoBufferedServerState *state = persist_state_map_entry(bookmark->persist_state, bookmark_data->persist_handle);
+  BufferedServerPosTracker *tracker;
 
-  state->buffer_pos = bookmark_data->pending_buffer_pos;
-  state->raw_stream_pos = bookmark_data->pending_raw_stream_pos;
-  state->raw_buffer_size = bookmark_data->pending_raw_buffer_size;
+  g_static_mutex_lock(&buffered_server_pos_trackers_lock);
+  tracker = _pos_tracker_lookup(bookmark->persist_state, bookmark_data->persist_handle);
 
-  msg_trace("Last message got confirmed",
-            evt_tag_int("raw_stream_pos", state->raw_stream_pos),
-            evt_tag_int("raw_buffer_len", state->raw_buffer_size),
-            evt_tag_int("buffer_pos", state->buffer_pos),
-            evt_tag_int("buffer_end", state->pending_buffer_end),
-            NULL);
-  persist_state_unmap_entry(bookmark->persist_state, bookmark_data->persist_handle);
+  tracker->unflushed_buffer_pos = bookmark_data->pending_buffer_pos;
+  tracker->unflushed_raw_stream_pos = bookmark_data->pending_raw_stream_pos;
+  tracker->unflushed_raw_buffer_size = bookmark_data->pending_raw_buffer_size;
+  tracker->dirty = TRUE;
+
+  if (bookmark_data->pos_sync_freq == 0 ||
+      cached_g_current_time_sec() - tracker->last_sync_time >= bookmark_data->pos_sync_freq ||
+      tracker->unflushed_raw_stream_pos - tracker->flushed_raw_stream_pos >= BUFFERED_SERVER_POS_SYNC_MAX_DELTA)
+    _pos_tracker_write_back(tracker, bookmark->persist_state, bookmark_data->persist_handle);
+  g_static_mutex_unlock(&buffered_server_pos_trackers_lock);
 }
 
 static void
@@ -761,6 +986,7 @@ _buffered_server_bookmark_fill(LogProtoBufferedServer *self, Bookmark *bookmark)
   data->pending_raw_stream_pos = state->pending_raw_stream_pos;
   data->pending_raw_buffer_size = state->pending_raw_buffer_size;
   data->persist_handle = self->persist_handle;
+  data->pos_sync_freq = self->super.options->pos_sync_freq;
   bookmark->save = _buffered_server_bookmark_save;
 
   log_proto_buffered_server_put_state(self);
@@ -834,6 +1060,12 @@ log_proto_buffered_server_fetch(LogProtoServer *s, const guchar **msg, gsize *ms
           _buffered_server_bookmark_fill(self, bookmark);
           _buffered_server_update_pos(&self->super);
         }
+      else
+        {
+          /* no message is being returned, thus nothing points into the
+           * buffer: safe to detach it if it is fully drained */
+          log_proto_buffered_server_release_buffer_if_idle(self);
+        }
     }
   return result;
 }
@@ -866,8 +1098,13 @@ log_proto_buffered_server_free_method(LogProtoServer *s)
 {
   LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
 
+  if (self->persist_state && self->persist_handle)
+    _pos_tracker_flush_pending(self->persist_state, self->persist_handle);
+
   log_transport_aux_data_destroy(&self->buffer_aux);
 
+  if (self->buffer)
+    memusage_count_free(MEMUSAGE_PROTO_BUFFER, self->buffer_alloc_size);
   g_free(self->buffer);
   if (self->state1)
     {
@@ -88,6 +88,8 @@ struct _LogProtoBufferedServer
   PersistEntryHandle persist_handle;
   GIConv convert;
   guchar *buffer;
+  /* allocated size of buffer, tracked for the memory accounting */
+  gsize buffer_alloc_size;
 
   /* auxiliary data (e.g. GSockAddr, other transport related meta
    * data) associated with the already buffered data */
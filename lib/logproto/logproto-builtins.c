@@ -22,11 +22,15 @@
  *
  */
 #include "logproto-dgram-server.h"
+#include "logproto-ewmm-client.h"
+#include "logproto-ewmm-server.h"
 #include "logproto-text-client.h"
 #include "logproto-text-server.h"
 #include "logproto-indented-multiline-server.h"
 #include "logproto-framed-client.h"
 #include "logproto-framed-server.h"
+#include "logproto-gzip-client.h"
+#include "logproto-gzip-server.h"
 #include "plugin.h"
 #include "plugin-types.h"
 
@@ -40,6 +44,10 @@ DEFINE_LOG_PROTO_SERVER(log_proto_text);
 DEFINE_LOG_PROTO_SERVER(log_proto_indented_multiline);
 DEFINE_LOG_PROTO_CLIENT(log_proto_framed);
 DEFINE_LOG_PROTO_SERVER(log_proto_framed);
+DEFINE_LOG_PROTO_CLIENT(log_proto_gzip);
+DEFINE_LOG_PROTO_SERVER(log_proto_gzip);
+DEFINE_LOG_PROTO_CLIENT(log_proto_ewmm);
+DEFINE_LOG_PROTO_SERVER(log_proto_ewmm);
 
 static Plugin framed_server_plugins[] =
 {
@@ -51,6 +59,17 @@ static Plugin framed_server_plugins[] =
   LOG_PROTO_SERVER_PLUGIN(log_proto_indented_multiline, "indented-multiline"),
   LOG_PROTO_CLIENT_PLUGIN(log_proto_framed, "framed"),
   LOG_PROTO_SERVER_PLUGIN(log_proto_framed, "framed"),
+  LOG_PROTO_CLIENT_PLUGIN(log_proto_gzip, "gzip"),
+  LOG_PROTO_SERVER_PLUGIN(log_proto_gzip, "gzip"),
+  LOG_PROTO_CLIENT_PLUGIN(log_proto_ewmm, "ewmm"),
+  LOG_PROTO_SERVER_PLUGIN(log_proto_ewmm, "ewmm"),
+  /* the format() counterpart of the ewmm protos, deserializing the
+   * relayed frames back into LogMessages */
+  {
+    .type = LL_CONTEXT_FORMAT,
+    .name = "ewmm",
+    .construct = log_proto_ewmm_format_construct,
+  },
 };
 
 void
@@ -35,6 +35,35 @@ log_proto_client_validate_options_method(LogProtoClient *s)
   return TRUE;
 }
 
+/*
+ * Generic fallback for protos without a gather write implementation:
+ * submit the entries one by one through post().  post() takes ownership
+ * of the buffer it consumes, while batch entries remain owned by the
+ * caller, so each entry is duplicated before being handed over.
+ */
+LogProtoStatus
+log_proto_client_post_batch_method(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed)
+{
+  LogProtoStatus status = LPS_SUCCESS;
+  gint i;
+
+  *num_consumed = 0;
+  for (i = 0; i < num_entries; i++)
+    {
+      gboolean consumed = FALSE;
+      guchar *msg = g_memdup(entries[i].msg, entries[i].msg_len);
+
+      status = log_proto_client_post(s, msg, entries[i].msg_len, &consumed);
+      if (consumed)
+        (*num_consumed)++;
+      else
+        g_free(msg);
+      if (status != LPS_SUCCESS || !consumed)
+        break;
+    }
+  return status;
+}
+
 void
 log_proto_client_free_method(LogProtoClient *s)
 {
@@ -42,6 +42,18 @@ typedef union _LogProtoClientOptionsStorage
   gchar __padding[LOG_PROTO_CLIENT_OPTIONS_SIZE];
 } LogProtoClientOptionsStorage;
 
+/* upper bound on the number of messages submitted by a single gather
+ * write, also bounds the iovec array protos put on the stack */
+#define LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES 32
+
+/* one formatted message of a gather write batch; the buffer stays owned
+ * by the caller, protos must copy whatever they need to keep */
+typedef struct _LogProtoClientBatchEntry
+{
+  guchar *msg;
+  gsize msg_len;
+} LogProtoClientBatchEntry;
+
 typedef void (*LogProtoClientAckCallback)(gint num_msg_acked, gpointer user_data);
 typedef void (*LogProtoClientRewindCallback)(gpointer user_data);
 
@@ -61,9 +73,20 @@ struct _LogProtoClient
   LogProtoStatus status;
   const LogProtoClientOptions *options;
   LogTransport *transport;
+  /* number of bytes the writer should reserve at the front of each
+   * formatted message; the proto writes its per-message header (e.g. the
+   * octet count of the framed protocol) into this space at post time, so
+   * header and payload go out as one contiguous record instead of a
+   * separate header write */
+  gsize post_header_reserve;
+  /* the proto transmits the serialized (binary) form of messages; the
+   * writer checks this flag and posts the log_msg_write() representation
+   * instead of template formatted text */
+  gboolean post_serialized_payload;
   /* FIXME: rename to something else */
   gboolean (*prepare)(LogProtoClient *s, gint *fd, GIOCondition *cond);
   LogProtoStatus (*post)(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed);
+  LogProtoStatus (*post_batch)(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed);
   LogProtoStatus (*flush)(LogProtoClient *s);
   gboolean (*validate_options)(LogProtoClient *s);
   void (*free_fn)(LogProtoClient *s);
@@ -118,6 +141,28 @@ log_proto_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *c
   return s->post(s, msg, msg_len, consumed);
 }
 
+LogProtoStatus log_proto_client_post_batch_method(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed);
+
+static inline LogProtoStatus
+log_proto_client_post_batch(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed)
+{
+  if (s->post_batch)
+    return s->post_batch(s, entries, num_entries, num_consumed);
+  return log_proto_client_post_batch_method(s, entries, num_entries, num_consumed);
+}
+
+static inline gsize
+log_proto_client_get_post_header_reserve(LogProtoClient *s)
+{
+  return s->post_header_reserve;
+}
+
+static inline gboolean
+log_proto_client_get_post_serialized_payload(LogProtoClient *s)
+{
+  return s->post_serialized_payload;
+}
+
 static inline gint
 log_proto_client_get_fd(LogProtoClient *s)
 {
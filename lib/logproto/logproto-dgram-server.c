@@ -23,6 +23,28 @@
  */
 #include "logproto-dgram-server.h"
 #include "logproto-buffered-server.h"
+#include "stats/stats-registry.h"
+
+#include <string.h>
+
+/* number of datagrams pulled in with a single batched receive call; the
+ * tail of the batch is handed out from user space, so a burst doesn't
+ * have to survive in the socket buffer until we get around to it */
+#define DGRAM_SERVER_BATCH_SIZE 64
+
+/* initial per-record slot size of the batch storage; the vast majority of
+ * syslog datagrams are well below 2k, sizing each of the 64 slots for the
+ * maximum message size would pin down megabytes per connection.  Slots are
+ * doubled whenever the kernel flags a truncated receive, up to the
+ * configured maximum. */
+#define DGRAM_SERVER_INITIAL_RECORD_SIZE 2048
+
+/* byte size histogram bucket upper bounds, datagrams larger than the last
+ * bound are counted in an open ended overflow bucket */
+static const gsize dgram_size_buckets[] = { 256, 512, 1024, 2048, 8192 };
+static const gchar *dgram_size_bucket_names[] = { "le_256", "le_512", "le_1024", "le_2048", "le_8192", "over_8192" };
+
+#define DGRAM_SIZE_BUCKETS G_N_ELEMENTS(dgram_size_buckets)
 
 /* proto that reads the input in datagrams (e.g. the underlying transport
  * determines record sizes, such as UDP) */
@@ -30,6 +52,18 @@ typedef struct _LogProtoDGramServer LogProtoDGramServer;
 struct _LogProtoDGramServer
 {
   LogProtoBufferedServer super;
+  guchar *batch_storage;
+  gsize batch_record_size;
+  gsize batch_record_limit;
+  gboolean batch_grow_pending;
+  LogTransportRecord batch_records[DGRAM_SERVER_BATCH_SIZE];
+  LogTransportAuxData batch_aux[DGRAM_SERVER_BATCH_SIZE];
+  gint batch_count;
+  gint batch_pos;
+  StatsCounterItem *batch_reads;
+  StatsCounterItem *batch_messages;
+  StatsCounterItem *truncated_dgrams;
+  StatsCounterItem *size_histogram[DGRAM_SIZE_BUCKETS + 1];
 };
 
 static gboolean
@@ -47,13 +81,165 @@ log_proto_dgram_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar
   return TRUE;
 }
 
+static void
+log_proto_dgram_server_account_size(LogProtoDGramServer *self, gsize msg_len)
+{
+  gint i;
+
+  for (i = 0; i < DGRAM_SIZE_BUCKETS; i++)
+    {
+      if (msg_len <= dgram_size_buckets[i])
+        {
+          stats_counter_inc(self->size_histogram[i]);
+          return;
+        }
+    }
+  stats_counter_inc(self->size_histogram[DGRAM_SIZE_BUCKETS]);
+}
+
+static gint
+log_proto_dgram_server_fill_batch(LogProtoDGramServer *self, gsize record_size)
+{
+  gint rc, i;
+
+  if (G_UNLIKELY(!self->batch_storage))
+    {
+      self->batch_record_limit = record_size;
+      self->batch_record_size = MIN(DGRAM_SERVER_INITIAL_RECORD_SIZE, record_size);
+      self->batch_storage = g_malloc(self->batch_record_size * DGRAM_SERVER_BATCH_SIZE);
+    }
+  else if (G_UNLIKELY(self->batch_grow_pending))
+    {
+      /* the previous batch has been fully consumed at this point, the
+       * storage can be resized without invalidating handed out records */
+      if (self->batch_record_size < self->batch_record_limit)
+        {
+          self->batch_record_size = MIN(self->batch_record_size * 2, self->batch_record_limit);
+          self->batch_storage = g_realloc(self->batch_storage, self->batch_record_size * DGRAM_SERVER_BATCH_SIZE);
+        }
+      self->batch_grow_pending = FALSE;
+    }
+  for (i = 0; i < DGRAM_SERVER_BATCH_SIZE; i++)
+    {
+      self->batch_records[i].buf = self->batch_storage + i * self->batch_record_size;
+      self->batch_records[i].buflen = self->batch_record_size;
+      log_transport_aux_data_reinit(&self->batch_aux[i]);
+      self->batch_records[i].aux = &self->batch_aux[i];
+    }
+
+  rc = log_transport_read_records(self->super.super.transport, self->batch_records, DGRAM_SERVER_BATCH_SIZE);
+  if (rc <= 0)
+    return rc;
+
+  for (i = 0; i < rc; i++)
+    {
+      log_proto_dgram_server_account_size(self, self->batch_records[i].msg_len);
+      if (G_UNLIKELY(self->batch_records[i].truncated))
+        {
+          /* the tail of this datagram is gone; the kernel hands out
+           * consumed datagrams only, so all that can be done is to
+           * account for it and to grow the slots for subsequent batches */
+          stats_counter_inc(self->truncated_dgrams);
+          self->batch_grow_pending = TRUE;
+        }
+    }
+
+  self->batch_count = rc;
+  self->batch_pos = 0;
+  stats_counter_inc(self->batch_reads);
+  stats_counter_add(self->batch_messages, rc);
+  return rc;
+}
+
+/* hand out datagrams from the current batch one by one, pulling in a new
+ * batch with a single syscall whenever it runs dry */
+static gint
+log_proto_dgram_server_read_data(LogProtoBufferedServer *s, guchar *buf, gsize len, LogTransportAuxData *aux)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+  LogTransportRecord *record;
+  gsize copy_len;
+  gint rc;
+
+  if (!s->super.transport->read_records)
+    return log_transport_read(s->super.transport, buf, len, aux);
+
+  while (self->batch_pos >= self->batch_count ||
+         self->batch_records[self->batch_pos].msg_len == 0)
+    {
+      if (self->batch_pos < self->batch_count)
+        {
+          /* skip empty datagrams, a zero return would look like an EOF
+           * to the buffered server */
+          self->batch_pos++;
+          continue;
+        }
+      rc = log_proto_dgram_server_fill_batch(self, len);
+      if (rc <= 0)
+        return rc;
+    }
+
+  record = &self->batch_records[self->batch_pos];
+  copy_len = MIN((gsize) record->msg_len, len);
+  memcpy(buf, record->buf, copy_len);
+  if (aux)
+    log_transport_aux_data_copy(aux, record->aux);
+  self->batch_pos++;
+  return copy_len;
+}
+
+static gboolean
+log_proto_dgram_server_prepare(LogProtoServer *s, GIOCondition *cond)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+
+  if (log_proto_buffered_server_prepare(s, cond))
+    return TRUE;
+
+  /* datagrams still batched in user space must be processed without
+   * waiting for the fd to become readable again */
+  return self->batch_pos < self->batch_count;
+}
+
+static void
+log_proto_dgram_server_free(LogProtoServer *s)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+  gint i;
+
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "dgram_batch_reads", NULL, SC_TYPE_PROCESSED, &self->batch_reads);
+  stats_unregister_counter(SCS_GLOBAL, "dgram_batch_messages", NULL, SC_TYPE_PROCESSED, &self->batch_messages);
+  stats_unregister_counter(SCS_GLOBAL, "dgram_truncated", NULL, SC_TYPE_DROPPED, &self->truncated_dgrams);
+  for (i = 0; i < DGRAM_SIZE_BUCKETS + 1; i++)
+    stats_unregister_counter(SCS_GLOBAL, "dgram_size", dgram_size_bucket_names[i], SC_TYPE_PROCESSED, &self->size_histogram[i]);
+  stats_unlock();
+
+  for (i = 0; i < DGRAM_SERVER_BATCH_SIZE; i++)
+    log_transport_aux_data_destroy(&self->batch_aux[i]);
+  g_free(self->batch_storage);
+  log_proto_buffered_server_free_method(s);
+}
+
 LogProtoServer *
 log_proto_dgram_server_new(LogTransport *transport, const LogProtoServerOptions *options)
 {
   LogProtoDGramServer *self = g_new0(LogProtoDGramServer, 1);
+  gint i;
 
   log_proto_buffered_server_init(&self->super, transport, options);
   self->super.fetch_from_buffer = log_proto_dgram_server_fetch_from_buffer;
+  self->super.read_data = log_proto_dgram_server_read_data;
+  self->super.super.prepare = log_proto_dgram_server_prepare;
+  self->super.super.free_fn = log_proto_dgram_server_free;
   self->super.stream_based = FALSE;
+
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "dgram_batch_reads", NULL, SC_TYPE_PROCESSED, &self->batch_reads);
+  stats_register_counter(0, SCS_GLOBAL, "dgram_batch_messages", NULL, SC_TYPE_PROCESSED, &self->batch_messages);
+  stats_register_counter(0, SCS_GLOBAL, "dgram_truncated", NULL, SC_TYPE_DROPPED, &self->truncated_dgrams);
+  for (i = 0; i < DGRAM_SIZE_BUCKETS + 1; i++)
+    stats_register_counter(0, SCS_GLOBAL, "dgram_size", dgram_size_bucket_names[i], SC_TYPE_PROCESSED, &self->size_histogram[i]);
+  stats_unlock();
   return &self->super.super;
 }
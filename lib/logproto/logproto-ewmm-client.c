@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logproto-ewmm-client.h"
+#include "logproto-ewmm.h"
+#include "logmsg.h"
+#include "serialize.h"
+#include "messages.h"
+
+/*
+ * Client side of the binary relay protocol: the writer serializes
+ * messages with log_msg_write() (see post_serialized_payload) and this
+ * proto frames the resulting payloads, so downstream hops deserialize
+ * the parsed name-value table instead of re-parsing message text.
+ *
+ * This is a standalone implementation instead of a LogProtoTextClient
+ * subclass because the handshake must go out in front of the first
+ * message without being acknowledged as one: the text client
+ * acknowledges whatever partial write drains, which would inflate the
+ * window by one per connection.  Pending output lives in a single
+ * buffer here and acks are counted explicitly.
+ */
+
+typedef struct _LogProtoEWMMClient
+{
+  LogProtoClient super;
+  GString *obuf;
+  gsize obuf_pos;
+  gint ack_pending;
+  gboolean handshake_sent;
+} LogProtoEWMMClient;
+
+static gboolean
+log_proto_ewmm_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
+{
+  LogProtoEWMMClient *self = (LogProtoEWMMClient *) s;
+
+  *fd = self->super.transport->fd;
+  *cond = self->super.transport->cond;
+
+  /* if there's no pending I/O in the transport layer, then we want to do a write */
+  if (*cond == 0)
+    *cond = G_IO_OUT;
+  return self->obuf_pos < self->obuf->len;
+}
+
+static LogProtoStatus
+log_proto_ewmm_client_flush(LogProtoClient *s)
+{
+  LogProtoEWMMClient *self = (LogProtoEWMMClient *) s;
+  gint rc;
+
+  while (self->obuf_pos < self->obuf->len)
+    {
+      rc = log_transport_write(self->super.transport, self->obuf->str + self->obuf_pos, self->obuf->len - self->obuf_pos);
+      if (rc < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            {
+              msg_error("I/O error occurred while writing",
+                        evt_tag_int("fd", self->super.transport->fd),
+                        evt_tag_errno(EVT_TAG_OSERROR, errno),
+                        NULL);
+              return LPS_ERROR;
+            }
+          return LPS_SUCCESS;
+        }
+      self->obuf_pos += rc;
+    }
+
+  g_string_truncate(self->obuf, 0);
+  self->obuf_pos = 0;
+  if (self->ack_pending)
+    {
+      log_proto_client_msg_ack(&self->super, self->ack_pending);
+      self->ack_pending = 0;
+    }
+  return LPS_SUCCESS;
+}
+
+/* announce the builtin value set of this process, see logproto-ewmm.h */
+static void
+log_proto_ewmm_client_write_handshake(SerializeArchive *sa)
+{
+  NVHandle handle;
+
+  serialize_write_blob(sa, LOG_PROTO_EWMM_MAGIC, LOG_PROTO_EWMM_MAGIC_LEN);
+  serialize_write_uint8(sa, LOG_PROTO_EWMM_VERSION);
+  serialize_write_varint(sa, LM_V_MAX - 1);
+  for (handle = 1; handle < LM_V_MAX; handle++)
+    serialize_write_cstring(sa, log_msg_get_value_name(handle, NULL), -1);
+}
+
+static LogProtoStatus
+log_proto_ewmm_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoEWMMClient *self = (LogProtoEWMMClient *) s;
+  SerializeArchive *sa;
+  LogProtoStatus status;
+
+  *consumed = FALSE;
+  status = log_proto_ewmm_client_flush(s);
+  if (status != LPS_SUCCESS)
+    return status;
+  if (self->obuf_pos < self->obuf->len)
+    {
+      /* the previous frame is still on its way out, writing now would
+       * interleave the two frames */
+      return LPS_SUCCESS;
+    }
+
+  sa = serialize_string_archive_new(self->obuf);
+  if (!self->handshake_sent)
+    {
+      log_proto_ewmm_client_write_handshake(sa);
+      self->handshake_sent = TRUE;
+    }
+  serialize_write_uint32(sa, msg_len);
+  serialize_write_blob(sa, msg, msg_len);
+  serialize_archive_free(sa);
+  g_free(msg);
+
+  *consumed = TRUE;
+  self->ack_pending++;
+  return log_proto_ewmm_client_flush(s);
+}
+
+static void
+log_proto_ewmm_client_free(LogProtoClient *s)
+{
+  LogProtoEWMMClient *self = (LogProtoEWMMClient *) s;
+
+  g_string_free(self->obuf, TRUE);
+  log_proto_client_free_method(s);
+}
+
+LogProtoClient *
+log_proto_ewmm_client_new(LogTransport *transport, const LogProtoClientOptions *options)
+{
+  LogProtoEWMMClient *self = g_new0(LogProtoEWMMClient, 1);
+
+  log_proto_client_init(&self->super, transport, options);
+  self->super.prepare = log_proto_ewmm_client_prepare;
+  self->super.flush = log_proto_ewmm_client_flush;
+  self->super.post = log_proto_ewmm_client_post;
+  self->super.free_fn = log_proto_ewmm_client_free;
+  self->super.post_serialized_payload = TRUE;
+  self->obuf = g_string_sized_new(256);
+  return &self->super;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logproto-ewmm-server.h"
+#include "logproto-ewmm.h"
+#include "logmsg.h"
+#include "msg-format.h"
+#include "serialize.h"
+#include "messages.h"
+
+#include <string.h>
+
+/*
+ * Server side of the binary relay protocol: validates the handshake sent
+ * at connection start (see logproto-ewmm.h) and then slices the length
+ * prefixed log_msg_write() frames out of the stream.  The frames are
+ * handed to the reader as-is; the format(ewmm) handler at the bottom of
+ * this file deserializes them into LogMessages, so a relay receiving on
+ * this proto never re-parses message text.
+ */
+
+#define LPEWS_HANDSHAKE_READ 0
+#define LPEWS_FRAME_READ     1
+#define LPEWS_MESSAGE_READ   2
+
+#define LPEWS_FRAME_HEADER_SIZE 4
+
+typedef struct _LogProtoEWMMServer
+{
+  LogProtoServer super;
+  gint state;
+
+  guchar *buffer;
+  guint32 buffer_size, buffer_pos, buffer_end;
+  guint32 frame_len;
+} LogProtoEWMMServer;
+
+static gboolean
+log_proto_ewmm_server_prepare(LogProtoServer *s, GIOCondition *cond)
+{
+  LogProtoEWMMServer *self = (LogProtoEWMMServer *) s;
+
+  *cond = self->super.transport->cond;
+
+  /* undelivered data in the buffer may hold a complete frame */
+  if (self->buffer_pos != self->buffer_end)
+    return TRUE;
+
+  /* if there's no pending I/O in the transport layer, then we want to do a read */
+  if (*cond == 0)
+    *cond = G_IO_IN;
+
+  return FALSE;
+}
+
+static LogProtoStatus
+log_proto_ewmm_server_fetch_data(LogProtoEWMMServer *self, gboolean *may_read)
+{
+  gint rc;
+
+  if (self->buffer_pos == self->buffer_end)
+    self->buffer_pos = self->buffer_end = 0;
+
+  if (self->buffer_size == self->buffer_end)
+    {
+      /* no more space at the end of the buffer, shift the pending data
+       * to the beginning to make some */
+      memmove(self->buffer, &self->buffer[self->buffer_pos], self->buffer_end - self->buffer_pos);
+      self->buffer_end = self->buffer_end - self->buffer_pos;
+      self->buffer_pos = 0;
+    }
+
+  if (!(*may_read))
+    return LPS_SUCCESS;
+
+  rc = log_transport_read(self->super.transport, &self->buffer[self->buffer_end], self->buffer_size - self->buffer_end, NULL);
+
+  if (rc < 0)
+    {
+      if (errno != EAGAIN)
+        {
+          msg_error("Error reading ewmm framed data",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_errno("error", errno),
+                    NULL);
+          return LPS_ERROR;
+        }
+    }
+  else if (rc == 0)
+    {
+      msg_verbose("EOF occurred while reading",
+                  evt_tag_int(EVT_TAG_FD, self->super.transport->fd),
+                  NULL);
+      return LPS_EOF;
+    }
+  else
+    {
+      self->buffer_end += rc;
+    }
+  return LPS_SUCCESS;
+}
+
+/*
+ * Attempt to parse the handshake from the buffered data.  An archive
+ * running out of data means the handshake has not fully arrived yet, in
+ * which case the attempt is simply repeated from scratch on the next
+ * call; the handshake is a few hundred bytes once per connection, so the
+ * re-parse is not worth optimizing out.
+ *
+ * The name list is matched against the builtin values of this process:
+ * the serialized payload block copies the static entry array, so every
+ * static handle must mean the same value on both ends, otherwise the
+ * frames cannot be accepted.
+ */
+static LogProtoStatus
+log_proto_ewmm_server_parse_handshake(LogProtoEWMMServer *self, gboolean *need_more_data)
+{
+  SerializeArchive *sa;
+  gchar magic[LOG_PROTO_EWMM_MAGIC_LEN];
+  const gchar *local_name;
+  gchar *name = NULL;
+  guint64 count, i;
+  guint8 version;
+  LogProtoStatus status = LPS_ERROR;
+
+  *need_more_data = FALSE;
+  sa = serialize_buffer_archive_new((gchar *) &self->buffer[self->buffer_pos], self->buffer_end - self->buffer_pos);
+  sa->silent = TRUE;
+
+  if (!serialize_read_blob(sa, magic, sizeof(magic)) ||
+      !serialize_read_uint8(sa, &version))
+    goto short_data;
+
+  if (memcmp(magic, LOG_PROTO_EWMM_MAGIC, sizeof(magic)) != 0)
+    {
+      msg_error("Missing ewmm handshake, the peer is probably not sending in ewmm mode",
+                evt_tag_int("fd", self->super.transport->fd),
+                NULL);
+      goto exit;
+    }
+  if (version != LOG_PROTO_EWMM_VERSION)
+    {
+      msg_error("Unsupported ewmm protocol version",
+                evt_tag_int("version", version),
+                evt_tag_int("supported_version", LOG_PROTO_EWMM_VERSION),
+                NULL);
+      goto exit;
+    }
+
+  if (!serialize_read_varint(sa, &count))
+    goto short_data;
+  if (count != LM_V_MAX - 1)
+    {
+      msg_error("The ewmm peer was built with a different set of builtin values, cannot accept serialized messages",
+                evt_tag_int("peer_values", count),
+                evt_tag_int("local_values", LM_V_MAX - 1),
+                NULL);
+      goto exit;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      if (!serialize_read_cstring(sa, &name, NULL))
+        goto short_data;
+      local_name = log_msg_get_value_name(i + 1, NULL);
+      if (!local_name || strcmp(name, local_name) != 0)
+        {
+          msg_error("The ewmm peer maps a builtin value handle to a different name, cannot accept serialized messages",
+                    evt_tag_int("handle", (gint) (i + 1)),
+                    evt_tag_str("peer_name", name),
+                    evt_tag_str("local_name", local_name ? : "none"),
+                    NULL);
+          g_free(name);
+          goto exit;
+        }
+      g_free(name);
+      name = NULL;
+    }
+
+  self->buffer_pos += serialize_buffer_archive_get_pos(sa);
+  status = LPS_SUCCESS;
+  goto exit;
+
+ short_data:
+  *need_more_data = TRUE;
+  status = LPS_SUCCESS;
+ exit:
+  serialize_archive_free(sa);
+  return status;
+}
+
+/* make sure the upcoming frame_len bytes can fit the buffer at
+ * buffer_pos: grow the buffer up to max_buffer_size if needed and shift
+ * the pending data to the beginning otherwise */
+static void
+log_proto_ewmm_server_ensure_frame_space(LogProtoEWMMServer *self)
+{
+  if (self->buffer_size < self->super.options->max_buffer_size &&
+      self->frame_len > self->buffer_size - self->buffer_pos)
+    {
+      self->buffer_size = 2 * (self->frame_len + LPEWS_FRAME_HEADER_SIZE);
+
+      if (self->buffer_size > self->super.options->max_buffer_size)
+        self->buffer_size = self->super.options->max_buffer_size;
+      self->buffer = g_realloc(self->buffer, self->buffer_size);
+      msg_debug("Resizing input buffer",
+                evt_tag_int("new_size", self->buffer_size),
+                NULL);
+    }
+  if (self->buffer_pos + self->frame_len > self->buffer_size)
+    {
+      memmove(self->buffer, &self->buffer[self->buffer_pos], self->buffer_end - self->buffer_pos);
+      self->buffer_end = self->buffer_end - self->buffer_pos;
+      self->buffer_pos = 0;
+    }
+}
+
+static LogProtoStatus
+log_proto_ewmm_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read, LogTransportAuxData *aux, Bookmark *bookmark)
+{
+  LogProtoEWMMServer *self = (LogProtoEWMMServer *) s;
+  LogProtoStatus status;
+  gboolean try_read = TRUE, need_more_data;
+
+  if (G_UNLIKELY(!self->buffer))
+    {
+      self->buffer_size = self->super.options->init_buffer_size;
+      self->buffer = g_malloc(self->buffer_size);
+    }
+
+  for (;;)
+    {
+      switch (self->state)
+        {
+        case LPEWS_HANDSHAKE_READ:
+          status = log_proto_ewmm_server_parse_handshake(self, &need_more_data);
+          if (status != LPS_SUCCESS)
+            return status;
+          if (!need_more_data)
+            {
+              self->state = LPEWS_FRAME_READ;
+              continue;
+            }
+          break;
+        case LPEWS_FRAME_READ:
+          if (self->buffer_end - self->buffer_pos >= LPEWS_FRAME_HEADER_SIZE)
+            {
+              self->frame_len = (self->buffer[self->buffer_pos] << 24) |
+                                (self->buffer[self->buffer_pos + 1] << 16) |
+                                (self->buffer[self->buffer_pos + 2] << 8) |
+                                self->buffer[self->buffer_pos + 3];
+              if (self->frame_len > self->super.options->max_msg_size)
+                {
+                  msg_error("Incoming ewmm frame larger than log_msg_size()",
+                            evt_tag_int("log_msg_size", self->super.options->max_msg_size),
+                            evt_tag_int("frame_length", self->frame_len),
+                            NULL);
+                  return LPS_ERROR;
+                }
+              self->buffer_pos += LPEWS_FRAME_HEADER_SIZE;
+              self->state = LPEWS_MESSAGE_READ;
+              log_proto_ewmm_server_ensure_frame_space(self);
+              continue;
+            }
+          break;
+        case LPEWS_MESSAGE_READ:
+          if (self->buffer_end - self->buffer_pos >= self->frame_len)
+            {
+              *msg = &self->buffer[self->buffer_pos];
+              *msg_len = self->frame_len;
+              self->buffer_pos += self->frame_len;
+              self->state = LPEWS_FRAME_READ;
+              return LPS_SUCCESS;
+            }
+          break;
+        default:
+          g_assert_not_reached();
+        }
+
+      /* whatever state we are in, it ran out of buffered data */
+      if (!try_read)
+        break;
+      status = log_proto_ewmm_server_fetch_data(self, may_read);
+      if (status != LPS_SUCCESS)
+        return status;
+      try_read = FALSE;
+    }
+  return LPS_SUCCESS;
+}
+
+static void
+log_proto_ewmm_server_free(LogProtoServer *s)
+{
+  LogProtoEWMMServer *self = (LogProtoEWMMServer *) s;
+
+  g_free(self->buffer);
+  log_proto_server_free_method(s);
+}
+
+LogProtoServer *
+log_proto_ewmm_server_new(LogTransport *transport, const LogProtoServerOptions *options)
+{
+  LogProtoEWMMServer *self = g_new0(LogProtoEWMMServer, 1);
+
+  log_proto_server_init(&self->super, transport, options);
+  self->super.prepare = log_proto_ewmm_server_prepare;
+  self->super.fetch = log_proto_ewmm_server_fetch;
+  self->super.free_fn = log_proto_ewmm_server_free;
+  self->state = LPEWS_HANDSHAKE_READ;
+  return &self->super;
+}
+
+/*
+ * The format(ewmm) side of the relay: the frames extracted above are the
+ * log_msg_write() representation, deserializing recreates the complete
+ * parsed message -- name-value pairs, tags, timestamps, priority --
+ * without touching a single byte of message text.
+ */
+static void
+log_proto_ewmm_format_parse(const MsgFormatOptions *parse_options, const guchar *data, gsize length, LogMessage *msg)
+{
+  SerializeArchive *sa;
+
+  sa = serialize_buffer_archive_new((gchar *) data, length);
+  sa->silent = TRUE;
+  if (!log_msg_read(msg, sa))
+    msg_format_inject_parse_error(msg, data, length);
+  serialize_archive_free(sa);
+}
+
+static MsgFormatHandler log_proto_ewmm_format_handler =
+{
+  .parse = log_proto_ewmm_format_parse,
+};
+
+gpointer
+log_proto_ewmm_format_construct(Plugin *self, GlobalConfig *cfg, gint plugin_type, const gchar *plugin_name)
+{
+  return &log_proto_ewmm_format_handler;
+}
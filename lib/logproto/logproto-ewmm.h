@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef LOGPROTO_EWMM_H_INCLUDED
+#define LOGPROTO_EWMM_H_INCLUDED
+
+/*
+ * Wire format shared by the ewmm client and server protos.
+ *
+ * The connection starts with a handshake frame sent by the client:
+ *
+ *   magic "EWMM" | version (uint8) | number of builtin values (varint) |
+ *   builtin value names (cstrings, in handle order, starting at handle 1)
+ *
+ * The serialized NVTable payload (see logmsg-serialize.c) block copies
+ * the static entry array, whose layout is determined by the builtin
+ * value set compiled into the sender.  The name list lets the receiver
+ * verify that each static handle refers to the same value on both ends
+ * before accepting block copied frames; dynamic handles are carried by
+ * name inside the payload and are remapped per message by
+ * log_msg_read().
+ *
+ * After the handshake, each message is a frame:
+ *
+ *   payload length (uint32, big endian) | log_msg_write() payload
+ */
+
+#define LOG_PROTO_EWMM_MAGIC "EWMM"
+#define LOG_PROTO_EWMM_MAGIC_LEN 4
+#define LOG_PROTO_EWMM_VERSION 1
+
+#endif
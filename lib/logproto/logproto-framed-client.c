@@ -25,9 +25,15 @@
 #include "logproto-text-client.h"
 #include "messages.h"
 
+#include <string.h>
+
 #define LPFCS_FRAME_SEND    0
 #define LPFCS_MESSAGE_SEND  1
 
+/* longest frame header is "9999999 ", shorter ones are written
+ * right-justified into the space the writer reserved */
+#define LPFC_FRAME_HEADER_RESERVE 8
+
 typedef struct _LogProtoFramedClient
 {
   LogProtoTextClient super;
@@ -76,6 +82,41 @@ log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboo
   return rc;
 }
 
+/*
+ * The writer reserved LPFC_FRAME_HEADER_RESERVE bytes at the front of
+ * each formatted message (see post_header_reserve); the frame header is
+ * written right-justified into that space here, making header and
+ * payload a single contiguous record, and the whole batch is handed to
+ * the inherited gather write.  This replaces the per-message
+ * frame-header/payload write pairs of the post() state machine.
+ */
+static LogProtoStatus
+log_proto_framed_client_post_batch(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed)
+{
+  gint i;
+
+  for (i = 0; i < num_entries; i++)
+    {
+      LogProtoClientBatchEntry *entry = &entries[i];
+      gchar hdr[LPFC_FRAME_HEADER_RESERVE + 1];
+      gsize payload_len = entry->msg_len - LPFC_FRAME_HEADER_RESERVE;
+      gint hdr_len;
+
+      if (payload_len > 9999999)
+        {
+          msg_warning("Error, message length too large for framed protocol, truncated",
+                      evt_tag_int("length", payload_len),
+                      NULL);
+          payload_len = 9999999;
+        }
+      hdr_len = g_snprintf(hdr, sizeof(hdr), "%" G_GSIZE_FORMAT " ", payload_len);
+      memcpy(entry->msg + LPFC_FRAME_HEADER_RESERVE - hdr_len, hdr, hdr_len);
+      entry->msg += LPFC_FRAME_HEADER_RESERVE - hdr_len;
+      entry->msg_len = hdr_len + payload_len;
+    }
+  return log_proto_text_client_post_batch(s, entries, num_entries, num_consumed);
+}
+
 LogProtoClient *
 log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -83,6 +124,20 @@ log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions
 
   log_proto_text_client_init(&self->super, transport, options);
   self->super.super.post = log_proto_framed_client_post;
+  if (transport->writev)
+    {
+      /* frame headers are fixed up in place into the space the writer
+       * reserves in front of each message, the batch goes out as one
+       * gather write */
+      self->super.super.post_batch = log_proto_framed_client_post_batch;
+      self->super.super.post_header_reserve = LPFC_FRAME_HEADER_RESERVE;
+    }
+  else
+    {
+      /* each message needs its frame header, fall back to per-message posts
+       * instead of the inherited gather write */
+      self->super.super.post_batch = NULL;
+    }
   self->super.state = LPFCS_FRAME_SEND;
   return &self->super.super;
 }
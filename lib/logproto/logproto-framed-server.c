@@ -153,6 +153,41 @@ log_proto_framed_server_extract_frame_length(LogProtoFramedServer *self, gboolea
   return TRUE;
 }
 
+/* make sure the upcoming frame_len bytes can fit the buffer at
+ * buffer_pos: grow the buffer up to max_buffer_size if that avoids
+ * shifting, and move the pending data to the beginning otherwise.
+ * Invalidates pointers into the buffer. */
+static void
+log_proto_framed_server_ensure_frame_space(LogProtoFramedServer *self)
+{
+  if (self->buffer_size < self->super.options->max_buffer_size &&
+      self->frame_len > self->buffer_size - self->buffer_pos)
+    {
+      /* a larger buffer would have prevented moving of data, grow
+       * the buffer up to max_buffer_size */
+
+      self->buffer_size = 16 * (self->frame_len + LPFS_FRAME_BUFFER);
+
+      if (self->buffer_size > self->super.options->max_buffer_size)
+        self->buffer_size = self->super.options->max_buffer_size;
+      self->buffer = g_realloc(self->buffer, self->buffer_size);
+      msg_debug("Resizing input buffer",
+                evt_tag_int("new_size", self->buffer_size),
+                NULL);
+    }
+  if (self->buffer_pos + self->frame_len > self->buffer_size)
+    {
+      /* message would be too large to fit into the buffer at
+       * buffer_pos, we need to move data to the beginning of
+       * the buffer to make space, and once we are at it, move
+       * to the beginning to make space for the maximum number
+       * of messages before the next shift */
+      memmove(self->buffer, &self->buffer[self->buffer_pos], self->buffer_end - self->buffer_pos);
+      self->buffer_end = self->buffer_end - self->buffer_pos;
+      self->buffer_pos = 0;
+    }
+}
+
 static LogProtoStatus
 log_proto_framed_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read, LogTransportAuxData *aux, Bookmark *bookmark)
 {
@@ -198,32 +233,7 @@ log_proto_framed_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_
                         NULL);
               return LPS_ERROR;
             }
-          if (self->buffer_size < self->super.options->max_buffer_size &&
-              self->frame_len > self->buffer_size - self->buffer_pos)
-            {
-              /* a larger buffer would have prevented moving of data, grow
-               * the buffer up to max_buffer_size */
-
-              self->buffer_size = 16 * (self->frame_len + LPFS_FRAME_BUFFER);
-
-              if (self->buffer_size > self->super.options->max_buffer_size)
-                self->buffer_size = self->super.options->max_buffer_size;
-              self->buffer = g_realloc(self->buffer, self->buffer_size);
-              msg_debug("Resizing input buffer",
-                        evt_tag_int("new_size", self->buffer_size),
-                        NULL);
-            }
-          if (self->buffer_pos + self->frame_len > self->buffer_size)
-            {
-              /* message would be too large to fit into the buffer at
-               * buffer_pos, we need to move data to the beginning of
-               * the buffer to make space, and once we are at it, move
-               * to the beginning to make space for the maximum number
-               * of messages before the next shift */
-              memmove(self->buffer, &self->buffer[self->buffer_pos], self->buffer_end - self->buffer_pos);
-              self->buffer_end = self->buffer_end - self->buffer_pos;
-              self->buffer_pos = 0;
-            }
+          log_proto_framed_server_ensure_frame_space(self);
           goto read_message;
         }
       break;
@@ -262,6 +272,93 @@ log_proto_framed_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_
   return LPS_SUCCESS;
 }
 
+/* Slice every complete frame out of the buffered data in one go.  The
+ * per-message fetch() above runs the whole state machine, with its
+ * conditional buffer shifting, once per message; here a single transport
+ * read refills the buffer and the loop below only walks frame headers,
+ * so back-to-back frames are emitted without any intermediate copying.
+ * The buffer is only shifted or grown when no slices from this call are
+ * outstanding, as both would invalidate the already emitted pointers;
+ * when a frame cannot fit the remaining space mid-batch, the collected
+ * entries are returned and the shift happens at the start of the next
+ * call. */
+static LogProtoStatus
+log_proto_framed_server_fetch_batch(LogProtoServer *s, LogProtoServerBatchEntry *entries, gint max_entries, gint *num_entries, gboolean *may_read)
+{
+  LogProtoFramedServer *self = (LogProtoFramedServer *) s;
+  LogProtoStatus status;
+  gboolean try_read = TRUE, need_more_data;
+
+  if (G_UNLIKELY(!self->buffer))
+    {
+      self->buffer_size = self->super.options->init_buffer_size;
+      self->buffer = g_malloc(self->buffer_size);
+    }
+
+  while (*num_entries < max_entries)
+    {
+      if (self->state == LPFSS_FRAME_READ)
+        {
+          guint32 header_start = self->buffer_pos;
+
+          if (!log_proto_framed_server_extract_frame_length(self, &need_more_data))
+            {
+              /* invalid frame header: deliver what we have, the error is
+               * reported on the next fetch through the pending status */
+              self->super.status = LPS_ERROR;
+              return *num_entries > 0 ? LPS_SUCCESS : LPS_ERROR;
+            }
+          if (need_more_data)
+            goto need_data;
+          if (self->frame_len > self->super.options->max_msg_size)
+            {
+              msg_error("Incoming frame larger than log_msg_size()",
+                        evt_tag_int("log_msg_size", self->super.options->max_msg_size),
+                        evt_tag_int("frame_length", self->frame_len),
+                        NULL);
+              self->super.status = LPS_ERROR;
+              return *num_entries > 0 ? LPS_SUCCESS : LPS_ERROR;
+            }
+          self->state = LPFSS_MESSAGE_READ;
+          if (self->buffer_pos + self->frame_len > self->buffer_size)
+            {
+              if (*num_entries > 0)
+                {
+                  /* shifting would invalidate the slices already emitted,
+                   * re-parse this header on the next call instead */
+                  self->buffer_pos = header_start;
+                  self->state = LPFSS_FRAME_READ;
+                  break;
+                }
+              log_proto_framed_server_ensure_frame_space(self);
+            }
+        }
+
+      if (self->buffer_end - self->buffer_pos < self->frame_len)
+        goto need_data;
+
+      entries[*num_entries].msg = &self->buffer[self->buffer_pos];
+      entries[*num_entries].msg_len = self->frame_len;
+      (*num_entries)++;
+      self->buffer_pos += self->frame_len;
+      self->state = LPFSS_FRAME_READ;
+      self->half_message_in_buffer = FALSE;
+      continue;
+
+    need_data:
+      /* reading may shift the buffer when it is completely full, so it
+       * only happens while no slices are outstanding; with a partial
+       * frame at the end of a batch the next poll wakeup reads on */
+      if (*num_entries > 0 || !try_read)
+        break;
+      status = log_proto_framed_server_fetch_data(self, may_read);
+      if (status != LPS_SUCCESS)
+        return status;
+      try_read = FALSE;
+    }
+  return LPS_SUCCESS;
+}
+
 static void
 log_proto_framed_server_free(LogProtoServer *s)
 {
@@ -279,6 +376,7 @@ log_proto_framed_server_new(LogTransport *transport, const LogProtoServerOptions
   log_proto_server_init(&self->super, transport, options);
   self->super.prepare = log_proto_framed_server_prepare;
   self->super.fetch = log_proto_framed_server_fetch;
+  self->super.fetch_batch = log_proto_framed_server_fetch_batch;
   self->super.free_fn = log_proto_framed_server_free;
   self->half_message_in_buffer = FALSE;
   return &self->super;
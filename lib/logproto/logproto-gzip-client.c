@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logproto-gzip-client.h"
+#include "messages.h"
+
+#include <zlib.h>
+#include <errno.h>
+#include <string.h>
+
+/*
+ * This proto compresses the message stream with a single long-running
+ * gzip deflate stream, so the dictionary carries over between messages
+ * and repetitive syslog traffic compresses well.  Compressed output is
+ * accumulated in a buffer and written out when it grows large enough or
+ * when the writer flushes.
+ *
+ * Flush alignment: every flush ends with a Z_SYNC_FLUSH, which emits all
+ * deflate state up to a byte boundary, so the peer can fully decode
+ * everything written out so far.  Messages are only acked once the sync
+ * flushed bytes covering them hit the transport; until then a disconnect
+ * rewinds and resends them, keeping the usual at-least-once semantics of
+ * the ack machinery.
+ */
+
+/* compressed bytes buffered before we force a sync flush + write even
+ * without the writer flushing */
+#define LOG_PROTO_GZIP_BUFFER_THRESHOLD 32768
+
+typedef struct _LogProtoGzipClient
+{
+  LogProtoClient super;
+  z_stream compress;
+  gboolean compress_initialized;
+  /* compressed bytes not yet handed to the transport */
+  GString *buffer;
+  gsize buffer_pos;
+  /* messages compressed since the last completed sync flush */
+  gint pending_acks;
+  /* no message bytes entered the deflate stream since the last sync flush */
+  gboolean synced;
+} LogProtoGzipClient;
+
+static gboolean
+log_proto_gzip_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
+{
+  LogProtoGzipClient *self = (LogProtoGzipClient *) s;
+
+  *fd = self->super.transport->fd;
+  *cond = self->super.transport->cond;
+
+  /* if there's no pending I/O in the transport layer, then we want to do a write */
+  if (*cond == 0)
+    *cond = G_IO_OUT;
+  return self->buffer->len > self->buffer_pos;
+}
+
+static LogProtoStatus
+log_proto_gzip_client_write_buffer(LogProtoGzipClient *self)
+{
+  gint rc;
+
+  while (self->buffer->len > self->buffer_pos)
+    {
+      rc = log_transport_write(self->super.transport,
+                               self->buffer->str + self->buffer_pos,
+                               self->buffer->len - self->buffer_pos);
+      if (rc < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            {
+              msg_error("I/O error occurred while writing",
+                        evt_tag_int("fd", self->super.transport->fd),
+                        evt_tag_errno(EVT_TAG_OSERROR, errno),
+                        NULL);
+              return LPS_ERROR;
+            }
+          return LPS_SUCCESS;
+        }
+      self->buffer_pos += rc;
+    }
+
+  g_string_truncate(self->buffer, 0);
+  self->buffer_pos = 0;
+
+  /* everything up to the last sync flush is decodable by the peer, the
+   * messages it covers are now safe to ack */
+  if (self->synced && self->pending_acks)
+    {
+      log_proto_client_msg_ack(&self->super, self->pending_acks);
+      self->pending_acks = 0;
+    }
+  return LPS_SUCCESS;
+}
+
+static LogProtoStatus
+log_proto_gzip_client_deflate(LogProtoGzipClient *self, guchar *msg, gsize msg_len, gint flush_mode)
+{
+  guchar out[4096];
+  gint rc;
+
+  self->compress.next_in = msg;
+  self->compress.avail_in = msg_len;
+  do
+    {
+      self->compress.next_out = out;
+      self->compress.avail_out = sizeof(out);
+      rc = deflate(&self->compress, flush_mode);
+      if (rc == Z_STREAM_ERROR)
+        {
+          msg_error("Internal error compressing the message stream",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_str("error", self->compress.msg ? : "unknown"),
+                    NULL);
+          return LPS_ERROR;
+        }
+      g_string_append_len(self->buffer, (gchar *) out, sizeof(out) - self->compress.avail_out);
+    }
+  while (self->compress.avail_out == 0 || self->compress.avail_in > 0);
+  return LPS_SUCCESS;
+}
+
+static LogProtoStatus
+log_proto_gzip_client_sync_and_write(LogProtoGzipClient *self)
+{
+  if (!self->synced)
+    {
+      if (log_proto_gzip_client_deflate(self, NULL, 0, Z_SYNC_FLUSH) != LPS_SUCCESS)
+        return LPS_ERROR;
+      self->synced = TRUE;
+    }
+  return log_proto_gzip_client_write_buffer(self);
+}
+
+static LogProtoStatus
+log_proto_gzip_client_flush(LogProtoClient *s)
+{
+  LogProtoGzipClient *self = (LogProtoGzipClient *) s;
+
+  return log_proto_gzip_client_sync_and_write(self);
+}
+
+static LogProtoStatus
+log_proto_gzip_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoGzipClient *self = (LogProtoGzipClient *) s;
+  LogProtoStatus status;
+
+  status = log_proto_gzip_client_deflate(self, msg, msg_len, Z_NO_FLUSH);
+  if (status != LPS_SUCCESS)
+    return status;
+
+  *consumed = TRUE;
+  g_free(msg);
+  self->pending_acks++;
+  self->synced = FALSE;
+
+  if (self->buffer->len - self->buffer_pos > LOG_PROTO_GZIP_BUFFER_THRESHOLD)
+    return log_proto_gzip_client_sync_and_write(self);
+  return LPS_SUCCESS;
+}
+
+static void
+log_proto_gzip_client_free(LogProtoClient *s)
+{
+  LogProtoGzipClient *self = (LogProtoGzipClient *) s;
+
+  if (self->compress_initialized)
+    deflateEnd(&self->compress);
+  g_string_free(self->buffer, TRUE);
+  log_proto_client_free_method(s);
+}
+
+LogProtoClient *
+log_proto_gzip_client_new(LogTransport *transport, const LogProtoClientOptions *options)
+{
+  LogProtoGzipClient *self = g_new0(LogProtoGzipClient, 1);
+
+  log_proto_client_init(&self->super, transport, options);
+  self->super.prepare = log_proto_gzip_client_prepare;
+  self->super.post = log_proto_gzip_client_post;
+  self->super.flush = log_proto_gzip_client_flush;
+  self->super.free_fn = log_proto_gzip_client_free;
+
+  self->buffer = g_string_sized_new(LOG_PROTO_GZIP_BUFFER_THRESHOLD);
+  self->synced = TRUE;
+
+  /* windowBits + 16 selects the gzip framing */
+  if (deflateInit2(&self->compress, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      msg_error("Error initializing the gzip compressor",
+                evt_tag_int("fd", transport->fd),
+                NULL);
+      self->super.status = LPS_ERROR;
+    }
+  else
+    self->compress_initialized = TRUE;
+
+  return &self->super;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logproto-gzip-server.h"
+#include "logproto-text-server.h"
+#include "messages.h"
+
+#include <zlib.h>
+#include <errno.h>
+
+/*
+ * The counterpart of the gzip client proto: a newline delimited message
+ * stream arriving as a single long-running gzip stream.  The compressed
+ * bytes are read from the transport into a private buffer and inflated
+ * into the buffer of LogProtoBufferedServer through the read_data hook,
+ * everything above that (EOL splitting, encoding, positions) works as
+ * with the plain text proto.  The sender sync flushes on every writer
+ * flush, so all data it considers sent is decodable on our side.
+ */
+
+#define LOG_PROTO_GZIP_SERVER_RAW_BUFFER_SIZE 16384
+
+typedef struct _LogProtoGzipServer
+{
+  LogProtoTextServer super;
+  z_stream decompress;
+  gboolean decompress_initialized;
+  gboolean stream_ended;
+  /* compressed bytes read from the transport, next_in/avail_in of the
+   * inflate stream point into this buffer between read_data calls */
+  guchar raw_buffer[LOG_PROTO_GZIP_SERVER_RAW_BUFFER_SIZE];
+} LogProtoGzipServer;
+
+static gint
+log_proto_gzip_server_read_data(LogProtoBufferedServer *s, guchar *buf, gsize len, LogTransportAuxData *aux)
+{
+  LogProtoGzipServer *self = (LogProtoGzipServer *) s;
+  gint rc;
+
+  if (self->stream_ended)
+    return 0;
+
+  self->decompress.next_out = buf;
+  self->decompress.avail_out = len;
+  while (self->decompress.avail_out > 0)
+    {
+      if (self->decompress.avail_in == 0)
+        {
+          rc = log_transport_read(self->super.super.super.transport,
+                                  self->raw_buffer, sizeof(self->raw_buffer), aux);
+          if (rc < 0)
+            {
+              if (len == self->decompress.avail_out)
+                return rc;
+              /* errno is EAGAIN or a real error, but we already have
+               * decompressed data to deliver; the error is reported by
+               * the next call when the output is drained */
+              break;
+            }
+          if (rc == 0)
+            {
+              self->stream_ended = TRUE;
+              break;
+            }
+          self->decompress.next_in = self->raw_buffer;
+          self->decompress.avail_in = rc;
+        }
+
+      rc = inflate(&self->decompress, Z_NO_FLUSH);
+      if (rc == Z_STREAM_END)
+        {
+          self->stream_ended = TRUE;
+          break;
+        }
+      if (rc != Z_OK && rc != Z_BUF_ERROR)
+        {
+          msg_error("Error decompressing the message stream",
+                    evt_tag_int("fd", self->super.super.super.transport->fd),
+                    evt_tag_str("error", self->decompress.msg ? : "unknown"),
+                    NULL);
+          errno = EINVAL;
+          return -1;
+        }
+    }
+  return len - self->decompress.avail_out;
+}
+
+static void
+log_proto_gzip_server_free(LogProtoServer *s)
+{
+  LogProtoGzipServer *self = (LogProtoGzipServer *) s;
+
+  if (self->decompress_initialized)
+    inflateEnd(&self->decompress);
+  /* NOTE: mirrors log_proto_text_server_free(), which is private to the
+   * text server */
+  g_free(self->super.reverse_buffer);
+  log_proto_buffered_server_free_method(s);
+}
+
+LogProtoServer *
+log_proto_gzip_server_new(LogTransport *transport, const LogProtoServerOptions *options)
+{
+  LogProtoGzipServer *self = g_new0(LogProtoGzipServer, 1);
+
+  log_proto_text_server_init(&self->super, transport, options);
+  self->super.super.read_data = log_proto_gzip_server_read_data;
+  self->super.super.super.free_fn = log_proto_gzip_server_free;
+  /* decompressed positions cannot be mapped back to raw stream offsets */
+  self->super.super.pos_tracking = FALSE;
+
+  /* windowBits + 32 accepts both the gzip and the zlib framing */
+  if (inflateInit2(&self->decompress, MAX_WBITS + 32) != Z_OK)
+    {
+      msg_error("Error initializing the gzip decompressor",
+                evt_tag_int("fd", transport->fd),
+                NULL);
+      self->super.super.io_status = G_IO_STATUS_ERROR;
+    }
+  else
+    self->decompress_initialized = TRUE;
+
+  return &self->super.super.super;
+}
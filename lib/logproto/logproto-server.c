@@ -37,11 +37,9 @@
  * the input data and returns a pointer to the first occurence of NL or NUL.
  *
  * It uses an algorithm similar to what there's in libc memchr/strchr.
- *
- * NOTE: find_eom is not static as it is used by a unit test program.
  **/
-const guchar *
-find_eom(const guchar *s, gsize n)
+static const guchar *
+find_eom_scalar(const guchar *s, gsize n)
 {
   const guchar *char_ptr;
   const gulong *longword_ptr;
@@ -100,6 +98,121 @@ find_eom(const guchar *s, gsize n)
   return NULL;
 }
 
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+
+#define FIND_EOM_SIMD 1
+
+#include <immintrin.h>
+
+/* SSE2 is part of the x86_64 baseline, no target attribute needed */
+static const guchar *
+find_eom_sse2(const guchar *s, gsize n)
+{
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  while (n >= 16)
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) s);
+      guint mask;
+
+      mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, nl),
+                                            _mm_cmpeq_epi8(chunk, nul)));
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 16;
+      n -= 16;
+    }
+  return find_eom_scalar(s, n);
+}
+
+__attribute__((target("avx2")))
+static const guchar *
+find_eom_avx2(const guchar *s, gsize n)
+{
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i nul = _mm256_setzero_si256();
+
+  while (n >= 32)
+    {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *) s);
+      guint mask;
+
+      mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, nl),
+                                                  _mm256_cmpeq_epi8(chunk, nul)));
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 32;
+      n -= 32;
+    }
+  return find_eom_sse2(s, n);
+}
+
+#endif
+
+typedef const guchar *(*FindEOMFunc)(const guchar *s, gsize n);
+
+static FindEOMFunc
+find_eom_resolve(void)
+{
+#ifdef FIND_EOM_SIMD
+  if (__builtin_cpu_supports("avx2"))
+    return find_eom_avx2;
+  return find_eom_sse2;
+#else
+  return find_eom_scalar;
+#endif
+}
+
+/**
+ * Vectorized wrapper around the end-of-message scan: dispatches to an
+ * AVX2 or SSE2 implementation based on runtime CPU detection on x86_64,
+ * and to the memchr-style scalar loop elsewhere.  The racy lazy
+ * initialization is safe as find_eom_resolve() is idempotent and pointer
+ * stores are atomic.
+ *
+ * NOTE: find_eom is not static as it is used by a unit test program.
+ **/
+const guchar *
+find_eom(const guchar *s, gsize n)
+{
+  static FindEOMFunc find_eom_impl;
+
+  if (G_UNLIKELY(!find_eom_impl))
+    find_eom_impl = find_eom_resolve();
+  return find_eom_impl(s, n);
+}
+
+/**
+ * Generic batched fetch: extract up to @max_entries messages by looping
+ * fetch() over the data that is already buffered (plus at most as many
+ * reads as *may_read permits), so callers can amortize their
+ * per-message bookkeeping over a whole buffer fill.
+ *
+ * If an error or EOF hits after some messages were already extracted,
+ * LPS_SUCCESS is returned with those messages; the error condition is
+ * persistent in s->status and resurfaces on the next call.
+ **/
+LogProtoStatus
+log_proto_server_fetch_batch_method(LogProtoServer *s, LogProtoServerBatchEntry *entries, gint max_entries, gint *num_entries, gboolean *may_read)
+{
+  while (*num_entries < max_entries)
+    {
+      LogProtoServerBatchEntry *entry = &entries[*num_entries];
+      LogProtoStatus status;
+
+      entry->msg = NULL;
+      entry->msg_len = 0;
+      status = s->fetch(s, &entry->msg, &entry->msg_len, may_read, &entry->aux, NULL);
+      if (status != LPS_SUCCESS)
+        return *num_entries > 0 ? LPS_SUCCESS : status;
+      if (!entry->msg)
+        break;
+      (*num_entries)++;
+    }
+  return LPS_SUCCESS;
+}
+
 gboolean
 log_proto_server_validate_options_method(LogProtoServer *s)
 {
@@ -152,6 +265,7 @@ log_proto_server_options_defaults(LogProtoServerOptions *options)
   options->max_msg_size = -1;
   options->init_buffer_size = -1;
   options->max_buffer_size = -1;
+  options->pos_sync_freq = -1;
 }
 
 void
@@ -176,6 +290,8 @@ log_proto_server_options_init(LogProtoServerOptions *options, GlobalConfig *cfg)
     }
   if (options->init_buffer_size == -1)
     options->init_buffer_size = MIN(options->max_msg_size, options->max_buffer_size);
+  if (options->pos_sync_freq == -1)
+    options->pos_sync_freq = 1;
   options->initialized = TRUE;
 }
 
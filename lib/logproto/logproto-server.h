@@ -33,7 +33,16 @@
 typedef struct _LogProtoServer LogProtoServer;
 typedef struct _LogProtoServerOptions LogProtoServerOptions;
 
-#define LOG_PROTO_SERVER_OPTIONS_SIZE 32
+/* a single message slice extracted by a batched fetch, pointing into the
+ * protocol's buffer, valid until the next fetch call */
+typedef struct _LogProtoServerBatchEntry
+{
+  const guchar *msg;
+  gsize msg_len;
+  LogTransportAuxData aux;
+} LogProtoServerBatchEntry;
+
+#define LOG_PROTO_SERVER_OPTIONS_SIZE 48
 
 struct _LogProtoServerOptions
 {
@@ -44,6 +53,13 @@ struct _LogProtoServerOptions
   gint max_msg_size;
   gint max_buffer_size;
   gint init_buffer_size;
+  /* how often confirmed file positions are written back to the persist
+   * file, in seconds; 0 writes on every confirmation */
+  gint pos_sync_freq;
+  /* maximum number of seconds a partially accumulated multi-line record
+   * may sit in the buffer before it is flushed as-is; 0 waits for the
+   * record to be completed by further input (or EOF) */
+  gint multi_line_timeout;
 };
 
 typedef union LogProtoServerOptionsStorage
@@ -69,6 +85,14 @@ struct _LogProtoServer
   gboolean (*is_preemptable)(LogProtoServer *s);
   gboolean (*restart_with_state)(LogProtoServer *s, PersistState *state, const gchar *persist_name);
   LogProtoStatus (*fetch)(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read, LogTransportAuxData *aux, Bookmark *bookmark);
+  /* extract multiple messages in one go; optional, the generic method
+   * loops fetch() over the already buffered data.  Bookmarks are not
+   * supported, callers needing position tracking must use fetch() */
+  LogProtoStatus (*fetch_batch)(LogProtoServer *s, LogProtoServerBatchEntry *entries, gint max_entries, gint *num_entries, gboolean *may_read);
+  /* number of milliseconds after which buffered, partially accumulated
+   * data should be flushed by calling fetch() again; optional, -1 means
+   * no timed flush is pending */
+  gint (*get_pending_flush_timeout)(LogProtoServer *s);
   gboolean (*validate_options)(LogProtoServer *s);
   void (*free_fn)(LogProtoServer *s);
 };
@@ -115,6 +139,27 @@ log_proto_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gb
   return s->status;
 }
 
+LogProtoStatus log_proto_server_fetch_batch_method(LogProtoServer *s, LogProtoServerBatchEntry *entries, gint max_entries, gint *num_entries, gboolean *may_read);
+
+static inline LogProtoStatus
+log_proto_server_fetch_batch(LogProtoServer *s, LogProtoServerBatchEntry *entries, gint max_entries, gint *num_entries, gboolean *may_read)
+{
+  *num_entries = 0;
+  if (s->status != LPS_SUCCESS)
+    return s->status;
+  if (s->fetch_batch)
+    return s->fetch_batch(s, entries, max_entries, num_entries, may_read);
+  return log_proto_server_fetch_batch_method(s, entries, max_entries, num_entries, may_read);
+}
+
+static inline gint
+log_proto_server_get_pending_flush_timeout(LogProtoServer *s)
+{
+  if (s->get_pending_flush_timeout)
+    return s->get_pending_flush_timeout(s);
+  return -1;
+}
+
 static inline gint
 log_proto_server_get_fd(LogProtoServer *s)
 {
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2016 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "logproto-string-multiline-server.h"
+#include "messages.h"
+
+#include <string.h>
+
+struct _MultiLineLiteral
+{
+  guchar *text;
+  gsize len;
+  /* Boyer-Moore-Horspool shift table, indexed by the byte under the
+   * last position of the search window */
+  gsize shift[256];
+};
+
+MultiLineLiteral *
+multi_line_literal_new(const gchar *text)
+{
+  MultiLineLiteral *self = g_new0(MultiLineLiteral, 1);
+  gint i;
+
+  self->text = (guchar *) g_strdup(text);
+  self->len = strlen(text);
+
+  for (i = 0; i < 256; i++)
+    self->shift[i] = self->len;
+  for (i = 0; i < (gint) self->len - 1; i++)
+    self->shift[self->text[i]] = self->len - 1 - i;
+  return self;
+}
+
+void
+multi_line_literal_free(MultiLineLiteral *self)
+{
+  if (self)
+    {
+      g_free(self->text);
+      g_free(self);
+    }
+}
+
+/* Boyer-Moore-Horspool search for the literal, returns the offset of
+ * the first match or -1 */
+static gint
+multi_line_literal_find(MultiLineLiteral *self, const guchar *str, gsize len)
+{
+  gsize pos = 0;
+
+  if (!self || self->len == 0 || len < self->len)
+    return -1;
+
+  while (pos + self->len <= len)
+    {
+      if (str[pos + self->len - 1] == self->text[self->len - 1] &&
+          memcmp(&str[pos], self->text, self->len - 1) == 0)
+        return pos;
+      pos += self->shift[str[pos + self->len - 1]];
+    }
+  return -1;
+}
+
+/* the prefix is anchored to the beginning of the line, a plain
+ * comparison is all that is needed */
+static gboolean
+multi_line_literal_prefix_matches(MultiLineLiteral *self, const guchar *str, gsize len)
+{
+  if (!self || self->len == 0 || len < self->len)
+    return FALSE;
+  return memcmp(str, self->text, self->len) == 0;
+}
+
+struct _LogProtoSTRMultiLineServer
+{
+  LogProtoTextServer super;
+  /* these are borrowed */
+  MultiLineLiteral *prefix;
+  MultiLineLiteral *garbage;
+};
+
+static gint
+_accumulate_initial_line(LogProtoSTRMultiLineServer *self,
+                         const guchar *line,
+                         gsize line_len,
+                         gssize consumed_len)
+{
+  gint offset_of_garbage = multi_line_literal_find(self->garbage, line, line_len);
+
+  if (offset_of_garbage >= 0)
+    return LPT_CONSUME_PARTIALLY(line_len - offset_of_garbage) | LPT_EXTRACTED;
+  else
+    return LPT_CONSUME_LINE | LPT_WAITING;
+}
+
+static gint
+_accumulate_continuation_line(LogProtoSTRMultiLineServer *self,
+                              const guchar *line,
+                              gsize line_len,
+                              gssize consumed_len)
+{
+  gint offset_of_garbage = multi_line_literal_find(self->garbage, line, line_len);
+
+  if (offset_of_garbage >= 0)
+    return LPT_CONSUME_PARTIALLY(line_len - offset_of_garbage) | LPT_EXTRACTED;
+  else if (multi_line_literal_prefix_matches(self->prefix, line, line_len))
+    return LPT_REWIND_LINE | LPT_EXTRACTED;
+  else
+    return LPT_CONSUME_LINE | LPT_WAITING;
+}
+
+static gint
+log_proto_string_multiline_accumulate_line(LogProtoTextServer *s,
+                                           const guchar *msg,
+                                           gsize msg_len,
+                                           gssize consumed_len)
+{
+  LogProtoSTRMultiLineServer *self = (LogProtoSTRMultiLineServer *) s;
+  gboolean initial_line;
+
+  /* NOTE: msg/msg_len/consumed_len follow the same conventions as in
+   * LogProtoREMultiLineServer; only the newly appended line (the part
+   * past consumed_len) is ever examined, so each byte of the
+   * accumulated message is looked at exactly once. */
+
+  initial_line = (consumed_len < 0) || (msg_len <= consumed_len + 1);
+  if (initial_line)
+    {
+      return _accumulate_initial_line(self, msg, msg_len, consumed_len);
+    }
+  else
+    {
+      const guchar *start_of_the_current_line = &msg[consumed_len + 1];
+      gint length_of_the_current_line = msg_len - (start_of_the_current_line - msg);
+
+      return _accumulate_continuation_line(self, start_of_the_current_line, length_of_the_current_line, consumed_len);
+    }
+}
+
+void
+log_proto_string_multiline_server_init(LogProtoSTRMultiLineServer *self,
+                                       LogTransport *transport,
+                                       const LogProtoServerOptions *options,
+                                       MultiLineLiteral *prefix,
+                                       MultiLineLiteral *garbage)
+{
+  log_proto_text_server_init(&self->super, transport, options);
+  self->super.accumulate_line = log_proto_string_multiline_accumulate_line;
+  self->prefix = prefix;
+  self->garbage = garbage;
+}
+
+LogProtoServer *
+log_proto_prefix_string_multiline_server_new(LogTransport *transport,
+                                     const LogProtoServerOptions *options,
+                                     MultiLineLiteral *prefix,
+                                     MultiLineLiteral *garbage)
+{
+  LogProtoSTRMultiLineServer *self = g_new0(LogProtoSTRMultiLineServer, 1);
+
+  log_proto_string_multiline_server_init(self, transport, options, prefix, garbage);
+  return &self->super.super.super;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2016 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#ifndef LOGPROTO_STRING_MULTILINE_SERVER_INCLUDED
+#define LOGPROTO_STRING_MULTILINE_SERVER_INCLUDED
+
+#include "logproto-text-server.h"
+
+typedef struct _MultiLineLiteral MultiLineLiteral;
+typedef struct _LogProtoSTRMultiLineServer LogProtoSTRMultiLineServer;
+
+MultiLineLiteral *multi_line_literal_new(const gchar *text);
+void multi_line_literal_free(MultiLineLiteral *self);
+
+/* LogProtoSTRMultiLineServer
+ *
+ * The literal string counterpart of LogProtoREMultiLineServer: a new
+ * record starts at a line beginning with a fixed prefix string (e.g. a
+ * timestamp shape), continuation lines are everything in between.  An
+ * optional garbage literal terminates the record at the position where
+ * it is found.  Matching uses an anchored comparison for the prefix and
+ * a Boyer-Moore-Horspool search for the garbage, each appended line is
+ * examined exactly once, so long stack traces stay linear instead of
+ * paying a regexp execution per line.
+ */
+LogProtoServer *log_proto_prefix_string_multiline_server_new(LogTransport *transport,
+                                                     const LogProtoServerOptions *options,
+                                                     MultiLineLiteral *prefix,
+                                                     MultiLineLiteral *garbage);
+void log_proto_string_multiline_server_init(LogProtoSTRMultiLineServer *self,
+                                            LogTransport *transport,
+                                            const LogProtoServerOptions *options,
+                                            MultiLineLiteral *prefix,
+                                            MultiLineLiteral *garbage);
+
+#endif
@@ -148,6 +148,133 @@ log_proto_text_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
   return log_proto_text_client_submit_write(s, msg, msg_len, (GDestroyNotify) g_free, -1);
 }
 
+/* submit the batch as individual records with a single sendmmsg() style
+ * call; records are atomic, so there is never a partial tail to buffer */
+static LogProtoStatus
+log_proto_text_client_post_batch_records(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  struct iovec iov[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+  gint rc;
+  gint i;
+
+  if (num_entries > LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES)
+    num_entries = LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES;
+  for (i = 0; i < num_entries; i++)
+    {
+      iov[i].iov_base = entries[i].msg;
+      iov[i].iov_len = entries[i].msg_len;
+    }
+
+  rc = log_transport_write_records(self->super.transport, iov, num_entries);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+          return LPS_ERROR;
+        }
+      return LPS_SUCCESS;
+    }
+
+  *num_consumed = rc;
+  if (rc)
+    log_proto_client_msg_ack(&self->super, rc);
+  return LPS_SUCCESS;
+}
+
+/*
+ * log_proto_text_client_post_batch:
+ * @entries: formatted log messages to send, the buffers remain owned by the caller
+ * @num_entries: number of elements in @entries
+ * @num_consumed: the number of entries taken over by this function
+ *
+ * Submit a batch of messages with a single writev() call.  Messages
+ * written out completely are acked right away, a partially written
+ * message has its unsent tail copied to the partial buffer and is acked
+ * once that drains, entries past that point stay with the caller.
+ **/
+LogProtoStatus
+log_proto_text_client_post_batch(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  struct iovec iov[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+  LogProtoStatus status;
+  gssize rc;
+  gint fully_sent = 0;
+  gint i;
+
+  *num_consumed = 0;
+
+  /* try to flush already buffered data, see the note in post() on why we
+   * must not write while a partial buffer is pending */
+  status = log_proto_text_client_flush(s);
+  if (status != LPS_SUCCESS)
+    return status;
+  if (self->partial)
+    return LPS_SUCCESS;
+
+  /* gather writes only make sense when the transport can coalesce the
+   * entries into a stream without merging record boundaries; datagram
+   * transports keep the boundaries instead and batch whole records */
+  if (!self->super.transport->writev)
+    {
+      if (self->super.transport->write_records)
+        return log_proto_text_client_post_batch_records(s, entries, num_entries, num_consumed);
+      return log_proto_client_post_batch_method(s, entries, num_entries, num_consumed);
+    }
+
+  if (num_entries > LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES)
+    num_entries = LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES;
+  for (i = 0; i < num_entries; i++)
+    {
+      iov[i].iov_base = entries[i].msg;
+      iov[i].iov_len = entries[i].msg_len;
+    }
+
+  rc = log_transport_writev(self->super.transport, iov, num_entries);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+          return LPS_ERROR;
+        }
+      return LPS_SUCCESS;
+    }
+
+  while (fully_sent < num_entries && (gsize) rc >= entries[fully_sent].msg_len)
+    {
+      rc -= entries[fully_sent].msg_len;
+      fully_sent++;
+    }
+  *num_consumed = fully_sent;
+
+  if (rc > 0)
+    {
+      /* the next entry went out partially, buffer its unsent tail */
+      LogProtoClientBatchEntry *entry = &entries[fully_sent];
+      gsize remainder = entry->msg_len - rc;
+
+      self->partial = g_memdup(entry->msg + rc, remainder);
+      self->partial_len = remainder;
+      self->partial_pos = 0;
+      self->partial_free = (GDestroyNotify) g_free;
+      self->next_state = -1;
+      (*num_consumed)++;
+    }
+
+  if (fully_sent)
+    log_proto_client_msg_ack(&self->super, fully_sent);
+  return LPS_SUCCESS;
+}
+
 void
 log_proto_text_client_free(LogProtoClient *s)
 {
@@ -165,6 +292,7 @@ log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, co
   self->super.prepare = log_proto_text_client_prepare;
   self->super.flush = log_proto_text_client_flush;
   self->super.post = log_proto_text_client_post;
+  self->super.post_batch = log_proto_text_client_post_batch;
   self->super.free_fn = log_proto_text_client_free;
   self->super.transport = transport;
   self->next_state = -1;
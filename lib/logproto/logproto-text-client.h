@@ -36,6 +36,7 @@ typedef struct _LogProtoTextClient
 } LogProtoTextClient;
 
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_post_batch(LogProtoClient *s, LogProtoClientBatchEntry *entries, gint num_entries, gint *num_consumed);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
 
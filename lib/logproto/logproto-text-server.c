@@ -23,6 +23,7 @@
  */
 #include "logproto-text-server.h"
 #include "messages.h"
+#include "timeutils.h"
 
 #include <string.h>
 
@@ -101,6 +102,33 @@ log_proto_text_server_is_preemptable(LogProtoServer *s)
   return preemptable;
 }
 
+/* update the partially-accumulated-bytes gauge to reflect the current
+ * size of the record being accumulated (0 when none) */
+static void
+log_proto_text_server_set_accumulated_bytes(LogProtoTextServer *self, gsize new_value)
+{
+  stats_counter_add(self->accumulated_bytes_stat, (gint) new_value - (gint) self->accumulated_bytes);
+  self->accumulated_bytes = new_value;
+}
+
+/* returns the number of milliseconds until the partially accumulated
+ * record exceeds its latency budget, -1 if no flush is pending */
+static gint
+log_proto_text_server_get_pending_flush_timeout(LogProtoServer *s)
+{
+  LogProtoTextServer *self = (LogProtoTextServer *) s;
+  gint timeout = self->super.super.options->multi_line_timeout;
+  glong elapsed;
+
+  if (timeout <= 0 || self->consumed_len < 0)
+    return -1;
+
+  elapsed = cached_g_current_time_sec() - self->partial_accumulated_since;
+  if (elapsed >= timeout)
+    return 0;
+  return (timeout - elapsed) * 1000;
+}
+
 static gboolean
 log_proto_text_server_prepare(LogProtoServer *s, GIOCondition *cond)
 {
@@ -113,7 +141,18 @@ log_proto_text_server_prepare(LogProtoServer *s, GIOCondition *cond)
     }
 
   avail = (self->cached_eol_pos != 0);
-  return avail;
+  if (avail)
+    return TRUE;
+
+  if (log_proto_text_server_get_pending_flush_timeout(s) == 0)
+    {
+      /* the partially accumulated record exceeded its latency budget;
+       * route the next fetch back to the buffer so the flush happens
+       * without waiting for new input */
+      self->super.fetch_state = LPBSF_FETCHING_FROM_BUFFER;
+      return TRUE;
+    }
+  return FALSE;
 }
 
 
@@ -275,6 +314,7 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
       else
         g_assert_not_reached();
       self->consumed_len = -1;
+      log_proto_text_server_set_accumulated_bytes(self, 0);
     }
   else if (verdict & LPT_WAITING)
     {
@@ -282,8 +322,11 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
       *msg_len = 0;
       if (verdict & LPT_CONSUME_LINE)
         {
+          if (self->consumed_len < 0)
+            self->partial_accumulated_since = cached_g_current_time_sec();
           self->cached_eol_pos = next_eol_pos;
           self->consumed_len = eol - buffer_start;
+          log_proto_text_server_set_accumulated_bytes(self, self->consumed_len + 1);
         }
       else
         {
@@ -335,9 +378,28 @@ log_proto_text_server_yield_whole_buffer_as_message(LogProtoTextServer *self, Lo
   *msg = buffer_start;
   *msg_len = buffer_bytes;
   self->consumed_len = -1;
+  log_proto_text_server_set_accumulated_bytes(self, 0);
   state->pending_buffer_pos = (*msg) + (*msg_len) - self->super.buffer;
 }
 
+/* emit the partially accumulated multi-line record without its
+ * terminating line, provided multi-line-timeout() is set and the record
+ * sat in the buffer for longer than that.  Bytes following the last
+ * consumed EOL (an incomplete line) stay in the buffer. */
+static gboolean
+log_proto_text_server_flush_partial(LogProtoTextServer *self, LogProtoBufferedServerState *state, const guchar *buffer_start, const guchar **msg, gsize *msg_len)
+{
+  if (log_proto_text_server_get_pending_flush_timeout(&self->super.super) != 0)
+    return FALSE;
+
+  *msg = buffer_start;
+  *msg_len = self->consumed_len;
+  state->pending_buffer_pos = (buffer_start + self->consumed_len + 1) - self->super.buffer;
+  self->consumed_len = -1;
+  log_proto_text_server_set_accumulated_bytes(self, 0);
+  return TRUE;
+}
+
 static inline const guchar *
 log_proto_text_server_locate_next_eol(LogProtoTextServer *self, LogProtoBufferedServerState *state, const guchar *buffer_start, gsize buffer_bytes)
 {
@@ -386,13 +448,19 @@ log_proto_text_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar
     }
   else if (!eol)
     {
+      if (log_proto_text_server_flush_partial(self, state, buffer_start, msg, msg_len))
+        goto success;
       log_proto_text_server_split_buffer(self, state, buffer_start, buffer_bytes);
       goto exit;
     }
   else
     {
       if (!log_proto_text_server_extract(self, state, buffer_start, buffer_bytes, eol, msg, msg_len))
-        goto exit;
+        {
+          if (log_proto_text_server_flush_partial(self, state, buffer_start, msg, msg_len))
+            goto success;
+          goto exit;
+        }
     }
 
  success:
@@ -413,6 +481,12 @@ log_proto_text_server_free(LogProtoServer *s)
     g_iconv_close(self->reverse_convert);
 
   g_free(self->reverse_buffer);
+
+  log_proto_text_server_set_accumulated_bytes(self, 0);
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "multi_line_accumulated_bytes", NULL, SC_TYPE_STORED, &self->accumulated_bytes_stat);
+  stats_unlock();
+
   log_proto_buffered_server_free_method(&self->super.super);
 }
 
@@ -422,6 +496,7 @@ log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, co
   log_proto_buffered_server_init(&self->super, transport, options);
   self->super.super.is_preemptable = log_proto_text_server_is_preemptable;
   self->super.super.prepare = log_proto_text_server_prepare;
+  self->super.super.get_pending_flush_timeout = log_proto_text_server_get_pending_flush_timeout;
   self->super.super.free_fn = log_proto_text_server_free;
   self->super.fetch_from_buffer = log_proto_text_server_fetch_from_buffer;
   self->accumulate_line = log_proto_text_server_accumulate_line_method;
@@ -429,6 +504,10 @@ log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, co
   self->reverse_convert = (GIConv) -1;
   self->consumed_len = -1;
   self->super.pos_tracking = TRUE;
+
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "multi_line_accumulated_bytes", NULL, SC_TYPE_STORED, &self->accumulated_bytes_stat);
+  stats_unlock();
 }
 
 LogProtoServer *
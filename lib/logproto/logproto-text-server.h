@@ -25,6 +25,7 @@
 #define LOGPROTO_TEXT_SERVER_INCLUDED
 
 #include "logproto-buffered-server.h"
+#include "stats/stats-registry.h"
 
 enum
 {
@@ -53,8 +54,21 @@ struct _LogProtoTextServer
   gsize reverse_buffer_len;
   gint convert_scale;
 
+  /* explicit continuation state: consumed_len >= 0 means a partially
+   * accumulated multi-line record starts at the pending buffer position
+   * and extends up to (and including) the EOL at consumed_len; each
+   * arriving line is classified exactly once and only extends this
+   * state.  partial_accumulated_since records when the record was
+   * started, so that multi-line-timeout() can flush it without waiting
+   * for the terminating line. */
   gint32 consumed_len;
   gint32 cached_eol_pos;
+  time_t partial_accumulated_since;
+
+  /* bytes currently sitting in partially accumulated records, mirrored
+   * into a process wide gauge */
+  gsize accumulated_bytes;
+  StatsCounterItem *accumulated_bytes_stat;
 };
 
 /* LogProtoTextServer
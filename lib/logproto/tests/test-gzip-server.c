@@ -0,0 +1,105 @@
+#include "mock-transport.h"
+#include "proto_lib.h"
+#include "msg_parse_lib.h"
+#include "logproto/logproto-gzip-server.h"
+
+#include <zlib.h>
+
+/****************************************************************************************
+ * LogProtoGzipServer
+ ****************************************************************************************/
+
+/* compress @data the way the gzip client proto does: a gzip framed
+ * deflate stream terminated by a sync flush */
+static GString *
+compress_input(const gchar *data, gssize len)
+{
+  z_stream zstrm;
+  guchar out[4096];
+  GString *compressed = g_string_sized_new(256);
+
+  if (len < 0)
+    len = strlen(data);
+
+  memset(&zstrm, 0, sizeof(zstrm));
+  g_assert(deflateInit2(&zstrm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  zstrm.next_in = (guchar *) data;
+  zstrm.avail_in = len;
+  do
+    {
+      zstrm.next_out = out;
+      zstrm.avail_out = sizeof(out);
+      g_assert(deflate(&zstrm, Z_SYNC_FLUSH) != Z_STREAM_ERROR);
+      g_string_append_len(compressed, (gchar *) out, sizeof(out) - zstrm.avail_out);
+    }
+  while (zstrm.avail_out == 0 || zstrm.avail_in > 0);
+  deflateEnd(&zstrm);
+  return compressed;
+}
+
+static void
+test_log_proto_gzip_server_simple_messages(void)
+{
+  LogProtoServer *proto;
+  GString *compressed;
+
+  compressed = compress_input("01234567\nárvíztűrőtükörfúrógép\n", -1);
+
+  proto_server_options.max_msg_size = 32;
+  proto = log_proto_gzip_server_new(
+            log_transport_mock_stream_new(
+              compressed->str, compressed->len,
+              LTM_EOF),
+            get_inited_proto_server_options());
+  assert_proto_server_fetch(proto, "01234567", -1);
+  assert_proto_server_fetch(proto, "árvíztűrőtükörfúrógép", -1);
+  log_proto_server_free(proto);
+  g_string_free(compressed, TRUE);
+}
+
+static void
+test_log_proto_gzip_server_compressed_stream_split_between_reads(void)
+{
+  LogProtoServer *proto;
+  GString *compressed;
+  gsize half;
+
+  compressed = compress_input("first message\nsecond message\n", -1);
+  half = compressed->len / 2;
+
+  proto_server_options.max_msg_size = 32;
+  proto = log_proto_gzip_server_new(
+            log_transport_mock_stream_new(
+              compressed->str, half,
+              compressed->str + half, compressed->len - half,
+              LTM_EOF),
+            get_inited_proto_server_options());
+  assert_proto_server_fetch(proto, "first message", -1);
+  assert_proto_server_fetch(proto, "second message", -1);
+  log_proto_server_free(proto);
+  g_string_free(compressed, TRUE);
+}
+
+static void
+test_log_proto_gzip_server_invalid_input(void)
+{
+  LogProtoServer *proto;
+
+  proto_server_options.max_msg_size = 32;
+  proto = log_proto_gzip_server_new(
+            log_transport_mock_stream_new(
+              "this is not a gzip stream\n", -1,
+              LTM_EOF),
+            get_inited_proto_server_options());
+  assert_proto_server_fetch_failure(proto, LPS_ERROR, NULL);
+  log_proto_server_free(proto);
+}
+
+void
+test_log_proto_gzip_server(void)
+{
+  PROTO_TESTCASE(test_log_proto_gzip_server_simple_messages);
+  PROTO_TESTCASE(test_log_proto_gzip_server_compressed_stream_split_between_reads);
+  PROTO_TESTCASE(test_log_proto_gzip_server_invalid_input);
+}
@@ -0,0 +1,118 @@
+#include "mock-transport.h"
+#include "proto_lib.h"
+#include "msg_parse_lib.h"
+#include "logproto/logproto-string-multiline-server.h"
+
+/****************************************************************************************
+ * LogProtoSTRMultiLineServer
+ ****************************************************************************************/
+
+static void
+test_lines_separated_with_string_prefix(gboolean input_is_stream)
+{
+  LogProtoServer *proto;
+  MultiLineLiteral *prefix;
+
+  proto = log_proto_prefix_string_multiline_server_new(
+            /* 32 bytes max line length, which means that the complete
+             * multi-line block plus one additional line must fit into 32
+             * bytes. */
+            (input_is_stream ? log_transport_mock_stream_new : log_transport_mock_records_new)(
+              "Foo First Line\n"
+              "Foo Second Line\n"
+              "Foo Third Line\n"
+              "Foo Multiline\n"
+              "multi\n"
+              "Foo final\n", -1,
+              LTM_PADDING,
+              LTM_EOF),
+            get_inited_proto_server_options(),
+            prefix = multi_line_literal_new("Foo"), NULL);
+
+  assert_proto_server_fetch(proto, "Foo First Line", -1);
+  assert_proto_server_fetch(proto, "Foo Second Line", -1);
+  assert_proto_server_fetch(proto, "Foo Third Line", -1);
+  assert_proto_server_fetch(proto, "Foo Multiline\nmulti", -1);
+
+  log_proto_server_free(proto);
+  log_proto_server_options_destroy(&proto_server_options);
+  multi_line_literal_free(prefix);
+}
+
+static void
+test_lines_separated_with_string_prefix_and_garbage(gboolean input_is_stream)
+{
+  LogProtoServer *proto;
+  MultiLineLiteral *prefix, *garbage;
+
+  proto = log_proto_prefix_string_multiline_server_new(
+            /* 32 bytes max line length, which means that the complete
+             * multi-line block plus one additional line must fit into 32
+             * bytes. */
+            (input_is_stream ? log_transport_mock_stream_new : log_transport_mock_records_new)(
+              "Foo First Line Bar\n"
+              "Foo Second Line Bar\n"
+              "Foo Third Line Bar\n"
+              "Foo Multiline\n"
+              "multi Bar\n"
+              "Foo final\n", -1,
+              LTM_PADDING,
+              LTM_EOF),
+            get_inited_proto_server_options(),
+            prefix = multi_line_literal_new("Foo"),
+            garbage = multi_line_literal_new(" Bar"));
+
+  assert_proto_server_fetch(proto, "Foo First Line", -1);
+  assert_proto_server_fetch(proto, "Foo Second Line", -1);
+  assert_proto_server_fetch(proto, "Foo Third Line", -1);
+  assert_proto_server_fetch(proto, "Foo Multiline\nmulti", -1);
+
+  log_proto_server_free(proto);
+  log_proto_server_options_destroy(&proto_server_options);
+  multi_line_literal_free(prefix);
+  multi_line_literal_free(garbage);
+}
+
+static void
+test_first_line_without_string_prefix(gboolean input_is_stream)
+{
+  LogProtoServer *proto;
+  MultiLineLiteral *prefix;
+
+  proto = log_proto_prefix_string_multiline_server_new(
+            /* 32 bytes max line length, which means that the complete
+             * multi-line block plus one additional line must fit into 32
+             * bytes. */
+            (input_is_stream ? log_transport_mock_stream_new : log_transport_mock_records_new)(
+              "First Line\n"
+              "Foo Second Line\n"
+              "Foo Third Line\n"
+              "Foo Multiline\n"
+              "multi\n"
+              "Foo final\n", -1,
+              LTM_PADDING,
+              LTM_EOF),
+            get_inited_proto_server_options(),
+            prefix = multi_line_literal_new("Foo"),
+            NULL);
+
+  assert_proto_server_fetch(proto, "First Line", -1);
+  assert_proto_server_fetch(proto, "Foo Second Line", -1);
+  assert_proto_server_fetch(proto, "Foo Third Line", -1);
+  assert_proto_server_fetch(proto, "Foo Multiline\nmulti", -1);
+
+  log_proto_server_free(proto);
+  log_proto_server_options_destroy(&proto_server_options);
+  multi_line_literal_free(prefix);
+}
+
+void
+test_log_proto_string_multiline_server(void)
+{
+  PROTO_TESTCASE(test_lines_separated_with_string_prefix, FALSE);
+  PROTO_TESTCASE(test_lines_separated_with_string_prefix, TRUE);
+  PROTO_TESTCASE(test_lines_separated_with_string_prefix_and_garbage, FALSE);
+  PROTO_TESTCASE(test_lines_separated_with_string_prefix_and_garbage, TRUE);
+  PROTO_TESTCASE(test_first_line_without_string_prefix, FALSE);
+  PROTO_TESTCASE(test_first_line_without_string_prefix, TRUE);
+}
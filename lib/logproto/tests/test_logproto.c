@@ -69,8 +69,10 @@ test_log_proto(void)
   test_log_proto_text_server();
   test_log_proto_indented_multiline_server();
   test_log_proto_regexp_multiline_server();
+  test_log_proto_string_multiline_server();
   test_log_proto_dgram_server();
   test_log_proto_framed_server();
+  test_log_proto_gzip_server();
 }
 
 int
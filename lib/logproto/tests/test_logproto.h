@@ -6,7 +6,9 @@ void test_log_proto_record_server(void);
 void test_log_proto_text_server(void);
 void test_log_proto_indented_multiline_server(void);
 void test_log_proto_regexp_multiline_server(void);
+void test_log_proto_string_multiline_server(void);
 void test_log_proto_dgram_server(void);
 void test_log_proto_framed_server(void);
+void test_log_proto_gzip_server(void);
 
 #endif
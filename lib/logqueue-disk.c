@@ -0,0 +1,643 @@
+/*
+ * Copyright (c) 2002-2016 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-disk.h"
+#include "logpipe.h"
+#include "messages.h"
+#include "serialize.h"
+#include "persistable-state-header.h"
+#include "stats/stats-registry.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <iv_list.h>
+
+/*
+ * LogQueueDisk is a FIFO queue that spills to a ring file on disk once
+ * its in-memory output window fills up, instead of dropping messages or
+ * exercising flow-control against the sources.
+ *
+ * Message flow:
+ *
+ *   - while nothing is queued on disk and the in-memory window (qout) has
+ *     room, messages stay in memory, embedded in LogMessageQueueNode
+ *     elements just like in LogQueueFifo
+ *
+ *   - once qout is full (or there's anything on disk already, to preserve
+ *     ordering), pushed messages are serialized via log_msg_write() and
+ *     appended to the ring file with sequential writes
+ *
+ *   - the output thread refills qout from the disk ring whenever it runs
+ *     empty, deserializing via log_msg_read()
+ *
+ * On-disk format: the data area is a byte ring of disk_buf_size bytes,
+ * each record is a 32 bit big-endian length followed by the serialized
+ * message.  A zero length record means "wrap to the start of the ring".
+ * Ring positions are not stored in the file itself but in the syslog-ng
+ * persist file (see log_queue_disk_save_state()), the same way file
+ * sources store their current position, so an orderly restart picks up
+ * queued messages where it left off.
+ *
+ * Threading: unlike LogQueueFifo this queue only runs its fast path in
+ * memory; all state (including the ring positions) is protected by
+ * super.lock.  This is the slow, spill-to-disk path, a mutex is fine
+ * here.
+ */
+
+typedef struct _LogQueueDisk
+{
+  LogQueue super;
+
+  /* in-memory output window */
+  struct iv_list_head qout;
+  gint qout_len;
+  gint qout_size;    /* in number of elements */
+
+  struct iv_list_head qbacklog;    /* entries that were sent but not acked yet */
+  gint qbacklog_len;
+
+  /* disk ring */
+  gchar *filename;
+  gint fd;
+  gint64 disk_buf_size;    /* size of the ring data area in bytes */
+  gint64 read_ofs;         /* ring offset of the next record to read */
+  gint64 write_ofs;        /* ring offset of the next record to write */
+  gint64 disk_used;        /* bytes currently used in the ring */
+  gint64 disk_stored;      /* number of serialized messages on disk */
+
+  GString *serialize_buffer;
+} LogQueueDisk;
+
+typedef struct _LogQueueDiskState
+{
+  PersistableStateHeader header;
+  gint64 read_ofs;
+  gint64 write_ofs;
+  gint64 disk_used;
+  gint64 disk_stored;
+} LogQueueDiskState;
+
+#define LOG_QUEUE_DISK_RECORD_HEADER_SIZE sizeof(guint32)
+
+static gint64
+log_queue_disk_get_length(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  return self->qout_len + self->disk_stored;
+}
+
+static gboolean
+log_queue_disk_keep_on_reload(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  return log_queue_disk_get_length(s) > 0 || self->qbacklog_len > 0;
+}
+
+static gboolean
+log_queue_disk_pwrite_all(LogQueueDisk *self, const gchar *buf, gsize len, gint64 ofs)
+{
+  gssize rc;
+
+  while (len > 0)
+    {
+      rc = pwrite(self->fd, buf, len, ofs);
+      if (rc < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          msg_error("Error writing disk queue file",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_errno("error", errno),
+                    NULL);
+          return FALSE;
+        }
+      buf += rc;
+      len -= rc;
+      ofs += rc;
+    }
+  return TRUE;
+}
+
+static gboolean
+log_queue_disk_pread_all(LogQueueDisk *self, gchar *buf, gsize len, gint64 ofs)
+{
+  gssize rc;
+
+  while (len > 0)
+    {
+      rc = pread(self->fd, buf, len, ofs);
+      if (rc < 0)
+        {
+          if (errno == EINTR)
+            continue;
+        }
+      if (rc <= 0)
+        {
+          msg_error("Error reading disk queue file",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_errno("error", errno),
+                    NULL);
+          return FALSE;
+        }
+      buf += rc;
+      len -= rc;
+      ofs += rc;
+    }
+  return TRUE;
+}
+
+/* serialize @msg and append it to the disk ring; returns FALSE if it
+ * doesn't fit or the write fails */
+static gboolean
+log_queue_disk_push_to_disk(LogQueueDisk *self, LogMessage *msg)
+{
+  SerializeArchive *sa;
+  guint32 record_len;
+  gint64 needed, contiguous;
+
+  g_string_truncate(self->serialize_buffer, 0);
+  sa = serialize_string_archive_new(self->serialize_buffer);
+  if (!log_msg_write(msg, sa))
+    {
+      serialize_archive_free(sa);
+      return FALSE;
+    }
+  serialize_archive_free(sa);
+
+  record_len = self->serialize_buffer->len;
+  needed = LOG_QUEUE_DISK_RECORD_HEADER_SIZE + record_len;
+
+  contiguous = self->disk_buf_size - self->write_ofs;
+  if (contiguous < needed)
+    {
+      /* record doesn't fit before the end of the ring, write a wrap
+       * marker (if there's room for one) and start over at offset 0 */
+      guint32 wrap_marker = 0;
+
+      if (self->disk_used + contiguous + needed > self->disk_buf_size)
+        return FALSE;
+
+      if (contiguous >= (gint64) LOG_QUEUE_DISK_RECORD_HEADER_SIZE &&
+          !log_queue_disk_pwrite_all(self, (gchar *) &wrap_marker, sizeof(wrap_marker), self->write_ofs))
+        return FALSE;
+
+      self->disk_used += contiguous;
+      self->write_ofs = 0;
+    }
+  else if (self->disk_used + needed > self->disk_buf_size)
+    return FALSE;
+
+  record_len = GUINT32_TO_BE(record_len);
+  if (!log_queue_disk_pwrite_all(self, (gchar *) &record_len, sizeof(record_len), self->write_ofs) ||
+      !log_queue_disk_pwrite_all(self, self->serialize_buffer->str, self->serialize_buffer->len, self->write_ofs + LOG_QUEUE_DISK_RECORD_HEADER_SIZE))
+    return FALSE;
+
+  self->write_ofs += needed;
+  self->disk_used += needed;
+  self->disk_stored++;
+  return TRUE;
+}
+
+/* read and deserialize the next record off the disk ring; returns NULL
+ * on read/parse errors, in which case the ring is reset to avoid
+ * looping on a corrupt record */
+static LogMessage *
+log_queue_disk_pop_from_disk(LogQueueDisk *self)
+{
+  SerializeArchive *sa;
+  LogMessage *msg;
+  guint32 record_len;
+  gint64 contiguous;
+
+  if (self->disk_stored == 0)
+    return NULL;
+
+  contiguous = self->disk_buf_size - self->read_ofs;
+  if (contiguous < (gint64) LOG_QUEUE_DISK_RECORD_HEADER_SIZE)
+    {
+      /* no room for a record header before the ring end, implicit wrap */
+      self->disk_used -= contiguous;
+      self->read_ofs = 0;
+    }
+  else
+    {
+      if (!log_queue_disk_pread_all(self, (gchar *) &record_len, sizeof(record_len), self->read_ofs))
+        goto error;
+      if (GUINT32_FROM_BE(record_len) == 0)
+        {
+          /* wrap marker */
+          self->disk_used -= contiguous;
+          self->read_ofs = 0;
+        }
+    }
+
+  if (!log_queue_disk_pread_all(self, (gchar *) &record_len, sizeof(record_len), self->read_ofs))
+    goto error;
+  record_len = GUINT32_FROM_BE(record_len);
+  if (record_len == 0 || (gint64) record_len > self->disk_buf_size - self->read_ofs)
+    goto error;
+
+  g_string_set_size(self->serialize_buffer, record_len);
+  if (!log_queue_disk_pread_all(self, self->serialize_buffer->str, record_len, self->read_ofs + LOG_QUEUE_DISK_RECORD_HEADER_SIZE))
+    goto error;
+
+  msg = log_msg_new_empty();
+  sa = serialize_string_archive_new(self->serialize_buffer);
+  if (!log_msg_read(msg, sa))
+    {
+      serialize_archive_free(sa);
+      log_msg_unref(msg);
+      goto error;
+    }
+  serialize_archive_free(sa);
+
+  self->read_ofs += LOG_QUEUE_DISK_RECORD_HEADER_SIZE + record_len;
+  self->disk_used -= LOG_QUEUE_DISK_RECORD_HEADER_SIZE + record_len;
+  self->disk_stored--;
+  if (self->disk_stored == 0)
+    {
+      /* the ring ran empty, rewind it so the next spill starts with
+       * purely sequential writes again */
+      self->read_ofs = self->write_ofs = 0;
+      self->disk_used = 0;
+      ftruncate(self->fd, 0);
+    }
+  return msg;
+
+error:
+  msg_error("Corrupt record in disk queue file, dropping queued messages",
+            evt_tag_str("filename", self->filename),
+            evt_tag_int("stored", self->disk_stored),
+            NULL);
+  stats_counter_add(self->super.dropped_messages, self->disk_stored);
+  self->read_ofs = self->write_ofs = 0;
+  self->disk_used = 0;
+  self->disk_stored = 0;
+  return NULL;
+}
+
+/* refill the in-memory output window from the disk ring, assumed to be
+ * called with super.lock held */
+static void
+log_queue_disk_fill_qout(LogQueueDisk *self)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  while (self->qout_len < self->qout_size && self->disk_stored > 0)
+    {
+      LogMessage *msg = log_queue_disk_pop_from_disk(self);
+      LogMessageQueueNode *node;
+
+      if (!msg)
+        break;
+
+      /* messages read back from disk no longer have a sender to ack,
+       * the ack happened when they were written out */
+      node = log_msg_alloc_queue_node(msg, &path_options);
+      iv_list_add_tail(&node->list, &self->qout);
+      self->qout_len++;
+      log_msg_unref(msg);
+    }
+}
+
+/**
+ * Put @msg to the tail of the queue, spilling to disk once the
+ * in-memory window is full.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ **/
+static void
+log_queue_disk_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogMessageQueueNode *node;
+
+  g_static_mutex_lock(&self->super.lock);
+
+  /* NOTE: anything on disk means qout must not be appended to directly,
+   * otherwise we'd reorder messages */
+  if (self->disk_stored == 0 && self->qout_len < self->qout_size)
+    {
+      node = log_msg_alloc_queue_node(msg, path_options);
+      iv_list_add_tail(&node->list, &self->qout);
+      self->qout_len++;
+
+      stats_counter_inc(self->super.stored_messages);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+      log_msg_unref(msg);
+      return;
+    }
+
+  if (log_queue_disk_push_to_disk(self, msg))
+    {
+      stats_counter_inc(self->super.stored_messages);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+
+      /* the message is safely on disk, ack it towards the source so
+       * flow-control doesn't throttle on a stalled destination */
+      log_msg_ack(msg, path_options, AT_PROCESSED);
+      log_msg_unref(msg);
+    }
+  else
+    {
+      stats_counter_inc(self->super.dropped_messages);
+      g_static_mutex_unlock(&self->super.lock);
+      log_msg_drop(msg, path_options);
+
+      msg_debug("Disk queue full, dropping message",
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("disk_buf_size", self->disk_buf_size),
+                evt_tag_str("persist_name", self->super.persist_name),
+                NULL);
+    }
+}
+
+/*
+ * Put an item back to the front of the queue.
+ *
+ * This is assumed to be called only from the output thread.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_disk_push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogMessageQueueNode *node;
+
+  node = log_msg_alloc_dynamic_queue_node(msg, path_options);
+  g_static_mutex_lock(&self->super.lock);
+  iv_list_add(&node->list, &self->qout);
+  self->qout_len++;
+  g_static_mutex_unlock(&self->super.lock);
+  log_msg_unref(msg);
+
+  stats_counter_inc(self->super.stored_messages);
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_disk_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogMessageQueueNode *node;
+  LogMessage *msg = NULL;
+
+  g_static_mutex_lock(&self->super.lock);
+  if (self->qout_len == 0)
+    log_queue_disk_fill_qout(self);
+
+  if (self->qout_len == 0)
+    {
+      g_static_mutex_unlock(&self->super.lock);
+      return NULL;
+    }
+
+  node = iv_list_entry(self->qout.next, LogMessageQueueNode, list);
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  self->qout_len--;
+  if (!self->super.use_backlog)
+    {
+      iv_list_del(&node->list);
+      log_msg_free_queue_node(node);
+    }
+  else
+    {
+      iv_list_del_init(&node->list);
+    }
+  stats_counter_dec(self->super.stored_messages);
+
+  if (self->super.use_backlog)
+    {
+      log_msg_ref(msg);
+      iv_list_add_tail(&node->list, &self->qbacklog);
+      self->qbacklog_len++;
+    }
+  g_static_mutex_unlock(&self->super.lock);
+
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static void
+log_queue_disk_ack_backlog(LogQueue *s, gint rewind_count)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint pos;
+
+  for (pos = 0; pos < rewind_count && self->qbacklog_len > 0; pos++)
+    {
+      LogMessageQueueNode *node;
+
+      node = iv_list_entry(self->qbacklog.next, LogMessageQueueNode, list);
+      msg = node->msg;
+
+      iv_list_del(&node->list);
+      self->qbacklog_len--;
+      path_options.ack_needed = node->ack_needed;
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_free_queue_node(node);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+log_queue_disk_rewind_backlog_all(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_static_mutex_lock(&self->super.lock);
+  iv_list_splice_tail_init(&self->qbacklog, &self->qout);
+  self->qout_len += self->qbacklog_len;
+  stats_counter_add(self->super.stored_messages, self->qbacklog_len);
+  self->qbacklog_len = 0;
+  g_static_mutex_unlock(&self->super.lock);
+}
+
+static void
+log_queue_disk_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  guint pos;
+
+  if (rewind_count > self->qbacklog_len)
+    rewind_count = self->qbacklog_len;
+
+  g_static_mutex_lock(&self->super.lock);
+  for (pos = 0; pos < rewind_count; pos++)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->qbacklog.prev, LogMessageQueueNode, list);
+
+      iv_list_del_init(&node->list);
+      iv_list_add(&node->list, &self->qout);
+
+      self->qbacklog_len--;
+      self->qout_len++;
+      stats_counter_inc(self->super.stored_messages);
+    }
+  g_static_mutex_unlock(&self->super.lock);
+}
+
+gboolean
+log_queue_disk_load_state(LogQueue *s, PersistState *state)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogQueueDiskState *persist;
+  PersistEntryHandle handle;
+  gsize size;
+  guint8 version;
+
+  handle = persist_state_lookup_entry(state, self->super.persist_name, &size, &version);
+  if (!handle || size < sizeof(LogQueueDiskState))
+    return FALSE;
+
+  persist = persist_state_map_entry(state, handle);
+  self->read_ofs = persist->read_ofs;
+  self->write_ofs = persist->write_ofs;
+  self->disk_used = persist->disk_used;
+  self->disk_stored = persist->disk_stored;
+  persist_state_unmap_entry(state, handle);
+
+  msg_verbose("Disk queue state restored",
+              evt_tag_str("filename", self->filename),
+              evt_tag_int("stored", self->disk_stored),
+              NULL);
+  return TRUE;
+}
+
+void
+log_queue_disk_save_state(LogQueue *s, PersistState *state)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  LogQueueDiskState *persist;
+  PersistEntryHandle handle;
+  gsize size;
+  guint8 version;
+
+  handle = persist_state_lookup_entry(state, self->super.persist_name, &size, &version);
+  if (!handle || size < sizeof(LogQueueDiskState))
+    handle = persist_state_alloc_entry(state, self->super.persist_name, sizeof(LogQueueDiskState));
+  if (!handle)
+    return;
+
+  persist = persist_state_map_entry(state, handle);
+  persist->header.version = 0;
+  persist->header.big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
+  persist->read_ofs = self->read_ofs;
+  persist->write_ofs = self->write_ofs;
+  persist->disk_used = self->disk_used;
+  persist->disk_stored = self->disk_stored;
+  persist_state_unmap_entry(state, handle);
+}
+
+static void
+log_queue_disk_free_queue(struct iv_list_head *q)
+{
+  while (!iv_list_empty(q))
+    {
+      LogMessageQueueNode *node;
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg;
+
+      node = iv_list_entry(q->next, LogMessageQueueNode, list);
+      iv_list_del(&node->list);
+
+      path_options.ack_needed = node->ack_needed;
+      msg = node->msg;
+      log_msg_free_queue_node(node);
+      log_msg_ack(msg, &path_options, AT_ABORTED);
+      log_msg_unref(msg);
+    }
+}
+
+static void
+log_queue_disk_free(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  log_queue_disk_free_queue(&self->qout);
+  log_queue_disk_free_queue(&self->qbacklog);
+  if (self->fd >= 0)
+    close(self->fd);
+  g_string_free(self->serialize_buffer, TRUE);
+  g_free(self->filename);
+  log_queue_free_method(s);
+}
+
+LogQueue *
+log_queue_disk_new(gint qout_size, gint64 disk_buf_size, const gchar *filename, const gchar *persist_name)
+{
+  LogQueueDisk *self;
+
+  self = g_new0(LogQueueDisk, 1);
+
+  log_queue_init_instance(&self->super, persist_name);
+  self->super.use_backlog = FALSE;
+  self->super.get_length = log_queue_disk_get_length;
+  self->super.keep_on_reload = log_queue_disk_keep_on_reload;
+  self->super.push_tail = log_queue_disk_push_tail;
+  self->super.push_head = log_queue_disk_push_head;
+  self->super.pop_head = log_queue_disk_pop_head;
+  self->super.ack_backlog = log_queue_disk_ack_backlog;
+  self->super.rewind_backlog = log_queue_disk_rewind_backlog;
+  self->super.rewind_backlog_all = log_queue_disk_rewind_backlog_all;
+  self->super.load_state = log_queue_disk_load_state;
+  self->super.save_state = log_queue_disk_save_state;
+  self->super.free_fn = log_queue_disk_free;
+
+  INIT_IV_LIST_HEAD(&self->qout);
+  INIT_IV_LIST_HEAD(&self->qbacklog);
+  self->qout_size = qout_size;
+  self->disk_buf_size = disk_buf_size;
+  self->filename = g_strdup(filename);
+  self->serialize_buffer = g_string_sized_new(256);
+
+  self->fd = open(filename, O_RDWR | O_CREAT, 0600);
+  if (self->fd < 0)
+    {
+      msg_error("Error opening disk queue file",
+                evt_tag_str("filename", filename),
+                evt_tag_errno("error", errno),
+                NULL);
+      log_queue_unref(&self->super);
+      return NULL;
+    }
+  return &self->super;
+}
@@ -24,6 +24,8 @@
 
 #include "logqueue.h"
 #include "logpipe.h"
+#include "ack_tracker.h"
+#include "tags.h"
 #include "messages.h"
 #include "serialize.h"
 #include "stats/stats-registry.h"
@@ -41,27 +43,35 @@
  *
  *   - has a per-thread, unlocked input queue where threads can put their items
  *
- *   - has a locked wait-queue where items go once the per-thread input
- *     would be overflown or if the input thread goes to sleep (e.g.  one
- *     lock acquisition per a longer period)
+ *   - has a lock-free, multi-producer single-consumer wait-stack where
+ *     items go once the per-thread input would be overflown or if the
+ *     input thread goes to sleep (e.g.  one compare-and-swap per a longer
+ *     period)
  *
- *   - has an unlocked output queue where items from the wait queue go, once
+ *   - has an unlocked output queue where items from the wait stack go, once
  *     it becomes depleted.
  *
  * This means that items flow in this sequence from one list to the next:
  *
- *    input queue (per-thread) -> wait queue (locked) -> output queue (single-threaded)
+ *    input queue (per-thread) -> wait stack (lock-free) -> output queue (single-threaded)
  *
  * Fastpath is:
  *   - input threads putting elements on their per-thread queue (lockless)
  *   - output threads removing elements from the output queue (lockless)
  *
  * Slowpath:
- *   - input queue is overflown (or the input thread goes to sleep), wait
- *     queue mutex is grabbed, all elements are put to the wait queue.
+ *   - input queue is overflown (or the input thread goes to sleep), the
+ *     whole batch is chained up and pushed to the wait stack with a single
+ *     compare-and-swap, producers never touch super.lock
  *
- *   - output queue is depleted, wait queue mutex is grabbed, all elements
- *     on the wait queue is put to the output queue
+ *   - output queue is depleted, the output thread detaches the entire
+ *     wait stack with a compare-and-swap and reverses it into FIFO order
+ *
+ * The wait stack is a Treiber style singly linked stack of
+ * LogMessageQueueNode elements (newest element first), chained through
+ * their embedded list.next pointers, so no allocation happens during the
+ * handoff.  super.lock only protects the parallel_push notification
+ * machinery, the message path itself never takes it.
  *
  * Threading assumptions:
  *   - the head of the queue is only manipulated from the output thread
@@ -70,13 +80,30 @@
  */
 
 
+/* starvation bound of the low-latency lane: after this many consecutive
+ * priority messages the normal lane is granted one slot even if further
+ * priority traffic is waiting */
+#define LOG_QUEUE_FIFO_MAX_PRIO_RUN 64
+
 typedef struct _LogQueueFifo
 {
   LogQueue super;
-  
+
   /* scalable qoverflow implementation */
   struct iv_list_head qoverflow_output;
-  struct iv_list_head qoverflow_wait;
+
+  /* optional low-latency lane: messages carrying prio_tag_id are routed
+   * here when the wait stack is drained and are popped ahead of the
+   * normal lane (see log_queue_fifo_set_prio_tag) */
+  struct iv_list_head qoverflow_prio;
+  gint qoverflow_prio_len;
+  LogTagId prio_tag_id;
+  gboolean prio_enabled;
+  gint prio_run;
+
+  /* lock-free MPSC handoff channel between input threads and the output
+   * thread, newest element first, linked through node->list.next */
+  struct iv_list_head *qoverflow_wait_stack;
   gint qoverflow_wait_len;
   gint qoverflow_output_len;
   gint qoverflow_size; /* in number of elements */
@@ -106,7 +133,82 @@ log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
 
-  return self->qoverflow_wait_len + self->qoverflow_output_len;
+  return g_atomic_int_get(&self->qoverflow_wait_len) + self->qoverflow_output_len + self->qoverflow_prio_len;
+}
+
+/* output side lane of a node: the low-latency lane if it is enabled and
+ * the message carries the priority tag, the normal lane otherwise */
+static struct iv_list_head *
+log_queue_fifo_classify_node(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  if (G_UNLIKELY(self->prio_enabled) && log_msg_is_tag_by_id(node->msg, self->prio_tag_id))
+    {
+      self->qoverflow_prio_len++;
+      return &self->qoverflow_prio;
+    }
+  self->qoverflow_output_len++;
+  return &self->qoverflow_output;
+}
+
+/* push a chain of queue nodes (newest first, chained through list.next,
+ * @tail being the oldest element) to the wait stack with a single
+ * compare-and-swap; can be called from any thread */
+static void
+log_queue_fifo_push_wait_stack(LogQueueFifo *self, struct iv_list_head *head, struct iv_list_head *tail, gint len)
+{
+  struct iv_list_head *old_head;
+
+  do
+    {
+      old_head = g_atomic_pointer_get(&self->qoverflow_wait_stack);
+      tail->next = old_head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange((volatile gpointer *) &self->qoverflow_wait_stack, old_head, head));
+  g_atomic_int_add(&self->qoverflow_wait_len, len);
+}
+
+/* wake up the output thread if it registered a parallel push callback;
+ * the racy check makes sure producers don't touch super.lock in the
+ * common case: the callback is only registered while the queue is
+ * totally empty, and log_queue_check_items() re-checks the queue length
+ * after registration, so the atomic increment of qoverflow_wait_len
+ * (full barrier) before this racy read closes the missed wakeup window */
+static void
+log_queue_fifo_push_notify_racy(LogQueueFifo *self)
+{
+  if (g_atomic_pointer_get((volatile gpointer *) &self->super.parallel_push_notify))
+    {
+      g_static_mutex_lock(&self->super.lock);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+    }
+}
+
+/* detach the entire wait stack and reverse it into FIFO order at the
+ * front of the (empty) output queue; can only run from the output thread */
+static void
+log_queue_fifo_drain_wait_stack(LogQueueFifo *self)
+{
+  struct iv_list_head *chain, *next;
+  gint n = 0;
+
+  do
+    {
+      chain = g_atomic_pointer_get(&self->qoverflow_wait_stack);
+      if (!chain)
+        return;
+    }
+  while (!g_atomic_pointer_compare_and_exchange((volatile gpointer *) &self->qoverflow_wait_stack, chain, NULL));
+
+  /* the chain is newest-first, prepending each element yields FIFO order
+   * within its lane */
+  for (; chain; chain = next)
+    {
+      next = chain->next;
+      iv_list_add(chain, log_queue_fifo_classify_node(self, iv_list_entry(chain, LogMessageQueueNode, list)));
+      n++;
+    }
+  g_atomic_int_add(&self->qoverflow_wait_len, -n);
 }
 
 gboolean
@@ -139,7 +241,7 @@ log_queue_fifo_keep_on_reload(LogQueue *s)
   return log_queue_fifo_get_length(s) > 0 || self->qbacklog_len > 0;
 }
 
-/* move items from the per-thread input queue to the lock-protected "wait" queue */
+/* move items from the per-thread input queue to the lock-free "wait" stack */
 static void
 log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
 {
@@ -159,6 +261,7 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
    */
 
   queue_len = log_queue_fifo_get_length(&self->super);
+  log_queue_publish_pressure(queue_len + self->qoverflow_input[thread_id].len, self->qoverflow_size);
   if (queue_len + self->qoverflow_input[thread_id].len > self->qoverflow_size)
     {
       /* slow path, the input thread's queue would overflow the queue, let's drop some messages */
@@ -191,15 +294,32 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
                 NULL);
     }
   stats_counter_add(self->super.stored_messages, self->qoverflow_input[thread_id].len);
-  iv_list_splice_tail_init(&self->qoverflow_input[thread_id].items, &self->qoverflow_wait);
-  self->qoverflow_wait_len += self->qoverflow_input[thread_id].len;
-  self->qoverflow_input[thread_id].len = 0;
+
+  if (self->qoverflow_input[thread_id].len > 0)
+    {
+      struct iv_list_head *chain_head = NULL, *chain_tail;
+      gint batch_len = self->qoverflow_input[thread_id].len;
+
+      /* build a newest-first chain out of the per-thread batch; taking
+       * elements from the oldest end and pushing them to the chain front
+       * reverses the batch, which is what the wait stack expects */
+      chain_tail = self->qoverflow_input[thread_id].items.next;
+      while (!iv_list_empty(&self->qoverflow_input[thread_id].items))
+        {
+          struct iv_list_head *lh = self->qoverflow_input[thread_id].items.next;
+
+          iv_list_del(lh);
+          lh->next = chain_head;
+          chain_head = lh;
+        }
+      log_queue_fifo_push_wait_stack(self, chain_head, chain_tail, batch_len);
+      self->qoverflow_input[thread_id].len = 0;
+    }
 }
 
-/* move items from the per-thread input queue to the lock-protected
- * "wait" queue, but grabbing locks first. This is registered as a
- * callback to be called when the input worker thread finishes its
- * job.
+/* move items from the per-thread input queue to the lock-free "wait"
+ * stack. This is registered as a callback to be called when the input
+ * worker thread finishes its job.
  */
 static gpointer
 log_queue_fifo_move_input(gpointer user_data)
@@ -211,10 +331,8 @@ log_queue_fifo_move_input(gpointer user_data)
 
   g_assert(thread_id >= 0);
 
-  g_static_mutex_lock(&self->super.lock);
   log_queue_fifo_move_input_unlocked(self, thread_id);
-  log_queue_push_notify(&self->super);
-  g_static_mutex_unlock(&self->super.lock);
+  log_queue_fifo_push_notify_racy(self);
   self->qoverflow_input[thread_id].finish_cb_registered = FALSE;
   return NULL;
 }
@@ -271,30 +389,22 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
       return;
     }
 
-  /* slow path, put the pending item and the whole input queue to the wait_queue */
+  /* slow path, no thread_id, push the single item to the wait stack */
 
-  g_static_mutex_lock(&self->super.lock);
-  
-  if (thread_id >= 0)
-    log_queue_fifo_move_input_unlocked(self, thread_id);
-  
+  log_queue_publish_pressure(log_queue_fifo_get_length(s), self->qoverflow_size);
   if (log_queue_fifo_get_length(s) < self->qoverflow_size)
     {
       node = log_msg_alloc_queue_node(msg, path_options);
 
-      iv_list_add_tail(&node->list, &self->qoverflow_wait);
-      self->qoverflow_wait_len++;
-      log_queue_push_notify(&self->super);
-
+      log_queue_fifo_push_wait_stack(self, &node->list, &node->list, 1);
       stats_counter_inc(self->super.stored_messages);
-      g_static_mutex_unlock(&self->super.lock);
+      log_queue_fifo_push_notify_racy(self);
 
       log_msg_unref(msg);
     }
   else
     {
       stats_counter_inc(self->super.dropped_messages);
-      g_static_mutex_unlock(&self->super.lock);
       log_msg_drop(msg, path_options);
 
       msg_debug("Destination queue full, dropping message",
@@ -324,8 +434,7 @@ log_queue_fifo_push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
    * can't deliver it. No checks, no drops either. */
 
   node = log_msg_alloc_dynamic_queue_node(msg, path_options);
-  iv_list_add(&node->list, &self->qoverflow_output);
-  self->qoverflow_output_len++;
+  iv_list_add(&node->list, log_queue_fifo_classify_node(self, node));
   log_msg_unref(msg);
 
   stats_counter_inc(self->super.stored_messages);
@@ -343,32 +452,26 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
   LogMessageQueueNode *node;
   LogMessage *msg = NULL;
 
-  if (self->qoverflow_output_len == 0)
+  /* with the low-latency lane enabled the wait stack is drained on every
+   * pop, so freshly arrived priority messages overtake a backlog sitting
+   * in the normal lane instead of waiting behind it in the stack */
+  if (self->qoverflow_output_len == 0 || self->prio_enabled)
     {
-      /* slow path, output queue is empty, get some elements from the wait queue */
-      g_static_mutex_lock(&self->super.lock);
-      iv_list_splice_tail_init(&self->qoverflow_wait, &self->qoverflow_output);
-      self->qoverflow_output_len = self->qoverflow_wait_len;
-      self->qoverflow_wait_len = 0;
-      g_static_mutex_unlock(&self->super.lock);
+      log_queue_fifo_drain_wait_stack(self);
     }
 
-  if (self->qoverflow_output_len > 0)
+  if (self->qoverflow_prio_len > 0 &&
+      (self->qoverflow_output_len == 0 || self->prio_run < LOG_QUEUE_FIFO_MAX_PRIO_RUN))
+    {
+      node = iv_list_entry(self->qoverflow_prio.next, LogMessageQueueNode, list);
+      self->qoverflow_prio_len--;
+      self->prio_run++;
+    }
+  else if (self->qoverflow_output_len > 0)
     {
       node = iv_list_entry(self->qoverflow_output.next, LogMessageQueueNode, list);
-
-      msg = node->msg;
-      path_options->ack_needed = node->ack_needed;
       self->qoverflow_output_len--;
-      if (!self->super.use_backlog)
-        {
-          iv_list_del(&node->list);
-          log_msg_free_queue_node(node);
-        }
-      else
-        {
-          iv_list_del_init(&node->list);
-        }
+      self->prio_run = 0;
     }
   else
     {
@@ -382,6 +485,18 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
        */
       return NULL;
     }
+
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  if (!self->super.use_backlog)
+    {
+      iv_list_del(&node->list);
+      log_msg_free_queue_node(node);
+    }
+  else
+    {
+      iv_list_del_init(&node->list);
+    }
   stats_counter_dec(self->super.stored_messages);
 
   if (self->super.use_backlog)
@@ -405,6 +520,10 @@ log_queue_fifo_ack_backlog(LogQueue *s, gint rewind_count)
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
   gint pos;
 
+  /* the writer acks the whole consumed batch at once: collect the acks
+   * per-tracker so the flow-control window and the bookmarks are advanced
+   * once per batch instead of once per message */
+  ack_tracker_batch_begin();
   for (pos = 0; pos < rewind_count && self->qbacklog_len > 0; pos++)
     {
       LogMessageQueueNode *node;
@@ -418,12 +537,18 @@ log_queue_fifo_ack_backlog(LogQueue *s, gint rewind_count)
       log_msg_free_queue_node(node);
       log_msg_unref(msg);
     }
+  ack_tracker_batch_end();
 }
 
 
 /*
  * log_queue_rewind_backlog_all:
  *
+ * NOTE: rewound messages are requeued on the normal lane regardless of
+ * their tags: the backlog is kept in pop order and redelivering it in
+ * that same order is what the ack bookkeeping expects, the low-latency
+ * lane only applies to fresh traffic.
+ *
  * Move items on our backlog back to our qoverflow queue. Please note that this
  * function does not really care about qoverflow size, it has to put the backlog
  * somewhere. The backlog is emptied as that will be filled if we send the
@@ -497,8 +622,11 @@ log_queue_fifo_free(LogQueue *s)
   for (i = 0; i < log_queue_max_threads; i++)
     log_queue_fifo_free_queue(&self->qoverflow_input[i].items);
 
-  log_queue_fifo_free_queue(&self->qoverflow_wait);
+  /* nobody is running at this point, drain whatever is still sitting on
+   * the wait stack into the output queue and free them together */
+  log_queue_fifo_drain_wait_stack(self);
   log_queue_fifo_free_queue(&self->qoverflow_output);
+  log_queue_fifo_free_queue(&self->qoverflow_prio);
   log_queue_fifo_free_queue(&self->qbacklog);
   log_queue_free_method(s);
 }
@@ -532,10 +660,26 @@ log_queue_fifo_new(gint qoverflow_size, const gchar *persist_name)
       self->qoverflow_input[i].cb.user_data = self;
       self->qoverflow_input[i].cb.func = log_queue_fifo_move_input;
     }
-  INIT_IV_LIST_HEAD(&self->qoverflow_wait);
+  self->qoverflow_wait_stack = NULL;
   INIT_IV_LIST_HEAD(&self->qoverflow_output);
+  INIT_IV_LIST_HEAD(&self->qoverflow_prio);
   INIT_IV_LIST_HEAD(&self->qbacklog);
 
   self->qoverflow_size = qoverflow_size;
   return &self->super;
 }
+
+/*
+ * Enable the low-latency lane: messages carrying the given tag are
+ * delivered ahead of untagged traffic (with a bounded number of
+ * consecutive priority deliveries, so the normal lane cannot starve).
+ * May only be called right after construction, before messages flow.
+ */
+void
+log_queue_fifo_set_prio_tag(LogQueue *s, const gchar *tag_name)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+
+  self->prio_tag_id = log_tags_get_by_name(tag_name);
+  self->prio_enabled = TRUE;
+}
@@ -28,5 +28,6 @@
 #include "logqueue.h"
 
 LogQueue *log_queue_fifo_new(gint qoverflow_size, const gchar *persist_name);
+void log_queue_fifo_set_prio_tag(LogQueue *s, const gchar *tag_name);
 
 #endif
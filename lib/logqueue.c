@@ -25,9 +25,45 @@
 #include "logqueue.h"
 #include "stats/stats-registry.h"
 #include "messages.h"
+#include "timeutils.h"
 
 gint log_queue_max_threads = 0;
 
+/* Process-wide backpressure signal fed by the fifo queues: whenever a
+ * destination queue crosses its high-water mark (3/4 full), the signal is
+ * armed for a second.  Sources with shed-below-severity() configured
+ * consult it in log_source_post() and drop their least important traffic
+ * before any further processing is spent on it.  The signal expires on
+ * its own once the queues stop reporting pressure. */
+static gint log_queue_pressure_until = 0;
+
+void
+log_queue_publish_pressure(gint queue_len, gint queue_size)
+{
+  if (queue_len >= queue_size - queue_size / 4)
+    g_atomic_int_set(&log_queue_pressure_until, (gint) cached_g_current_time_sec() + 1);
+}
+
+gboolean
+log_queue_is_under_pressure(void)
+{
+  return (gint) cached_g_current_time_sec() <= g_atomic_int_get(&log_queue_pressure_until);
+}
+
+/* registry of all live queues so that control commands can enumerate
+ * them; queues are created and freed in the main thread, the lock only
+ * guards against a control command racing a reload */
+static GStaticMutex queue_registry_lock = G_STATIC_MUTEX_INIT;
+static GList *queue_registry;
+
+void
+log_queue_registry_foreach(GFunc func, gpointer user_data)
+{
+  g_static_mutex_lock(&queue_registry_lock);
+  g_list_foreach(queue_registry, func, user_data);
+  g_static_mutex_unlock(&queue_registry_lock);
+}
+
 /*
  * When this is called, it is assumed that the output thread is currently
  * not running (since this is the function that wakes it up), thus we can
@@ -105,8 +141,21 @@ log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc para
       self->parallel_push_notify = parallel_push_notify;
       self->parallel_push_data = user_data;
       self->parallel_push_data_destroy = user_data_destroy;
-      g_static_mutex_unlock(&self->lock);
-      return FALSE;
+
+      /* lock-free producers (e.g. LogQueueFifo) check
+       * parallel_push_notify without the lock, right after atomically
+       * publishing their items; re-checking the length here after the
+       * registration became visible closes the window where their racy
+       * read could miss the callback */
+      num_elements = log_queue_get_length(self);
+      if (num_elements == 0)
+        {
+          g_static_mutex_unlock(&self->lock);
+          return FALSE;
+        }
+      self->parallel_push_notify = NULL;
+      self->parallel_push_data = NULL;
+      self->parallel_push_data_destroy = NULL;
     }
 
   /* consume the user_data reference as we won't use the callback */
@@ -183,11 +232,19 @@ log_queue_init_instance(LogQueue *self, const gchar *persist_name)
 
   self->persist_name = persist_name ? g_strdup(persist_name) : NULL;
   g_static_mutex_init(&self->lock);
+
+  g_static_mutex_lock(&queue_registry_lock);
+  queue_registry = g_list_prepend(queue_registry, self);
+  g_static_mutex_unlock(&queue_registry_lock);
 }
 
 void
 log_queue_free_method(LogQueue *self)
 {
+  g_static_mutex_lock(&queue_registry_lock);
+  queue_registry = g_list_remove(queue_registry, self);
+  g_static_mutex_unlock(&queue_registry_lock);
+
   g_static_mutex_free(&self->lock);
   g_free(self->persist_name);
   g_free(self);
@@ -27,6 +27,7 @@
 
 #include "logmsg.h"
 #include "stats/stats-registry.h"
+#include "persist-state.h"
 
 extern gint log_queue_max_threads;
 
@@ -49,6 +50,10 @@ struct _LogQueue
   StatsCounterItem *stored_messages;
   StatsCounterItem *dropped_messages;
 
+  /* highest queue length ever observed, maintained racily at push time,
+   * only used for introspection via "syslog-ng-ctl show-queues" */
+  gint64 max_length;
+
   GStaticMutex lock;
   LogQueuePushNotifyFunc parallel_push_notify;
   gpointer parallel_push_data;
@@ -65,6 +70,11 @@ struct _LogQueue
   void (*rewind_backlog)(LogQueue *self, guint rewind_count);
   void (*rewind_backlog_all)(LogQueue *self);
 
+  /* optional; queues that keep their contents outside the process (such
+   * as the disk based queue) restore/save their positions through these */
+  gboolean (*load_state)(LogQueue *self, PersistState *state);
+  void (*save_state)(LogQueue *self, PersistState *state);
+
   void (*free_fn)(LogQueue *self);
 };
 
@@ -76,6 +86,21 @@ log_queue_keep_on_reload(LogQueue *self)
   return TRUE;
 }
 
+static inline gboolean
+log_queue_load_state(LogQueue *self, PersistState *state)
+{
+  if (self->load_state)
+    return self->load_state(self, state);
+  return TRUE;
+}
+
+static inline void
+log_queue_save_state(LogQueue *self, PersistState *state)
+{
+  if (self->save_state)
+    self->save_state(self, state);
+}
+
 static inline gint64
 log_queue_get_length(LogQueue *self)
 {
@@ -94,7 +119,15 @@ log_queue_is_empty_racy(LogQueue *self)
 static inline void
 log_queue_push_tail(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options)
 {
+  gint64 length;
+
   self->push_tail(self, msg, path_options);
+
+  /* racy high-watermark tracking: concurrent producers may miss an
+   * update, which is fine for a capacity planning aid */
+  length = self->get_length(self);
+  if (length > self->max_length)
+    self->max_length = length;
 }
 
 static inline void
@@ -195,6 +228,11 @@ gboolean log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotify
 void log_queue_set_counters(LogQueue *self, StatsCounterItem *stored_messages, StatsCounterItem *dropped_messages);
 void log_queue_init_instance(LogQueue *self, const gchar *persist_name);
 void log_queue_free_method(LogQueue *self);
+void log_queue_registry_foreach(GFunc func, gpointer user_data);
+
+/* process-wide backpressure signal, see shed-below-severity() */
+void log_queue_publish_pressure(gint queue_len, gint queue_size);
+gboolean log_queue_is_under_pressure(void);
 
 void log_queue_set_max_threads(gint max_threads);
 
@@ -26,6 +26,7 @@
 #include "mainloop-io-worker.h"
 #include "mainloop-call.h"
 #include "ack_tracker.h"
+#include "timeutils.h"
 
 struct _LogReader
 {
@@ -45,10 +46,18 @@ struct _LogReader
 
   struct iv_task restart_task;
   struct iv_event schedule_wakeup;
+  /* fires when the proto holds partially accumulated data that must be
+   * flushed even though no new input arrived (multi-line-timeout()) */
+  struct iv_timer flush_timer;
   MainLoopIOWorkerJob io_job;
-  gboolean watches_running:1, suspended:1;
+  gboolean watches_running:1, suspended:1, quarantine_pending:1;
   gint notify_code;
 
+  /* per-connection parse error accounting for parse-errors-max(); only
+   * touched by the reader's own worker, no locking needed */
+  gint parse_errors_in_sec;
+  time_t parse_error_sec;
+
 
   /* proto & poll_events pending to be applied. As long as the previous
    * processing is being done, we can't replace these in self->proto and
@@ -205,6 +214,10 @@ log_reader_init_watches(LogReader *self)
   self->schedule_wakeup.cookie = self;
   self->schedule_wakeup.handler = log_reader_wakeup_triggered;
 
+  IV_TIMER_INIT(&self->flush_timer);
+  self->flush_timer.cookie = self;
+  self->flush_timer.handler = log_reader_io_process_input;
+
   main_loop_io_worker_job_init(&self->io_job);
   self->io_job.user_data = self;
   self->io_job.work = (void (*)(void *)) log_reader_work_perform;
@@ -220,6 +233,8 @@ log_reader_stop_watches(LogReader *self)
 
       if (iv_task_registered(&self->restart_task))
         iv_task_unregister(&self->restart_task);
+      if (iv_timer_registered(&self->flush_timer))
+        iv_timer_unregister(&self->flush_timer);
       self->watches_running = FALSE;
     }
 }
@@ -245,6 +260,8 @@ log_reader_suspend_until_awoken(LogReader *self)
 {
   self->immediate_check = FALSE;
   poll_events_suspend_watches(self->poll_events);
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
   self->suspended = TRUE;
 }
 
@@ -267,6 +284,7 @@ log_reader_update_watches(LogReader *self)
   GIOCondition cond;
   gboolean free_to_send;
   gboolean line_is_ready_in_buffer;
+  gint flush_timeout;
 
   main_loop_assert_main_thread();
 
@@ -289,6 +307,17 @@ log_reader_update_watches(LogReader *self)
       return;
     }
   poll_events_update_watches(self->poll_events, cond);
+
+  flush_timeout = log_proto_server_get_pending_flush_timeout(self->proto);
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
+  if (flush_timeout >= 0)
+    {
+      iv_validate_now();
+      self->flush_timer.expires = iv_now;
+      timespec_add_msec(&self->flush_timer.expires, flush_timeout);
+      iv_timer_register(&self->flush_timer);
+    }
 }
 
 static void
@@ -299,12 +328,28 @@ _add_aux_nvpair(const gchar *name, const gchar *value, gsize value_len, gpointer
   log_msg_set_value_by_name(msg, name, value, value_len);;
 }
 
+/* one more parse error arrived on this connection; decide whether it
+ * pushed the error rate over parse-errors-max() */
+static void
+log_reader_account_parse_error(LogReader *self)
+{
+  time_t now = cached_g_current_time_sec();
+
+  if (now != self->parse_error_sec)
+    {
+      self->parse_error_sec = now;
+      self->parse_errors_in_sec = 0;
+    }
+  if (++self->parse_errors_in_sec > self->options->parse_errors_max)
+    self->quarantine_pending = TRUE;
+}
+
 static gboolean
 log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
 {
   LogMessage *m;
-  
-  msg_debug("Incoming log entry", 
+
+  msg_debug("Incoming log entry",
             evt_tag_printf("line", "%.*s", length, line),
             NULL);
   /* use the current time to get the time zone offset */
@@ -312,6 +357,9 @@ log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTran
                   aux->peer_addr ? : self->peer_addr,
                   &self->options->parse_options);
 
+  if (G_UNLIKELY((m->flags & LF_PARSE_ERROR) && self->options->parse_errors_max))
+    log_reader_account_parse_error(self);
+
   log_msg_refcache_start_producer(m);
   
   log_transport_aux_data_foreach(aux, _add_aux_nvpair, m);
@@ -321,6 +369,80 @@ log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTran
   return log_source_free_to_send(&self->super);
 }
 
+/* number of messages extracted by a single batched fetch; the flow
+ * control window can be overrun by at most this many messages, so keep
+ * it well below usual window sizes */
+#define LOG_READER_FETCH_BATCH_SIZE 32
+
+/* batched fetch loop for protocols that don't need per-message
+ * bookmarks; extracts whole batches of message slices out of one buffer
+ * fill, so the poll/fetch bookkeeping runs once per batch instead of
+ * once per message; returns notify_code or 0, fills msg_count */
+static gint
+log_reader_fetch_log_batched(LogReader *self, gboolean may_read, gint *msg_count)
+{
+  LogProtoServerBatchEntry entries[LOG_READER_FETCH_BATCH_SIZE];
+  gboolean window_full = FALSE;
+
+  while (*msg_count < self->options->fetch_limit && !window_full &&
+         !self->quarantine_pending && !main_loop_worker_job_quit())
+    {
+      LogProtoStatus status;
+      gint num_entries = 0;
+      gint max_entries, i;
+
+      max_entries = MIN(self->options->fetch_limit - *msg_count, LOG_READER_FETCH_BATCH_SIZE);
+      for (i = 0; i < max_entries; i++)
+        log_transport_aux_data_init(&entries[i].aux);
+
+      status = log_proto_server_fetch_batch(self->proto, entries, max_entries, &num_entries, &may_read);
+      if (status == LPS_EOF || status == LPS_ERROR)
+        {
+          for (i = 0; i < max_entries; i++)
+            log_transport_aux_data_destroy(&entries[i].aux);
+          return status == LPS_ERROR ? NC_READ_ERROR : NC_CLOSE;
+        }
+
+      /* NOTE: all extracted entries must be posted, the protocol already
+       * consumed them; a full window only stops further fetching */
+      for (i = 0; i < num_entries; i++)
+        {
+          if (entries[i].msg_len > 0 || (self->options->flags & LR_EMPTY_LINES))
+            {
+              (*msg_count)++;
+
+              if (!log_reader_handle_line(self, entries[i].msg, entries[i].msg_len, &entries[i].aux))
+                window_full = TRUE;
+            }
+        }
+      for (i = 0; i < max_entries; i++)
+        log_transport_aux_data_destroy(&entries[i].aux);
+
+      if (num_entries < max_entries)
+        {
+          /* no more messages for now */
+          break;
+        }
+    }
+  return 0;
+}
+
+/* returns NC_CLOSE once and rearms if the connection exceeded its
+ * parse-errors-max() budget during the last fetch */
+static gint
+log_reader_check_quarantine(LogReader *self)
+{
+  if (!self->quarantine_pending)
+    return 0;
+
+  self->quarantine_pending = FALSE;
+  msg_warning("Too many unparsable messages on this connection, closing it",
+              evt_tag_int("parse_errors", self->parse_errors_in_sec),
+              evt_tag_int("parse_errors_max", self->options->parse_errors_max),
+              NULL);
+  return NC_CLOSE;
+}
+
 /* returns: notify_code (NC_XXXX) or 0 for success */
 static gint
 log_reader_fetch_log(LogReader *self)
@@ -332,6 +454,21 @@ log_reader_fetch_log(LogReader *self)
   if (self->waiting_for_preemption)
     may_read = FALSE;
 
+  if (!log_proto_server_is_position_tracked(self->proto))
+    {
+      /* bookmarks are not needed, the whole batch can be extracted from
+       * one buffer fill and pushed through before touching the window
+       * counters again */
+      gint notify_code = log_reader_fetch_log_batched(self, may_read, &msg_count);
+
+      if (notify_code)
+        return notify_code;
+      notify_code = log_reader_check_quarantine(self);
+      if (notify_code)
+        return notify_code;
+      goto finish;
+    }
+
   /* NOTE: this loop is here to decrease the load on the main loop, we try
    * to fetch a couple of messages in a single run (but only up to
    * fetch_limit).
@@ -382,9 +519,16 @@ log_reader_fetch_log(LogReader *self)
               /* window is full, don't generate further messages */
               break;
             }
+          if (self->quarantine_pending)
+            break;
         }
     }
   log_transport_aux_data_destroy(&aux);
+
+  if (self->quarantine_pending)
+    return log_reader_check_quarantine(self);
+
+ finish:
   if (self->options->flags & LR_PREEMPT)
     {
       if (log_proto_server_is_preemptable(self->proto))
@@ -569,6 +713,7 @@ log_reader_options_defaults(LogReaderOptions *options)
   log_proto_server_options_defaults(&options->proto_options.super);
   msg_format_options_defaults(&options->parse_options);
   options->fetch_limit = 10;
+  options->parse_errors_max = 0;
   if (configuration && cfg_is_config_version_older(configuration, 0x0300))
     {
       msg_warning_once("WARNING: input: sources do not remove new-line characters from messages by default from " VERSION_3_0 ", please add 'no-multi-line' flag to your configuration if you want to retain this functionality",
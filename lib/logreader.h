@@ -48,6 +48,9 @@ typedef struct _LogReaderOptions
   LogProtoServerOptionsStorage proto_options;
   guint32 flags;
   gint fetch_limit;
+  /* close the connection when it produces more than this many parse
+   * errors within one second, 0 disables the quarantine */
+  gint parse_errors_max;
   const gchar *group_name;
   gboolean check_hostname;
 } LogReaderOptions;
@@ -24,13 +24,16 @@
   
 #include "logsource.h"
 #include "messages.h"
+#include "cfg.h"
 #include "misc.h"
 #include "host-resolve.h"
 #include "timeutils.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-syslog.h"
+#include "syslog-names.h"
 #include "tags.h"
 #include "ack_tracker.h"
+#include "logqueue.h"
 
 #include <string.h>
 
@@ -117,6 +120,51 @@ _flow_control_rate_adjust(LogSource *self)
 #endif
 }
 
+/*
+ * Rebalance this connection's share of the flow-control window against the
+ * pool shared by all connections of the driver.  Runs in the reader thread
+ * right after window_size was decremented for the current message;
+ * @window_after is the number of slots still free.  As we are the only
+ * thread that ever decreases window_size and concurrent acks can only
+ * increase it, @window_after is a safe lower bound when giving slots back.
+ */
+static void
+_dynamic_window_rebalance(LogSource *self, gint window_after)
+{
+  GAtomicCounter *pool = &self->options->dynamic_window_pool;
+
+  if (window_after == 0)
+    {
+      /* we've just run out of window, try to borrow another
+       * init_window_size worth of slots; the pool may hand out less (or
+       * nothing) if other connections got there first */
+      gint chunk = self->options->init_window_size;
+      gint avail = g_atomic_counter_exchange_and_add(pool, -chunk);
+      gint taken = MIN(avail, chunk);
+
+      if (taken < 0)
+        taken = 0;
+      if (taken < chunk)
+        g_atomic_counter_exchange_and_add(pool, chunk - taken);
+      if (taken > 0)
+        {
+          self->window_borrowed += taken;
+          g_atomic_counter_exchange_and_add(&self->window_size, taken);
+        }
+    }
+  else if (self->window_borrowed > 0 && window_after > self->options->init_window_size)
+    {
+      /* acks have caught up with this connection, the part of the free
+       * window above our own base size is not needed anymore: return it
+       * so slower moments on other connections can use it */
+      gint surplus = MIN(self->window_borrowed, window_after - self->options->init_window_size);
+
+      g_atomic_counter_exchange_and_add(&self->window_size, -surplus);
+      g_atomic_counter_exchange_and_add(pool, surplus);
+      self->window_borrowed -= surplus;
+    }
+}
+
 void
 log_source_flow_control_adjust(LogSource *self, guint32 window_size_increment)
 {
@@ -196,6 +244,10 @@ log_source_init(LogPipe *s)
   stats_lock();
   stats_register_counter(self->stats_level, self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->recvd_messages);
   stats_register_counter(self->stats_level, self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_STAMP, &self->last_message_seen);
+  if (self->options->shed_severities)
+    stats_register_counter(self->stats_level, self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_DROPPED, &self->shed_messages);
+  if (self->recvd_messages)
+    self->recvd_messages_shards = stats_counter_shards_new(self->recvd_messages);
   stats_unlock();
   return TRUE;
 }
@@ -206,18 +258,235 @@ log_source_deinit(LogPipe *s)
   LogSource *self = (LogSource *) s;
   
   stats_lock();
+  stats_counter_shards_free(self->recvd_messages_shards);
+  self->recvd_messages_shards = NULL;
   stats_unregister_counter(self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->recvd_messages);
   stats_unregister_counter(self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_STAMP, &self->last_message_seen);
+  if (self->shed_messages)
+    stats_unregister_counter(self->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance, SC_TYPE_DROPPED, &self->shed_messages);
   stats_unlock();
   return TRUE;
 }
 
+/* Duplicate suppression for at-least-once relay chains: a relay that
+ * resends its disk buffer after a connection breakdown delivers messages
+ * the collector has already accepted.  Senders using the syslog protocol
+ * stamp every message with an [meta sequenceId="..."] SD element, so the
+ * receiving side can keep a sliding window of recently seen sequence
+ * numbers per peer and drop repeats before they are bookmarked or queued.
+ *
+ * The window is the usual anti-replay construct: a bitmap of the last
+ * LOG_SOURCE_DEDUP_WINDOW_SIZE sequence numbers relative to the highest
+ * one seen.  Messages far below the window indicate a sender restart
+ * (sequence numbering begins anew with a new RUNID) and reset the window
+ * instead of being treated as duplicates. */
+
+#define LOG_SOURCE_DEDUP_WINDOW_SIZE 8192
+
+typedef struct _LogSourceDedupWindow
+{
+  gboolean initialized;
+  /* highest sequence number seen, bit i of the bitmap covers last_seq - i */
+  guint32 last_seq;
+  guint32 seen[LOG_SOURCE_DEDUP_WINDOW_SIZE / 32];
+} LogSourceDedupWindow;
+
+static inline void
+_dedup_window_set_bit(LogSourceDedupWindow *win, guint32 ofs)
+{
+  win->seen[ofs / 32] |= 1U << (ofs % 32);
+}
+
+static inline gboolean
+_dedup_window_test_bit(LogSourceDedupWindow *win, guint32 ofs)
+{
+  return (win->seen[ofs / 32] & (1U << (ofs % 32))) != 0;
+}
+
+/* the window advanced by @distance sequence numbers: the offset of every
+ * recorded bit grows by the same amount, so the bitmap is shifted towards
+ * the higher indices */
+static void
+_dedup_window_slide(LogSourceDedupWindow *win, guint32 distance)
+{
+  const gint num_words = LOG_SOURCE_DEDUP_WINDOW_SIZE / 32;
+  gint word_shift = distance / 32;
+  gint bit_shift = distance % 32;
+  gint i;
+
+  if (distance >= LOG_SOURCE_DEDUP_WINDOW_SIZE)
+    {
+      memset(win->seen, 0, sizeof(win->seen));
+      return;
+    }
+
+  for (i = num_words - 1; i >= 0; i--)
+    {
+      guint32 v = 0;
+
+      if (i - word_shift >= 0)
+        v = win->seen[i - word_shift] << bit_shift;
+      if (bit_shift && i - word_shift - 1 >= 0)
+        v |= win->seen[i - word_shift - 1] >> (32 - bit_shift);
+      win->seen[i] = v;
+    }
+}
+
+/* returns whether the message is new to the window; duplicates leave the
+ * window unchanged */
+static gboolean
+_dedup_window_check_and_update(LogSourceDedupWindow *win, guint32 seq)
+{
+  gint32 distance;
+
+  if (!win->initialized)
+    {
+      win->initialized = TRUE;
+      win->last_seq = seq;
+      _dedup_window_set_bit(win, 0);
+      return TRUE;
+    }
+
+  distance = (gint32) (seq - win->last_seq);
+  if (distance > 0)
+    {
+      _dedup_window_slide(win, distance);
+      win->last_seq = seq;
+      _dedup_window_set_bit(win, 0);
+      return TRUE;
+    }
+
+  if (distance <= -LOG_SOURCE_DEDUP_WINDOW_SIZE)
+    {
+      /* far below the window: the sender was restarted and begins a new
+       * sequence, start afresh instead of swallowing its messages */
+      memset(win->seen, 0, sizeof(win->seen));
+      win->last_seq = seq;
+      _dedup_window_set_bit(win, 0);
+      return TRUE;
+    }
+
+  if (_dedup_window_test_bit(win, -distance))
+    return FALSE;
+  _dedup_window_set_bit(win, -distance);
+  return TRUE;
+}
+
+static NVHandle
+_dedup_sequence_id_handle(void)
+{
+  static NVHandle handle = 0;
+
+  if (!handle)
+    handle = log_msg_get_value_handle(".SDATA.meta.sequenceId");
+  return handle;
+}
+
+static gboolean
+_suppress_duplicates_accept(LogSource *self, LogMessage *msg)
+{
+  const gchar *key;
+  gint64 seq;
+  LogSourceDedupWindow *win;
+
+  if (!log_msg_get_value_as_int64(msg, _dedup_sequence_id_handle(), &seq))
+    {
+      /* no sequence information, nothing to match on */
+      return TRUE;
+    }
+
+  key = msg->saddr ? g_sockaddr_get_address_str(msg->saddr) : "local";
+  if (!self->dedup_peers)
+    self->dedup_peers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  win = g_hash_table_lookup(self->dedup_peers, key);
+  if (!win)
+    {
+      win = g_new0(LogSourceDedupWindow, 1);
+      g_hash_table_insert(self->dedup_peers, g_strdup(key), win);
+    }
+  return _dedup_window_check_and_update(win, (guint32) seq);
+}
+
+static gboolean
+log_source_pri_accepted(LogSource *self, LogMessage *msg)
+{
+  guint32 severity = msg->pri & LOG_PRIMASK;
+  guint32 facility = (msg->pri & LOG_FACMASK) >> 3;
+
+  if (!(self->options->accepted_severities & (1 << severity)))
+    return FALSE;
+  /* facilities above 31 do not fit the bitmask and are always accepted */
+  if (facility < 32 && !(self->options->accepted_facilities & (1 << facility)))
+    return FALSE;
+  return TRUE;
+}
+
 void
 log_source_post(LogSource *self, LogMessage *msg)
 {
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
   gint old_window_size;
 
+  if (G_UNLIKELY(!log_source_pri_accepted(self, msg)))
+    {
+      /* no log path referencing this source accepts this severity/facility
+       * combination, drop the message before it is bookmarked or queued */
+      msg_debug("Dropping message, no log path accepts its priority",
+                evt_tag_str("source", self->options->group_name),
+                evt_tag_int("pri", msg->pri),
+                NULL);
+      log_msg_unref(msg);
+      return;
+    }
+
+  if (G_UNLIKELY(self->options->shed_severities & (1 << (msg->pri & LOG_PRIMASK))) &&
+      log_queue_is_under_pressure())
+    {
+      /* a destination queue signalled backpressure: shed the least
+       * important traffic here, before parsing side effects, bookmarking
+       * and the log path traversal are paid for it */
+      stats_counter_inc(self->shed_messages);
+      log_msg_unref(msg);
+      return;
+    }
+
+  if (G_UNLIKELY(self->options->suppress_duplicates) &&
+      !_suppress_duplicates_accept(self, msg))
+    {
+      msg_debug("Dropping message, its sequence number was already seen from this peer",
+                evt_tag_str("source", self->options->group_name),
+                NULL);
+      log_msg_unref(msg);
+      return;
+    }
+
+  if (G_UNLIKELY(self->options->latency_sample_freq > 0))
+    {
+      /* stamp every Nth message so the destinations can publish latency
+       * histograms; the cached clock is too coarse for this purpose, so
+       * we pay for a real gettimeofday() on the sampled messages only */
+      if ((self->latency_sample_counter++ % self->options->latency_sample_freq) == 0)
+        {
+          GTimeVal now;
+
+          g_get_current_time(&now);
+          msg->latency_stamp = (guint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+        }
+    }
+
+  if (G_UNLIKELY(self->window_free))
+    {
+      /* fast path: no-one downstream requires acknowledgements (no
+       * flags(flow-control) anywhere in the configuration) and our
+       * position is not tracked either, so there's no need to bookmark
+       * the message or to account for the flow-control window; without
+       * an outstanding ack the message simply goes away with its last
+       * reference */
+      path_options.ack_needed = FALSE;
+      log_pipe_queue(&self->super, msg, &path_options);
+      return;
+    }
+
   ack_tracker_track_msg(self->ack_tracker, msg);
 
   /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
@@ -237,6 +506,10 @@ log_source_post(LogSource *self, LogMessage *msg)
    */
 
   g_assert(old_window_size > 0);
+
+  if (G_UNLIKELY(self->options->dynamic_window_size > 0))
+    _dynamic_window_rebalance(self, old_window_size - 1);
+
   log_pipe_queue(&self->super, msg, &path_options);
 }
 
@@ -283,26 +556,22 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
 
   log_msg_set_tag_by_id(msg, self->options->source_group_tag);
 
-  /* stats counters */
+  /* stats counters; these only lock the registry shard owning the key */
   if (stats_check_level(2))
     {
-      stats_lock();
-
       stats_register_and_increment_dynamic_counter(2, SCS_HOST | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
       if (stats_check_level(3))
         {
           stats_register_and_increment_dynamic_counter(3, SCS_SENDER | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST_FROM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
           stats_register_and_increment_dynamic_counter(3, SCS_PROGRAM | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_PROGRAM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
         }
-
-      stats_unlock();
     }
   stats_syslog_process_message_pri(msg->pri);
 
   /* message setup finished, send it out */
 
 
-  stats_counter_inc(self->recvd_messages);
+  stats_counter_shards_inc(self->recvd_messages_shards);
   stats_counter_set(self->last_message_seen, msg->timestamps[LM_TS_RECVD].tv_sec);
   log_pipe_forward_msg(s, msg, path_options);
 
@@ -353,6 +622,12 @@ log_source_set_options(LogSource *self, LogSourceOptions *options, gint stats_le
   self->threaded = threaded;
   self->pos_tracked = pos_tracked;
   self->super.expr_node = expr_node;
+
+  /* if no log path in the configuration uses flags(flow-control) and our
+   * position is not tracked, acks would only be used to replenish the
+   * window that nothing ever stalls: destinations ack at queue time in
+   * this case.  Skip the whole machinery for such sources. */
+  self->window_free = !pos_tracked && !log_pipe_get_config(&self->super)->tree.flow_control_used;
   _create_ack_tracker_if_not_exists(self, pos_tracked);
 }
 
@@ -372,7 +647,15 @@ void
 log_source_free(LogPipe *s)
 {
   LogSource *self = (LogSource *) s;
-  
+
+  /* NOTE: no acks can be outstanding by the time a source is freed (they
+   * would dereference our ack_tracker below), so the borrowed part of the
+   * window is free again and can go back to the shared pool */
+  if (self->window_borrowed > 0)
+    g_atomic_counter_exchange_and_add(&self->options->dynamic_window_pool, self->window_borrowed);
+
+  if (self->dedup_peers)
+    g_hash_table_destroy(self->dedup_peers);
   g_free(self->stats_id);
   g_free(self->stats_instance);
   log_pipe_free_method(s);
@@ -384,12 +667,18 @@ void
 log_source_options_defaults(LogSourceOptions *options)
 {
   options->init_window_size = 100;
+  options->dynamic_window_size = 0;
   options->keep_hostname = -1;
   options->chain_hostnames = -1;
   options->keep_timestamp = -1;
   options->program_override_len = -1;
   options->host_override_len = -1;
   options->tags = NULL;
+  options->accepted_severities = 0xff;
+  options->accepted_facilities = 0xffffffff;
+  options->latency_sample_freq = 0;
+  options->suppress_duplicates = FALSE;
+  options->shed_severities = 0;
   host_resolve_options_defaults(&options->host_resolve_options);
 }
 
@@ -407,6 +696,19 @@ log_source_options_init(LogSourceOptions *options, GlobalConfig *cfg, const gcha
     options->keep_timestamp = cfg->keep_timestamp;
   options->group_name = group_name;
 
+  if (!cfg_tree_get_source_accepted_pri(&cfg->tree, group_name, &options->accepted_severities, &options->accepted_facilities))
+    {
+      options->accepted_severities = 0xff;
+      options->accepted_facilities = 0xffffffff;
+    }
+
+  options->latency_sample_freq = cfg->latency_sample_freq;
+
+  /* NOTE: much like init_window_size above, the pool is reset on reload
+   * without consulting surviving connections; slots they borrowed earlier
+   * are simply returned on top of the new pool size */
+  g_atomic_counter_set(&options->dynamic_window_pool, options->dynamic_window_size);
+
   source_group_name = g_strdup_printf(".source.%s", group_name);
   options->source_group_tag = log_tags_get_by_name(source_group_name);
   g_free(source_group_name);
@@ -446,6 +748,20 @@ log_source_options_set_tags(LogSourceOptions *options, GList *tags)
     }
 }
 
+/* configure under-pressure shedding: messages strictly less important
+ * than @level (numerically greater severity) are dropped while the
+ * destination queues report backpressure */
+gboolean
+log_source_options_set_shed_below_severity(LogSourceOptions *options, const gchar *level)
+{
+  gint severity = syslog_name_lookup_level_by_name(level);
+
+  if (severity < 0)
+    return FALSE;
+  options->shed_severities = ~((1 << (severity + 1)) - 1) & 0xff;
+  return TRUE;
+}
+
 void
 log_source_global_init(void)
 {
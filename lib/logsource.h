@@ -32,6 +32,14 @@
 typedef struct _LogSourceOptions
 {
   gint init_window_size;
+  /* extra flow-control window shared by all connections of this driver;
+   * connections that exhaust their own window borrow from this pool and
+   * return the borrowed slots once their acks catch up, so a burst on one
+   * connection may use capacity that quiet connections do not need.  The
+   * per-connection window plus this pool caps the total number of
+   * messages in flight for the driver.  0 disables borrowing. */
+  gint dynamic_window_size;
+  GAtomicCounter dynamic_window_pool;
   const gchar *group_name;
   gboolean keep_timestamp;
   gboolean keep_hostname;
@@ -43,6 +51,21 @@ typedef struct _LogSourceOptions
   gint host_override_len;
   LogTagId source_group_tag;
   GArray *tags;
+  /* conservative superset of the PRI values any log path consuming this
+   * source may act upon, see cfg_tree_get_source_accepted_pri(); messages
+   * outside these masks are dropped early in log_source_post() */
+  guint32 accepted_severities;
+  guint32 accepted_facilities;
+  /* copied from the global latency-sample-freq() option, 0 disables
+   * latency stamping */
+  gint latency_sample_freq;
+  /* drop messages whose ${.SDATA.meta.sequenceId} was already seen from
+   * the same peer, protecting against duplicates injected by retransmits
+   * of at-least-once relay chains */
+  gboolean suppress_duplicates;
+  /* severities shed in log_source_post() while the destination queues
+   * report backpressure, see shed-below-severity(); 0 disables shedding */
+  guint32 shed_severities;
 } LogSourceOptions;
 
 typedef struct _LogSource LogSource;
@@ -63,15 +86,31 @@ struct _LogSource
   guint16 stats_source;
   gboolean threaded;
   gboolean pos_tracked;
+  /* neither flow-control nor position tracking is in use: messages are
+   * posted without requesting an acknowledgement and without window
+   * accounting, see log_source_post() */
+  gboolean window_free;
   gchar *stats_id;
   gchar *stats_instance;
   GAtomicCounter window_size;
+  /* number of window slots currently borrowed from the shared
+   * dynamic_window_pool; only manipulated by the reader thread */
+  gint window_borrowed;
   StatsCounterItem *last_message_seen;
   StatsCounterItem *recvd_messages;
+  StatsCounterItem *shed_messages;
+  StatsCounterShards *recvd_messages_shards;
   guint32 last_ack_count;
   guint32 ack_count;
   glong window_full_sleep_nsec;
+  /* counts posted messages for the 1-in-N latency sampling decision;
+   * updated without synchronization, a lost increment merely shifts
+   * which message gets stamped */
+  guint latency_sample_counter;
   struct timespec last_ack_rate_time;
+  /* per-peer sequence number windows for suppress-duplicates(), keyed by
+   * the peer address; only touched by the reader thread */
+  GHashTable *dedup_peers;
   AckTracker *ack_tracker;
 
   void (*wakeup)(LogSource *s);
@@ -80,6 +119,8 @@ struct _LogSource
 static inline gboolean
 log_source_free_to_send(LogSource *self)
 {
+  if (self->window_free)
+    return TRUE;
   return g_atomic_counter_get(&self->window_size) > 0;
 }
 
@@ -101,6 +142,7 @@ void log_source_options_defaults(LogSourceOptions *options);
 void log_source_options_init(LogSourceOptions *options, GlobalConfig *cfg, const gchar *group_name);
 void log_source_options_destroy(LogSourceOptions *options);
 void log_source_options_set_tags(LogSourceOptions *options, GList *tags);
+gboolean log_source_options_set_shed_below_severity(LogSourceOptions *options, const gchar *level);
 void log_source_free(LogPipe *s);
 void log_source_wakeup(LogSource *self);
 void log_source_flow_control_adjust(LogSource *self, guint32 window_size_increment);
@@ -26,6 +26,30 @@
 #include "messages.h"
 #include "timeutils.h"
 #include "str-format.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+/* per-thread cache of the last rendered timestamp body for each format,
+ * keyed by the second and the target zone offset; destinations emitting
+ * many messages within the same second append a pre-rendered string
+ * instead of re-running the digit formatting (second fractions and the
+ * ISO zone suffix are appended outside the cached body) */
+typedef struct _LogStampCacheEntry
+{
+  time_t when;
+  glong zone_offset;
+  guint8 len;
+  gchar buf[47];
+} LogStampCacheEntry;
+
+TLS_BLOCK_START
+{
+  LogStampCacheEntry stamp_format_cache[4];    /* indexed by TS_FMT_* */
+}
+TLS_BLOCK_END;
+
+#define stamp_format_cache   __tls_deref(stamp_format_cache)
 
 static void
 log_stamp_append_frac_digits(const LogStamp *stamp, GString *target, gint frac_digits)
@@ -63,15 +87,27 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
 {
   glong target_zone_offset = 0;
   struct tm *tm, tm_storage;
+  LogStampCacheEntry *cached;
+  gsize body_ofs;
   char buf[8];
   time_t t;
-  
+
   if (zone_offset != -1)
     target_zone_offset = zone_offset;
   else
     target_zone_offset = stamp->zone_offset;
 
   t = stamp->tv_sec + target_zone_offset;
+
+  cached = &stamp_format_cache[ts_format & 3];
+  if (ts_format != TS_FMT_UNIX &&
+      cached->len && cached->when == t && cached->zone_offset == target_zone_offset)
+    {
+      g_string_append_len(target, cached->buf, cached->len);
+      goto append_suffix;
+    }
+
+  body_ofs = target->len;
   cached_gmtime(&t, &tm_storage);
   tm = &tm_storage;
   switch (ts_format)
@@ -81,29 +117,24 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       g_string_append_c(target, ' ');
       format_uint32_padded(target, 2, ' ', 10, tm->tm_mday);
       g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_hour);
+      format_uint32_2digits(target, tm->tm_hour);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_min);
+      format_uint32_2digits(target, tm->tm_min);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
+      format_uint32_2digits(target, tm->tm_sec);
       break;
     case TS_FMT_ISO:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
       g_string_append_c(target, '-');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_mon + 1);
+      format_uint32_2digits(target, tm->tm_mon + 1);
       g_string_append_c(target, '-');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_mday);
+      format_uint32_2digits(target, tm->tm_mday);
       g_string_append_c(target, 'T');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_hour);
+      format_uint32_2digits(target, tm->tm_hour);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_min);
+      format_uint32_2digits(target, tm->tm_min);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
-      format_zone_info(buf, sizeof(buf), target_zone_offset);
-      g_string_append(target, buf);
+      format_uint32_2digits(target, tm->tm_sec);
       break;
     case TS_FMT_FULL:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
@@ -112,22 +143,36 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       g_string_append_c(target, ' ');
       format_uint32_padded(target, 2, ' ', 10, tm->tm_mday);
       g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_hour);
+      format_uint32_2digits(target, tm->tm_hour);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_min);
+      format_uint32_2digits(target, tm->tm_min);
       g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
+      format_uint32_2digits(target, tm->tm_sec);
       break;
     case TS_FMT_UNIX:
       format_uint32_padded(target, 0, 0, 10, (int) stamp->tv_sec);
       log_stamp_append_frac_digits(stamp, target, frac_digits);
-      break;
+      return;
     default:
       g_assert_not_reached();
       break;
     }
+
+  if (target->len - body_ofs <= sizeof(cached->buf))
+    {
+      cached->when = t;
+      cached->zone_offset = target_zone_offset;
+      cached->len = target->len - body_ofs;
+      memcpy(cached->buf, target->str + body_ofs, cached->len);
+    }
+
+ append_suffix:
+  log_stamp_append_frac_digits(stamp, target, frac_digits);
+  if (ts_format == TS_FMT_ISO)
+    {
+      format_zone_info(buf, sizeof(buf), target_zone_offset);
+      g_string_append(target, buf);
+    }
 }
 
 void
@@ -134,10 +134,39 @@ _disconnect_and_suspend(LogThrDestDriver *self)
 {
   self->suspended = TRUE;
   __disconnect(self);
+  if (self->queued_messages > 0)
+    {
+      /* messages already written to the now closed connection were never
+       * confirmed, resend them after reconnecting */
+      log_queue_rewind_backlog(self->queue, self->queued_messages);
+      self->queued_messages = 0;
+    }
   log_queue_reset_parallel_push(self->queue);
   log_threaded_dest_driver_suspend(self);
 }
 
+static void
+log_threaded_dest_driver_flush_queued(LogThrDestDriver *self)
+{
+  worker_insert_result_t result;
+
+  if (self->queued_messages == 0)
+    return;
+
+  result = self->worker.flush ? self->worker.flush(self) : WORKER_INSERT_RESULT_SUCCESS;
+  if (result == WORKER_INSERT_RESULT_SUCCESS)
+    {
+      log_queue_ack_backlog(self->queue, self->queued_messages);
+      self->queued_messages = 0;
+      self->retries.counter = 0;
+    }
+  else
+    {
+      self->retries.counter++;
+      _disconnect_and_suspend(self);
+    }
+}
+
 static void
 log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
 {
@@ -189,6 +218,16 @@ log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
           log_threaded_dest_driver_message_accept(self, msg);
           break;
 
+        case WORKER_INSERT_RESULT_QUEUED:
+          /* the backlog reference keeps the message alive until the flush
+           * confirms or rewinds it */
+          self->queued_messages++;
+          step_sequence_number(&self->seq_num);
+          log_msg_unref(msg);
+          if (self->queued_messages >= self->pipeline_depth)
+            log_threaded_dest_driver_flush_queued(self);
+          break;
+
         default:
           break;
         }
@@ -196,6 +235,10 @@ log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
       msg_set_context(NULL);
       log_msg_refcache_stop();
     }
+  if (!self->suspended)
+    {
+      log_threaded_dest_driver_flush_queued(self);
+    }
   if (!self->suspended)
     {
       if (self->worker.worker_message_queue_empty)
@@ -303,9 +346,189 @@ log_threaded_dest_driver_stop_thread(gpointer s)
   iv_event_post(&self->shutdown_event);
 }
 
+/* Shared worker pool: instead of a dedicated thread per driver, drivers are
+ * assigned round-robin to a bounded set of threads, each running its own
+ * ivykis loop.  All watches of a driver are registered on its assigned
+ * thread, so the per-driver serialization guarantees of the dedicated
+ * thread model are retained, and iv_event coalesces wakeups posted while
+ * the loop is busy draining other drivers. */
+
+typedef struct _LogThrDestWorkerPoolThread
+{
+  struct iv_event attach_event;
+  struct iv_event shutdown_event;
+  /* protects pending_attach and loop_running */
+  GStaticMutex lock;
+  GList *pending_attach;
+  /* attached drivers, only touched from the pool thread */
+  GList *drivers;
+  gboolean started;
+  gboolean loop_running;
+  WorkerOptions worker_options;
+} LogThrDestWorkerPoolThread;
+
+static LogThrDestWorkerPoolThread pool_threads[MAIN_LOOP_MAX_WORKER_THREADS];
+static gint pool_size;
+static gint pool_next_slot;
+
+static void
+log_threaded_dest_worker_pool_thread_attach_pending(gpointer arg)
+{
+  LogThrDestWorkerPoolThread *pt = (LogThrDestWorkerPoolThread *) arg;
+  GList *pending, *l;
+
+  g_static_mutex_lock(&pt->lock);
+  pending = pt->pending_attach;
+  pt->pending_attach = NULL;
+  g_static_mutex_unlock(&pt->lock);
+
+  for (l = pending; l; l = l->next)
+    {
+      LogThrDestDriver *self = (LogThrDestDriver *) l->data;
+
+      pt->drivers = g_list_append(pt->drivers, self);
+
+      msg_debug("Driver attached to pooled worker thread",
+                evt_tag_str("driver", self->super.super.id),
+                NULL);
+
+      log_queue_set_use_backlog(self->queue, TRUE);
+      log_threaded_dest_driver_init_watches(self);
+      log_threaded_dest_driver_start_watches(self);
+
+      if (self->worker.thread_init)
+        self->worker.thread_init(self);
+    }
+  g_list_free(pending);
+}
+
 static void
-log_threaded_dest_driver_start_thread(LogThrDestDriver *self)
+log_threaded_dest_worker_pool_thread_shutdown(gpointer arg)
 {
+  LogThrDestWorkerPoolThread *pt = (LogThrDestWorkerPoolThread *) arg;
+  GList *l;
+
+  for (l = pt->drivers; l; l = l->next)
+    {
+      LogThrDestDriver *self = (LogThrDestDriver *) l->data;
+
+      log_threaded_dest_driver_stop_watches(self);
+      iv_event_unregister(&self->wake_up_event);
+      iv_event_unregister(&self->shutdown_event);
+      __disconnect(self);
+      if (self->worker.thread_deinit)
+        self->worker.thread_deinit(self);
+    }
+  g_list_free(pt->drivers);
+  pt->drivers = NULL;
+
+  g_static_mutex_lock(&pt->lock);
+  pt->loop_running = FALSE;
+  pt->started = FALSE;
+  g_static_mutex_unlock(&pt->lock);
+
+  iv_quit();
+}
+
+static void
+log_threaded_dest_worker_pool_thread_main(gpointer arg)
+{
+  LogThrDestWorkerPoolThread *pt = (LogThrDestWorkerPoolThread *) arg;
+
+  iv_init();
+
+  msg_debug("Pooled worker thread started", NULL);
+
+  IV_EVENT_INIT(&pt->attach_event);
+  pt->attach_event.cookie = pt;
+  pt->attach_event.handler = log_threaded_dest_worker_pool_thread_attach_pending;
+  iv_event_register(&pt->attach_event);
+
+  IV_EVENT_INIT(&pt->shutdown_event);
+  pt->shutdown_event.cookie = pt;
+  pt->shutdown_event.handler = log_threaded_dest_worker_pool_thread_shutdown;
+  iv_event_register(&pt->shutdown_event);
+
+  g_static_mutex_lock(&pt->lock);
+  pt->loop_running = TRUE;
+  g_static_mutex_unlock(&pt->lock);
+
+  /* drivers attached before the loop came up */
+  log_threaded_dest_worker_pool_thread_attach_pending(pt);
+
+  iv_main();
+
+  iv_event_unregister(&pt->attach_event);
+  iv_event_unregister(&pt->shutdown_event);
+
+  msg_debug("Pooled worker thread finished", NULL);
+  iv_deinit();
+}
+
+static void
+log_threaded_dest_worker_pool_thread_stop(gpointer arg)
+{
+  LogThrDestWorkerPoolThread *pt = (LogThrDestWorkerPoolThread *) arg;
+
+  iv_event_post(&pt->shutdown_event);
+}
+
+static void
+log_threaded_dest_worker_pool_attach(LogThrDestDriver *self)
+{
+  LogThrDestWorkerPoolThread *pt;
+  gboolean loop_running;
+
+  /* pool_size may have shrunk on reload, the modulo keeps stale slot
+   * numbers in range */
+  pt = &pool_threads[pool_next_slot % pool_size];
+  pool_next_slot = (pool_next_slot + 1) % pool_size;
+
+  if (!pt->started)
+    {
+      pt->started = TRUE;
+      pt->worker_options.is_output_thread = TRUE;
+      main_loop_create_worker_thread(log_threaded_dest_worker_pool_thread_main,
+                                     log_threaded_dest_worker_pool_thread_stop,
+                                     pt, &pt->worker_options);
+    }
+
+  g_static_mutex_lock(&pt->lock);
+  pt->pending_attach = g_list_append(pt->pending_attach, self);
+  loop_running = pt->loop_running;
+  g_static_mutex_unlock(&pt->lock);
+
+  /* if the loop is not yet running, the thread picks up the pending list on
+   * its own right after registering the attach event */
+  if (loop_running)
+    iv_event_post(&pt->attach_event);
+}
+
+static void
+log_threaded_dest_worker_pool_init(void)
+{
+  static gboolean pool_initialized = FALSE;
+  gint i;
+
+  if (pool_initialized)
+    return;
+  pool_initialized = TRUE;
+
+  for (i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    g_static_mutex_init(&pool_threads[i].lock);
+}
+
+static void
+log_threaded_dest_driver_start_thread(LogThrDestDriver *self, GlobalConfig *cfg)
+{
+  if (cfg->dest_worker_pool_size > 0)
+    {
+      log_threaded_dest_worker_pool_init();
+      pool_size = MIN(cfg->dest_worker_pool_size, MAIN_LOOP_MAX_WORKER_THREADS);
+      log_threaded_dest_worker_pool_attach(self);
+      return;
+    }
+
   main_loop_create_worker_thread(log_threaded_dest_driver_worker_thread_main,
                                  log_threaded_dest_driver_stop_thread,
                                  self, &self->worker_options);
@@ -358,7 +581,7 @@ log_threaded_dest_driver_start(LogPipe *s)
   if (!self->seq_num)
     init_sequence_number(&self->seq_num);
 
-  log_threaded_dest_driver_start_thread(self);
+  log_threaded_dest_driver_start_thread(self, cfg);
 
   return TRUE;
 }
@@ -466,6 +689,14 @@ log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
   log_msg_unref(msg);
 }
 
+void
+log_threaded_dest_driver_set_pipeline_depth(LogDriver *s, gint pipeline_depth)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->pipeline_depth = pipeline_depth;
+}
+
 void
 log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries)
 {
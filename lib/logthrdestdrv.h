@@ -39,7 +39,10 @@ typedef enum
   WORKER_INSERT_RESULT_ERROR,
   WORKER_INSERT_RESULT_REWIND,
   WORKER_INSERT_RESULT_SUCCESS,
-  WORKER_INSERT_RESULT_NOT_CONNECTED
+  WORKER_INSERT_RESULT_NOT_CONNECTED,
+  /* the message was written to the peer but its confirmation is deferred
+   * until the next worker.flush() call, see pipeline_depth */
+  WORKER_INSERT_RESULT_QUEUED
 } worker_insert_result_t;
 
 typedef struct _LogThrDestDriver LogThrDestDriver;
@@ -63,6 +66,9 @@ struct _LogThrDestDriver
     void (*thread_init) (LogThrDestDriver *s);
     void (*thread_deinit) (LogThrDestDriver *s);
     worker_insert_result_t (*insert) (LogThrDestDriver *s, LogMessage *msg);
+    /* confirm the messages inserted with WORKER_INSERT_RESULT_QUEUED since
+     * the last flush, may only return SUCCESS or ERROR */
+    worker_insert_result_t (*flush) (LogThrDestDriver *s);
     gboolean (*connect) (LogThrDestDriver *s);
     void (*worker_message_queue_empty)(LogThrDestDriver *s);
     void (*disconnect) (LogThrDestDriver *s);
@@ -81,6 +87,14 @@ struct _LogThrDestDriver
   gint stats_source;
   gint32 seq_num;
 
+  /* number of messages inserted with WORKER_INSERT_RESULT_QUEUED that are
+   * not yet confirmed by the peer; they are retained on the queue backlog
+   * until worker.flush() succeeds */
+  gint queued_messages;
+  /* worker.flush() is invoked once this many messages are queued, values
+   * below 2 keep the driver synchronous */
+  gint pipeline_depth;
+
   struct
   {
     gint counter;
@@ -112,5 +126,6 @@ void log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
                                              LogMessage *msg);
 
 void log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries);
+void log_threaded_dest_driver_set_pipeline_depth(LogDriver *s, gint pipeline_depth);
 
 #endif
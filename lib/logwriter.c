@@ -23,6 +23,7 @@
  */
   
 #include "logwriter.h"
+#include "driver.h"
 #include "messages.h"
 #include "stats/stats-registry.h"
 #include "hostname.h"
@@ -32,7 +33,10 @@
 #include "mainloop-io-worker.h"
 #include "mainloop-call.h"
 #include "ml-batched-timer.h"
+#include "ringbuffer.h"
+#include "serialize.h"
 #include "str-format.h"
+#include "timeutils.h"
 
 #include <unistd.h>
 #include <assert.h>
@@ -44,6 +48,10 @@
 #include <iv_event.h>
 #include <iv_work.h>
 
+/* number of power-of-two microsecond buckets in the per-destination
+ * latency histograms, the last bucket is open ended */
+#define LOG_WRITER_LATENCY_HIST_BUCKETS 24
+
 typedef enum
 {
   /* flush modes */
@@ -54,6 +62,18 @@ typedef enum
   LW_FLUSH_FORCE,
 } LogWriterFlushMode;
 
+/* a slot of the parallel formatting ring: filled by the flush thread,
+ * formatted by one of the format threads, drained by the flush thread in
+ * submission order */
+typedef struct _LogWriterFormatCell
+{
+  LogMessage *msg;
+  LogPathOptions path_options;
+  GString *line;
+  gint32 seq_num;
+  gboolean done;
+} LogWriterFormatCell;
+
 struct _LogWriter
 {
   LogPipe super;
@@ -63,12 +83,36 @@ struct _LogWriter
   StatsCounterItem *dropped_messages;
   StatsCounterItem *suppressed_messages;
   StatsCounterItem *processed_messages;
+  StatsCounterShards *processed_messages_shards;
   StatsCounterItem *stored_messages;
+  /* latency histograms fed by messages stamped at the source when
+   * latency-sample-freq() is set: queue time measured when the message
+   * leaves our queue, total time measured when the proto consumed it */
+  StatsCounterItem *latency_queue_hist[LOG_WRITER_LATENCY_HIST_BUCKETS];
+  StatsCounterItem *latency_total_hist[LOG_WRITER_LATENCY_HIST_BUCKETS];
   LogPipe *control;
   LogWriterOptions *options;
   LogMessage *last_msg;
   guint32 last_msg_count;
-  GString *line_buffer;
+  /* digest of the suppress()-compared fields of last_msg, checked before
+   * the string comparisons so non-repeated traffic gets away with a
+   * single integer compare under suppress_lock */
+  guint64 last_msg_digest;
+  /* pooled formatting buffers for the gather write flush path, lazily
+   * allocated, one per batch slot */
+  GString *batch_line_buffers[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+  /* high watermark of formatted line lengths, newly allocated line
+   * buffers start at this size so they don't grow through several
+   * reallocs during warmup; updated racily by the format threads, a
+   * lost update only costs an extra realloc */
+  gint line_size_hint;
+  /* bytes kept free at the front of each formatted line for the proto's
+   * per-message header, mirrors the proto's post_header_reserve value so
+   * the format threads don't have to dereference the proto */
+  gsize proto_header_reserve;
+  /* the proto transmits serialized messages (binary relay mode), mirrors
+   * the proto's post_serialized_payload flag */
+  gboolean proto_serialized_payload;
 
   gint stats_level;
   guint16 stats_source;
@@ -84,13 +128,43 @@ struct _LogWriter
   MlBatchedTimer suppress_timer;
   MlBatchedTimer mark_timer;
   struct iv_timer reopen_timer;
+  /* adaptive retry delay for the suspend/reopen timers plus whether we
+   * hold one of the global reconnect slots (see driver.h) */
+  LogDriverReconnect reconnect;
+  gboolean reconnect_slot_held;
   gboolean work_result;
+  /* current adaptive spin window in microseconds, bounded by the
+   * spin-timeout() option; grown when spinning picks up work, shrunk when
+   * it expires empty */
+  gint spin_window_usec;
+  /* adaptive batching controller, active when flush-target-latency() is
+   * set: drain rate and per-flush cost estimates are maintained by the
+   * flush thread around each proto post and read racily by the main
+   * thread when scheduling; a stale value only misplaces a single wait */
+  gdouble batch_arrival_rate;      /* messages per millisecond, EWMA */
+  gdouble batch_drain_time;        /* milliseconds per proto post, EWMA */
+  GTimeVal batch_last_flush;
+  gint batch_msgs_since_update;
+  gint batch_target;               /* batch size currently aimed for */
+  StatsCounterItem *batch_size_counter;
   gint pollable_state;
   LogProtoClient *proto, *pending_proto;
   gboolean watches_running:1, suspended:1, working:1, waiting_for_throttle:1;
   gboolean pending_proto_present;
   GCond *pending_proto_cond;
   GStaticMutex pending_proto_lock;
+
+  /* parallel formatting stage, active when format_threads() > 1.  The
+   * flush thread pushes popped messages into format_ring, the format
+   * threads claim and format them concurrently, and the continual range
+   * of completed cells at the tail is released to the proto in order. */
+  RingBuffer format_ring;
+  GThread **format_thread_ids;
+  guint32 format_claim_offset;
+  gboolean format_quit;
+  GCond *format_request_cond;
+  GCond *format_done_cond;
+  GStaticMutex format_lock;
 };
 
 /**
@@ -122,6 +196,7 @@ static void log_writer_start_watches(LogWriter *self);
 static void log_writer_stop_watches(LogWriter *self);
 static void log_writer_update_watches(LogWriter *self);
 static void log_writer_suspend(LogWriter *self);
+static void log_writer_arm_suspend_timer(LogWriter *self, void (*handler)(void *), gint timeout_msec);
 static void log_writer_free_proto(LogWriter *self);
 static void log_writer_set_proto(LogWriter *self, LogProtoClient *proto);
 static void log_writer_set_pending_proto(LogWriter *self, LogProtoClient *proto, gboolean present);
@@ -174,6 +249,46 @@ log_writer_set_queue(LogWriter *s, LogQueue *queue)
   log_queue_set_use_backlog(self->queue, TRUE);
 }
 
+/* Spin on the queue length for a short while after draining it instead of
+ * parking right away: parking costs a futex round trip through
+ * iv_event_post() and the main loop for every wakeup, which dominates at
+ * high message rates.  The spin window adapts to the observed arrival
+ * pattern: it is doubled whenever spinning picked up work within the
+ * window and halved whenever the window expired empty, bounded by the
+ * spin-timeout() option.  Runs in the flush thread while the writer's
+ * watches are stopped, so flushing from here is safe. */
+static void
+log_writer_spin_for_more_work(LogWriter *self)
+{
+  GTimeVal start, now;
+  glong elapsed;
+
+  if (self->spin_window_usec == 0)
+    self->spin_window_usec = 1;
+
+  for (;;)
+    {
+      g_get_current_time(&start);
+      while (log_queue_get_length(self->queue) == 0)
+        {
+          g_get_current_time(&now);
+          elapsed = (now.tv_sec - start.tv_sec) * G_USEC_PER_SEC + (now.tv_usec - start.tv_usec);
+          if (elapsed >= self->spin_window_usec)
+            {
+              /* arrivals are sparser than the spin window, shrink it and
+               * fall back to the parked wakeup path */
+              self->spin_window_usec = MAX(self->spin_window_usec / 2, 1);
+              return;
+            }
+        }
+
+      self->spin_window_usec = MIN(self->spin_window_usec * 2, self->options->spin_timeout);
+      self->work_result = log_writer_flush(self, LW_FLUSH_NORMAL);
+      if (!self->work_result)
+        return;
+    }
+}
+
 static void
 log_writer_work_perform(gpointer s)
 {
@@ -181,6 +296,18 @@ log_writer_work_perform(gpointer s)
 
   g_assert((self->super.flags & PIF_INITIALIZED) != 0);
   self->work_result = log_writer_flush(self, LW_FLUSH_NORMAL);
+  if (self->work_result && self->options->spin_timeout > 0)
+    log_writer_spin_for_more_work(self);
+}
+
+static void
+log_writer_release_reconnect_slot(LogWriter *self)
+{
+  if (self->reconnect_slot_held)
+    {
+      self->reconnect_slot_held = FALSE;
+      log_driver_reconnect_slot_release();
+    }
 }
 
 static void
@@ -191,6 +318,10 @@ log_writer_work_finished(gpointer s)
   main_loop_assert_main_thread();
   self->waiting_for_throttle = FALSE;
 
+  /* whatever the outcome, the reconnect attempt this work item belonged
+   * to is over, let the next waiting writer have a go */
+  log_writer_release_reconnect_slot(self);
+
   if (self->pending_proto_present)
     {
       /* pending proto is only set in the main thread, so no need to
@@ -224,6 +355,8 @@ log_writer_work_finished(gpointer s)
 
   if ((self->super.flags & PIF_INITIALIZED) && self->proto)
     {
+      if (self->reconnect.failures)
+        log_driver_reconnect_reset(&self->reconnect);
       /* reenable polling the source, but only if we're still initialized */
       log_writer_start_watches(self);
     }
@@ -302,6 +435,15 @@ log_writer_error_suspend_elapsed(gpointer s)
 {
   LogWriter *self = (LogWriter *) s;
 
+  if (!log_driver_reconnect_slot_acquire())
+    {
+      /* too many writers are retrying right now, stay suspended for a
+       * little longer so the destination is not stampeded */
+      log_writer_arm_suspend_timer(self, log_writer_error_suspend_elapsed, log_driver_reconnect_slot_retry_msec());
+      return;
+    }
+  self->reconnect_slot_held = TRUE;
+
   self->suspended = FALSE;
   msg_notice("Error suspend timeout has elapsed, attempting to write again",
              evt_tag_int("fd", log_proto_client_get_fd(self->proto)),
@@ -414,31 +556,123 @@ static void
 log_writer_suspend(LogWriter *self)
 {
   /* flush code indicates that we need to suspend our writing activities
-   * until time_reopen elapses */
+   * until time_reopen elapses; the delay starts at time_reopen() and
+   * backs off exponentially (with jitter) while the errors persist */
 
-  log_writer_arm_suspend_timer(self, log_writer_error_suspend_elapsed, self->options->time_reopen * 1e3);
+  log_writer_arm_suspend_timer(self, log_writer_error_suspend_elapsed,
+                               log_driver_reconnect_next_delay_msec(&self->reconnect, self->options->time_reopen));
   self->suspended = TRUE;
 }
 
+/* Update the estimates driving the adaptive batching controller after a
+ * proto post consumed @num_consumed messages.  The drain rate stands in
+ * for the arrival rate: the two are equal whenever the queue is bounded,
+ * and overestimating during a backlog drain only makes the controller
+ * batch harder, which is what a backlog calls for anyway.  Runs in the
+ * flush thread. */
+static void
+log_writer_batch_note_flush(LogWriter *self, gint num_consumed, GTimeVal *flush_start, GTimeVal *flush_end)
+{
+  gdouble drain_msec, interval_msec, rate, target;
+
+  self->batch_msgs_since_update += num_consumed;
+  if (self->batch_last_flush.tv_sec == 0)
+    {
+      self->batch_last_flush = *flush_end;
+      self->batch_msgs_since_update = 0;
+      return;
+    }
+
+  drain_msec = g_time_val_diff(flush_end, flush_start) / 1000.0;
+  self->batch_drain_time += (drain_msec - self->batch_drain_time) / 8;
+
+  /* rate samples are only taken once at least a millisecond has passed,
+   * so a burst of back-to-back flushes cannot produce wild samples */
+  interval_msec = g_time_val_diff(flush_end, &self->batch_last_flush) / 1000.0;
+  if (interval_msec < 1)
+    return;
+
+  rate = self->batch_msgs_since_update / interval_msec;
+  self->batch_arrival_rate += (rate - self->batch_arrival_rate) / 8;
+  self->batch_last_flush = *flush_end;
+  self->batch_msgs_since_update = 0;
+
+  /* aim for the number of messages expected to arrive within the latency
+   * budget left over after the flush itself */
+  target = self->batch_arrival_rate * (self->options->flush_target_latency - self->batch_drain_time);
+  self->batch_target = CLAMP((gint) target, 1, LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES);
+  stats_counter_set(self->batch_size_counter, self->batch_target);
+}
+
+/* Decide whether a flush should be deferred to let a fuller batch
+ * accumulate.  Called from the scheduling path when messages are already
+ * available; the returned wait is bounded so the messages already queued
+ * still leave within flush-target-latency().  Runs in the main thread. */
+static gboolean
+log_writer_batch_should_wait(LogWriter *self, gint *wait_msec)
+{
+  gint batch_target = self->batch_target;
+  gdouble budget, needed;
+  gint64 pending;
+
+  if (self->options->flush_target_latency <= 0 || batch_target <= 1)
+    return FALSE;
+
+  pending = log_queue_get_length(self->queue);
+  if (pending >= batch_target)
+    return FALSE;
+
+  /* leave room for the estimated drain cost within the latency budget */
+  budget = self->options->flush_target_latency - self->batch_drain_time;
+  if (self->batch_arrival_rate > 0)
+    {
+      needed = (batch_target - pending) / self->batch_arrival_rate;
+      if (needed < budget)
+        budget = needed;
+    }
+  if (budget < 1)
+    return FALSE;
+
+  *wait_msec = (gint) budget;
+  return TRUE;
+}
+
 static void
 log_writer_update_watches(LogWriter *self)
 {
   gint fd;
   GIOCondition cond = 0;
   gint timeout_msec = 0;
+  gint batch_wait_msec = 0;
 
   main_loop_assert_main_thread();
 
   /* NOTE: we either start the suspend_timer or enable the fd_watch. The two MUST not happen at the same time. */
 
-  if (log_proto_client_prepare(self->proto, &fd, &cond) ||
-      self->waiting_for_throttle ||
-      log_queue_check_items(self->queue, &timeout_msec,
-                            (LogQueuePushNotifyFunc) log_writer_schedule_update_watches, self, NULL))
+  if (log_proto_client_prepare(self->proto, &fd, &cond))
     {
-      /* flush_lines number of element is already available and throttle would permit us to send. */
+      /* the proto asked for I/O of its own accord (e.g. a partial write
+       * or a handshake in progress), batching must not delay that */
       log_writer_update_fd_callbacks(self, cond);
     }
+  else if (self->waiting_for_throttle ||
+           log_queue_check_items(self->queue, &timeout_msec,
+                                 (LogQueuePushNotifyFunc) log_writer_schedule_update_watches, self, NULL))
+    {
+      /* flush_lines number of element is already available and throttle would permit us to send. */
+      if (!self->waiting_for_throttle && log_writer_batch_should_wait(self, &batch_wait_msec))
+        {
+          /* messages are available but fewer than the adaptive batch
+           * size; wait for more to accumulate.  The timer bounds the
+           * wait and waiting_for_throttle makes the pass it triggers
+           * flush whatever is queued by then. */
+          log_writer_update_fd_callbacks(self, 0);
+          self->waiting_for_throttle = TRUE;
+          log_writer_arm_suspend_timer(self, (void (*)(void *)) log_writer_update_watches, batch_wait_msec);
+        }
+      else
+        log_writer_update_fd_callbacks(self, cond);
+    }
   else if (timeout_msec)
     {
       /* few elements are available, but less than flush_lines, we need to start a timer to initiate a flush */
@@ -539,6 +773,7 @@ log_writer_record_last_message(LogWriter *self, LogMessage *lm)
 
   log_msg_ref(lm);
   self->last_msg = lm;
+  self->last_msg_digest = log_msg_get_suppress_digest(lm);
   self->last_msg_count = 0;
 }
 
@@ -552,6 +787,7 @@ log_writer_release_last_message(LogWriter *self)
     log_msg_unref(self->last_msg);
 
   self->last_msg = NULL;
+  self->last_msg_digest = 0;
   self->last_msg_count = 0;
 }
 
@@ -692,14 +928,21 @@ log_writer_is_msg_suppressed(LogWriter *self, LogMessage *lm)
 {
   gboolean need_to_arm_suppress_timer;
   gboolean need_to_cancel_suppress_timer = FALSE;
+  guint64 msg_digest;
 
   if (self->options->suppress <= 0)
     return FALSE;
 
+  /* computing (and caching) the digest needs no lock, so the string
+   * comparisons under suppress_lock only run for messages whose digest
+   * already matches the recorded one */
+  msg_digest = log_msg_get_suppress_digest(lm);
+
   g_static_mutex_lock(&self->suppress_lock);
   if (self->last_msg)
     {
-      if (_is_time_within_the_suppress_timeout(self, lm) &&
+      if (msg_digest == self->last_msg_digest &&
+          _is_time_within_the_suppress_timeout(self, lm) &&
           _is_message_a_repetition(lm, self->last_msg) &&
           !_is_message_a_mark(lm))
         {
@@ -771,7 +1014,7 @@ log_writer_mark_timeout(void *cookie)
   if (!log_writer_is_msg_suppressed(self, msg))
     {
       log_queue_push_tail(self->queue, msg, &path_options);
-      stats_counter_inc(self->processed_messages);
+      stats_counter_shards_inc(self->processed_messages_shards);
     }
   else
     {
@@ -823,7 +1066,7 @@ log_writer_queue(LogPipe *s, LogMessage *lm, const LogPathOptions *path_options,
       log_writer_postpone_mark_timer(self);
     }
 
-  stats_counter_inc(self->processed_messages);
+  stats_counter_shards_inc(self->processed_messages_shards);
   log_queue_push_tail(self->queue, lm, path_options);
 }
 
@@ -874,20 +1117,64 @@ log_writer_do_padding(LogWriter *self, GString *result)
   memset(result->str + len - 1, '\0', padd_bytes);
 }
 
-void
-log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
+/* NOTE: the sequence number of local messages is passed in explicitly, so
+ * that the format threads can use the value captured when the message was
+ * popped off the queue, instead of the live counter */
+static void
+log_writer_do_format_log(LogWriter *self, LogMessage *lm, gint32 local_seq_num, GString *result)
 {
   LogTemplate *template = NULL;
   LogStamp *stamp;
   guint32 seq_num;
   static NVHandle meta_seqid = 0;
 
+  /* binary relay mode: the proto transmits the serialized form of the
+   * message, the template machinery is bypassed entirely and the frame
+   * payload is produced by log_msg_write(); padding and the multi-line
+   * options make no sense on binary frames and are skipped */
+  if (G_UNLIKELY(self->proto_serialized_payload))
+    {
+      SerializeArchive *sa;
+
+      g_string_set_size(result, self->proto_header_reserve);
+      sa = serialize_string_archive_new(result);
+      log_msg_write(lm, sa);
+      serialize_archive_free(sa);
+      if (result->len > self->line_size_hint)
+        self->line_size_hint = result->len;
+      return;
+    }
+
+  /* passthrough fast path: our owner driver is only referenced from
+   * flags(passthrough) log statements (see
+   * cfg_tree_compile_passthrough_marks()) and this message still holds
+   * the frame exactly as it was received, so it is forwarded verbatim
+   * without running the template machinery.  An explicit template or
+   * syslog-protocol framing takes precedence. */
+  if (G_UNLIKELY(self->control && (self->control->flags & PIF_PASSTHROUGH)) &&
+      (lm->flags & LF_RAW_FRAME) &&
+      !self->options->template &&
+      !(self->flags & LW_SYSLOG_PROTOCOL) && !(self->options->options & LWO_SYSLOG_PROTOCOL))
+    {
+      const gchar *p;
+      gssize len;
+
+      /* formatting starts past the space reserved for the proto's
+       * per-message header, see post_header_reserve */
+      g_string_set_size(result, self->proto_header_reserve);
+      p = log_msg_get_value(lm, LM_V_MESSAGE, &len);
+      g_string_append_len(result, p, len);
+      g_string_append_c(result, '\n');
+      log_writer_do_padding(self, result);
+      return;
+    }
+
   if (!meta_seqid)
     meta_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
 
   if (lm->flags & LF_LOCAL)
     {
-      seq_num = self->seq_num;
+      seq_num = local_seq_num;
     }
   else
     {
@@ -905,7 +1192,7 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
   /* no template was specified, use default */
   stamp = &lm->timestamps[LM_TS_STAMP];
 
-  g_string_truncate(result, 0);
+  g_string_set_size(result, self->proto_header_reserve);
 
   if ((self->flags & LW_SYSLOG_PROTOCOL) || (self->options->options & LWO_SYSLOG_PROTOCOL))
     {
@@ -983,11 +1270,14 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
       
       if (template)
         {
-          log_template_format(template, lm, 
-                              &self->options->template_options,
-                              LTZ_SEND,
-                              seq_num, NULL,
-                              result);
+          /* shared templates of mirrored destinations have a result cache
+           * attached, the first writer formats and the others reuse; the
+           * append variant keeps the reserved header bytes in place */
+          log_template_append_format_cached(template, lm,
+                                            &self->options->template_options,
+                                            LTZ_SEND,
+                                            seq_num, NULL,
+                                            result);
 
         }
       else 
@@ -1049,7 +1339,7 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
     {
       gchar *p;
 
-      p = result->str;
+      p = result->str + self->proto_header_reserve;
       /* NOTE: the size is calculated to leave trailing new line */
       while ((p = find_cr_or_lf(p, result->str + result->len - p - 1)))
         {
@@ -1058,21 +1348,22 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
         }
 
     }
+
+  if (result->len > self->line_size_hint)
+    self->line_size_hint = result->len;
 }
 
-static void
-log_writer_broken(LogWriter *self, gint notify_code)
+void
+log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
 {
-  log_writer_stop_watches(self);
-  log_pipe_notify(self->control, notify_code, self);
+  log_writer_do_format_log(self, lm, self->seq_num, result);
 }
 
 static void
-log_writer_realloc_line_buffer(LogWriter *self)
+log_writer_broken(LogWriter *self, gint notify_code)
 {
-  self->line_buffer->str = g_malloc(self->line_buffer->allocated_len);
-  self->line_buffer->str[0] = 0;
-  self->line_buffer->len = 0;
+  log_writer_stop_watches(self);
+  log_pipe_notify(self->control, notify_code, self);
 }
 
 /*
@@ -1098,91 +1389,434 @@ log_writer_flush_finalize(LogWriter *self)
   return TRUE;
 }
 
-gboolean
-log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_options, gboolean *write_error)
+/* record the elapsed time since the source stamped this message into one
+ * of the latency histograms; called for the few sampled messages only, so
+ * the gettimeofday() cost is negligible */
+static void
+log_writer_record_latency(LogWriter *self, LogMessage *msg, StatsCounterItem **hist)
+{
+  GTimeVal now;
+  guint64 delta;
+  gint bucket;
+
+  g_get_current_time(&now);
+  delta = (guint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec - msg->latency_stamp;
+  for (bucket = 0; bucket < LOG_WRITER_LATENCY_HIST_BUCKETS - 1; bucket++)
+    {
+      if (delta <= ((guint64) 1 << bucket))
+        break;
+    }
+  stats_counter_inc(hist[bucket]);
+}
+
+static inline LogMessage *
+log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
 {
-  gboolean consumed = FALSE;
+  LogMessage *msg;
+
+  if (force_flush)
+    msg = log_queue_pop_head_ignore_throttle(self->queue, path_options);
+  else
+    msg = log_queue_pop_head(self->queue, path_options);
+
+  if (msg && G_UNLIKELY(msg->latency_stamp))
+    log_writer_record_latency(self, msg, self->latency_queue_hist);
+  return msg;
+}
+
+/*
+ * Drain up to LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES messages from the
+ * queue, format each into a pooled line buffer and submit them as a
+ * single batch, which stream protos turn into one writev() call.
+ * Messages not consumed by the proto are rewound to the backlog and
+ * re-formatted on the next attempt.  Returns whether the flush loop
+ * should keep going.
+ */
+static gboolean
+log_writer_write_message_batch(LogWriter *self, LogWriterFlushMode flush_mode, gboolean *write_error)
+{
+  LogMessage *msgs[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+  LogProtoClientBatchEntry entries[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+  LogProtoStatus status;
+  GTimeVal flush_start, flush_end;
+  gint num_msgs = 0;
+  gint num_consumed = 0;
+  gint i;
 
   *write_error = FALSE;
 
-  log_msg_refcache_start_consumer(msg, path_options);
-  msg_set_context(msg);
+  while (num_msgs < LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_writer_queue_pop_message(self, &path_options, flush_mode == LW_FLUSH_FORCE);
+      GString *line;
 
-  log_writer_format_log(self, msg, self->line_buffer);
+      if (!msg)
+        break;
+
+      if (!self->batch_line_buffers[num_msgs])
+        self->batch_line_buffers[num_msgs] = g_string_sized_new(MAX(128, self->line_size_hint));
+      line = self->batch_line_buffers[num_msgs];
+
+      log_msg_refcache_start_consumer(msg, &path_options);
+      msg_set_context(msg);
+
+      log_writer_format_log(self, msg, line);
+
+      if (!(msg->flags & LF_INTERNAL))
+        {
+          msg_debug("Outgoing message",
+                evt_tag_str("message", line->str + self->proto_header_reserve),
+                NULL);
+        }
 
-  if (!(msg->flags & LF_INTERNAL))
+      msg_set_context(NULL);
+      log_msg_refcache_stop();
+
+      if (line->len <= self->proto_header_reserve)
+        {
+          msg_debug("Error posting log message as template() output resulted in an empty string, skipping message",
+                    NULL);
+          if (msg->flags & LF_LOCAL)
+            step_sequence_number(&self->seq_num);
+          log_msg_unref(msg);
+          continue;
+        }
+
+      /* the sequence number is stepped at formatting time so that each
+       * message of the batch gets its own, it is rolled back below for
+       * messages the proto did not consume */
+      if (msg->flags & LF_LOCAL)
+        step_sequence_number(&self->seq_num);
+
+      msgs[num_msgs] = msg;
+      entries[num_msgs].msg = (guchar *) line->str;
+      entries[num_msgs].msg_len = line->len;
+      num_msgs++;
+    }
+
+  if (num_msgs == 0)
+    return FALSE;
+
+  if (self->options->flush_target_latency > 0)
+    g_get_current_time(&flush_start);
+  status = log_proto_client_post_batch(self->proto, entries, num_msgs, &num_consumed);
+
+  if (status == LPS_ERROR)
     {
-      msg_debug("Outgoing message",
-            evt_tag_str("message",self->line_buffer->str),
-            NULL);
+      if ((self->options->options & LWO_IGNORE_ERRORS) != 0)
+        num_consumed = num_msgs;
+      else
+        *write_error = TRUE;
     }
 
-  if (self->line_buffer->len)
+  if (self->options->flush_target_latency > 0)
     {
-      LogProtoStatus status = log_proto_client_post(self->proto, (guchar *)self->line_buffer->str, self->line_buffer->len, &consumed);
+      g_get_current_time(&flush_end);
+      log_writer_batch_note_flush(self, num_consumed, &flush_start, &flush_end);
+    }
 
-      if (consumed)
-        log_writer_realloc_line_buffer(self);
+  if (num_consumed < num_msgs)
+    {
+      gint rollback = 0;
 
-      if (status == LPS_ERROR)
+      for (i = num_consumed; i < num_msgs; i++)
         {
-          if ((self->options->options & LWO_IGNORE_ERRORS) != 0)
-            {
-              if (!consumed)
-                {
-                  g_free(self->line_buffer->str);
-                  log_writer_realloc_line_buffer(self);
-                  consumed = TRUE;
-                }
-            }
-          else
-            {
-              *write_error = TRUE;
-              consumed = FALSE;
-            }
+          if (msgs[i]->flags & LF_LOCAL)
+            rollback++;
+        }
+      if (rollback)
+        {
+          self->seq_num -= rollback;
+          if (self->seq_num <= 0)
+            self->seq_num += G_MAXINT32;
         }
+
+      msg_debug("Can't send all messages, rewinding backlog",
+                evt_tag_int("num_rewound", num_msgs - num_consumed),
+                NULL);
+      log_queue_rewind_backlog(self->queue, num_msgs - num_consumed);
     }
-  else
+
+  for (i = 0; i < num_consumed; i++)
     {
-      msg_debug("Error posting log message as template() output resulted in an empty string, skipping message",
-                NULL);
-      consumed = TRUE;
+      if (G_UNLIKELY(msgs[i]->latency_stamp))
+        log_writer_record_latency(self, msgs[i], self->latency_total_hist);
     }
+  for (i = 0; i < num_msgs; i++)
+    log_msg_unref(msgs[i]);
+
+  return num_consumed == num_msgs && !(*write_error);
+}
 
-  if (consumed)
+static gboolean
+log_writer_format_cell_is_done(gpointer element)
+{
+  LogWriterFormatCell *cell = (LogWriterFormatCell *) element;
+
+  return cell->done;
+}
+
+static gpointer
+log_writer_format_thread_main(gpointer s)
+{
+  LogWriter *self = (LogWriter *) s;
+
+  g_static_mutex_lock(&self->format_lock);
+  while (1)
     {
-      if (msg->flags & LF_LOCAL)
-        step_sequence_number(&self->seq_num);
+      LogWriterFormatCell *cell;
+
+      while (!self->format_quit && self->format_claim_offset >= ring_buffer_count(&self->format_ring))
+        g_cond_wait(self->format_request_cond, g_static_mutex_get_mutex(&self->format_lock));
+      if (self->format_quit)
+        break;
+
+      /* cell slots are not recycled while a fill is being worked on, so
+       * the pointer stays valid after the lock is dropped, even if the
+       * flush thread pops completed cells before this one */
+      cell = ring_buffer_element_at(&self->format_ring, self->format_claim_offset);
+      self->format_claim_offset++;
+      g_static_mutex_unlock(&self->format_lock);
 
-      log_msg_unref(msg);
+      log_msg_refcache_start_consumer(cell->msg, &cell->path_options);
+      msg_set_context(cell->msg);
+      log_writer_do_format_log(self, cell->msg, cell->seq_num, cell->line);
       msg_set_context(NULL);
       log_msg_refcache_stop();
 
-      return TRUE;
-  }
-  else
+      g_static_mutex_lock(&self->format_lock);
+      cell->done = TRUE;
+      g_cond_signal(self->format_done_cond);
+    }
+  g_static_mutex_unlock(&self->format_lock);
+  return NULL;
+}
+
+/*
+ * Fill the formatting ring with messages popped off the queue, waking the
+ * format threads as cells become available.  The sequence number is
+ * stepped at submission time and the value to be used is captured in the
+ * cell.  Returns the number of cells submitted.
+ */
+static gint
+log_writer_format_ring_fill(LogWriter *self, LogWriterFlushMode flush_mode)
+{
+  gint num_pushed = 0;
+
+  while (!ring_buffer_is_full(&self->format_ring))
     {
-      msg_debug("Can't send the message rewind backlog",
-                evt_tag_str("message",self->line_buffer->str),
-                NULL);
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_writer_queue_pop_message(self, &path_options, flush_mode == LW_FLUSH_FORCE);
+      LogWriterFormatCell *cell;
 
-      log_queue_rewind_backlog(self->queue, 1);
+      if (!msg)
+        break;
 
-      log_msg_unref(msg);
-      msg_set_context(NULL);
-      log_msg_refcache_stop();
+      g_static_mutex_lock(&self->format_lock);
+      cell = ring_buffer_push(&self->format_ring);
+      cell->msg = msg;
+      cell->path_options = path_options;
+      cell->seq_num = self->seq_num;
+      cell->done = FALSE;
+      if (!cell->line)
+        cell->line = g_string_sized_new(MAX(128, self->line_size_hint));
+      g_cond_signal(self->format_request_cond);
+      g_static_mutex_unlock(&self->format_lock);
 
-      return FALSE;
+      if (msg->flags & LF_LOCAL)
+        step_sequence_number(&self->seq_num);
+      num_pushed++;
     }
+  return num_pushed;
 }
 
-static inline LogMessage *
-log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
+/*
+ * Drain the formatting ring: whenever a continual range of formatted
+ * cells is available at the tail, release it to the proto as a batch, so
+ * output order matches queue order no matter how the format threads are
+ * scheduled.  On a write error the remaining cells are still waited for
+ * (the format threads reference them), but are rewound to the backlog
+ * instead of being posted.
+ */
+static gboolean
+log_writer_format_ring_drain(LogWriter *self, gboolean *write_error)
 {
-  if (force_flush)
-    return log_queue_pop_head_ignore_throttle(self->queue, path_options);
-  else
-    return log_queue_pop_head(self->queue, path_options);
+  gboolean all_consumed = TRUE;
+  gint i;
+
+  g_static_mutex_lock(&self->format_lock);
+  while (ring_buffer_count(&self->format_ring) > 0)
+    {
+      LogWriterFormatCell *cells[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+      LogMessage *msgs[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+      LogProtoClientBatchEntry entries[LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES];
+      LogProtoStatus status;
+      gint range;
+      gint num_msgs = 0;
+      gint num_consumed;
+
+      range = ring_buffer_get_continual_range_length(&self->format_ring, log_writer_format_cell_is_done);
+      if (range == 0)
+        {
+          g_cond_wait(self->format_done_cond, g_static_mutex_get_mutex(&self->format_lock));
+          continue;
+        }
+      if (range > LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES)
+        range = LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES;
+
+      for (i = 0; i < range; i++)
+        cells[i] = ring_buffer_pop(&self->format_ring);
+      self->format_claim_offset -= range;
+      g_static_mutex_unlock(&self->format_lock);
+
+      for (i = 0; i < range; i++)
+        {
+          LogWriterFormatCell *cell = cells[i];
+
+          if (cell->line->len <= self->proto_header_reserve)
+            {
+              msg_debug("Error posting log message as template() output resulted in an empty string, skipping message",
+                        NULL);
+              log_msg_unref(cell->msg);
+              continue;
+            }
+
+          if (!(cell->msg->flags & LF_INTERNAL))
+            {
+              msg_debug("Outgoing message",
+                    evt_tag_str("message", cell->line->str + self->proto_header_reserve),
+                    NULL);
+            }
+
+          msgs[num_msgs] = cell->msg;
+          entries[num_msgs].msg = (guchar *) cell->line->str;
+          entries[num_msgs].msg_len = cell->line->len;
+          num_msgs++;
+        }
+
+      num_consumed = 0;
+      if (num_msgs > 0 && !(*write_error))
+        {
+          GTimeVal flush_start, flush_end;
+
+          if (self->options->flush_target_latency > 0)
+            g_get_current_time(&flush_start);
+          status = log_proto_client_post_batch(self->proto, entries, num_msgs, &num_consumed);
+
+          if (status == LPS_ERROR)
+            {
+              if ((self->options->options & LWO_IGNORE_ERRORS) != 0)
+                num_consumed = num_msgs;
+              else
+                *write_error = TRUE;
+            }
+
+          if (self->options->flush_target_latency > 0)
+            {
+              g_get_current_time(&flush_end);
+              log_writer_batch_note_flush(self, num_consumed, &flush_start, &flush_end);
+            }
+        }
+
+      if (num_consumed < num_msgs)
+        {
+          gint rollback = 0;
+
+          for (i = num_consumed; i < num_msgs; i++)
+            {
+              if (msgs[i]->flags & LF_LOCAL)
+                rollback++;
+            }
+          if (rollback)
+            {
+              self->seq_num -= rollback;
+              if (self->seq_num <= 0)
+                self->seq_num += G_MAXINT32;
+            }
+
+          msg_debug("Can't send all messages, rewinding backlog",
+                    evt_tag_int("num_rewound", num_msgs - num_consumed),
+                    NULL);
+          log_queue_rewind_backlog(self->queue, num_msgs - num_consumed);
+          all_consumed = FALSE;
+        }
+
+      for (i = 0; i < num_consumed; i++)
+        {
+          if (G_UNLIKELY(msgs[i]->latency_stamp))
+            log_writer_record_latency(self, msgs[i], self->latency_total_hist);
+        }
+      for (i = 0; i < num_msgs; i++)
+        log_msg_unref(msgs[i]);
+
+      g_static_mutex_lock(&self->format_lock);
+    }
+  g_static_mutex_unlock(&self->format_lock);
+
+  return all_consumed && !(*write_error);
+}
+
+/*
+ * The parallel counterpart of log_writer_write_message_batch(): one fill
+ * of the formatting ring is formatted by the format threads and drained
+ * in order.  Returns whether the flush loop should keep going.
+ */
+static gboolean
+log_writer_write_message_batch_parallel(LogWriter *self, LogWriterFlushMode flush_mode, gboolean *write_error)
+{
+  *write_error = FALSE;
+
+  if (log_writer_format_ring_fill(self, flush_mode) == 0)
+    return FALSE;
+
+  return log_writer_format_ring_drain(self, write_error);
+}
+
+static void
+log_writer_start_format_threads(LogWriter *self)
+{
+  gint i;
+
+  if (self->options->format_threads < 2 || self->format_thread_ids)
+    return;
+
+  ring_buffer_alloc(&self->format_ring, sizeof(LogWriterFormatCell), LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES);
+  self->format_claim_offset = 0;
+  self->format_quit = FALSE;
+  self->format_thread_ids = g_new0(GThread *, self->options->format_threads);
+  for (i = 0; i < self->options->format_threads; i++)
+    self->format_thread_ids[i] = g_thread_create(log_writer_format_thread_main, self, TRUE, NULL);
+}
+
+static void
+log_writer_stop_format_threads(LogWriter *self)
+{
+  LogWriterFormatCell *cells;
+  gint i;
+
+  if (!self->format_thread_ids)
+    return;
+
+  g_static_mutex_lock(&self->format_lock);
+  self->format_quit = TRUE;
+  g_cond_broadcast(self->format_request_cond);
+  g_static_mutex_unlock(&self->format_lock);
+
+  for (i = 0; i < self->options->format_threads; i++)
+    g_thread_join(self->format_thread_ids[i]);
+  g_free(self->format_thread_ids);
+  self->format_thread_ids = NULL;
+
+  /* the ring was fully drained before stopping, only the lazily
+   * allocated line buffers remain in the slots */
+  cells = (LogWriterFormatCell *) self->format_ring.buffer;
+  for (i = 0; i < (gint) ring_buffer_capacity(&self->format_ring); i++)
+    {
+      if (cells[i].line)
+        g_string_free(cells[i].line, TRUE);
+    }
+  ring_buffer_free(&self->format_ring);
 }
 
 /*
@@ -1209,13 +1843,12 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
 
   while ((!main_loop_worker_job_quit() || flush_mode == LW_FLUSH_FORCE) && !write_error)
     {
-      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-      LogMessage *msg = log_writer_queue_pop_message(self, &path_options, flush_mode == LW_FLUSH_FORCE);
-
-      if (!msg)
-        break;
-
-      if (!log_writer_write_message(self, msg, &path_options, &write_error))
+      if (self->format_thread_ids)
+        {
+          if (!log_writer_write_message_batch_parallel(self, flush_mode, &write_error))
+            break;
+        }
+      else if (!log_writer_write_message_batch(self, flush_mode, &write_error))
         break;
     }
 
@@ -1230,6 +1863,18 @@ log_writer_reopen_timeout(void *cookie)
 {
   LogWriter *self = (LogWriter *)cookie;
 
+  if (!log_driver_reconnect_slot_acquire())
+    {
+      /* too many drivers are reconnecting right now, check back for a
+       * free slot shortly */
+      iv_validate_now();
+      self->reopen_timer.expires = iv_now;
+      timespec_add_msec(&self->reopen_timer.expires, log_driver_reconnect_slot_retry_msec());
+      iv_timer_register(&self->reopen_timer);
+      return;
+    }
+  self->reconnect_slot_held = TRUE;
+
   log_pipe_notify(self->control, NC_REOPEN_REQUIRED, self);
 }
 
@@ -1290,8 +1935,39 @@ log_writer_init(LogPipe *s)
       if (self->options->suppress > 0)
         stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_SUPPRESSED, &self->suppressed_messages);
       stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->processed_messages);
-      
+      if (self->processed_messages)
+        self->processed_messages_shards = stats_counter_shards_new(self->processed_messages);
+
       stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_STORED, &self->stored_messages);
+
+      if (self->options->flush_target_latency > 0)
+        {
+          const gchar *prefix = self->stats_instance ? self->stats_instance : "";
+          gchar instance[256];
+
+          /* gauge showing the batch size the adaptive controller is
+           * currently aiming for */
+          g_snprintf(instance, sizeof(instance), "%s#batch_size", prefix);
+          stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_STORED, &self->batch_size_counter);
+        }
+
+      if (log_pipe_get_config(s)->latency_sample_freq > 0)
+        {
+          const gchar *hist_prefix = self->stats_instance ? self->stats_instance : "";
+          gchar instance[256];
+          gint bucket;
+
+          /* one counter per power-of-two microsecond bucket; percentiles
+           * can be derived from the cumulative bucket counts by whatever
+           * consumes syslog-ng-ctl stats */
+          for (bucket = 0; bucket < LOG_WRITER_LATENCY_HIST_BUCKETS; bucket++)
+            {
+              g_snprintf(instance, sizeof(instance), "%s#latency_queue/%lu", hist_prefix, (gulong) 1 << bucket);
+              stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_PROCESSED, &self->latency_queue_hist[bucket]);
+              g_snprintf(instance, sizeof(instance), "%s#latency_total/%lu", hist_prefix, (gulong) 1 << bucket);
+              stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_PROCESSED, &self->latency_total_hist[bucket]);
+            }
+        }
       stats_unlock();
     }
   log_queue_set_counters(self->queue, self->stored_messages, self->dropped_messages);
@@ -1312,6 +1988,8 @@ log_writer_init(LogPipe *s)
       log_writer_postpone_mark_timer(self);
     }
 
+  log_writer_start_format_threads(self);
+
   return TRUE;
 }
 
@@ -1324,11 +2002,13 @@ log_writer_deinit(LogPipe *s)
 
   log_queue_reset_parallel_push(self->queue);
   log_writer_flush(self, LW_FLUSH_FORCE);
+  log_writer_stop_format_threads(self);
   /* FIXME: by the time we arrive here, it must be guaranteed that no
    * _queue() call is running in a different thread, otherwise we'd need
    * some kind of locking. */
 
   log_writer_stop_watches(self);
+  log_writer_release_reconnect_slot(self);
   iv_event_unregister(&self->queue_filled);
 
   ml_batched_timer_unregister(&self->suppress_timer);
@@ -1337,10 +2017,33 @@ log_writer_deinit(LogPipe *s)
   log_queue_set_counters(self->queue, NULL, NULL);
 
   stats_lock();
+  stats_counter_shards_free(self->processed_messages_shards);
+  self->processed_messages_shards = NULL;
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_DROPPED, &self->dropped_messages);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_SUPPRESSED, &self->suppressed_messages);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->processed_messages);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_STORED, &self->stored_messages);
+  if (self->batch_size_counter)
+    {
+      const gchar *prefix = self->stats_instance ? self->stats_instance : "";
+      gchar instance[256];
+
+      g_snprintf(instance, sizeof(instance), "%s#batch_size", prefix);
+      stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_STORED, &self->batch_size_counter);
+    }
+  {
+    const gchar *hist_prefix = self->stats_instance ? self->stats_instance : "";
+    gchar instance[256];
+    gint bucket;
+
+    for (bucket = 0; bucket < LOG_WRITER_LATENCY_HIST_BUCKETS; bucket++)
+      {
+        g_snprintf(instance, sizeof(instance), "%s#latency_queue/%lu", hist_prefix, (gulong) 1 << bucket);
+        stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_PROCESSED, &self->latency_queue_hist[bucket]);
+        g_snprintf(instance, sizeof(instance), "%s#latency_total/%lu", hist_prefix, (gulong) 1 << bucket);
+        stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, instance, SC_TYPE_PROCESSED, &self->latency_total_hist[bucket]);
+      }
+  }
   stats_unlock();
   
   return TRUE;
@@ -1350,11 +2053,15 @@ static void
 log_writer_free(LogPipe *s)
 {
   LogWriter *self = (LogWriter *) s;
+  gint i;
 
   log_writer_free_proto(self);
 
-  if (self->line_buffer)
-    g_string_free(self->line_buffer, TRUE);
+  for (i = 0; i < LOG_PROTO_CLIENT_MAX_BATCH_MESSAGES; i++)
+    {
+      if (self->batch_line_buffers[i])
+        g_string_free(self->batch_line_buffers[i], TRUE);
+    }
 
   log_queue_unref(self->queue);
   if (self->last_msg)
@@ -1366,6 +2073,9 @@ log_writer_free(LogPipe *s)
   g_static_mutex_free(&self->suppress_lock);
   g_static_mutex_free(&self->pending_proto_lock);
   g_cond_free(self->pending_proto_cond);
+  g_static_mutex_free(&self->format_lock);
+  g_cond_free(self->format_request_cond);
+  g_cond_free(self->format_done_cond);
 
   log_pipe_free_method(s);
 }
@@ -1397,6 +2107,8 @@ static void
 log_writer_set_proto(LogWriter *self, LogProtoClient *proto)
 {
   self->proto = proto;
+  self->proto_header_reserve = proto ? log_proto_client_get_post_header_reserve(proto) : 0;
+  self->proto_serialized_payload = proto ? log_proto_client_get_post_serialized_payload(proto) : FALSE;
 
   if (proto)
     {
@@ -1427,18 +2139,23 @@ log_writer_reopen_deferred(gpointer s)
   LogWriter *self = args[0];
   LogProtoClient *proto = args[1];
 
+  /* the outcome of the reconnect attempt has arrived, give up our slot */
+  log_writer_release_reconnect_slot(self);
   if (!proto)
     {
       iv_validate_now();
 
       self->reopen_timer.expires = iv_now;
-      self->reopen_timer.expires.tv_sec += self->options->time_reopen;
+      timespec_add_msec(&self->reopen_timer.expires,
+                        log_driver_reconnect_next_delay_msec(&self->reconnect, self->options->time_reopen));
 
       if (iv_timer_registered(&self->reopen_timer))
           iv_timer_unregister(&self->reopen_timer);
 
       iv_timer_register(&self->reopen_timer);
     }
+  else
+    log_driver_reconnect_reset(&self->reconnect);
 
   init_sequence_number(&self->seq_num);
 
@@ -1534,7 +2251,6 @@ log_writer_new(guint32 flags, GlobalConfig *cfg)
   self->super.queue = log_writer_queue;
   self->super.free_fn = log_writer_free;
   self->flags = flags;
-  self->line_buffer = g_string_sized_new(128);
   self->pollable_state = -1;
   init_sequence_number(&self->seq_num);
 
@@ -1542,6 +2258,10 @@ log_writer_new(guint32 flags, GlobalConfig *cfg)
   g_static_mutex_init(&self->suppress_lock);
   g_static_mutex_init(&self->pending_proto_lock);
   self->pending_proto_cond = g_cond_new();
+  g_static_mutex_init(&self->format_lock);
+  self->format_request_cond = g_cond_new();
+  self->format_done_cond = g_cond_new();
+  ring_buffer_init(&self->format_ring);
 
   return self;
 }
@@ -1558,6 +2278,9 @@ log_writer_options_defaults(LogWriterOptions *options)
   options->padding = 0;
   options->mark_mode = MM_GLOBAL;
   options->mark_freq = -1;
+  options->format_threads = 0;
+  options->spin_timeout = 0;
+  options->flush_target_latency = 0;
   host_resolve_options_defaults(&options->host_resolve_options);
 }
 
@@ -1566,6 +2289,19 @@ log_writer_options_set_template_escape(LogWriterOptions *options, gboolean enabl
 {
   if (options->template && options->template->def_inline)
     {
+      if (options->template->escape != enable && options->template->ref_cnt > 2)
+        {
+          /* inline templates are interned by cfg_tree_check_inline_template()
+           * and may be shared with other destinations; flipping the escape
+           * flag on the shared instance would change their output too, so
+           * compile a private copy first */
+          LogTemplate *template = log_template_new(options->template->cfg, NULL);
+
+          log_template_compile(template, options->template->template, NULL);
+          template->def_inline = TRUE;
+          log_template_unref(options->template);
+          options->template = template;
+        }
       log_template_set_escape(options->template, enable);
     }
   else
@@ -72,6 +72,17 @@ typedef struct _LogWriterOptions
   gint padding;
   gint mark_mode;
   gint mark_freq;
+  /* number of threads formatting messages in parallel, values below 2
+   * keep formatting on the flush thread */
+  gint format_threads;
+  /* upper bound in microseconds for spinning on the queue after a flush
+   * instead of parking right away, 0 disables spinning */
+  gint spin_timeout;
+  /* latency budget in milliseconds for the adaptive batching controller:
+   * the writer delays flushes to accumulate larger batches as long as the
+   * first message of the batch still leaves within this budget, 0
+   * disables adaptive batching */
+  gint flush_target_latency;
 } LogWriterOptions;
 
 typedef struct _LogWriter LogWriter;
@@ -105,6 +105,7 @@ main_loop_io_worker_deinit(void)
 static GOptionEntry main_loop_io_worker_options[] =
 {
   { "worker-threads",      0,         0, G_OPTION_ARG_INT, &main_loop_io_workers.max_threads, "Set the number of I/O worker threads", "<max>" },
+  { "worker-affinity",     0,         0, G_OPTION_ARG_NONE, &main_loop_worker_affinity, "Pin worker threads to CPUs round-robin, keeps their buffers node-local on NUMA hosts", NULL },
   { NULL },
 };
 
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2002-2013 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2013 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "mainloop-watchdog.h"
+#include "logpipe.h"
+#include "messages.h"
+#include "stats/stats-registry.h"
+#include "timeutils.h"
+
+#include <iv.h>
+
+/*
+ * Watchdog for loop stalls
+ * ========================
+ *
+ * When a callback blocks (a synchronous DNS lookup, a slow open() on a
+ * hung NFS mount), everything serviced by that thread degrades and the
+ * logs only show the symptoms.  This module runs a dedicated watchdog
+ * thread that samples two progress signals:
+ *
+ *   - a heartbeat timer registered on the main event loop: if the
+ *     heartbeat stops advancing, the main loop itself is stuck,
+ *
+ *   - a per-thread progress counter and current-pipe pointer bumped
+ *     around every queue method invocation (see
+ *     main_loop_watchdog_pipe_enter() called from log_pipe_queue()): if
+ *     the counter does not advance while the pipe pointer is set, the
+ *     thread is blocked inside that very pipe.
+ *
+ * Stall durations are published as power-of-two histograms under the
+ * global stats component, and stalls above a threshold emit a warning
+ * naming the config location of the blocking pipe, which is otherwise
+ * only diagnosable with a debugger attached at the right moment.
+ *
+ * The per-thread state is only ever written by its owner thread; the
+ * watchdog reads it without synchronization and merely compares
+ * snapshots taken one sampling interval apart, so a torn read can at
+ * worst delay the detection by one sample.
+ */
+
+/* sampling interval of the watchdog thread and period of the main loop
+ * heartbeat timer */
+#define WD_SAMPLE_INTERVAL_MSEC 100
+
+/* the heartbeat and the sampling run on the same period, so a single
+ * unchanged sample is expected jitter; require this many consecutive
+ * unchanged samples before the main loop is considered stalled */
+#define WD_MAINLOOP_STALL_MIN_SAMPLES 3
+
+/* stalls at least this long are reported through msg_warning() */
+#define WD_STALL_WARN_MSEC 1000
+
+/* stall duration histograms, the first bucket collects everything up to
+ * WD_HIST_FIRST_BUCKET_MSEC, subsequent buckets double, the last one is
+ * open ended */
+#define WD_HIST_BUCKETS 8
+#define WD_HIST_FIRST_BUCKET_MSEC 128
+
+typedef struct _MainLoopWatchdogThreadState
+{
+  /* written by the owner thread only, read racily by the watchdog */
+  LogPipe *current_pipe;
+  guint32 progress;
+
+  /* watchdog-private bookkeeping, the snapshot of the previous sample
+   * and the length of the stall in progress */
+  LogPipe *seen_pipe;
+  guint32 seen_progress;
+  gint stall_msec;
+  gboolean warned;
+} MainLoopWatchdogThreadState;
+
+/* list of the live per-thread state blocks; the lock guards the list
+ * only, see the comment above on how the blocks themselves are accessed */
+static GStaticMutex watchdog_lock = G_STATIC_MUTEX_INIT;
+static GList *watchdog_threads;
+static GStaticPrivate watchdog_thread_state_private = G_STATIC_PRIVATE_INIT;
+
+static GThread *watchdog_thread;
+static volatile gboolean watchdog_quit;
+
+/* bumped on the main loop, staleness means the loop itself is stuck */
+static volatile guint32 watchdog_heartbeat;
+static struct iv_timer watchdog_heartbeat_timer;
+
+/* the main thread's state block, used to attribute main loop stalls to
+ * the pipe the main thread was running, if any */
+static MainLoopWatchdogThreadState *watchdog_main_thread_state;
+
+static StatsCounterItem *watchdog_mainloop_hist[WD_HIST_BUCKETS];
+static StatsCounterItem *watchdog_pipe_hist[WD_HIST_BUCKETS];
+static StatsCounterItem *watchdog_longest_stall;
+static gint watchdog_longest_stall_msec;
+
+static const gchar *watchdog_hist_bucket_names[WD_HIST_BUCKETS] =
+{
+  "128", "256", "512", "1024", "2048", "4096", "8192", "large"
+};
+
+static void
+main_loop_watchdog_thread_state_free(gpointer s)
+{
+  MainLoopWatchdogThreadState *self = (MainLoopWatchdogThreadState *) s;
+
+  g_static_mutex_lock(&watchdog_lock);
+  watchdog_threads = g_list_remove(watchdog_threads, self);
+  g_static_mutex_unlock(&watchdog_lock);
+  g_free(self);
+}
+
+static MainLoopWatchdogThreadState *
+main_loop_watchdog_thread_state_get(void)
+{
+  MainLoopWatchdogThreadState *self = g_static_private_get(&watchdog_thread_state_private);
+
+  if (G_UNLIKELY(!self))
+    {
+      self = g_new0(MainLoopWatchdogThreadState, 1);
+      g_static_private_set(&watchdog_thread_state_private, self, main_loop_watchdog_thread_state_free);
+      g_static_mutex_lock(&watchdog_lock);
+      watchdog_threads = g_list_prepend(watchdog_threads, self);
+      g_static_mutex_unlock(&watchdog_lock);
+    }
+  return self;
+}
+
+LogPipe *
+main_loop_watchdog_pipe_enter(LogPipe *pipe)
+{
+  MainLoopWatchdogThreadState *state = main_loop_watchdog_thread_state_get();
+  LogPipe *prev = state->current_pipe;
+
+  state->current_pipe = pipe;
+  state->progress++;
+  return prev;
+}
+
+void
+main_loop_watchdog_pipe_leave(LogPipe *prev)
+{
+  MainLoopWatchdogThreadState *state = main_loop_watchdog_thread_state_get();
+
+  state->current_pipe = prev;
+  state->progress++;
+}
+
+static void
+main_loop_watchdog_record_stall(StatsCounterItem **hist, gint stall_msec)
+{
+  gint bucket;
+
+  for (bucket = 0; bucket < WD_HIST_BUCKETS - 1; bucket++)
+    {
+      if (stall_msec <= (WD_HIST_FIRST_BUCKET_MSEC << bucket))
+        break;
+    }
+  stats_counter_inc(hist[bucket]);
+  if (stall_msec > watchdog_longest_stall_msec)
+    {
+      watchdog_longest_stall_msec = stall_msec;
+      stats_counter_set(watchdog_longest_stall, stall_msec);
+    }
+}
+
+static void
+main_loop_watchdog_sample_threads(void)
+{
+  GList *l;
+
+  g_static_mutex_lock(&watchdog_lock);
+  for (l = watchdog_threads; l; l = l->next)
+    {
+      MainLoopWatchdogThreadState *state = (MainLoopWatchdogThreadState *) l->data;
+      LogPipe *pipe = state->current_pipe;
+      guint32 progress = state->progress;
+
+      if (pipe && pipe == state->seen_pipe && progress == state->seen_progress)
+        {
+          /* the progress counter is bumped on every enter/leave, so an
+           * unchanged value means the thread has been sitting in this
+           * very invocation since the previous sample */
+          state->stall_msec += WD_SAMPLE_INTERVAL_MSEC;
+          if (state->stall_msec >= WD_STALL_WARN_MSEC && !state->warned)
+            {
+              /* the blocked thread is inside the queue method of this
+               * pipe, which keeps the pipe and its configuration alive;
+               * should the stall end while the warning is being
+               * formatted, we may name a pipe that just finished, which
+               * is acceptable for a diagnostic */
+              msg_warning("Thread blocked inside a LogPipe, processing through it is stalled",
+                          evt_tag_int("stalled_for_msec", state->stall_msec),
+                          log_pipe_location_tag(pipe),
+                          NULL);
+              state->warned = TRUE;
+            }
+        }
+      else
+        {
+          if (state->stall_msec)
+            main_loop_watchdog_record_stall(watchdog_pipe_hist, state->stall_msec);
+          state->stall_msec = 0;
+          state->warned = FALSE;
+        }
+      state->seen_pipe = pipe;
+      state->seen_progress = progress;
+    }
+  g_static_mutex_unlock(&watchdog_lock);
+}
+
+static void
+main_loop_watchdog_sample_mainloop(void)
+{
+  static guint32 seen_heartbeat;
+  static gint unchanged_samples;
+  static gint stall_msec;
+  static gboolean warned;
+  guint32 heartbeat = watchdog_heartbeat;
+
+  if (heartbeat == seen_heartbeat)
+    {
+      unchanged_samples++;
+      if (unchanged_samples < WD_MAINLOOP_STALL_MIN_SAMPLES)
+        return;
+      stall_msec = unchanged_samples * WD_SAMPLE_INTERVAL_MSEC;
+      if (stall_msec >= WD_STALL_WARN_MSEC && !warned)
+        {
+          LogPipe *pipe = watchdog_main_thread_state ? watchdog_main_thread_state->current_pipe : NULL;
+
+          msg_warning("Main loop is not making progress, I/O dispatching is stalled",
+                      evt_tag_int("stalled_for_msec", stall_msec),
+                      pipe ? log_pipe_location_tag(pipe) : evt_tag_str("blocked_in", "unknown, outside of any LogPipe"),
+                      NULL);
+          warned = TRUE;
+        }
+    }
+  else
+    {
+      if (stall_msec)
+        main_loop_watchdog_record_stall(watchdog_mainloop_hist, stall_msec);
+      unchanged_samples = 0;
+      stall_msec = 0;
+      warned = FALSE;
+      seen_heartbeat = heartbeat;
+    }
+}
+
+static gpointer
+main_loop_watchdog_thread_main(gpointer s)
+{
+  while (!watchdog_quit)
+    {
+      g_usleep(WD_SAMPLE_INTERVAL_MSEC * 1000);
+      main_loop_watchdog_sample_mainloop();
+      main_loop_watchdog_sample_threads();
+    }
+  return NULL;
+}
+
+static void
+main_loop_watchdog_heartbeat(void *cookie)
+{
+  watchdog_heartbeat++;
+  iv_validate_now();
+  watchdog_heartbeat_timer.expires = iv_now;
+  timespec_add_msec(&watchdog_heartbeat_timer.expires, WD_SAMPLE_INTERVAL_MSEC);
+  iv_timer_register(&watchdog_heartbeat_timer);
+}
+
+static void
+main_loop_watchdog_register_counters(void)
+{
+  gint i;
+
+  stats_lock();
+  for (i = 0; i < WD_HIST_BUCKETS; i++)
+    {
+      stats_register_counter(0, SCS_GLOBAL, "mainloop_stalls", watchdog_hist_bucket_names[i], SC_TYPE_PROCESSED, &watchdog_mainloop_hist[i]);
+      stats_register_counter(0, SCS_GLOBAL, "pipe_stalls", watchdog_hist_bucket_names[i], SC_TYPE_PROCESSED, &watchdog_pipe_hist[i]);
+    }
+  stats_register_counter(0, SCS_GLOBAL, "longest_stall_msec", NULL, SC_TYPE_PROCESSED, &watchdog_longest_stall);
+  stats_unlock();
+}
+
+void
+main_loop_watchdog_start(void)
+{
+  main_loop_watchdog_register_counters();
+
+  /* the main thread's own state block, so main loop stalls can be
+   * attributed when the main thread is stuck inside a pipe */
+  watchdog_main_thread_state = main_loop_watchdog_thread_state_get();
+
+  IV_TIMER_INIT(&watchdog_heartbeat_timer);
+  watchdog_heartbeat_timer.handler = main_loop_watchdog_heartbeat;
+  iv_validate_now();
+  watchdog_heartbeat_timer.expires = iv_now;
+  timespec_add_msec(&watchdog_heartbeat_timer.expires, WD_SAMPLE_INTERVAL_MSEC);
+  iv_timer_register(&watchdog_heartbeat_timer);
+
+  watchdog_quit = FALSE;
+  watchdog_thread = g_thread_create(main_loop_watchdog_thread_main, NULL, TRUE, NULL);
+}
+
+void
+main_loop_watchdog_stop(void)
+{
+  if (!watchdog_thread)
+    return;
+
+  watchdog_quit = TRUE;
+  g_thread_join(watchdog_thread);
+  watchdog_thread = NULL;
+  if (iv_timer_registered(&watchdog_heartbeat_timer))
+    iv_timer_unregister(&watchdog_heartbeat_timer);
+  watchdog_main_thread_state = NULL;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2002-2013 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2013 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef MAINLOOP_WATCHDOG_H_INCLUDED
+#define MAINLOOP_WATCHDOG_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* bracket the execution of a pipe's queue method, so a stall can be
+ * attributed to the pipe that was running when the thread stopped making
+ * progress; enter returns the previous innermost pipe, which leave
+ * restores (pipes queue into each other recursively) */
+LogPipe *main_loop_watchdog_pipe_enter(LogPipe *pipe);
+void main_loop_watchdog_pipe_leave(LogPipe *prev);
+
+void main_loop_watchdog_start(void);
+void main_loop_watchdog_stop(void);
+
+#endif
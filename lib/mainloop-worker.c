@@ -25,8 +25,15 @@
 #include "mainloop-call.h"
 #include "tls-support.h"
 #include "apphook.h"
+#include "messages.h"
 
 #include <iv.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef SYSLOG_NG_HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
 
 typedef enum { GENERAL_THREAD = 0, OUTPUT_THREAD, EXTERNAL_INPUT_THREAD, MAIN_LOOP_WORKER_TYPE_MAX} MainLoopWorkerType;
 
@@ -156,6 +163,37 @@ _request_all_threads_to_exit(void)
   main_loop_workers_quit = TRUE;
 }
 
+gboolean main_loop_worker_affinity = FALSE;
+
+/* Pin the calling worker thread to the next online CPU, round-robin.  On
+ * NUMA hosts this keeps a thread on the node where it first ran, so the
+ * buffers and queue nodes it allocates stay node-local under the kernel's
+ * first-touch placement policy, instead of bouncing between sockets as
+ * the scheduler migrates unpinned threads. */
+static void
+_pin_thread_to_next_cpu(void)
+{
+#ifdef SYSLOG_NG_HAVE_SCHED_SETAFFINITY
+  static gint next_cpu = 0;
+  cpu_set_t cpu_set;
+  glong num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  gint cpu;
+
+  if (num_cpus <= 0)
+    return;
+  cpu = g_atomic_int_exchange_and_add(&next_cpu, 1) % num_cpus;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0)
+    {
+      msg_warning("Error pinning worker thread to CPU",
+                  evt_tag_int("cpu", cpu),
+                  evt_tag_errno("error", errno),
+                  NULL);
+    }
+#endif
+}
+
 /* Call this function from worker threads, when you start up */
 void
 main_loop_worker_thread_start(void *cookie)
@@ -163,6 +201,9 @@ main_loop_worker_thread_start(void *cookie)
   WorkerOptions *worker_options = cookie;
   main_loop_worker_type = GENERAL_THREAD;
 
+  if (main_loop_worker_affinity)
+    _pin_thread_to_next_cpu();
+
   if (worker_options && worker_options->is_output_thread)
     {
       main_loop_worker_type = OUTPUT_THREAD;
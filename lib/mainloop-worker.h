@@ -55,6 +55,10 @@ typedef struct _WorkerOptions
   gboolean is_external_input;
 } WorkerOptions;
 
+/* pin worker threads to CPUs round-robin as they start up, keeps their
+ * buffers node-local on NUMA hosts */
+extern gboolean main_loop_worker_affinity;
+
 static inline void
 worker_batch_callback_init(WorkerBatchCallback *self)
 {
@@ -25,6 +25,7 @@
 #include "mainloop-worker.h"
 #include "mainloop-io-worker.h"
 #include "mainloop-call.h"
+#include "mainloop-watchdog.h"
 #include "apphook.h"
 #include "cfg.h"
 #include "stats/stats-registry.h"
@@ -99,6 +100,7 @@ const gchar *module_path;
 static gchar *preprocess_into = NULL;
 gboolean syntax_only = FALSE;
 gboolean interactive_mode = FALSE;
+static gboolean handover = FALSE;
 
 /*
  * This variable is used to detect that syslog-ng is being terminated, in which
@@ -153,6 +155,12 @@ static struct iv_event reload_config_requested;
 static GlobalConfig *current_configuration;
 ThreadId main_thread_handle;
 
+GlobalConfig *
+main_loop_get_current_config(void)
+{
+  return current_configuration;
+}
+
 /************************************************************************************
  * config load/reload
  ************************************************************************************/
@@ -163,16 +171,14 @@ static GlobalConfig *main_loop_old_config;
 static GlobalConfig *main_loop_new_config;
 
 
-/* called when syslog-ng first starts up */
-gboolean
-main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
+/* called when syslog-ng first starts up; @state is an already started
+ * PersistState instance, ownership is passed to @cfg */
+static gboolean
+main_loop_initialize_state_from_persist(GlobalConfig *cfg, PersistState *state)
 {
   gboolean success;
 
-  cfg->state = persist_state_new(persist_filename);
-  if (!persist_state_start(cfg->state))
-    return FALSE;
-
+  cfg->state = state;
   run_id_init(cfg->state);
   host_id_init(cfg->state);
   success = cfg_init(cfg);
@@ -184,6 +190,45 @@ main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
   return success;
 }
 
+gboolean
+main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
+{
+  cfg->state = persist_state_new(persist_filename);
+  if (!persist_state_start(cfg->state))
+    return FALSE;
+
+  return main_loop_initialize_state_from_persist(cfg, cfg->state);
+}
+
+/* the already deinitialized old configuration, kept around until the main
+ * loop gets a chance to tear it down in the background */
+static GlobalConfig *main_loop_retired_config;
+static struct iv_task main_loop_retired_config_free_task;
+
+static void
+main_loop_retired_config_free(void *arg)
+{
+  cfg_free(main_loop_retired_config);
+  main_loop_retired_config = NULL;
+}
+
+/* defer freeing the old configuration graph until after the workers have
+ * been restarted on the new one; destroying a large graph (pipes,
+ * templates, parser databases) can take long enough to matter during the
+ * reload outage window and none of it needs the workers stopped */
+static void
+main_loop_retire_config(GlobalConfig *cfg)
+{
+  if (main_loop_retired_config)
+    {
+      /* reloaded again before the task has run, free the earlier one now */
+      cfg_free(main_loop_retired_config);
+    }
+  main_loop_retired_config = cfg;
+  if (!iv_task_registered(&main_loop_retired_config_free_task))
+    iv_task_register(&main_loop_retired_config_free_task);
+}
+
 /* called to apply the new configuration once all I/O worker threads have finished */
 static void
 main_loop_reload_config_apply(void)
@@ -206,7 +251,7 @@ main_loop_reload_config_apply(void)
       msg_verbose("New configuration initialized", NULL);
       persist_config_free(main_loop_new_config->persist);
       main_loop_new_config->persist = NULL;
-      cfg_free(main_loop_old_config);
+      main_loop_retire_config(main_loop_old_config);
       current_configuration = main_loop_new_config;
       service_management_clear_status();
     }
@@ -279,6 +324,28 @@ main_loop_reload_config_initiate(void)
       service_management_publish_status("Error parsing new configuration, using the old config");
       return;
     }
+
+  /* config management tools tend to issue a SIGHUP even when nothing
+   * changed; recognizing that here avoids tearing down and reinitializing
+   * every source and destination (along with their connections and
+   * queues) for nothing.  This is opt-in via skip-unchanged-reloads():
+   * a HUP also reopens file destinations (logrotate counts on that) and
+   * re-reads file backed resources such as pattern databases and TLS
+   * certificates, which only happens through the full deinit/init
+   * cycle, so short-circuiting it must be an explicit choice */
+  if (main_loop_old_config->skip_unchanged_reloads &&
+      main_loop_old_config->preprocess_config_hash &&
+      main_loop_old_config->preprocess_config_hash == main_loop_new_config->preprocess_config_hash)
+    {
+      msg_notice("Configuration unchanged, skipping reload",
+                 evt_tag_str(EVT_TAG_FILENAME, cfgfilename),
+                 NULL);
+      cfg_free(main_loop_new_config);
+      main_loop_new_config = NULL;
+      main_loop_old_config = NULL;
+      service_management_clear_status();
+      return;
+    }
   main_loop_worker_sync_call(main_loop_reload_config_apply);
 }
 
@@ -295,6 +362,11 @@ main_loop_exit_finish(void)
    * threads are running.  This will unregister ivykis tasks and timers
    * that could fire while the configuration is being destructed */
   cfg_deinit(current_configuration);
+  if (main_loop_retired_config)
+    {
+      iv_task_unregister(&main_loop_retired_config_free_task);
+      main_loop_retired_config_free(NULL);
+    }
   iv_quit();
 }
 
@@ -433,21 +505,67 @@ main_loop_init(void)
   main_loop_io_worker_init();
   main_loop_call_init();
 
+  IV_TASK_INIT(&main_loop_retired_config_free_task);
+  main_loop_retired_config_free_task.handler = main_loop_retired_config_free;
+
   main_loop_init_events();
   if (!syntax_only)
-    control_init(ctlfilename);
+    {
+      control_init(ctlfilename);
+      main_loop_watchdog_start();
+    }
   setup_signals();
 }
 
+/* loads and compacts the persist file in the background, overlapping its
+ * disk traffic with config parsing; returns the persist_state_start()
+ * verdict */
+static gpointer
+main_loop_persist_state_load_thread(gpointer user_data)
+{
+  PersistState *state = (PersistState *) user_data;
+
+  return GINT_TO_POINTER(persist_state_start(state));
+}
+
 /*
  * Returns: exit code to be returned to the calling process, 0 on success.
  */
 int
 main_loop_read_and_init_config(void)
 {
+  GThread *persist_load_thread = NULL;
+  PersistState *state = NULL;
+
+  /* fetch the listening fds of an already running instance before
+   * anything binds: the drivers consult the handover registry when their
+   * reload-persist lookup comes up empty, so a successor started with
+   * --handover takes over the sockets without a listening gap */
+  if (handover && !syntax_only && !preprocess_into)
+    {
+      if (!control_fetch_handover_fds(ctlfilename))
+        msg_error("Error fetching listener fds from the running instance, sockets will be bound anew",
+                  evt_tag_str("control", ctlfilename),
+                  NULL);
+    }
+
+  /* rewriting the persist file on startup only touches data config
+   * parsing doesn't need, the two are joined below before the state is
+   * handed over to the configuration */
+  if (!syntax_only && !preprocess_into)
+    {
+      state = persist_state_new(persist_file);
+      persist_load_thread = g_thread_create(main_loop_persist_state_load_thread, state, TRUE, NULL);
+    }
+
   current_configuration = cfg_new(0);
   if (!cfg_read_config(current_configuration, cfgfilename, syntax_only, preprocess_into))
     {
+      if (persist_load_thread)
+        {
+          g_thread_join(persist_load_thread);
+          current_configuration->state = state;
+        }
       return 1;
     }
 
@@ -456,7 +574,13 @@ main_loop_read_and_init_config(void)
       return 0;
     }
 
-  if (!main_loop_initialize_state(current_configuration, persist_file))
+  if (!GPOINTER_TO_INT(g_thread_join(persist_load_thread)))
+    {
+      current_configuration->state = state;
+      return 2;
+    }
+
+  if (!main_loop_initialize_state_from_persist(current_configuration, state))
     {
       return 2;
     }
@@ -473,6 +597,9 @@ main_loop_free_config(void)
 void
 main_loop_deinit(void)
 {
+  /* stop sampling before the configuration graph is torn down */
+  main_loop_watchdog_stop();
+
   main_loop_free_config();
 
   if (!syntax_only)
@@ -513,6 +640,7 @@ static GOptionEntry main_loop_options[] =
   { "syntax-only",       's',         0, G_OPTION_ARG_NONE, &syntax_only, "Only read and parse config file", NULL},
   { "control",           'c',         0, G_OPTION_ARG_STRING, &ctlfilename, "Set syslog-ng control socket, default=" PATH_CONTROL_SOCKET, "<ctlpath>" },
   { "interactive",       'i',         0, G_OPTION_ARG_NONE, &interactive_mode, "Enable interactive mode" },
+  { "handover",            0,         0, G_OPTION_ARG_NONE, &handover, "Take over listening sockets from an already running syslog-ng through its control socket", NULL },
   { NULL },
 };
 
@@ -67,6 +67,7 @@ void main_loop_add_options(GOptionContext *ctx);
 void main_loop_global_init(void);
 
 gboolean main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename);
+GlobalConfig *main_loop_get_current_config(void);
 
 
 #endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "memusage.h"
+#include "stats/stats.h"
+
+typedef struct _MemUsageThreadCounters
+{
+  gint64 bytes[MEMUSAGE_MAX];
+} MemUsageThreadCounters;
+
+/* list of the live per-thread counter blocks plus the folded-in totals
+ * of already exited threads; the lock only guards the list and the
+ * retired totals, the blocks themselves are written by their owner
+ * thread without synchronization.  Summing may therefore see torn or
+ * stale values, which is acceptable for a memory gauge, the numbers are
+ * unbiased as every alloc/free pair hits the same counter. */
+static GStaticMutex memusage_lock = G_STATIC_MUTEX_INIT;
+static GList *memusage_threads;
+static gint64 memusage_retired_bytes[MEMUSAGE_MAX];
+static GStaticPrivate memusage_thread_counters_private = G_STATIC_PRIVATE_INIT;
+
+static StatsCounterItem *memusage_stats_counters[MEMUSAGE_MAX];
+
+static const gchar *memusage_subsystem_names[MEMUSAGE_MAX] =
+{
+  "memory_nvtable_kb",
+  "memory_logmsg_kb",
+  "memory_queue_kb",
+  "memory_proto_buffer_kb",
+};
+
+static void
+memusage_thread_counters_free(gpointer s)
+{
+  MemUsageThreadCounters *self = (MemUsageThreadCounters *) s;
+  gint i;
+
+  g_static_mutex_lock(&memusage_lock);
+  for (i = 0; i < MEMUSAGE_MAX; i++)
+    memusage_retired_bytes[i] += self->bytes[i];
+  memusage_threads = g_list_remove(memusage_threads, self);
+  g_static_mutex_unlock(&memusage_lock);
+  g_free(self);
+}
+
+static MemUsageThreadCounters *
+memusage_thread_counters_get(void)
+{
+  MemUsageThreadCounters *self = g_static_private_get(&memusage_thread_counters_private);
+
+  if (G_UNLIKELY(!self))
+    {
+      self = g_new0(MemUsageThreadCounters, 1);
+      g_static_private_set(&memusage_thread_counters_private, self, memusage_thread_counters_free);
+      g_static_mutex_lock(&memusage_lock);
+      memusage_threads = g_list_prepend(memusage_threads, self);
+      g_static_mutex_unlock(&memusage_lock);
+    }
+  return self;
+}
+
+void
+memusage_count_alloc(MemUsageSubsystem subsystem, gsize bytes)
+{
+  memusage_thread_counters_get()->bytes[subsystem] += bytes;
+}
+
+void
+memusage_count_free(MemUsageSubsystem subsystem, gsize bytes)
+{
+  memusage_thread_counters_get()->bytes[subsystem] -= bytes;
+}
+
+gint64
+memusage_get(MemUsageSubsystem subsystem)
+{
+  gint64 sum;
+  GList *l;
+
+  g_static_mutex_lock(&memusage_lock);
+  sum = memusage_retired_bytes[subsystem];
+  for (l = memusage_threads; l; l = l->next)
+    sum += ((MemUsageThreadCounters *) l->data)->bytes[subsystem];
+  g_static_mutex_unlock(&memusage_lock);
+  return sum;
+}
+
+/* called whenever the stats output is rendered, the same way the
+ * counter shards are aggregated lazily */
+void
+memusage_refresh_counters(void)
+{
+  gint i;
+
+  for (i = 0; i < MEMUSAGE_MAX; i++)
+    stats_counter_set(memusage_stats_counters[i], memusage_get(i) / 1024);
+}
+
+void
+memusage_global_init(void)
+{
+  gint i;
+
+  stats_lock();
+  for (i = 0; i < MEMUSAGE_MAX; i++)
+    stats_register_counter(0, SCS_GLOBAL, memusage_subsystem_names[i], NULL, SC_TYPE_PROCESSED, &memusage_stats_counters[i]);
+  stats_unlock();
+}
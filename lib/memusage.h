@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef MEMUSAGE_H_INCLUDED
+#define MEMUSAGE_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* Always-on byte accounting for the large allocation choke points.
+ *
+ * Unlike the memtrace malloc tracer this is meant for production use:
+ * each subsystem adds/subtracts to a per-thread 64 bit counter at the
+ * points where it already knows the allocation size, so the hot path is
+ * two unsynchronized memory operations.  The per-thread counters are
+ * summed on demand; the result is a racy-but-unbiased gauge of how many
+ * bytes each subsystem currently holds, rendered into the stats output
+ * as the memory_* counters (in kilobytes, to fit the 32 bit stats
+ * counter value).
+ */
+typedef enum
+{
+  MEMUSAGE_NVTABLE,        /* message payloads (nvtable.c) */
+  MEMUSAGE_LOGMSG,         /* LogMessage structures and embedded payloads (logmsg.c) */
+  MEMUSAGE_QUEUE,          /* out-of-line queue nodes (logmsg.c, logqueue-fifo.c) */
+  MEMUSAGE_PROTO_BUFFER,   /* source read buffers (logproto-buffered-server.c) */
+  MEMUSAGE_MAX
+} MemUsageSubsystem;
+
+void memusage_count_alloc(MemUsageSubsystem subsystem, gsize bytes);
+void memusage_count_free(MemUsageSubsystem subsystem, gsize bytes);
+gint64 memusage_get(MemUsageSubsystem subsystem);
+void memusage_refresh_counters(void);
+void memusage_global_init(void);
+
+#endif
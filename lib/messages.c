@@ -57,6 +57,7 @@ gboolean verbose_flag = 0;
 gboolean trace_flag = 0;
 gboolean log_stderr = FALSE;
 gboolean skip_timestamp_on_stderr = FALSE;
+guint32 msg_enabled_severities = 0xffffffff;
 static MsgPostFunc msg_post_func;
 static EVTCONTEXT *evt_context;
 static GStaticPrivate msg_context_private = G_STATIC_PRIVATE_INIT;
@@ -251,6 +252,16 @@ msg_set_post_func(MsgPostFunc func)
   msg_post_func = func;
 }
 
+/* Publish the set of severities worth generating diagnostic messages
+ * for, see msg_severity_enabled().  Racy updates are fine, a stale mask
+ * only means a few messages get formatted (or skipped) around a config
+ * reload. */
+void
+msg_set_enabled_severities(guint32 severities)
+{
+  msg_enabled_severities = severities;
+}
+
 void
 msg_post_message(LogMessage *msg)
 {
@@ -33,6 +33,7 @@ extern int debug_flag;
 extern int verbose_flag;
 extern int trace_flag;
 extern int log_stderr;
+extern guint32 msg_enabled_severities;
 
 typedef void (*MsgPostFunc)(LogMessage *msg);
 
@@ -45,18 +46,38 @@ void msg_event_suppress_recursions_and_send(EVTREC *e);
 
 
 void msg_set_post_func(MsgPostFunc func);
+void msg_set_enabled_severities(guint32 severities);
 void msg_init(gboolean interactive);
 void msg_deinit(void);
 
 void msg_add_option_group(GOptionContext *ctx);
 
+/* Severity prefilter for the diagnostic macros below.  The internal()
+ * source publishes the union of severities that any log path acting on it
+ * accepts (see afinter_source_init()), messages no consumer would see are
+ * skipped here, before their tags are evaluated and formatted.  When
+ * logging to stderr everything is let through, and fatal->warning are
+ * never masked as they can reach stderr even without a consumer. */
+#define msg_severity_enabled(pri) \
+        (G_UNLIKELY(log_stderr) || (msg_enabled_severities & (1 << (pri))))
+
 /* fatal->warning goes out to the console during startup, notice and below
  * comes goes to the log even during startup */
 #define msg_fatal(desc, tag1, tags...)    msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_CRIT, desc, tag1, ##tags ))
 #define msg_error(desc, tag1, tags...)    msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_ERR, desc, tag1, ##tags ))
 #define msg_warning(desc, tag1, tags...)  msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_WARNING, desc, tag1, ##tags ))
-#define msg_notice(desc, tag1, tags...)   msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_NOTICE, desc, tag1, ##tags ))
-#define msg_info(desc, tag1, tags...)     msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_INFO, desc, tag1, ##tags ))
+#define msg_notice(desc, tag1, tags...) 					  \
+	do { 									  \
+	  if (msg_severity_enabled(EVT_PRI_NOTICE))                               \
+	    msg_event_suppress_recursions_and_send(                               \
+	          msg_event_create(EVT_PRI_NOTICE, desc, tag1, ##tags ));         \
+	} while (0)
+#define msg_info(desc, tag1, tags...) 						  \
+	do { 									  \
+	  if (msg_severity_enabled(EVT_PRI_INFO))                                 \
+	    msg_event_suppress_recursions_and_send(                               \
+	          msg_event_create(EVT_PRI_INFO, desc, tag1, ##tags ));           \
+	} while (0)
 
 /* just like msg_info, but prepends the message with a timestamp -- useful in interactive
  * tools with long running time to provide some feedback */
@@ -81,7 +102,7 @@ void msg_add_option_group(GOptionContext *ctx);
 
 #define msg_debug(desc, tag1, tags...) 						  \
 	do { 									  \
-	  if (G_UNLIKELY(debug_flag))                                             \
+	  if (G_UNLIKELY(debug_flag) && msg_severity_enabled(EVT_PRI_DEBUG))      \
 	    msg_event_suppress_recursions_and_send(                               \
 	          msg_event_create(EVT_PRI_DEBUG, desc, tag1, ##tags ));          \
 	} while (0)
@@ -89,7 +110,7 @@ void msg_add_option_group(GOptionContext *ctx);
 #if SYSLOG_NG_ENABLE_DEBUG
 #define msg_trace(desc, tag1, tags...) 						  \
 	do { 									  \
-	  if (G_UNLIKELY(trace_flag))            				  \
+	  if (G_UNLIKELY(trace_flag) && msg_severity_enabled(EVT_PRI_DEBUG))      \
             msg_event_suppress_recursions_and_send(                               \
                   msg_event_create(EVT_PRI_DEBUG, desc, tag1, ##tags ));          \
 	} while (0)
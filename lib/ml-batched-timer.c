@@ -25,28 +25,173 @@
 #include "ml-batched-timer.h"
 #include "mainloop-call.h"
 
-/* callback to be invoked when the timeout triggers */
+/*
+ * Shared timer wheel for all MlBatchedTimer instances.
+ *
+ * These timers only ever carry coarse, second granularity deadlines
+ * (suppress(), mark-freq() and friends), but a configuration with tens
+ * of thousands of dynamic file writers used to keep one ivykis timer
+ * per writer registered, and re-arming them dominated the main loop's
+ * timer management.  Instead, deadlines are stored in a binary min-heap
+ * and a single ivykis timer is armed at the earliest of them; one tick
+ * fires every timer that expired in that second.  Re-arming a timer
+ * whose deadline is not the earliest doesn't touch ivykis at all.
+ *
+ * All heap manipulation happens in the main thread, just as the
+ * per-instance ivykis timer updates did before.
+ */
+
+static GPtrArray *ml_batched_timer_heap;
+static struct iv_timer ml_batched_timer_tick_timer;
+
+static void ml_batched_timer_wheel_tick(void *cookie);
+
+static inline MlBatchedTimer *
+ml_batched_timer_heap_at(gint index)
+{
+  return (MlBatchedTimer *) g_ptr_array_index(ml_batched_timer_heap, index);
+}
+
+static inline void
+ml_batched_timer_heap_set(gint index, MlBatchedTimer *timer)
+{
+  g_ptr_array_index(ml_batched_timer_heap, index) = timer;
+  timer->heap_index = index;
+}
+
+static void
+ml_batched_timer_heap_sift_up(gint index)
+{
+  MlBatchedTimer *timer = ml_batched_timer_heap_at(index);
+
+  while (index > 0)
+    {
+      gint parent = (index - 1) / 2;
+      MlBatchedTimer *parent_timer = ml_batched_timer_heap_at(parent);
+
+      if (parent_timer->heap_deadline <= timer->heap_deadline)
+        break;
+      ml_batched_timer_heap_set(index, parent_timer);
+      index = parent;
+    }
+  ml_batched_timer_heap_set(index, timer);
+}
+
+static void
+ml_batched_timer_heap_sift_down(gint index)
+{
+  MlBatchedTimer *timer = ml_batched_timer_heap_at(index);
+  gint len = ml_batched_timer_heap->len;
+
+  while (1)
+    {
+      gint child = 2 * index + 1;
+
+      if (child >= len)
+        break;
+      if (child + 1 < len &&
+          ml_batched_timer_heap_at(child + 1)->heap_deadline < ml_batched_timer_heap_at(child)->heap_deadline)
+        child++;
+      if (ml_batched_timer_heap_at(child)->heap_deadline >= timer->heap_deadline)
+        break;
+      ml_batched_timer_heap_set(index, ml_batched_timer_heap_at(child));
+      index = child;
+    }
+  ml_batched_timer_heap_set(index, timer);
+}
+
+static void
+ml_batched_timer_wheel_insert(MlBatchedTimer *self)
+{
+  if (!ml_batched_timer_heap)
+    {
+      ml_batched_timer_heap = g_ptr_array_new();
+      IV_TIMER_INIT(&ml_batched_timer_tick_timer);
+      ml_batched_timer_tick_timer.handler = ml_batched_timer_wheel_tick;
+    }
+
+  self->heap_deadline = self->expires.tv_sec;
+  g_ptr_array_add(ml_batched_timer_heap, self);
+  ml_batched_timer_heap_sift_up(ml_batched_timer_heap->len - 1);
+}
+
+static void
+ml_batched_timer_wheel_remove(MlBatchedTimer *self)
+{
+  gint index = self->heap_index;
+  MlBatchedTimer *last;
+
+  if (index < 0)
+    return;
+  self->heap_index = -1;
+
+  last = ml_batched_timer_heap_at(ml_batched_timer_heap->len - 1);
+  g_ptr_array_set_size(ml_batched_timer_heap, ml_batched_timer_heap->len - 1);
+  if (last != self)
+    {
+      ml_batched_timer_heap_set(index, last);
+      ml_batched_timer_heap_sift_up(index);
+      ml_batched_timer_heap_sift_down(last->heap_index);
+    }
+}
+
+/* (re)arm the single ivykis timer for the earliest queued deadline */
+static void
+ml_batched_timer_wheel_rearm(void)
+{
+  MlBatchedTimer *min;
+
+  if (!ml_batched_timer_heap || ml_batched_timer_heap->len == 0)
+    {
+      if (iv_timer_registered(&ml_batched_timer_tick_timer))
+        iv_timer_unregister(&ml_batched_timer_tick_timer);
+      return;
+    }
+
+  min = ml_batched_timer_heap_at(0);
+  if (iv_timer_registered(&ml_batched_timer_tick_timer))
+    {
+      if (ml_batched_timer_tick_timer.expires.tv_sec == min->heap_deadline)
+        return;
+      iv_timer_unregister(&ml_batched_timer_tick_timer);
+    }
+  ml_batched_timer_tick_timer.expires.tv_sec = min->heap_deadline;
+  ml_batched_timer_tick_timer.expires.tv_nsec = 0;
+  iv_timer_register(&ml_batched_timer_tick_timer);
+}
+
 static void
-ml_batched_timer_handle(MlBatchedTimer *self)
+ml_batched_timer_wheel_tick(void *cookie)
 {
-  self->handler(self->cookie);
+  iv_validate_now();
+
+  /* timers are popped one by one as handlers may re-arm or cancel any
+   * of the still queued ones */
+  while (ml_batched_timer_heap->len > 0)
+    {
+      MlBatchedTimer *min = ml_batched_timer_heap_at(0);
+
+      if (min->heap_deadline > iv_now.tv_sec)
+        break;
+      ml_batched_timer_wheel_remove(min);
+      min->handler(min->cookie);
+    }
+  ml_batched_timer_wheel_rearm();
 }
 
 /* function called using main_loop_call() in case the suppress timer needs
  * to be updated.  It is running in the main thread, thus is able to
- * reregister our ivykis timer */
+ * requeue our entry in the shared timer wheel */
 static void
 ml_batched_timer_perform_update(MlBatchedTimer *self)
 {
   main_loop_assert_main_thread();
 
-  if (iv_timer_registered(&self->timer))
-    iv_timer_unregister(&self->timer);
-
-  self->timer.expires = self->expires;
+  ml_batched_timer_wheel_remove(self);
 
-  if (self->timer.expires.tv_sec > 0)
-    iv_timer_register(&self->timer);
+  if (self->expires.tv_sec > 0)
+    ml_batched_timer_wheel_insert(self);
+  ml_batched_timer_wheel_rearm();
   self->unref_cookie(self->cookie);
 }
 
@@ -137,14 +282,14 @@ ml_batched_timer_cancel(MlBatchedTimer *self)
   ml_batched_timer_update(self, &next_expires);
 }
 
-/* unregister the underlying ivykis timer, can only be called from the main thread. */
+/* remove this timer from the shared wheel, can only be called from the main thread. */
 void
 ml_batched_timer_unregister(MlBatchedTimer *self)
 {
   main_loop_assert_main_thread();
 
-  if (iv_timer_registered(&self->timer))
-    iv_timer_unregister(&self->timer);
+  ml_batched_timer_wheel_remove(self);
+  ml_batched_timer_wheel_rearm();
   self->expires.tv_sec = 0;
   self->expires.tv_nsec = 0;
 }
@@ -154,9 +299,7 @@ void
 ml_batched_timer_init(MlBatchedTimer *self)
 {
   g_static_mutex_init(&self->lock);
-  IV_TIMER_INIT(&self->timer);
-  self->timer.cookie = self;
-  self->timer.handler = (void (*)(void *)) ml_batched_timer_handle;
+  self->heap_index = -1;
 }
 
 /* Free MlBatchedTimer state. */
@@ -29,12 +29,19 @@
 #include <iv.h>
 
 
-/* timer which only updates */
+/* timer which only updates, with second granularity.  Instances don't
+ * own an ivykis timer of their own: their deadlines are kept in a
+ * process wide heap driven by a single ivykis timer, so tens of
+ * thousands of writers arm and re-arm their timeouts without churning
+ * the ivykis timer list */
 typedef struct _MlBatchedTimer
 {
   GStaticMutex lock;
-  struct iv_timer timer;
   struct timespec expires;
+  /* deadline & position in the shared timer heap, main thread only;
+   * heap_index is -1 while not queued */
+  time_t heap_deadline;
+  gint heap_index;
   gpointer cookie;
   void *(*ref_cookie)(gpointer self);
   void (*unref_cookie)(gpointer self);
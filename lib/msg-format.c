@@ -26,6 +26,32 @@
 #include "cfg.h"
 #include "plugin.h"
 #include "plugin-types.h"
+#include "stats/stats-registry.h"
+
+/* number of fully formatted error reports per second; the excess only
+ * gets a terse static message, so a client spewing garbage costs us a
+ * couple of set_value calls per bad line instead of a 2k snprintf */
+#define MSG_FORMAT_PARSE_ERROR_SYNTH_LIMIT 100
+
+static StatsCounterItem *parse_errors_stats;
+static gint parse_error_synth_tokens = MSG_FORMAT_PARSE_ERROR_SYNTH_LIMIT;
+static time_t parse_error_synth_sec;
+
+/* NOTE: the token bucket is racy on purpose: concurrent readers may
+ * slightly over- or undershoot the limit around second boundaries,
+ * which is fine for suppressing a flood */
+static gboolean
+_parse_error_synth_allowed(void)
+{
+  time_t now = cached_g_current_time_sec();
+
+  if (now != parse_error_synth_sec)
+    {
+      parse_error_synth_sec = now;
+      g_atomic_int_set(&parse_error_synth_tokens, MSG_FORMAT_PARSE_ERROR_SYNTH_LIMIT);
+    }
+  return g_atomic_int_exchange_and_add(&parse_error_synth_tokens, -1) > 0;
+}
 
 void
 msg_format_inject_parse_error(LogMessage *msg, const guchar *data, gsize length)
@@ -35,25 +61,117 @@ msg_format_inject_parse_error(LogMessage *msg, const guchar *data, gsize length)
   log_msg_clear(msg);
 
   msg->timestamps[LM_TS_STAMP] = msg->timestamps[LM_TS_RECVD];
-  log_msg_set_value(msg, LM_V_HOST, "", 0);
-  g_snprintf(buf, sizeof(buf), "Error processing log message: %.*s", (gint) length, data);
-  log_msg_set_value(msg, LM_V_MESSAGE, buf, -1);
+  msg->flags |= LF_PARSE_ERROR;
+  stats_counter_inc(parse_errors_stats);
+
   log_msg_set_value(msg, LM_V_PROGRAM, "syslog-ng", 9);
-  g_snprintf(buf, sizeof(buf), "%d", (int) getpid());
-  log_msg_set_value(msg, LM_V_PID, buf, -1);
+  if (_parse_error_synth_allowed())
+    {
+      log_msg_set_value(msg, LM_V_HOST, "", 0);
+      g_snprintf(buf, sizeof(buf), "Error processing log message: %.*s", (gint) length, data);
+      log_msg_set_value(msg, LM_V_MESSAGE, buf, -1);
+      g_snprintf(buf, sizeof(buf), "%d", (int) getpid());
+      log_msg_set_value(msg, LM_V_PID, buf, -1);
+    }
+  else
+    {
+      log_msg_set_value(msg, LM_V_MESSAGE, "Error processing log message (rate limited, details suppressed)", 63);
+    }
 
   msg->pri = LOG_SYSLOG | LOG_ERR;
 }
 
+static inline gint
+_payload_size_to_bucket(gsize payload_size)
+{
+  gint bucket;
+
+  for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS - 1; bucket++)
+    {
+      if (payload_size <= (gsize) (256 << bucket))
+        break;
+    }
+  return bucket;
+}
+
+/* condense the histogram into a new initial sizing hint: the smallest
+ * bucket that covers ~98% of the recorded messages.  Racy reads of the
+ * bucket counters are fine, the hint is a heuristic. */
+static void
+_recalc_init_payload_size(MsgFormatOptions *options)
+{
+  gint samples = 0, covered = 0, target;
+  gint counts[MSG_FORMAT_PAYLOAD_HIST_BUCKETS];
+  gint bucket;
+
+  for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS; bucket++)
+    {
+      counts[bucket] = g_atomic_counter_get(&options->payload_size_hist[bucket]);
+      samples += counts[bucket];
+    }
+  if (samples == 0)
+    return;
+
+  target = samples - samples / 64;
+  for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS; bucket++)
+    {
+      covered += counts[bucket];
+      if (covered >= target)
+        break;
+    }
+  options->init_payload_size = 256 << bucket;
+}
+
+/* record the final payload size of a parsed message; called by
+ * log_msg_new() once the format parser is done */
+void
+msg_format_options_note_payload_size(MsgFormatOptions *options, gsize payload_size)
+{
+  gint bucket = _payload_size_to_bucket(payload_size);
+
+  g_atomic_counter_inc(&options->payload_size_hist[bucket]);
+  stats_counter_inc(options->payload_size_hist_stats[bucket]);
+
+  if ((g_atomic_counter_exchange_and_add(&options->payload_size_samples, 1) % MSG_FORMAT_PAYLOAD_HIST_RECALC_PERIOD) == MSG_FORMAT_PAYLOAD_HIST_RECALC_PERIOD - 1)
+    _recalc_init_payload_size(options);
+}
+
+gint
+msg_format_options_get_init_payload_size(MsgFormatOptions *options)
+{
+  return options->init_payload_size;
+}
+
 void
 msg_format_options_defaults(MsgFormatOptions *options)
 {
+  gint bucket;
+
   options->flags = LP_EXPECT_HOSTNAME | LP_STORE_LEGACY_MSGHDR;
   options->recv_time_zone = NULL;
   options->recv_time_zone_info = NULL;
   options->bad_hostname = NULL;
   options->default_pri = 0xFFFF;
   options->sdata_param_value_max = 65535;
+  for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS; bucket++)
+    {
+      g_atomic_counter_set(&options->payload_size_hist[bucket], 0);
+      options->payload_size_hist_stats[bucket] = NULL;
+    }
+  g_atomic_counter_set(&options->payload_size_samples, 0);
+  options->init_payload_size = 0;
+}
+
+static void
+_resolve_parse_function(MsgFormatOptions *options)
+{
+  if (!options->format_handler)
+    return;
+
+  if (options->format_handler->select_parse)
+    options->parse = options->format_handler->select_parse(options);
+  else
+    options->parse = options->format_handler->parse;
 }
 
 /* NOTE: _init needs to be idempotent when called multiple times w/o invoking _destroy */
@@ -63,7 +181,12 @@ msg_format_options_init(MsgFormatOptions *options, GlobalConfig *cfg)
   Plugin *p;
 
   if (options->initialized)
-    return;
+    {
+      /* the flags may have been adjusted since the first call, make
+       * sure the specialized parse function matches them */
+      _resolve_parse_function(options);
+      return;
+    }
 
   if (cfg->bad_hostname_compiled)
     options->bad_hostname = &cfg->bad_hostname;
@@ -78,6 +201,30 @@ msg_format_options_init(MsgFormatOptions *options, GlobalConfig *cfg)
   p = plugin_find(cfg, LL_CONTEXT_FORMAT, options->format);
   if (p)
     options->format_handler = plugin_construct(p, cfg, LL_CONTEXT_FORMAT, options->format);
+
+  _resolve_parse_function(options);
+
+  /* the histogram buckets are mirrored into stats counters; the tuple is
+   * the same for every source, so the published histogram aggregates all
+   * sources, while the private per-source counters drive the sizing */
+  stats_lock();
+  {
+    gchar instance[16];
+    gint bucket;
+
+    for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS; bucket++)
+      {
+        g_snprintf(instance, sizeof(instance), "%d", 256 << bucket);
+        stats_register_counter(2, SCS_GLOBAL, "payload_size_hist", instance, SC_TYPE_PROCESSED, &options->payload_size_hist_stats[bucket]);
+      }
+
+    /* process-wide counter shared by every source, registered once and
+     * kept for the lifetime of the process */
+    if (!parse_errors_stats)
+      stats_register_counter(0, SCS_GLOBAL, "parse_errors", NULL, SC_TYPE_PROCESSED, &parse_errors_stats);
+  }
+  stats_unlock();
+
   options->initialized = TRUE;
 }
 
@@ -99,6 +246,22 @@ msg_format_options_destroy(MsgFormatOptions *options)
       time_zone_info_free(options->recv_time_zone_info);
       options->recv_time_zone_info = NULL;
     }
+
+  stats_lock();
+  {
+    gchar instance[16];
+    gint bucket;
+
+    for (bucket = 0; bucket < MSG_FORMAT_PAYLOAD_HIST_BUCKETS; bucket++)
+      {
+        if (!options->payload_size_hist_stats[bucket])
+          continue;
+        g_snprintf(instance, sizeof(instance), "%d", 256 << bucket);
+        stats_unregister_counter(SCS_GLOBAL, "payload_size_hist", instance, SC_TYPE_PROCESSED, &options->payload_size_hist_stats[bucket]);
+      }
+  }
+  stats_unlock();
+
   options->initialized = FALSE;
 }
 
@@ -115,6 +278,7 @@ CfgFlagHandler msg_format_flag_handlers[] =
   { "dont-store-legacy-msghdr", CFH_CLEAR, offsetof(MsgFormatOptions, flags), LP_STORE_LEGACY_MSGHDR },
   { "expect-hostname",            CFH_SET, offsetof(MsgFormatOptions, flags), LP_EXPECT_HOSTNAME },
   { "no-hostname",              CFH_CLEAR, offsetof(MsgFormatOptions, flags), LP_EXPECT_HOSTNAME },
+  { "lazy-sdata",                 CFH_SET, offsetof(MsgFormatOptions, flags), LP_LAZY_SDATA },
 
   { NULL },
 };
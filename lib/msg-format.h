@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "timeutils.h"
 #include "logproto/logproto-server.h"
+#include "atomic.h"
+#include "stats/stats-counter.h"
 
 #include <regex.h>
 
@@ -53,22 +55,55 @@ enum
   LP_EXPECT_HOSTNAME = 0x0100,
   /* message is locally generated and should be marked with LF_LOCAL */
   LP_LOCAL = 0x0200,
+  /* store RFC5424 structured data as a single raw value and only
+   * materialize the individual .SDATA.* entries when something asks for
+   * them.  Name-value iteration (e.g.  value-pairs) does not see the
+   * entries until they are materialized, see LF_LAZY_SDATA in logmsg.h */
+  LP_LAZY_SDATA = 0x0400,
 };
 
 typedef struct _MsgFormatHandler MsgFormatHandler;
+typedef struct _MsgFormatOptions MsgFormatOptions;
 
-typedef struct _MsgFormatOptions
+typedef void (*MsgFormatParseFunc)(const MsgFormatOptions *options, const guchar *data, gsize length, LogMessage *msg);
+
+/* number of power-of-two histogram buckets for final payload sizes,
+ * bucket i counts messages that fit into (256 << i) bytes */
+#define MSG_FORMAT_PAYLOAD_HIST_BUCKETS 9
+
+/* number of recorded payload sizes between two recomputations of the
+ * initial sizing hint */
+#define MSG_FORMAT_PAYLOAD_HIST_RECALC_PERIOD 1024
+
+struct _MsgFormatOptions
 {
   gboolean initialized;
   gchar *format;
   MsgFormatHandler *format_handler;
+
+  /* parse function resolved by msg_format_options_init(): either a
+   * variant the format handler specialized for our flags or its generic
+   * parse method, so the per-message path dispatches through a single
+   * pointer without re-checking flag bits */
+  MsgFormatParseFunc parse;
   guint32 flags;
   guint16 default_pri;
   gchar *recv_time_zone;
   TimeZoneInfo *recv_time_zone_info;
   regex_t *bad_hostname;
   gint sdata_param_value_max;
-} MsgFormatOptions;
+
+  /* running histogram of the final payload sizes produced by this
+   * source's parser; periodically condensed into init_payload_size,
+   * which feeds back into the initial NVTable sizing performed by
+   * log_msg_new() so the common message never needs a mid-parse
+   * realloc.  The buckets are mirrored into shared stats counters, see
+   * msg_format_options_init(). */
+  GAtomicCounter payload_size_hist[MSG_FORMAT_PAYLOAD_HIST_BUCKETS];
+  GAtomicCounter payload_size_samples;
+  gint init_payload_size;
+  StatsCounterItem *payload_size_hist_stats[MSG_FORMAT_PAYLOAD_HIST_BUCKETS];
+};
 
 struct _MsgFormatHandler
 {
@@ -77,13 +112,21 @@ struct _MsgFormatHandler
    * the "pacct" plugin to set the record length the proper size
    */
   LogProtoServer *(*construct_proto)(const MsgFormatOptions *options, LogTransport *transport, const LogProtoServerOptions *proto_options);
-  void (*parse)(const MsgFormatOptions *options, const guchar *data, gsize length, LogMessage *msg);
+  MsgFormatParseFunc parse;
+
+  /* optional: return a parse function specialized at config time for
+   * the flags in @options, hoisting per-message flag checks out of the
+   * parse path.  When NULL the generic parse method above is used. */
+  MsgFormatParseFunc (*select_parse)(const MsgFormatOptions *options);
 };
 
 void msg_format_options_defaults(MsgFormatOptions *options);
 void msg_format_options_init(MsgFormatOptions *parse_options, GlobalConfig *cfg);
 void msg_format_options_destroy(MsgFormatOptions *parse_options);
 
+void msg_format_options_note_payload_size(MsgFormatOptions *options, gsize payload_size);
+gint msg_format_options_get_init_payload_size(MsgFormatOptions *options);
+
 gboolean msg_format_options_process_flag(MsgFormatOptions *options, gchar *flag);
 
 void msg_format_inject_parse_error(LogMessage *msg, const guchar *data, gsize length);
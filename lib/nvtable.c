@@ -23,6 +23,8 @@
  */
 #include "nvtable.h"
 #include "messages.h"
+#include "memusage.h"
+#include "fasthash.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -127,7 +129,7 @@ nv_registry_new(const gchar **static_names)
   NVRegistry *self = g_new0(NVRegistry, 1);
   gint i;
 
-  self->name_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->name_map = g_hash_table_new_full(fast_hash_g_str, g_str_equal, g_free, NULL);
   self->names = g_array_new(FALSE, FALSE, sizeof(NVHandleDesc));
   for (i = 0; static_names[i]; i++)
     {
@@ -144,6 +146,83 @@ nv_registry_free(NVRegistry *self)
   g_free(self);
 }
 
+/*
+ * Intern pool for high-repetition values (hostnames, program names): a
+ * typical installation sees the same couple of thousand strings over and
+ * over again, storing them once and referencing them by id from the
+ * payloads saves both the per-message bytes and the memcpy on every set.
+ *
+ * Insertion takes nv_intern_lock, lookups are lock-free: ids are only
+ * handed out after the string pointer has been stored in its block, pool
+ * strings are never freed, and an id only reaches another thread embedded
+ * in a LogMessage passed through a queue, which synchronizes memory.  The
+ * two-level block array exists so that growing the pool never moves
+ * entries a concurrent reader may be dereferencing.
+ */
+#define NV_INTERN_MAX_VALUE_LEN 255
+#define NV_INTERN_BLOCK_SHIFT 10
+#define NV_INTERN_BLOCK_SIZE (1 << NV_INTERN_BLOCK_SHIFT)
+#define NV_INTERN_MAX_BLOCKS 256
+
+static GStaticMutex nv_intern_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *nv_intern_ids;
+static gchar **nv_intern_blocks[NV_INTERN_MAX_BLOCKS];
+static guint32 nv_intern_count;
+
+guint32
+nv_intern_string(const gchar *value, gsize value_len)
+{
+  gchar key[NV_INTERN_MAX_VALUE_LEN + 1];
+  gchar *stored;
+  gpointer p;
+  guint32 id = 0;
+
+  if (value_len > NV_INTERN_MAX_VALUE_LEN || memchr(value, 0, value_len))
+    return 0;
+
+  memcpy(key, value, value_len);
+  key[value_len] = 0;
+
+  g_static_mutex_lock(&nv_intern_lock);
+  if (G_UNLIKELY(!nv_intern_ids))
+    nv_intern_ids = g_hash_table_new(fast_hash_g_str, g_str_equal);
+
+  p = g_hash_table_lookup(nv_intern_ids, key);
+  if (p)
+    {
+      id = GPOINTER_TO_UINT(p);
+      goto exit;
+    }
+
+  /* a full pool means the traffic is not as repetitive as interning
+   * assumes, callers simply keep storing such values inline */
+  if (nv_intern_count >= NV_INTERN_MAX_BLOCKS * NV_INTERN_BLOCK_SIZE)
+    goto exit;
+
+  if (!nv_intern_blocks[nv_intern_count >> NV_INTERN_BLOCK_SHIFT])
+    nv_intern_blocks[nv_intern_count >> NV_INTERN_BLOCK_SHIFT] = g_new0(gchar *, NV_INTERN_BLOCK_SIZE);
+  stored = g_strdup(key);
+  nv_intern_blocks[nv_intern_count >> NV_INTERN_BLOCK_SHIFT][nv_intern_count & (NV_INTERN_BLOCK_SIZE - 1)] = stored;
+
+  /* ids start at 1, 0 means "not interned" */
+  nv_intern_count++;
+  id = nv_intern_count;
+  g_hash_table_insert(nv_intern_ids, stored, GUINT_TO_POINTER(id));
+ exit:
+  g_static_mutex_unlock(&nv_intern_lock);
+  return id;
+}
+
+const gchar *
+nv_intern_lookup(guint32 intern_id)
+{
+  guint32 ndx = intern_id - 1;
+
+  if (G_UNLIKELY(!intern_id || intern_id > nv_intern_count))
+    return null_string;
+  return nv_intern_blocks[ndx >> NV_INTERN_BLOCK_SHIFT][ndx & (NV_INTERN_BLOCK_SIZE - 1)];
+}
+
 /* clonable LogMessage support with shared data pointers */
 
 static inline gchar *
@@ -182,6 +261,7 @@ nv_table_alloc_value(NVTable *self, gsize alloc_size)
   entry->alloc_len = alloc_size;
   entry->indirect = FALSE;
   entry->referenced = FALSE;
+  entry->interned = FALSE;
   return entry;
 }
 
@@ -212,6 +292,12 @@ nv_table_resolve_entry(NVTable *self, NVEntry *entry, gssize *length)
 {
   if (!entry->indirect)
     {
+      if (G_UNLIKELY(entry->interned))
+        {
+          if (length)
+            *length = entry->vinterned.value_len;
+          return nv_intern_lookup(entry->vinterned.intern_id);
+        }
       if (length)
         *length = entry->vdirect.value_len;
       return entry->vdirect.data + entry->name_len + 1;
@@ -399,7 +485,7 @@ nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name
     {
       gchar *dst;
       /* this value already exists and the new value fits in the old space */
-      if (!entry->indirect)
+      if (!entry->indirect && !entry->interned)
         {
           dst = entry->vdirect.data + entry->name_len + 1;
 
@@ -409,8 +495,9 @@ nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name
         }
       else
         {
-          /* this was an indirect entry, convert it */
+          /* this was an indirect or interned entry, convert it */
           entry->indirect = 0;
+          entry->interned = 0;
           entry->vdirect.value_len = value_len;
           entry->name_len = name_len;
           memmove(entry->vdirect.data, name, name_len + 1);
@@ -449,6 +536,82 @@ nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name
   return TRUE;
 }
 
+gboolean
+nv_table_add_value_interned(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, const gchar *value, gsize value_len, gboolean *new_entry)
+{
+  NVEntry *entry;
+  guint32 ofs;
+  NVDynValue *dyn_slot;
+  guint32 intern_id;
+
+  intern_id = nv_intern_string(value, value_len);
+  if (!intern_id)
+    return nv_table_add_value(self, handle, name, name_len, value, value_len, new_entry);
+
+  if (new_entry)
+    *new_entry = FALSE;
+  entry = nv_table_get_entry(self, handle, &dyn_slot);
+  if (G_UNLIKELY(!entry && !new_entry && value_len == 0))
+    {
+      /* see nv_table_add_value() for why zero length values are skipped */
+      return TRUE;
+    }
+  if (G_UNLIKELY(entry && !entry->indirect && entry->referenced))
+    {
+      gpointer data[2] = { self, GUINT_TO_POINTER((glong) handle) };
+
+      if (nv_table_foreach_entry(self, nv_table_make_direct, data))
+        {
+          /* we had to stop iteration, which means that we were unable
+           * to allocate enough space for making indirect entries
+           * direct */
+          return FALSE;
+        }
+    }
+  if (G_UNLIKELY(entry && (((guint) entry->alloc_len)) >= NV_ENTRY_INTERNED_HDR + name_len + 1))
+    {
+      /* this value already exists and the interned reference fits in the
+       * old space, whatever layout the entry had before */
+      entry->indirect = 0;
+      entry->interned = 1;
+      entry->vinterned.value_len = value_len;
+      entry->vinterned.intern_id = intern_id;
+      if (handle >= self->num_static_entries)
+        {
+          entry->name_len = name_len;
+          memmove(entry->vinterned.name, name, name_len + 1);
+        }
+      else
+        entry->name_len = 0;
+      return TRUE;
+    }
+  else if (!entry && new_entry)
+    *new_entry = TRUE;
+
+  if (!nv_table_reserve_table_entry(self, handle, &dyn_slot))
+    return FALSE;
+  entry = nv_table_alloc_value(self, NV_ENTRY_INTERNED_HDR + name_len + 1);
+  if (G_UNLIKELY(!entry))
+    {
+      return FALSE;
+    }
+
+  ofs = nv_table_get_dyn_value_offset_from_nventry(self, entry);
+  entry->interned = 1;
+  entry->vinterned.value_len = value_len;
+  entry->vinterned.intern_id = intern_id;
+  if (handle >= self->num_static_entries)
+    {
+      entry->name_len = name_len;
+      memmove(entry->vinterned.name, name, name_len + 1);
+    }
+  else
+    entry->name_len = 0;
+
+  nv_table_set_table_entry(self, handle, ofs, dyn_slot);
+  return TRUE;
+}
+
 gboolean
 nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, NVHandle ref_handle, guint8 type, guint32 rofs, guint32 rlen, gboolean *new_entry)
 {
@@ -459,13 +622,34 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
   if (new_entry)
     *new_entry = FALSE;
   ref_entry = nv_table_get_entry(self, ref_handle, &dyn_slot);
+  if (ref_entry && ref_entry->indirect && handle != ref_handle && ref_entry->vindirect.handle != handle)
+    {
+      /* the to-be-referenced value is itself an indirect entry: rebase
+       * this reference onto the direct entry it points into, keeping
+       * substring-of-substring chains (e.g. kv-parser over a csv-parser
+       * column) zero-copy instead of flattening them */
+      guint32 ref_len = ref_entry->vindirect.len;
+
+      if (rofs > ref_len)
+        {
+          rofs = 0;
+          rlen = 0;
+        }
+      else
+        {
+          rlen = MIN(rofs + rlen, ref_len) - rofs;
+        }
+      rofs += ref_entry->vindirect.ofs;
+      ref_handle = ref_entry->vindirect.handle;
+      ref_entry = nv_table_get_entry(self, ref_handle, &dyn_slot);
+    }
   if ((ref_entry && ref_entry->indirect) || handle == ref_handle)
     {
       const gchar *ref_value;
       gssize ref_length;
 
       /* NOTE: uh-oh, the to-be-referenced value is already an indirect
-       * reference, this is not supported, copy the stuff */
+       * reference and could not be rebased, copy the stuff */
 
       ref_value = nv_table_resolve_entry(self, ref_entry, &ref_length);
 
@@ -510,6 +694,7 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
         {
           /* previously a non-indirect entry, convert it */
           entry->indirect = 1;
+          entry->interned = 0;
           if (handle >= self->num_static_entries)
             {
               entry->name_len = name_len;
@@ -637,6 +822,7 @@ nv_table_new(gint num_static_entries, gint num_dyn_values, gint init_length)
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, num_dyn_values, init_length);
   self = (NVTable *) g_malloc(alloc_length);
+  memusage_count_alloc(MEMUSAGE_NVTABLE, alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -671,6 +857,7 @@ nv_table_realloc(NVTable *self, NVTable **new)
   if (self->ref_cnt == 1 && !self->borrowed)
     {
       *new = self = g_realloc(self, new_size);
+      memusage_count_alloc(MEMUSAGE_NVTABLE, new_size - old_size);
 
       self->size = new_size;
       /* move the downwards growing region to the end of the new buffer */
@@ -681,6 +868,7 @@ nv_table_realloc(NVTable *self, NVTable **new)
   else
     {
       *new = g_malloc(new_size);
+      memusage_count_alloc(MEMUSAGE_NVTABLE, new_size);
 
       /* we only copy the header first */
       memcpy(*new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->num_dyn_entries * sizeof(NVDynValue));
@@ -709,6 +897,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
+      memusage_count_free(MEMUSAGE_NVTABLE, self->size);
       g_free(self);
     }
 }
@@ -735,6 +924,7 @@ nv_table_clone(NVTable *self, gint additional_space)
     new_size = NV_TABLE_MAX_BYTES;
 
   new = g_malloc(new_size);
+  memusage_count_alloc(MEMUSAGE_NVTABLE, new_size);
   memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->num_dyn_entries * sizeof(NVDynValue));
   new->size = new_size;
   new->ref_cnt = 1;
@@ -746,3 +936,89 @@ nv_table_clone(NVTable *self, gint additional_space)
 
   return new;
 }
+
+static gboolean
+nv_table_materialize_count(NVHandle handle, NVEntry *entry, gpointer user_data)
+{
+  gsize *extra = (gsize *) user_data;
+
+  if (entry->interned)
+    *extra += NV_TABLE_BOUND(NV_ENTRY_DIRECT_HDR + entry->name_len + entry->vinterned.value_len + 2);
+  return FALSE;
+}
+
+typedef struct _NVTableMaterializeState
+{
+  NVTable *src;
+  NVTable *dst;
+  gboolean indirect_pass;
+} NVTableMaterializeState;
+
+static gboolean
+nv_table_materialize_entry(NVHandle handle, NVEntry *entry, gpointer user_data)
+{
+  NVTableMaterializeState *state = (NVTableMaterializeState *) user_data;
+  const gchar *value;
+  gssize value_len;
+  gboolean added;
+
+  if ((!!entry->indirect) != state->indirect_pass)
+    return FALSE;
+
+  while (1)
+    {
+      gboolean success;
+
+      if (entry->indirect)
+        {
+          success = nv_table_add_value_indirect(state->dst, handle, nv_entry_get_name(entry), entry->name_len,
+                                                entry->vindirect.handle, entry->vindirect.type,
+                                                entry->vindirect.ofs, entry->vindirect.len, &added);
+        }
+      else
+        {
+          value = nv_table_resolve_entry(state->src, entry, &value_len);
+          success = nv_table_add_value(state->dst, handle, nv_entry_get_name(entry), entry->name_len, value, value_len, &added);
+        }
+      if (success)
+        return FALSE;
+      if (!nv_table_realloc(state->dst, &state->dst))
+        return TRUE;
+    }
+}
+
+/**
+ * nv_table_materialize_interned:
+ *
+ * Interned entries only store an id into the process-wide pool, which is
+ * meaningless outside this process, so serialization needs a copy where
+ * every value is stored inline.  Returns a new table with all interned
+ * entries converted to direct ones, or NULL if there was nothing to
+ * convert (or the copy would not fit NV_TABLE_MAX_BYTES).
+ **/
+NVTable *
+nv_table_materialize_interned(NVTable *self)
+{
+  NVTableMaterializeState state;
+  gsize extra = 0;
+
+  nv_table_foreach_entry(self, nv_table_materialize_count, &extra);
+  if (!extra)
+    return NULL;
+
+  state.src = self;
+  state.dst = nv_table_new(self->num_static_entries, self->num_dyn_entries, self->used + extra);
+  state.indirect_pass = FALSE;
+  if (nv_table_foreach_entry(self, nv_table_materialize_entry, &state))
+    goto error;
+
+  /* indirect entries go in a second pass so that every entry they
+   * reference is already in place */
+  state.indirect_pass = TRUE;
+  if (nv_table_foreach_entry(self, nv_table_materialize_entry, &state))
+    goto error;
+  return state.dst;
+ error:
+  nv_table_unref(state.dst);
+  return NULL;
+}
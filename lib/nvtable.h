@@ -105,7 +105,7 @@ struct _NVEntry
   /* negative offset, counting from string table top, e.g. start of the string is at @top + ofs */
   union {
     struct {
-      guint8 indirect:1, referenced:1;
+      guint8 indirect:1, referenced:1, interned:1;
     };
     guint8 flags;
   };
@@ -127,17 +127,28 @@ struct _NVEntry
       guint8 type;
       gchar name[0];
     } vindirect;
+    struct
+    {
+      /* the value bytes live in the process-wide intern pool, only its id
+       * is stored here, see nv_intern_string() */
+      guint32 value_len;
+      guint32 intern_id;
+      gchar name[0];
+    } vinterned;
   };
 };
 
 #define NV_ENTRY_DIRECT_HDR ((gsize) (&((NVEntry *) NULL)->vdirect.data))
 #define NV_ENTRY_INDIRECT_HDR (sizeof(NVEntry))
+#define NV_ENTRY_INTERNED_HDR ((gsize) (&((NVEntry *) NULL)->vinterned.name))
 
 static inline const gchar *
 nv_entry_get_name(NVEntry *self)
 {
   if (self->indirect)
     return self->vindirect.name;
+  else if (self->interned)
+    return self->vinterned.name;
   else
     return self->vdirect.data;
 }
@@ -216,8 +227,18 @@ struct _NVTable
 #define NV_TABLE_MAX_BYTES  (256*1024*1024)
 
 gboolean nv_table_add_value(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, const gchar *value, gsize value_len, gboolean *new_entry);
+gboolean nv_table_add_value_interned(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, const gchar *value, gsize value_len, gboolean *new_entry);
 gboolean nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, gsize name_len, NVHandle ref_handle, guint8 type, guint32 ofs, guint32 len, gboolean *new_entry);
 
+/* process-wide string intern pool for high-repetition values (hostnames,
+ * program names).  Returns the id of the pooled copy or 0 if the value is
+ * not internable (too long, embedded NUL or the pool is full), in which
+ * case the caller falls back to plain direct storage. */
+guint32 nv_intern_string(const gchar *value, gsize value_len);
+const gchar *nv_intern_lookup(guint32 intern_id);
+
+NVTable *nv_table_materialize_interned(NVTable *self);
+
 gboolean nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, gpointer user_data);
 gboolean nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data);
 
@@ -309,6 +330,12 @@ __nv_table_get_value(NVTable *self, NVHandle handle, guint16 num_static_entries,
 
   if (!entry->indirect)
     {
+      if (G_UNLIKELY(entry->interned))
+        {
+          if (length)
+            *length = entry->vinterned.value_len;
+          return nv_intern_lookup(entry->vinterned.intern_id);
+        }
       if (length)
         *length = entry->vdirect.value_len;
       return entry->vdirect.data + entry->name_len + 1;
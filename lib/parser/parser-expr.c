@@ -46,6 +46,7 @@ log_parser_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   if (G_LIKELY(!self->template))
     {
       NVTable *payload = nv_table_ref(msg->payload);
+      NVTable *payload_overlay = msg->payload_overlay ? nv_table_ref(msg->payload_overlay) : NULL;
       const gchar *value;
       gssize value_len;
 
@@ -55,11 +56,15 @@ log_parser_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
        * it'll always _move_ the structure and leave the old one intact,
        * until its refcounter drops to zero.  If that wouldn't be the case,
        * nv_table_realloc() could make our payload pointer and the
-       * LM_V_MESSAGE pointer we pass to process() go stale.
+       * LM_V_MESSAGE pointer we pass to process() go stale.  The value may
+       * come from the payload overlay of a cloned message, so that is
+       * pinned the same way.
        */
 
       value = log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
       success = self->process(self, &msg, path_options, value, value_len);
+      if (payload_overlay)
+        nv_table_unref(payload_overlay);
       nv_table_unref(payload);
     }
   else
@@ -253,7 +253,14 @@ _alloc_value(PersistState *self, guint32 orig_size, gboolean in_use, guint8 vers
 
   if (self->current_ofs + size + sizeof(PersistValueHeader) > self->current_size)
     {
-      if (!_grow_store(self, self->current_size + sizeof(PersistValueHeader) + size))
+      /* grow geometrically: every _grow_store() extends the file and
+       * remaps it, which gets painfully slow when tens of thousands of
+       * entries trigger it one page at a time */
+      guint32 new_size = self->current_size * 2;
+
+      while (new_size < self->current_ofs + size + sizeof(PersistValueHeader))
+        new_size *= 2;
+      if (!_grow_store(self, new_size))
         return 0;
     }
 
@@ -521,6 +528,13 @@ _load_v4(PersistState *self, gboolean load_all_entries)
     }
   header = (PersistFileHeader *) map;
 
+  /* the surviving entries of the old file fit into about as much space as
+   * the old file itself, so grow the new store once up front instead of
+   * remapping it again and again while the entries are copied; if this
+   * fails we fall back to growing on demand in _alloc_value() */
+  if ((guint32) file_size > self->current_size)
+    _grow_store(self, file_size);
+
   key_block = ((gchar *) map) + offsetof(PersistFileHeader, initial_key_store);
   key_size = sizeof((((PersistFileHeader *) NULL))->initial_key_store);
 
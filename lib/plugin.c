@@ -28,6 +28,7 @@
 #include "cfg-lexer.h"
 #include "plugin-types.h"
 #include "pathutils.h"
+#include "timeutils.h"
 
 #include <gmodule.h>
 #include <string.h>
@@ -84,6 +85,34 @@ plugin_candidate_free(PluginCandidate *self)
   g_free(self);
 }
 
+/* Discovering candidate plugins means dlopening every shared object in
+ * module-path just to read its module_info, which dominates config load
+ * time.  The .so files don't change under a running process, so the
+ * result of that discovery is cached for the lifetime of the process and
+ * reloads are served from the cache without touching the loader. */
+
+typedef struct _PluginCandidateCacheEntry
+{
+  gint type;
+  gchar *name;
+  gint preference;
+} PluginCandidateCacheEntry;
+
+/* module_name -> GList of PluginCandidateCacheEntry, a NULL list means
+ * the file was not a syslog-ng module */
+static GHashTable *candidate_module_cache;
+
+static PluginCandidateCacheEntry *
+plugin_candidate_cache_entry_new(gint plugin_type, const gchar *name, gint preference)
+{
+  PluginCandidateCacheEntry *self = g_new0(PluginCandidateCacheEntry, 1);
+
+  self->type = plugin_type;
+  self->name = g_strdup(name);
+  self->preference = preference;
+  return self;
+}
+
 static Plugin *
 plugin_find_in_list(GlobalConfig *cfg, GList *head, gint plugin_type, const gchar *plugin_name)
 {
@@ -249,7 +278,7 @@ plugin_get_module_init_name(const gchar *module_name)
 }
 
 static GModule *
-plugin_dlopen_module(const gchar *module_name, const gchar *module_path)
+plugin_dlopen_module(const gchar *module_name, const gchar *module_path, GModuleFlags flags)
 {
   gchar *plugin_module_name = NULL;
   gchar **module_path_dirs, *p, *dot;
@@ -309,7 +338,7 @@ plugin_dlopen_module(const gchar *module_name, const gchar *module_path)
             evt_tag_str("filename", plugin_module_name),
             NULL);
 
-  mod = g_module_open(plugin_module_name, G_MODULE_BIND_LAZY);
+  mod = g_module_open(plugin_module_name, flags);
   g_free(plugin_module_name);
   if (!mod)
     {
@@ -332,6 +361,9 @@ plugin_load_module(const gchar *module_name, GlobalConfig *cfg, CfgArgs *args)
   const gchar *mp;
   gboolean result;
   ModuleInfo *module_info;
+  GTimeVal load_start, load_end;
+
+  g_get_current_time(&load_start);
 
   /* lookup in the main executable */
   if (!main_module_handle)
@@ -353,7 +385,11 @@ plugin_load_module(const gchar *module_name, GlobalConfig *cfg, CfgArgs *args)
   if (!mp)
     mp = module_path;
 
-  mod = plugin_dlopen_module(module_name, mp);
+  /* modules loaded here stay resident, so bind all their symbols now
+   * instead of lazily: the relocation cost is paid at startup rather
+   * than as PLT resolver stalls on the first messages passing through
+   * the freshly loaded drivers */
+  mod = plugin_dlopen_module(module_name, mp, 0);
   if (!mod)
     {
       g_free(module_init_func);
@@ -382,9 +418,11 @@ plugin_load_module(const gchar *module_name, GlobalConfig *cfg, CfgArgs *args)
  call_init:
   g_free(module_init_func);
   result = (*init_func)(cfg, args);
+  g_get_current_time(&load_end);
   if (result)
     msg_verbose("Module loaded and initialized successfully",
                evt_tag_str("module", module_name),
+               evt_tag_long("load_time_usec", g_time_val_diff(&load_end, &load_start)),
                NULL);
   else
     msg_error("Module initialization failed",
@@ -393,12 +431,75 @@ plugin_load_module(const gchar *module_name, GlobalConfig *cfg, CfgArgs *args)
   return result;
 }
 
+static void
+plugin_register_cached_candidates(GlobalConfig *cfg, const gchar *module_name, GList *entries)
+{
+  GList *l;
+
+  for (l = entries; l; l = g_list_next(l))
+    {
+      PluginCandidateCacheEntry *entry = l->data;
+      PluginCandidate *candidate_plugin;
+
+      candidate_plugin = (PluginCandidate *) plugin_find_in_list(cfg, cfg->candidate_plugins, entry->type, entry->name);
+
+      msg_debug("Registering candidate plugin",
+                evt_tag_str("module", module_name),
+                evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(entry->type)),
+                evt_tag_str("name", entry->name),
+                evt_tag_int("preference", entry->preference),
+                NULL);
+      if (candidate_plugin)
+        {
+          if (candidate_plugin->preference < entry->preference)
+            {
+              plugin_candidate_set_module_name(candidate_plugin, module_name);
+              plugin_candidate_set_preference(candidate_plugin, entry->preference);
+            }
+        }
+      else
+        {
+          cfg->candidate_plugins = g_list_prepend(cfg->candidate_plugins, plugin_candidate_new(entry->type, entry->name, module_name, entry->preference));
+        }
+    }
+}
+
+static GList *
+plugin_discover_candidates(const gchar *module_name)
+{
+  GModule *mod;
+  ModuleInfo *module_info;
+  GList *entries = NULL;
+  gint j;
+
+  /* only module_info is read before the module is closed again, lazy
+   * binding is the cheapest way to get at it */
+  mod = plugin_dlopen_module(module_name, module_path, G_MODULE_BIND_LAZY);
+  module_info = plugin_get_module_info(mod);
+
+  if (module_info)
+    {
+      for (j = 0; j < module_info->plugins_len; j++)
+        {
+          Plugin *plugin = &module_info->plugins[j];
+
+          entries = g_list_prepend(entries,
+                                   plugin_candidate_cache_entry_new(plugin->type, plugin->name, module_info->preference));
+        }
+    }
+  if (mod)
+    g_module_close(mod);
+  return entries;
+}
+
 void
 plugin_load_candidate_modules(GlobalConfig *cfg)
 {
-  GModule *mod;
   gchar **mod_paths;
-  gint i, j;
+  gint i;
+
+  if (!candidate_module_cache)
+    candidate_module_cache = g_hash_table_new(g_str_hash, g_str_equal);
 
   mod_paths = g_strsplit(module_path ? : "", G_SEARCHPATH_SEPARATOR_S, 0);
   for (i = 0; mod_paths[i]; i++)
@@ -417,54 +518,24 @@ plugin_load_candidate_modules(GlobalConfig *cfg)
           if (g_str_has_suffix(fname, G_MODULE_SUFFIX))
             {
               gchar *module_name;
-              ModuleInfo *module_info;
+              GList *entries;
 
               if (g_str_has_prefix(fname, "lib"))
                 fname += 3;
               module_name = g_strndup(fname, (gint) (strlen(fname) - strlen(G_MODULE_SUFFIX) - 1));
 
-              msg_debug("Reading shared object for a candidate module",
-                        evt_tag_str("path", mod_paths[i]),
-                        evt_tag_str("fname", fname),
-                        evt_tag_str("module", module_name),
-                        NULL);
-              mod = plugin_dlopen_module(module_name, module_path);
-              module_info = plugin_get_module_info(mod);
-
-              if (module_info)
+              if (!g_hash_table_lookup_extended(candidate_module_cache, module_name, NULL, (gpointer *) &entries))
                 {
-                  for (j = 0; j < module_info->plugins_len; j++)
-                    {
-                      Plugin *plugin = &module_info->plugins[j];
-                      PluginCandidate *candidate_plugin;
-
-                      candidate_plugin = (PluginCandidate *) plugin_find_in_list(cfg, cfg->candidate_plugins, plugin->type, plugin->name);
-
-                      msg_debug("Registering candidate plugin",
-                                evt_tag_str("module", module_name),
-                                evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->type)),
-                                evt_tag_str("name", plugin->name),
-                                evt_tag_int("preference", module_info->preference),
-                                NULL);
-                      if (candidate_plugin)
-                        {
-                          if (candidate_plugin->preference < module_info->preference)
-                            {
-                              plugin_candidate_set_module_name(candidate_plugin, module_name);
-                              plugin_candidate_set_preference(candidate_plugin, module_info->preference);
-                            }
-                        }
-                      else
-                        {
-                          cfg->candidate_plugins = g_list_prepend(cfg->candidate_plugins, plugin_candidate_new(plugin->type, plugin->name, module_name, module_info->preference));
-                        }
-                    }
+                  msg_debug("Reading shared object for a candidate module",
+                            evt_tag_str("path", mod_paths[i]),
+                            evt_tag_str("fname", fname),
+                            evt_tag_str("module", module_name),
+                            NULL);
+                  entries = plugin_discover_candidates(module_name);
+                  g_hash_table_insert(candidate_module_cache, g_strdup(module_name), entries);
                 }
+              plugin_register_cached_candidates(cfg, module_name, entries);
               g_free(module_name);
-              if (mod)
-                g_module_close(mod);
-              else
-                mod = NULL;
             }
         }
       g_dir_close(dir);
@@ -508,7 +579,7 @@ plugin_list_modules(FILE *out, gboolean verbose)
                 fname += 3;
               module_name = g_strndup(fname, (gint) (strlen(fname) - strlen(G_MODULE_SUFFIX) - 1));
 
-              mod = plugin_dlopen_module(module_name, module_path);
+              mod = plugin_dlopen_module(module_name, module_path, G_MODULE_BIND_LAZY);
               module_info = plugin_get_module_info(mod);
               if (verbose)
                 {
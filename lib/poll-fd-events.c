@@ -22,16 +22,83 @@
  *
  */
 #include "poll-fd-events.h"
+#include "stats/stats-registry.h"
+#include "timeutils.h"
 
 #include <iv.h>
 
+/* number of back-to-back readiness dispatches a continuously ready fd may
+ * receive before it is forced to yield a loop pass to its peers, see
+ * poll_fd_events_dispatch() */
+#define POLL_FD_EVENTS_DISPATCH_BUDGET 8
+
+/* a gap of at least this much between two dispatches means the fd is not
+ * flooding, the budget above starts over */
+#define POLL_FD_EVENTS_BURST_RESET_USEC 1000
+
 typedef struct _PollFdEvents
 {
   PollEvents super;
   struct iv_fd fd_watch;
+  /* explicit re-queue of an over-budget fd, runs the suppressed callback
+   * on the next loop pass */
+  struct iv_task requeue_task;
+  gint dispatch_count;
+  GTimeVal last_dispatch;
 } PollFdEvents;
 
-#define IV_FD_CALLBACK(x) ((void (*)(void *)) (x))
+/* time spent in readiness callbacks, in microseconds; together with the
+ * dispatch count this exposes how long loop iterations are stalled by
+ * individual fds */
+static StatsCounterItem *count_dispatch_usec;
+static StatsCounterItem *count_dispatch_requeues;
+
+/* Readiness dispatch with a per-fd budget.  ivykis invokes each ready
+ * fd's handler once per loop pass, but a flooding peer is ready on every
+ * pass and its callback (e.g. a reader draining fetch_limit messages)
+ * dominates the iteration, inflating the latency of quiet fds sharing
+ * the loop.  After POLL_FD_EVENTS_DISPATCH_BUDGET back-to-back passes
+ * the callback is re-queued through an iv_task instead: the rest of the
+ * ready fds are served first and the loop polls again before the busy fd
+ * gets its next slice. */
+static void
+poll_fd_events_dispatch(gpointer s)
+{
+  PollFdEvents *self = (PollFdEvents *) s;
+  GTimeVal dispatch_start, dispatch_end;
+
+  if (iv_task_registered(&self->requeue_task))
+    return;
+
+  g_get_current_time(&dispatch_start);
+  if (g_time_val_diff(&dispatch_start, &self->last_dispatch) >= POLL_FD_EVENTS_BURST_RESET_USEC)
+    self->dispatch_count = 0;
+
+  if (self->dispatch_count >= POLL_FD_EVENTS_DISPATCH_BUDGET)
+    {
+      self->dispatch_count = 0;
+      stats_counter_inc(count_dispatch_requeues);
+      iv_task_register(&self->requeue_task);
+      return;
+    }
+  self->dispatch_count++;
+
+  poll_events_invoke_callback(&self->super);
+
+  g_get_current_time(&dispatch_end);
+  self->last_dispatch = dispatch_end;
+  stats_counter_add(count_dispatch_usec, g_time_val_diff(&dispatch_end, &dispatch_start));
+}
+
+static void
+poll_fd_events_requeue_dispatch(gpointer s)
+{
+  PollFdEvents *self = (PollFdEvents *) s;
+
+  /* the budget was reset when the task was registered, this invocation
+   * starts a fresh burst */
+  poll_fd_events_dispatch(self);
+}
 
 static void
 poll_fd_events_start_watches(PollEvents *s)
@@ -46,6 +113,8 @@ poll_fd_events_stop_watches(PollEvents *s)
 {
   PollFdEvents *self = (PollFdEvents *) s;
 
+  if (iv_task_registered(&self->requeue_task))
+    iv_task_unregister(&self->requeue_task);
   if (iv_fd_registered(&self->fd_watch))
     iv_fd_unregister(&self->fd_watch);
 }
@@ -56,17 +125,17 @@ poll_fd_events_update_watches(PollEvents *s, GIOCondition cond)
   PollFdEvents *self = (PollFdEvents *) s;
 
   if (cond & G_IO_IN)
-    iv_fd_set_handler_in(&self->fd_watch, IV_FD_CALLBACK(poll_events_invoke_callback));
+    iv_fd_set_handler_in(&self->fd_watch, poll_fd_events_dispatch);
   else
     iv_fd_set_handler_in(&self->fd_watch, NULL);
 
   if (cond & G_IO_OUT)
-    iv_fd_set_handler_out(&self->fd_watch, IV_FD_CALLBACK(poll_events_invoke_callback));
+    iv_fd_set_handler_out(&self->fd_watch, poll_fd_events_dispatch);
   else
     iv_fd_set_handler_out(&self->fd_watch, NULL);
 
   if (cond & (G_IO_IN + G_IO_OUT))
-    iv_fd_set_handler_err(&self->fd_watch, IV_FD_CALLBACK(poll_events_invoke_callback));
+    iv_fd_set_handler_err(&self->fd_watch, poll_fd_events_dispatch);
   else
     iv_fd_set_handler_err(&self->fd_watch, NULL);
 }
@@ -86,5 +155,17 @@ poll_fd_events_new(gint fd)
   self->fd_watch.fd = fd;
   self->fd_watch.cookie = self;
 
+  IV_TASK_INIT(&self->requeue_task);
+  self->requeue_task.cookie = self;
+  self->requeue_task.handler = poll_fd_events_requeue_dispatch;
+
+  if (!count_dispatch_usec)
+    {
+      stats_lock();
+      stats_register_counter(0, SCS_GLOBAL, "eventloop_dispatch_usec", NULL, SC_TYPE_PROCESSED, &count_dispatch_usec);
+      stats_register_counter(0, SCS_GLOBAL, "eventloop_dispatch_requeues", NULL, SC_TYPE_PROCESSED, &count_dispatch_requeues);
+      stats_unlock();
+    }
+
   return &self->super;
 }
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "profiler.h"
+#include "messages.h"
+
+#if defined(HAVE_EXECINFO_H) && defined(HAVE_BACKTRACE)
+
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+
+/* SIGPROF fires on whichever thread is burning CPU time, so the sample
+ * population automatically covers all worker threads in proportion to
+ * the cycles they consume.  The handler only stores raw return
+ * addresses into a preallocated array claimed through an atomic index,
+ * all symbolization and aggregation happens at stop time on the control
+ * connection's thread. */
+
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_MAX_SAMPLES 16384
+
+/* the first two frames of every sample are the handler itself and the
+ * kernel signal trampoline */
+#define PROFILER_SKIP_FRAMES 2
+
+typedef struct _ProfilerSample
+{
+  gpointer frames[PROFILER_MAX_DEPTH];
+  gint depth;
+} ProfilerSample;
+
+static ProfilerSample *profiler_samples;
+static gint profiler_sample_count;
+static gboolean profiler_running;
+static struct sigaction profiler_orig_sigprof;
+
+static void
+profiler_sigprof_handler(int signo)
+{
+  gint ndx = g_atomic_int_exchange_and_add(&profiler_sample_count, 1);
+
+  if (ndx >= PROFILER_MAX_SAMPLES)
+    return;
+  /* backtrace() only unwinds here, the one-time internal initialization
+   * that would malloc() was forced in profiler_start() */
+  profiler_samples[ndx].depth = backtrace(profiler_samples[ndx].frames, PROFILER_MAX_DEPTH);
+}
+
+/* prefer the nearest exported symbol; static functions in plugin .so
+ * files fall back to the module basename plus the offset within it,
+ * which addr2line can still resolve offline */
+static void
+profiler_append_frame(GString *folded, gpointer addr)
+{
+  Dl_info info;
+
+  if (dladdr(addr, &info))
+    {
+      if (info.dli_sname)
+        {
+          g_string_append(folded, info.dli_sname);
+          return;
+        }
+      if (info.dli_fname)
+        {
+          const gchar *slash = strrchr(info.dli_fname, '/');
+
+          g_string_append_printf(folded, "%s+0x%lx",
+                                 slash ? slash + 1 : info.dli_fname,
+                                 (gulong) ((guint8 *) addr - (guint8 *) info.dli_fbase));
+          return;
+        }
+    }
+  g_string_append_printf(folded, "0x%lx", (gulong) addr);
+}
+
+static void
+profiler_append_folded_line(gpointer key, gpointer value, gpointer user_data)
+{
+  GString *result = (GString *) user_data;
+
+  g_string_append(result, (const gchar *) key);
+  g_string_append_printf(result, " %u\n", GPOINTER_TO_UINT(value));
+}
+
+static void
+profiler_render_folded_stacks(GString *result)
+{
+  GHashTable *folded_stacks;
+  GString *folded;
+  gint count = MIN(profiler_sample_count, PROFILER_MAX_SAMPLES);
+  gint i, j;
+
+  folded_stacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  folded = g_string_sized_new(256);
+  for (i = 0; i < count; i++)
+    {
+      ProfilerSample *sample = &profiler_samples[i];
+      guint stack_count;
+
+      g_string_truncate(folded, 0);
+      /* folded format runs from the outermost frame to the leaf */
+      for (j = sample->depth - 1; j >= PROFILER_SKIP_FRAMES; j--)
+        {
+          profiler_append_frame(folded, sample->frames[j]);
+          if (j > PROFILER_SKIP_FRAMES)
+            g_string_append_c(folded, ';');
+        }
+      stack_count = GPOINTER_TO_UINT(g_hash_table_lookup(folded_stacks, folded->str));
+      g_hash_table_replace(folded_stacks, g_strdup(folded->str), GUINT_TO_POINTER(stack_count + 1));
+    }
+  g_hash_table_foreach(folded_stacks, profiler_append_folded_line, result);
+  g_hash_table_destroy(folded_stacks);
+  g_string_free(folded, TRUE);
+}
+
+gboolean
+profiler_start(gint freq, GString *result)
+{
+  struct sigaction sa;
+  struct itimerval timer;
+  gpointer warmup[PROFILER_MAX_DEPTH];
+
+  if (profiler_running)
+    {
+      g_string_assign(result, "FAIL Profiler is already running");
+      return FALSE;
+    }
+  if (freq <= 0 || freq > 1000)
+    {
+      g_string_assign(result, "FAIL Sampling frequency must be between 1 and 1000 Hz");
+      return FALSE;
+    }
+
+  profiler_samples = g_new(ProfilerSample, PROFILER_MAX_SAMPLES);
+  profiler_sample_count = 0;
+
+  /* force backtrace() to finish its lazy initialization outside of
+   * signal context */
+  backtrace(warmup, PROFILER_MAX_DEPTH);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = profiler_sigprof_handler;
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGPROF, &sa, &profiler_orig_sigprof);
+
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / freq;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+
+  profiler_running = TRUE;
+  msg_notice("Sampling profiler started",
+             evt_tag_int("freq", freq),
+             NULL);
+  g_string_printf(result, "OK Profiler started, sampling at %d Hz", freq);
+  return TRUE;
+}
+
+void
+profiler_stop(GString *result)
+{
+  struct itimerval timer;
+
+  if (!profiler_running)
+    {
+      g_string_assign(result, "FAIL Profiler is not running");
+      return;
+    }
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  sigaction(SIGPROF, &profiler_orig_sigprof, NULL);
+  profiler_running = FALSE;
+
+  msg_notice("Sampling profiler stopped",
+             evt_tag_int("samples", MIN(profiler_sample_count, PROFILER_MAX_SAMPLES)),
+             evt_tag_int("dropped", MAX(profiler_sample_count - PROFILER_MAX_SAMPLES, 0)),
+             NULL);
+  profiler_render_folded_stacks(result);
+  g_free(profiler_samples);
+  profiler_samples = NULL;
+  profiler_sample_count = 0;
+
+  if (result->len == 0)
+    g_string_assign(result, "OK No samples collected");
+}
+
+#else
+
+gboolean
+profiler_start(gint freq, GString *result)
+{
+  g_string_assign(result, "FAIL The sampling profiler is not supported on this platform");
+  return FALSE;
+}
+
+void
+profiler_stop(GString *result)
+{
+  g_string_assign(result, "FAIL The sampling profiler is not supported on this platform");
+}
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/* in-process sampling profiler driven by the PROFILE control command;
+ * profiler_stop() renders the collected samples as folded stacks
+ * ("outer;inner;leaf count" per line) ready for flame graph tooling */
+gboolean profiler_start(gint freq, GString *result);
+void profiler_stop(GString *result);
+
+#endif
@@ -32,6 +32,31 @@ log_rewrite_set_condition(LogRewrite *self, FilterExprNode *condition)
   self->condition = condition;
 }
 
+/*
+ * Evaluate the condition() of the rewrite consulting the per-message
+ * memoization bit when one was assigned in log_rewrite_init_method(), so
+ * rewrite blocks whose conditions share a predicate evaluate it once and
+ * the rest only test their bit.
+ */
+static gboolean
+log_rewrite_eval_condition(LogRewrite *self, LogMessage **pmsg, const LogPathOptions *path_options)
+{
+  guint32 memo_bit = self->condition->memo_slot ? (1U << (self->condition->memo_slot - 1)) : 0;
+  gboolean res;
+
+  if (memo_bit && log_msg_filter_memo_lookup(*pmsg, memo_bit, &res))
+    return res;
+
+  res = filter_expr_eval_root(self->condition, pmsg, path_options);
+  if (memo_bit)
+    {
+      /* threaded branches may fan the same uncloned message out to
+       * several workers, the publish is atomic to stay safe there */
+      log_msg_filter_memo_publish(*pmsg, memo_bit, res ? memo_bit : 0);
+    }
+  return res;
+}
+
 static void
 log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
 {
@@ -39,7 +64,7 @@ log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_option
   gssize length;
   const gchar *value;
 
-  if (self->condition && !filter_expr_eval_root(self->condition, &msg, path_options))
+  if (self->condition && !log_rewrite_eval_condition(self, &msg, path_options))
     {
       msg_debug("Rewrite condition unmatched, skipping rewrite",
                 evt_tag_str("value", log_msg_get_value_name(self->value_handle, NULL)),
@@ -71,6 +96,15 @@ log_rewrite_init_method(LogPipe *s)
   if (self->condition && self->condition->init)
     self->condition->init(self->condition, log_pipe_get_config(s));
 
+  /* the condition expression is shared between the clones of this
+   * rewrite in different log paths; memoize its verdict so a message
+   * traversing several of those paths evaluates it only once.  Shared
+   * subexpressions spelled as named filter references get their bit in
+   * filter_call_init(). */
+  if (self->condition && self->condition->ref_cnt > 1 && !self->condition->modify &&
+      !self->condition->memo_slot && cfg->filter_memo_slots < LOG_MSG_FILTER_MEMO_SLOTS)
+    self->condition->memo_slot = ++cfg->filter_memo_slots;
+
   if (!self->name)
     self->name = cfg_tree_get_rule_name(&cfg->tree, ENC_REWRITE, s->expr_node);
   return TRUE;
@@ -24,6 +24,8 @@
 
 #include "rewrite-set.h"
 
+#include <string.h>
+
 /* LogRewriteSet
  *
  * This class implements the "set" expression in a rewrite rule.
@@ -44,18 +46,52 @@ log_rewrite_set_get_template_options(LogRewrite *s)
   return &self->template_options;
 }
 
+static GStaticPrivate priv_set_scratch = G_STATIC_PRIVATE_INIT;
+
+static void
+__free_set_scratch(gpointer s)
+{
+  g_string_free((GString *) s, TRUE);
+}
+
+/* rewrite pipes may be traversed by multiple source threads in parallel,
+ * the scratch buffer used for template formatting is per-thread */
+static GString *
+log_rewrite_set_get_scratch_buffer(void)
+{
+  GString *result;
+
+  result = g_static_private_get(&priv_set_scratch);
+  if (!result)
+    {
+      result = g_string_sized_new(64);
+      g_static_private_set(&priv_set_scratch, result, __free_set_scratch);
+    }
+  g_string_truncate(result, 0);
+  return result;
+}
+
 static void
 log_rewrite_set_process(LogRewrite *s, LogMessage **pmsg, const LogPathOptions *path_options)
 {
   LogRewriteSet *self = (LogRewriteSet *) s;
   GString *result;
+  const gchar *current;
+  gssize current_len = 0;
 
-  result = g_string_sized_new(64);
+  result = log_rewrite_set_get_scratch_buffer();
   log_template_format(self->value_template, *pmsg, &self->template_options, LTZ_SEND, 0, NULL, result);
 
+  /* in normalization configs the value is frequently in the desired form
+   * already; storing the same bytes again would only trigger an unnecessary
+   * copy-on-write of the entire payload on write protected messages */
+  current = log_msg_get_value(*pmsg, self->super.value_handle, &current_len);
+  if (current_len == (gssize) result->len &&
+      memcmp(current, result->str, result->len) == 0)
+    return;
+
   log_msg_make_writable(pmsg, path_options);
   log_msg_set_value(*pmsg, self->super.value_handle, result->str, result->len);
-  g_string_free(result, TRUE);
 }
 
 static LogPipe *
@@ -108,6 +108,17 @@ void test_set_field_not_exist_and_set_literal_string()
   rewrite_teardown(msg);
 }
 
+void test_set_field_unchanged_value_is_a_noop_on_write_protected_message()
+{
+  LogRewrite *test_rewrite = create_rewrite_rule("set(\"oldvalue\" value(\"field1\") );");
+  LogMessage *msg = create_message_with_field("field1", "oldvalue");
+  log_msg_write_protect(msg);
+  invoke_rewrite_rule(test_rewrite, msg);
+  assert_msg_field_equals(msg, "field1", "oldvalue", -1, ASSERTION_ERROR("Field changed by a noop set"));
+  log_msg_write_unprotect(msg);
+  rewrite_teardown(msg);
+}
+
 void test_set_field_exist_and_set_template_string()
 {
   LogRewrite *test_rewrite = create_rewrite_rule("set(\"$field2\" value(\"field1\") );");
@@ -272,6 +283,7 @@ main(int argc, char **argv)
   test_reference_on_condition_cloned();
   test_set_field_exist_and_set_literal_string();
   test_set_field_not_exist_and_set_literal_string();
+  test_set_field_unchanged_value_is_a_noop_on_write_protected_message();
   test_set_field_exist_and_set_template_string();
   test_subst_field_exist_and_substring_substituted();
   test_subst_field_exist_and_substring_substituted_with_template();
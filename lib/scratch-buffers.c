@@ -26,23 +26,65 @@
 #include "scratch-buffers.h"
 #include "misc.h"
 
+#include <string.h>
+
+/* per-thread, per-stack pool accounting, see the trimming logic below */
+typedef struct _ScratchBufferPoolStats
+{
+  gint pooled;       /* buffers sitting in the free stack */
+  gint outstanding;  /* buffers currently acquired */
+  gint watermark;    /* peak of outstanding buffers since the last trim */
+  gint releases;     /* release operations since the last trim */
+} ScratchBufferPoolStats;
+
 TLS_BLOCK_START
 {
   GTrashStack *sb_gstrings;
+  ScratchBufferPoolStats sb_gstrings_stats;
   GTrashStack *sb_th_gstrings;
+  ScratchBufferPoolStats sb_th_gstrings_stats;
   GList *sb_registry;
 }
 TLS_BLOCK_END;
 
+/* GString payloads larger than this are released with their buffer, so a
+ * single oversized message cannot pin large allocations in the pool */
+#define SCRATCH_BUFFERS_MAX_KEPT_SIZE 8192
+
+/* number of release operations between two trim passes */
+#define SCRATCH_BUFFERS_TRIM_INTERVAL 1024
+
+/* drop payloads above the kept size class, the next user starts out with
+ * a small allocation again */
+static inline void
+sb_string_cap_size(GString *s)
+{
+  if (s->allocated_len > SCRATCH_BUFFERS_MAX_KEPT_SIZE)
+    {
+      g_free(s->str);
+      g_string_steal(s);
+    }
+}
+
+static inline void
+sb_stats_acquire(ScratchBufferPoolStats *stats)
+{
+  stats->outstanding++;
+  if (stats->outstanding > stats->watermark)
+    stats->watermark = stats->outstanding;
+}
+
 /* GStrings */
 
 #define local_sb_gstrings        __tls_deref(sb_gstrings)
+#define local_sb_gstrings_stats  __tls_deref(sb_gstrings_stats)
 
 GTrashStack *
 sb_gstring_acquire_buffer(void)
 {
   SBGString *sb;
 
+  sb_stats_acquire(&local_sb_gstrings_stats);
   sb = g_trash_stack_pop(&local_sb_gstrings);
   if (!sb)
     {
@@ -50,17 +92,45 @@ sb_gstring_acquire_buffer(void)
       g_string_steal(sb_gstring_string(sb));
     }
   else
-    g_string_set_size(sb_gstring_string(sb), 0);
+    {
+      local_sb_gstrings_stats.pooled--;
+      g_string_set_size(sb_gstring_string(sb), 0);
+    }
 
   return (GTrashStack *) sb;
 }
 
+/* trim the pool back to the recent peak of concurrent users: in steady
+ * state acquire always hits the pool, while buffers kept alive by a
+ * one-off burst are given back to the heap */
+static void
+sb_gstring_trim_stack(void)
+{
+  ScratchBufferPoolStats *stats = &local_sb_gstrings_stats;
+  SBGString *sb;
+
+  while (stats->pooled > stats->watermark &&
+         (sb = g_trash_stack_pop(&local_sb_gstrings)) != NULL)
+    {
+      g_free(sb_gstring_string(sb)->str);
+      g_free(sb);
+      stats->pooled--;
+    }
+  stats->watermark = stats->outstanding;
+  stats->releases = 0;
+}
+
 void
 sb_gstring_release_buffer(GTrashStack *s)
 {
   SBGString *sb = (SBGString *) s;
 
+  sb_string_cap_size(sb_gstring_string(sb));
   g_trash_stack_push(&local_sb_gstrings, sb);
+  local_sb_gstrings_stats.outstanding--;
+  local_sb_gstrings_stats.pooled++;
+  if (++local_sb_gstrings_stats.releases >= SCRATCH_BUFFERS_TRIM_INTERVAL)
+    sb_gstring_trim_stack();
 }
 
 void
@@ -73,6 +143,7 @@ sb_gstring_free_stack(void)
       g_free(sb_gstring_string(sb)->str);
       g_free(sb);
     }
+  memset(&local_sb_gstrings_stats, 0, sizeof(local_sb_gstrings_stats));
 }
 
 ScratchBufferStack SBGStringStack = {
@@ -84,12 +155,14 @@ ScratchBufferStack SBGStringStack = {
 /* Type-hinted GStrings */
 
 #define local_sb_th_gstrings        __tls_deref(sb_th_gstrings)
+#define local_sb_th_gstrings_stats  __tls_deref(sb_th_gstrings_stats)
 
 GTrashStack *
 sb_th_gstring_acquire_buffer (void)
 {
   SBTHGString *sb;
 
+  sb_stats_acquire(&local_sb_th_gstrings_stats);
   sb = g_trash_stack_pop(&local_sb_th_gstrings);
   if (!sb)
     {
@@ -98,15 +171,42 @@ sb_th_gstring_acquire_buffer (void)
       sb->type_hint = TYPE_HINT_STRING;
     }
   else
-    g_string_set_size(sb_th_gstring_string(sb), 0);
+    {
+      local_sb_th_gstrings_stats.pooled--;
+      g_string_set_size(sb_th_gstring_string(sb), 0);
+    }
 
   return (GTrashStack *)sb;
 }
 
+static void
+sb_th_gstring_trim_stack(void)
+{
+  ScratchBufferPoolStats *stats = &local_sb_th_gstrings_stats;
+  SBTHGString *sb;
+
+  while (stats->pooled > stats->watermark &&
+         (sb = g_trash_stack_pop(&local_sb_th_gstrings)) != NULL)
+    {
+      g_free(sb_th_gstring_string(sb)->str);
+      g_free(sb);
+      stats->pooled--;
+    }
+  stats->watermark = stats->outstanding;
+  stats->releases = 0;
+}
+
 void
 sb_th_gstring_release_buffer(GTrashStack *s)
 {
-  g_trash_stack_push(&local_sb_th_gstrings, s);
+  SBTHGString *sb = (SBTHGString *) s;
+
+  sb_string_cap_size(sb_th_gstring_string(sb));
+  g_trash_stack_push(&local_sb_th_gstrings, sb);
+  local_sb_th_gstrings_stats.outstanding--;
+  local_sb_th_gstrings_stats.pooled++;
+  if (++local_sb_th_gstrings_stats.releases >= SCRATCH_BUFFERS_TRIM_INTERVAL)
+    sb_th_gstring_trim_stack();
 }
 
 void
@@ -119,6 +219,7 @@ sb_th_gstring_free_stack(void)
       g_free(sb_gstring_string(sb)->str);
       g_free(sb);
     }
+  memset(&local_sb_th_gstrings_stats, 0, sizeof(local_sb_th_gstrings_stats));
 }
 
 ScratchBufferStack SBTHGStringStack = {
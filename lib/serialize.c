@@ -402,4 +402,42 @@ serialize_read_uint8(SerializeArchive *archive, guint8 *value)
   return FALSE;
 }
 
+/* variable length encoding for unsigned integers: seven value bits per
+ * byte, least significant group first, the high bit marks continuation.
+ * Small values -- lengths, offsets, counters -- thus take a single byte
+ * instead of a fixed width field. */
+gboolean
+serialize_write_varint(SerializeArchive *archive, guint64 value)
+{
+  guchar buf[10];
+  gint len = 0;
+
+  while (value >= 0x80)
+    {
+      buf[len++] = (value & 0x7f) | 0x80;
+      value >>= 7;
+    }
+  buf[len++] = value;
+  return serialize_archive_write_bytes(archive, (gchar *) buf, len);
+}
+
+gboolean
+serialize_read_varint(SerializeArchive *archive, guint64 *value)
+{
+  guint64 result = 0;
+  guint shift = 0;
+  guint8 b;
+
+  do
+    {
+      if (shift > 63 || !serialize_read_uint8(archive, &b))
+        return FALSE;
+      result |= ((guint64) (b & 0x7f)) << shift;
+      shift += 7;
+    }
+  while (b & 0x80);
+  *value = result;
+  return TRUE;
+}
+
 
@@ -54,6 +54,8 @@ gboolean serialize_write_uint16(SerializeArchive *archive, guint16 value);
 gboolean serialize_read_uint16(SerializeArchive *archive, guint16 *value);
 gboolean serialize_write_uint8(SerializeArchive *archive, guint8 value);
 gboolean serialize_read_uint8(SerializeArchive *archive, guint8 *value);
+gboolean serialize_write_varint(SerializeArchive *archive, guint64 value);
+gboolean serialize_read_varint(SerializeArchive *archive, guint64 *value);
 
 SerializeArchive *serialize_file_archive_new(FILE *f);
 SerializeArchive *serialize_string_archive_new(GString *str);
@@ -22,6 +22,7 @@
  *
  */
 #include "stats/stats-cluster.h"
+#include "fasthash.h"
 
 #include <string.h>
 
@@ -94,7 +95,9 @@ _get_module_name(gint source)
     "snmp",
     "riemann",
     "journald",
-    "java"
+    "java",
+    "kafka",
+    "http"
   };
   return module_names[source & SCS_SOURCE_MASK];
 }
@@ -138,7 +141,7 @@ stats_cluster_equal(const StatsCluster *sc1, const StatsCluster *sc2)
 guint
 stats_cluster_hash(const StatsCluster *self)
 {
-  return g_str_hash(self->id) + g_str_hash(self->instance) + self->component;
+  return fast_hash_str(self->id) + fast_hash_str(self->instance) + self->component;
 }
 
 StatsCounterItem *
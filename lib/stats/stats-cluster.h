@@ -79,6 +79,8 @@ enum
   SCS_RIEMANN        = 33,
   SCS_JOURNALD       = 34,
   SCS_JAVA           = 35,
+  SCS_KAFKA          = 36,
+  SCS_HTTP           = 37,
   SCS_MAX,
   SCS_SOURCE_MASK    = 0xff
 };
@@ -23,6 +23,105 @@
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-registry.h"
+#include "tls-support.h"
+#include "atomic.h"
+
+/* number of per-thread slots in a shard set; threads beyond this many
+ * share slots, which is safe as the slots are updated atomically */
+#define STATS_COUNTER_SHARD_SLOTS 32
+
+typedef struct _StatsCounterShardSlot
+{
+  gint value;
+  /* pad to a cache line so slots of different threads don't share one */
+  gchar pad[64 - sizeof(gint)];
+} StatsCounterShardSlot;
+
+struct _StatsCounterShards
+{
+  StatsCounterItem *owner;
+  /* sum already folded into the owner by the last aggregation pass */
+  gint aggregated;
+  StatsCounterShardSlot slots[STATS_COUNTER_SHARD_SLOTS];
+};
+
+TLS_BLOCK_START
+{
+  gint stats_shard_slot_index;
+}
+TLS_BLOCK_END;
+
+#define stats_shard_slot_index __tls_deref(stats_shard_slot_index)
+
+/* protected by stats_lock() */
+static GList *stats_counter_shards_list;
+static GAtomicCounter stats_shard_next_slot;
+
+static gint
+stats_counter_shards_get_slot(void)
+{
+  if (G_UNLIKELY(stats_shard_slot_index == 0))
+    stats_shard_slot_index = (g_atomic_counter_exchange_and_add(&stats_shard_next_slot, 1) % STATS_COUNTER_SHARD_SLOTS) + 1;
+  return stats_shard_slot_index - 1;
+}
+
+StatsCounterShards *
+stats_counter_shards_new(StatsCounterItem *owner)
+{
+  StatsCounterShards *self = g_new0(StatsCounterShards, 1);
+
+  self->owner = owner;
+  stats_counter_shards_list = g_list_prepend(stats_counter_shards_list, self);
+  return self;
+}
+
+static void
+_aggregate_shards(StatsCounterShards *self)
+{
+  gint sum = 0;
+  gint i;
+
+  for (i = 0; i < STATS_COUNTER_SHARD_SLOTS; i++)
+    sum += g_atomic_int_get(&self->slots[i].value);
+
+  /* several shard sets and direct stats_counter_inc() calls may target
+   * the same counter, so only fold in the delta since the last pass */
+  stats_counter_add(self->owner, sum - self->aggregated);
+  self->aggregated = sum;
+}
+
+void
+stats_counter_shards_free(StatsCounterShards *self)
+{
+  if (!self)
+    return;
+
+  _aggregate_shards(self);
+  stats_counter_shards_list = g_list_remove(stats_counter_shards_list, self);
+  g_free(self);
+}
+
+void
+stats_counter_shards_add(StatsCounterShards *self, gint add)
+{
+  if (self)
+    g_atomic_int_add(&self->slots[stats_counter_shards_get_slot()].value, add);
+}
+
+void
+stats_counter_shards_inc(StatsCounterShards *self)
+{
+  stats_counter_shards_add(self, 1);
+}
+
+void
+stats_counter_aggregate_shards(void)
+{
+  GList *l;
+
+  for (l = stats_counter_shards_list; l; l = l->next)
+    _aggregate_shards((StatsCounterShards *) l->data);
+}
 
 static void
 _reset_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
@@ -31,6 +31,23 @@ typedef struct _StatsCounterItem
   gint value;
 } StatsCounterItem;
 
+/* Sharded view of a hot counter: updater threads increment their own,
+ * cache-line padded slot and the real counter is updated lazily by
+ * stats_counter_aggregate_shards() whenever the stats output is
+ * rendered.  Use it for counters incremented on every message, where
+ * the atomic increments of many threads would bounce the same cache
+ * line around. */
+typedef struct _StatsCounterShards StatsCounterShards;
+
+/* NOTE: _new and _free require stats_lock() to be held */
+StatsCounterShards *stats_counter_shards_new(StatsCounterItem *owner);
+void stats_counter_shards_free(StatsCounterShards *self);
+void stats_counter_shards_inc(StatsCounterShards *self);
+void stats_counter_shards_add(StatsCounterShards *self, gint add);
+
+/* NOTE: requires stats_lock() to be held */
+void stats_counter_aggregate_shards(void);
+
 
 static inline void
 stats_counter_add(StatsCounterItem *counter, gint add)
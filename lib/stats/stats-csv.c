@@ -24,6 +24,7 @@
 #include "stats/stats-csv.h"
 #include "stats/stats-registry.h"
 #include "utf8utils.h"
+#include "memusage.h"
 
 #include <string.h>
 
@@ -85,14 +86,56 @@ stats_format_csv(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointe
 }
 
 
-gchar *
-stats_generate_csv(void)
+static void
+_add_cluster_to_snapshot(StatsCluster *sc, gpointer user_data)
 {
-  GString *csv = g_string_sized_new(1024);
+  GPtrArray *clusters = (GPtrArray *) user_data;
+
+  g_ptr_array_add(clusters, sc);
+}
 
+void
+stats_csv_format_header(GString *csv)
+{
   g_string_append_printf(csv, "%s;%s;%s;%s;%s;%s\n", "SourceName", "SourceId", "SourceInstance", "State", "Type", "Number");
+}
+
+void
+stats_csv_format_cluster(StatsCluster *sc, GString *csv)
+{
+  stats_cluster_foreach_counter(sc, stats_format_csv, csv);
+}
+
+GPtrArray *
+stats_csv_get_cluster_snapshot(void)
+{
+  GPtrArray *clusters = g_ptr_array_sized_new(256);
+
+  /* The registry lock is held only while snapshotting the cluster
+   * pointers, not for rendering the potentially sizable output.  This is
+   * safe without an epoch scheme: clusters are only ever freed by the
+   * config-reload time pruning, which runs in the main thread just like
+   * the control commands, while registrations from worker threads merely
+   * add new clusters we may miss.  This way an 80k-cluster stats dump no
+   * longer stalls counter registration in the data path. */
+  memusage_refresh_counters();
   stats_lock();
-  stats_foreach_counter(stats_format_csv, csv);
+  stats_counter_aggregate_shards();
+  stats_foreach_cluster(_add_cluster_to_snapshot, clusters);
   stats_unlock();
+  return clusters;
+}
+
+gchar *
+stats_generate_csv(void)
+{
+  GString *csv = g_string_sized_new(1024);
+  GPtrArray *clusters = stats_csv_get_cluster_snapshot();
+  gint i;
+
+  stats_csv_format_header(csv);
+  for (i = 0; i < clusters->len; i++)
+    stats_csv_format_cluster(g_ptr_array_index(clusters, i), csv);
+  g_ptr_array_free(clusters, TRUE);
   return g_string_free(csv, FALSE);
 }
@@ -25,7 +25,13 @@
 #define STATS_CSV_H_INCLUDED 1
 
 #include "syslog-ng.h"
+#include "stats/stats-cluster.h"
 
 gchar *stats_generate_csv(void);
 
+/* building blocks for incrementally rendered stats dumps */
+GPtrArray *stats_csv_get_cluster_snapshot(void);
+void stats_csv_format_header(GString *csv);
+void stats_csv_format_cluster(StatsCluster *sc, GString *csv);
+
 #endif
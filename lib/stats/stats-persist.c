@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2002-2013 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2013 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "stats/stats-persist.h"
+#include "stats/stats-registry.h"
+#include "stats/stats.h"
+#include "persistable-state-header.h"
+
+#include <string.h>
+
+/* Optional persistence of counter values across restarts
+ * (stats-persist-freq() option).
+ *
+ * Counters reset to zero whenever syslog-ng restarts, which breaks rate
+ * calculations in external collectors.  When enabled, the values of
+ * non-dynamic clusters (the ones tied to configuration elements; dynamic
+ * per-host/per-sender clusters are unbounded in number and are pruned
+ * anyway) are checkpointed into the persist file and restored when the
+ * cluster is registered again after a restart.
+ *
+ * The counter hot path is not touched at all: checkpointing walks the
+ * registry on a timer, compares each cluster with its persisted image and
+ * only writes the ones that changed, so the effective dirty set is
+ * determined at flush time instead of being tracked per increment.
+ */
+
+typedef struct _StatsPersistedCluster
+{
+  PersistableStateHeader header;
+  guint32 values[SC_TYPE_MAX];
+} StatsPersistedCluster;
+
+static PersistState *stats_persist_state;
+
+/* persist name -> PersistEntryHandle, only accessed with stats_lock()
+ * held (both registration and the checkpoint walk hold it) */
+static GHashTable *stats_persist_handles;
+
+static void
+_format_persist_name(StatsCluster *sc, gchar *buf, gsize buf_len)
+{
+  gchar component_buf[32];
+
+  g_snprintf(buf, buf_len, "stats(%s,%s,%s)",
+             stats_cluster_get_component_name(sc, component_buf, sizeof(component_buf)),
+             sc->id, sc->instance);
+}
+
+/* restore the persisted values of a newly registered non-dynamic cluster;
+ * called by the registry right after creating the cluster, before any of
+ * its counters are tracked */
+void
+stats_persist_restore_cluster(StatsCluster *sc)
+{
+  gchar name[256];
+  PersistEntryHandle handle;
+  StatsPersistedCluster *data;
+  gsize size;
+  guint8 version;
+  gint i;
+
+  if (!stats_persist_state || sc->dynamic)
+    return;
+
+  _format_persist_name(sc, name, sizeof(name));
+  handle = persist_state_lookup_entry(stats_persist_state, name, &size, &version);
+  if (!handle || size < sizeof(StatsPersistedCluster))
+    return;
+
+  data = (StatsPersistedCluster *) persist_state_map_entry(stats_persist_state, handle);
+  if ((data->header.big_endian && G_BYTE_ORDER == G_LITTLE_ENDIAN) ||
+      (!data->header.big_endian && G_BYTE_ORDER == G_BIG_ENDIAN))
+    {
+      data->header.big_endian = !data->header.big_endian;
+      for (i = 0; i < SC_TYPE_MAX; i++)
+        data->values[i] = GUINT32_SWAP_LE_BE(data->values[i]);
+    }
+  for (i = 0; i < SC_TYPE_MAX; i++)
+    sc->counters[i].value = data->values[i];
+  persist_state_unmap_entry(stats_persist_state, handle);
+
+  g_hash_table_insert(stats_persist_handles, g_strdup(name), GUINT_TO_POINTER(handle));
+}
+
+static void
+_checkpoint_cluster(StatsCluster *sc, gpointer user_data)
+{
+  gchar name[256];
+  PersistEntryHandle handle;
+  StatsPersistedCluster *data;
+  guint32 values[SC_TYPE_MAX];
+  gint i;
+
+  if (sc->dynamic)
+    return;
+
+  for (i = 0; i < SC_TYPE_MAX; i++)
+    values[i] = stats_counter_get(&sc->counters[i]);
+
+  _format_persist_name(sc, name, sizeof(name));
+  handle = GPOINTER_TO_UINT(g_hash_table_lookup(stats_persist_handles, name));
+  if (!handle)
+    {
+      gsize size;
+      guint8 version;
+
+      /* the entry may exist from a previous run even if the cluster was
+       * never restored (e.g. it got registered during a reload) */
+      handle = persist_state_lookup_entry(stats_persist_state, name, &size, &version);
+      if (handle && size < sizeof(StatsPersistedCluster))
+        return;
+      if (!handle)
+        {
+          handle = persist_state_alloc_entry(stats_persist_state, name, sizeof(StatsPersistedCluster));
+          if (!handle)
+            return;
+        }
+      g_hash_table_insert(stats_persist_handles, g_strdup(name), GUINT_TO_POINTER(handle));
+    }
+
+  data = (StatsPersistedCluster *) persist_state_map_entry(stats_persist_state, handle);
+  if (memcmp(data->values, values, sizeof(values)) != 0)
+    {
+      data->header.version = 0;
+      data->header.big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
+      memcpy(data->values, values, sizeof(values));
+    }
+  persist_state_unmap_entry(stats_persist_state, handle);
+}
+
+void
+stats_persist_checkpoint_counters(void)
+{
+  if (!stats_persist_state)
+    return;
+
+  stats_lock();
+  stats_counter_aggregate_shards();
+  stats_foreach_cluster(_checkpoint_cluster, NULL);
+  stats_unlock();
+}
+
+void
+stats_persist_reinit(PersistState *state, gboolean enabled)
+{
+  stats_persist_deinit();
+  if (!enabled || !state)
+    return;
+
+  stats_persist_state = state;
+  stats_persist_handles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+void
+stats_persist_deinit(void)
+{
+  stats_persist_checkpoint_counters();
+  if (stats_persist_handles)
+    g_hash_table_destroy(stats_persist_handles);
+  stats_persist_handles = NULL;
+  stats_persist_state = NULL;
+}
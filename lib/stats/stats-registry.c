@@ -22,52 +22,140 @@
  *
  */
 #include "stats/stats-registry.h"
+#include "stats/stats.h"
+#include "stats/stats-persist.h"
 
 #include <string.h>
 
-static GHashTable *counter_hash;
-static GStaticMutex stats_mutex = G_STATIC_MUTEX_INIT;
+/* The registry is sharded by the cluster key hash: each shard has its own
+ * hash table and mutex.  Config-time (un)registration and iteration still
+ * take all shard locks through stats_lock()/stats_unlock(), which keeps the
+ * original locking contract for those callers.  The per-message dynamic
+ * counter path (e.g.  per-$HOST counters at stats levels 2-3) only locks
+ * the shard that owns the key, so worker threads updating counters for
+ * different hosts no longer serialize on a single registry mutex. */
+
+#define STATS_REGISTRY_SHARDS 8
+
+typedef struct _StatsRegistryShard
+{
+  GHashTable *counter_hash;
+  GStaticMutex lock;
+} StatsRegistryShard;
+
+static StatsRegistryShard stats_registry_shards[STATS_REGISTRY_SHARDS];
+static gint stats_num_dynamic_clusters;
 gboolean stats_locked;
 
 void
 stats_lock(void)
 {
-  g_static_mutex_lock(&stats_mutex);
+  gint i;
+
+  for (i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    g_static_mutex_lock(&stats_registry_shards[i].lock);
   stats_locked = TRUE;
 }
 
 void
 stats_unlock(void)
 {
+  gint i;
+
   stats_locked = FALSE;
-  g_static_mutex_unlock(&stats_mutex);
+  for (i = STATS_REGISTRY_SHARDS - 1; i >= 0; i--)
+    g_static_mutex_unlock(&stats_registry_shards[i].lock);
+}
+
+static void
+_setup_key(StatsCluster *key, gint component, const gchar *id, const gchar *instance)
+{
+  if (!id)
+    id = "";
+  if (!instance)
+    instance = "";
+
+  key->component = component;
+  key->id = (gchar *) id;
+  key->instance = (gchar *) instance;
+}
+
+static StatsRegistryShard *
+_shard_for_key(StatsCluster *key)
+{
+  return &stats_registry_shards[stats_cluster_hash(key) % STATS_REGISTRY_SHARDS];
+}
+
+static void
+_find_lru_dynamic_cluster(gpointer key, gpointer value, gpointer user_data)
+{
+  StatsCluster *sc = (StatsCluster *) value;
+  StatsCluster **victim = (StatsCluster **) user_data;
+
+  if (!sc->dynamic || sc->use_count > 0)
+    return;
+
+  /* clusters without a stamp sort as the oldest possible */
+  if (!*victim ||
+      sc->counters[SC_TYPE_STAMP].value < (*victim)->counters[SC_TYPE_STAMP].value)
+    *victim = sc;
+}
+
+/* evict the least recently stamped, unreferenced dynamic cluster from the
+ * shard to make room for a new one; returns whether a cluster was freed */
+static gboolean
+_evict_lru_dynamic_cluster(StatsRegistryShard *shard)
+{
+  StatsCluster *victim = NULL;
+
+  g_hash_table_foreach(shard->counter_hash, _find_lru_dynamic_cluster, &victim);
+  if (!victim)
+    return FALSE;
+
+  g_hash_table_remove(shard->counter_hash, victim);
+  g_atomic_int_add(&stats_num_dynamic_clusters, -1);
+  return TRUE;
+}
+
+static gboolean
+_dynamic_cluster_limit_reached(void)
+{
+  gint max_dynamics = stats_options ? stats_options->max_dynamics : 0;
+
+  return max_dynamics > 0 &&
+         g_atomic_int_get(&stats_num_dynamic_clusters) >= max_dynamics;
 }
 
 static StatsCluster *
-_grab_cluster(gint stats_level, gint component, const gchar *id, const gchar *instance, gboolean dynamic)
+_grab_cluster(StatsRegistryShard *shard, gint stats_level, gint component, const gchar *id, const gchar *instance, gboolean dynamic)
 {
   StatsCluster key;
   StatsCluster *sc;
 
   if (!stats_check_level(stats_level))
     return NULL;
-  
-  if (!id)
-    id = "";
-  if (!instance)
-    instance = "";
-  
-  key.component = component;
-  key.id = (gchar *) id;
-  key.instance = (gchar *) instance;
-  
-  sc = g_hash_table_lookup(counter_hash, &key);
+
+  _setup_key(&key, component, id, instance);
+
+  sc = g_hash_table_lookup(shard->counter_hash, &key);
   if (!sc)
     {
+      if (dynamic && _dynamic_cluster_limit_reached() &&
+          !_evict_lru_dynamic_cluster(shard))
+        {
+          /* at the cap and nothing evictable in this shard, refuse the
+           * registration rather than growing without bound */
+          return NULL;
+        }
+
       /* no such StatsCluster instance, register one */
-      sc = stats_cluster_new(component, id, instance);
+      sc = stats_cluster_new(component, key.id, key.instance);
       sc->dynamic = dynamic;
-      g_hash_table_insert(counter_hash, sc, sc);
+      g_hash_table_insert(shard->counter_hash, sc, sc);
+      if (dynamic)
+        g_atomic_int_add(&stats_num_dynamic_clusters, 1);
+      else
+        stats_persist_restore_cluster(sc);
     }
   else
     {
@@ -85,11 +173,13 @@ _grab_cluster(gint stats_level, gint component, const gchar *id, const gchar *in
 static StatsCluster *
 _register_counter(gint stats_level, gint component, const gchar *id, const gchar *instance, StatsCounterType type, gboolean dynamic, StatsCounterItem **counter)
 {
+  StatsCluster key;
   StatsCluster *sc;
 
   g_assert(stats_locked);
 
-  sc = _grab_cluster(stats_level, component, id, instance, dynamic);
+  _setup_key(&key, component, id, instance);
+  sc = _grab_cluster(_shard_for_key(&key), stats_level, component, id, instance, dynamic);
   if (sc)
     *counter = stats_cluster_track_counter(sc, type);
   else
@@ -130,23 +220,36 @@ stats_register_dynamic_counter(gint stats_level, gint component, const gchar *id
  * @timestamp: if non-negative, an associated timestamp will be created and set
  *
  * Instantly create (if not exists) and increment a dynamic counter.
+ *
+ * NOTE: this is the per-message fast path, it locks only the registry
+ * shard that owns the key, do NOT call it with stats_lock() held.
  */
 void
 stats_register_and_increment_dynamic_counter(gint stats_level, gint component, const gchar *id, const gchar *instance, time_t timestamp)
 {
   StatsCounterItem *counter, *stamp;
-  StatsCluster *handle;
+  StatsCluster key;
+  StatsCluster *sc;
+  StatsRegistryShard *shard;
 
-  g_assert(stats_locked);
-  handle = stats_register_dynamic_counter(stats_level, component, id, instance, SC_TYPE_PROCESSED, &counter);
-  stats_counter_inc(counter);
-  if (timestamp >= 0)
+  _setup_key(&key, component, id, instance);
+  shard = _shard_for_key(&key);
+
+  g_static_mutex_lock(&shard->lock);
+  sc = _grab_cluster(shard, stats_level, component, id, instance, TRUE);
+  if (sc)
     {
-      stats_register_associated_counter(handle, SC_TYPE_STAMP, &stamp);
-      stats_counter_set(stamp, timestamp);
-      stats_unregister_dynamic_counter(handle, SC_TYPE_STAMP, &stamp);
+      counter = stats_cluster_track_counter(sc, SC_TYPE_PROCESSED);
+      stats_counter_inc(counter);
+      if (timestamp >= 0)
+        {
+          stamp = stats_cluster_track_counter(sc, SC_TYPE_STAMP);
+          stats_counter_set(stamp, timestamp);
+          stats_cluster_untrack_counter(sc, SC_TYPE_STAMP, &stamp);
+        }
+      stats_cluster_untrack_counter(sc, SC_TYPE_PROCESSED, &counter);
     }
-  stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
+  g_static_mutex_unlock(&shard->lock);
 }
 
 /**
@@ -176,23 +279,15 @@ stats_unregister_counter(gint component, const gchar *id, const gchar *instance,
 {
   StatsCluster *sc;
   StatsCluster key;
-  
+
   g_assert(stats_locked);
 
   if (*counter == NULL)
     return;
 
-  if (!id)
-    id = "";
-  if (!instance)
-    instance = "";
-  
-  key.component = component;
-  key.id = (gchar *) id;
-  key.instance = (gchar *) instance;
+  _setup_key(&key, component, id, instance);
+  sc = g_hash_table_lookup(_shard_for_key(&key)->counter_hash, &key);
 
-  sc = g_hash_table_lookup(counter_hash, &key);
-  
   stats_cluster_untrack_counter(sc, type, counter);
 }
 
@@ -220,9 +315,11 @@ void
 stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data)
 {
   gpointer args[] = { func, user_data };
+  gint i;
 
   g_assert(stats_locked);
-  g_hash_table_foreach(counter_hash, _foreach_cluster_helper, args);
+  for (i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    g_hash_table_foreach(stats_registry_shards[i].counter_hash, _foreach_cluster_helper, args);
 }
 
 static gboolean
@@ -232,15 +329,22 @@ _foreach_cluster_remove_helper(gpointer key, gpointer value, gpointer user_data)
   StatsForeachClusterRemoveFunc func = args[0];
   gpointer func_data = args[1];
   StatsCluster *sc = (StatsCluster *) value;
-  
-  return func(sc, func_data);
+  gboolean remove;
+
+  remove = func(sc, func_data);
+  if (remove && sc->dynamic)
+    g_atomic_int_add(&stats_num_dynamic_clusters, -1);
+  return remove;
 }
 
 void
 stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_data)
 {
   gpointer args[] = { func, user_data };
-  g_hash_table_foreach_remove(counter_hash, _foreach_cluster_remove_helper, args);
+  gint i;
+
+  for (i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    g_hash_table_foreach_remove(stats_registry_shards[i].counter_hash, _foreach_cluster_remove_helper, args);
 }
 
 static void
@@ -265,14 +369,25 @@ stats_foreach_counter(StatsForeachCounterFunc func, gpointer user_data)
 void
 stats_registry_init(void)
 {
-  counter_hash = g_hash_table_new_full((GHashFunc) stats_cluster_hash, (GEqualFunc) stats_cluster_equal, NULL, (GDestroyNotify) stats_cluster_free);
-  g_static_mutex_init(&stats_mutex);
+  gint i;
+
+  for (i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    {
+      stats_registry_shards[i].counter_hash = g_hash_table_new_full((GHashFunc) stats_cluster_hash, (GEqualFunc) stats_cluster_equal, NULL, (GDestroyNotify) stats_cluster_free);
+      g_static_mutex_init(&stats_registry_shards[i].lock);
+    }
+  stats_num_dynamic_clusters = 0;
 }
 
 void
 stats_registry_deinit(void)
 {
-  g_hash_table_destroy(counter_hash);
-  counter_hash = NULL;
-  g_static_mutex_free(&stats_mutex);
+  gint i;
+
+  for (i = 0; i < STATS_REGISTRY_SHARDS; i++)
+    {
+      g_hash_table_destroy(stats_registry_shards[i].counter_hash);
+      stats_registry_shards[i].counter_hash = NULL;
+      g_static_mutex_free(&stats_registry_shards[i].lock);
+    }
 }
@@ -26,7 +26,9 @@
 #include "stats/stats-syslog.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-log.h"
+#include "stats/stats-persist.h"
 #include "timeutils.h"
+#include "memusage.h"
 
 #include <string.h>
 #include <iv.h>
@@ -161,7 +163,9 @@ stats_publish_and_prune_counters(void)
   if (publish)
     st.stats_event = msg_event_create(EVT_PRI_INFO, "Log statistics", NULL);
 
+  memusage_refresh_counters();
   stats_lock();
+  stats_counter_aggregate_shards();
   stats_foreach_cluster_remove(stats_format_and_prune_cluster, &st);
   stats_unlock();
 
@@ -210,6 +214,7 @@ stats_timer_kill(struct iv_timer *timer)
 }
 
 static struct iv_timer stats_timer;
+static struct iv_timer stats_persist_timer;
 
 
 static void
@@ -219,6 +224,13 @@ stats_timer_elapsed(gpointer st)
   stats_timer_rearm(&stats_timer);
 }
 
+static void
+stats_persist_timer_elapsed(gpointer st)
+{
+  stats_persist_checkpoint_counters();
+  stats_timer_rearm(&stats_persist_timer);
+}
+
 void
 stats_timer_reinit(void)
 {
@@ -231,6 +243,13 @@ stats_timer_reinit(void)
   stats_timer_kill(&stats_timer);
   stats_timer_init(&stats_timer, stats_timer_elapsed, freq);
   stats_timer_rearm(&stats_timer);
+
+  stats_timer_kill(&stats_persist_timer);
+  if (stats_options->persist_freq > 0)
+    {
+      stats_timer_init(&stats_persist_timer, stats_persist_timer_elapsed, stats_options->persist_freq);
+      stats_timer_rearm(&stats_persist_timer);
+    }
 }
 
 void
@@ -259,4 +278,6 @@ stats_options_defaults(StatsOptions *options)
   options->level = 0;
   options->log_freq = 600;
   options->lifetime = 600;
+  options->max_dynamics = 0;
+  options->persist_freq = 0;
 }
@@ -33,8 +33,14 @@ typedef struct _StatsOptions
   gint log_freq;
   gint level;
   gint lifetime;
+  gint max_dynamics;
+  /* seconds between counter checkpoints into the persist file, 0 disables
+   * persistence (see stats-persist.c) */
+  gint persist_freq;
 } StatsOptions;
 
+extern StatsOptions *stats_options;
+
 enum
 {
   STATS_LEVEL0 = 0,
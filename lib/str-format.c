@@ -29,6 +29,20 @@
 
 static gchar digits[] = "0123456789abcdef";
 
+/* all two digit numbers as consecutive character pairs, base10 conversion
+ * emits two digits per division instead of one */
+static gchar digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
 /* format 64 bit ints */
 
 static inline gint
@@ -36,7 +50,6 @@ format_uint64_base10_rev(gchar *result, gsize result_len, gint sign, guint64 val
 {
   gchar *p;
   gboolean negative = FALSE;
-  gboolean first = TRUE;
 
   if (sign && ((gint64) value) < 0)
     {
@@ -45,13 +58,26 @@ format_uint64_base10_rev(gchar *result, gsize result_len, gint sign, guint64 val
     }
 
   p = result;
-  while (first || (result_len > 0 && value > 0))
+  while (value >= 100 && result_len >= 2)
     {
-      *p = digits[value % 10];
-      value /= 10;
-      p++;
+      const gchar *d = &digit_pairs[(value % 100) << 1];
+
+      value /= 100;
+      *p++ = d[1];
+      *p++ = d[0];
+      result_len -= 2;
+    }
+  if (result_len > 0)
+    {
+      const gchar *d = &digit_pairs[value << 1];
+
+      *p++ = d[1];
       result_len--;
-      first = FALSE;
+      if (value >= 10 && result_len > 0)
+        {
+          *p++ = d[0];
+          result_len--;
+        }
     }
   if (negative && result_len > 0)
     {
@@ -151,7 +177,6 @@ format_uint32_base10_rev(gchar *result, gsize result_len, gint sign, guint32 val
 {
   gchar *p;
   gboolean negative = 0;
-  gboolean first = TRUE;
 
   if (sign && ((gint32) value) < 0)
     {
@@ -160,13 +185,26 @@ format_uint32_base10_rev(gchar *result, gsize result_len, gint sign, guint32 val
     }
 
   p = result;
-  while (first || (result_len > 0 && value > 0))
+  while (value >= 100 && result_len >= 2)
     {
-      *p = digits[value % 10];
-      value /= 10;
-      p++;
+      const gchar *d = &digit_pairs[(value % 100) << 1];
+
+      value /= 100;
+      *p++ = d[1];
+      *p++ = d[0];
+      result_len -= 2;
+    }
+  if (result_len > 0)
+    {
+      const gchar *d = &digit_pairs[value << 1];
+
+      *p++ = d[1];
       result_len--;
-      first = FALSE;
+      if (value >= 10 && result_len > 0)
+        {
+          *p++ = d[0];
+          result_len--;
+        }
     }
   if (negative && result_len > 0)
     {
@@ -261,6 +299,56 @@ format_int32_padded(GString *result, gint field_len, gchar pad_char, gint base,
   return format_padded_int32(result, field_len, pad_char, 1, base, value);
 }
 
+/* Fixed-width, zero padded decimal conversions for the known-width fields
+ * of the timestamp formats (two digit date components, the millisecond
+ * part).  Values too wide for the field fall back to the generic path,
+ * which widens the field the same way format_uint32_padded() does. */
+
+gint
+format_uint32_2digits(GString *result, guint32 value)
+{
+  gint pos;
+
+  if (G_UNLIKELY(value >= 100))
+    return format_uint32_padded(result, 2, '0', 10, value);
+
+  pos = result->len;
+  if (G_UNLIKELY(result->allocated_len < pos + 2 + 1))
+    {
+      g_string_set_size(result, pos + 2);
+    }
+  else
+    {
+      result->len += 2;
+      result->str[pos + 2] = 0;
+    }
+  memcpy(result->str + pos, &digit_pairs[value << 1], 2);
+  return 2;
+}
+
+gint
+format_uint32_3digits(GString *result, guint32 value)
+{
+  gint pos;
+
+  if (G_UNLIKELY(value >= 1000))
+    return format_uint32_padded(result, 3, '0', 10, value);
+
+  pos = result->len;
+  if (G_UNLIKELY(result->allocated_len < pos + 3 + 1))
+    {
+      g_string_set_size(result, pos + 3);
+    }
+  else
+    {
+      result->len += 3;
+      result->str[pos + 3] = 0;
+    }
+  result->str[pos] = digits[value / 100];
+  memcpy(result->str + pos + 1, &digit_pairs[(value % 100) << 1], 2);
+  return 3;
+}
+
 gchar *
 format_hex_string_with_delimiter(gpointer data, gsize data_len, gchar *result, gsize result_len, gchar delimiter)
 {
@@ -441,10 +529,37 @@ scan_month_abbrev(const gchar **buf, gint *left, gint *mon)
 }
 
 
+#define SCAN_DIGIT(c)        ((c) >= '0' && (c) <= '9')
+#define SCAN_2DIGITS(p)      (((p)[0] - '0') * 10 + ((p)[1] - '0'))
+
 /* this function parses the date/time portion of an ISODATE */
 gboolean
 scan_iso_timestamp(const gchar **buf, gint *left, struct tm *tm)
 {
+  const gchar *src = *buf;
+
+  /* fast path for the fixed YYYY-MM-DDTHH:MM:SS layout: validate all
+   * digit positions up front, then convert with unrolled arithmetic
+   * instead of the per-character scan_int()/scan_expect_char() chain */
+  if (*left >= 19 &&
+      SCAN_DIGIT(src[0]) && SCAN_DIGIT(src[1]) && SCAN_DIGIT(src[2]) && SCAN_DIGIT(src[3]) &&
+      src[4] == '-' && SCAN_DIGIT(src[5]) && SCAN_DIGIT(src[6]) &&
+      src[7] == '-' && SCAN_DIGIT(src[8]) && SCAN_DIGIT(src[9]) &&
+      src[10] == 'T' && SCAN_DIGIT(src[11]) && SCAN_DIGIT(src[12]) &&
+      src[13] == ':' && SCAN_DIGIT(src[14]) && SCAN_DIGIT(src[15]) &&
+      src[16] == ':' && SCAN_DIGIT(src[17]) && SCAN_DIGIT(src[18]))
+    {
+      tm->tm_year = SCAN_2DIGITS(&src[0]) * 100 + SCAN_2DIGITS(&src[2]) - 1900;
+      tm->tm_mon = SCAN_2DIGITS(&src[5]) - 1;
+      tm->tm_mday = SCAN_2DIGITS(&src[8]);
+      tm->tm_hour = SCAN_2DIGITS(&src[11]);
+      tm->tm_min = SCAN_2DIGITS(&src[14]);
+      tm->tm_sec = SCAN_2DIGITS(&src[17]);
+      (*buf) += 19;
+      (*left) -= 19;
+      return TRUE;
+    }
+
   /* YYYY-MM-DDTHH:MM:SS */
   if (!scan_int(buf, left, 4, &tm->tm_year) ||
       !scan_expect_char(buf, left, '-') ||
@@ -507,6 +622,32 @@ scan_linksys_timestamp(const gchar **buf, gint *left, struct tm *tm)
 gboolean
 scan_bsd_timestamp(const gchar **buf, gint *left, struct tm *tm)
 {
+  const gchar *src = *buf;
+
+  /* fast path for the fixed "MMM dd HH:MM:SS" layout (day possibly
+   * space padded), same unrolled conversion as scan_iso_timestamp() */
+  if (*left >= 15 &&
+      src[3] == ' ' &&
+      (SCAN_DIGIT(src[4]) || src[4] == ' ') && SCAN_DIGIT(src[5]) &&
+      src[6] == ' ' && SCAN_DIGIT(src[7]) && SCAN_DIGIT(src[8]) &&
+      src[9] == ':' && SCAN_DIGIT(src[10]) && SCAN_DIGIT(src[11]) &&
+      src[12] == ':' && SCAN_DIGIT(src[13]) && SCAN_DIGIT(src[14]))
+    {
+      const gchar *p = src;
+      gint l = *left;
+
+      if (scan_month_abbrev(&p, &l, &tm->tm_mon))
+        {
+          tm->tm_mday = (src[4] == ' ' ? 0 : (src[4] - '0') * 10) + (src[5] - '0');
+          tm->tm_hour = SCAN_2DIGITS(&src[7]);
+          tm->tm_min = SCAN_2DIGITS(&src[10]);
+          tm->tm_sec = SCAN_2DIGITS(&src[13]);
+          (*buf) += 15;
+          (*left) -= 15;
+          return TRUE;
+        }
+    }
+
   /* RFC 3164 timestamp, expected format: MMM DD HH:MM:SS ... */
   if (!scan_month_abbrev(buf, left, &tm->tm_mon) ||
       !scan_expect_char(buf, left, ' ') ||
@@ -76,6 +76,139 @@ struct sl_name sl_facilities[] = {
   {NULL, -1}
 };
 
+/* Reverse tables indexed by the numeric code, built once at startup so
+ * the PRI derived macros ($FACILITY, $LEVEL, their _NUM variants and
+ * $PRI) expand to a table index plus one bounded append instead of
+ * walking the name tables and formatting numbers for every message.
+ * The first name listed for a code wins, matching what the linear
+ * syslog_name_lookup_name_by_value() scan returned; codes without a
+ * name fall back to their precomputed numeric form. */
+typedef struct _SlReverseEntry
+{
+  const char *name;
+  gsize len;
+} SlReverseEntry;
+
+#define SL_NUM_FACILITIES ((LOG_FACMASK >> 3) + 1)
+#define SL_NUM_PRIS       ((LOG_FACMASK | LOG_PRIMASK) + 1)
+
+static SlReverseEntry sl_level_names_by_code[(LOG_PRIMASK) + 1];
+static SlReverseEntry sl_facility_names_by_code[SL_NUM_FACILITIES];
+static SlReverseEntry sl_level_nums_by_code[(LOG_PRIMASK) + 1];
+static gchar sl_level_num_strings[(LOG_PRIMASK) + 1][4];
+static SlReverseEntry sl_facility_nums_by_code[SL_NUM_FACILITIES];
+static gchar sl_facility_num_strings[SL_NUM_FACILITIES][4];
+static gchar sl_facility_hex_strings[SL_NUM_FACILITIES][4];
+static SlReverseEntry sl_pris_by_value[SL_NUM_PRIS];
+static gchar sl_pri_strings[SL_NUM_PRIS][5];
+
+void
+syslog_names_global_init(void)
+{
+  gint i;
+
+  for (i = 0; sl_levels[i].name; i++)
+    {
+      SlReverseEntry *entry = &sl_level_names_by_code[LOG_PRI(sl_levels[i].value)];
+
+      if (!entry->name)
+        {
+          entry->name = sl_levels[i].name;
+          entry->len = strlen(sl_levels[i].name);
+        }
+    }
+
+  for (i = 0; sl_facilities[i].name; i++)
+    {
+      SlReverseEntry *entry = &sl_facility_names_by_code[LOG_FAC(sl_facilities[i].value)];
+
+      if (!entry->name)
+        {
+          entry->name = sl_facilities[i].name;
+          entry->len = strlen(sl_facilities[i].name);
+        }
+    }
+
+  for (i = 0; i <= LOG_PRIMASK; i++)
+    {
+      sl_level_nums_by_code[i].len = g_snprintf(sl_level_num_strings[i], sizeof(sl_level_num_strings[0]), "%d", i);
+      sl_level_nums_by_code[i].name = sl_level_num_strings[i];
+
+      /* every level code has a name, but stay safe */
+      if (!sl_level_names_by_code[i].name)
+        sl_level_names_by_code[i] = sl_level_nums_by_code[i];
+    }
+
+  for (i = 0; i < SL_NUM_FACILITIES; i++)
+    {
+      sl_facility_nums_by_code[i].len = g_snprintf(sl_facility_num_strings[i], sizeof(sl_facility_num_strings[0]), "%d", i);
+      sl_facility_nums_by_code[i].name = sl_facility_num_strings[i];
+
+      /* $FACILITY has historically printed unknown codes in hex */
+      if (!sl_facility_names_by_code[i].name)
+        {
+          sl_facility_names_by_code[i].len = g_snprintf(sl_facility_hex_strings[i], sizeof(sl_facility_hex_strings[0]), "%x", i);
+          sl_facility_names_by_code[i].name = sl_facility_hex_strings[i];
+        }
+    }
+
+  for (i = 0; i < SL_NUM_PRIS; i++)
+    {
+      sl_pris_by_value[i].len = g_snprintf(sl_pri_strings[i], sizeof(sl_pri_strings[0]), "%d", i);
+      sl_pris_by_value[i].name = sl_pri_strings[i];
+    }
+}
+
+const gchar *
+syslog_name_lookup_level_name_by_value(int value, gsize *len)
+{
+  const SlReverseEntry *entry = &sl_level_names_by_code[LOG_PRI(value)];
+
+  *len = entry->len;
+  return entry->name;
+}
+
+const gchar *
+syslog_name_lookup_facility_name_by_value(int value, gsize *len)
+{
+  const SlReverseEntry *entry = &sl_facility_names_by_code[LOG_FAC(value)];
+
+  *len = entry->len;
+  return entry->name;
+}
+
+const gchar *
+syslog_name_lookup_level_num_by_value(int value, gsize *len)
+{
+  const SlReverseEntry *entry = &sl_level_nums_by_code[LOG_PRI(value)];
+
+  *len = entry->len;
+  return entry->name;
+}
+
+const gchar *
+syslog_name_lookup_facility_num_by_value(int value, gsize *len)
+{
+  const SlReverseEntry *entry = &sl_facility_nums_by_code[LOG_FAC(value)];
+
+  *len = entry->len;
+  return entry->name;
+}
+
+/* returns NULL if @value does not fit the PRI range, e.g. for messages
+ * carrying a raw pri beyond facility 127 */
+const gchar *
+syslog_name_lookup_pri_by_value(int value, gsize *len)
+{
+  const SlReverseEntry *entry;
+
+  if (G_UNLIKELY(value < 0 || value >= SL_NUM_PRIS))
+    return NULL;
+  entry = &sl_pris_by_value[value];
+  *len = entry->len;
+  return entry->name;
+}
+
 static inline int
 syslog_name_find_name(const char *name, struct sl_name names[])
 {
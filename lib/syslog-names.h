@@ -50,6 +50,17 @@ int syslog_name_lookup_id_by_name(const char *name, struct sl_name names[]);
 int syslog_name_lookup_value_by_name(const char *name, struct sl_name names[]);
 const char *syslog_name_lookup_name_by_value(int value, struct sl_name names[]);
 
+/* O(1) reverse lookups with precomputed name lengths for macro
+ * expansion; filled at startup for every code (numeric fallback for
+ * codes without a name), so they never return NULL */
+const gchar *syslog_name_lookup_level_name_by_value(int value, gsize *len);
+const gchar *syslog_name_lookup_facility_name_by_value(int value, gsize *len);
+const gchar *syslog_name_lookup_level_num_by_value(int value, gsize *len);
+const gchar *syslog_name_lookup_facility_num_by_value(int value, gsize *len);
+const gchar *syslog_name_lookup_pri_by_value(int value, gsize *len);
+
+void syslog_names_global_init(void);
+
 guint32 syslog_make_range(guint32 r1, guint32 r2);
 
 static inline guint32
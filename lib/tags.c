@@ -40,6 +40,37 @@ static guint32 log_tags_num = 0;
 static guint32 log_tags_list_size = 4;
 static GStaticMutex log_tags_lock = G_STATIC_MUTEX_INIT;
 
+/* Read-only snapshot of log_tags_hash, published once the configuration is
+ * frozen (log_tags_reinit_stats() at cfg_init() time) and republished
+ * whenever a tag is registered afterwards.  Lookups of already known tags
+ * -- e.g.  dynamic tag names resolved by patterndb for every message --
+ * don't need to take log_tags_lock, they only do an atomic pointer fetch
+ * and search an immutable hash.
+ *
+ * Replaced snapshots are kept around until deinit instead of being freed:
+ * a reader may still be looking at one and tag registrations are rare and
+ * bounded by LOG_TAGS_MAX, so the retired tables cost little.  The
+ * snapshot shares its key strings with log_tags_list, which never frees
+ * them before deinit either. */
+static GHashTable *log_tags_snapshot = NULL;
+static GList *log_tags_retired_snapshots = NULL;
+
+/* NOTE: must be called with log_tags_lock held */
+static void
+log_tags_publish_snapshot(void)
+{
+  GHashTable *snapshot;
+  gint id;
+
+  snapshot = g_hash_table_new(g_str_hash, g_str_equal);
+  for (id = 0; id < log_tags_num; id++)
+    g_hash_table_insert(snapshot, log_tags_list[id].name, GUINT_TO_POINTER(log_tags_list[id].id + 1));
+
+  if (log_tags_snapshot)
+    log_tags_retired_snapshots = g_list_prepend(log_tags_retired_snapshots, log_tags_snapshot);
+  g_atomic_pointer_set(&log_tags_snapshot, snapshot);
+}
+
 
 /*
  * log_tags_get_by_name
@@ -63,9 +94,18 @@ log_tags_get_by_name(const gchar *name)
      In both cases the return value is 0.
    */
   guint id;
+  GHashTable *snapshot;
 
   g_assert(log_tags_hash != NULL);
 
+  snapshot = g_atomic_pointer_get(&log_tags_snapshot);
+  if (snapshot)
+    {
+      id = GPOINTER_TO_UINT(g_hash_table_lookup(snapshot, name)) - 1;
+      if (id != 0xffffffff)
+        return id;
+    }
+
   g_static_mutex_lock(&log_tags_lock);
 
   id = GPOINTER_TO_UINT(g_hash_table_lookup(log_tags_hash, name)) - 1;
@@ -92,6 +132,11 @@ log_tags_get_by_name(const gchar *name)
           stats_unlock();
 
           g_hash_table_insert(log_tags_hash, log_tags_list[id].name, GUINT_TO_POINTER(log_tags_list[id].id + 1));
+
+          /* once frozen, keep the lock-free snapshot in sync with the
+           * authoritative hash */
+          if (log_tags_snapshot)
+            log_tags_publish_snapshot();
         }
       else
         id = 0;
@@ -180,6 +225,13 @@ log_tags_reinit_stats(GlobalConfig *cfg)
     }
 
   stats_unlock();
+
+  /* cfg_init() is the point where the set of statically known tags is
+   * complete, publish the read-only snapshot used by the lock-free lookup
+   * path */
+  g_static_mutex_lock(&log_tags_lock);
+  log_tags_publish_snapshot();
+  g_static_mutex_unlock(&log_tags_lock);
 }
 
 void
@@ -207,6 +259,15 @@ log_tags_global_deinit(void)
 
   g_hash_table_destroy(log_tags_hash);
 
+  if (log_tags_snapshot)
+    {
+      g_hash_table_destroy(log_tags_snapshot);
+      log_tags_snapshot = NULL;
+    }
+  g_list_foreach(log_tags_retired_snapshots, (GFunc) g_hash_table_destroy, NULL);
+  g_list_free(log_tags_retired_snapshots);
+  log_tags_retired_snapshots = NULL;
+
   stats_lock();
   for (i = 0; i < log_tags_num; i++)
     {
@@ -467,6 +467,48 @@ log_template_compiler_process_token(LogTemplateCompiler *self, GError **error)
   return TRUE;
 }
 
+static inline gboolean
+log_template_elem_is_pure_literal(LogTemplateElem *e)
+{
+  return e->type == LTE_MACRO && e->macro == M_NONE && !e->default_value;
+}
+
+/* Merge pure literal elements (M_NONE macros that only carry text) into
+ * the literal prefix of the element that follows them, so that each
+ * literal run is emitted with a single append at expansion time.  The
+ * compiler itself only produces such elements at the end of the template,
+ * but concatenated or rewritten element lists can contain them anywhere. */
+static void
+log_template_compiler_merge_literals(GList **compiled_template)
+{
+  GList *p = *compiled_template;
+
+  while (p && g_list_next(p))
+    {
+      GList *next = g_list_next(p);
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+      LogTemplateElem *n = (LogTemplateElem *) next->data;
+
+      if (log_template_elem_is_pure_literal(e))
+        {
+          gchar *merged = g_malloc(e->text_len + n->text_len + 1);
+
+          memcpy(merged, e->text, e->text_len);
+          if (n->text_len)
+            memcpy(merged + e->text_len, n->text, n->text_len);
+          merged[e->text_len + n->text_len] = 0;
+          g_free(n->text);
+          n->text = merged;
+          n->text_len += e->text_len;
+
+          g_free(e->text);
+          g_free(e);
+          *compiled_template = g_list_delete_link(*compiled_template, p);
+        }
+      p = next;
+    }
+}
+
 static void
 log_template_compiler_free_result(LogTemplateCompiler *self)
 {
@@ -497,6 +539,8 @@ log_template_compiler_compile(LogTemplateCompiler *self, GList **compiled_templa
  error:
   *compiled_template = g_list_reverse(self->result);
   self->result = NULL;
+  if (result)
+    log_template_compiler_merge_literals(compiled_template);
   return result;
 }
 
@@ -27,10 +27,25 @@
 
 #include <string.h>
 
+/* bytes that need escaping: control characters, the two quote characters
+ * and the backslash; everything else forms "clean runs" that are appended
+ * with a single memcpy instead of char-by-char */
+static const guint8 escape_dirty_chars[256] =
+{
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x00 - 0x0f */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x10 - 0x1f */
+  0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x20 - 0x2f, 0x22 is the double, 0x27 the single quote */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x30 - 0x3f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x40 - 0x4f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,  /* 0x50 - 0x5f, 0x5c is the backslash */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x60 - 0x6f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x70 - 0x7f */
+};
+
 void
 result_append(GString *result, const gchar *sstr, gssize len, gboolean escape)
 {
-  gint i;
+  gint i, run_start;
   const guchar *ustr = (const guchar *) sstr;
 
   if (len < 0)
@@ -38,21 +53,28 @@ result_append(GString *result, const gchar *sstr, gssize len, gboolean escape)
 
   if (escape)
     {
+      run_start = 0;
       for (i = 0; i < len; i++)
         {
+          if (!escape_dirty_chars[ustr[i]])
+            continue;
+
+          if (i != run_start)
+            g_string_append_len(result, sstr + run_start, i - run_start);
           if (ustr[i] == '\'' || ustr[i] == '"' || ustr[i] == '\\')
             {
               g_string_append_c(result, '\\');
               g_string_append_c(result, ustr[i]);
             }
-          else if (ustr[i] < ' ')
+          else
             {
               g_string_append_c(result, '\\');
               format_uint32_padded(result, 3, '0', 8, ustr[i]);
             }
-          else
-            g_string_append_c(result, ustr[i]);
+          run_start = i + 1;
         }
+      if (i != run_start)
+        g_string_append_len(result, sstr + run_start, i - run_start);
     }
   else
     g_string_append_len(result, sstr, len);
@@ -79,6 +79,11 @@ struct _LogTemplateFunction
 
   /* generic argument that can be used to pass information from registration time */
   gpointer arg;
+
+  /* optional: returns whether this invocation produces the same output
+   * for every message (pure function, all arguments literal).  Such
+   * invocations are folded into literal text at compile time. */
+  gboolean (*is_constant)(LogTemplateFunction *self, gpointer state);
 };
 
 #define TEMPLATE_FUNCTION_PROTOTYPE(prefix) \
@@ -91,7 +96,7 @@ struct _LogTemplateFunction
   TEMPLATE_FUNCTION_PROTOTYPE(prefix);
 
 /* helper macros for template function plugins */
-#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+#define TEMPLATE_FUNCTION_EX(state_struct, prefix, prepare, eval, call, free_state, arg, is_constant) \
   TEMPLATE_FUNCTION_PROTOTYPE(prefix) 					\
   {                                                                     \
     static LogTemplateFunction func = {                                 \
@@ -101,11 +106,15 @@ struct _LogTemplateFunction
       call,                                                             \
       free_state,                                                       \
       NULL,								\
-      arg                                                               \
+      arg,                                                              \
+      is_constant                                                       \
     };                                                                  \
     return &func;                                                       \
   }
 
+#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+  TEMPLATE_FUNCTION_EX(state_struct, prefix, prepare, eval, call, free_state, arg, NULL)
+
 #define TEMPLATE_FUNCTION_PLUGIN(x, tf_name) \
   {                                     \
     .type = LL_CONTEXT_TEMPLATE_FUNC,   \
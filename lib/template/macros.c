@@ -182,6 +182,11 @@ static GTimeVal app_uptime;
 static GHashTable *macro_hash;
 static LogTemplateOptions template_options_for_macro_expand;
 
+/* hidden NV entry holding the composed "program[pid]: " header, so that a
+ * message expanded through multiple $MSGHDR references (e.g. the same
+ * template in several destinations) only pays for the concatenation once */
+static NVHandle handle_cached_msghdr;
+
 static void
 _result_append_value(GString *result, const LogMessage *lm, NVHandle handle, gboolean escape)
 {
@@ -215,43 +220,38 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
       {
         /* facility */
         const char *n;
+        gsize len = 0;
 
-        n = syslog_name_lookup_name_by_value(msg->pri & LOG_FACMASK, sl_facilities);
-        if (n)
-          {
-            g_string_append(result, n);
-          }
-        else
-          {
-            format_uint32_padded(result, 0, 0, 16, (msg->pri & LOG_FACMASK) >> 3);
-          }
+        n = syslog_name_lookup_facility_name_by_value(msg->pri, &len);
+        g_string_append_len(result, n, len);
         break;
       }
     case M_FACILITY_NUM:
       {
-        format_uint32_padded(result, 0, 0, 10, (msg->pri & LOG_FACMASK) >> 3);
+        const char *n;
+        gsize len = 0;
+
+        n = syslog_name_lookup_facility_num_by_value(msg->pri, &len);
+        g_string_append_len(result, n, len);
         break;
       }
     case M_LEVEL:
       {
         /* level */
         const char *n;
+        gsize len = 0;
 
-        n = syslog_name_lookup_name_by_value(msg->pri & LOG_PRIMASK, sl_levels);
-        if (n)
-          {
-            g_string_append(result, n);
-          }
-        else
-          {
-            format_uint32_padded(result, 0, 0, 10, msg->pri & LOG_PRIMASK);
-          }
-
+        n = syslog_name_lookup_level_name_by_value(msg->pri, &len);
+        g_string_append_len(result, n, len);
         break;
       }
     case M_LEVEL_NUM:
       {
-        format_uint32_padded(result, 0, 0, 10, msg->pri & LOG_PRIMASK);
+        const char *n;
+        gsize len = 0;
+
+        n = syslog_name_lookup_level_num_by_value(msg->pri, &len);
+        g_string_append_len(result, n, len);
         break;
       }
     case M_TAG:
@@ -272,7 +272,14 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
       }
     case M_PRI:
       {
-        format_uint32_padded(result, 0, 0, 10, msg->pri);
+        const char *n;
+        gsize len = 0;
+
+        n = syslog_name_lookup_pri_by_value(msg->pri, &len);
+        if (G_LIKELY(n))
+          g_string_append_len(result, n, len);
+        else
+          format_uint32_padded(result, 0, 0, 10, msg->pri);
         break;
       }
     case M_HOST:
@@ -328,11 +335,20 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
       else
         {
           /* message, complete with program name and pid */
+          const gchar *hdr;
+          gssize hdr_ofs;
           gssize len;
 
-          len = result->len;
+          hdr = log_msg_get_value(msg, handle_cached_msghdr, &len);
+          if (len > 0)
+            {
+              result_append(result, hdr, len, escape);
+              break;
+            }
+
+          hdr_ofs = result->len;
           _result_append_value(result, msg, LM_V_PROGRAM, escape);
-          if (len != result->len)
+          if (hdr_ofs != result->len)
             {
               const gchar *pid = log_msg_get_value(msg, LM_V_PID, &len);
               if (len > 0)
@@ -342,6 +358,14 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
                   result_append(result, "]", 1, FALSE);
                 }
               result_append(result, ": ", 2, FALSE);
+
+              /* remember the composed header for subsequent expansions; only
+               * the unescaped form is cached (the cached value is escaped on
+               * the way out above) and shared messages are left alone, they
+               * simply recompute */
+              if (!escape && !log_msg_is_write_protected(msg))
+                log_msg_set_value((LogMessage *) msg, handle_cached_msghdr,
+                                  result->str + hdr_ofs, result->len - hdr_ofs);
             }
         }
       break;
@@ -352,14 +376,12 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
       break;
     case M_SOURCE_IP:
       {
-        gchar *ip;
-        
+        const gchar *ip;
+
         if(_is_message_source_an_ip_address(msg))
           {
-            gchar buf[MAX_SOCKADDR_STRING];
-
-            g_sockaddr_format(msg->saddr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
-            ip = buf;
+            /* cached on the sockaddr, formatted once per connection */
+            ip = g_sockaddr_get_address_str(msg->saddr);
           }
         else
           {
@@ -500,16 +522,16 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
             format_uint32_padded(result, 0, 0, 10, tm->tm_wday + 1);
             break;
           case M_WEEK:
-            format_uint32_padded(result, 2, '0', 10, (tm->tm_yday - (tm->tm_wday - 1 + 7) % 7 + 7) / 7);
+            format_uint32_2digits(result, (tm->tm_yday - (tm->tm_wday - 1 + 7) % 7 + 7) / 7);
             break;
           case M_YEAR:
             format_uint32_padded(result, 4, '0', 10, tm->tm_year + 1900);
             break;
           case M_YEAR_DAY:
-            format_uint32_padded(result, 3, '0', 10, tm->tm_yday + 1);
+            format_uint32_3digits(result, tm->tm_yday + 1);
             break;
           case M_MONTH:
-            format_uint32_padded(result, 2, '0', 10, tm->tm_mon + 1);
+            format_uint32_2digits(result, tm->tm_mon + 1);
             break;
           case M_MONTH_WEEK:
             format_uint32_padded(result, 0, 0, 10, ((tm->tm_mday / 7) + ((tm->tm_wday > 0) && ((tm->tm_mday % 7) >= tm->tm_wday))));
@@ -521,10 +543,10 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
             g_string_append(result, month_names[tm->tm_mon]);
             break;
           case M_DAY:
-            format_uint32_padded(result, 2, '0', 10, tm->tm_mday);
+            format_uint32_2digits(result, tm->tm_mday);
             break;
           case M_HOUR:
-            format_uint32_padded(result, 2, '0', 10, tm->tm_hour);
+            format_uint32_2digits(result, tm->tm_hour);
             break;
           case M_HOUR12:
             if (tm->tm_hour < 12)
@@ -534,16 +556,16 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
 
             if (tmp_hour == 0)
               tmp_hour = 12;
-            format_uint32_padded(result, 2, '0', 10, tmp_hour);
+            format_uint32_2digits(result, tmp_hour);
             break;
           case M_MIN:
-            format_uint32_padded(result, 2, '0', 10, tm->tm_min);
+            format_uint32_2digits(result, tm->tm_min);
             break;
           case M_SEC:
-            format_uint32_padded(result, 2, '0', 10, tm->tm_sec);
+            format_uint32_2digits(result, tm->tm_sec);
             break;
           case M_MSEC:
-            format_uint32_padded(result, 3, '0', 10, stamp->tv_usec/1000);
+            format_uint32_3digits(result, stamp->tv_usec/1000);
             break;
           case M_USEC:
             format_uint32_padded(result, 6, '0', 10, stamp->tv_usec);
@@ -617,6 +639,7 @@ log_macros_global_init(void)
       g_hash_table_insert(macro_hash, macros[i].name,
                           GINT_TO_POINTER(macros[i].id));
     }
+  handle_cached_msghdr = log_msg_get_value_handle(".msghdr");
   return;
 }
 
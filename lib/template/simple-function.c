@@ -24,6 +24,9 @@
 
 #include "template/simple-function.h"
 #include "template/templates.h"
+#include "stats/stats.h"
+
+#include <string.h>
 
 void
 log_template_append_format_recursive(LogTemplate *self, const LogTemplateInvokeArgs *args, GString *result)
@@ -56,11 +59,40 @@ tf_simple_func_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *paren
         goto error;
     }
   state->argc = argc - 1;
+
+  /* most invocations are of the $(func $HOST ...) form; classify such
+   * arguments up front so tf_simple_func_eval() can copy them as spans
+   * instead of spinning up the template executor for each of them on
+   * every message */
+  state->literal_argv = g_new0(const gchar *, state->argc);
+  state->value_handle_argv = g_new0(NVHandle, state->argc);
+  for (i = 0; i < state->argc; i++)
+    {
+      state->literal_argv[i] = log_template_get_literal_value(state->argv[i]);
+      if (!state->literal_argv[i])
+        state->value_handle_argv[i] = log_template_get_trivial_value_handle(state->argv[i]);
+    }
   return TRUE;
  error:
   return FALSE;
 }
 
+/* is_constant hook shared by pure simple functions: the invocation is a
+ * compile time constant when every argument compiles to a literal */
+gboolean
+tf_simple_func_is_constant(LogTemplateFunction *self, gpointer s)
+{
+  TFSimpleFuncState *state = (TFSimpleFuncState *) s;
+  gint i;
+
+  for (i = 0; i < state->argc; i++)
+    {
+      if (!log_template_get_literal_value(state->argv[i]))
+        return FALSE;
+    }
+  return TRUE;
+}
+
 void
 tf_simple_func_eval(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args)
 {
@@ -77,7 +109,25 @@ tf_simple_func_eval(LogTemplateFunction *self, gpointer s, const LogTemplateInvo
       arg = (GString **) &g_ptr_array_index(args->bufs, i);
       g_string_truncate(*arg, 0);
 
-      log_template_append_format_recursive(state->argv[i], args, *arg);
+      if (state->literal_argv && state->literal_argv[i])
+        {
+          /* constant argument, copy the compiled literal */
+          g_string_append(*arg, state->literal_argv[i]);
+        }
+      else if (state->value_handle_argv && state->value_handle_argv[i])
+        {
+          /* bare value reference, serve it as a span straight from the
+           * message payload */
+          const gchar *value;
+          gssize value_len;
+
+          value = log_msg_get_value(args->messages[args->num_messages - 1], state->value_handle_argv[i], &value_len);
+          g_string_append_len(*arg, value, value_len);
+        }
+      else
+        {
+          log_template_append_format_recursive(state->argv[i], args, *arg);
+        }
     }
 }
 
@@ -102,4 +152,167 @@ tf_simple_func_free_state(gpointer s)
         log_template_unref(state->argv[i]);
     }
   g_free(state->argv);
+  g_free(state->literal_argv);
+  g_free(state->value_handle_argv);
+}
+
+/*
+ * Opt-in memoization for expensive template functions, see
+ * TEMPLATE_FUNCTION_MEMOIZED.  Results are cached in a small per-thread
+ * LRU keyed on the resolved argument bytes, so evaluating $(sha1 $HOST)
+ * over the same couple of hundred hostnames does not recompute the digest
+ * for every message.  Per-thread caches need no locking, at the price of
+ * each worker warming up its own copy.
+ */
+
+#define TF_MEMOIZE_CACHE_SIZE 128
+
+typedef struct _TFMemoizeEntry
+{
+  GString *key;
+  GString *value;
+  GList *lru_link;
+} TFMemoizeEntry;
+
+typedef struct _TFMemoizeCache
+{
+  GHashTable *entries;
+  /* most recently used entries at the head */
+  GQueue *lru;
+  GString *scratch_key;
+} TFMemoizeCache;
+
+static GStaticPrivate tf_memoize_cache_private = G_STATIC_PRIVATE_INIT;
+static StatsCounterItem *tf_memoize_cache_hits;
+static StatsCounterItem *tf_memoize_cache_misses;
+
+static guint
+_memoize_key_hash(gconstpointer k)
+{
+  const GString *key = (const GString *) k;
+  guint hash = 5381;
+  gsize i;
+
+  for (i = 0; i < key->len; i++)
+    hash = (hash << 5) + hash + (guchar) key->str[i];
+  return hash;
+}
+
+static gboolean
+_memoize_key_equal(gconstpointer a, gconstpointer b)
+{
+  const GString *key_a = (const GString *) a;
+  const GString *key_b = (const GString *) b;
+
+  return key_a->len == key_b->len && memcmp(key_a->str, key_b->str, key_a->len) == 0;
+}
+
+static void
+_memoize_entry_free(gpointer data)
+{
+  TFMemoizeEntry *entry = (TFMemoizeEntry *) data;
+
+  g_string_free(entry->key, TRUE);
+  g_string_free(entry->value, TRUE);
+  g_free(entry);
+}
+
+static void
+_memoize_cache_free(gpointer data)
+{
+  TFMemoizeCache *cache = (TFMemoizeCache *) data;
+
+  g_hash_table_destroy(cache->entries);
+  g_queue_free(cache->lru);
+  g_string_free(cache->scratch_key, TRUE);
+  g_free(cache);
+}
+
+static TFMemoizeCache *
+_memoize_cache_get(void)
+{
+  TFMemoizeCache *cache = g_static_private_get(&tf_memoize_cache_private);
+
+  if (!cache)
+    {
+      cache = g_new0(TFMemoizeCache, 1);
+      cache->entries = g_hash_table_new_full(_memoize_key_hash, _memoize_key_equal, NULL, _memoize_entry_free);
+      cache->lru = g_queue_new();
+      cache->scratch_key = g_string_sized_new(256);
+      g_static_private_set(&tf_memoize_cache_private, cache, _memoize_cache_free);
+    }
+  return cache;
+}
+
+static void
+_memoize_format_key(GString *key, gpointer s, const LogTemplateInvokeArgs *args)
+{
+  guint i;
+
+  /* the state pointer identifies the template function instance, and
+   * with it the function name and any compile time options */
+  g_string_truncate(key, 0);
+  g_string_append_len(key, (gchar *) &s, sizeof(s));
+  for (i = 0; i < args->bufs->len; i++)
+    {
+      GString *arg = (GString *) g_ptr_array_index(args->bufs, i);
+      guint32 len = arg->len;
+
+      g_string_append_len(key, (gchar *) &len, sizeof(len));
+      g_string_append_len(key, arg->str, arg->len);
+    }
+}
+
+static void
+_memoize_store(TFMemoizeCache *cache, const GString *key, const gchar *value, gsize value_len)
+{
+  TFMemoizeEntry *entry;
+
+  if (g_hash_table_size(cache->entries) >= TF_MEMOIZE_CACHE_SIZE)
+    {
+      TFMemoizeEntry *victim = (TFMemoizeEntry *) g_queue_pop_tail(cache->lru);
+
+      g_hash_table_remove(cache->entries, victim->key);
+    }
+
+  entry = g_new0(TFMemoizeEntry, 1);
+  entry->key = g_string_new_len(key->str, key->len);
+  entry->value = g_string_new_len(value, value_len);
+  g_hash_table_insert(cache->entries, entry->key, entry);
+  g_queue_push_head(cache->lru, entry);
+  entry->lru_link = cache->lru->head;
+}
+
+void
+tf_simple_func_call_with_memoization(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args,
+                                     GString *result, TFSimpleFuncCall real_call)
+{
+  TFMemoizeCache *cache = _memoize_cache_get();
+  TFMemoizeEntry *entry;
+  gsize orig_len;
+
+  _memoize_format_key(cache->scratch_key, s, args);
+  entry = (TFMemoizeEntry *) g_hash_table_lookup(cache->entries, cache->scratch_key);
+  if (entry)
+    {
+      g_string_append_len(result, entry->value->str, entry->value->len);
+      g_queue_unlink(cache->lru, entry->lru_link);
+      g_queue_push_head_link(cache->lru, entry->lru_link);
+      stats_counter_inc(tf_memoize_cache_hits);
+      return;
+    }
+
+  orig_len = result->len;
+  real_call(self, s, args, result);
+  _memoize_store(cache, cache->scratch_key, result->str + orig_len, result->len - orig_len);
+  stats_counter_inc(tf_memoize_cache_misses);
+}
+
+void
+tf_simple_func_global_init(void)
+{
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "tf_memoize_cache_hits", NULL, SC_TYPE_PROCESSED, &tf_memoize_cache_hits);
+  stats_register_counter(0, SCS_GLOBAL, "tf_memoize_cache_misses", NULL, SC_TYPE_PROCESSED, &tf_memoize_cache_misses);
+  stats_unlock();
 }
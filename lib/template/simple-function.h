@@ -26,6 +26,7 @@
 #define TEMPLATE_SIMPLE_FUNCTION_H_INCLUDED
 
 #include "template/function.h"
+#include "logmsg.h"
 
 /* function pointers for template functions */
 
@@ -33,15 +34,49 @@ typedef struct _TFSimpleFuncState
 {
   gint argc;
   LogTemplate **argv;
+
+  /* per-argument classification filled in by tf_simple_func_prepare():
+   * arguments that compile to a constant string or to a bare value
+   * reference are marshalled as (pointer, length) spans in
+   * tf_simple_func_eval() instead of running the template executor */
+  const gchar **literal_argv;
+  NVHandle *value_handle_argv;
 } TFSimpleFuncState;
 
 typedef void (*TFSimpleFunc)(LogMessage *msg, gint argc, GString *argv[], GString *result);
+typedef void (*TFSimpleFuncCall)(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args, GString *result);
 
 gboolean tf_simple_func_prepare(LogTemplateFunction *self, gpointer state, LogTemplate *parent, gint argc, gchar *argv[], GError **error);
+gboolean tf_simple_func_is_constant(LogTemplateFunction *self, gpointer state);
 void tf_simple_func_eval(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args);
 void tf_simple_func_call(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args, GString *result);
+void tf_simple_func_call_with_memoization(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args, GString *result, TFSimpleFuncCall real_call);
 void tf_simple_func_free_state(gpointer state);
+void tf_simple_func_global_init(void);
 
 #define TEMPLATE_FUNCTION_SIMPLE(x) TEMPLATE_FUNCTION(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x)
 
+/* variant for pure functions whose output depends solely on their
+ * arguments (no message state, no external input): invocations with
+ * all-literal arguments are folded into the surrounding literal text at
+ * compile time */
+#define TEMPLATE_FUNCTION_SIMPLE_PURE(x) TEMPLATE_FUNCTION_EX(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x, tf_simple_func_is_constant)
+
+/* opt-in memoization for expensive, deterministic functions: the result is
+ * cached in a small per-thread LRU keyed on the resolved argument bytes.
+ * Only use this for functions whose output depends solely on their
+ * arguments, never for ones drawing on randomness or message state.  The
+ * same contract makes all-literal invocations compile time constants, so
+ * these are also folded (the state struct must embed TFSimpleFuncState
+ * as its first member, which tf_simple_func_free_state requires anyway). */
+#define TEMPLATE_FUNCTION_MEMOIZED(state_struct, prefix, prepare, eval, call, free_state, arg) \
+  static void                                                           \
+  prefix ## _call_memoized(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args, GString *result) \
+  {                                                                     \
+    tf_simple_func_call_with_memoization(self, s, args, result, call);  \
+  }                                                                     \
+  TEMPLATE_FUNCTION_EX(state_struct, prefix, prepare, eval, prefix ## _call_memoized, free_state, arg, tf_simple_func_is_constant)
+
+#define TEMPLATE_FUNCTION_SIMPLE_MEMOIZED(x) TEMPLATE_FUNCTION_MEMOIZED(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x)
+
 #endif
@@ -26,13 +26,124 @@
 #include "template/compiler.h"
 #include "template/macros.h"
 #include "template/escaping.h"
+#include "template/simple-function.h"
 #include "cfg.h"
 
+#include <string.h>
+
+/* number of distinct results kept by the result cache, dynamic key sets
+ * (e.g. filename templates over an open-ended set of hosts) shouldn't
+ * grow without bounds */
+#define LOG_TEMPLATE_RESULT_CACHE_LIMIT 1024
+
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  /* the exec array borrows the internal pointers of the list elements,
+   * it has to go first and only the array itself is freed */
+  g_free(self->exec_elems);
+  self->exec_elems = NULL;
+  self->num_exec_elems = 0;
+  self->literal_len = 0;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
+  if (self->result_cache)
+    g_hash_table_remove_all(self->result_cache);
+}
+
+/* flatten the compiled element list into a contiguous array, so that
+ * expansion walks cache-friendly memory instead of chasing GList
+ * pointers; the element contents (pre-measured constants, pre-resolved
+ * value handles) are copied by value */
+static void
+log_template_flatten_compiled(LogTemplate *self)
+{
+  GList *p;
+  gint i = 0;
+
+  self->num_exec_elems = g_list_length(self->compiled_template);
+  self->exec_elems = g_new(LogTemplateElem, self->num_exec_elems);
+  self->literal_len = 0;
+  for (p = self->compiled_template; p; p = g_list_next(p))
+    {
+      self->exec_elems[i] = *(LogTemplateElem *) p->data;
+      self->literal_len += self->exec_elems[i].text_len;
+      i++;
+    }
+}
+
+/* evaluate template function invocations that declare themselves
+ * constant (pure function, all arguments literal -- see the is_constant
+ * hook) once at compile time and splice the result into the literal
+ * text of the element.  Arguments compile recursively before the parent,
+ * so $(echo $(lowercase CONST)) folds inside out.  Generated
+ * configurations tend to contain dozens of such constant calls. */
+static void
+log_template_fold_constant_elems(LogTemplate *self)
+{
+  GList *p;
+  LogMessage *dummy_msg = NULL;
+
+  for (p = self->compiled_template; p; p = g_list_next(p))
+    {
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+      LogTemplateInvokeArgs args;
+      GPtrArray *bufs;
+      GString *result;
+      gchar *text;
+      guint i;
+
+      if (e->type != LTE_FUNC || !e->func.ops->is_constant ||
+          !e->func.ops->is_constant(e->func.ops, e->func.state))
+        continue;
+
+      /* the message is never touched by a constant invocation, but the
+       * invocation interface hands one over nevertheless */
+      if (!dummy_msg)
+        dummy_msg = log_msg_new_empty();
+      bufs = g_ptr_array_new();
+      result = g_string_sized_new(64);
+
+      args.bufs = bufs;
+      args.messages = &dummy_msg;
+      args.num_messages = 1;
+      args.opts = NULL;
+      args.tz = LTZ_LOCAL;
+      args.seq_num = 0;
+      args.context_id = NULL;
+
+      if (e->func.ops->eval)
+        e->func.ops->eval(e->func.ops, e->func.state, &args);
+      e->func.ops->call(e->func.ops, e->func.state, &args, result);
+
+      /* release the function instance and turn the element into a literal */
+      if (e->func.state)
+        {
+          e->func.ops->free_state(e->func.state);
+          g_free(e->func.state);
+          e->func.state = NULL;
+        }
+      if (e->func.ops->free_fn)
+        e->func.ops->free_fn(e->func.ops);
+
+      text = g_malloc(e->text_len + result->len + 1);
+      if (e->text_len)
+        memcpy(text, e->text, e->text_len);
+      memcpy(text + e->text_len, result->str, result->len);
+      text[e->text_len + result->len] = 0;
+      g_free(e->text);
+      e->text = text;
+      e->text_len += result->len;
+      e->type = LTE_MACRO;
+      e->macro = M_NONE;
+
+      for (i = 0; i < bufs->len; i++)
+        g_string_free((GString *) g_ptr_array_index(bufs, i), TRUE);
+      g_ptr_array_free(bufs, TRUE);
+      g_string_free(result, TRUE);
+    }
+  if (dummy_msg)
+    log_msg_unref(dummy_msg);
 }
 
 gboolean
@@ -51,6 +162,11 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   log_template_compiler_init(&compiler, self);
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
+  if (result)
+    {
+      log_template_fold_constant_elems(self);
+      log_template_flatten_compiled(self);
+    }
   return result;
 }
 
@@ -72,18 +188,18 @@ log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **e
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  GList *p;
-  LogTemplateElem *e;
+  const LogTemplateElem *e;
+  gint ndx;
 
   if (!opts)
     opts = &self->cfg->template_options;
 
-  for (p = self->compiled_template; p; p = g_list_next(p))
+  for (ndx = 0; ndx < self->num_exec_elems; ndx++)
     {
       gint msg_ndx;
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      e = &self->exec_elems[ndx];
+      if (e->text_len)
         {
           g_string_append_len(result, e->text, e->text_len);
         }
@@ -164,11 +280,42 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
     }
 }
 
+/* make sure the constant parts of the template and the learned size of
+ * previous results fit the result buffer without reallocation; only used
+ * on the truncating entry points, where the buffer content is discarded
+ * anyway */
+static inline void
+log_template_presize_result(LogTemplate *self, GString *result)
+{
+  gsize expected = MAX(self->literal_len, self->result_size_hint);
+
+  if (result->allocated_len <= expected)
+    g_string_set_size(result, expected);
+  g_string_truncate(result, 0);
+}
+
+/* track an exponentially decayed maximum of result lengths: growth is
+ * immediate so the very next expansion already fits, while the decay
+ * (1/64 per expansion below the hint) lets the hint drift back after a
+ * one-off outlier instead of oversizing every buffer forever; benign
+ * race, see the comment on result_size_hint */
+static inline void
+log_template_learn_result_size(LogTemplate *self, GString *result)
+{
+  gsize hint = self->result_size_hint;
+
+  if (result->len > hint)
+    self->result_size_hint = result->len;
+  else if (hint - result->len > hint >> 6)
+    self->result_size_hint = hint - (hint >> 6);
+}
+
 void
 log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  g_string_truncate(result, 0);
+  log_template_presize_result(self, result);
   log_template_append_format_with_context(self, messages, num_messages, opts, tz, seq_num, context_id, result);
+  log_template_learn_result_size(self, result);
 }
 
 void
@@ -180,8 +327,208 @@ log_template_append_format(LogTemplate *self, LogMessage *lm, const LogTemplateO
 void
 log_template_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  g_string_truncate(result, 0);
+  log_template_presize_result(self, result);
   log_template_append_format(self, lm, opts, tz, seq_num, context_id, result);
+  log_template_learn_result_size(self, result);
+}
+
+/**
+ * log_template_get_trivial_value_handle:
+ *
+ * If the template consists of a single value reference with no
+ * surrounding literal text (e.g. "$MSG"), return the handle of the
+ * referenced value, LM_V_NONE otherwise.  Such templates can be served
+ * by a direct log_msg_get_value() without going through the expansion
+ * loop.
+ **/
+NVHandle
+log_template_get_trivial_value_handle(LogTemplate *self)
+{
+  const LogTemplateElem *e;
+
+  if (self->num_exec_elems != 1 || self->escape)
+    return LM_V_NONE;
+  e = &self->exec_elems[0];
+  if (e->type != LTE_VALUE || e->text_len || e->msg_ref || e->default_value)
+    return LM_V_NONE;
+  return e->value_handle;
+}
+
+/**
+ * log_template_get_literal_value:
+ *
+ * If the template contains no references at all (it expands to a
+ * constant string), return the literal, NULL otherwise.
+ **/
+const gchar *
+log_template_get_literal_value(LogTemplate *self)
+{
+  const LogTemplateElem *e;
+
+  if (self->num_exec_elems != 1)
+    return NULL;
+  e = &self->exec_elems[0];
+  if (e->type != LTE_MACRO || e->macro != M_NONE || e->default_value)
+    return NULL;
+  return e->text ? e->text : "";
+}
+
+/* an element's expansion is a pure function of the message if its inputs
+ * can be captured in the cache key below; time related macros and
+ * template functions are excluded, they may consult the wall clock or
+ * arbitrary state */
+static gboolean
+log_template_elem_is_cacheable(const LogTemplateElem *e)
+{
+  if (e->msg_ref > 0)
+    return FALSE;
+  switch (e->type)
+    {
+    case LTE_VALUE:
+      return TRUE;
+    case LTE_MACRO:
+      switch (e->macro)
+        {
+        case M_FACILITY:
+        case M_FACILITY_NUM:
+        case M_LEVEL:
+        case M_LEVEL_NUM:
+        case M_TAG:
+        case M_BSDTAG:
+        case M_PRI:
+        case M_HOST:
+          return TRUE;
+        default:
+          return FALSE;
+        }
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * log_template_enable_result_cache:
+ *
+ * Attach a result cache to this template, to be consulted through
+ * log_template_format_cached().  Only templates whose expansion depends
+ * exclusively on message contents can be cached; returns whether caching
+ * could be enabled.
+ **/
+gboolean
+log_template_enable_result_cache(LogTemplate *self)
+{
+  gint i;
+
+  for (i = 0; i < self->num_exec_elems; i++)
+    {
+      if (!log_template_elem_is_cacheable(&self->exec_elems[i]))
+        return FALSE;
+    }
+  if (!self->result_cache)
+    self->result_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  return TRUE;
+}
+
+/* capture the inputs of all non-literal elements; components are length
+ * prefixed so differing value boundaries can't produce the same key */
+static gboolean
+log_template_build_cache_key(LogTemplate *self, LogMessage *lm, GString *key)
+{
+  gint i;
+
+  g_string_truncate(key, 0);
+  for (i = 0; i < self->num_exec_elems; i++)
+    {
+      const LogTemplateElem *e = &self->exec_elems[i];
+
+      if (e->type == LTE_VALUE)
+        {
+          gssize len = 0;
+          const gchar *value = log_msg_get_value(lm, e->value_handle, &len);
+
+          if (memchr(value, 0, len))
+            return FALSE;
+          g_string_append_printf(key, "%" G_GSSIZE_FORMAT ":", len);
+          g_string_append_len(key, value, len);
+        }
+      else if (e->type == LTE_MACRO && e->macro == M_HOST)
+        {
+          gssize len = 0;
+          const gchar *value = log_msg_get_value(lm, LM_V_HOST, &len);
+
+          if (memchr(value, 0, len))
+            return FALSE;
+          g_string_append_printf(key, "%c%" G_GSSIZE_FORMAT ":",
+                                 (lm->flags & LF_CHAINED_HOSTNAME) ? 'c' : 'h', len);
+          g_string_append_len(key, value, len);
+        }
+      else if (e->type == LTE_MACRO)
+        {
+          /* the remaining cacheable macros all derive from the priority field */
+          g_string_append_printf(key, "%d;", lm->pri);
+        }
+    }
+  return TRUE;
+}
+
+/**
+ * log_template_append_format_cached:
+ *
+ * Append the expansion of the template to @result, serving repeated
+ * expansions with the same inputs from the result cache.  Falls back to
+ * a full format when the cache is not enabled.  Returns whether the
+ * result came from the cache.
+ **/
+gboolean
+log_template_append_format_cached(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
+{
+  const gchar *cached;
+  gsize orig_len = result->len;
+  gboolean hit = FALSE;
+
+  if (!self->result_cache)
+    {
+      log_template_append_format(self, lm, opts, tz, seq_num, context_id, result);
+      return FALSE;
+    }
+
+  g_static_mutex_lock(&self->result_cache_lock);
+  if (!self->result_cache_key)
+    self->result_cache_key = g_string_sized_new(64);
+  if (!log_template_build_cache_key(self, lm, self->result_cache_key))
+    {
+      g_static_mutex_unlock(&self->result_cache_lock);
+      log_template_append_format(self, lm, opts, tz, seq_num, context_id, result);
+      return FALSE;
+    }
+
+  cached = g_hash_table_lookup(self->result_cache, self->result_cache_key->str);
+  if (cached)
+    {
+      g_string_append(result, cached);
+      hit = TRUE;
+    }
+  else
+    {
+      log_template_append_format(self, lm, opts, tz, seq_num, context_id, result);
+      if (g_hash_table_size(self->result_cache) < LOG_TEMPLATE_RESULT_CACHE_LIMIT)
+        g_hash_table_insert(self->result_cache,
+                            g_strdup(self->result_cache_key->str),
+                            g_strdup(result->str + orig_len));
+    }
+  g_static_mutex_unlock(&self->result_cache_lock);
+  return hit;
+}
+
+gboolean
+log_template_format_cached(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
+{
+  gboolean hit;
+
+  log_template_presize_result(self, result);
+  hit = log_template_append_format_cached(self, lm, opts, tz, seq_num, context_id, result);
+  log_template_learn_result_size(self, result);
+  return hit;
 }
 
 
@@ -225,6 +572,7 @@ log_template_new(GlobalConfig *cfg, const gchar *name)
   self->ref_cnt = 1;
   self->cfg = cfg;
   g_static_mutex_init(&self->arg_lock);
+  g_static_mutex_init(&self->result_cache_lock);
   if (cfg_is_config_version_older(cfg, 0x0300))
     {
       msg_warning_once("WARNING: template: the default value for template-escape has changed to 'no' from " VERSION_3_0 ", please update your configuration file accordingly",
@@ -246,9 +594,14 @@ log_template_free(LogTemplate *self)
       g_ptr_array_free(self->arg_bufs, TRUE);
     }
   log_template_reset_compiled(self);
+  if (self->result_cache)
+    g_hash_table_destroy(self->result_cache);
+  if (self->result_cache_key)
+    g_string_free(self->result_cache_key, TRUE);
   g_free(self->name);
   g_free(self->template);
   g_static_mutex_free(&self->arg_lock);
+  g_static_mutex_free(&self->result_cache_lock);
   g_free(self);
 }
 
@@ -333,6 +686,7 @@ void
 log_template_global_init(void)
 {
   log_macros_global_init();
+  tf_simple_func_global_init();
 }
 
 void
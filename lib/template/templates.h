@@ -61,12 +61,31 @@ typedef struct _LogTemplate
   gchar *name;
   gchar *template;
   GList *compiled_template;
+  /* the compiled_template list flattened into a contiguous array, this
+   * is what expansion executes; the elements share their internal
+   * pointers (text, default_value, func state) with the list above */
+  struct _LogTemplateElem *exec_elems;
+  gint num_exec_elems;
+  /* total length of the constant parts of the template, used to presize
+   * the result buffer before expansion */
+  gsize literal_len;
+  /* exponentially decayed maximum of formatted result lengths, so
+   * repeat expansions of the same template grow the result buffer at
+   * most once instead of reallocating in the middle of formatting, while
+   * a single outlier result does not inflate every later buffer; updated
+   * racily, a lost update only costs an extra realloc */
+  gsize result_size_hint;
   gboolean escape;
   gboolean def_inline;
   GlobalConfig *cfg;
   GStaticMutex arg_lock;
   GPtrArray *arg_bufs;
   TypeHint type_hint;
+  /* optional cache of formatted results keyed by the referenced message
+   * values, see log_template_enable_result_cache() */
+  GStaticMutex result_cache_lock;
+  GHashTable *result_cache;
+  GString *result_cache_key;
 } LogTemplate;
 
 /* template expansion options that can be influenced by the user and
@@ -98,6 +117,11 @@ void log_template_format(LogTemplate *self, LogMessage *lm, const LogTemplateOpt
 void log_template_append_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
+NVHandle log_template_get_trivial_value_handle(LogTemplate *self);
+const gchar *log_template_get_literal_value(LogTemplate *self);
+gboolean log_template_enable_result_cache(LogTemplate *self);
+gboolean log_template_append_format_cached(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
+gboolean log_template_format_cached(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_set_name(LogTemplate *self, const gchar *name);
 
 LogTemplate *log_template_new(GlobalConfig *cfg, const gchar *name);
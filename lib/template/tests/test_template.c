@@ -4,6 +4,7 @@
 #include "logmsg.h"
 #include "template/templates.h"
 #include "template/user-function.h"
+#include "template/simple-function.h"
 #include "misc.h"
 #include "apphook.h"
 #include "cfg.h"
@@ -262,6 +263,82 @@ test_escaping(void)
                                        TRUE, "\\\"value\\\"");
 }
 
+static gint memoized_invocations;
+
+static void
+tf_counted(LogMessage *msg, gint argc, GString *argv[], GString *result)
+{
+  gint i;
+
+  memoized_invocations++;
+  for (i = 0; i < argc; i++)
+    g_string_append_len(result, argv[i]->str, argv[i]->len);
+}
+
+TEMPLATE_FUNCTION_SIMPLE_MEMOIZED(tf_counted);
+
+static Plugin memoized_plugins[] =
+{
+  TEMPLATE_FUNCTION_PLUGIN(tf_counted, "counted"),
+};
+
+static void
+test_memoized_template_function(void)
+{
+  LogTemplate *templ;
+  LogMessage *msg;
+  GString *result = g_string_new("");
+
+  plugin_register(configuration, memoized_plugins, G_N_ELEMENTS(memoized_plugins));
+
+  msg = create_sample_message();
+  templ = compile_template("$(counted $HOST)", FALSE);
+
+  memoized_invocations = 0;
+  log_template_format(templ, msg, NULL, LTZ_LOCAL, 999, NULL, result);
+  assert_string(result->str, "bzorp", "memoized template function yielded invalid result");
+  g_string_truncate(result, 0);
+  log_template_format(templ, msg, NULL, LTZ_LOCAL, 999, NULL, result);
+  assert_string(result->str, "bzorp", "memoized template function yielded invalid result from the cache");
+  assert_gint(memoized_invocations, 1, "memoized template function was re-evaluated for cached arguments");
+
+  g_string_free(result, TRUE);
+  log_template_unref(templ);
+  log_msg_unref(msg);
+}
+
+static void
+test_constant_folding(void)
+{
+  LogTemplate *templ;
+  LogMessage *msg;
+  GString *result = g_string_new("");
+
+  msg = create_sample_message();
+
+  /* all-literal arguments of a pure function are evaluated at compile
+   * time, formatting must not invoke the function again */
+  memoized_invocations = 0;
+  templ = compile_template("$(counted foo bar)", FALSE);
+  assert_gint(memoized_invocations, 1, "constant template function was not folded at compile time");
+  log_template_format(templ, msg, NULL, LTZ_LOCAL, 999, NULL, result);
+  log_template_format(templ, msg, NULL, LTZ_LOCAL, 999, NULL, result);
+  assert_gint(memoized_invocations, 1, "constant template function was re-evaluated at format time");
+  log_template_unref(templ);
+
+  assert_template_format("xx$(counted foo)yy", "xxfooyy");
+  assert_template_format("$(counted $(counted inner))", "inner");
+
+  /* a message reference keeps the invocation dynamic */
+  memoized_invocations = 0;
+  templ = compile_template("$(counted $HOST)", FALSE);
+  assert_gint(memoized_invocations, 0, "template function with a value reference was folded at compile time");
+  log_template_unref(templ);
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+}
+
 static void
 test_user_template_function(void)
 {
@@ -296,6 +373,8 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   test_compat();
   test_multi_thread();
   test_escaping();
+  test_memoized_template_function();
+  test_constant_folding();
   test_user_template_function();
   /* multi-threaded expansion */
 
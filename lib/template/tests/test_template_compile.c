@@ -288,6 +288,16 @@ test_double_at_is_a_literal_at(void)
   assert_compiled_template(text = "@12", default_value = NULL, macro = M_NONE, type = LTE_MACRO, msg_ref = 0);
 }
 
+static void
+test_literal_length_is_precomputed(void)
+{
+  assert_template_compile("foo${MESSAGE} bar baz");
+  assert_gint(template->literal_len, strlen("foo") + strlen(" bar baz"), ASSERTION_ERROR("Bad precomputed literal length"));
+
+  assert_template_compile("${MESSAGE}");
+  assert_gint(template->literal_len, 0, ASSERTION_ERROR("Bad precomputed literal length"));
+}
+
 static void
 test_template_compile_macro(void)
 {
@@ -305,6 +315,7 @@ test_template_compile_macro(void)
   TEMPLATE_TESTCASE(test_dollar_with_an_invalid_macro_name_without_braces_is_parsed_as_a_literal_dollar);
   TEMPLATE_TESTCASE(test_backslash_without_finishing_the_escape_sequence_is_ignored);
   TEMPLATE_TESTCASE(test_double_at_is_a_literal_at);
+  TEMPLATE_TESTCASE(test_literal_length_is_precomputed);
 }
 
 static void
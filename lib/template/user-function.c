@@ -23,6 +23,7 @@
  */
 
 #include "template/function.h"
+#include "template/templates.h"
 #include "plugin-types.h"
 
 typedef struct _UserTemplateFunction
@@ -55,6 +56,16 @@ user_template_function_call(LogTemplateFunction *s, gpointer state, const LogTem
   log_template_append_format_with_context(self->template, args->messages, args->num_messages, args->opts, args->tz, args->seq_num, args->context_id, result);
 }
 
+static gboolean
+user_template_function_is_constant(LogTemplateFunction *s, gpointer state)
+{
+  UserTemplateFunction *self = (UserTemplateFunction *) s;
+
+  /* calls to a user defined function whose body expands to a constant
+   * string are folded at compile time */
+  return log_template_get_literal_value(self->template) != NULL;
+}
+
 static void
 user_template_function_free(LogTemplateFunction *s)
 {
@@ -75,6 +86,7 @@ user_template_function_new(const gchar *name, LogTemplate *template)
   self->super.prepare = user_template_function_prepare;
   self->super.call = user_template_function_call;
   self->super.free_fn = user_template_function_free;
+  self->super.is_constant = user_template_function_is_constant;
   self->template = log_template_ref(template);
   self->name = g_strdup(name);
   return &self->super;
@@ -0,0 +1,81 @@
+#include "cfg-include-cache.h"
+#include "libtest/testutils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_FILE "test_include_cache.conf"
+
+static void
+write_test_file(const gchar *content)
+{
+  FILE *f = fopen(TEST_FILE, "w");
+
+  fwrite(content, strlen(content), 1, f);
+  fclose(f);
+}
+
+static void
+test_lookup_returns_file_contents(void)
+{
+  const gchar *content;
+  gsize length = 0;
+
+  write_test_file("options { };\n");
+  content = cfg_include_cache_lookup(TEST_FILE, &length);
+  assert_not_null((gpointer) content, "include file was not cached");
+  assert_nstring(content, length, "options { };\n", -1, "cached contents differ from the file");
+}
+
+static void
+test_unchanged_file_is_served_from_cache(void)
+{
+  const gchar *content1, *content2;
+  gsize length = 0;
+
+  write_test_file("source s_test { internal(); };\n");
+  content1 = cfg_include_cache_lookup(TEST_FILE, &length);
+  content2 = cfg_include_cache_lookup(TEST_FILE, &length);
+  assert_gpointer((gpointer) content2, (gpointer) content1, "unchanged file was reread instead of being served from the cache");
+}
+
+static void
+test_changed_file_is_reread(void)
+{
+  const gchar *content;
+  gsize length = 0;
+
+  write_test_file("source s_test { internal(); };\n");
+  cfg_include_cache_lookup(TEST_FILE, &length);
+
+  /* the size change makes the cached entry stale even if the mtime
+   * granularity is too coarse to notice the rewrite */
+  write_test_file("source s_test { internal(); };\nlog { source(s_test); };\n");
+  content = cfg_include_cache_lookup(TEST_FILE, &length);
+  assert_not_null((gpointer) content, "changed include file was not reread");
+  assert_nstring(content, length, "source s_test { internal(); };\nlog { source(s_test); };\n", -1, "cache returned stale contents for a changed file");
+}
+
+static void
+test_missing_file_returns_null(void)
+{
+  const gchar *content;
+  gsize length = 0;
+
+  content = cfg_include_cache_lookup("nonexistent_include.conf", &length);
+  assert_null((gpointer) content, "lookup of a missing file did not fail");
+}
+
+int
+main()
+{
+  test_lookup_returns_file_contents();
+  test_unchanged_file_is_served_from_cache();
+  test_changed_file_is_reread();
+  test_missing_file_returns_null();
+
+  unlink(TEST_FILE);
+  cfg_include_cache_clear();
+  return 0;
+}
@@ -33,6 +33,12 @@ assert_escaped_text(const gchar *str, const gchar *expected_escaped_str)
   assert_escaped_text_with_unsafe_chars(str, expected_escaped_str, NULL);
 }
 
+void
+assert_validate_utf8(const gchar *str, gssize len, gboolean expected)
+{
+  assert_gboolean(validate_utf8(str, len), expected, "validate_utf8() verdict is not expected");
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -64,5 +70,18 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"text\\\"", "\"");
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"te\\xt\\\"", "\"x");
 
+  assert_validate_utf8("", 0, TRUE);
+  assert_validate_utf8("almafa", -1, TRUE);
+  assert_validate_utf8("this text is longer than a single 8 byte word", -1, TRUE);
+  assert_validate_utf8("árvíztűrőtükörfúrógép", -1, TRUE);
+  assert_validate_utf8("\xad", -1, FALSE);
+  assert_validate_utf8("Á\xadÉ", -1, FALSE);
+  /* embedded NULs are invalid wherever they sit: in the ASCII fast
+   * path (both before and after word alignment) and behind the first
+   * high-bit byte */
+  assert_validate_utf8("abc\0def", 7, FALSE);
+  assert_validate_utf8("this text is longer than a single 8 byte word\0tail", 50, FALSE);
+  assert_validate_utf8("árvíztűrő\0tükörfúrógép", 31, FALSE);
+
   return 0;
 }
@@ -99,6 +99,8 @@ TLS_BLOCK_START
   TimeCache gm_time_cache[64];
   struct tm mktime_prev_tm;
   time_t mktime_prev_time;
+  time_t cached_zone_ofs_when;
+  long cached_zone_ofs;
 }
 TLS_BLOCK_END;
 
@@ -108,6 +110,8 @@ TLS_BLOCK_END;
 #define gm_time_cache        __tls_deref(gm_time_cache)
 #define mktime_prev_tm       __tls_deref(mktime_prev_tm)
 #define mktime_prev_time     __tls_deref(mktime_prev_time)
+#define cached_zone_ofs_when __tls_deref(cached_zone_ofs_when)
+#define cached_zone_ofs      __tls_deref(cached_zone_ofs)
 
 #if !defined(SYSLOG_NG_HAVE_LOCALTIME_R) || !defined(SYSLOG_NG_HAVE_GMTIME_R)
 static GStaticMutex localtime_lock = G_STATIC_MUTEX_INIT;
@@ -272,6 +276,19 @@ get_local_timezone_ofs(time_t when)
 #endif /* SYSLOG_NG_HAVE_STRUCT_TM_TM_GMTOFF */
 }
 
+/* the zone offset only changes at DST transitions, caching it for the
+ * current second removes a cached_localtime() round trip (including its
+ * struct tm copy) from every message reception, see log_msg_init() */
+long
+cached_get_local_timezone_ofs(time_t when)
+{
+  if (G_UNLIKELY(when != cached_zone_ofs_when || when == 0))
+    {
+      cached_zone_ofs = get_local_timezone_ofs(when);
+      cached_zone_ofs_when = when;
+    }
+  return cached_zone_ofs;
+}
 
 void
 clean_time_cache(void)
@@ -33,6 +33,7 @@ void cached_localtime(time_t *when, struct tm *tm);
 void cached_gmtime(time_t *when, struct tm *tm);
 
 long get_local_timezone_ofs(time_t when);
+long cached_get_local_timezone_ofs(time_t when);
 void clean_time_cache(void);
 
 
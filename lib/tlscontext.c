@@ -258,6 +258,47 @@ tls_session_free(TLSSession *self)
   g_free(self);
 }
 
+/* size of the server side session cache; sized so that a large client
+ * population reconnecting after a restart can still resume with an
+ * abbreviated handshake instead of a full asymmetric crypto exchange */
+#define TLS_SESSION_CACHE_SIZE 20480
+
+static int
+tls_context_store_cached_client_session(SSL *ssl, SSL_SESSION *ssl_session)
+{
+  TLSSession *session = SSL_get_app_data(ssl);
+  TLSContext *self = session->ctx;
+
+  /* only a single connection exists per client mode TLSContext, no
+   * locking is needed here */
+  if (self->cached_client_session)
+    SSL_SESSION_free(self->cached_client_session);
+  self->cached_client_session = ssl_session;
+
+  /* non-zero means we have taken over the reference passed in */
+  return 1;
+}
+
+static void
+tls_context_setup_session_cache(TLSContext *self)
+{
+  if (self->mode == TM_SERVER)
+    {
+      /* cache established sessions so reconnecting clients can resume
+       * with an abbreviated handshake */
+      SSL_CTX_set_session_id_context(self->ssl_ctx, (const unsigned char *) "syslog-ng", 9);
+      SSL_CTX_sess_set_cache_size(self->ssl_ctx, TLS_SESSION_CACHE_SIZE);
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_SERVER);
+    }
+  else
+    {
+      /* stash the negotiated session ourselves instead of using the
+       * internal store, so we can offer it on the next connection */
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(self->ssl_ctx, tls_context_store_cached_client_session);
+    }
+}
+
 static gboolean
 file_exists(const gchar *fname)
 {
@@ -360,12 +401,18 @@ tls_context_setup_session(TLSContext *self)
           if (!SSL_CTX_set_cipher_list(self->ssl_ctx, self->cipher_suite))
             goto error;
         }
+
+      tls_context_setup_session_cache(self);
     }
 
   ssl = SSL_new(self->ssl_ctx);
 
   if (self->mode == TM_CLIENT)
-    SSL_set_connect_state(ssl);
+    {
+      if (self->cached_client_session)
+        SSL_set_session(ssl, self->cached_client_session);
+      SSL_set_connect_state(ssl);
+    }
   else
     SSL_set_accept_state(ssl);
 
@@ -401,6 +448,8 @@ tls_context_new(TLSMode mode)
 void
 tls_context_free(TLSContext *self)
 {
+  if (self->cached_client_session)
+    SSL_SESSION_free(self->cached_client_session);
   SSL_CTX_free(self->ssl_ctx);
   g_list_foreach(self->trusted_fingerpint_list, (GFunc) g_free, NULL);
   g_list_foreach(self->trusted_dn_list, (GFunc) g_free, NULL);
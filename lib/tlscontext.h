@@ -82,6 +82,10 @@ struct _TLSContext
   GList *trusted_fingerpint_list;
   GList *trusted_dn_list;
   gint ssl_options;
+
+  /* last session established in client mode, reused on reconnect so that
+   * the peer can offer us an abbreviated handshake */
+  SSL_SESSION *cached_client_session;
 };
 
 
@@ -28,14 +28,39 @@
 #include "syslog-ng.h"
 #include "transport/transport-aux-data.h"
 
+#include <sys/uio.h>
+
 typedef struct _LogTransport LogTransport;
 
+/* a single datagram sized record for batched reception: buf/buflen are
+ * filled in by the caller, msg_len and aux by the transport */
+typedef struct _LogTransportRecord
+{
+  gpointer buf;
+  gsize buflen;
+  gssize msg_len;
+  /* the datagram did not fit into buf and its tail was discarded by the
+   * kernel; msg_len still holds the number of bytes placed into buf */
+  gboolean truncated;
+  LogTransportAuxData *aux;
+} LogTransportRecord;
+
 struct _LogTransport
 {
   gint fd;
   GIOCondition cond;
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
+  /* optional gather-write entry point, only set on transports where
+   * multiple buffers may be coalesced into a single stream write */
+  gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* optional record-batch entry point for datagram-like transports: each
+   * iovec element is submitted as a separate record, the return value is
+   * the number of records written out */
+  gint (*write_records)(LogTransport *self, struct iovec *records, gint records_count);
+  /* optional batched reception counterpart, fills in up to records_count
+   * records with one syscall and returns the number of records read */
+  gint (*read_records)(LogTransport *self, LogTransportRecord *records, gint records_count);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -51,6 +76,29 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gssize
+log_transport_writev(LogTransport *self, struct iovec *iov, gint iov_count)
+{
+  if (self->writev)
+    return self->writev(self, iov, iov_count);
+
+  /* without gather support only the first chunk is submitted, the
+   * caller handles short writes anyway */
+  return self->write(self, iov[0].iov_base, iov[0].iov_len);
+}
+
+static inline gint
+log_transport_write_records(LogTransport *self, struct iovec *records, gint records_count)
+{
+  return self->write_records(self, records, records_count);
+}
+
+static inline gint
+log_transport_read_records(LogTransport *self, LogTransportRecord *records, gint records_count)
+{
+  return self->read_records(self, records, records_count);
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
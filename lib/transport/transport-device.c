@@ -31,6 +31,9 @@ struct _LogTransportDevice
 {
   LogTransport super;
   gint timeout;
+  /* largest buffer size the device has rejected with EINVAL, used to
+   * detect when the caller cannot grow its buffers any further */
+  gsize einval_buflen;
 };
 
 static gssize
@@ -61,6 +64,65 @@ log_transport_device_read_method(LogTransport *s, gpointer buf, gsize buflen, Lo
   return rc;
 }
 
+/* record oriented devices (/dev/kmsg most prominently) hand out a single
+ * record per read(), so draining everything that accumulated while we were
+ * away costs one poll wakeup per record without batching; this method
+ * keeps reading until the device runs dry or all slots are filled */
+static gint
+log_transport_device_read_records_method(LogTransport *s, LogTransportRecord *records, gint records_count)
+{
+  LogTransportDevice *self = (LogTransportDevice *) s;
+  gint count = 0;
+  gssize rc;
+
+  while (count < records_count)
+    {
+      LogTransportRecord *record = &records[count];
+
+      rc = log_transport_device_read_method(s, record->buf, record->buflen, record->aux);
+      if (rc < 0)
+        {
+          if (errno == EPIPE)
+            {
+              /* the device overwrote this record before we got to it
+               * (/dev/kmsg ring buffer wraparound), the next read
+               * continues at the oldest surviving record */
+              continue;
+            }
+          if (errno == EINVAL)
+            {
+              /* the record does not fit into our buffer and the device
+               * refuses to hand out a truncated copy; flagging the slot
+               * truncated makes the caller grow its buffers, the record
+               * itself is not consumed and is retried with the larger
+               * buffer.  If the buffers did not grow since the last
+               * EINVAL, the caller has hit its size limit and the error
+               * must be propagated instead of retrying forever. */
+              if (record->buflen <= self->einval_buflen)
+                {
+                  if (count == 0)
+                    return -1;
+                  break;
+                }
+              self->einval_buflen = record->buflen;
+              record->msg_len = 0;
+              record->truncated = TRUE;
+              count++;
+              continue;
+            }
+          if (count == 0)
+            return -1;
+          break;
+        }
+      if (rc == 0)
+        break;
+      record->msg_len = rc;
+      record->truncated = FALSE;
+      count++;
+    }
+  return count;
+}
+
 LogTransport *
 log_transport_device_new(gint fd, gint timeout)
 {
@@ -69,6 +131,7 @@ log_transport_device_new(gint fd, gint timeout)
   log_transport_init_instance(&self->super, fd);
   self->timeout = timeout;
   self->super.read = log_transport_device_read_method;
+  self->super.read_records = log_transport_device_read_records_method;
   self->super.write = NULL;
   self->super.free_fn = log_transport_free_method;
   return &self->super;
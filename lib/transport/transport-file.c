@@ -49,7 +49,7 @@ log_transport_file_write_method(LogTransport *s, const gpointer buf, gsize bufle
 {
   LogTransportFile *self = (LogTransportFile *) s;
   gint rc;
-  
+
   do
     {
       rc = write(self->super.fd, buf, buflen);
@@ -58,12 +58,27 @@ log_transport_file_write_method(LogTransport *s, const gpointer buf, gsize bufle
   return rc;
 }
 
+static gssize
+log_transport_file_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+  gssize rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 void
 log_transport_file_init_instance(LogTransportFile *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_file_read_method;
   self->super.write = log_transport_file_write_method;
+  self->super.writev = log_transport_file_writev_method;
   self->super.free_fn = log_transport_free_method;
 }
 
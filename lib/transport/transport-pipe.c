@@ -73,5 +73,8 @@ log_transport_pipe_new(gint fd)
 
   log_transport_file_init_instance(self, fd);
   self->super.write = log_transport_pipe_write_method;
+  /* keep pipes on the single buffer path, gather writes would bypass the
+   * PIPE_BUF workaround above */
+  self->super.writev = NULL;
   return &self->super;
 }
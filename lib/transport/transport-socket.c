@@ -23,6 +23,8 @@
 
 #include "transport-socket.h"
 
+#include <string.h>
+
 
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
@@ -76,12 +78,92 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+static gint
+log_transport_dgram_socket_read_records_method(LogTransport *s, LogTransportRecord *records, gint records_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  struct mmsghdr *msgvec;
+  struct iovec *iov;
+  struct sockaddr_storage *ss;
+  gint rc, i;
+
+  msgvec = g_alloca(records_count * sizeof(struct mmsghdr));
+  iov = g_alloca(records_count * sizeof(struct iovec));
+  ss = g_alloca(records_count * sizeof(struct sockaddr_storage));
+  memset(msgvec, 0, records_count * sizeof(struct mmsghdr));
+  for (i = 0; i < records_count; i++)
+    {
+      iov[i].iov_base = records[i].buf;
+      iov[i].iov_len = records[i].buflen;
+      msgvec[i].msg_hdr.msg_iov = &iov[i];
+      msgvec[i].msg_hdr.msg_iovlen = 1;
+      msgvec[i].msg_hdr.msg_name = &ss[i];
+      msgvec[i].msg_hdr.msg_namelen = sizeof(ss[i]);
+    }
+
+  do
+    {
+      rc = recvmmsg(self->super.fd, msgvec, records_count, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+  if (rc <= 0)
+    return rc;
+
+  for (i = 0; i < rc; i++)
+    {
+      records[i].msg_len = msgvec[i].msg_len;
+      records[i].truncated = !!(msgvec[i].msg_hdr.msg_flags & MSG_TRUNC);
+      if (msgvec[i].msg_hdr.msg_namelen && records[i].aux)
+        log_transport_aux_data_set_peer_addr_ref(records[i].aux,
+                                                 g_sockaddr_new((struct sockaddr *) &ss[i], msgvec[i].msg_hdr.msg_namelen));
+    }
+  return rc;
+}
+#endif
+
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+static gint
+log_transport_dgram_socket_write_records_method(LogTransport *s, struct iovec *records, gint records_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  struct mmsghdr *msgvec;
+  gint rc, i;
+
+  msgvec = g_alloca(records_count * sizeof(struct mmsghdr));
+  memset(msgvec, 0, records_count * sizeof(struct mmsghdr));
+  for (i = 0; i < records_count; i++)
+    {
+      msgvec[i].msg_hdr.msg_iov = &records[i];
+      msgvec[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  do
+    {
+      rc = sendmmsg(self->super.fd, msgvec, records_count, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  /* see the ENOBUFS note in the write method above, the datagram is
+   * dropped instead of spinning on an unpollable condition */
+  if (rc < 0 && errno == ENOBUFS)
+    return records_count;
+  return rc;
+}
+#endif
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  self->super.read_records = log_transport_dgram_socket_read_records_method;
+#endif
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+  self->super.write_records = log_transport_dgram_socket_write_records_method;
+#endif
 }
 
 LogTransport *
@@ -121,6 +203,20 @@ log_transport_stream_socket_write_method(LogTransport *s, const gpointer buf, gs
   return rc;
 }
 
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gssize rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 static void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
@@ -134,6 +230,7 @@ log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_stream_socket_read_method;
   self->super.write = log_transport_stream_socket_write_method;
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
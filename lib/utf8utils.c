@@ -23,6 +23,120 @@
 #include "utf8utils.h"
 #include <string.h>
 
+/* bytes that cannot be copied to the output verbatim: NUL, control
+ * characters, backslash and everything non-ASCII, which has to go through
+ * utf8 validation.  Everything else forms "clean runs" that are appended
+ * with a single memcpy instead of char-by-char. */
+static const guint8 unsafe_utf8_stop_chars[256] =
+{
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x00 - 0x0f */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x10 - 0x1f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x20 - 0x2f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x30 - 0x3f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x40 - 0x4f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,  /* 0x50 - 0x5f, 0x5c is the backslash */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x60 - 0x6f */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x70 - 0x7f */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x80 - 0x8f */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0x90 - 0x9f */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xa0 - 0xaf */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xb0 - 0xbf */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xc0 - 0xcf */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xd0 - 0xdf */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xe0 - 0xef */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  /* 0xf0 - 0xff */
+};
+
+static inline void
+_build_stop_table(guint8 *stop_chars, const gchar *unsafe_chars)
+{
+  memcpy(stop_chars, unsafe_utf8_stop_chars, sizeof(unsafe_utf8_stop_chars));
+  for (; unsafe_chars && *unsafe_chars; unsafe_chars++)
+    stop_chars[*(const guchar *) unsafe_chars] = 1;
+}
+
+/* make sure the output GString can hold the escaped form of str without
+ * further reallocations: one prescan counts the bytes that need escaping
+ * and we reserve room for their worst-case expansion up front.  GString
+ * has no reserve API, so we grow it with g_string_set_size() and truncate
+ * back, which keeps the allocation. */
+static inline void
+_reserve_space(GString *escaped_string, const gchar *str, const guint8 *stop_chars, gsize escape_overhead)
+{
+  const guchar *p;
+  gsize len = 0, stops = 0;
+
+  for (p = (const guchar *) str; *p; p++)
+    {
+      len++;
+      if (stop_chars[*p])
+        stops++;
+    }
+  if (escaped_string->allocated_len <= escaped_string->len + len + stops * escape_overhead)
+    {
+      gsize orig_len = escaped_string->len;
+
+      g_string_set_size(escaped_string, orig_len + len + stops * escape_overhead);
+      g_string_truncate(escaped_string, orig_len);
+    }
+}
+
+static const gchar hex_digits[] = "0123456789abcdef";
+
+/* \xXX */
+static inline void
+_append_hex_byte_escape(GString *escaped_string, guint8 byte)
+{
+  gchar buf[4];
+
+  buf[0] = '\\';
+  buf[1] = 'x';
+  buf[2] = hex_digits[byte >> 4];
+  buf[3] = hex_digits[byte & 0x0f];
+  g_string_append_len(escaped_string, buf, 4);
+}
+
+/* \\xXX, e.g. a literal \xXX sequence for utf8-only receivers */
+static inline void
+_append_double_escaped_hex_byte(GString *escaped_string, guint8 byte)
+{
+  gchar buf[5];
+
+  buf[0] = '\\';
+  buf[1] = '\\';
+  buf[2] = 'x';
+  buf[3] = hex_digits[byte >> 4];
+  buf[4] = hex_digits[byte & 0x0f];
+  g_string_append_len(escaped_string, buf, 5);
+}
+
+/* \u00XX, only used for control characters, e.g. uchar < 0x100 */
+static inline void
+_append_unichar_escape(GString *escaped_string, gunichar uchar)
+{
+  gchar buf[6];
+
+  buf[0] = '\\';
+  buf[1] = 'u';
+  buf[2] = '0';
+  buf[3] = '0';
+  buf[4] = hex_digits[(uchar >> 4) & 0x0f];
+  buf[5] = hex_digits[uchar & 0x0f];
+  g_string_append_len(escaped_string, buf, 6);
+}
+
+static inline const gchar *
+_append_clean_run(GString *escaped_string, const gchar *char_ptr, const guint8 *stop_chars)
+{
+  const gchar *run_start = char_ptr;
+
+  while (!stop_chars[*(const guchar *) char_ptr])
+    char_ptr++;
+  if (char_ptr != run_start)
+    g_string_append_len(escaped_string, run_start, char_ptr - run_start);
+  return char_ptr;
+}
+
 /**
  * This function escapes an unsanitized input (e.g. that can contain binary
  * characters, and produces an escaped format that can be deescaped in need,
@@ -47,16 +161,27 @@ void
 append_unsafe_utf8_as_escaped_binary(GString *escaped_string, const gchar *str, const gchar *unsafe_chars)
 {
   const gchar *char_ptr = str;
+  guint8 stop_chars[256];
+
+  _build_stop_table(stop_chars, unsafe_chars);
+  /* worst case expansion is \xXX, e.g. 3 extra bytes per escaped byte */
+  _reserve_space(escaped_string, str, stop_chars, 3);
 
   while (*char_ptr)
     {
-      gunichar uchar = g_utf8_get_char_validated(char_ptr, -1);
+      gunichar uchar;
+
+      char_ptr = _append_clean_run(escaped_string, char_ptr, stop_chars);
+      if (!*char_ptr)
+        break;
+
+      uchar = g_utf8_get_char_validated(char_ptr, -1);
 
       switch (uchar)
         {
           case (gunichar) -1:
           case (gunichar) -2:
-            g_string_append_printf(escaped_string, "\\x%02x", *(guint8 *) char_ptr);
+            _append_hex_byte_escape(escaped_string, *(guint8 *) char_ptr);
             char_ptr++;
             continue;
             break;
@@ -80,9 +205,12 @@ append_unsafe_utf8_as_escaped_binary(GString *escaped_string, const gchar *str,
             break;
           default:
             if (uchar < 32)
-              g_string_append_printf(escaped_string, "\\x%02x", uchar);
+              _append_hex_byte_escape(escaped_string, uchar);
             else if (uchar < 256 && unsafe_chars && strchr(unsafe_chars, (gchar) uchar))
-              g_string_append_printf(escaped_string, "\\%c", (gchar) uchar);
+              {
+                g_string_append_c(escaped_string, '\\');
+                g_string_append_c(escaped_string, (gchar) uchar);
+              }
             else
               g_string_append_unichar(escaped_string, uchar);
             break;
@@ -125,15 +253,26 @@ void
 append_unsafe_utf8_as_escaped_text(GString *escaped_string, const gchar *str, const gchar *unsafe_chars)
 {
   const gchar *char_ptr = str;
+  guint8 stop_chars[256];
+
+  _build_stop_table(stop_chars, unsafe_chars);
+  /* worst case expansion is \u00XX, e.g. 5 extra bytes per escaped byte */
+  _reserve_space(escaped_string, str, stop_chars, 5);
 
   while (*char_ptr)
     {
-      gunichar uchar = g_utf8_get_char_validated(char_ptr, -1);
+      gunichar uchar;
+
+      char_ptr = _append_clean_run(escaped_string, char_ptr, stop_chars);
+      if (!*char_ptr)
+        break;
+
+      uchar = g_utf8_get_char_validated(char_ptr, -1);
 
       switch (uchar)
         {
           case (gunichar) -1:
-            g_string_append_printf(escaped_string, "\\\\x%02x", *(guint8 *) char_ptr);
+            _append_double_escaped_hex_byte(escaped_string, *(guint8 *) char_ptr);
             char_ptr++;
             continue;
             break;
@@ -157,9 +296,12 @@ append_unsafe_utf8_as_escaped_text(GString *escaped_string, const gchar *str, co
             break;
           default:
             if (uchar < 32)
-              g_string_append_printf(escaped_string, "\\u%04x", uchar);
+              _append_unichar_escape(escaped_string, uchar);
             else if (uchar < 256 && unsafe_chars && strchr(unsafe_chars, (gchar) uchar))
-              g_string_append_printf(escaped_string, "\\%c", (gchar) uchar);
+              {
+                g_string_append_c(escaped_string, '\\');
+                g_string_append_c(escaped_string, (gchar) uchar);
+              }
             else
               g_string_append_unichar(escaped_string, uchar);
             break;
@@ -177,3 +319,51 @@ convert_unsafe_utf8_to_escaped_text(const gchar *str, const gchar *unsafe_chars)
   append_unsafe_utf8_as_escaped_text(escaped_string, str, unsafe_chars);
   return g_string_free(escaped_string, FALSE);
 }
+
+/**
+ * Validate that the buffer is valid utf8.  The bulk of syslog traffic is
+ * plain ASCII, which g_utf8_validate() grinds through char by char, so we
+ * first skip ASCII-only content a word at a time and only hand the
+ * remainder starting at the first non-ASCII byte to the full validator.
+ **/
+gboolean
+validate_utf8(const gchar *data, gssize length)
+{
+  const gchar *p = data;
+  const gchar *end;
+
+  if (length < 0)
+    length = strlen(data);
+  end = data + length;
+
+  /* byte-wise until the pointer is word aligned; NUL is a stop byte just
+   * like the high-bit ones, g_utf8_validate() rejects embedded NULs and
+   * the fast path must not skip past them */
+  while (p < end && (GPOINTER_TO_SIZE(p) & (sizeof(guint64) - 1)) &&
+         *(const guchar *) p && !(*(const guchar *) p & 0x80))
+    p++;
+
+  if ((GPOINTER_TO_SIZE(p) & (sizeof(guint64) - 1)) == 0)
+    {
+      while (p + sizeof(guint64) <= end)
+        {
+          guint64 w = *(const guint64 *) p;
+
+          /* stop on a high-bit byte or a zero byte (the usual
+           * word-has-a-zero-byte bit trick) */
+          if ((w & G_GUINT64_CONSTANT(0x8080808080808080)) ||
+              ((w - G_GUINT64_CONSTANT(0x0101010101010101)) & ~w & G_GUINT64_CONSTANT(0x8080808080808080)))
+            break;
+          p += sizeof(guint64);
+        }
+    }
+
+  while (p < end && *(const guchar *) p && !(*(const guchar *) p & 0x80))
+    p++;
+
+  if (p == end)
+    return TRUE;
+  if (*(const guchar *) p == 0)
+    return FALSE;
+  return g_utf8_validate(p, end - p, NULL);
+}
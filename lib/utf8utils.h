@@ -31,4 +31,6 @@ gchar *convert_unsafe_utf8_to_escaped_binary(const gchar *str, const gchar *addi
 void append_unsafe_utf8_as_escaped_text(GString *escaped_string, const gchar *str, const gchar *unsafe_chars);
 gchar *convert_unsafe_utf8_to_escaped_text(const gchar *str, const gchar *additional_unsafe_chars);
 
+gboolean validate_utf8(const gchar *data, gssize length);
+
 #endif
@@ -31,6 +31,7 @@
 #include "cfg-parser.h"
 #include "misc.h"
 #include "scratch-buffers.h"
+#include "stats/stats-registry.h"
 #include "cfg.h"
 
 #include <stdlib.h>
@@ -40,7 +41,11 @@
 typedef struct
 {
   GPatternSpec *pattern;
+  gchar *pattern_text;
   gboolean include;
+  /* the pattern contains no wildcard characters, it can only match a
+     name equal to pattern_text */
+  gboolean literal;
 } VPPatternSpec;
 
 typedef struct
@@ -49,6 +54,14 @@ typedef struct
   LogTemplate *template;
 } VPPairConf;
 
+/* a key() pattern without wildcards, resolved to an NVHandle so the
+   value can be looked up directly instead of scanning the NVTable */
+typedef struct
+{
+  gchar *name;
+  NVHandle handle;
+} VPLiteralKey;
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -59,6 +72,25 @@ struct _ValuePairs
   /* guint32 as CfgFlagHandler only supports 32 bit integers */
   guint32 scopes;
   guint32 patterns_size;
+
+  /* compiled evaluation plan, lazily built on the first foreach and
+   * dropped whenever scopes/patterns change, see vp_update_plan().
+   * literal_keys is non-NULL if every pattern is literal, in which case
+   * the NVTable scan can be replaced by direct handle lookups (provided
+   * no scope requires a full scan).  match_cache memoizes the
+   * per-handle include/exclude verdict of the glob patterns, as it only
+   * depends on the handle, not on the message.  rename_cache memoizes
+   * the outcome of the --rekey transform chains per original key for
+   * the same reason. */
+  GStaticMutex plan_lock;
+  gboolean plan_compiled;
+  GPtrArray *literal_keys;
+  GHashTable *match_cache;
+  GHashTable *rename_cache;
+
+  /* longest value passed on to the formatter, longer ones are
+   * truncated (and counted); 0 means unlimited */
+  gsize max_value_length;
 };
 
 typedef enum
@@ -116,6 +148,69 @@ static ValuePairSpec selected_macros[] =
 
 static ValuePairSpec *all_macros;
 static gboolean value_pair_sets_initialized;
+static StatsCounterItem *count_truncated_value_pairs;
+
+/* a collected value waiting to be emitted: either a pointer borrowed
+ * from the LogMessage payload (sb == NULL), or an owned scratch buffer
+ * for values that had to be rendered, copied or truncated.  Borrowing
+ * is safe for the lifetime of the foreach as log_msg_get_value() never
+ * reallocates the payload and log_msg_values_foreach() materializes
+ * lazy sdata up front. */
+typedef struct
+{
+  TypeHint type_hint;
+  const gchar *value;
+  SBTHGString *sb;
+} VPValue;
+
+static VPValue *
+vp_value_new_owned(SBTHGString *sb)
+{
+  VPValue *v = g_slice_new(VPValue);
+
+  v->type_hint = sb->type_hint;
+  v->value = sb_th_gstring_string(sb)->str;
+  v->sb = sb;
+  return v;
+}
+
+/* wrap a value from the message payload; zero-copy when possible, the
+ * value is only copied if it needs truncation or is not
+ * NUL-terminated in place (values behind indirect entries are
+ * substrings of another value) */
+static VPValue *
+vp_value_new_for_nvpair(ValuePairs *vp, const gchar *value, gsize value_len)
+{
+  VPValue *v;
+  SBTHGString *sb;
+
+  if (vp->max_value_length && value_len > vp->max_value_length)
+    {
+      value_len = vp->max_value_length;
+      stats_counter_inc(count_truncated_value_pairs);
+    }
+  else if (value[value_len] == '\0')
+    {
+      v = g_slice_new(VPValue);
+      v->type_hint = TYPE_HINT_STRING;
+      v->value = value;
+      v->sb = NULL;
+      return v;
+    }
+
+  sb = sb_th_gstring_acquire();
+  g_string_append_len(sb_th_gstring_string(sb), value, value_len);
+  sb->type_hint = TYPE_HINT_STRING;
+  return vp_value_new_owned(sb);
+}
+
+static void
+vp_value_free(VPValue *v)
+{
+  if (v->sb)
+    sb_th_gstring_release(v->sb);
+  g_slice_free(VPValue, v);
+}
 
 static CfgFlagHandler value_pair_scope[] =
 {
@@ -144,6 +239,7 @@ static void
 vp_pattern_spec_free(VPPatternSpec *self)
 {
   g_pattern_spec_free(self->pattern);
+  g_free(self->pattern_text);
   g_free(self);
 }
 
@@ -153,14 +249,98 @@ vp_pattern_spec_new(const gchar *pattern, gboolean include)
   VPPatternSpec *self = g_new0(VPPatternSpec, 1);
 
   self->pattern = g_pattern_spec_new(pattern);
+  self->pattern_text = g_strdup(pattern);
   self->include = include;
+  self->literal = (strpbrk(pattern, "*?") == NULL);
   return self;
 }
 
+static void
+vp_literal_key_free(VPLiteralKey *self)
+{
+  g_free(self->name);
+  g_free(self);
+}
+
+/* drop the compiled plan, it is rebuilt on the next foreach.  Called
+   whenever the scopes or the pattern set changes. */
+static void
+vp_invalidate_plan(ValuePairs *vp)
+{
+  g_static_mutex_lock(&vp->plan_lock);
+  vp->plan_compiled = FALSE;
+  if (vp->literal_keys)
+    {
+      g_ptr_array_foreach(vp->literal_keys, (GFunc) vp_literal_key_free, NULL);
+      g_ptr_array_free(vp->literal_keys, TRUE);
+      vp->literal_keys = NULL;
+    }
+  g_hash_table_remove_all(vp->match_cache);
+  g_static_mutex_unlock(&vp->plan_lock);
+}
+
+static void
+vp_build_literal_key(gpointer key, gpointer value, gpointer user_data)
+{
+  ValuePairs *vp = (ValuePairs *) user_data;
+  VPLiteralKey *lk;
+
+  if (!GPOINTER_TO_INT(value))
+    return;
+
+  lk = g_new(VPLiteralKey, 1);
+  lk->name = g_strdup((gchar *) key);
+  lk->handle = log_msg_get_value_handle(lk->name);
+  g_ptr_array_add(vp->literal_keys, lk);
+}
+
+/* called with plan_lock held */
+static void
+vp_compile_plan(ValuePairs *vp)
+{
+  GHashTable *verdicts;
+  guint i;
+
+  for (i = 0; i < vp->patterns_size; i++)
+    {
+      if (!vp->patterns[i]->literal)
+        return;
+    }
+
+  /* all patterns are literal: a pattern can only match a name equal to
+   * itself, so the verdict for each mentioned name is simply that of
+   * the last pattern mentioning it, everything else is excluded.
+   * Resolve the included names to handles once, per-message evaluation
+   * then goes through log_msg_get_value() instead of a full scan. */
+  verdicts = g_hash_table_new(g_str_hash, g_str_equal);
+  for (i = 0; i < vp->patterns_size; i++)
+    g_hash_table_insert(verdicts, vp->patterns[i]->pattern_text, GINT_TO_POINTER(vp->patterns[i]->include));
+
+  vp->literal_keys = g_ptr_array_new();
+  g_hash_table_foreach(verdicts, vp_build_literal_key, vp);
+  g_hash_table_destroy(verdicts);
+}
+
+static void
+vp_update_plan(ValuePairs *vp)
+{
+  g_static_mutex_lock(&vp->plan_lock);
+  if (!vp->plan_compiled)
+    {
+      vp_compile_plan(vp);
+      vp->plan_compiled = TRUE;
+    }
+  g_static_mutex_unlock(&vp->plan_lock);
+}
+
 gboolean
 value_pairs_add_scope(ValuePairs *vp, const gchar *scope)
 {
-  return cfg_process_flag(value_pair_scope, vp, scope);
+  gboolean result;
+
+  result = cfg_process_flag(value_pair_scope, vp, scope);
+  vp_invalidate_plan(vp);
+  return result;
 }
 
 void
@@ -171,7 +351,8 @@ value_pairs_add_glob_pattern(ValuePairs *vp, const gchar *pattern,
 
   i = vp->patterns_size++;
   vp->patterns = g_renew(VPPatternSpec *, vp->patterns, vp->patterns_size);
-  vp->patterns[i] = vp_pattern_spec_new(pattern, include);;
+  vp->patterns[i] = vp_pattern_spec_new(pattern, include);
+  vp_invalidate_plan(vp);
 }
 
 void
@@ -202,11 +383,23 @@ static gchar *
 vp_transform_apply (ValuePairs *vp, gchar *key)
 {
   GList *l;
-  gchar *ckey, *okey = g_strdup(key);
+  gchar *ckey, *okey;
+  gchar *cached;
 
   if (!vp->transforms)
-    return okey;
-
+    return g_strdup(key);
+
+  /* the transform chains are pure functions of the key, so the final
+   * name is computed only once per distinct key; afterwards renaming is
+   * a hash lookup instead of re-running the glob match and the prefix
+   * manipulations on every message */
+  g_static_mutex_lock(&vp->plan_lock);
+  cached = g_hash_table_lookup(vp->rename_cache, key);
+  g_static_mutex_unlock(&vp->plan_lock);
+  if (cached)
+    return g_strdup(cached);
+
+  okey = g_strdup(key);
   l = vp->transforms;
   while (l)
     {
@@ -217,6 +410,10 @@ vp_transform_apply (ValuePairs *vp, gchar *key)
       l = g_list_next (l);
     }
 
+  g_static_mutex_lock(&vp->plan_lock);
+  g_hash_table_replace(vp->rename_cache, g_strdup(key), g_strdup(ckey));
+  g_static_mutex_unlock(&vp->plan_lock);
+
   return ckey;
 }
 
@@ -244,7 +441,13 @@ vp_pairs_foreach(gpointer data, gpointer user_data)
       return;
     }
 
-  g_tree_insert(scope_set, vp_transform_apply(vp, vpc->name), sb);
+  if (vp->max_value_length && sb_th_gstring_string(sb)->len > vp->max_value_length)
+    {
+      g_string_truncate(sb_th_gstring_string(sb), vp->max_value_length);
+      stats_counter_inc(count_truncated_value_pairs);
+    }
+
+  g_tree_insert(scope_set, vp_transform_apply(vp, vpc->name), vp_value_new_owned(sb));
 }
 
 /* runs over the LogMessage nv-pairs, and inserts them unless excluded */
@@ -257,33 +460,70 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
   GTree *scope_set = ((gpointer *)user_data)[5];
   guint j;
   gboolean inc;
-  SBTHGString *sb;
+  gpointer cached_verdict;
 
   if (value_len == 0)
     return FALSE;
 
-  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
-        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
-        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+  /* the verdict only depends on the handle (name, sdata-ness) and the
+   * configured scopes/patterns, so it is memoized per handle to avoid
+   * re-running the glob patterns on every message */
+  g_static_mutex_lock(&vp->plan_lock);
+  cached_verdict = g_hash_table_lookup(vp->match_cache, GUINT_TO_POINTER(handle));
+  g_static_mutex_unlock(&vp->plan_lock);
 
-  for (j = 0; j < vp->patterns_size; j++)
+  if (cached_verdict)
     {
-      if (vp_pattern_spec_eval(vp->patterns[j], name))
-        inc = vp->patterns[j]->include;
+      inc = (GPOINTER_TO_INT(cached_verdict) > 0);
+    }
+  else
+    {
+      inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
+            (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
+            (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+
+      for (j = 0; j < vp->patterns_size; j++)
+        {
+          if (vp_pattern_spec_eval(vp->patterns[j], name))
+            inc = vp->patterns[j]->include;
+        }
+
+      g_static_mutex_lock(&vp->plan_lock);
+      g_hash_table_insert(vp->match_cache, GUINT_TO_POINTER(handle), GINT_TO_POINTER(inc ? 1 : -1));
+      g_static_mutex_unlock(&vp->plan_lock);
     }
 
   if (!inc)
     return FALSE;
 
-  sb = sb_th_gstring_acquire();
-
-  g_string_append_len(sb_th_gstring_string(sb), value, value_len);
-  sb->type_hint = TYPE_HINT_STRING;
-  g_tree_insert(scope_set, vp_transform_apply(vp, name), sb);
+  g_tree_insert(scope_set, vp_transform_apply(vp, name),
+                vp_value_new_for_nvpair(vp, value, value_len));
 
   return FALSE;
 }
 
+/* the all-literal fast path of vp_msg_nvpairs_foreach(): look up each
+   selected key directly instead of scanning the whole NVTable */
+static void
+vp_merge_literal_keys(ValuePairs *vp, LogMessage *msg, GTree *scope_set)
+{
+  guint i;
+
+  for (i = 0; i < vp->literal_keys->len; i++)
+    {
+      VPLiteralKey *lk = (VPLiteralKey *) g_ptr_array_index(vp->literal_keys, i);
+      const gchar *value;
+      gssize value_len = 0;
+
+      value = log_msg_get_value(msg, lk->handle, &value_len);
+      if (value_len == 0)
+        continue;
+
+      g_tree_insert(scope_set, vp_transform_apply(vp, lk->name),
+                    vp_value_new_for_nvpair(vp, value, value_len));
+    }
+}
+
 static gboolean
 vp_find_in_set(ValuePairs *vp, gchar *name, gboolean exclude)
 {
@@ -310,34 +550,43 @@ vp_merge_other_set(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zo
       if (!vp_find_in_set(vp, set[i].name, exclude))
         continue;
 
-      sb = sb_th_gstring_acquire();
-
       switch (set[i].type)
         {
         case VPT_MACRO:
+          sb = sb_th_gstring_acquire();
           log_macro_expand(sb_th_gstring_string(sb), set[i].id, FALSE,
                            template_options, time_zone_mode, seq_num, NULL, msg);
+
+          if (sb_th_gstring_string(sb)->len == 0)
+            {
+              sb_th_gstring_release(sb);
+              continue;
+            }
+
+          if (vp->max_value_length && sb_th_gstring_string(sb)->len > vp->max_value_length)
+            {
+              g_string_truncate(sb_th_gstring_string(sb), vp->max_value_length);
+              stats_counter_inc(count_truncated_value_pairs);
+            }
+
+          g_tree_insert(dest, vp_transform_apply(vp, set[i].name), vp_value_new_owned(sb));
           break;
         case VPT_NVPAIR:
           {
             const gchar *nv;
-            gssize len;
+            gssize len = 0;
 
             nv = log_msg_get_value(msg, (NVHandle) set[i].id, &len);
-            g_string_append_len(sb_th_gstring_string(sb), nv, len);
+            if (len == 0)
+              continue;
+
+            g_tree_insert(dest, vp_transform_apply(vp, set[i].name),
+                          vp_value_new_for_nvpair(vp, nv, len));
             break;
           }
         default:
           g_assert_not_reached();
         }
-
-      if (sb_th_gstring_string(sb)->len == 0)
-        {
-          sb_th_gstring_release(sb);
-          continue;
-        }
-
-      g_tree_insert(dest, vp_transform_apply(vp, set[i].name), sb);
     }
 }
 
@@ -356,7 +605,7 @@ vp_merge_set(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zone_mod
 }
 
 static gboolean
-vp_foreach_helper (const gchar *name, const SBTHGString *hinted_value,
+vp_foreach_helper (const gchar *name, const VPValue *hinted_value,
                    gpointer data)
 {
   VPForeachFunc func = ((gpointer *)data)[0];
@@ -364,16 +613,10 @@ vp_foreach_helper (const gchar *name, const SBTHGString *hinted_value,
   gboolean *r = ((gpointer *)data)[2];
 
   *r &= !func(name, hinted_value->type_hint,
-              sb_th_gstring_string(hinted_value)->str, user_data);
+              hinted_value->value, user_data);
   return !*r;
 }
 
-static void
-vp_data_free (SBTHGString *s)
-{
-  sb_th_gstring_release (s);
-}
-
 gboolean
 value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             GCompareDataFunc compare_func,
@@ -391,16 +634,23 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
 
   scope_set = g_tree_new_full((GCompareDataFunc)compare_func, NULL,
                               (GDestroyNotify)g_free,
-                              (GDestroyNotify)vp_data_free);
+                              (GDestroyNotify)vp_value_free);
   args[5] = scope_set;
 
+  vp_update_plan(vp);
+
   /*
    * Build up the base set
    */
-  if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) ||
-      vp->patterns_size > 0)
-    nv_table_foreach(msg->payload, logmsg_registry,
-                     (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
+  /* NOTE: iterating through log_msg_values_foreach() instead of the
+   * payload NVTable directly makes sure values staged in the payload
+   * overlay of a cloned message are visible as well */
+  if (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424))
+    log_msg_values_foreach(msg, (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
+  else if (vp->literal_keys)
+    vp_merge_literal_keys(vp, msg, scope_set);
+  else if (vp->patterns_size > 0)
+    log_msg_values_foreach(msg, (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
 
   if (vp->patterns_size > 0)
     vp_merge_macros(vp, msg, seq_num, time_zone_mode, scope_set, template_options);
@@ -449,14 +699,14 @@ value_pairs_debug_append (const gchar *name, TypeHint type, const gchar *value,
 EVTTAG *
 evt_tag_value_pairs(const char* key, ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zone_mode, LogTemplateOptions *template_options)
 {
-   GString *debug_text = g_string_new("");
+   SBGString *debug_text = sb_gstring_acquire();
    EVTTAG* result;
 
-   value_pairs_foreach(vp, value_pairs_debug_append, msg, seq_num, time_zone_mode, template_options, debug_text);
+   value_pairs_foreach(vp, value_pairs_debug_append, msg, seq_num, time_zone_mode, template_options, sb_gstring_string(debug_text));
 
-   result = evt_tag_str(key, debug_text->str);
+   result = evt_tag_str(key, sb_gstring_string(debug_text)->str);
 
-   g_string_free(debug_text, TRUE);
+   sb_gstring_release(debug_text);
    return result;
 };
 
@@ -857,6 +1107,9 @@ value_pairs_new(void)
   vp = g_new0(ValuePairs, 1);
    g_atomic_counter_set(&vp->ref_cnt, 1);
   vp->vpairs = g_ptr_array_sized_new(8);
+  g_static_mutex_init(&vp->plan_lock);
+  vp->match_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+  vp->rename_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 
   if (!value_pair_sets_initialized)
     {
@@ -883,6 +1136,11 @@ value_pairs_new(void)
         }
       all_macros = (ValuePairSpec *) g_array_free(a, FALSE);
 
+      stats_lock();
+      stats_register_counter(0, SCS_GLOBAL, "truncated_value_pairs", NULL,
+                             SC_TYPE_PROCESSED, &count_truncated_value_pairs);
+      stats_unlock();
+
       value_pair_sets_initialized = TRUE;
     }
 
@@ -917,6 +1175,15 @@ value_pairs_free (ValuePairs *vp)
     }
   g_free(vp->patterns);
 
+  if (vp->literal_keys)
+    {
+      g_ptr_array_foreach(vp->literal_keys, (GFunc) vp_literal_key_free, NULL);
+      g_ptr_array_free(vp->literal_keys, TRUE);
+    }
+  g_hash_table_destroy(vp->match_cache);
+  g_hash_table_destroy(vp->rename_cache);
+  g_static_mutex_free(&vp->plan_lock);
+
   l = vp->transforms;
   while (l)
     {
@@ -932,6 +1199,13 @@ void
 value_pairs_add_transforms(ValuePairs *vp, gpointer vpts)
 {
   vp->transforms = g_list_append(vp->transforms, vpts);
+  g_hash_table_remove_all(vp->rename_cache);
+}
+
+void
+value_pairs_set_max_value_length(ValuePairs *vp, gsize max_len)
+{
+  vp->max_value_length = max_len;
 }
 
 /*******************************************************************************
@@ -999,6 +1273,27 @@ vp_cmdline_parse_exclude(const gchar *option_name, const gchar *value,
   return TRUE;
 }
 
+static gboolean
+vp_cmdline_parse_max_value_length(const gchar *option_name, const gchar *value,
+                                  gpointer data, GError **error)
+{
+  gpointer *args = (gpointer *) data;
+  ValuePairs *vp = (ValuePairs *) args[1];
+  gchar *end = NULL;
+  glong max_len;
+
+  max_len = strtol(value, &end, 10);
+  if (!end || *end != '\0' || max_len < 0)
+    {
+      g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                   "Error parsing value-pairs: invalid --max-value-length %s", value);
+      return FALSE;
+    }
+
+  value_pairs_set_max_value_length (vp, (gsize) max_len);
+  return TRUE;
+}
+
 static void
 vp_cmdline_start_key(gpointer data, const gchar *key)
 {
@@ -1229,6 +1524,8 @@ value_pairs_new_from_cmdline (GlobalConfig *cfg,
       NULL, NULL },
     { "exclude", 'x', 0, G_OPTION_ARG_CALLBACK, vp_cmdline_parse_exclude,
       NULL, NULL },
+    { "max-value-length", 0, 0, G_OPTION_ARG_CALLBACK, vp_cmdline_parse_max_value_length,
+      NULL, NULL },
     { "key", 'k', 0, G_OPTION_ARG_CALLBACK, vp_cmdline_parse_key,
       NULL, NULL },
     { "rekey", 'r', 0, G_OPTION_ARG_CALLBACK, vp_cmdline_parse_rekey,
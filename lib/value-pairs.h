@@ -50,6 +50,11 @@ gboolean value_pairs_add_pair(ValuePairs *vp, const gchar *key, LogTemplate *val
 
 void value_pairs_add_transforms(ValuePairs *vp, gpointer vpts);
 
+/* values longer than this are truncated before being passed to the
+ * foreach callbacks (0: unlimited), also settable as the
+ * --max-value-length cmdline option */
+void value_pairs_set_max_value_length(ValuePairs *vp, gsize max_len);
+
 gboolean value_pairs_foreach_sorted(ValuePairs *vp, VPForeachFunc func,
                                     GCompareDataFunc compare_func,
                                     LogMessage *msg, gint32 seq_num, gint tz,
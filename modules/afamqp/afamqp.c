@@ -66,6 +66,11 @@ typedef struct
   amqp_socket_t* sockfd;
   amqp_table_entry_t *entries;
   gint32 max_entries;
+
+  /* publisher confirm bookkeeping for pipeline() >= 2; delivery tags are
+   * numbered from 1 on each channel */
+  guint64 publish_tag;
+  guint64 confirmed_tag;
 } AMQPDestDriver;
 
 /*
@@ -388,6 +393,18 @@ afamqp_dd_connect(AMQPDestDriver *self, gboolean reconnect)
         }
     }
 
+  if (self->super.pipeline_depth >= 2)
+    {
+      amqp_confirm_select(self->conn, 1);
+      ret = amqp_get_rpc_reply(self->conn);
+      if (!afamqp_is_ok(self, "Error enabling AMQP publisher confirms", ret))
+        {
+          goto exception_amqp_dd_connect_failed_exchange;
+        }
+    }
+  self->publish_tag = 0;
+  self->confirmed_tag = 0;
+
   msg_debug ("Connecting to AMQP succeeded",
              evt_tag_str("driver", self->super.super.super.id),
              NULL);
@@ -508,6 +525,66 @@ afamqp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
   if (!afamqp_worker_publish (self, msg))
     return WORKER_INSERT_RESULT_ERROR;
 
+  if (self->super.pipeline_depth >= 2)
+    {
+      self->publish_tag++;
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
+/* wait for the batched publisher confirms; the broker may cover several
+ * messages with one basic.ack using the multiple flag */
+static worker_insert_result_t
+afamqp_worker_flush(LogThrDestDriver *s)
+{
+  AMQPDestDriver *self = (AMQPDestDriver *)s;
+
+  while (self->confirmed_tag < self->publish_tag)
+    {
+      amqp_frame_t frame;
+      gint ret;
+
+      ret = amqp_simple_wait_frame(self->conn, &frame);
+      if (ret < 0)
+        {
+          msg_error("Network error while waiting for AMQP publisher confirms",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("error", amqp_error_string2(-ret)),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+
+      if (frame.frame_type != AMQP_FRAME_METHOD)
+        continue;
+
+      if (frame.payload.method.id == AMQP_BASIC_ACK_METHOD)
+        {
+          amqp_basic_ack_t *ack = (amqp_basic_ack_t *) frame.payload.method.decoded;
+
+          if (ack->multiple)
+            {
+              if (ack->delivery_tag > self->confirmed_tag)
+                self->confirmed_tag = ack->delivery_tag;
+            }
+          else
+            self->confirmed_tag++;
+        }
+      else
+        {
+          /* basic.nack, basic.return or a close method, the outstanding
+           * window cannot be confirmed */
+          msg_error("AMQP server refused batched publish",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_printf("method_id", "0x%08X", frame.payload.method.id),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+    }
+
   return WORKER_INSERT_RESULT_SUCCESS;
 }
 
@@ -592,6 +669,7 @@ afamqp_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_init = afamqp_worker_thread_init;
   self->super.worker.disconnect = afamqp_dd_disconnect;
   self->super.worker.insert = afamqp_worker_insert;
+  self->super.worker.flush = afamqp_worker_flush;
 
   self->super.format.stats_instance = afamqp_dd_format_stats_instance;
   self->super.format.persist_name = afamqp_dd_format_persist_name;
@@ -28,7 +28,9 @@
 #include "serialize.h"
 #include "gprocess.h"
 #include "stats/stats-registry.h"
+#include "mainloop.h"
 #include "mainloop-call.h"
+#include "mainloop-io-worker.h"
 #include "transport/transport-file.h"
 #include "logproto/logproto-text-client.h"
 #include "logproto-file-writer.h"
@@ -98,6 +100,9 @@ struct _AFFileDestWriter
   time_t last_open_stamp;
   time_t time_reopen;
   struct iv_timer reap_timer;
+  /* open()/stat() are performed on an I/O worker thread through this job */
+  MainLoopIOWorkerJob open_job;
+  gboolean open_succeeded;
   gboolean reopen_pending, queue_pending;
 };
 
@@ -156,25 +161,19 @@ _affile_dw_reopen_file(AFFileDestWriter *self, gchar *name, gint *fd)
   return affile_open_file(name, &self->owner->file_open_options, &self->owner->file_perm_options, fd);
 }
 
-static gboolean
-affile_dw_reopen(AFFileDestWriter *self)
+/* runs on an I/O worker thread: perform the stat()/open() calls and hand
+ * the constructed proto over to the writer, so metadata I/O on the output
+ * path doesn't stall the source threads or the main loop */
+static void
+affile_dw_open_file(gpointer s)
 {
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
   int fd;
   struct stat st;
-  GlobalConfig *cfg;
   LogProtoClient *proto = NULL;
 
-  cfg = log_pipe_get_config(&self->super);
-  if (cfg)
-    self->time_reopen = cfg->time_reopen;
-
-   msg_verbose("Initializing destination file writer",
-              evt_tag_str("template", self->owner->filename_template->template),
-              evt_tag_str("filename", self->filename),
-              NULL);
-
   self->last_open_stamp = self->last_msg_stamp;
-  if (self->owner->overwrite_if_older > 0 && 
+  if (self->owner->overwrite_if_older > 0 &&
       stat(self->filename, &st) == 0 &&
       st.st_mtime < time(NULL) - self->owner->overwrite_if_older)
     {
@@ -191,9 +190,10 @@ affile_dw_reopen(AFFileDestWriter *self)
                            ? log_proto_text_client_new(log_transport_pipe_new(fd), &self->owner->writer_options.proto_options.super)
                            : log_proto_file_writer_new(log_transport_file_new(fd), &self->owner->writer_options.proto_options.super,
                                                        self->owner->writer_options.flush_lines,
-                                                       self->owner->use_fsync);
+                                                       self->owner->use_fsync,
+                                                       self->owner->use_fsync_async);
 
-      main_loop_call((void * (*)(void *)) affile_dw_arm_reaper, self, TRUE);
+      self->open_succeeded = TRUE;
     }
   else
     {
@@ -201,9 +201,68 @@ affile_dw_reopen(AFFileDestWriter *self)
                 evt_tag_str("filename", self->filename),
                 evt_tag_errno(EVT_TAG_OSERROR, errno),
                 NULL);
+      self->open_succeeded = FALSE;
     }
 
+  /* a NULL proto makes the writer schedule a retry in time_reopen() seconds */
   log_writer_reopen(self->writer, proto);
+}
+
+/* runs in the main thread once the open job has finished */
+static void
+affile_dw_open_finished(gpointer s)
+{
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
+
+  if (self->open_succeeded && (self->super.flags & PIF_INITIALIZED))
+    affile_dw_arm_reaper(self);
+
+  g_static_mutex_lock(&self->lock);
+  self->reopen_pending = FALSE;
+  g_static_mutex_unlock(&self->lock);
+
+  /* drop the reference held by the job */
+  log_pipe_unref(&self->super);
+}
+
+/* jobs can only be submitted from the main thread */
+static void
+affile_dw_submit_open(gpointer s)
+{
+  AFFileDestWriter *self = (AFFileDestWriter *) s;
+
+  main_loop_io_worker_job_submit(&self->open_job);
+}
+
+static gboolean
+affile_dw_reopen(AFFileDestWriter *self)
+{
+  GlobalConfig *cfg;
+
+  cfg = log_pipe_get_config(&self->super);
+  if (cfg)
+    self->time_reopen = cfg->time_reopen;
+
+  msg_verbose("Initializing destination file writer",
+              evt_tag_str("template", self->owner->filename_template->template),
+              evt_tag_str("filename", self->filename),
+              NULL);
+
+  g_static_mutex_lock(&self->lock);
+  if (self->reopen_pending)
+    {
+      g_static_mutex_unlock(&self->lock);
+      return TRUE;
+    }
+  self->reopen_pending = TRUE;
+  g_static_mutex_unlock(&self->lock);
+
+  /* the job keeps the writer alive until the completion callback runs */
+  log_pipe_ref(&self->super);
+  if (main_loop_is_main_thread())
+    affile_dw_submit_open(self);
+  else
+    main_loop_call((void *(*)(void *)) affile_dw_submit_open, self, FALSE);
 
   return TRUE;
 }
@@ -281,12 +340,12 @@ affile_dw_queue(LogPipe *s, LogMessage *lm, const LogPathOptions *path_options,
       !self->reopen_pending &&
       (self->last_open_stamp < self->last_msg_stamp - self->time_reopen))
     {
-      self->reopen_pending = TRUE;
-      /* if the file couldn't be opened, try it again every time_reopen seconds */
+      /* if the file couldn't be opened, try it again every time_reopen
+       * seconds; reopen_pending is managed by affile_dw_reopen() and its
+       * completion callback */
       g_static_mutex_unlock(&self->lock);
       affile_dw_reopen(self);
       g_static_mutex_lock(&self->lock);
-      self->reopen_pending = FALSE;
     }
   g_static_mutex_unlock(&self->lock);
 
@@ -363,6 +422,11 @@ affile_dw_new(const gchar *filename, GlobalConfig *cfg)
   self->reap_timer.cookie = self;
   self->reap_timer.handler = affile_dw_reap;
 
+  main_loop_io_worker_job_init(&self->open_job);
+  self->open_job.user_data = self;
+  self->open_job.work = affile_dw_open_file;
+  self->open_job.completion = affile_dw_open_finished;
+
   /* we have to take care about freeing filename later. 
      This avoids a move of the filename. */
   self->filename = g_strdup(filename);
@@ -386,7 +450,7 @@ affile_dd_set_overwrite_if_older(LogDriver *s, gint overwrite_if_older)
   self->overwrite_if_older = overwrite_if_older;
 }
 
-void 
+void
 affile_dd_set_fsync(LogDriver *s, gboolean fsync)
 {
   AFFileDestDriver *self = (AFFileDestDriver *) s;
@@ -394,6 +458,22 @@ affile_dd_set_fsync(LogDriver *s, gboolean fsync)
   self->use_fsync = fsync;
 }
 
+void
+affile_dd_set_fsync_async(LogDriver *s, gboolean fsync_async)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->use_fsync_async = fsync_async;
+}
+
+void
+affile_dd_set_max_open_files(LogDriver *s, gint max_open_files)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->max_open_files = max_open_files;
+}
+
 static inline gchar *
 affile_dd_format_persist_name(AFFileDestDriver *self)
 {
@@ -573,6 +653,42 @@ affile_dd_deinit(LogPipe *s)
   return TRUE;
 }
 
+static void
+affile_dd_find_lru_writer(gpointer key, gpointer value, gpointer user_data)
+{
+  AFFileDestWriter **lru = (AFFileDestWriter **) user_data;
+  AFFileDestWriter *dw = (AFFileDestWriter *) value;
+
+  if (dw->queue_pending || dw->reopen_pending || log_writer_has_pending_writes(dw->writer))
+    return;
+  if (!*lru || dw->last_msg_stamp < (*lru)->last_msg_stamp)
+    *lru = dw;
+}
+
+/* called in the main thread before a new writer is opened: when the
+ * number of open files reached max_open_files(), close the least
+ * recently used idle one instead of waiting for its reap timer */
+static void
+affile_dd_reap_lru_writer(AFFileDestDriver *self)
+{
+  AFFileDestWriter *lru = NULL;
+
+  if (self->max_open_files <= 0 ||
+      g_hash_table_size(self->writer_hash) < self->max_open_files)
+    return;
+
+  g_hash_table_foreach(self->writer_hash, affile_dd_find_lru_writer, &lru);
+  if (lru)
+    {
+      msg_verbose("Maximum number of open files reached, reaping the least recently used one",
+                  evt_tag_str("template", self->filename_template->template),
+                  evt_tag_str("filename", lru->filename),
+                  evt_tag_int("max_open_files", self->max_open_files),
+                  NULL);
+      affile_dd_reap_writer(self, lru);
+    }
+}
+
 /*
  * This function is ran in the main thread whenever a writer is not yet
  * instantiated.  Returns a reference to the newly constructed LogPipe
@@ -626,6 +742,7 @@ affile_dd_open_writer(gpointer args[])
       next = g_hash_table_lookup(self->writer_hash, filename->str);
       if (!next)
 	{
+	  affile_dd_reap_lru_writer(self);
 	  next = affile_dw_new(filename->str, log_pipe_get_config(&self->super.super.super));
           affile_dw_set_owner(next, self);
           if (!log_pipe_init(&next->super))
@@ -690,7 +807,7 @@ affile_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
       GString *filename;
 
       filename = g_string_sized_new(32);
-      log_template_format(self->filename_template, msg, &self->writer_options.template_options, LTZ_LOCAL, 0, NULL, filename);
+      log_template_format_cached(self->filename_template, msg, &self->writer_options.template_options, LTZ_LOCAL, 0, NULL, filename);
 
       g_static_mutex_lock(&self->lock);
       if (self->writer_hash)
@@ -756,6 +873,11 @@ affile_dd_new_instance(gchar *filename, GlobalConfig *cfg)
   if (strchr(filename, '$') != NULL)
     {
       self->filename_is_a_template = TRUE;
+
+      /* most filename templates only reference slow changing values
+       * (e.g. $HOST), repeated messages then resolve their path with a
+       * hash lookup instead of a full template expansion */
+      log_template_enable_result_cache(self->filename_template);
     }
   self->time_reap = -1;
   self->file_open_options.is_pipe = FALSE;
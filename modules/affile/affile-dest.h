@@ -38,7 +38,8 @@ typedef struct _AFFileDestDriver
   AFFileDestWriter *single_writer;
   gboolean filename_is_a_template:1,
     template_escape:1,
-    use_fsync:1;
+    use_fsync:1,
+    use_fsync_async:1;
   FilePermOptions file_perm_options;
   FileOpenOptions file_open_options;
   TimeZoneInfo *local_time_zone_info;
@@ -48,6 +49,7 @@ typedef struct _AFFileDestDriver
   gint overwrite_if_older;
   gboolean use_time_recvd;
   gint time_reap;
+  gint max_open_files;
 } AFFileDestDriver;
 
 LogDriver *affile_dd_new(gchar *filename, GlobalConfig *cfg);
@@ -55,7 +57,9 @@ LogDriver *afpipe_dd_new(gchar *filename, GlobalConfig *cfg);
 
 void affile_dd_set_create_dirs(LogDriver *s, gboolean create_dirs);
 void affile_dd_set_fsync(LogDriver *s, gboolean enable);
+void affile_dd_set_fsync_async(LogDriver *s, gboolean enable);
 void affile_dd_set_overwrite_if_older(LogDriver *s, gint overwrite_if_older);
+void affile_dd_set_max_open_files(LogDriver *s, gint max_open_files);
 void affile_dd_set_local_time_zone(LogDriver *s, const gchar *local_time_zone);
 
 #endif
@@ -33,10 +33,18 @@ static CfgLexerKeyword affile_keywords[] = {
   { "file",               KW_FILE },
   { "fifo",               KW_PIPE },
   { "pipe",               KW_PIPE },
+  { "wildcard_file",      KW_WILDCARD_FILE },
+
+  { "base_dir",           KW_BASE_DIR },
+  { "filename_pattern",   KW_FILENAME_PATTERN },
+  { "max_files",          KW_MAX_FILES },
+  { "monitor_freq",       KW_MONITOR_FREQ },
 
   { "fsync",              KW_FSYNC },
+  { "fsync_async",        KW_FSYNC_ASYNC },
   { "remove_if_older",    KW_OVERWRITE_IF_OLDER, KWS_OBSOLETE, "overwrite_if_older" },
   { "overwrite_if_older", KW_OVERWRITE_IF_OLDER },
+  { "max_open_files",     KW_MAX_OPEN_FILES },
   { "follow_freq",        KW_FOLLOW_FREQ },
   { "multi_line_mode",    KW_MULTI_LINE_MODE  },
   { "multi_line_prefix",  KW_MULTI_LINE_PREFIX },
@@ -25,6 +25,7 @@
 #include "messages.h"
 #include "misc.h"
 #include "serialize.h"
+#include "persistable-state-header.h"
 #include "gprocess.h"
 #include "stats/stats-registry.h"
 #include "mainloop.h"
@@ -65,6 +66,8 @@ affile_sd_set_multi_line_mode(LogDriver *s, const gchar *mode)
     self->multi_line_mode = MLM_PREFIX_GARBAGE;
   else if (strcasecmp(mode, "prefix-suffix") == 0)
     self->multi_line_mode = MLM_PREFIX_SUFFIX;
+  else if (strcasecmp(mode, "prefix-string") == 0)
+    self->multi_line_mode = MLM_PREFIX_STRING;
   else if (strcasecmp(mode, "none") == 0)
     self->multi_line_mode = MLM_NONE;
   else
@@ -72,22 +75,27 @@ affile_sd_set_multi_line_mode(LogDriver *s, const gchar *mode)
   return TRUE;
 }
 
+/* NOTE: the patterns are only stored here; whether they are compiled
+ * into regexps or literal matchers depends on multi-line-mode(), which
+ * may be set later, so compilation is deferred to init time */
 gboolean
-affile_sd_set_multi_line_prefix(LogDriver *s, const gchar *prefix_regexp, GError **error)
+affile_sd_set_multi_line_prefix(LogDriver *s, const gchar *prefix_pattern, GError **error)
 {
   AFFileSourceDriver *self = (AFFileSourceDriver *) s;
 
-  self->multi_line_prefix = multi_line_regexp_compile(prefix_regexp, error);
-  return self->multi_line_prefix != NULL;
+  g_free(self->multi_line_prefix_pattern);
+  self->multi_line_prefix_pattern = g_strdup(prefix_pattern);
+  return TRUE;
 }
 
 gboolean
-affile_sd_set_multi_line_garbage(LogDriver *s, const gchar *garbage_regexp, GError **error)
+affile_sd_set_multi_line_garbage(LogDriver *s, const gchar *garbage_pattern, GError **error)
 {
   AFFileSourceDriver *self = (AFFileSourceDriver *) s;
 
-  self->multi_line_garbage = multi_line_regexp_compile(garbage_regexp, error);
-  return self->multi_line_garbage != NULL;
+  g_free(self->multi_line_garbage_pattern);
+  self->multi_line_garbage_pattern = g_strdup(garbage_pattern);
+  return TRUE;
 }
 
 void
@@ -160,6 +168,180 @@ affile_sd_recover_state(LogPipe *s, GlobalConfig *cfg, LogProtoServer *proto)
     }
 }
 
+typedef struct _AFFileKmsgSeqState
+{
+  PersistableStateHeader header;
+  guint64 last_seq;
+} AFFileKmsgSeqState;
+
+static inline gchar *
+affile_sd_format_kmsg_seq_persist_name(AFFileSourceDriver *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "affile_sd_kmsg_seq(%s)", self->filename->str);
+  return persist_name;
+}
+
+/* extract the sequence number (the second comma separated field) from a
+ * raw /dev/kmsg record, without going anywhere near the message parser */
+static gboolean
+affile_sd_parse_kmsg_seq(const gchar *record, gsize len, guint64 *seq)
+{
+  guint64 value = 0;
+  gboolean have_digits = FALSE;
+  gsize pos = 0;
+
+  while (pos < len && record[pos] != ',')
+    pos++;
+  pos++;
+  while (pos < len && g_ascii_isdigit(record[pos]))
+    {
+      value = value * 10 + (record[pos] - '0');
+      have_digits = TRUE;
+      pos++;
+    }
+  if (!have_digits || pos >= len || record[pos] != ',')
+    return FALSE;
+  *seq = value;
+  return TRUE;
+}
+
+/* looks up or allocates the persist entry holding the last processed
+ * /dev/kmsg sequence number; returns TRUE if a previous position was
+ * restored into *last_seq */
+static gboolean
+affile_sd_acquire_kmsg_seq_state(AFFileSourceDriver *self, guint64 *last_seq)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+  AFFileKmsgSeqState *data;
+  gsize size;
+  guint8 version;
+
+  *last_seq = 0;
+  if (!cfg->state)
+    return FALSE;
+
+  self->kmsg_persist_state = cfg->state;
+  self->kmsg_seq_handle = persist_state_lookup_entry(cfg->state, affile_sd_format_kmsg_seq_persist_name(self), &size, &version);
+  if (self->kmsg_seq_handle)
+    {
+      data = persist_state_map_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+      if (data->header.version > 0)
+        {
+          msg_error("Internal error restoring /dev/kmsg position, stored data is too new",
+                    evt_tag_int("version", data->header.version),
+                    NULL);
+          persist_state_unmap_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+          return FALSE;
+        }
+      if ((data->header.big_endian && G_BYTE_ORDER == G_LITTLE_ENDIAN) ||
+          (!data->header.big_endian && G_BYTE_ORDER == G_BIG_ENDIAN))
+        {
+          data->header.big_endian = !data->header.big_endian;
+          data->last_seq = GUINT64_SWAP_LE_BE(data->last_seq);
+        }
+      *last_seq = data->last_seq;
+      persist_state_unmap_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+      return TRUE;
+    }
+
+  self->kmsg_seq_handle = persist_state_alloc_entry(cfg->state, affile_sd_format_kmsg_seq_persist_name(self), sizeof(AFFileKmsgSeqState));
+  if (!self->kmsg_seq_handle)
+    {
+      msg_error("Error allocating /dev/kmsg sequence number in persist-state",
+                NULL);
+      self->kmsg_persist_state = NULL;
+      return FALSE;
+    }
+  data = persist_state_map_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+  data->header.version = 0;
+  data->header.big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
+  data->last_seq = 0;
+  persist_state_unmap_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+  return FALSE;
+}
+
+/* Position /dev/kmsg right after the last record the previous run has
+ * processed.  The device only supports seeking to the oldest record or to
+ * the end, so we skip forward by reading records and comparing their
+ * sequence numbers against the persisted one: sequence numbers are dense,
+ * thus the record whose sequence number equals the persisted value is the
+ * last one we have seen and the very next read returns the first unseen
+ * record.  Skipping costs a read() plus a short digit scan per record,
+ * nothing enters the message parser or the log path, so catching up over
+ * a full ring buffer is cheap even with a hundred thousand records in it.
+ * Without a usable previous position we keep the old behaviour of
+ * starting at the end. */
+static void
+affile_sd_kmsg_catch_up(AFFileSourceDriver *self, gint fd)
+{
+  gchar buf[8192];
+  guint64 last_seq, seq;
+  gssize rc;
+
+  if (!affile_sd_acquire_kmsg_seq_state(self, &last_seq) || last_seq == 0)
+    {
+      if (lseek(fd, 0, SEEK_END) < 0)
+        {
+          msg_error("Error seeking /dev/kmsg to the end",
+                    evt_tag_str("error", g_strerror(errno)),
+                    NULL);
+        }
+      return;
+    }
+
+  /* NOTE: if the ring buffer overran our position, the first record read
+   * here already has a higher sequence number and gets consumed by the
+   * probe; losing that single record when the kernel has already dropped
+   * an unknown number of them is an acceptable price for not being able
+   * to peek.  After a reboot sequence numbers restart from zero, the loop
+   * then drains the entire ring and we start at the end, exactly as
+   * before. */
+  for (;;)
+    {
+      do
+        {
+          rc = read(fd, buf, sizeof(buf));
+        }
+      while (rc == -1 && errno == EINTR);
+
+      if (rc == -1 && errno == EPIPE)
+        continue;
+      if (rc <= 0)
+        break;
+      if (affile_sd_parse_kmsg_seq(buf, rc, &seq) && seq >= last_seq)
+        break;
+    }
+}
+
+/* remember the sequence number of each message that made it into the log
+ * path; the kmsg format parser stores it in MSGID.  Only the reader thread
+ * touches the entry while the driver is running, so no locking is needed
+ * around the in-place update. */
+static void
+affile_sd_save_kmsg_seq(AFFileSourceDriver *self, LogMessage *msg)
+{
+  AFFileKmsgSeqState *data;
+  const gchar *seq_str;
+  gssize seq_len, i;
+  guint64 seq = 0;
+
+  seq_str = log_msg_get_value(msg, LM_V_MSGID, &seq_len);
+  if (seq_len == 0)
+    return;
+  for (i = 0; i < seq_len; i++)
+    {
+      if (!g_ascii_isdigit(seq_str[i]))
+        return;
+      seq = seq * 10 + (seq_str[i] - '0');
+    }
+
+  data = persist_state_map_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+  data->last_seq = seq;
+  persist_state_unmap_entry(self->kmsg_persist_state, self->kmsg_seq_handle);
+}
+
 static gboolean
 _is_fd_pollable(gint fd)
 {
@@ -204,12 +386,7 @@ affile_sd_construct_transport(AFFileSourceDriver *self, gint fd)
     return log_transport_device_new(fd, 10);
   else if (affile_is_linux_dev_kmsg(self->filename->str))
     {
-      if (lseek(fd, 0, SEEK_END) < 0)
-        {
-          msg_error("Error seeking /dev/kmsg to the end",
-                    evt_tag_str("error", g_strerror(errno)),
-                    NULL);
-        }
+      affile_sd_kmsg_catch_up(self, fd);
       return log_transport_device_new(fd, 0);
     }
   else
@@ -247,6 +424,8 @@ affile_sd_construct_proto(AFFileSourceDriver *self, gint fd)
           return log_proto_prefix_garbage_multiline_server_new(transport, proto_options, self->multi_line_prefix, self->multi_line_garbage);
         case MLM_PREFIX_SUFFIX:
           return log_proto_prefix_suffix_multiline_server_new(transport, proto_options, self->multi_line_prefix, self->multi_line_garbage);
+        case MLM_PREFIX_STRING:
+          return log_proto_prefix_string_multiline_server_new(transport, proto_options, self->multi_line_prefix_literal, self->multi_line_garbage_literal);
         default:
           return log_proto_text_server_new(transport, proto_options);
         }
@@ -326,9 +505,56 @@ affile_sd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
   
   log_msg_set_value(msg, filename_handle, self->filename->str, self->filename->len);
 
+  if (self->kmsg_persist_state)
+    affile_sd_save_kmsg_seq(self, msg);
+
   log_src_driver_queue_method(s, msg, path_options, user_data);
 }
 
+/* the raw multi-line patterns are compiled here, as the interpretation
+ * (regexp or literal string) depends on multi-line-mode() and the
+ * options may arrive in any order during parsing */
+static gboolean
+affile_sd_compile_multi_line_patterns(AFFileSourceDriver *self)
+{
+  GError *error = NULL;
+
+  if (self->multi_line_mode == MLM_PREFIX_STRING)
+    {
+      if (self->multi_line_prefix_pattern && !self->multi_line_prefix_literal)
+        self->multi_line_prefix_literal = multi_line_literal_new(self->multi_line_prefix_pattern);
+      if (self->multi_line_garbage_pattern && !self->multi_line_garbage_literal)
+        self->multi_line_garbage_literal = multi_line_literal_new(self->multi_line_garbage_pattern);
+      return TRUE;
+    }
+
+  if (self->multi_line_prefix_pattern && !self->multi_line_prefix)
+    {
+      self->multi_line_prefix = multi_line_regexp_compile(self->multi_line_prefix_pattern, &error);
+      if (!self->multi_line_prefix)
+        {
+          msg_error("Error compiling multi-line-prefix() regexp",
+                    evt_tag_str("error", error->message),
+                    NULL);
+          g_clear_error(&error);
+          return FALSE;
+        }
+    }
+  if (self->multi_line_garbage_pattern && !self->multi_line_garbage)
+    {
+      self->multi_line_garbage = multi_line_regexp_compile(self->multi_line_garbage_pattern, &error);
+      if (!self->multi_line_garbage)
+        {
+          msg_error("Error compiling multi-line-garbage() regexp",
+                    evt_tag_str("error", error->message),
+                    NULL);
+          g_clear_error(&error);
+          return FALSE;
+        }
+    }
+  return TRUE;
+}
+
 static gboolean
 affile_sd_init(LogPipe *s)
 {
@@ -342,12 +568,16 @@ affile_sd_init(LogPipe *s)
 
   log_reader_options_init(&self->reader_options, cfg, self->super.super.group);
 
-  if ((self->multi_line_mode != MLM_PREFIX_GARBAGE && self->multi_line_mode != MLM_PREFIX_SUFFIX ) && (self->multi_line_prefix || self->multi_line_garbage))
+  if ((self->multi_line_mode != MLM_PREFIX_GARBAGE && self->multi_line_mode != MLM_PREFIX_SUFFIX && self->multi_line_mode != MLM_PREFIX_STRING) &&
+      (self->multi_line_prefix_pattern || self->multi_line_garbage_pattern))
     {
-      msg_error("multi-line-prefix() and/or multi-line-garbage() specified but multi-line-mode() is not regexp based (prefix-garbage or prefix-suffix), please set multi-line-mode() properly", NULL);
+      msg_error("multi-line-prefix() and/or multi-line-garbage() specified but multi-line-mode() is not pattern based (prefix-garbage, prefix-suffix or prefix-string), please set multi-line-mode() properly", NULL);
       return FALSE;
     }
 
+  if (!affile_sd_compile_multi_line_patterns(self))
+    return FALSE;
+
   file_opened = affile_sd_open_file(self, self->filename->str, &fd);
   if (!file_opened && self->follow_freq > 0)
     {
@@ -438,8 +668,12 @@ affile_sd_free(LogPipe *s)
 
   log_reader_options_destroy(&self->reader_options);
 
+  g_free(self->multi_line_prefix_pattern);
+  g_free(self->multi_line_garbage_pattern);
   multi_line_regexp_free(self->multi_line_prefix);
   multi_line_regexp_free(self->multi_line_garbage);
+  multi_line_literal_free(self->multi_line_prefix_literal);
+  multi_line_literal_free(self->multi_line_garbage_literal);
 
   log_src_driver_free(s);
 }
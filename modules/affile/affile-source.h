@@ -26,7 +26,9 @@
 
 #include "driver.h"
 #include "logreader.h"
+#include "persist-state.h"
 #include "logproto/logproto-regexp-multiline-server.h"
+#include "logproto/logproto-string-multiline-server.h"
 #include "affile-common.h"
 
 
@@ -36,6 +38,7 @@ enum
   MLM_INDENTED,
   MLM_PREFIX_GARBAGE,
   MLM_PREFIX_SUFFIX,
+  MLM_PREFIX_STRING,
 };
 
 typedef struct _AFFileSourceDriver
@@ -49,15 +52,24 @@ typedef struct _AFFileSourceDriver
   gint pad_size;
   gint follow_freq;
   gint multi_line_mode;
+  /* the raw multi-line-prefix()/multi-line-garbage() option values; they
+   * are compiled in init, once multi-line-mode() is known, either into
+   * regexps or into literal matchers */
+  gchar *multi_line_prefix_pattern, *multi_line_garbage_pattern;
   MultiLineRegexp *multi_line_prefix, *multi_line_garbage;
+  MultiLineLiteral *multi_line_prefix_literal, *multi_line_garbage_literal;
+  /* last /dev/kmsg sequence number we processed, persisted so a restart
+   * can skip the part of the kernel ring buffer it has already seen */
+  PersistState *kmsg_persist_state;
+  PersistEntryHandle kmsg_seq_handle;
   /* state information to follow a set of files using a wildcard expression */
 } AFFileSourceDriver;
 
 LogDriver *affile_sd_new(gchar *filename, GlobalConfig *cfg);
 LogDriver *afpipe_sd_new(gchar *filename, GlobalConfig *cfg);
 
-gboolean affile_sd_set_multi_line_prefix(LogDriver *s, const gchar *prefix_regexp, GError **error);
-gboolean affile_sd_set_multi_line_garbage(LogDriver *s, const gchar *garbage_regexp, GError **error);
+gboolean affile_sd_set_multi_line_prefix(LogDriver *s, const gchar *prefix_pattern, GError **error);
+gboolean affile_sd_set_multi_line_garbage(LogDriver *s, const gchar *garbage_pattern, GError **error);
 gboolean affile_sd_set_multi_line_mode(LogDriver *s, const gchar *mode);
 void affile_sd_set_follow_freq(LogDriver *s, gint follow_freq);
 
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "directory-monitor.h"
+#include "messages.h"
+#include "misc.h"
+#include "timeutils.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <iv.h>
+
+#ifdef SYSLOG_NG_HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+/* Watches the entries of a single directory and reports
+ * creation/modification/deletion of the files within.  On Linux a single
+ * inotify watch covers the whole directory, so following thousands of
+ * files costs one fd instead of one timer or fd per file.  On platforms
+ * without inotify the directory is rescanned every rescan_freq
+ * milliseconds and changes are detected by comparing size/mtime against
+ * the previous scan. */
+
+typedef struct _DirectoryMonitorFileState
+{
+  off_t size;
+  time_t mtime;
+  guint32 generation;
+} DirectoryMonitorFileState;
+
+struct _DirectoryMonitor
+{
+  gchar *dir;
+  gint rescan_freq;
+  DirectoryMonitorEventCallback callback;
+  gpointer callback_data;
+  gboolean use_inotify;
+  gint inotify_fd;
+  gint inotify_watch;
+  struct iv_fd inotify_poll;
+  struct iv_timer rescan_timer;
+  /* name -> DirectoryMonitorFileState, only used by the rescan fallback */
+  GHashTable *file_states;
+  guint32 generation;
+};
+
+static void
+directory_monitor_report(DirectoryMonitor *self, const gchar *name, DirectoryMonitorEvent event)
+{
+  self->callback(name, event, self->callback_data);
+}
+
+#ifdef SYSLOG_NG_HAVE_SYS_INOTIFY_H
+
+static void
+directory_monitor_inotify_events(gpointer s)
+{
+  DirectoryMonitor *self = (DirectoryMonitor *) s;
+  gchar buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  gssize len;
+  gint i;
+
+  while ((len = read(self->inotify_fd, buf, sizeof(buf))) > 0)
+    {
+      i = 0;
+      while (i < len)
+        {
+          struct inotify_event *event = (struct inotify_event *) &buf[i];
+
+          i += sizeof(struct inotify_event) + event->len;
+          if (event->len == 0 || (event->mask & IN_ISDIR))
+            continue;
+
+          if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            directory_monitor_report(self, event->name, DIRECTORY_MONITOR_FILE_CREATED);
+          else if (event->mask & IN_MODIFY)
+            directory_monitor_report(self, event->name, DIRECTORY_MONITOR_FILE_MODIFIED);
+          else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            directory_monitor_report(self, event->name, DIRECTORY_MONITOR_FILE_DELETED);
+        }
+    }
+  if (len < 0 && errno != EAGAIN)
+    {
+      msg_error("Error reading inotify events, disabling directory monitoring",
+                evt_tag_str("dir", self->dir),
+                evt_tag_errno("error", errno),
+                NULL);
+      iv_fd_unregister(&self->inotify_poll);
+      close(self->inotify_fd);
+      self->inotify_fd = -1;
+    }
+}
+
+static gboolean
+directory_monitor_start_inotify(DirectoryMonitor *self)
+{
+  self->inotify_fd = inotify_init();
+  if (self->inotify_fd < 0)
+    return FALSE;
+
+  self->inotify_watch = inotify_add_watch(self->inotify_fd, self->dir,
+                                          IN_CREATE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+  if (self->inotify_watch < 0)
+    {
+      close(self->inotify_fd);
+      self->inotify_fd = -1;
+      return FALSE;
+    }
+
+  g_fd_set_nonblock(self->inotify_fd, TRUE);
+  self->inotify_poll.fd = self->inotify_fd;
+  iv_fd_register(&self->inotify_poll);
+  iv_fd_set_handler_in(&self->inotify_poll, directory_monitor_inotify_events);
+  self->use_inotify = TRUE;
+  return TRUE;
+}
+
+#else
+
+static gboolean
+directory_monitor_start_inotify(DirectoryMonitor *self)
+{
+  return FALSE;
+}
+
+#endif
+
+/* scan the directory and report changes against the previous scan; also
+ * used for the initial enumeration, in which case every matching entry is
+ * reported as created */
+static gboolean
+directory_monitor_rescan(DirectoryMonitor *self)
+{
+  GDir *dir;
+  const gchar *name;
+  GError *error = NULL;
+
+  dir = g_dir_open(self->dir, 0, &error);
+  if (!dir)
+    {
+      msg_verbose("Error opening monitored directory",
+                  evt_tag_str("dir", self->dir),
+                  evt_tag_str("error", error->message),
+                  NULL);
+      g_clear_error(&error);
+      return FALSE;
+    }
+
+  self->generation++;
+  while ((name = g_dir_read_name(dir)))
+    {
+      DirectoryMonitorFileState *state;
+      gchar *filename;
+      struct stat st;
+
+      filename = g_build_filename(self->dir, name, NULL);
+      if (stat(filename, &st) < 0 || !S_ISREG(st.st_mode))
+        {
+          g_free(filename);
+          continue;
+        }
+      g_free(filename);
+
+      state = g_hash_table_lookup(self->file_states, name);
+      if (!state)
+        {
+          state = g_new0(DirectoryMonitorFileState, 1);
+          state->size = st.st_size;
+          state->mtime = st.st_mtime;
+          state->generation = self->generation;
+          g_hash_table_insert(self->file_states, g_strdup(name), state);
+          directory_monitor_report(self, name, DIRECTORY_MONITOR_FILE_CREATED);
+        }
+      else
+        {
+          state->generation = self->generation;
+          if (state->size != st.st_size || state->mtime != st.st_mtime)
+            {
+              state->size = st.st_size;
+              state->mtime = st.st_mtime;
+              directory_monitor_report(self, name, DIRECTORY_MONITOR_FILE_MODIFIED);
+            }
+        }
+    }
+  g_dir_close(dir);
+  return TRUE;
+}
+
+static gboolean
+directory_monitor_remove_stale(gpointer key, gpointer value, gpointer user_data)
+{
+  DirectoryMonitor *self = (DirectoryMonitor *) user_data;
+  DirectoryMonitorFileState *state = (DirectoryMonitorFileState *) value;
+
+  if (state->generation == self->generation)
+    return FALSE;
+  directory_monitor_report(self, (const gchar *) key, DIRECTORY_MONITOR_FILE_DELETED);
+  return TRUE;
+}
+
+static void
+directory_monitor_rearm_rescan_timer(DirectoryMonitor *self)
+{
+  iv_validate_now();
+  self->rescan_timer.expires = iv_now;
+  timespec_add_msec(&self->rescan_timer.expires, self->rescan_freq);
+  iv_timer_register(&self->rescan_timer);
+}
+
+static void
+directory_monitor_rescan_timer_elapsed(gpointer s)
+{
+  DirectoryMonitor *self = (DirectoryMonitor *) s;
+
+  directory_monitor_rescan(self);
+  g_hash_table_foreach_remove(self->file_states, directory_monitor_remove_stale, self);
+  directory_monitor_rearm_rescan_timer(self);
+}
+
+void
+directory_monitor_set_callback(DirectoryMonitor *self, DirectoryMonitorEventCallback callback, gpointer user_data)
+{
+  self->callback = callback;
+  self->callback_data = user_data;
+}
+
+gboolean
+directory_monitor_start(DirectoryMonitor *self)
+{
+  g_assert(self->callback);
+
+  if (directory_monitor_start_inotify(self))
+    {
+      /* the initial enumeration is a plain scan, inotify only reports
+       * changes from this point on */
+      if (!directory_monitor_rescan(self))
+        {
+          directory_monitor_stop(self);
+          return FALSE;
+        }
+      msg_verbose("Monitoring directory using inotify",
+                  evt_tag_str("dir", self->dir),
+                  NULL);
+      return TRUE;
+    }
+
+  if (!directory_monitor_rescan(self))
+    return FALSE;
+  msg_verbose("Monitoring directory using periodic rescan, inotify is not available",
+              evt_tag_str("dir", self->dir),
+              evt_tag_int("rescan_freq", self->rescan_freq),
+              NULL);
+  directory_monitor_rearm_rescan_timer(self);
+  return TRUE;
+}
+
+void
+directory_monitor_stop(DirectoryMonitor *self)
+{
+  if (iv_timer_registered(&self->rescan_timer))
+    iv_timer_unregister(&self->rescan_timer);
+#ifdef SYSLOG_NG_HAVE_SYS_INOTIFY_H
+  if (self->use_inotify && self->inotify_fd >= 0)
+    {
+      iv_fd_unregister(&self->inotify_poll);
+      inotify_rm_watch(self->inotify_fd, self->inotify_watch);
+      close(self->inotify_fd);
+      self->inotify_fd = -1;
+    }
+#endif
+  self->use_inotify = FALSE;
+}
+
+void
+directory_monitor_free(DirectoryMonitor *self)
+{
+  g_hash_table_destroy(self->file_states);
+  g_free(self->dir);
+  g_free(self);
+}
+
+DirectoryMonitor *
+directory_monitor_new(const gchar *dir, gint rescan_freq)
+{
+  DirectoryMonitor *self = g_new0(DirectoryMonitor, 1);
+
+  self->dir = g_strdup(dir);
+  self->rescan_freq = rescan_freq;
+  self->inotify_fd = -1;
+  self->file_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  IV_FD_INIT(&self->inotify_poll);
+  self->inotify_poll.cookie = self;
+
+  IV_TIMER_INIT(&self->rescan_timer);
+  self->rescan_timer.cookie = self;
+  self->rescan_timer.handler = directory_monitor_rescan_timer_elapsed;
+
+  return self;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef DIRECTORY_MONITOR_H_INCLUDED
+#define DIRECTORY_MONITOR_H_INCLUDED
+
+#include "syslog-ng.h"
+
+typedef enum
+{
+  DIRECTORY_MONITOR_FILE_CREATED,
+  DIRECTORY_MONITOR_FILE_MODIFIED,
+  DIRECTORY_MONITOR_FILE_DELETED,
+} DirectoryMonitorEvent;
+
+/* NOTE: name is the entry name relative to the monitored directory */
+typedef void (*DirectoryMonitorEventCallback)(const gchar *name, DirectoryMonitorEvent event, gpointer user_data);
+
+typedef struct _DirectoryMonitor DirectoryMonitor;
+
+DirectoryMonitor *directory_monitor_new(const gchar *dir, gint rescan_freq);
+void directory_monitor_set_callback(DirectoryMonitor *self, DirectoryMonitorEventCallback callback, gpointer user_data);
+gboolean directory_monitor_start(DirectoryMonitor *self);
+void directory_monitor_stop(DirectoryMonitor *self);
+void directory_monitor_free(DirectoryMonitor *self);
+
+#endif
@@ -37,21 +37,132 @@ typedef struct _LogProtoFileWriter
   gint fd;
   gint sum_len;
   gboolean fsync;
+  gboolean fsync_async;
+  /* number of messages written out since the last fsync() (since the
+   * last sync request in async mode) */
+  gint unsynced_msgs;
+
+  /* fsync-async(yes): writes complete into the page cache and a
+   * dedicated thread runs the fsync()s behind the writer, while the
+   * acks of a batch are withheld until the fsync covering it has
+   * completed.  The counters below are cumulative message counts along
+   * the written -> sync requested -> synced pipeline, protected by
+   * fsync_lock; acks are only ever delivered on the writer's own
+   * thread (see _collect_acks), the fsync thread never touches the
+   * queue. */
+  GThread *fsync_thread;
+  GMutex *fsync_lock;
+  GCond *fsync_request_cond;
+  GCond *fsync_complete_cond;
+  guint64 fsync_requested_msgs;
+  guint64 fsync_completed_msgs;
+  /* only the writer thread advances this, no lock needed */
+  guint64 fsync_acked_msgs;
+  gboolean fsync_stop;
+
   struct iovec buffer[0];
 } LogProtoFileWriter;
 
+/* number of messages a single fsync() is amortized over when fsync(yes)
+ * is set; the externally triggered flush at the end of a burst always
+ * syncs, so at most this many messages can be pending at any time */
+#define LOG_PROTO_FILE_WRITER_FSYNC_GROUP 64
+
+static gpointer
+log_proto_file_writer_fsync_thread(gpointer s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  g_mutex_lock(self->fsync_lock);
+  for (;;)
+    {
+      guint64 target;
+
+      while (!self->fsync_stop && self->fsync_completed_msgs == self->fsync_requested_msgs)
+        g_cond_wait(self->fsync_request_cond, self->fsync_lock);
+      if (self->fsync_completed_msgs == self->fsync_requested_msgs)
+        break;
+      target = self->fsync_requested_msgs;
+      g_mutex_unlock(self->fsync_lock);
+      fsync(self->fd);
+      g_mutex_lock(self->fsync_lock);
+      /* requests that arrived during the fsync() stay pending and are
+       * picked up by the next round */
+      self->fsync_completed_msgs = target;
+      g_cond_signal(self->fsync_complete_cond);
+    }
+  g_mutex_unlock(self->fsync_lock);
+  return NULL;
+}
+
+/* deliver the acks of batches whose covering fsync has completed; runs
+ * on the writer's own thread only, so the backlog stays single
+ * consumer */
+static void
+log_proto_file_writer_collect_acks(LogProtoFileWriter *self)
+{
+  guint64 completed;
+  gint num_acks;
+
+  g_mutex_lock(self->fsync_lock);
+  completed = self->fsync_completed_msgs;
+  g_mutex_unlock(self->fsync_lock);
+  num_acks = completed - self->fsync_acked_msgs;
+  if (num_acks > 0)
+    {
+      self->fsync_acked_msgs = completed;
+      log_proto_client_msg_ack(&self->super, num_acks);
+    }
+}
+
+static void
+log_proto_file_writer_maybe_fsync(LogProtoFileWriter *self, gboolean sync_required)
+{
+  if (!self->fsync)
+    return;
+  if (self->fsync_async)
+    {
+      if (self->unsynced_msgs > 0 &&
+          (sync_required || self->unsynced_msgs >= LOG_PROTO_FILE_WRITER_FSYNC_GROUP))
+        {
+          g_mutex_lock(self->fsync_lock);
+          self->fsync_requested_msgs += self->unsynced_msgs;
+          self->unsynced_msgs = 0;
+          g_cond_signal(self->fsync_request_cond);
+          if (sync_required)
+            {
+              /* the forced flush at the end of a burst keeps its
+               * synchronous durability guarantee and drains all
+               * deferred acks below */
+              while (self->fsync_completed_msgs != self->fsync_requested_msgs)
+                g_cond_wait(self->fsync_complete_cond, self->fsync_lock);
+            }
+          g_mutex_unlock(self->fsync_lock);
+        }
+      log_proto_file_writer_collect_acks(self);
+      return;
+    }
+  if (self->unsynced_msgs == 0)
+    return;
+  if (!sync_required && self->unsynced_msgs < LOG_PROTO_FILE_WRITER_FSYNC_GROUP)
+    return;
+  fsync(self->fd);
+  self->unsynced_msgs = 0;
+}
+
 /*
- * log_proto_file_writer_flush:
+ * log_proto_file_writer_flush_data:
  *
  * this function flushes the file output buffer
- * it is called either form log_proto_file_writer_post (normal mode: the buffer is full)
- * or from log_proto_flush (foced flush: flush time, exit, etc)
+ * it is called either from log_proto_file_writer_post (normal mode: the
+ * buffer is full, sync_required is FALSE so fsync() calls are grouped)
+ * or through log_proto_flush (forced flush: flush time, exit, etc, which
+ * always syncs written data)
  *
  */
 static LogProtoStatus
-log_proto_file_writer_flush(LogProtoClient *s)
+log_proto_file_writer_flush_data(LogProtoFileWriter *self, gboolean sync_required)
 {
-  LogProtoFileWriter *self = (LogProtoFileWriter *)s;
   gint rc, i, i0, sum, ofs, pos;
 
   if (self->partial)
@@ -60,8 +171,6 @@ log_proto_file_writer_flush(LogProtoClient *s)
       gint len = self->partial_len - self->partial_pos;
 
       rc = write(self->fd, self->partial + self->partial_pos, len);
-      if (rc > 0 && self->fsync)
-        fsync(self->fd);
       if (rc < 0)
         {
           goto write_error;
@@ -69,23 +178,25 @@ log_proto_file_writer_flush(LogProtoClient *s)
       else if (rc != len)
         {
           self->partial_pos += rc;
+          log_proto_file_writer_maybe_fsync(self, sync_required);
           return LPS_SUCCESS;
         }
       else
         {
           g_free(self->partial);
           self->partial = NULL;
+          self->unsynced_msgs++;
         }
     }
 
   /* we might be called from log_writer_deinit() without having a buffer at all */
   if (self->buf_count == 0)
-    return LPS_SUCCESS;
+    {
+      log_proto_file_writer_maybe_fsync(self, sync_required);
+      return LPS_SUCCESS;
+    }
 
   rc = writev(self->fd, self->buffer, self->buf_count);
-  if (rc > 0 && self->fsync)
-    fsync(self->fd);
-
   if (rc < 0)
     {
       goto write_error;
@@ -95,36 +206,45 @@ log_proto_file_writer_flush(LogProtoClient *s)
       /* partial success: not everything has been written out */
       /* look for the first chunk that has been cut */
       sum = self->buffer[0].iov_len; /* sum is the cumulated length of the already processed items */
-      i = 0;
+      i0 = 0;
       while (rc > sum)
-        sum += self->buffer[++i].iov_len;
-      self->partial_len = sum - rc; /* this is the length of the first non-written chunk */
-      i0 = i;
-      ++i;
-      /* add the lengths of the following messages */
-      while (i < self->buf_count)
-        self->partial_len += self->buffer[i++].iov_len;
-      /* allocate and copy the remaning data */
-      self->partial = (guchar *)g_malloc(self->partial_len);
-      ofs = sum - rc; /* the length of the remaning (not processed) chunk in the first message */
-      pos = self->buffer[i0].iov_len - ofs;
-      memcpy(self->partial, self->buffer[i0].iov_base + pos, ofs);
-      i = i0 + 1;
-      while (i < self->buf_count)
+        sum += self->buffer[++i0].iov_len;
+
+      /* only the unwritten tail of the cut chunk is copied aside, the
+       * chunks after it stay in the iovec array for the next round
+       * instead of being re-copied */
+      ofs = sum - rc;
+      if (ofs > 0)
         {
-          memcpy(self->partial + ofs, self->buffer[i].iov_base, self->buffer[i].iov_len);
-          ofs += self->buffer[i].iov_len;
-          ++i;
+          pos = self->buffer[i0].iov_len - ofs;
+          self->partial = (guchar *) g_malloc(ofs);
+          memcpy(self->partial, self->buffer[i0].iov_base + pos, ofs);
+          self->partial_len = ofs;
+          self->partial_pos = 0;
         }
-      self->partial_pos = 0;
+      self->unsynced_msgs += i0 + (ofs > 0 ? 0 : 1);
+
+      /* free the chunks that have been written out completely (the cut
+       * one included, its tail lives on in the partial buffer) */
+      for (i = 0; i <= i0; ++i)
+        g_free(self->buffer[i].iov_base);
+      memmove(&self->buffer[0], &self->buffer[i0 + 1], (self->buf_count - (i0 + 1)) * sizeof(struct iovec));
+      self->buf_count -= i0 + 1;
+      self->sum_len -= sum;
+
+      log_proto_file_writer_maybe_fsync(self, sync_required);
+      return LPS_SUCCESS;
     }
 
-  /* free the previous message strings (the remaning part has been copied to the partial buffer) */
+  self->unsynced_msgs += self->buf_count;
+
+  /* free the message strings, everything has been written out */
   for (i = 0; i < self->buf_count; ++i)
     g_free(self->buffer[i].iov_base);
   self->buf_count = 0;
   self->sum_len = 0;
 
+  log_proto_file_writer_maybe_fsync(self, sync_required);
   return LPS_SUCCESS;
 
  write_error:
@@ -138,7 +258,14 @@ log_proto_file_writer_flush(LogProtoClient *s)
     }
 
   return LPS_SUCCESS;
+}
 
+static LogProtoStatus
+log_proto_file_writer_flush(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  return log_proto_file_writer_flush_data(self, TRUE);
 }
 
 /*
@@ -161,7 +288,7 @@ log_proto_file_writer_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
   *consumed = FALSE;
   if (self->buf_count >= self->buf_size || self->partial)
     {
-      result = log_proto_file_writer_flush(s);
+      result = log_proto_file_writer_flush_data(self, FALSE);
       if (result != LPS_SUCCESS || self->buf_count >= self->buf_size || self->partial)
         {
           /* don't consume a new message if flush failed OR if we couldn't
@@ -181,13 +308,16 @@ log_proto_file_writer_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
   if (self->buf_count == self->buf_size)
     {
       /* we have reached the max buffer size -> we need to write the messages */
-      result = log_proto_file_writer_flush(s);
+      result = log_proto_file_writer_flush_data(self, FALSE);
       if (result != LPS_SUCCESS)
         return result;
     }
 
   *consumed = TRUE;
-  log_proto_client_msg_ack(&self->super, 1);
+  /* in async mode the ack is withheld until the fsync covering this
+   * message completes, see log_proto_file_writer_collect_acks() */
+  if (!self->fsync_async)
+    log_proto_client_msg_ack(&self->super, 1);
   return LPS_SUCCESS;
 }
 
@@ -205,8 +335,29 @@ log_proto_file_writer_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
   return self->buf_count > 0 || self->partial;
 }
 
+static void
+log_proto_file_writer_free(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  if (self->fsync_thread)
+    {
+      g_mutex_lock(self->fsync_lock);
+      self->fsync_stop = TRUE;
+      g_cond_signal(self->fsync_request_cond);
+      g_mutex_unlock(self->fsync_lock);
+      g_thread_join(self->fsync_thread);
+      g_mutex_free(self->fsync_lock);
+      g_cond_free(self->fsync_request_cond);
+      g_cond_free(self->fsync_complete_cond);
+    }
+  /* messages whose deferred ack never arrived stay in the backlog and
+   * are rewound by the writer, preserving at-least-once delivery */
+  log_proto_client_free_method(s);
+}
+
 LogProtoClient *
-log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync)
+log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gboolean fsync, gboolean fsync_async)
 {
   if (flush_lines == 0)
     /* the flush-lines option has not been specified, use a default value */
@@ -223,9 +374,29 @@ log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *
   log_proto_client_init(&self->super, transport, options);
   self->fd = transport->fd;
   self->buf_size = flush_lines;
-  self->fsync = fsync;
+  self->fsync = fsync || fsync_async;
+  self->fsync_async = fsync_async;
   self->super.prepare = log_proto_file_writer_prepare;
   self->super.post = log_proto_file_writer_post;
   self->super.flush = log_proto_file_writer_flush;
+  self->super.free_fn = log_proto_file_writer_free;
+  if (self->fsync_async)
+    {
+      self->fsync_lock = g_mutex_new();
+      self->fsync_request_cond = g_cond_new();
+      self->fsync_complete_cond = g_cond_new();
+      self->fsync_thread = g_thread_create(log_proto_file_writer_fsync_thread, self, TRUE, NULL);
+      if (!self->fsync_thread)
+        {
+          /* no thread, no deferral: fall back to synchronous fsync */
+          msg_error("Error starting the fsync thread, falling back to synchronous fsync",
+                    evt_tag_int("fd", self->fd),
+                    NULL);
+          g_mutex_free(self->fsync_lock);
+          g_cond_free(self->fsync_request_cond);
+          g_cond_free(self->fsync_complete_cond);
+          self->fsync_async = FALSE;
+        }
+    }
   return &self->super;
 }
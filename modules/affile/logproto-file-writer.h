@@ -26,6 +26,6 @@
 
 #include "logproto/logproto-client.h"
 
-LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gboolean fsync);
+LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gboolean fsync, gboolean fsync_async);
 
 #endif
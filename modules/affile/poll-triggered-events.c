@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "poll-triggered-events.h"
+
+/* PollEvents instance that has no poll source of its own: an external
+ * component (e.g.  a directory monitor multiplexing an inotify watch over
+ * many files) tells it when the associated fd became readable by calling
+ * poll_triggered_events_trigger().  The trigger is only delivered when the
+ * reader asked for input, otherwise it is dropped; the external component
+ * is expected to signal again when new data arrives. */
+
+typedef struct _PollTriggeredEvents
+{
+  PollEvents super;
+  gboolean armed;
+} PollTriggeredEvents;
+
+static void
+poll_triggered_events_stop_watches(PollEvents *s)
+{
+  PollTriggeredEvents *self = (PollTriggeredEvents *) s;
+
+  self->armed = FALSE;
+}
+
+static void
+poll_triggered_events_update_watches(PollEvents *s, GIOCondition cond)
+{
+  PollTriggeredEvents *self = (PollTriggeredEvents *) s;
+
+  /* we can only provide input events */
+  g_assert((cond & ~G_IO_IN) == 0);
+
+  self->armed = !!(cond & G_IO_IN);
+}
+
+void
+poll_triggered_events_trigger(PollEvents *s)
+{
+  PollTriggeredEvents *self = (PollTriggeredEvents *) s;
+
+  if (!self->armed)
+    return;
+
+  /* disarm first: the reader re-arms through update_watches() once it
+   * drained the fd and wants to be woken up again */
+  self->armed = FALSE;
+  poll_events_invoke_callback(s);
+}
+
+PollEvents *
+poll_triggered_events_new(void)
+{
+  PollTriggeredEvents *self = g_new0(PollTriggeredEvents, 1);
+
+  self->super.stop_watches = poll_triggered_events_stop_watches;
+  self->super.update_watches = poll_triggered_events_update_watches;
+
+  return &self->super;
+}
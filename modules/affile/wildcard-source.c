@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "wildcard-source.h"
+#include "poll-triggered-events.h"
+#include "messages.h"
+#include "stats/stats-registry.h"
+#include "transport/transport-file.h"
+#include "logproto/logproto-text-server.h"
+#include "compat/lfs.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define DEFAULT_SD_OPEN_FLAGS (O_RDONLY | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
+#define DEFAULT_MAX_FILES 100
+#define DEFAULT_MONITOR_FREQ 1000
+
+/* Wildcard file source: follows all files matching filename-pattern()
+ * within base-dir().  A single DirectoryMonitor instance watches the
+ * directory, so one inotify fd (or one rescan timer on platforms without
+ * inotify) covers the whole set of files instead of a follow-timer per
+ * file.  Each matched file gets an ordinary LogReader whose PollEvents is
+ * driven by the monitor: when the monitor sees the file change, the
+ * reader is woken up and reads until EAGAIN.  Rotation is detected from
+ * the directory events themselves (a new file appearing under a followed
+ * name), without any stat()/reopen polling. */
+
+/* per-file LogPipe between the LogReader and the driver: owns the reader,
+ * tags messages with the originating filename and serves as the reader's
+ * control pipe */
+typedef struct _WildcardFileReader
+{
+  LogPipe super;
+  WildcardSourceDriver *driver;
+  GString *filename;
+  LogReader *reader;
+  /* owned by self->reader, only valid while the reader exists */
+  PollEvents *poll_events;
+} WildcardFileReader;
+
+static inline gchar *
+wildcard_file_reader_format_persist_name(WildcardFileReader *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "wildcard_file_sd_curpos(%s)", self->filename->str);
+  return persist_name;
+}
+
+static gboolean
+wildcard_file_reader_init(LogPipe *s)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+  WildcardSourceDriver *driver = self->driver;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+  LogProtoServer *proto;
+  gint fd;
+
+  if (!affile_open_file(self->filename->str, &driver->file_open_options, &driver->file_perm_options, &fd))
+    {
+      msg_error("Error opening file for reading",
+                evt_tag_str("filename", self->filename->str),
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+      return FALSE;
+    }
+
+  proto = log_proto_text_server_new(log_transport_file_new(fd), &driver->reader_options.proto_options.super);
+  self->poll_events = poll_triggered_events_new();
+
+  self->reader = log_reader_new(cfg);
+  log_reader_reopen(self->reader, proto, self->poll_events);
+  log_reader_set_options(self->reader,
+                         s,
+                         &driver->reader_options,
+                         STATS_LEVEL1,
+                         SCS_FILE,
+                         driver->super.super.id,
+                         self->filename->str);
+  /* pick up the content the file already has, the monitor only reports
+   * changes from now on */
+  log_reader_set_immediate_check(self->reader);
+
+  log_pipe_append((LogPipe *) self->reader, s);
+  if (!log_pipe_init((LogPipe *) self->reader))
+    {
+      msg_error("Error initializing log_reader, closing fd",
+                evt_tag_int("fd", fd),
+                NULL);
+      log_pipe_unref((LogPipe *) self->reader);
+      self->reader = NULL;
+      self->poll_events = NULL;
+      close(fd);
+      return FALSE;
+    }
+
+  if (!log_proto_server_restart_with_state(proto, cfg->state, wildcard_file_reader_format_persist_name(self)))
+    {
+      msg_error("Error converting persistent state from on-disk format, losing file position information",
+                evt_tag_str("filename", self->filename->str),
+                NULL);
+    }
+  return TRUE;
+}
+
+static gboolean
+wildcard_file_reader_deinit(LogPipe *s)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+
+  if (self->reader)
+    {
+      log_pipe_deinit((LogPipe *) self->reader);
+      log_pipe_unref((LogPipe *) self->reader);
+      self->reader = NULL;
+      self->poll_events = NULL;
+    }
+  return TRUE;
+}
+
+static void
+wildcard_file_reader_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+  static NVHandle filename_handle = 0;
+
+  if (!filename_handle)
+    filename_handle = log_msg_get_value_handle("FILE_NAME");
+
+  log_msg_set_value(msg, filename_handle, self->filename->str, self->filename->len);
+
+  log_pipe_forward_msg(s, msg, path_options);
+}
+
+static void
+wildcard_file_reader_notify(LogPipe *s, gint notify_code, gpointer user_data)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+
+  switch (notify_code)
+    {
+    case NC_READ_ERROR:
+      msg_error("Error reading followed file",
+                evt_tag_str("filename", self->filename->str),
+                NULL);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+wildcard_file_reader_free(LogPipe *s)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+
+  g_assert(!self->reader);
+  g_string_free(self->filename, TRUE);
+  log_pipe_free_method(s);
+}
+
+/* wake up the reader, the monitor saw the file change */
+static void
+wildcard_file_reader_trigger(WildcardFileReader *self)
+{
+  if (self->poll_events)
+    poll_triggered_events_trigger(self->poll_events);
+}
+
+/* the file was recreated under the followed name (rotation): reopen it,
+ * restarting from the persisted position of the new file */
+static gboolean
+wildcard_file_reader_reopen(WildcardFileReader *self)
+{
+  msg_verbose("Followed file was recreated, reopening",
+              evt_tag_str("filename", self->filename->str),
+              NULL);
+  log_pipe_deinit(&self->super);
+  return log_pipe_init(&self->super);
+}
+
+static WildcardFileReader *
+wildcard_file_reader_new(WildcardSourceDriver *driver, const gchar *filename)
+{
+  WildcardFileReader *self = g_new0(WildcardFileReader, 1);
+
+  log_pipe_init_instance(&self->super, log_pipe_get_config(&driver->super.super.super));
+  self->super.init = wildcard_file_reader_init;
+  self->super.deinit = wildcard_file_reader_deinit;
+  self->super.queue = wildcard_file_reader_queue;
+  self->super.notify = wildcard_file_reader_notify;
+  self->super.free_fn = wildcard_file_reader_free;
+  self->driver = driver;
+  self->filename = g_string_new(filename);
+  log_pipe_append(&self->super, &driver->super.super.super);
+  return self;
+}
+
+void
+wildcard_sd_set_base_dir(LogDriver *s, const gchar *base_dir)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_free(self->base_dir);
+  self->base_dir = g_strdup(base_dir);
+}
+
+void
+wildcard_sd_set_filename_pattern(LogDriver *s, const gchar *filename_pattern)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_free(self->filename_pattern);
+  self->filename_pattern = g_strdup(filename_pattern);
+}
+
+void
+wildcard_sd_set_max_files(LogDriver *s, gint max_files)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  self->max_files = max_files;
+}
+
+void
+wildcard_sd_set_monitor_freq(LogDriver *s, gint monitor_freq)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  self->monitor_freq = monitor_freq;
+}
+
+static void
+wildcard_sd_start_file_reader(WildcardSourceDriver *self, const gchar *filename)
+{
+  WildcardFileReader *reader;
+
+  if (g_hash_table_size(self->file_readers) >= self->max_files)
+    {
+      if (!self->max_files_reached)
+        msg_warning("Number of followed files reached max-files(), not following new files",
+                    evt_tag_str("base_dir", self->base_dir),
+                    evt_tag_int("max_files", self->max_files),
+                    NULL);
+      self->max_files_reached = TRUE;
+      return;
+    }
+
+  reader = wildcard_file_reader_new(self, filename);
+  if (!log_pipe_init(&reader->super))
+    {
+      log_pipe_unref(&reader->super);
+      return;
+    }
+  g_hash_table_insert(self->file_readers, g_strdup(filename), reader);
+}
+
+static void
+wildcard_sd_directory_event(const gchar *name, DirectoryMonitorEvent event, gpointer user_data)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) user_data;
+  WildcardFileReader *reader;
+  gchar *filename;
+
+  if (!g_pattern_match_string(self->compiled_pattern, name))
+    return;
+
+  filename = g_build_filename(self->base_dir, name, NULL);
+  reader = g_hash_table_lookup(self->file_readers, filename);
+  switch (event)
+    {
+    case DIRECTORY_MONITOR_FILE_CREATED:
+      if (!reader)
+        wildcard_sd_start_file_reader(self, filename);
+      else if (!wildcard_file_reader_reopen(reader))
+        g_hash_table_remove(self->file_readers, filename);
+      break;
+    case DIRECTORY_MONITOR_FILE_MODIFIED:
+      /* a file might show up without a creation event if the monitor
+       * started falling back to rescans, follow it in that case too */
+      if (reader)
+        wildcard_file_reader_trigger(reader);
+      else
+        wildcard_sd_start_file_reader(self, filename);
+      break;
+    case DIRECTORY_MONITOR_FILE_DELETED:
+      if (reader)
+        {
+          log_pipe_deinit(&reader->super);
+          g_hash_table_remove(self->file_readers, filename);
+          self->max_files_reached = FALSE;
+        }
+      break;
+    }
+  g_free(filename);
+}
+
+static gboolean
+wildcard_sd_init(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_src_driver_init_method(s))
+    return FALSE;
+
+  if (!self->base_dir || !self->filename_pattern)
+    {
+      msg_error("base-dir() and filename-pattern() are mandatory options of the wildcard-file() source", NULL);
+      return FALSE;
+    }
+
+  log_reader_options_init(&self->reader_options, cfg, self->super.super.group);
+
+  if (!self->compiled_pattern)
+    self->compiled_pattern = g_pattern_spec_new(self->filename_pattern);
+
+  self->monitor = directory_monitor_new(self->base_dir, self->monitor_freq);
+  directory_monitor_set_callback(self->monitor, wildcard_sd_directory_event, self);
+  /* NOTE: starting the monitor enumerates the directory, matching files
+   * are opened and their readers started right here */
+  if (!directory_monitor_start(self->monitor))
+    {
+      msg_error("Error opening wildcard file source directory",
+                evt_tag_str("base_dir", self->base_dir),
+                NULL);
+      directory_monitor_free(self->monitor);
+      self->monitor = NULL;
+      return self->super.super.optional;
+    }
+  return TRUE;
+}
+
+static gboolean
+wildcard_sd_deinit_file_reader(gpointer key, gpointer value, gpointer user_data)
+{
+  log_pipe_deinit((LogPipe *) value);
+  return TRUE;
+}
+
+static gboolean
+wildcard_sd_deinit(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  if (self->monitor)
+    {
+      directory_monitor_stop(self->monitor);
+      directory_monitor_free(self->monitor);
+      self->monitor = NULL;
+    }
+  g_hash_table_foreach_remove(self->file_readers, wildcard_sd_deinit_file_reader, NULL);
+  self->max_files_reached = FALSE;
+
+  if (!log_src_driver_deinit_method(s))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+wildcard_sd_free(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_hash_table_destroy(self->file_readers);
+  g_free(self->base_dir);
+  g_free(self->filename_pattern);
+  if (self->compiled_pattern)
+    g_pattern_spec_free(self->compiled_pattern);
+
+  log_reader_options_destroy(&self->reader_options);
+
+  log_src_driver_free(s);
+}
+
+LogDriver *
+wildcard_sd_new(GlobalConfig *cfg)
+{
+  WildcardSourceDriver *self = g_new0(WildcardSourceDriver, 1);
+
+  log_src_driver_init_instance(&self->super, cfg);
+  self->super.super.super.init = wildcard_sd_init;
+  self->super.super.super.deinit = wildcard_sd_deinit;
+  self->super.super.super.free_fn = wildcard_sd_free;
+
+  log_reader_options_defaults(&self->reader_options);
+  file_perm_options_defaults(&self->file_perm_options);
+  self->reader_options.parse_options.flags |= LP_LOCAL;
+
+  self->file_open_options.is_pipe = FALSE;
+  self->file_open_options.open_flags = DEFAULT_SD_OPEN_FLAGS;
+
+  self->max_files = DEFAULT_MAX_FILES;
+  self->monitor_freq = DEFAULT_MONITOR_FREQ;
+  self->file_readers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) log_pipe_unref);
+
+  return &self->super.super;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2002-2015 BalaBit IT Ltd, Budapest, Hungary
+ * Copyright (c) 1998-2015 Balázs Scheidler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef WILDCARD_SOURCE_H_INCLUDED
+#define WILDCARD_SOURCE_H_INCLUDED
+
+#include "driver.h"
+#include "logreader.h"
+#include "affile-common.h"
+#include "directory-monitor.h"
+
+typedef struct _WildcardSourceDriver
+{
+  LogSrcDriver super;
+  gchar *base_dir;
+  gchar *filename_pattern;
+  GPatternSpec *compiled_pattern;
+  guint32 max_files;
+  gint monitor_freq;
+  LogReaderOptions reader_options;
+  FileOpenOptions file_open_options;
+  FilePermOptions file_perm_options;
+  DirectoryMonitor *monitor;
+  /* full path -> WildcardFileReader for the files being followed */
+  GHashTable *file_readers;
+  gboolean max_files_reached;
+} WildcardSourceDriver;
+
+LogDriver *wildcard_sd_new(GlobalConfig *cfg);
+
+void wildcard_sd_set_base_dir(LogDriver *s, const gchar *base_dir);
+void wildcard_sd_set_filename_pattern(LogDriver *s, const gchar *filename_pattern);
+void wildcard_sd_set_max_files(LogDriver *s, gint max_files);
+void wildcard_sd_set_monitor_freq(LogDriver *s, gint monitor_freq);
+
+#endif
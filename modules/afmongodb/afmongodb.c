@@ -77,6 +77,8 @@ typedef struct
 
   GString *current_value;
   bson *bson;
+  /* finished documents waiting for the next bulk insert, see pipeline() */
+  GPtrArray *batch_bsons;
 } MongoDBDestDriver;
 
 /*
@@ -242,6 +244,16 @@ afmongodb_dd_format_persist_name(LogThrDestDriver *d)
   return persist_name;
 }
 
+static void
+afmongodb_worker_drop_batch(MongoDBDestDriver *self)
+{
+  guint i;
+
+  for (i = 0; i < self->batch_bsons->len; i++)
+    bson_free((bson *) g_ptr_array_index(self->batch_bsons, i));
+  g_ptr_array_set_size(self->batch_bsons, 0);
+}
+
 static void
 afmongodb_dd_disconnect(LogThrDestDriver *s)
 {
@@ -249,6 +261,11 @@ afmongodb_dd_disconnect(LogThrDestDriver *s)
 
   mongo_sync_disconnect(self->conn);
   self->conn = NULL;
+
+  /* unflushed documents are rewound together with the connection loss, they
+   * will be rebuilt from the queue backlog */
+  if (self->batch_bsons)
+    afmongodb_worker_drop_batch(self);
 }
 
 static gboolean
@@ -504,6 +521,17 @@ afmongodb_worker_insert (LogThrDestDriver *s, LogMessage *msg)
                                     LTZ_SEND, &self->template_options),
                 evt_tag_str("driver", self->super.super.super.id),
                 NULL);
+
+      /* accumulate documents for a single bulk insert; after a failure the
+       * rewound messages are reinserted one by one so a single broken
+       * message cannot hold up the whole batch */
+      if (self->super.pipeline_depth > 1 && self->super.retries.counter == 0)
+        {
+          g_ptr_array_add(self->batch_bsons, self->bson);
+          self->bson = bson_new_sized(4096);
+          return WORKER_INSERT_RESULT_QUEUED;
+        }
+
       if (!mongo_sync_cmd_insert_n(self->conn, self->ns, 1,
                                    (const bson **)&self->bson))
         {
@@ -525,6 +553,37 @@ afmongodb_worker_insert (LogThrDestDriver *s, LogMessage *msg)
   return WORKER_INSERT_RESULT_SUCCESS;
 }
 
+static worker_insert_result_t
+afmongodb_worker_flush(LogThrDestDriver *s)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)s;
+  gboolean success;
+
+  success = mongo_sync_cmd_insert_n(self->conn, self->ns,
+                                    self->batch_bsons->len,
+                                    (const bson **) self->batch_bsons->pdata);
+  if (!success)
+    msg_error("Network error while bulk inserting into MongoDB",
+              evt_tag_int("num_of_messages", self->batch_bsons->len),
+              evt_tag_int("time_reopen", self->super.time_reopen),
+              evt_tag_str("reason", mongo_sync_conn_get_last_error(self->conn)),
+              evt_tag_str("driver", self->super.super.super.id),
+              NULL);
+  else
+    msg_debug("Bulk insert into MongoDB succeeded",
+              evt_tag_int("num_of_messages", self->batch_bsons->len),
+              evt_tag_str("driver", self->super.super.super.id),
+              NULL);
+
+  /* the documents are rebuilt from the rewound messages on failure */
+  afmongodb_worker_drop_batch(self);
+
+  if (!success)
+    return WORKER_INSERT_RESULT_ERROR;
+
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
 static void
 afmongodb_worker_thread_init(LogThrDestDriver *d)
 {
@@ -537,6 +596,7 @@ afmongodb_worker_thread_init(LogThrDestDriver *d)
   self->current_value = g_string_sized_new(256);
 
   self->bson = bson_new_sized(4096);
+  self->batch_bsons = g_ptr_array_new();
 }
 
 static void
@@ -548,6 +608,8 @@ afmongodb_worker_thread_deinit(LogThrDestDriver *d)
   g_string_free (self->current_value, TRUE);
 
   bson_free (self->bson);
+  afmongodb_worker_drop_batch(self);
+  g_ptr_array_free(self->batch_bsons, TRUE);
 }
 
 /*
@@ -723,6 +785,7 @@ afmongodb_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_deinit = afmongodb_worker_thread_deinit;
   self->super.worker.disconnect = afmongodb_dd_disconnect;
   self->super.worker.insert = afmongodb_worker_insert;
+  self->super.worker.flush = afmongodb_worker_flush;
   self->super.format.stats_instance = afmongodb_dd_format_stats_instance;
   self->super.format.persist_name = afmongodb_dd_format_persist_name;
   self->super.stats_source = SCS_MONGODB;
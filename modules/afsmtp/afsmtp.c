@@ -66,6 +66,13 @@ typedef struct
   /* Writer-only stuff */
   GString *str;
   LogTemplateOptions template_options;
+
+  /* messages accumulated for a batched session when pipeline() >= 2 */
+  smtp_session_t batch_session;
+  GPtrArray *batch_messages;
+  /* message bodies are not copied by libesmtp, keep them alive until the
+   * session is sent */
+  GPtrArray *batch_bodies;
 } AFSMTPDriver;
 
 typedef struct
@@ -395,6 +402,7 @@ static smtp_message_t
 __build_message(AFSMTPDriver *self, LogMessage *msg, smtp_session_t session)
 {
   smtp_message_t message;
+  gchar *body;
   gpointer args[] = { self, NULL, NULL };
 
   message = smtp_add_message(session);
@@ -431,10 +439,22 @@ __build_message(AFSMTPDriver *self, LogMessage *msg, smtp_session_t session)
   log_template_append_format(self->body_template, msg, &self->template_options,
                              LTZ_SEND, self->super.seq_num,
                              NULL, self->str);
-  smtp_set_message_str(message, self->str->str);
+  body = g_strdup(self->str->str);
+  g_ptr_array_add(self->batch_bodies, body);
+  smtp_set_message_str(message, body);
   return message;
 }
 
+static void
+__free_batch_bodies(AFSMTPDriver *self)
+{
+  gint i;
+
+  for (i = 0; i < self->batch_bodies->len; i++)
+    g_free(g_ptr_array_index(self->batch_bodies, i));
+  g_ptr_array_set_size(self->batch_bodies, 0);
+}
+
 static gboolean
 __check_transfer_status(AFSMTPDriver *self, smtp_message_t message)
 {
@@ -515,6 +535,17 @@ afsmtp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
       return WORKER_INSERT_RESULT_SUCCESS;
     }
 
+  if (self->super.pipeline_depth >= 2)
+    {
+      /* accumulate messages into a shared session and submit them with a
+       * single SMTP connection from the flush */
+      if (!self->batch_session)
+        self->batch_session = __build_session(self, msg);
+      message = __build_message(self, msg, self->batch_session);
+      g_ptr_array_add(self->batch_messages, message);
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
   session = __build_session(self, msg);
   message = __build_message(self, msg, session);
 
@@ -522,6 +553,7 @@ afsmtp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
   success = message_sent && __check_transfer_status(self, message);
 
   smtp_destroy_session(session);
+  __free_batch_bodies(self);
 
   if (!success)
     {
@@ -534,12 +566,36 @@ afsmtp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
   return WORKER_INSERT_RESULT_SUCCESS;
 }
 
+static worker_insert_result_t
+afsmtp_worker_flush(LogThrDestDriver *s)
+{
+  AFSMTPDriver *self = (AFSMTPDriver *)s;
+  gboolean success;
+  gint i;
+
+  if (!self->batch_session)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  success = __send_message(self, self->batch_session);
+  for (i = 0; success && i < self->batch_messages->len; i++)
+    success = __check_transfer_status(self, (smtp_message_t) g_ptr_array_index(self->batch_messages, i));
+
+  smtp_destroy_session(self->batch_session);
+  self->batch_session = NULL;
+  g_ptr_array_set_size(self->batch_messages, 0);
+  __free_batch_bodies(self);
+
+  return success ? WORKER_INSERT_RESULT_SUCCESS : WORKER_INSERT_RESULT_ERROR;
+}
+
 static void
 afsmtp_worker_thread_init(LogThrDestDriver *d)
 {
   AFSMTPDriver *self = (AFSMTPDriver *)d;
 
   self->str = g_string_sized_new(1024);
+  self->batch_messages = g_ptr_array_new();
+  self->batch_bodies = g_ptr_array_new();
 
   ignore_sigpipe();
 }
@@ -549,6 +605,14 @@ afsmtp_worker_thread_deinit(LogThrDestDriver *d)
 {
   AFSMTPDriver *self = (AFSMTPDriver *)d;
 
+  if (self->batch_session)
+    {
+      smtp_destroy_session(self->batch_session);
+      self->batch_session = NULL;
+    }
+  __free_batch_bodies(self);
+  g_ptr_array_free(self->batch_messages, TRUE);
+  g_ptr_array_free(self->batch_bodies, TRUE);
   g_string_free(self->str, TRUE);
 }
 
@@ -692,6 +756,7 @@ afsmtp_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_init = afsmtp_worker_thread_init;
   self->super.worker.thread_deinit = afsmtp_worker_thread_deinit;
   self->super.worker.insert = afsmtp_worker_insert;
+  self->super.worker.flush = afsmtp_worker_flush;
 
   self->super.format.stats_instance = afsmtp_dd_format_stats_instance;
   self->super.format.persist_name = afsmtp_dd_format_persist_name;
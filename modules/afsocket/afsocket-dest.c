@@ -133,6 +133,16 @@ afsocket_dd_start_watches(AFSocketDestDriver *self)
   iv_fd_register(&self->connect_fd);
 }
 
+static void
+afsocket_dd_release_reconnect_slot(AFSocketDestDriver *self)
+{
+  if (self->reconnect_slot_held)
+    {
+      self->reconnect_slot_held = FALSE;
+      log_driver_reconnect_slot_release();
+    }
+}
+
 static void
 afsocket_dd_stop_watches(AFSocketDestDriver *self)
 {
@@ -150,10 +160,11 @@ afsocket_dd_stop_watches(AFSocketDestDriver *self)
     }
   if (iv_timer_registered(&self->reconnect_timer))
     iv_timer_unregister(&self->reconnect_timer);
+  afsocket_dd_release_reconnect_slot(self);
 }
 
 static void
-afsocket_dd_start_reconnect_timer(AFSocketDestDriver *self)
+afsocket_dd_arm_reconnect_timer(AFSocketDestDriver *self, glong delay_msec)
 {
   main_loop_assert_main_thread();
 
@@ -162,10 +173,16 @@ afsocket_dd_start_reconnect_timer(AFSocketDestDriver *self)
   iv_validate_now();
 
   self->reconnect_timer.expires = iv_now;
-  timespec_add_msec(&self->reconnect_timer.expires, self->time_reopen * 1000);
+  timespec_add_msec(&self->reconnect_timer.expires, delay_msec);
   iv_timer_register(&self->reconnect_timer);
 }
 
+static void
+afsocket_dd_start_reconnect_timer(AFSocketDestDriver *self)
+{
+  afsocket_dd_arm_reconnect_timer(self, log_driver_reconnect_next_delay_msec(&self->reconnect, self->time_reopen));
+}
+
 static LogTransport *
 afsocket_dd_construct_transport(AFSocketDestDriver *self, gint fd)
 {
@@ -222,10 +239,13 @@ afsocket_dd_connected(AFSocketDestDriver *self)
   proto = log_proto_client_factory_construct(self->proto_factory, transport, &self->writer_options.proto_options.super);
 
   log_writer_reopen(self->writer, proto);
+  afsocket_dd_release_reconnect_slot(self);
+  log_driver_reconnect_reset(&self->reconnect);
   return TRUE;
  error_reconnect:
   close(self->fd);
   self->fd = -1;
+  afsocket_dd_release_reconnect_slot(self);
   afsocket_dd_start_reconnect_timer(self);
   return FALSE;
 }
@@ -280,12 +300,25 @@ afsocket_dd_start_connect(AFSocketDestDriver *self)
 static void
 afsocket_dd_reconnect(AFSocketDestDriver *self)
 {
+  if (!self->reconnect_slot_held)
+    {
+      if (!log_driver_reconnect_slot_acquire())
+        {
+          /* too many drivers are reconnecting right now, check back for
+           * a free slot shortly so the destination is not stampeded */
+          afsocket_dd_arm_reconnect_timer(self, log_driver_reconnect_slot_retry_msec());
+          return;
+        }
+      self->reconnect_slot_held = TRUE;
+    }
+
   if (!afsocket_dd_setup_addresses(self) ||
       !afsocket_dd_start_connect(self))
     {
       msg_error("Initiating connection failed, reconnecting",
                 evt_tag_int("time_reopen", self->time_reopen),
                 NULL);
+      afsocket_dd_release_reconnect_slot(self);
       afsocket_dd_start_reconnect_timer(self);
     }
 }
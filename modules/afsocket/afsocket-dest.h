@@ -49,6 +49,10 @@ struct _AFSocketDestDriver
   GSockAddr *dest_addr;
   gint time_reopen;
   gboolean connection_initialized;
+  /* adaptive retry delay for reconnect_timer plus whether this driver
+   * holds one of the global reconnect slots (see driver.h) */
+  LogDriverReconnect reconnect;
+  gboolean reconnect_slot_held;
   struct iv_fd connect_fd;
   struct iv_timer reconnect_timer;
   SocketOptions *socket_options;
@@ -62,8 +62,10 @@ static CfgLexerKeyword afsocket_keywords[] = {
   { "ip_tos",             KW_IP_TOS },
   { "so_broadcast",       KW_SO_BROADCAST },
   { "so_rcvbuf",          KW_SO_RCVBUF },
+  { "so_rcvbuf_max",      KW_SO_RCVBUF_MAX },
   { "so_sndbuf",          KW_SO_SNDBUF },
   { "so_keepalive",       KW_SO_KEEPALIVE },
+  { "so_reuseport",       KW_SO_REUSEPORT },
   { "tcp_keep_alive",     KW_SO_KEEPALIVE }, /* old, once deprecated form, but revived in 3.4 */
   { "tcp_keepalive",      KW_SO_KEEPALIVE }, /* alias for so-keepalive, as tcp is the only option actually using it */
   { "tcp_keepalive_time", KW_TCP_KEEPALIVE_TIME },
@@ -74,6 +76,7 @@ static CfgLexerKeyword afsocket_keywords[] = {
   { "ip_protocol",        KW_IP_PROTOCOL },
   { "max_connections",    KW_MAX_CONNECTIONS },
   { "keep_alive",         KW_KEEP_ALIVE },
+  { "pid_from_credentials", KW_PID_FROM_CREDENTIALS },
   { "systemd_syslog",     KW_SYSTEMD_SYSLOG  },
   { NULL }
 };
@@ -28,10 +28,13 @@
 #include "stats/stats-registry.h"
 #include "mainloop.h"
 #include "poll-fd-events.h"
+#include "control/control.h"
 
 #include <string.h>
+#include <stdio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #if SYSLOG_NG_ENABLE_TCP_WRAPPER
 #include <tcpd.h>
@@ -407,6 +410,163 @@ afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnectio
   self->num_connections--;
 }
 
+/* sampling period of the UDP receive buffer feedback loop, in seconds */
+#define RCVBUF_TUNING_PERIOD 10
+
+/*
+ * Look up the kernel side drop counter and receive queue backlog of a
+ * bound UDP socket in /proc/net/udp{,6}, matching the socket on its
+ * inode number.  Returns FALSE when the socket cannot be found, e.g. on
+ * platforms without these proc files.
+ */
+static gboolean
+afsocket_sd_get_udp_sock_info(gint fd, gint family, guint64 *rx_queue, guint64 *drops)
+{
+  struct stat st;
+  FILE *f;
+  gchar line[512];
+  gboolean found = FALSE;
+
+  if (fstat(fd, &st) < 0)
+    return FALSE;
+  f = fopen(family == AF_INET6 ? "/proc/net/udp6" : "/proc/net/udp", "r");
+  if (!f)
+    return FALSE;
+
+  /* skip the header line */
+  if (fgets(line, sizeof(line), f))
+    {
+      while (fgets(line, sizeof(line), f))
+        {
+          guint64 inode, rxq, drp;
+
+          if (sscanf(line,
+                     "%*u: %*[0-9A-Fa-f]:%*x %*[0-9A-Fa-f]:%*x %*x "
+                     "%*x:%" G_GINT64_MODIFIER "x %*x:%*x %*x %*u %*u "
+                     "%" G_GINT64_MODIFIER "u %*u %*[0-9a-fA-F] "
+                     "%" G_GINT64_MODIFIER "u",
+                     &rxq, &inode, &drp) != 3)
+            continue;
+          if (inode == (guint64) st.st_ino)
+            {
+              *rx_queue = rxq;
+              *drops = drp;
+              found = TRUE;
+              break;
+            }
+        }
+    }
+  fclose(f);
+  return found;
+}
+
+/*
+ * Feedback loop for UDP sources: sample the kernel drop counter and the
+ * receive queue backlog of the bound socket periodically, export the
+ * drop deltas next to the processed counters of the source and grow
+ * SO_RCVBUF whenever the kernel dropped datagrams or the queue trends
+ * full since the last sample, up to the so-rcvbuf-max() cap.
+ */
+static void
+afsocket_sd_tune_rcvbuf(gpointer s)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+  guint64 rx_queue = 0, drops = 0;
+  gchar buf[MAX_SOCKADDR_STRING];
+
+  if (afsocket_sd_get_udp_sock_info(self->tuned_sock, self->bind_addr->sa.sa_family, &rx_queue, &drops))
+    {
+      guint64 drop_delta = self->kernel_drops_valid ? drops - self->last_kernel_drops : 0;
+      gint rcvbuf = 0;
+      socklen_t len = sizeof(rcvbuf);
+
+      self->last_kernel_drops = drops;
+      self->kernel_drops_valid = TRUE;
+      if (drop_delta)
+        stats_counter_add(self->kernel_drops, drop_delta);
+
+      if (self->socket_options->so_rcvbuf_max > 0 &&
+          getsockopt(self->tuned_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &len) >= 0 &&
+          rcvbuf < self->socket_options->so_rcvbuf_max &&
+          (drop_delta > 0 || rx_queue >= (guint64) rcvbuf - (guint64) rcvbuf / 4))
+        {
+          gint target = MIN(rcvbuf * 2, self->socket_options->so_rcvbuf_max);
+
+          if (setsockopt(self->tuned_sock, SOL_SOCKET, SO_RCVBUF, &target, sizeof(target)) < 0)
+            msg_error("Error growing the receive buffer of the UDP socket",
+                      evt_tag_str("local", g_sockaddr_format(self->bind_addr, buf, sizeof(buf), GSA_FULL)),
+                      evt_tag_int("so_rcvbuf", target),
+                      evt_tag_errno(EVT_TAG_OSERROR, errno),
+                      NULL);
+          else
+            msg_notice("Growing the receive buffer of the UDP socket, the kernel dropped datagrams since the last sample",
+                       evt_tag_str("local", g_sockaddr_format(self->bind_addr, buf, sizeof(buf), GSA_FULL)),
+                       evt_tag_int("so_rcvbuf", target),
+                       evt_tag_int("so_rcvbuf_max", self->socket_options->so_rcvbuf_max),
+                       evt_tag_long("kernel_drops", drop_delta),
+                       NULL);
+        }
+    }
+
+  iv_validate_now();
+  self->rcvbuf_tuning_timer.expires = iv_now;
+  self->rcvbuf_tuning_timer.expires.tv_sec += RCVBUF_TUNING_PERIOD;
+  iv_timer_register(&self->rcvbuf_tuning_timer);
+}
+
+static gchar *
+afsocket_sd_rcvbuf_stats_instance(AFSocketSourceDriver *self)
+{
+  static gchar buf[256];
+
+  g_sockaddr_format(self->bind_addr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+  return buf;
+}
+
+static void
+afsocket_sd_start_rcvbuf_tuning(AFSocketSourceDriver *self)
+{
+  if (self->transport_mapper->sock_type != SOCK_DGRAM ||
+      !self->bind_addr ||
+      (self->bind_addr->sa.sa_family != AF_INET
+#if SYSLOG_NG_ENABLE_IPV6
+       && self->bind_addr->sa.sa_family != AF_INET6
+#endif
+      ))
+    return;
+  if (!self->connections)
+    return;
+
+  self->tuned_sock = ((AFSocketSourceConnection *) self->connections->data)->sock;
+  self->kernel_drops_valid = FALSE;
+
+  stats_lock();
+  stats_register_counter(0, self->transport_mapper->stats_source | SCS_SOURCE,
+                         self->super.super.id, afsocket_sd_rcvbuf_stats_instance(self),
+                         SC_TYPE_DROPPED, &self->kernel_drops);
+  stats_unlock();
+
+  iv_validate_now();
+  self->rcvbuf_tuning_timer.expires = iv_now;
+  self->rcvbuf_tuning_timer.expires.tv_sec += RCVBUF_TUNING_PERIOD;
+  iv_timer_register(&self->rcvbuf_tuning_timer);
+}
+
+static void
+afsocket_sd_stop_rcvbuf_tuning(AFSocketSourceDriver *self)
+{
+  if (iv_timer_registered(&self->rcvbuf_tuning_timer))
+    iv_timer_unregister(&self->rcvbuf_tuning_timer);
+  if (self->kernel_drops)
+    {
+      stats_lock();
+      stats_unregister_counter(self->transport_mapper->stats_source | SCS_SOURCE,
+                               self->super.super.id, afsocket_sd_rcvbuf_stats_instance(self),
+                               SC_TYPE_DROPPED, &self->kernel_drops);
+      stats_unlock();
+    }
+}
+
 static void
 afsocket_sd_start_watches(AFSocketSourceDriver *self)
 {
@@ -439,12 +599,23 @@ afsocket_sd_setup_reader_options(AFSocketSourceDriver *self)
       self->reader_options.super.init_window_size /= self->max_connections;
       if (self->reader_options.super.init_window_size < 100)
         {
-          msg_warning("WARNING: window sizing for tcp sources were changed in " VERSION_3_3 ", the configuration value was divided by the value of max-connections(). The result was too small, clamping to 100 entries. Ensure you have a proper log_fifo_size setting to avoid message loss.",
-                      evt_tag_int("orig_log_iw_size", self->reader_options.super.init_window_size),
-                      evt_tag_int("new_log_iw_size", 100),
-                      evt_tag_int("min_log_fifo_size", 100 * self->max_connections),
+          /* instead of pinning the clamped 100 entries on every (mostly
+           * idle) connection, guarantee a small per-connection base and
+           * let the rest of the clamped window float in a shared
+           * spillover pool that busy connections borrow from, so a peer
+           * exhausting its share suspends alone without gating the
+           * others; an explicit dynamic-window-size() overrides the
+           * computed pool */
+          gint base = MAX(self->reader_options.super.init_window_size, 10);
+
+          if (self->reader_options.super.dynamic_window_size == 0)
+            self->reader_options.super.dynamic_window_size = (100 - base) * self->max_connections;
+          self->reader_options.super.init_window_size = base;
+          msg_warning("WARNING: window sizing for tcp sources were changed in " VERSION_3_3 ", the configuration value was divided by the value of max-connections(). The result was too small and was split into a guaranteed per-connection window and a shared spillover pool. Ensure you have a proper log_fifo_size setting to avoid message loss.",
+                      evt_tag_int("base_window_size", base),
+                      evt_tag_int("dynamic_window_size", self->reader_options.super.dynamic_window_size),
+                      evt_tag_int("min_log_fifo_size", base * self->max_connections + self->reader_options.super.dynamic_window_size),
                       NULL);
-          self->reader_options.super.init_window_size = 100;
         }
       self->window_size_initialized = TRUE;
     }
@@ -522,6 +693,14 @@ afsocket_sd_open_listener(AFSocketSourceDriver *self)
           sock = GPOINTER_TO_UINT(cfg_persist_config_fetch(cfg, afsocket_sd_format_persist_name(self, TRUE))) - 1;
         }
 
+      if (sock == -1)
+        {
+          /* a listener handed over by a predecessor process through the
+           * control socket (--handover), registered under the same name
+           * the reload-persist entry would use */
+          sock = control_lookup_handover_fd(afsocket_sd_format_persist_name(self, TRUE));
+        }
+
       if (sock == -1)
         {
           if (!afsocket_sd_acquire_socket(self, &sock))
@@ -542,6 +721,9 @@ afsocket_sd_open_listener(AFSocketSourceDriver *self)
 
       self->fd = sock;
       afsocket_sd_start_watches(self);
+      /* offer the live listener to a successor process over the control
+       * socket; SCM_RIGHTS dups the fd, so we keep serving it ourselves */
+      control_register_handover_fd(afsocket_sd_format_persist_name(self, TRUE), self->fd);
       res = TRUE;
     }
   else
@@ -602,6 +784,7 @@ afsocket_sd_save_listener(AFSocketSourceDriver *self)
   if (self->transport_mapper->sock_type == SOCK_STREAM)
     {
       afsocket_sd_stop_watches(self);
+      control_unregister_handover_fd(afsocket_sd_format_persist_name(self, TRUE));
       if (!self->connections_kept_alive_accross_reloads)
         {
           msg_verbose("Closing listener fd",
@@ -631,11 +814,15 @@ afsocket_sd_init_method(LogPipe *s)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
 
-  return log_src_driver_init_method(s) &&
-         afsocket_sd_setup_transport(self) &&
-         afsocket_sd_setup_addresses(self) &&
-         afsocket_sd_restore_kept_alive_connections(self) &&
-         afsocket_sd_open_listener(self);
+  if (!(log_src_driver_init_method(s) &&
+        afsocket_sd_setup_transport(self) &&
+        afsocket_sd_setup_addresses(self) &&
+        afsocket_sd_restore_kept_alive_connections(self) &&
+        afsocket_sd_open_listener(self)))
+    return FALSE;
+
+  afsocket_sd_start_rcvbuf_tuning(self);
+  return TRUE;
 }
 
 gboolean
@@ -643,6 +830,7 @@ afsocket_sd_deinit_method(LogPipe *s)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
 
+  afsocket_sd_stop_rcvbuf_tuning(self);
   afsocket_sd_save_connections(self);
   afsocket_sd_save_listener(self);
 
@@ -694,6 +882,9 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->max_connections = 10;
   self->listen_backlog = 255;
   self->connections_kept_alive_accross_reloads = TRUE;
+  IV_TIMER_INIT(&self->rcvbuf_tuning_timer);
+  self->rcvbuf_tuning_timer.cookie = self;
+  self->rcvbuf_tuning_timer.handler = afsocket_sd_tune_rcvbuf;
   log_reader_options_defaults(&self->reader_options);
 
   /* NOTE: this changes the initial window size from 100 to 1000. Reasons:
@@ -55,6 +55,14 @@ struct _AFSocketSourceDriver
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
 
+  /* receive buffer feedback loop state of UDP sources, see
+   * afsocket_sd_tune_rcvbuf() */
+  struct iv_timer rcvbuf_tuning_timer;
+  gint tuned_sock;
+  guint64 last_kernel_drops;
+  gboolean kernel_drops_valid;
+  StatsCounterItem *kernel_drops;
+
   /*
    * Apply transport options, set up bind_addr based on the
    * information processed during parse time. This used to be
@@ -138,6 +138,12 @@ afunix_sd_set_pass_unix_credentials(AFUnixSourceDriver *self, gboolean pass)
   transport_mapper_unix_set_pass_unix_credentials(self->super.transport_mapper, pass);
 }
 
+void
+afunix_sd_set_pid_from_credentials(AFUnixSourceDriver *self, gboolean enable)
+{
+  transport_mapper_unix_set_pid_from_credentials(self->super.transport_mapper, enable);
+}
+
 void
 afunix_sd_set_create_dirs(AFUnixSourceDriver *self, gboolean create_dirs)
 {
@@ -40,6 +40,7 @@ typedef struct _AFUnixSourceDriver
 AFUnixSourceDriver *afunix_sd_new_stream(gchar *filename, GlobalConfig *cfg);
 AFUnixSourceDriver *afunix_sd_new_dgram(gchar *filename, GlobalConfig *cfg);
 void afunix_sd_set_pass_unix_credentials(AFUnixSourceDriver *self, gboolean pass);
+void afunix_sd_set_pid_from_credentials(AFUnixSourceDriver *self, gboolean enable);
 void afunix_sd_set_create_dirs(AFUnixSourceDriver *self, gboolean create_dirs);
 
 #endif
@@ -137,6 +137,34 @@ socket_options_inet_setup_socket(SocketOptions *s, gint fd, GSockAddr *addr, AFS
   return TRUE;
 }
 
+static gboolean
+socket_options_inet_setup_pre_bind(SocketOptions *s, gint fd, AFSocketDirection dir)
+{
+  SocketOptionsInet *self = (SocketOptionsInet *) s;
+
+  if (!socket_options_setup_pre_bind_method(s, fd, dir))
+    return FALSE;
+
+  if (self->so_reuseport)
+    {
+#ifdef SO_REUSEPORT
+      gint on = 1;
+
+      if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+        {
+          msg_error("The kernel refused our SO_REUSEPORT setsockopt() request, so-reuseport() requires kernel support (Linux 3.9 or later)",
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+          return FALSE;
+        }
+#else
+      msg_error("so-reuseport() is set but no SO_REUSEPORT setsockopt on this platform", NULL);
+      return FALSE;
+#endif
+    }
+  return TRUE;
+}
+
 SocketOptionsInet *
 socket_options_inet_new_instance(void)
 {
@@ -144,6 +172,7 @@ socket_options_inet_new_instance(void)
 
   socket_options_init_instance(&self->super);
   self->super.setup_socket = socket_options_inet_setup_socket;
+  self->super.setup_pre_bind = socket_options_inet_setup_pre_bind;
   self->super.so_keepalive = TRUE;
 #if defined(TCP_KEEPTIME) && defined(TCP_KEEPIDLE) && defined(TCP_KEEPCNT)
   self->tcp_keepalive_time = 60;
@@ -78,10 +78,17 @@ socket_options_setup_socket_method(SocketOptions *self, gint fd, GSockAddr *bind
   return TRUE;
 }
 
+gboolean
+socket_options_setup_pre_bind_method(SocketOptions *self, gint fd, AFSocketDirection dir)
+{
+  return TRUE;
+}
+
 void
 socket_options_init_instance(SocketOptions *self)
 {
   self->setup_socket = socket_options_setup_socket_method;
+  self->setup_pre_bind = socket_options_setup_pre_bind_method;
   self->free = g_free;
 }
 
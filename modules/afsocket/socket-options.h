@@ -38,13 +38,19 @@ struct _SocketOptions
   /* socket options */
   gint so_sndbuf;
   gint so_rcvbuf;
+  /* upper bound for the receive buffer feedback loop of UDP sources, 0
+   * disables auto-growing, see afsocket_sd_tune_rcvbuf() */
+  gint so_rcvbuf_max;
   gint so_broadcast;
   gint so_keepalive;
   gboolean (*setup_socket)(SocketOptions *s, gint sock, GSockAddr *bind_addr, AFSocketDirection dir);
+  /* options that must be applied before bind() (e.g. SO_REUSEPORT) */
+  gboolean (*setup_pre_bind)(SocketOptions *s, gint sock, AFSocketDirection dir);
   void (*free)(gpointer s);
 };
 
 gboolean socket_options_setup_socket_method(SocketOptions *self, gint fd, GSockAddr *bind_addr, AFSocketDirection dir);
+gboolean socket_options_setup_pre_bind_method(SocketOptions *self, gint fd, AFSocketDirection dir);
 void socket_options_init_instance(SocketOptions *self);
 SocketOptions *socket_options_new(void);
 
@@ -54,6 +60,12 @@ socket_options_setup_socket(SocketOptions *s, gint sock, GSockAddr *bind_addr, A
   return s->setup_socket(s, sock, bind_addr, dir);
 }
 
+static inline gboolean
+socket_options_setup_pre_bind(SocketOptions *s, gint sock, AFSocketDirection dir)
+{
+  return s->setup_pre_bind(s, sock, dir);
+}
+
 static inline void
 socket_options_free(SocketOptions *s)
 {
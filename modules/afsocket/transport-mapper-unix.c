@@ -35,15 +35,18 @@ struct _TransportMapperUnix
   TransportMapper super;
   gchar *filename;
   gboolean pass_unix_credentials;
+  gboolean pid_from_credentials;
 };
 
 static LogTransport*
 _create_log_transport(TransportMapper *s, gint fd)
 {
+  TransportMapperUnix *self = (TransportMapperUnix*) s;
+
   if (s->sock_type == SOCK_DGRAM)
-    return log_transport_unix_dgram_socket_new(fd);
+    return log_transport_unix_dgram_socket_new(fd, self->pid_from_credentials);
   else
-    return log_transport_unix_stream_socket_new(fd);
+    return log_transport_unix_stream_socket_new(fd, self->pid_from_credentials);
 }
 
 static LogTransport *
@@ -52,7 +55,7 @@ _construct_log_transport(TransportMapper *s, gint fd)
   TransportMapperUnix *self = (TransportMapperUnix*) s;
   LogTransport *transport = _create_log_transport(s, fd);
 
-  if (self->pass_unix_credentials)
+  if (self->pass_unix_credentials || self->pid_from_credentials)
     socket_set_pass_credentials(fd);
 
   return transport;
@@ -77,6 +80,13 @@ transport_mapper_unix_set_pass_unix_credentials(TransportMapper *s, gboolean pas
   self->pass_unix_credentials = pass;
 }
 
+void
+transport_mapper_unix_set_pid_from_credentials(TransportMapper *s, gboolean enable)
+{
+  TransportMapperUnix *self = (TransportMapperUnix*) s;
+  self->pid_from_credentials = enable;
+}
+
 TransportMapper *
 transport_mapper_unix_dgram_new(void)
 {
@@ -30,5 +30,6 @@ typedef struct _TransportMapperUnix TransportMapperUnix;
 TransportMapper *transport_mapper_unix_dgram_new(void);
 TransportMapper *transport_mapper_unix_stream_new(void);
 void transport_mapper_unix_set_pass_unix_credentials(TransportMapper *self, gboolean pass);
+void transport_mapper_unix_set_pid_from_credentials(TransportMapper *self, gboolean enable);
 
 #endif
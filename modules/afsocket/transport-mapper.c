@@ -66,6 +66,9 @@ transport_mapper_open_socket(TransportMapper *self,
   g_fd_set_nonblock(sock, TRUE);
   g_fd_set_cloexec(sock, TRUE);
 
+  if (!socket_options_setup_pre_bind(socket_options, sock, dir))
+    goto error_close;
+
   if (!transport_mapper_privileged_bind(sock, bind_addr))
     {
       gchar buf[256];
@@ -26,12 +26,19 @@
 #include "scratch-buffers.h"
 #include "str-format.h"
 #include "unix-credentials.h"
+#include "logmsg.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 
+typedef struct _LogTransportUnixSocket
+{
+  LogTransportSocket super;
+  gboolean pid_from_credentials;
+} LogTransportUnixSocket;
+
 static void
 _add_nv_pair_int(LogTransportAuxData *aux, const gchar *name, gint value)
 {
@@ -150,6 +157,43 @@ _add_nv_pair_proc_readlink(LogTransportAuxData *aux, const gchar *name, pid_t pi
 }
 
 #if defined (CRED_PASS_SUPPORTED)
+
+/* Value names only enter the registry when something looks them up by
+ * name, which a configuration referencing them does at compile time
+ * (templates, filters and rewrite rules all resolve their value names to
+ * handles then).  As long as a name was never asked for, collecting the
+ * corresponding aux value is pure overhead that every datagram on
+ * /dev/log would pay, most painfully the procfs lookups below which cost
+ * four open/read/close rounds apiece.  The lookup here never allocates a
+ * handle, so our own checks don't make the names appear referenced.
+ *
+ * Once a name is found the result is latched: handles are never
+ * unregistered.  Until then we pay a few hash lookups per datagram,
+ * which is noise compared to recvmsg(). */
+static gboolean
+_any_aux_value_name_referenced(const gchar **names, gint num_names, gboolean *latch)
+{
+  gint i;
+
+  if (*latch)
+    return TRUE;
+  for (i = 0; i < num_names; i++)
+    {
+      if (nv_registry_get_handle(logmsg_registry, names[i]))
+        {
+          *latch = TRUE;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+static const gchar *cred_aux_value_names[] = { ".unix.pid", ".unix.uid", ".unix.gid" };
+static gboolean cred_aux_values_referenced = FALSE;
+
+static const gchar *procfs_aux_value_names[] = { ".unix.cmdline", ".unix.exe", ".audit.auid", ".audit.ses" };
+static gboolean procfs_aux_values_referenced = FALSE;
+
 static void
 _feed_aux_from_ucred(LogTransportAuxData *aux, cred_t *uc)
 {
@@ -181,19 +225,39 @@ _feed_aux_from_procfs(LogTransportAuxData *aux, pid_t pid)
 #endif
 
 static void
-_feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg, gboolean pid_from_credentials)
 {
 #if defined(CRED_PASS_SUPPORTED)
   struct cmsghdr *cmsg;
-
-  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) 
+  gboolean want_cred, want_procfs;
+
+  want_cred = _any_aux_value_name_referenced(cred_aux_value_names,
+                                             G_N_ELEMENTS(cred_aux_value_names),
+                                             &cred_aux_values_referenced);
+  want_procfs = _any_aux_value_name_referenced(procfs_aux_value_names,
+                                               G_N_ELEMENTS(procfs_aux_value_names),
+                                               &procfs_aux_values_referenced);
+  if (!want_cred && !want_procfs && !pid_from_credentials)
+    return;
+
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
     {
       if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS)
         {
           cred_t *uc = (cred_t *) CMSG_DATA(cmsg);
 
-          _feed_aux_from_procfs(aux, cred_get(uc, pid));
-          _feed_aux_from_ucred(aux, uc);
+          if (want_procfs)
+            _feed_aux_from_procfs(aux, cred_get(uc, pid));
+          if (want_cred)
+            _feed_aux_from_ucred(aux, uc);
+
+          /* with pid-from-credentials() the kernel supplied PID goes
+           * straight into $PID, overriding whatever the sender put into
+           * the message header, without requiring a rewrite rule (and a
+           * reference to ${.unix.pid}, which would turn on the
+           * collection of all three cred values above) */
+          if (pid_from_credentials)
+            _add_nv_pair_int(aux, "PID", cred_get(uc, pid));
           break;
         }
     }
@@ -201,13 +265,13 @@ _feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
 }
 
 static void
-_feed_aux_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_aux_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg, gboolean pid_from_credentials)
 {
-  _feed_credentials_from_cmsg(aux, msg);
+  _feed_credentials_from_cmsg(aux, msg, pid_from_credentials);
 }
 
 static gssize
-_unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+_unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux, gboolean pid_from_credentials)
 {
   gint rc;
   struct msghdr msg;
@@ -237,8 +301,8 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
     {
       if (msg.msg_namelen && aux)
         log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) &ss, msg.msg_namelen));
-        
-      _feed_aux_from_cmsg(aux, &msg);
+
+      _feed_aux_from_cmsg(aux, &msg, pid_from_credentials);
     }
 
   return rc;
@@ -247,9 +311,10 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 static gssize
 log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
+  LogTransportUnixSocket *self = (LogTransportUnixSocket *) s;
   gint rc;
 
-  rc = _unix_socket_read(s->fd, buf, buflen, aux);
+  rc = _unix_socket_read(s->fd, buf, buflen, aux, self->pid_from_credentials);
   if (rc == 0)
     {
       /* DGRAM sockets should never return EOF, they just need to be read again */
@@ -260,29 +325,33 @@ log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize
 }
 
 LogTransport *
-log_transport_unix_dgram_socket_new(gint fd)
+log_transport_unix_dgram_socket_new(gint fd, gboolean pid_from_credentials)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnixSocket *self = g_new0(LogTransportUnixSocket, 1);
 
-  log_transport_dgram_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_dgram_socket_read_method;
+  log_transport_dgram_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_unix_dgram_socket_read_method;
+  self->pid_from_credentials = pid_from_credentials;
 
-  return &self->super;
+  return &self->super.super;
 }
 
 static gssize
 log_transport_unix_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
-  return _unix_socket_read(s->fd, buf, buflen, aux);
+  LogTransportUnixSocket *self = (LogTransportUnixSocket *) s;
+
+  return _unix_socket_read(s->fd, buf, buflen, aux, self->pid_from_credentials);
 }
 
 LogTransport *
-log_transport_unix_stream_socket_new(gint fd)
+log_transport_unix_stream_socket_new(gint fd, gboolean pid_from_credentials)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnixSocket *self = g_new0(LogTransportUnixSocket, 1);
 
-  log_transport_stream_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_stream_socket_read_method;
+  log_transport_stream_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_unix_stream_socket_read_method;
+  self->pid_from_credentials = pid_from_credentials;
 
-  return &self->super;
+  return &self->super.super;
 }
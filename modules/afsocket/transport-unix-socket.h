@@ -25,8 +25,8 @@
 
 #include "transport/logtransport.h"
 
-LogTransport *log_transport_unix_dgram_socket_new(gint fd);
-LogTransport *log_transport_unix_stream_socket_new(gint fd);
+LogTransport *log_transport_unix_dgram_socket_new(gint fd, gboolean pid_from_credentials);
+LogTransport *log_transport_unix_stream_socket_new(gint fd, gboolean pid_from_credentials);
 
 
 #endif
@@ -261,6 +261,18 @@ afsql_dd_run_query(AFSqlDestDriver *self, const gchar *query, gboolean silent, d
   return TRUE;
 }
 
+/* drop our reference to the message saved while assembling a multi-row
+ * INSERT, its queue node lives on in the backlog/queue */
+static void
+afsql_dd_drop_pending_msg(AFSqlDestDriver *self)
+{
+  if (self->pending_msg)
+    {
+      log_msg_unref(self->pending_msg);
+      self->pending_msg = NULL;
+    }
+}
+
 /**
  * afsql_dd_handle_transaction_error:
  *
@@ -271,6 +283,8 @@ afsql_dd_run_query(AFSqlDestDriver *self, const gchar *query, gboolean silent, d
 static void
 afsql_dd_handle_transaction_error(AFSqlDestDriver *self)
 {
+  /* the rewind below requeues the pending message as well */
+  afsql_dd_drop_pending_msg(self);
   log_queue_rewind_backlog_all(self->queue);
   self->flush_lines_queued = 0;
 }
@@ -790,31 +804,13 @@ afsql_dd_ensure_accessible_database_table(AFSqlDestDriver *self, LogMessage *msg
   return table;
 }
 
-static GString *
-afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+static void
+afsql_dd_append_insert_row(AFSqlDestDriver *self, LogMessage *msg, GString *insert_command)
 {
-  GString *insert_command = g_string_sized_new(256);
   GString *value = g_string_sized_new(512);
   gint i, j;
 
-  g_string_printf(insert_command, "INSERT INTO %s (", table->str);
-
-  for (i = 0; i < self->fields_len; i++)
-    {
-      if ((self->fields[i].flags & AFSQL_FF_DEFAULT) == 0 && self->fields[i].value != NULL)
-        {
-           g_string_append(insert_command, self->fields[i].name);
-
-           j = i + 1;
-           while (j < self->fields_len && (self->fields[j].flags & AFSQL_FF_DEFAULT) == AFSQL_FF_DEFAULT)
-             j++;
-
-           if (j < self->fields_len)
-             g_string_append(insert_command, ", ");
-        }
-    }
-
-  g_string_append(insert_command, ") VALUES (");
+  g_string_append_c(insert_command, '(');
 
   for (i = 0; i < self->fields_len; i++)
     {
@@ -849,9 +845,36 @@ afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *t
         }
     }
 
-  g_string_append(insert_command, ")");
+  g_string_append_c(insert_command, ')');
 
   g_string_free(value, TRUE);
+}
+
+static GString *
+afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+{
+  GString *insert_command = g_string_sized_new(256);
+  gint i, j;
+
+  g_string_printf(insert_command, "INSERT INTO %s (", table->str);
+
+  for (i = 0; i < self->fields_len; i++)
+    {
+      if ((self->fields[i].flags & AFSQL_FF_DEFAULT) == 0 && self->fields[i].value != NULL)
+        {
+           g_string_append(insert_command, self->fields[i].name);
+
+           j = i + 1;
+           while (j < self->fields_len && (self->fields[j].flags & AFSQL_FF_DEFAULT) == AFSQL_FF_DEFAULT)
+             j++;
+
+           if (j < self->fields_len)
+             g_string_append(insert_command, ", ");
+        }
+    }
+
+  g_string_append(insert_command, ") VALUES ");
+  afsql_dd_append_insert_row(self, msg, insert_command);
 
   return insert_command;
 }
@@ -874,11 +897,73 @@ afsql_dd_should_commit_transaction(const AFSqlDestDriver *self)
   return afsql_dd_is_transaction_handling_enabled(self) && self->flush_lines_queued == self->flush_lines;
 }
 
+static inline gboolean
+afsql_dd_is_multi_row_insert_supported(const AFSqlDestDriver *self)
+{
+  /* Oracle, FreeTDS/MSSQL and Firebird cannot take more than one tuple in
+   * a VALUES clause */
+  return strcmp(self->type, "mysql") == 0
+      || strcmp(self->type, "pgsql") == 0
+      || strcmp(self->type, "sqlite3") == 0;
+}
+
+static inline gboolean
+afsql_dd_should_batch_inserts(const AFSqlDestDriver *self)
+{
+  /* rows are only batched inside an explicit transaction: if the batch
+   * fails, the whole transaction is rewound, so we do not lose per-row
+   * granularity.  Retries after a failure go row by row. */
+  return afsql_dd_is_transaction_handling_enabled(self)
+      && self->failed_message_counter == 0
+      && afsql_dd_is_multi_row_insert_supported(self);
+}
+
+/**
+ * afsql_dd_extend_insert_batch:
+ *
+ * Append further rows destined to the same table to an INSERT statement,
+ * popping at most as many messages as fit into the current transaction.
+ * A message rendering a different table name is saved to pending_msg and
+ * consumed by the next insert round.
+ *
+ * NOTE: This function can only be called from the database thread.
+ **/
+static void
+afsql_dd_extend_insert_batch(AFSqlDestDriver *self, GString *table, GString *insert_command,
+                             GPtrArray *batch_msgs, GArray *batch_path_options)
+{
+  GString *msg_table = g_string_sized_new(32);
+
+  while (self->flush_lines_queued + 1 + batch_msgs->len < self->flush_lines)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(self->queue, &path_options);
+
+      if (!msg)
+        break;
+
+      log_template_format(self->table, msg, &self->template_options, LTZ_LOCAL, 0, NULL, msg_table);
+      if (strcmp(msg_table->str, table->str) != 0)
+        {
+          self->pending_msg = msg;
+          self->pending_msg_path_options = path_options;
+          break;
+        }
+
+      g_string_append(insert_command, ", ");
+      step_sequence_number(&self->seq_num);
+      afsql_dd_append_insert_row(self, msg, insert_command);
+      g_ptr_array_add(batch_msgs, msg);
+      g_array_append_val(batch_path_options, path_options);
+    }
+  g_string_free(msg_table, TRUE);
+}
+
 static inline void
-afsql_dd_rollback_msg(AFSqlDestDriver *self, LogMessage *msg, LogPathOptions *path_options)
+afsql_dd_rollback_msg(AFSqlDestDriver *self, LogMessage *msg, LogPathOptions *path_options, gint batch_size)
 {
   if (self->flags & AFSQL_DDF_EXPLICIT_COMMITS)
-    log_queue_rewind_backlog(self->queue, 1);
+    log_queue_rewind_backlog(self->queue, batch_size);
   else
     log_queue_push_head(self->queue, msg, path_options);
 }
@@ -886,13 +971,14 @@ afsql_dd_rollback_msg(AFSqlDestDriver *self, LogMessage *msg, LogPathOptions *pa
 static inline gboolean
 afsql_dd_handle_insert_row_error_depending_on_connection_availability(AFSqlDestDriver *self,
                                                                       LogMessage *msg,
-                                                                      LogPathOptions *path_options)
+                                                                      LogPathOptions *path_options,
+                                                                      gint batch_size)
 {
   const gchar *dbi_error, *error_message;
 
   if (dbi_conn_ping(self->dbi_ctx) == 1)
     {
-      afsql_dd_rollback_msg(self, msg, path_options);
+      afsql_dd_rollback_msg(self, msg, path_options, batch_size);
       return TRUE;
     }
 
@@ -905,7 +991,7 @@ afsql_dd_handle_insert_row_error_depending_on_connection_availability(AFSqlDestD
   else
     {
       error_message = "Error, no SQL connection after failed query attempt";
-      afsql_dd_rollback_msg(self, msg, path_options);
+      afsql_dd_rollback_msg(self, msg, path_options, batch_size);
     }
 
   dbi_conn_error(self->dbi_ctx, &dbi_error);
@@ -934,15 +1020,28 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
 {
   GString *table = NULL;
   GString *insert_command = NULL;
+  GPtrArray *batch_msgs = NULL;
+  GArray *batch_path_options = NULL;
   LogMessage *msg;
   gboolean success = TRUE;
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint32 batch_start_seq = self->seq_num;
+  gint i;
 
   if (!afsql_dd_ensure_initialized_connection(self))
     return FALSE;
 
   /* connection established, try to insert a message */
-  msg = log_queue_pop_head(self->queue, &path_options);
+  if (self->pending_msg)
+    {
+      msg = self->pending_msg;
+      path_options = self->pending_msg_path_options;
+      self->pending_msg = NULL;
+    }
+  else
+    {
+      msg = log_queue_pop_head(self->queue, &path_options);
+    }
   if (!msg)
     return TRUE;
 
@@ -963,20 +1062,25 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
     }
 
   insert_command = afsql_dd_build_insert_command(self, msg, table);
+
+  if (afsql_dd_should_batch_inserts(self))
+    {
+      batch_msgs = g_ptr_array_new();
+      batch_path_options = g_array_new(FALSE, FALSE, sizeof(LogPathOptions));
+      afsql_dd_extend_insert_batch(self, table, insert_command, batch_msgs, batch_path_options);
+    }
+
   success = afsql_dd_run_query(self, insert_command->str, FALSE, NULL);
 
   if (success && self->flush_lines_queued != -1)
     {
-      self->flush_lines_queued++;
+      self->flush_lines_queued += 1 + (batch_msgs ? (gint) batch_msgs->len : 0);
 
       if (afsql_dd_should_commit_transaction(self) && !afsql_dd_commit_transaction(self))
         {
           /* Assuming that in case of error, the queue is rewound by afsql_dd_commit_transaction() */
           afsql_dd_rollback_transaction(self);
 
-          g_string_free(insert_command, TRUE);
-          msg_set_context(NULL);
-
           success = FALSE;
         }
     }
@@ -996,13 +1100,50 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
       log_msg_ack(msg, &path_options, AT_PROCESSED);
       log_msg_unref(msg);
       step_sequence_number(&self->seq_num);
+      if (batch_msgs)
+        {
+          for (i = 0; i < batch_msgs->len; i++)
+            {
+              LogMessage *batch_msg = g_ptr_array_index(batch_msgs, i);
+
+              log_msg_ack(batch_msg, &g_array_index(batch_path_options, LogPathOptions, i), AT_PROCESSED);
+              log_msg_unref(batch_msg);
+            }
+        }
       self->failed_message_counter = 0;
     }
   else
     {
+      /* rows formatted into the failed statement are retried with their
+       * original sequence numbers */
+      self->seq_num = batch_start_seq;
       if (self->failed_message_counter < self->num_retries)
         {
-          if (!afsql_dd_handle_insert_row_error_depending_on_connection_availability(self, msg, &path_options))
+          gboolean connection_available;
+          gint batch_size = 1 + (batch_msgs ? (gint) batch_msgs->len : 0);
+
+          if (self->pending_msg)
+            {
+              /* the pending message is the newest backlog entry, it has to
+               * be rewound together with the batch */
+              batch_size++;
+              afsql_dd_drop_pending_msg(self);
+            }
+
+          connection_available =
+            afsql_dd_handle_insert_row_error_depending_on_connection_availability(self, msg, &path_options, batch_size);
+
+          /* the rewind requeued the batched messages, drop our references */
+          if (batch_msgs)
+            {
+              for (i = 0; i < batch_msgs->len; i++)
+                log_msg_unref(g_ptr_array_index(batch_msgs, i));
+              g_ptr_array_free(batch_msgs, TRUE);
+              g_array_free(batch_path_options, TRUE);
+              batch_msgs = NULL;
+            }
+
+          if (!connection_available)
             return FALSE;
 
           self->failed_message_counter++;
@@ -1019,6 +1160,12 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
         }
     }
 
+  if (batch_msgs)
+    {
+      g_ptr_array_free(batch_msgs, TRUE);
+      g_array_free(batch_path_options, TRUE);
+    }
+
   return success;
 }
 
@@ -1082,7 +1229,7 @@ afsql_dd_database_thread(gpointer arg)
                   continue;
                 }
             }
-          else if (!self->db_thread_terminate)
+          else if (!self->db_thread_terminate && !self->pending_msg)
             {
               g_cond_wait(self->db_thread_wakeup_cond, self->db_thread_mutex);
             }
@@ -1101,7 +1248,7 @@ afsql_dd_database_thread(gpointer arg)
         }
     }
 
-  while (log_queue_get_length(self->queue) > 0)
+  while (log_queue_get_length(self->queue) > 0 || self->pending_msg)
     {
       if (!afsql_dd_insert_db(self))
         {
@@ -1120,6 +1267,7 @@ afsql_dd_database_thread(gpointer arg)
         afsql_dd_rollback_transaction(self);
     }
 exit:
+  afsql_dd_drop_pending_msg(self);
   afsql_dd_disconnect(self);
 
   msg_verbose("Database thread finished",
@@ -108,6 +108,10 @@ typedef struct _AFSqlDestDriver
   LogQueue *queue;
   /* used exclusively by the db thread */
   gint32 seq_num;
+  /* message popped while assembling a multi-row INSERT but rendering a
+   * different table name, consumed by the next insert round */
+  LogMessage *pending_msg;
+  LogPathOptions pending_msg_path_options;
   dbi_conn dbi_ctx;
   GHashTable *syslogng_conform_tables;
   guint32 failed_message_counter;
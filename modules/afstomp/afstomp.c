@@ -305,7 +305,7 @@ afstomp_worker_publish(STOMPDestDriver *self, LogMessage *msg)
       success = FALSE;
     }
 
-  if (success && self->ack_needed)
+  if (success && self->ack_needed && self->super.pipeline_depth < 2)
     success = stomp_receive_frame(self->conn, &recv_frame);
 
   sb_gstring_release(body);
@@ -324,6 +324,30 @@ afstomp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
   if (!afstomp_worker_publish (self, msg))
     return WORKER_INSERT_RESULT_ERROR;
 
+  if (self->ack_needed && self->super.pipeline_depth >= 2)
+    return WORKER_INSERT_RESULT_QUEUED;
+
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
+/* with pipeline(), a receipt is still requested for every frame, but the
+ * server replies are only read here in one go, so the per-message round
+ * trip is replaced by one wait per batch */
+static worker_insert_result_t
+afstomp_worker_flush(LogThrDestDriver *s)
+{
+  STOMPDestDriver *self = (STOMPDestDriver *)s;
+  stomp_frame recv_frame;
+  gint i;
+
+  for (i = 0; i < s->queued_messages; i++)
+    {
+      if (!stomp_receive_frame(self->conn, &recv_frame))
+        {
+          msg_error("Error while waiting for STOMP receipts", NULL);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+    }
   return WORKER_INSERT_RESULT_SUCCESS;
 }
 
@@ -386,6 +410,7 @@ afstomp_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_init = afstomp_worker_thread_init;
   self->super.worker.disconnect = afstomp_dd_disconnect;
   self->super.worker.insert = afstomp_worker_insert;
+  self->super.worker.flush = afstomp_worker_flush;
 
   self->super.format.stats_instance = afstomp_dd_format_stats_instance;
   self->super.format.persist_name = afstomp_dd_format_persist_name;
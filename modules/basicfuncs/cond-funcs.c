@@ -177,4 +177,4 @@ tf_or (LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_or);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_or);
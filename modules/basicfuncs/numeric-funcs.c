@@ -65,7 +65,7 @@ tf_num_plus(LogMessage *msg, gint argc, GString *argv[], GString *result)
   format_int64_padded(result, 0, ' ', 10, n + m);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_plus);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_plus);
 
 static void
 tf_num_minus(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -81,7 +81,7 @@ tf_num_minus(LogMessage *msg, gint argc, GString *argv[], GString *result)
   format_int64_padded(result, 0, ' ', 10, n - m);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_minus);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_minus);
 
 static void
 tf_num_multi(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -97,7 +97,7 @@ tf_num_multi(LogMessage *msg, gint argc, GString *argv[], GString *result)
   format_int64_padded(result, 0, ' ', 10, n * m);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_multi);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_multi);
 
 static void
 tf_num_div(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -113,7 +113,7 @@ tf_num_div(LogMessage *msg, gint argc, GString *argv[], GString *result)
   format_int64_padded(result, 0, ' ', 10, n / m);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_div);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_div);
 
 static void
 tf_num_mod(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -129,4 +129,4 @@ tf_num_mod(LogMessage *msg, gint argc, GString *argv[], GString *result)
   format_uint64_padded(result, 0, ' ', 10, n % m);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_mod);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_mod);
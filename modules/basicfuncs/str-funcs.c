@@ -38,7 +38,7 @@ tf_echo(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_echo);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_echo);
 
 static void
 tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -53,7 +53,7 @@ tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_length);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_length);
 
 /*
  * $(substr $arg START [LEN])
@@ -156,7 +156,7 @@ tf_substr(LogMessage *msg, gint argc, GString *argv[], GString *result)
   g_string_append_len(result, argv[0]->str + start, len);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_substr);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_substr);
 
 /*
  * $(strip $arg1 $arg2 ...)
@@ -193,7 +193,7 @@ tf_strip(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_strip);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_strip);
 
 /*
  * $(sanitize [opts] $arg1 $arg2 ...)
@@ -294,7 +294,7 @@ tf_sanitize_free_state(gpointer s)
   tf_simple_func_free_state(&state->super);
 }
 
-TEMPLATE_FUNCTION(TFSanitizeState, tf_sanitize, tf_sanitize_prepare, tf_simple_func_eval, tf_sanitize_call, tf_sanitize_free_state, NULL);
+TEMPLATE_FUNCTION_EX(TFSanitizeState, tf_sanitize, tf_sanitize_prepare, tf_simple_func_eval, tf_sanitize_call, tf_sanitize_free_state, NULL, tf_simple_func_is_constant);
 
 
 static void
@@ -331,7 +331,7 @@ tf_indent_multi_line(LogMessage *msg, gint argc, GString *argv[], GString *text)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_indent_multi_line);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_indent_multi_line);
 
 void
 tf_lowercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -350,7 +350,7 @@ tf_lowercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_lowercase);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_lowercase);
 
 void
 tf_uppercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -369,7 +369,7 @@ tf_uppercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_uppercase);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_uppercase);
 
 void
 tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -392,13 +392,14 @@ tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *resul
   g_free(haystack);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_replace_delimiter);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_replace_delimiter);
 
 static void
 tf_string_padding(LogMessage *msg, gint argc, GString *argv[], GString *result)
 {
   GString *text = argv[0];
-  GString *padding;
+  const gchar *padding = " ";
+  gsize padding_len = 1;
   gint64 width, i;
 
   if (argc <= 1)
@@ -413,25 +414,21 @@ tf_string_padding(LogMessage *msg, gint argc, GString *argv[], GString *result)
       return;
     }
 
-  if (argc <= 2)
-    padding = g_string_new(" ");
-  else
-    padding = argv[2];
+  if (argc > 2 && argv[2]->len > 0)
+    {
+      padding = argv[2]->str;
+      padding_len = argv[2]->len;
+    }
 
   if (text->len < width)
     {
       for (i = 0; i < width - text->len; i++)
         {
-          g_string_append_c(result, *(padding->str + (i % padding->len)));
+          g_string_append_c(result, padding[i % padding_len]);
         }
     }
 
   g_string_append_len(result, text->str, text->len);
-
-  if (argc <= 2)
-    {
-      g_string_free(padding, TRUE);
-    }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_string_padding);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_string_padding);
@@ -141,7 +141,9 @@ tf_hash_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs
     }
 }
 
-TEMPLATE_FUNCTION(TFHashState, tf_hash, tf_hash_prepare, tf_simple_func_eval, tf_hash_call, tf_simple_func_free_state, NULL);
+/* the digest only depends on the resolved arguments, so repeated values
+ * (hostnames, program names) can be served from the memoization cache */
+TEMPLATE_FUNCTION_MEMOIZED(TFHashState, tf_hash, tf_hash_prepare, tf_simple_func_eval, tf_hash_call, tf_simple_func_free_state, NULL);
 
 
 static Plugin cryptofuncs_plugins[] =
@@ -29,6 +29,19 @@
  * CSVScannerOptions
  ************************************************************************/
 
+static void
+_options_update_char_classes(CSVScannerOptions *options)
+{
+  gint i;
+
+  memset(options->is_delimiter, 0, sizeof(options->is_delimiter));
+  memset(options->quote_end_of, 0, sizeof(options->quote_end_of));
+  for (i = 0; options->delimiters && options->delimiters[i]; i++)
+    options->is_delimiter[(guchar) options->delimiters[i]] = 1;
+  for (i = 0; options->quotes_start && options->quotes_start[i]; i++)
+    options->quote_end_of[(guchar) options->quotes_start[i]] = options->quotes_end[i];
+}
+
 void
 csv_scanner_options_set_flags(CSVScannerOptions *options, guint32 flags)
 {
@@ -53,6 +66,7 @@ csv_scanner_options_set_delimiters(CSVScannerOptions *options, const gchar *deli
 {
   g_free(options->delimiters);
   options->delimiters = g_strdup(delimiters);
+  _options_update_char_classes(options);
 }
 
 void
@@ -69,6 +83,7 @@ csv_scanner_options_set_quotes_start_and_end(CSVScannerOptions *options, const g
   g_free(options->quotes_end);
   options->quotes_start = g_strdup(quotes_start);
   options->quotes_end = g_strdup(quotes_end);
+  _options_update_char_classes(options);
 }
 
 void
@@ -95,6 +110,7 @@ csv_scanner_options_set_quote_pairs(CSVScannerOptions *options, const gchar *quo
     }
   options->quotes_start[i / 2] = 0;
   options->quotes_end[i / 2] = 0;
+  _options_update_char_classes(options);
 }
 
 
@@ -170,13 +186,13 @@ _is_at_the_end_of_columns(CSVScanner *self)
 static void
 _parse_opening_quote_character(CSVScanner *self)
 {
-  gchar *quote = strchr(self->options->quotes_start, *self->src);
+  gchar quote_end = self->options->quote_end_of[(guchar) *self->src];
 
-  if (quote != NULL)
+  if (quote_end)
     {
       /* ok, quote character found */
       self->src++;
-      self->current_quote = self->options->quotes_end[quote - self->options->quotes_start];
+      self->current_quote = quote_end;
     }
   else
     {
@@ -220,6 +236,15 @@ _parse_character_with_quotation(CSVScanner *self)
   self->src++;
 }
 
+static void
+_begin_token(CSVScanner *self)
+{
+  /* quoted values may drop or rewrite bytes while scanning, only unquoted
+   * ones are guaranteed to be verbatim slices of the input */
+  self->token_literal = self->current_quote == 0;
+  self->token_start = self->src;
+}
+
 /* searches for str in list and returns the first occurence, otherwise NULL */
 static const gboolean
 _match_string_delimiters_at_current_position(const char *input, GList *string_delimiters, int *result_length)
@@ -260,7 +285,7 @@ _parse_string_delimiters_at_current_position(CSVScanner *self)
 static gboolean
 _parse_character_delimiters_at_current_position(CSVScanner *self)
 {
-  if (strchr(self->options->delimiters, *self->src) != NULL)
+  if (self->options->is_delimiter[(guchar) *self->src])
     {
       self->src++;
       return TRUE;
@@ -330,7 +355,10 @@ _translate_null_value(CSVScanner *self)
 {
   if (self->options->null_value &&
       strcmp(self->current_value->str, self->options->null_value) == 0)
-    g_string_truncate(self->current_value, 0);
+    {
+      g_string_truncate(self->current_value, 0);
+      self->token_literal = FALSE;
+    }
 }
 
 static void
@@ -350,6 +378,8 @@ csv_scanner_scan_next(CSVScanner *self)
 
   if (_is_last_column(self) && (self->options->flags & CSV_SCANNER_GREEDY))
     {
+      self->token_literal = TRUE;
+      self->token_start = self->src;
       g_string_assign(self->current_value, self->src);
       self->src = NULL;
       return TRUE;
@@ -363,6 +393,7 @@ csv_scanner_scan_next(CSVScanner *self)
     {
       _parse_opening_quote_character(self);
       _parse_left_whitespace(self);
+      _begin_token(self);
       _parse_value_with_whitespace_and_delimiter(self);
       _translate_value(self);
       return TRUE;
@@ -387,6 +418,20 @@ csv_scanner_get_current_value_len(CSVScanner *self)
   return self->current_value->len;
 }
 
+/* the current value is byte-for-byte identical to a slice of the input
+ * buffer and can thus be referenced instead of copied */
+gboolean
+csv_scanner_is_current_value_literal(CSVScanner *self)
+{
+  return self->token_literal;
+}
+
+gint
+csv_scanner_get_current_value_offset(CSVScanner *self)
+{
+  return self->token_start - self->input;
+}
+
 gboolean
 csv_scanner_is_scan_finished(CSVScanner *self)
 {
@@ -403,6 +448,7 @@ csv_scanner_is_scan_finished(CSVScanner *self)
 void
 csv_scanner_input(CSVScanner *self, const gchar *input)
 {
+  self->input = input;
   self->src = input;
   self->current_column = NULL;
 }
@@ -412,9 +458,12 @@ csv_scanner_state_init(CSVScanner *self, CSVScannerOptions *options)
 {
   self->options = options;
   self->current_column = options->columns;
+  self->input = NULL;
   self->src = NULL;
   self->current_value = g_string_sized_new(128);
   self->current_quote = 0;
+  self->token_literal = FALSE;
+  self->token_start = NULL;
 }
 
 void
@@ -48,6 +48,13 @@ typedef struct _CSVScannerOptions
   GList *string_delimiters;
   CSVScannerDialect dialect;
   guint32 flags;
+
+  /* classifier tables derived from delimiters/quotes_start above, so the
+   * scanner can decide what a byte is with one indexed load instead of a
+   * strchr(); is_delimiter is a boolean, quote_end_of maps a quote start
+   * character to its matching end character (0: not a quote start) */
+  guint8 is_delimiter[256];
+  gchar quote_end_of[256];
 } CSVScannerOptions;
 
 void csv_scanner_options_clean(CSVScannerOptions *options);
@@ -67,14 +74,21 @@ typedef struct _CSVScanner
 {
   CSVScannerOptions *options;
   GList *current_column;
+  const gchar *input;
   const gchar *src;
   GString *current_value;
   gchar current_quote;
+  /* the current value is a verbatim, contiguous slice of the input
+   * buffer; token_start points to its first byte */
+  gboolean token_literal;
+  const gchar *token_start;
 } CSVScanner;
 
 const gchar *csv_scanner_get_current_name(CSVScanner *pstate);
 const gchar *csv_scanner_get_current_value(CSVScanner *pstate);
 gint csv_scanner_get_current_value_len(CSVScanner *self);
+gboolean csv_scanner_is_current_value_literal(CSVScanner *self);
+gint csv_scanner_get_current_value_offset(CSVScanner *self);
 gboolean csv_scanner_scan_next(CSVScanner *pstate);
 gboolean csv_scanner_is_scan_finished(CSVScanner *pstate);
 
@@ -36,6 +36,10 @@ typedef struct _CSVParser
   GString *formatted_key;
   gchar *prefix;
   gint prefix_len;
+  /* column names (with the prefix applied) resolved to name-value handles
+   * at init time, in the same order as options.columns */
+  NVHandle *column_handles;
+  gint num_columns;
 } CSVParser;
 
 #define _ESCAPE_MODE_SHIFT 16
@@ -111,20 +115,63 @@ _get_formatted_key(CSVParser *self, const gchar *key)
   return self->formatted_key->str;
 }
 
+static void
+_compile_column_handles(CSVParser *self)
+{
+  GList *l;
+  gint i;
+
+  g_free(self->column_handles);
+  self->num_columns = g_list_length(self->options.columns);
+  self->column_handles = g_new(NVHandle, self->num_columns);
+  for (i = 0, l = self->options.columns; l; l = l->next, i++)
+    self->column_handles[i] = log_msg_get_value_handle(_get_formatted_key(self, (const gchar *) l->data));
+}
+
+static gboolean
+csv_parser_init(LogPipe *s)
+{
+  CSVParser *self = (CSVParser *) s;
+
+  if (!log_parser_init_method(s))
+    return FALSE;
+
+  _compile_column_handles(self);
+  return TRUE;
+}
+
 static gboolean
 csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
 {
   CSVParser *self = (CSVParser *) s;
   LogMessage *msg = log_msg_make_writable(pmsg, path_options);
+  gint i = 0;
+
+  if (G_UNLIKELY(!self->column_handles))
+    _compile_column_handles(self);
 
   csv_scanner_input(&self->scanner, input);
-  while (csv_scanner_scan_next(&self->scanner))
+  while (i < self->num_columns && csv_scanner_scan_next(&self->scanner))
     {
+      NVHandle handle = self->column_handles[i++];
+      gint value_len = csv_scanner_get_current_value_len(&self->scanner);
+      gint value_ofs;
 
-      log_msg_set_value_by_name(msg,
-                                _get_formatted_key(self, csv_scanner_get_current_name(&self->scanner)),
-                                csv_scanner_get_current_value(&self->scanner),
-                                csv_scanner_get_current_value_len(&self->scanner));
+      /* without a template() the input is the MESSAGE value itself; tokens
+       * that came through the scanner unmodified can then be stored as an
+       * indirect value referencing it, skipping the copy */
+      if (!self->super.template &&
+          csv_scanner_is_current_value_literal(&self->scanner) &&
+          (value_ofs = csv_scanner_get_current_value_offset(&self->scanner)) + value_len <= 65535)
+        {
+          log_msg_set_value_indirect(msg, handle, LM_V_MESSAGE, 0, value_ofs, value_len);
+        }
+      else
+        {
+          log_msg_set_value(msg, handle,
+                            csv_scanner_get_current_value(&self->scanner),
+                            value_len);
+        }
     }
 
   return csv_scanner_is_scan_finished(&self->scanner);
@@ -151,6 +198,7 @@ csv_parser_free(LogPipe *s)
   csv_scanner_options_clean(&self->options);
   csv_scanner_state_clean(&self->scanner);
   g_string_free(self->formatted_key, TRUE);
+  g_free(self->column_handles);
   g_free(self->prefix);
   log_parser_free_method(s);
 }
@@ -164,6 +212,7 @@ csv_parser_new(GlobalConfig *cfg)
   CSVParser *self = g_new0(CSVParser, 1);
 
   log_parser_init_instance(&self->super, cfg);
+  self->super.super.init = csv_parser_init;
   self->super.super.free_fn = csv_parser_free;
   self->super.super.clone = csv_parser_clone;
   self->super.process = csv_parser_process;
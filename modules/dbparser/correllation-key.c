@@ -22,6 +22,7 @@
  */
 #include "correllation-key.h"
 #include "logmsg.h"
+#include "fasthash.h"
 #include <string.h>
 
 
@@ -39,18 +40,18 @@ correllation_key_hash(gconstpointer k)
   switch (key->scope)
     {
     case RCS_PROCESS:
-      hash += g_str_hash(key->pid);
+      hash += fast_hash_str(key->pid);
     case RCS_PROGRAM:
-      hash += g_str_hash(key->program);
+      hash += fast_hash_str(key->program);
     case RCS_HOST:
-      hash += g_str_hash(key->host);
+      hash += fast_hash_str(key->host);
     case RCS_GLOBAL:
       break;
     default:
       g_assert_not_reached();
       break;
     }
-  return hash + g_str_hash(key->session_id);
+  return hash + fast_hash_str(key->session_id);
 }
 
 gboolean
@@ -33,6 +33,10 @@ static CfgLexerKeyword dbparser_keywords[] =
 {
   { "db_parser",          KW_DB_PARSER, 0x0300 },
   { "grouping_by",        KW_GROUPING_BY, 0x0307 },
+  { "dedup",              KW_DEDUP, 0x0308 },
+
+  /* dedup options */
+  { "max_count",          KW_MAX_COUNT, 0x0308 },
 
   /* correllate options */
   { "inject_mode",        KW_INJECT_MODE, 0x0307 },
@@ -24,6 +24,7 @@
 #include "cfg-parser.h"
 #include "dbparser.h"
 #include "groupingby.h"
+#include "dedup.h"
 #include "plugin.h"
 #include "plugin-types.h"
 
@@ -41,6 +42,11 @@ static Plugin dbparser_plugins[] =
     .name = "grouping-by",
     .parser = &dbparser_parser,
   },
+  {
+    .type = LL_CONTEXT_PARSER,
+    .name = "dedup",
+    .parser = &dbparser_parser,
+  },
 };
 
 gboolean
@@ -48,6 +54,7 @@ dbparser_module_init(GlobalConfig *cfg, CfgArgs *args)
 {
   pattern_db_global_init();
   grouping_by_global_init();
+  dedup_parser_global_init();
   plugin_register(cfg, dbparser_plugins, G_N_ELEMENTS(dbparser_plugins));
   return TRUE;
 }
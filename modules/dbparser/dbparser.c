@@ -27,23 +27,31 @@
 #include "apphook.h"
 #include "reloc.h"
 #include "stateful-parser.h"
+#include "stats/stats-registry.h"
 
 #include <sys/stat.h>
 #include <iv.h>
 #include <string.h>
 
+/* number of correllation contexts a single message (or timer tick) may
+ * expire inline; the rest is drained by a low priority main loop task so
+ * that context storms don't stall message processing */
+#define LOG_DB_PARSER_EXPIRATION_BATCH 128
 
 struct _LogDBParser
 {
   StatefulParser super;
   GStaticMutex lock;
   struct iv_timer tick;
+  struct iv_task expire_task;
   PatternDB *db;
   gchar *db_file;
   time_t db_file_last_check;
   ino_t db_file_inode;
   time_t db_file_mtime;
   gboolean db_file_reloading;
+  GThread *reload_thread;
+  StatsCounterItem *timer_wheel_depth;
 };
 
 static void
@@ -97,12 +105,67 @@ log_db_parser_reload_database(LogDBParser *self)
 
 }
 
+/*
+ * Re-parsing a large pattern database takes seconds, so the periodic
+ * file-change reload runs in a detached-style worker thread instead of
+ * blocking the message path: workers keep matching against the old
+ * ruleset until pattern_db_reload_ruleset() swaps in the new one under
+ * its writer lock.  A compiled/mmapped ruleset image was considered, but
+ * the radix trie embeds parser vtables and compiled templates, which
+ * cannot be stored position independently without a full redesign.
+ */
+static gpointer
+log_db_parser_reload_thread(gpointer s)
+{
+  LogDBParser *self = (LogDBParser *) s;
+
+  log_db_parser_reload_database(self);
+
+  g_static_mutex_lock(&self->lock);
+  self->db_file_reloading = FALSE;
+  g_static_mutex_unlock(&self->lock);
+  return NULL;
+}
+
+/* NOTE: called with self->lock held; joins the previous, already finished
+ * reload thread (if any) and starts a new one */
+static void
+log_db_parser_start_reload_thread(LogDBParser *self)
+{
+  if (self->reload_thread)
+    g_thread_join(self->reload_thread);
+  self->reload_thread = g_thread_create(log_db_parser_reload_thread, self, TRUE, NULL);
+  if (!self->reload_thread)
+    {
+      /* thread creation failed, fall back to reloading in place */
+      g_static_mutex_unlock(&self->lock);
+      log_db_parser_reload_thread(self);
+      g_static_mutex_lock(&self->lock);
+    }
+}
+
+/* drains expirations left over by a capped run; re-registers itself
+ * until the timer wheel catches up, processing a bounded batch per main
+ * loop iteration */
+static void
+log_db_parser_expire_task(gpointer s)
+{
+  LogDBParser *self = (LogDBParser *) s;
+
+  pattern_db_process_pending_expirations(self->db);
+  if (pattern_db_has_pending_expirations(self->db))
+    iv_task_register(&self->expire_task);
+}
+
 static void
 log_db_parser_timer_tick(gpointer s)
 {
   LogDBParser *self = (LogDBParser *) s;
 
   pattern_db_timer_tick(self->db);
+  stats_counter_set(self->timer_wheel_depth, pattern_db_get_timer_count(self->db));
+  if (pattern_db_has_pending_expirations(self->db) && !iv_task_registered(&self->expire_task))
+    iv_task_register(&self->expire_task);
   iv_validate_now();
   self->tick.expires = iv_now;
   self->tick.expires.tv_sec++;
@@ -148,7 +211,13 @@ log_db_parser_init(LogPipe *s)
       log_db_parser_reload_database(self);
     }
   if (self->db)
-    pattern_db_set_emit_func(self->db, log_db_parser_emit, self);
+    {
+      pattern_db_set_emit_func(self->db, log_db_parser_emit, self);
+      pattern_db_set_expiration_batch(self->db, LOG_DB_PARSER_EXPIRATION_BATCH);
+    }
+  stats_lock();
+  stats_register_counter(1, SCS_GLOBAL, "db_parser_timer_wheel_depth", self->db_file, SC_TYPE_STORED, &self->timer_wheel_depth);
+  stats_unlock();
   iv_validate_now();
   IV_TIMER_INIT(&self->tick);
   self->tick.cookie = self;
@@ -157,6 +226,9 @@ log_db_parser_init(LogPipe *s)
   self->tick.expires.tv_sec++;
   self->tick.expires.tv_nsec = 0;
   iv_timer_register(&self->tick);
+  IV_TASK_INIT(&self->expire_task);
+  self->expire_task.cookie = self;
+  self->expire_task.handler = log_db_parser_expire_task;
   if (!self->db)
     return FALSE;
   return log_parser_init_method(s);
@@ -167,12 +239,31 @@ log_db_parser_deinit(LogPipe *s)
 {
   LogDBParser *self = (LogDBParser *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+  GThread *reload_thread;
 
   if (iv_timer_registered(&self->tick))
     {
       iv_timer_unregister(&self->tick);
     }
 
+  /* wait for an in-flight background reload, it is using self->db which
+   * is about to be handed over to persist */
+  g_static_mutex_lock(&self->lock);
+  reload_thread = self->reload_thread;
+  self->reload_thread = NULL;
+  g_static_mutex_unlock(&self->lock);
+  if (reload_thread)
+    g_thread_join(reload_thread);
+
+  if (iv_task_registered(&self->expire_task))
+    {
+      iv_task_unregister(&self->expire_task);
+    }
+
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "db_parser_timer_wheel_depth", self->db_file, SC_TYPE_STORED, &self->timer_wheel_depth);
+  stats_unlock();
+
   cfg_persist_config_add(cfg, log_db_parser_format_persist_name(self), self->db, (GDestroyNotify) pattern_db_free, FALSE);
   self->db = NULL;
   return TRUE;
@@ -195,13 +286,10 @@ log_db_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *pat
         {
           self->db_file_last_check = (*pmsg)->timestamps[LM_TS_RECVD].tv_sec;
           self->db_file_reloading = TRUE;
-          g_static_mutex_unlock(&self->lock);
-
-          /* only one thread may come here, the others may continue to use self->db, until we update it here. */
-          log_db_parser_reload_database(self);
 
-          g_static_mutex_lock(&self->lock);
-          self->db_file_reloading = FALSE;
+          /* all threads, including this one, continue to use self->db
+           * until the reload thread swaps the ruleset */
+          log_db_parser_start_reload_thread(self);
         }
       g_static_mutex_unlock(&self->lock);
     }
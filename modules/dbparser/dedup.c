@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2016 BalaBit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "dedup.h"
+#include "timerwheel.h"
+#include "messages.h"
+#include "misc.h"
+#include "timeutils.h"
+#include <iv.h>
+
+/*
+ * The dedup() parser suppresses repeated messages close to the source: the
+ * first message carrying a given key (as rendered by the key() template)
+ * passes through, further copies arriving within timeout() seconds are
+ * dropped while being counted.  When the window expires -- or earlier,
+ * when max-count() copies have been swallowed -- a single synthesized
+ * message reports how many copies were suppressed, inheriting its
+ * properties from the last suppressed copy.  The count and the key are
+ * available to aggregate() templates as ${.dedup.count} and ${.dedup.key}.
+ *
+ * The window is fixed, not sliding: it starts at the first occurrence and
+ * is not extended by further copies, so a continuous flood still produces
+ * one message plus one summary per timeout() seconds.
+ */
+
+typedef struct _DedupParser DedupParser;
+
+typedef struct _DedupEntry
+{
+  gchar *key;
+  /* the most recently suppressed copy, the synthesized summary inherits
+   * its properties from this message */
+  LogMessage *last_msg;
+  guint suppressed;
+  TWEntry *timer;
+} DedupEntry;
+
+struct _DedupParser
+{
+  StatefulParser super;
+  GStaticMutex lock;
+  struct iv_timer tick;
+  TimerWheel *timer_wheel;
+  GTimeVal last_tick;
+  GHashTable *entries;
+  LogTemplate *key_template;
+  gint timeout;
+  gint max_count;
+  SyntheticMessage *synthetic_message;
+};
+
+static NVHandle dedup_count_handle = 0;
+static NVHandle dedup_key_handle = 0;
+
+void
+dedup_parser_set_key_template(LogParser *s, LogTemplate *key_template)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  log_template_unref(self->key_template);
+  self->key_template = log_template_ref(key_template);
+}
+
+void
+dedup_parser_set_timeout(LogParser *s, gint timeout)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  self->timeout = timeout;
+}
+
+void
+dedup_parser_set_max_count(LogParser *s, gint max_count)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  self->max_count = max_count;
+}
+
+void
+dedup_parser_set_synthetic_message(LogParser *s, SyntheticMessage *message)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  if (self->synthetic_message)
+    synthetic_message_free(self->synthetic_message);
+  self->synthetic_message = message;
+}
+
+static DedupEntry *
+dedup_entry_new(gchar *key)
+{
+  DedupEntry *self = g_new0(DedupEntry, 1);
+
+  self->key = key;
+  return self;
+}
+
+static void
+dedup_entry_free(DedupEntry *self)
+{
+  if (self->last_msg)
+    log_msg_unref(self->last_msg);
+  g_free(self->key);
+  g_free(self);
+}
+
+/* NOTE: lock should be acquired before calling this function. */
+static void
+dedup_parser_set_time(DedupParser *self, const LogStamp *ls)
+{
+  GTimeVal now;
+
+  /* clamp the current time between the timestamp of the current message
+   * (low limit) and the current system time (high limit).  This ensures
+   * that incorrect clocks do not skew the current time known by the
+   * deduplication engine too much. */
+
+  cached_g_current_time(&now);
+  self->last_tick = now;
+
+  if (ls->tv_sec < now.tv_sec)
+    now.tv_sec = ls->tv_sec;
+
+  timer_wheel_set_time(self->timer_wheel, now.tv_sec);
+}
+
+/* Synthesize and emit the "last message repeated N times" record for
+ * @entry.  NOTE: lock is held, the same way grouping-by emits from under
+ * its lock via the timer wheel callbacks. */
+static void
+dedup_parser_emit_entry(DedupParser *self, DedupEntry *entry)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *genmsg;
+  GString *buffer;
+  gchar count_buf[16];
+
+  if (entry->suppressed == 0)
+    return;
+
+  path_options.ack_needed = FALSE;
+  genmsg = log_msg_clone_cow(entry->last_msg, &path_options);
+  g_snprintf(count_buf, sizeof(count_buf), "%u", entry->suppressed);
+  log_msg_set_value(genmsg, dedup_count_handle, count_buf, -1);
+  log_msg_set_value(genmsg, dedup_key_handle, entry->key, -1);
+
+  buffer = g_string_sized_new(64);
+  if (self->synthetic_message)
+    {
+      /* with a NULL context the aggregate() templates are rendered
+       * against genmsg itself, so ${.dedup.count} set above is visible */
+      synthetic_message_apply(self->synthetic_message, NULL, genmsg, buffer);
+    }
+  else
+    {
+      g_string_printf(buffer, "Last message repeated %u times", entry->suppressed);
+      log_msg_set_value(genmsg, LM_V_MESSAGE, buffer->str, buffer->len);
+    }
+  stateful_parser_emit_synthetic(&self->super, genmsg);
+  log_msg_unref(genmsg);
+  g_string_free(buffer, TRUE);
+}
+
+static void
+dedup_parser_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
+{
+  DedupEntry *entry = user_data;
+  DedupParser *self = (DedupParser *) timer_wheel_get_associated_data(wheel);
+  gchar buf[256];
+
+  msg_debug("Expiring dedup() entry",
+            evt_tag_long("utc", timer_wheel_get_time(wheel)),
+            evt_tag_str("key", entry->key),
+            evt_tag_int("suppressed", entry->suppressed),
+            evt_tag_str("location",
+                        log_expr_node_format_location(self->super.super.super.expr_node,
+                                                      buf, sizeof(buf))),
+            NULL);
+  entry->timer = NULL;
+  dedup_parser_emit_entry(self, entry);
+  g_hash_table_remove(self->entries, entry->key);
+}
+
+/*
+ * Advance the timer wheel between messages, so windows of keys that
+ * stopped arriving still expire.  Mirrors the grouping-by timer tick.
+ */
+static void
+dedup_parser_timer_tick(gpointer s)
+{
+  DedupParser *self = (DedupParser *) s;
+  GTimeVal now;
+  glong diff;
+
+  g_static_mutex_lock(&self->lock);
+  cached_g_current_time(&now);
+  diff = g_time_val_diff(&now, &self->last_tick);
+
+  if (diff > 1e6)
+    {
+      glong diff_sec = diff / 1e6;
+
+      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec);
+
+      /* update last_tick, take the fraction of the seconds not calculated into this update into account */
+      self->last_tick = now;
+      g_time_val_add(&self->last_tick, -(diff - diff_sec * 1e6));
+    }
+  else if (diff < 0)
+    {
+      /* time moving backwards, this can only happen if the computer's time
+       * is changed.  Wait another tick to update instead. */
+      self->last_tick = now;
+    }
+  g_static_mutex_unlock(&self->lock);
+
+  iv_validate_now();
+  self->tick.expires = iv_now;
+  self->tick.expires.tv_sec++;
+  iv_timer_register(&self->tick);
+}
+
+static gboolean
+dedup_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
+{
+  DedupParser *self = (DedupParser *) s;
+  LogMessage *msg = log_msg_make_writable(pmsg, path_options);
+  GString *buffer = g_string_sized_new(64);
+  DedupEntry *entry;
+  gboolean pass;
+
+  g_static_mutex_lock(&self->lock);
+  dedup_parser_set_time(self, &msg->timestamps[LM_TS_STAMP]);
+  log_template_format(self->key_template, msg, NULL, LTZ_LOCAL, 0, NULL, buffer);
+
+  entry = g_hash_table_lookup(self->entries, buffer->str);
+  if (!entry)
+    {
+      entry = dedup_entry_new(buffer->str);
+      entry->last_msg = log_msg_ref(msg);
+      g_hash_table_insert(self->entries, entry->key, entry);
+      entry->timer = timer_wheel_add_timer(self->timer_wheel, self->timeout,
+                                           dedup_parser_expire_entry, entry, NULL);
+      g_string_steal(buffer);
+      pass = TRUE;
+    }
+  else
+    {
+      entry->suppressed++;
+      log_msg_unref(entry->last_msg);
+      entry->last_msg = log_msg_ref(msg);
+      if (self->max_count && entry->suppressed >= (guint) self->max_count)
+        {
+          /* enough copies swallowed, flush the summary early instead of
+           * waiting for the window to expire */
+          timer_wheel_del_timer(self->timer_wheel, entry->timer);
+          entry->timer = NULL;
+          dedup_parser_emit_entry(self, entry);
+          g_hash_table_remove(self->entries, entry->key);
+        }
+      pass = FALSE;
+    }
+  g_static_mutex_unlock(&self->lock);
+
+  /* we hold a reference as last_msg of the entry, whoever changes the
+   * message must make a copy first */
+  log_msg_write_protect(msg);
+
+  g_string_free(buffer, TRUE);
+  return pass;
+}
+
+static void
+dedup_parser_flush_entry(gpointer key, gpointer value, gpointer user_data)
+{
+  DedupParser *self = (DedupParser *) user_data;
+  DedupEntry *entry = (DedupEntry *) value;
+
+  if (entry->timer)
+    {
+      timer_wheel_del_timer(self->timer_wheel, entry->timer);
+      entry->timer = NULL;
+    }
+  dedup_parser_emit_entry(self, entry);
+}
+
+static GHashTable *
+dedup_parser_hash_table_new(void)
+{
+  /* keys are owned by the entries */
+  return g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) dedup_entry_free);
+}
+
+static gboolean
+dedup_parser_init(LogPipe *s)
+{
+  DedupParser *self = (DedupParser *) s;
+  gchar buf[256];
+
+  if (!self->key_template)
+    {
+      msg_error("dedup() requires a key() option",
+                evt_tag_str("location",
+                            log_expr_node_format_location(self->super.super.super.expr_node,
+                                                          buf, sizeof(buf))),
+                NULL);
+      return FALSE;
+    }
+
+  iv_validate_now();
+  IV_TIMER_INIT(&self->tick);
+  self->tick.cookie = self;
+  self->tick.handler = dedup_parser_timer_tick;
+  self->tick.expires = iv_now;
+  self->tick.expires.tv_sec++;
+  self->tick.expires.tv_nsec = 0;
+  iv_timer_register(&self->tick);
+  return TRUE;
+}
+
+static gboolean
+dedup_parser_deinit(LogPipe *s)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  if (iv_timer_registered(&self->tick))
+    {
+      iv_timer_unregister(&self->tick);
+    }
+
+  /* emit the pending summaries instead of losing the counts on reload */
+  g_static_mutex_lock(&self->lock);
+  g_hash_table_foreach(self->entries, dedup_parser_flush_entry, self);
+  g_hash_table_destroy(self->entries);
+  self->entries = dedup_parser_hash_table_new();
+  g_static_mutex_unlock(&self->lock);
+  return TRUE;
+}
+
+static LogPipe *
+dedup_parser_clone(LogPipe *s)
+{
+  LogParser *clone;
+  DedupParser *self = (DedupParser *) s;
+
+  /* FIXME: share state between clones! */
+  clone = dedup_parser_new(s->cfg);
+  dedup_parser_set_key_template(clone, self->key_template);
+  dedup_parser_set_timeout(clone, self->timeout);
+  dedup_parser_set_max_count(clone, self->max_count);
+  return &clone->super;
+}
+
+static void
+dedup_parser_free(LogPipe *s)
+{
+  DedupParser *self = (DedupParser *) s;
+
+  g_static_mutex_free(&self->lock);
+  log_template_unref(self->key_template);
+  if (self->synthetic_message)
+    synthetic_message_free(self->synthetic_message);
+  g_hash_table_destroy(self->entries);
+  timer_wheel_free(self->timer_wheel);
+  stateful_parser_free_method(s);
+}
+
+LogParser *
+dedup_parser_new(GlobalConfig *cfg)
+{
+  DedupParser *self = g_new0(DedupParser, 1);
+
+  stateful_parser_init_instance(&self->super, cfg);
+  self->super.super.super.free_fn = dedup_parser_free;
+  self->super.super.super.init = dedup_parser_init;
+  self->super.super.super.deinit = dedup_parser_deinit;
+  self->super.super.super.clone = dedup_parser_clone;
+  self->super.super.process = dedup_parser_process;
+  g_static_mutex_init(&self->lock);
+  self->timeout = 5;
+  self->entries = dedup_parser_hash_table_new();
+  self->timer_wheel = timer_wheel_new();
+  timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
+  cached_g_current_time(&self->last_tick);
+  return &self->super.super;
+}
+
+void
+dedup_parser_global_init(void)
+{
+  dedup_count_handle = log_msg_get_value_handle(".dedup.count");
+  dedup_key_handle = log_msg_get_value_handle(".dedup.key");
+}
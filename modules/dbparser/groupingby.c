@@ -45,10 +45,15 @@ typedef struct _GroupingBy
   FilterExprNode *trigger_condition_expr;
   FilterExprNode *where_condition_expr;
   FilterExprNode *having_condition_expr;
+  /* contexts closed by the last sweep or trigger, waiting for their
+   * synthetic message to be emitted outside the lock; protected by lock */
+  GList *expired_contexts;
 } GroupingBy;
 
 static NVHandle context_id_handle = 0;
 
+static void grouping_by_flush_expired_entries(GroupingBy *self);
+
 void
 grouping_by_set_key_template(LogParser *s, LogTemplate *key_template)
 {
@@ -179,6 +184,8 @@ _grouping_by_timer_tick(GroupingBy *self)
       self->last_tick = now;
     }
   g_static_mutex_unlock(&self->lock);
+
+  grouping_by_flush_expired_entries(self);
 }
 
 static void
@@ -243,12 +250,43 @@ grouping_by_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
                         log_expr_node_format_location(self->super.super.super.expr_node,
                                                       buf, sizeof(buf))),
             NULL);
-  grouping_by_emit_synthetic(self, context);
+
+  /* only detach the context here: generating and emitting the synthetic
+   * message is the expensive part of closing a context (having()
+   * evaluation and the templates walk all queued messages) and this
+   * callback runs with the lock held, potentially for thousands of
+   * contexts in one timeout sweep.  The emission happens from
+   * grouping_by_flush_expired_entries() once the lock is released. */
+  self->expired_contexts = g_list_prepend(self->expired_contexts, correllation_context_ref(context));
   g_hash_table_remove(self->correllation->state, &context->key);
 
-  /* correllation_context_free is automatically called when returning from
-     this function by the timerwheel code as a destroy notify
-     callback. */
+  /* the timerwheel's reference is automatically dropped when returning
+     from this function by its destroy notify callback. */
+}
+
+/* emit synthetic messages for the contexts closed during a sweep; must
+ * be called without the lock held.  The contexts on the list are already
+ * detached from the state hash and the timer wheel, so they are
+ * exclusively ours here and workers can enter _perform_groupby() while
+ * the expensive template formatting and emission runs. */
+static void
+grouping_by_flush_expired_entries(GroupingBy *self)
+{
+  GList *expired, *l;
+
+  g_static_mutex_lock(&self->lock);
+  expired = g_list_reverse(self->expired_contexts);
+  self->expired_contexts = NULL;
+  g_static_mutex_unlock(&self->lock);
+
+  for (l = expired; l; l = l->next)
+    {
+      CorrellationContext *context = (CorrellationContext *) l->data;
+
+      grouping_by_emit_synthetic(self, context);
+      correllation_context_unref(context);
+    }
+  g_list_free(expired);
 }
 
 
@@ -344,6 +382,10 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
 
   g_static_mutex_unlock(&self->lock);
 
+  /* emit before the triggering message moves on, so synthetic messages
+   * still precede it downstream */
+  grouping_by_flush_expired_entries(self);
+
   if (context)
     log_msg_write_protect(msg);
 
@@ -427,6 +469,8 @@ grouping_by_free(LogPipe *s)
   GroupingBy *self = (GroupingBy *) s;
 
   g_static_mutex_free(&self->lock);
+  g_list_foreach(self->expired_contexts, (GFunc) correllation_context_unref, NULL);
+  g_list_free(self->expired_contexts);
   log_template_unref(self->key_template);
   if (self->synthetic_message)
     synthetic_message_free(self->synthetic_message);
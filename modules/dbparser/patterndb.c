@@ -58,11 +58,21 @@ struct _PDBLookupParams
 
 struct _PatternDB
 {
+  /* protects the ruleset pointer: taken as a reader while processing
+   * messages and as a writer when the ruleset is reloaded */
   GStaticRWLock lock;
   PDBRuleSet *ruleset;
+  /* protects the correllation contexts, the timer wheel, the rate limit
+   * states and last_tick; rule matching itself runs outside of this
+   * lock, so only messages that need correllation or trigger actions
+   * serialize on it */
+  GStaticMutex state_lock;
   CorrellationState correllation;
   GHashTable *rate_limits;
   TimerWheel *timer_wheel;
+  /* expiration budget applied to the timer wheel, survives
+   * pattern_db_forget_state() which recreates the wheel */
+  gint expiration_batch;
   GTimeVal last_tick;
   PatternDBEmitFunc emit;
   gpointer emit_data;
@@ -177,6 +187,50 @@ pdb_rate_limit_free(PDBRateLimit *self)
   g_free(self);
 }
 
+/***************************************************************************
+ * PDBLookupScratch, per-thread radix lookup state
+ ***************************************************************************/
+
+/* match arrays used by the radix tree lookup, kept in thread private
+ * storage so that concurrent pattern_db_process() invocations neither
+ * share state nor allocate/free them for each message */
+typedef struct _PDBLookupScratch
+{
+  GArray *prg_matches;
+  GArray *matches;
+} PDBLookupScratch;
+
+static GStaticPrivate pdb_lookup_scratch_private = G_STATIC_PRIVATE_INIT;
+
+static void
+pdb_lookup_scratch_free(gpointer s)
+{
+  PDBLookupScratch *self = (PDBLookupScratch *) s;
+
+  g_array_free(self->prg_matches, TRUE);
+  g_array_free(self->matches, TRUE);
+  g_free(self);
+}
+
+static PDBLookupScratch *
+pdb_lookup_scratch_get(void)
+{
+  PDBLookupScratch *self = g_static_private_get(&pdb_lookup_scratch_private);
+
+  if (!self)
+    {
+      self = g_new0(PDBLookupScratch, 1);
+
+      /* NOTE: We're not using g_array_sized_new as that does not
+       * correctly zero-initialize the new items even if clear_ is TRUE
+       */
+      self->prg_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+      self->matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+      g_static_private_set(&pdb_lookup_scratch_private, self, pdb_lookup_scratch_free);
+    }
+  return self;
+}
+
 /*********************************************
  * Rule evaluation
  *********************************************/
@@ -351,6 +405,7 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
 {
   RNode *node;
   LogMessage *msg = lookup->msg;
+  PDBLookupScratch *scratch;
   GArray *prg_matches, *matches;
   const gchar *program;
   gssize program_len;
@@ -358,14 +413,21 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
   if (G_UNLIKELY(!self->programs))
     return FALSE;
 
+  scratch = pdb_lookup_scratch_get();
   program = log_msg_get_value(msg, lookup->program_handle, &program_len);
-  prg_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+
+  /* the filter only produces negatives the radix walk below would also
+   * produce, just without touching the tree */
+  if (!pdb_rule_set_program_may_have_rules(self, program, program_len))
+    return NULL;
+
+  prg_matches = scratch->prg_matches;
+  g_array_set_size(prg_matches, 0);
   node = r_find_node(self->programs, (guint8 *) program, program_len, prg_matches);
 
   if (node)
     {
       _add_matches_to_message(msg, prg_matches, lookup->program_handle, program);
-      g_array_free(prg_matches, TRUE);
 
       PDBProgram *program = (PDBProgram *) node->value;
 
@@ -375,11 +437,8 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
           const gchar *message;
           gssize message_len;
 
-          /* NOTE: We're not using g_array_sized_new as that does not
-           * correctly zero-initialize the new items even if clear_ is TRUE
-           */
-
-          matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+          matches = scratch->matches;
+          g_array_set_size(matches, 0);
           g_array_set_size(matches, 1);
 
           if (lookup->message_handle)
@@ -400,7 +459,6 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
           if (msg_node)
             {
               PDBRule *rule = (PDBRule *) msg_node->value;
-              GString *buffer = g_string_sized_new(32);
 
               msg_debug("patterndb rule matches",
                         evt_tag_str("rule_id", rule->rule_id),
@@ -409,14 +467,12 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
               log_msg_set_value(msg, rule_id_handle, rule->rule_id, -1);
 
               _add_matches_to_message(msg, matches, lookup->message_handle, message);
-              g_array_free(matches, TRUE);
 
               if (!rule->class)
                 {
                   log_msg_set_tag_by_id(msg, system_tag);
                 }
               log_msg_clear_tag_by_id(msg, unknown_tag);
-              g_string_free(buffer, TRUE);
               pdb_rule_ref(rule);
               return rule;
             }
@@ -425,13 +481,8 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
               log_msg_set_value(msg, class_handle, "unknown", 7);
               log_msg_set_tag_by_id(msg, unknown_tag);
             }
-          g_array_free(matches, TRUE);
         }
     }
-  else
-    {
-      g_array_free(prg_matches, TRUE);
-    }
 
   return NULL;
 
@@ -441,8 +492,7 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
  * PatternDB
  *********************************************************/
 
-/* NOTE: this function requires PatternDB reader/writer lock to be
- * write-locked.
+/* NOTE: this function requires the PatternDB state_lock to be held.
  *
  * Currently, it is, as timer_wheel_set_time() is only called with that
  * precondition, and timer-wheel callbacks are only called from within
@@ -485,7 +535,7 @@ pattern_db_timer_tick(PatternDB *self)
   GTimeVal now;
   glong diff;
 
-  g_static_rw_lock_writer_lock(&self->lock);
+  g_static_mutex_lock(&self->state_lock);
   cached_g_current_time(&now);
   diff = g_time_val_diff(&now, &self->last_tick);
 
@@ -510,10 +560,10 @@ pattern_db_timer_tick(PatternDB *self)
        */
       self->last_tick = now;
     }
-  g_static_rw_lock_writer_unlock(&self->lock);
+  g_static_mutex_unlock(&self->state_lock);
 }
 
-/* NOTE: lock should be acquired for writing before calling this function. */
+/* NOTE: state_lock should be acquired before calling this function. */
 void
 pattern_db_set_time(PatternDB *self, const LogStamp *ls)
 {
@@ -599,15 +649,18 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
   if (G_UNLIKELY(!self->ruleset))
     return FALSE;
 
+  /* NOTE: the reader lock is held for the whole processing so that the
+   * ruleset is not swapped out by a reload while the matched rule is in
+   * use; concurrent process calls only contend on state_lock and only
+   * if they correllate or run actions */
   g_static_rw_lock_reader_lock(&self->lock);
   rule = pdb_lookup_ruleset(self->ruleset, lookup, dbg_list);
-  g_static_rw_lock_reader_unlock(&self->lock);
   if (rule)
     {
       PDBContext *context = NULL;
       GString *buffer = g_string_sized_new(32);
 
-      g_static_rw_lock_writer_lock(&self->lock);
+      g_static_mutex_lock(&self->state_lock);
       pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
       if (rule->context_id_template)
         {
@@ -659,31 +712,47 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
                 pdb_rule_unref(context->rule);
               context->rule = pdb_rule_ref(rule);
             }
+
+          synthetic_message_apply(&rule->msg, &context->super, msg, buffer);
+          if (self->emit)
+            {
+              self->emit(msg, FALSE, self->emit_data);
+              pdb_run_rule_actions(rule, self, RAT_MATCH, context, msg, buffer);
+            }
+          g_static_mutex_unlock(&self->state_lock);
+
+          log_msg_write_protect(msg);
         }
       else
         {
-          context = NULL;
-        }
+          g_static_mutex_unlock(&self->state_lock);
 
-      synthetic_message_apply(&rule->msg, &context->super, msg, buffer);
-      if (self->emit)
-        {
-          self->emit(msg, FALSE, self->emit_data);
-          pdb_run_rule_actions(rule, self, RAT_MATCH, context, msg, buffer);
+          /* no correllation: the message is private to this thread, no
+           * need to serialize on the state lock except for the action
+           * rate limit states */
+          synthetic_message_apply(&rule->msg, NULL, msg, buffer);
+          if (self->emit)
+            {
+              self->emit(msg, FALSE, self->emit_data);
+              if (rule->actions)
+                {
+                  g_static_mutex_lock(&self->state_lock);
+                  pdb_run_rule_actions(rule, self, RAT_MATCH, NULL, msg, buffer);
+                  g_static_mutex_unlock(&self->state_lock);
+                }
+            }
         }
       pdb_rule_unref(rule);
-      g_static_rw_lock_writer_unlock(&self->lock);
-
-      if (context)
-        log_msg_write_protect(msg);
+      g_static_rw_lock_reader_unlock(&self->lock);
 
       g_string_free(buffer, TRUE);
     }
   else
     {
-      g_static_rw_lock_writer_lock(&self->lock);
+      g_static_rw_lock_reader_unlock(&self->lock);
+      g_static_mutex_lock(&self->state_lock);
       pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
-      g_static_rw_lock_writer_unlock(&self->lock);
+      g_static_mutex_unlock(&self->state_lock);
       if (self->emit)
         self->emit(msg, FALSE, self->emit_data);
     }
@@ -729,12 +798,58 @@ pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list)
   _pattern_db_process(self, &lookup, dbg_list);
 }
 
+/*
+ * Limits the number of correllation contexts expired by a single
+ * (message or tick driven) time update, so that a context storm does not
+ * stall the thread processing the message that moved the clock.  The
+ * remainder is reported by pattern_db_has_pending_expirations() and is
+ * drained with repeated pattern_db_process_pending_expirations() calls.
+ */
+void
+pattern_db_set_expiration_batch(PatternDB *self, gint max_batch)
+{
+  g_static_mutex_lock(&self->state_lock);
+  self->expiration_batch = max_batch;
+  timer_wheel_set_max_expiration_batch(self->timer_wheel, max_batch);
+  g_static_mutex_unlock(&self->state_lock);
+}
+
+gboolean
+pattern_db_has_pending_expirations(PatternDB *self)
+{
+  gboolean pending;
+
+  g_static_mutex_lock(&self->state_lock);
+  pending = timer_wheel_has_pending_expirations(self->timer_wheel);
+  g_static_mutex_unlock(&self->state_lock);
+  return pending;
+}
+
+void
+pattern_db_process_pending_expirations(PatternDB *self)
+{
+  g_static_mutex_lock(&self->state_lock);
+  timer_wheel_process_pending(self->timer_wheel);
+  g_static_mutex_unlock(&self->state_lock);
+}
+
+gint
+pattern_db_get_timer_count(PatternDB *self)
+{
+  gint num_timers;
+
+  g_static_mutex_lock(&self->state_lock);
+  num_timers = timer_wheel_get_timer_count(self->timer_wheel);
+  g_static_mutex_unlock(&self->state_lock);
+  return num_timers;
+}
+
 void
 pattern_db_expire_state(PatternDB *self)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
+  g_static_mutex_lock(&self->state_lock);
   timer_wheel_expire_all(self->timer_wheel);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  g_static_mutex_unlock(&self->state_lock);
 }
 
 static void
@@ -743,6 +858,7 @@ _init_state(PatternDB *self)
   self->rate_limits = g_hash_table_new_full(correllation_key_hash, correllation_key_equal, NULL, (GDestroyNotify) pdb_rate_limit_free);
   correllation_state_init_instance(&self->correllation);
   self->timer_wheel = timer_wheel_new();
+  timer_wheel_set_max_expiration_batch(self->timer_wheel, self->expiration_batch);
   timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
 }
 
@@ -759,10 +875,10 @@ _destroy_state(PatternDB *self)
 void
 pattern_db_forget_state(PatternDB *self)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
+  g_static_mutex_lock(&self->state_lock);
   _destroy_state(self);
   _init_state(self);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  g_static_mutex_unlock(&self->state_lock);
 }
 
 PatternDB *
@@ -774,6 +890,7 @@ pattern_db_new(void)
   _init_state(self);
   cached_g_current_time(&self->last_tick);
   g_static_rw_lock_init(&self->lock);
+  g_static_mutex_init(&self->state_lock);
   return self;
 }
 
@@ -784,6 +901,7 @@ pattern_db_free(PatternDB *self)
     pdb_rule_set_free(self->ruleset);
   _destroy_state(self);
   g_static_rw_lock_free(&self->lock);
+  g_static_mutex_free(&self->state_lock);
   g_free(self);
 }
 
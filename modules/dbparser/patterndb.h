@@ -43,6 +43,10 @@ void pattern_db_timer_tick(PatternDB *self);
 gboolean pattern_db_process(PatternDB *self, LogMessage *msg);
 gboolean pattern_db_process_with_custom_message(PatternDB *self, LogMessage *msg, const gchar *message, gssize message_len);
 void pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list);
+void pattern_db_set_expiration_batch(PatternDB *self, gint max_batch);
+gboolean pattern_db_has_pending_expirations(PatternDB *self);
+void pattern_db_process_pending_expirations(PatternDB *self);
+gint pattern_db_get_timer_count(PatternDB *self);
 void pattern_db_expire_state(PatternDB *self);
 void pattern_db_forget_state(PatternDB *self);
 
@@ -276,6 +276,7 @@ pdb_loader_end_element(GMarkupParseContext *context, const gchar *element_name,
 
   if (strcmp(element_name, "patterndb") == 0)
     {
+      pdb_rule_set_build_program_filter(state->ruleset, state->ruleset_patterns);
       g_hash_table_foreach(state->ruleset_patterns, _populate_ruleset_radix, state);
       g_hash_table_remove_all(state->ruleset_patterns);
     }
@@ -544,6 +545,7 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (state.load_examples)
     *examples = state.examples;
 
+  pdb_rule_set_freeze(self);
   success = TRUE;
 
  error:
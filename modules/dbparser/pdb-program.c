@@ -46,6 +46,17 @@ pdb_program_ref(PDBProgram *self)
   return self;
 }
 
+/* compact the rules tree into a contiguous arena once loading is
+ * finished; programs may be referenced from multiple radix nodes
+ * (aliases), so this may be invoked multiple times */
+void
+pdb_program_freeze(PDBProgram *self)
+{
+  if (!self->rules || self->frozen_arena)
+    return;
+  self->rules = r_freeze_node(self->rules, &self->frozen_arena);
+}
+
 void
 pdb_program_unref(PDBProgram *s)
 {
@@ -53,7 +64,12 @@ pdb_program_unref(PDBProgram *s)
 
   if (--self->ref_cnt == 0)
     {
-      if (self->rules)
+      if (self->frozen_arena)
+        {
+          r_free_frozen_node(self->rules, (void (*)(void *)) pdb_rule_unref);
+          g_free(self->frozen_arena);
+        }
+      else if (self->rules)
         r_free_node(self->rules, (void (*)(void *)) pdb_rule_unref);
 
       g_free(self);
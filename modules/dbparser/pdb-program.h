@@ -36,10 +36,13 @@ typedef struct _PDBProgram
 {
   guint ref_cnt;
   RNode *rules;
+  /* backing store of the rules tree once frozen, NULL while loading */
+  gpointer frozen_arena;
 } PDBProgram;
 
 PDBProgram *pdb_program_new(void);
 PDBProgram *pdb_program_ref(PDBProgram *self);
+void pdb_program_freeze(PDBProgram *self);
 void pdb_program_unref(PDBProgram *s);
 
 #endif
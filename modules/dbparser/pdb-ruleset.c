@@ -22,6 +22,9 @@
  */
 #include "pdb-ruleset.h"
 #include "pdb-program.h"
+#include "fasthash.h"
+
+#include <string.h>
 
 PDBRuleSet *
 pdb_rule_set_new(void)
@@ -31,11 +34,142 @@ pdb_rule_set_new(void)
   return self;
 }
 
+/* Most traffic is emitted by programs that have no rules at all; their
+ * lookups used to pay for a full radix walk just to come back empty.
+ * The program patterns are known at load time, so a small Bloom filter
+ * over them answers "can this program have rules?" from a couple of
+ * cache lines and lets the no-rule majority skip the tree entirely.
+ * Two probes out of ~16 bits allocated per pattern keep the false
+ * positive rate (which only costs the old radix walk) around 1-2%. */
+
+#define PDB_PROGRAM_BLOOM_BITS_PER_ENTRY 16
+
+static guint32
+_program_hash2(const gchar *program, gssize len)
+{
+  guint32 h = 5381;
+  gssize i;
+
+  for (i = 0; i < len; i++)
+    h = (h << 5) + h + (guchar) program[i];
+  /* the second probe must differ from the first even if the hashes
+   * collide */
+  return h | 1;
+}
+
+static void
+_program_bloom_set(PDBRuleSet *self, guint32 hash)
+{
+  guint32 bit = hash & self->program_bloom_mask;
+
+  self->program_bloom[bit >> 5] |= 1U << (bit & 31);
+}
+
+static gboolean
+_program_bloom_test(PDBRuleSet *self, guint32 hash)
+{
+  guint32 bit = hash & self->program_bloom_mask;
+
+  return (self->program_bloom[bit >> 5] & (1U << (bit & 31))) != 0;
+}
+
+static void
+_add_program_pattern_to_filter(gpointer key, gpointer value, gpointer user_data)
+{
+  PDBRuleSet *self = (PDBRuleSet *) user_data;
+  const gchar *pattern = (const gchar *) key;
+  guint32 h1, h2;
+
+  if (self->program_bloom_disabled)
+    return;
+  if (strchr(pattern, '@'))
+    {
+      /* the pattern contains a parser (or an escaped @): it can match
+       * program names we cannot enumerate, a pre-check would produce
+       * false negatives */
+      self->program_bloom_disabled = TRUE;
+      return;
+    }
+  h1 = fast_hash(pattern, strlen(pattern));
+  h2 = _program_hash2(pattern, strlen(pattern));
+  _program_bloom_set(self, h1);
+  _program_bloom_set(self, h1 + h2);
+}
+
+void
+pdb_rule_set_build_program_filter(PDBRuleSet *self, GHashTable *program_patterns)
+{
+  if (self->program_bloom_disabled)
+    return;
+  if (!self->program_bloom)
+    {
+      guint32 nbits = 256;
+
+      while (nbits < g_hash_table_size(program_patterns) * PDB_PROGRAM_BLOOM_BITS_PER_ENTRY)
+        nbits <<= 1;
+      self->program_bloom = g_new0(guint32, nbits >> 5);
+      self->program_bloom_mask = nbits - 1;
+    }
+  g_hash_table_foreach(program_patterns, _add_program_pattern_to_filter, self);
+  if (self->program_bloom_disabled)
+    {
+      g_free(self->program_bloom);
+      self->program_bloom = NULL;
+    }
+}
+
+gboolean
+pdb_rule_set_program_may_have_rules(PDBRuleSet *self, const gchar *program, gssize program_len)
+{
+  guint32 h1, h2;
+
+  /* rules without a program pattern hang off the radix root and are
+   * found with an empty program name, the filter does not cover them */
+  if (!self->program_bloom || program_len == 0)
+    return TRUE;
+  h1 = fast_hash(program, program_len);
+  h2 = _program_hash2(program, program_len);
+  return _program_bloom_test(self, h1) && _program_bloom_test(self, h1 + h2);
+}
+
+static void
+_freeze_programs(RNode *node)
+{
+  gint i;
+
+  if (node->value)
+    pdb_program_freeze((PDBProgram *) node->value);
+
+  for (i = 0; i < node->num_children; i++)
+    _freeze_programs(node->children[i]);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    _freeze_programs(node->pchildren[i]);
+}
+
+/* relayout the radix trees into contiguous, read-only arenas after a
+ * successful load, see r_freeze_node() */
+void
+pdb_rule_set_freeze(PDBRuleSet *self)
+{
+  if (!self->programs || self->frozen_arena)
+    return;
+  self->programs = r_freeze_node(self->programs, &self->frozen_arena);
+  _freeze_programs(self->programs);
+}
+
 void
 pdb_rule_set_free(PDBRuleSet *self)
 {
-  if (self->programs)
+  if (self->frozen_arena)
+    {
+      r_free_frozen_node(self->programs, (GDestroyNotify) pdb_program_unref);
+      g_free(self->frozen_arena);
+    }
+  else if (self->programs)
     r_free_node(self->programs, (GDestroyNotify) pdb_program_unref);
+  if (self->program_bloom)
+    g_free(self->program_bloom);
   if (self->version)
     g_free(self->version);
   if (self->pub_date)
@@ -30,11 +30,23 @@
 typedef struct _PDBRuleSet
 {
   RNode *programs;
+  /* backing store of the programs tree once frozen, NULL while loading */
+  gpointer frozen_arena;
+  /* Bloom filter over the literal program patterns, consulted before
+   * walking the programs radix tree; NULL when not built, disabled
+   * outright once any program pattern contains a parser, as those can
+   * match programs the filter has never seen */
+  guint32 *program_bloom;
+  guint32 program_bloom_mask;
+  gboolean program_bloom_disabled;
   gchar *version;
   gchar *pub_date;
 } PDBRuleSet;
 
 PDBRuleSet *pdb_rule_set_new(void);
+void pdb_rule_set_build_program_filter(PDBRuleSet *self, GHashTable *program_patterns);
+gboolean pdb_rule_set_program_may_have_rules(PDBRuleSet *self, const gchar *program, gssize program_len);
+void pdb_rule_set_freeze(PDBRuleSet *self);
 void pdb_rule_set_free(PDBRuleSet *self);
 
 #endif
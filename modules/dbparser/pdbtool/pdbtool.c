@@ -25,6 +25,7 @@
 #include "messages.h"
 #include "template/templates.h"
 #include "misc.h"
+#include "timeutils.h"
 #include "patterndb.h"
 #include "dbparser.h"
 #include "radix.h"
@@ -385,7 +386,7 @@ pdbtool_pdb_emit(LogMessage *msg, gboolean synthetic, gpointer user_data)
           if (debug_pattern && !debug_pattern_parse)
             printf("\nValues:\n");
 
-          nv_table_foreach(msg->payload, logmsg_registry, pdbtool_match_values, ret);
+          log_msg_values_foreach(msg, pdbtool_match_values, ret);
           g_string_truncate(output, 0);
           log_msg_print_tags(msg, output);
           printf("TAGS=%s\n", output->str);
@@ -519,7 +520,7 @@ pdbtool_match(int argc, char *argv[])
         {
           log_msg_unref(msg);
           msg = log_msg_new_empty();
-          parse_options.format_handler->parse(&parse_options, buf, buflen, msg);
+          parse_options.parse(&parse_options, buf, buflen, msg);
         }
 
       if (G_UNLIKELY(debug_pattern))
@@ -859,6 +860,272 @@ static GOptionEntry test_options[] =
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
+static gchar *benchmark_file = NULL;
+static gint benchmark_workers = 1;
+
+typedef struct _PdbToolBenchmarkWorker
+{
+  PatternDB *patterndb;
+  GPtrArray *messages;
+  guint first;
+  guint last;
+  guint matched;
+  GHashTable *rule_hits;
+  GThread *thread;
+} PdbToolBenchmarkWorker;
+
+static void
+pdbtool_benchmark_count_rule(PdbToolBenchmarkWorker *self, LogMessage *msg)
+{
+  const gchar *rule_id;
+  gssize rule_id_len;
+  gpointer orig_key, hits;
+
+  rule_id = log_msg_get_value_by_name(msg, ".classifier.rule_id", &rule_id_len);
+  if (!rule_id || rule_id_len == 0)
+    return;
+
+  if (g_hash_table_lookup_extended(self->rule_hits, rule_id, &orig_key, &hits))
+    g_hash_table_insert(self->rule_hits, orig_key, GUINT_TO_POINTER(GPOINTER_TO_UINT(hits) + 1));
+  else
+    g_hash_table_insert(self->rule_hits, g_strndup(rule_id, rule_id_len), GUINT_TO_POINTER(1));
+}
+
+static gpointer
+pdbtool_benchmark_worker_thread(gpointer s)
+{
+  PdbToolBenchmarkWorker *self = (PdbToolBenchmarkWorker *) s;
+  guint i;
+
+  for (i = self->first; i < self->last; i++)
+    {
+      LogMessage *msg = (LogMessage *) g_ptr_array_index(self->messages, i);
+
+      if (pattern_db_process(self->patterndb, msg))
+        {
+          self->matched++;
+          pdbtool_benchmark_count_rule(self, msg);
+        }
+    }
+  return NULL;
+}
+
+static void
+pdbtool_benchmark_merge_hits(gpointer key, gpointer value, gpointer user_data)
+{
+  GHashTable *combined = (GHashTable *) user_data;
+  gpointer hits;
+
+  hits = g_hash_table_lookup(combined, key);
+  g_hash_table_insert(combined, key, GUINT_TO_POINTER(GPOINTER_TO_UINT(hits) + GPOINTER_TO_UINT(value)));
+}
+
+typedef struct _PdbToolBenchmarkHit
+{
+  const gchar *rule_id;
+  guint hits;
+} PdbToolBenchmarkHit;
+
+static void
+pdbtool_benchmark_collect_hit(gpointer key, gpointer value, gpointer user_data)
+{
+  GPtrArray *hit_list = (GPtrArray *) user_data;
+  PdbToolBenchmarkHit *hit = g_new(PdbToolBenchmarkHit, 1);
+
+  hit->rule_id = (const gchar *) key;
+  hit->hits = GPOINTER_TO_UINT(value);
+  g_ptr_array_add(hit_list, hit);
+}
+
+static gint
+pdbtool_benchmark_compare_hits(gconstpointer a, gconstpointer b)
+{
+  const PdbToolBenchmarkHit *hit_a = *(PdbToolBenchmarkHit **) a;
+  const PdbToolBenchmarkHit *hit_b = *(PdbToolBenchmarkHit **) b;
+
+  if (hit_a->hits != hit_b->hits)
+    return hit_a->hits < hit_b->hits ? 1 : -1;
+  return strcmp(hit_a->rule_id, hit_b->rule_id);
+}
+
+static GPtrArray *
+pdbtool_benchmark_load_corpus(MsgFormatOptions *parse_options, LogProtoServerOptions *proto_options)
+{
+  GPtrArray *messages;
+  LogTransport *transport;
+  LogProtoServer *proto;
+  const guchar *buf = NULL;
+  gsize buflen;
+  gboolean may_read = TRUE;
+  gint fd;
+
+  if (strcmp(benchmark_file, "-") == 0)
+    {
+      fd = 0;
+    }
+  else
+    {
+      fd = open(benchmark_file, O_RDONLY);
+      if (fd < 0)
+        {
+          fprintf(stderr, "Error opening file to be processed: %s\n", g_strerror(errno));
+          return NULL;
+        }
+    }
+  transport = log_transport_file_new(fd);
+  proto = log_proto_text_server_new(transport, proto_options);
+
+  messages = g_ptr_array_sized_new(65536);
+  while (log_proto_server_fetch(proto, &buf, &buflen, &may_read, NULL, NULL) == LPS_SUCCESS)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      parse_options->parse(parse_options, buf, buflen, msg);
+      g_ptr_array_add(messages, msg);
+      buf = NULL;
+    }
+  log_proto_server_free(proto);
+  return messages;
+}
+
+static gint
+pdbtool_benchmark(int argc, char *argv[])
+{
+  PatternDB *patterndb;
+  PdbToolBenchmarkWorker *workers;
+  GPtrArray *messages = NULL;
+  GHashTable *combined;
+  GPtrArray *hit_list;
+  MsgFormatOptions parse_options;
+  LogProtoServerOptions proto_options;
+  GTimeVal start, end;
+  glong elapsed_usec;
+  guint matched = 0;
+  gint ret = 1;
+  guint i;
+
+  if (!benchmark_file)
+    {
+      fprintf(stderr, "The -f option is required to specify the message corpus\n");
+      return 1;
+    }
+  if (benchmark_workers < 1)
+    {
+      fprintf(stderr, "The number of workers must be at least 1\n");
+      return 1;
+    }
+
+  if (!g_thread_supported())
+    g_thread_init(NULL);
+
+  memset(&parse_options, 0, sizeof(parse_options));
+  msg_format_options_defaults(&parse_options);
+  /* the syslog protocol parser automatically falls back to RFC3164 format */
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_EXPECT_HOSTNAME;
+  msg_format_options_init(&parse_options, configuration);
+  log_proto_server_options_defaults(&proto_options);
+  proto_options.max_msg_size = 65536;
+  log_proto_server_options_init(&proto_options, configuration);
+
+  patterndb = pattern_db_new();
+  if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
+    goto error;
+
+  /* parsing the corpus up front keeps the syslog parser out of the
+   * timed section, what remains is the cost of the ruleset itself */
+  messages = pdbtool_benchmark_load_corpus(&parse_options, &proto_options);
+  if (!messages)
+    goto error;
+  if (messages->len == 0)
+    {
+      fprintf(stderr, "The message corpus is empty\n");
+      goto error;
+    }
+
+  workers = g_new0(PdbToolBenchmarkWorker, benchmark_workers);
+  for (i = 0; i < (guint) benchmark_workers; i++)
+    {
+      workers[i].patterndb = patterndb;
+      workers[i].messages = messages;
+      workers[i].first = (messages->len * i) / benchmark_workers;
+      workers[i].last = (messages->len * (i + 1)) / benchmark_workers;
+      workers[i].rule_hits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+  g_get_current_time(&start);
+  if (benchmark_workers == 1)
+    {
+      pdbtool_benchmark_worker_thread(&workers[0]);
+    }
+  else
+    {
+      for (i = 0; i < (guint) benchmark_workers; i++)
+        workers[i].thread = g_thread_create(pdbtool_benchmark_worker_thread, &workers[i], TRUE, NULL);
+      for (i = 0; i < (guint) benchmark_workers; i++)
+        g_thread_join(workers[i].thread);
+    }
+  g_get_current_time(&end);
+  elapsed_usec = g_time_val_diff(&end, &start);
+  if (elapsed_usec <= 0)
+    elapsed_usec = 1;
+
+  combined = g_hash_table_new(g_str_hash, g_str_equal);
+  for (i = 0; i < (guint) benchmark_workers; i++)
+    {
+      matched += workers[i].matched;
+      g_hash_table_foreach(workers[i].rule_hits, pdbtool_benchmark_merge_hits, combined);
+    }
+
+  printf("Processed %u messages in %.3f seconds using %d worker(s)\n",
+         messages->len, elapsed_usec / (gdouble) G_USEC_PER_SEC, benchmark_workers);
+  printf("Matched %u messages (%.2f%%), %.0f messages/sec, %.0f ns/message\n",
+         matched, matched * 100.0 / messages->len,
+         messages->len / (elapsed_usec / (gdouble) G_USEC_PER_SEC),
+         elapsed_usec * 1000.0 / messages->len);
+
+  hit_list = g_ptr_array_new();
+  g_hash_table_foreach(combined, pdbtool_benchmark_collect_hit, hit_list);
+  g_ptr_array_sort(hit_list, pdbtool_benchmark_compare_hits);
+  for (i = 0; i < hit_list->len; i++)
+    {
+      PdbToolBenchmarkHit *hit = (PdbToolBenchmarkHit *) g_ptr_array_index(hit_list, i);
+
+      printf("%9u %s\n", hit->hits, hit->rule_id);
+      g_free(hit);
+    }
+  g_ptr_array_free(hit_list, TRUE);
+  g_hash_table_destroy(combined);
+
+  for (i = 0; i < (guint) benchmark_workers; i++)
+    g_hash_table_destroy(workers[i].rule_hits);
+  g_free(workers);
+  ret = 0;
+
+  pattern_db_expire_state(patterndb);
+ error:
+  if (messages)
+    {
+      for (i = 0; i < messages->len; i++)
+        log_msg_unref((LogMessage *) g_ptr_array_index(messages, i));
+      g_ptr_array_free(messages, TRUE);
+    }
+  pattern_db_free(patterndb);
+  msg_format_options_destroy(&parse_options);
+
+  return ret;
+}
+
+static GOptionEntry benchmark_options[] =
+{
+  { "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>" },
+  { "file", 'f', 0, G_OPTION_ARG_STRING, &benchmark_file,
+    "Read the message corpus from the file specified, use '-' for stdin", NULL },
+  { "workers", 'W', 0, G_OPTION_ARG_INT, &benchmark_workers,
+    "Number of threads matching messages in parallel (default: 1)", "<workers>" },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static gboolean dump_program_tree = FALSE;
 
 void
@@ -1140,6 +1407,7 @@ static struct
   { "dump", dump_options, "Dump pattern datebase tree", pdbtool_dump },
   { "merge", merge_options, "Merge pattern databases", pdbtool_merge },
   { "test", test_options, "Test pattern databases", pdbtool_test },
+  { "benchmark", benchmark_options, "Benchmark a pattern database against a message corpus", pdbtool_benchmark },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
   { NULL, NULL },
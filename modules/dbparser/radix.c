@@ -1524,3 +1524,158 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
 
   g_free(node);
 }
+
+/**************************************************************
+ * Frozen (read-only) trees.
+ **************************************************************/
+
+#define R_ARENA_ALIGN(s) (((s) + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1))
+
+static gsize
+r_frozen_node_size(RNode *node)
+{
+  gsize size = R_ARENA_ALIGN(sizeof(RNode));
+  gint i;
+
+  if (node->key)
+    size += R_ARENA_ALIGN(node->keylen + 1);
+  size += R_ARENA_ALIGN(node->num_children * sizeof(RNode *));
+  size += R_ARENA_ALIGN(node->num_pchildren * sizeof(RNode *));
+
+  for (i = 0; i < node->num_children; i++)
+    size += r_frozen_node_size(node->children[i]);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    size += r_frozen_node_size(node->pchildren[i]);
+
+  return size;
+}
+
+/* free the shell of an already frozen tree: node structures, keys and
+ * child arrays, but neither parsers nor values, those were moved over to
+ * the frozen copy */
+static void
+r_free_node_shell(RNode *node)
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    r_free_node_shell(node->children[i]);
+
+  if (node->children)
+    g_free(node->children);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    r_free_node_shell(node->pchildren[i]);
+
+  if (node->pchildren)
+    g_free(node->pchildren);
+
+  if (node->key)
+    g_free(node->key);
+
+  g_free(node);
+}
+
+typedef struct _RFreezeItem
+{
+  RNode *node;
+  RNode **slot;
+} RFreezeItem;
+
+static void
+r_freeze_enqueue(GQueue *queue, RNode *node, RNode **slot)
+{
+  RFreezeItem *item = g_new(RFreezeItem, 1);
+
+  item->node = node;
+  item->slot = slot;
+  g_queue_push_tail(queue, item);
+}
+
+/**
+ * r_freeze_node:
+ *
+ * Copy a fully built tree into a single, contiguous arena, laying the
+ * nodes out in breadth-first order so siblings probed by the binary
+ * search in r_find_child_by_first_character() share cache lines.  The
+ * original tree is freed, parser descriptors and values are moved over
+ * to the copy.  Returns the frozen root, the arena itself is stored
+ * into *arena and must outlive the returned tree.  Frozen trees must
+ * not be modified and are to be freed with r_free_frozen_node() plus a
+ * g_free() on the arena.
+ **/
+RNode *
+r_freeze_node(RNode *root, gpointer *arena)
+{
+  RNode *frozen_root = NULL;
+  RFreezeItem *item;
+  GQueue *queue = g_queue_new();
+  gchar *pos;
+
+  pos = *arena = g_malloc(r_frozen_node_size(root));
+
+  r_freeze_enqueue(queue, root, &frozen_root);
+  while ((item = g_queue_pop_head(queue)) != NULL)
+    {
+      RNode *node = item->node;
+      RNode *copy = (RNode *) pos;
+      gint i;
+
+      pos += R_ARENA_ALIGN(sizeof(RNode));
+      *copy = *node;
+      if (node->key)
+        {
+          copy->key = (guint8 *) pos;
+          memcpy(copy->key, node->key, node->keylen + 1);
+          pos += R_ARENA_ALIGN(node->keylen + 1);
+        }
+      if (node->num_children)
+        {
+          copy->children = (RNode **) pos;
+          pos += R_ARENA_ALIGN(node->num_children * sizeof(RNode *));
+        }
+      if (node->num_pchildren)
+        {
+          copy->pchildren = (RNode **) pos;
+          pos += R_ARENA_ALIGN(node->num_pchildren * sizeof(RNode *));
+        }
+      *item->slot = copy;
+      g_free(item);
+
+      for (i = 0; i < node->num_children; i++)
+        r_freeze_enqueue(queue, node->children[i], &copy->children[i]);
+
+      for (i = 0; i < node->num_pchildren; i++)
+        r_freeze_enqueue(queue, node->pchildren[i], &copy->pchildren[i]);
+    }
+  g_queue_free(queue);
+
+  r_free_node_shell(root);
+  return frozen_root;
+}
+
+/**
+ * r_free_frozen_node:
+ *
+ * Release the parsers and values held by a frozen tree.  The node
+ * structures themselves live in the arena returned by r_freeze_node(),
+ * which the caller frees afterwards in one step.
+ **/
+void
+r_free_frozen_node(RNode *node, void (*free_fn)(gpointer data))
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    r_free_frozen_node(node->children[i], free_fn);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    {
+      r_free_pnode_only(node->pchildren[i]->parser);
+      r_free_frozen_node(node->pchildren[i], free_fn);
+    }
+
+  if (node->value && free_fn)
+    free_fn(node->value);
+}
@@ -683,6 +683,37 @@ test_zorp_logs(void)
 
 }
 
+void
+test_frozen(void)
+{
+  RNode *root = r_new_node("", NULL);
+  gpointer arena = NULL;
+
+  insert_node(root, "alma");
+  insert_node(root, "almafa");
+  insert_node(root, "almabor");
+  insert_node(root, "korte");
+  insert_node(root, "ko");
+  insert_node(root, "koro");
+  insert_node(root, "a@NUMBER:szam@aa");
+  insert_node(root, "baa@NUMBER@");
+
+  root = r_freeze_node(root, &arena);
+
+  test_search(root, "alma", TRUE);
+  test_search(root, "almafa", TRUE);
+  test_search(root, "almabor", TRUE);
+  test_search(root, "korte", TRUE);
+  test_search_value(root, "kort", "ko");
+  test_search_value(root, "koromp", "koro");
+  test_search(root, "mmm", FALSE);
+  test_search_matches(root, "a12345aa", "szam", "12345", NULL);
+  test_search_value(root, "baa12345", "baa@NUMBER@");
+
+  r_free_frozen_node(root, NULL);
+  g_free(arena);
+}
+
 
 int
 main(int argc, char *argv[])
@@ -698,6 +729,7 @@ main(int argc, char *argv[])
   test_parsers();
   test_matches();
   test_zorp_logs();
+  test_frozen();
 
   app_shutdown();
   return  (fail ? 1 : 0);
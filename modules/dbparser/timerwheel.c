@@ -131,6 +131,15 @@ struct _TimerWheel
   guint64 now;
   guint64 base;
   gint num_timers;
+  /* limit on the number of callbacks fired by a single
+   * timer_wheel_set_time() invocation, 0 means no limit.  When the limit
+   * is hit, "now" stops short of the requested time and the remaining
+   * expirations are processed by subsequent set_time calls or an
+   * explicit timer_wheel_process_pending(). */
+  gint max_expiration_batch;
+  /* the latest time requested via timer_wheel_set_time(), ahead of
+   * "now" whenever a capped run could not process all expirations */
+  guint64 requested_now;
   gpointer assoc_data;
   GDestroyNotify assoc_data_free;
 };
@@ -290,6 +299,15 @@ timer_wheel_cascade(TimerWheel *self)
 void
 timer_wheel_set_time(TimerWheel *self, guint64 new_now)
 {
+  gint expired = 0;
+
+  if (new_now > self->requested_now)
+    self->requested_now = new_now;
+
+  /* catch up to the latest requested time, a capped run below may have
+   * stopped short of it earlier */
+  new_now = self->requested_now;
+
   /* time is not allowed to go backwards */
   if (self->now >= new_now)
     return;
@@ -316,12 +334,21 @@ timer_wheel_set_time(TimerWheel *self, guint64 new_now)
       head = &self->levels[0]->slots[slot];
       iv_list_for_each_safe(lh, lh_next, head)
         {
+          if (self->max_expiration_batch && expired >= self->max_expiration_batch)
+            {
+              /* expiration budget exhausted: "now" stays on this very
+               * slot, the remaining entries are picked up by the next
+               * set_time call */
+              return;
+            }
+
           entry = iv_list_entry(lh, TWEntry, list);
 
           tw_entry_unlink(entry);
           entry->callback(self, self->now, entry->user_data);
           tw_entry_free(entry);
           self->num_timers--;
+          expired++;
         }
 
       if (self->num_timers == 0)
@@ -336,6 +363,30 @@ timer_wheel_set_time(TimerWheel *self, guint64 new_now)
     }
 }
 
+void
+timer_wheel_set_max_expiration_batch(TimerWheel *self, gint max_batch)
+{
+  self->max_expiration_batch = max_batch;
+}
+
+gboolean
+timer_wheel_has_pending_expirations(TimerWheel *self)
+{
+  return self->num_timers > 0 && self->requested_now > self->now;
+}
+
+void
+timer_wheel_process_pending(TimerWheel *self)
+{
+  timer_wheel_set_time(self, self->requested_now);
+}
+
+gint
+timer_wheel_get_timer_count(TimerWheel *self)
+{
+  return self->num_timers;
+}
+
 guint64
 timer_wheel_get_time(TimerWheel *self)
 {
@@ -346,10 +397,17 @@ void
 timer_wheel_expire_all(TimerWheel *self)
 {
   guint64 now;
+  gint saved_batch;
 
+  /* this is a forced flush (shutdown, state reset), the expiration
+   * budget does not apply here */
+  saved_batch = self->max_expiration_batch;
+  self->max_expiration_batch = 0;
   now = self->now;
   timer_wheel_set_time(self, (guint64) -1);
   self->now = now;
+  self->requested_now = now;
+  self->max_expiration_batch = saved_batch;
 }
 
 static void
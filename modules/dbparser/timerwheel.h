@@ -37,6 +37,10 @@ guint64 timer_wheel_get_timer_expiration(TimerWheel *self, TWEntry *entry);
 
 void timer_wheel_set_time(TimerWheel *self, guint64 new_now);
 guint64 timer_wheel_get_time(TimerWheel *self);
+void timer_wheel_set_max_expiration_batch(TimerWheel *self, gint max_batch);
+gboolean timer_wheel_has_pending_expirations(TimerWheel *self);
+void timer_wheel_process_pending(TimerWheel *self);
+gint timer_wheel_get_timer_count(TimerWheel *self);
 void timer_wheel_expire_all(TimerWheel *self);
 void timer_wheel_set_associated_data(TimerWheel *self, gpointer assoc_data, GDestroyNotify assoc_data_free);
 gpointer timer_wheel_get_associated_data(TimerWheel *self);
@@ -23,17 +23,36 @@
 #include "geoip-parser.h"
 #include "parser/parser-expr.h"
 #include "scratch-buffers.h"
+#include "messages.h"
+#include "stats/stats-registry.h"
+#include "timeutils.h"
 
 #include <GeoIPCity.h>
+#include <sys/stat.h>
+
+/* number of resolved addresses remembered per worker thread; most
+ * deployments see the bulk of their traffic from a few thousand
+ * addresses, so this absorbs nearly all libGeoIP lookups */
+#define GEOIP_CACHE_SIZE 4096
+
+/* how often the database file is checked for changes, in seconds */
+#define GEOIP_DATABASE_CHECK_FREQ 5
 
 typedef struct
 {
   LogParser super;
   GeoIP *gi;
+  GStaticMutex lock;
 
   gchar *database;
   gchar *prefix;
 
+  time_t db_mtime;
+  time_t db_last_check;
+
+  StatsCounterItem *cache_hits;
+  StatsCounterItem *cache_misses;
+
   struct
   {
     gchar *country_code;
@@ -42,6 +61,86 @@ typedef struct
   } dest;
 } GeoIPParser;
 
+/*
+ * Lookup results are cached in a per-thread LRU, following the pattern
+ * of the template function memoization cache: no locking on the hot
+ * path, at the price of each worker warming up its own copy.  Negative
+ * results are cached as well (an entry with all fields NULL).  Whenever
+ * any parser reopens its database the global generation is bumped and
+ * the per-thread caches drop their entries on next use.
+ */
+
+typedef struct _GeoIPCacheEntry
+{
+  /* "<parser pointer>/<ip>", so parsers with different databases don't
+   * see each other's entries */
+  gchar *key;
+  gchar *country_code;
+  gchar *latitude;
+  gchar *longitude;
+  GList *lru_link;
+} GeoIPCacheEntry;
+
+typedef struct _GeoIPCache
+{
+  GHashTable *entries;
+  /* most recently used entries at the head */
+  GQueue *lru;
+  gint generation;
+} GeoIPCache;
+
+static GStaticPrivate geoip_cache_private = G_STATIC_PRIVATE_INIT;
+static gint geoip_database_generation;
+
+static void
+geoip_cache_entry_free(gpointer data)
+{
+  GeoIPCacheEntry *entry = (GeoIPCacheEntry *) data;
+
+  g_free(entry->key);
+  g_free(entry->country_code);
+  g_free(entry->latitude);
+  g_free(entry->longitude);
+  g_free(entry);
+}
+
+static void
+geoip_cache_free(gpointer data)
+{
+  GeoIPCache *cache = (GeoIPCache *) data;
+
+  g_hash_table_destroy(cache->entries);
+  g_queue_free(cache->lru);
+  g_free(cache);
+}
+
+static GeoIPCache *
+geoip_cache_get(void)
+{
+  GeoIPCache *cache = g_static_private_get(&geoip_cache_private);
+  gint generation;
+
+  if (!cache)
+    {
+      cache = g_new0(GeoIPCache, 1);
+      cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, geoip_cache_entry_free);
+      cache->lru = g_queue_new();
+      cache->generation = g_atomic_int_get(&geoip_database_generation);
+      g_static_private_set(&geoip_cache_private, cache, geoip_cache_free);
+    }
+
+  generation = g_atomic_int_get(&geoip_database_generation);
+  if (cache->generation != generation)
+    {
+      /* a database was reloaded, entries resolved from the old one are stale */
+      while (!g_queue_is_empty(cache->lru))
+        g_queue_pop_head(cache->lru);
+      g_hash_table_remove_all(cache->entries);
+      cache->generation = generation;
+    }
+  return cache;
+}
+
 void
 geoip_parser_set_prefix(LogParser *s, const gchar *prefix)
 {
@@ -73,6 +172,89 @@ geoip_parser_set_database(LogParser *s, const gchar *database)
   self->database = g_strdup(database);
 }
 
+/* throttled check whether the database file changed on disk; if so, the
+ * handle is reopened and all cached lookup results are invalidated via
+ * the global generation counter */
+static void
+geoip_parser_check_database(GeoIPParser *self)
+{
+  struct stat st;
+  time_t now = cached_g_current_time_sec();
+
+  if (now - self->db_last_check < GEOIP_DATABASE_CHECK_FREQ)
+    return;
+
+  g_static_mutex_lock(&self->lock);
+  if (now - self->db_last_check >= GEOIP_DATABASE_CHECK_FREQ)
+    {
+      self->db_last_check = now;
+      if (stat(self->database, &st) == 0 && st.st_mtime != self->db_mtime)
+        {
+          GeoIP *gi = GeoIP_open(self->database, GEOIP_MMAP_CACHE);
+
+          if (gi)
+            {
+              GeoIP_delete(self->gi);
+              self->gi = gi;
+              self->db_mtime = st.st_mtime;
+              g_atomic_int_inc(&geoip_database_generation);
+              msg_notice("GeoIP database changed on disk, reloaded",
+                         evt_tag_str("database", self->database),
+                         NULL);
+            }
+        }
+    }
+  g_static_mutex_unlock(&self->lock);
+}
+
+/* perform the actual libGeoIP lookup, storing the results in @entry; the
+ * lock serializes access to the GeoIP handle, which may be swapped out
+ * by a database reload */
+static void
+geoip_parser_resolve(GeoIPParser *self, const gchar *input, GeoIPCacheEntry *entry)
+{
+  GeoIPRecord *record;
+
+  g_static_mutex_lock(&self->lock);
+  record = GeoIP_record_by_name(self->gi, input);
+
+  if (!record)
+    {
+      const char *country;
+
+      country = GeoIP_country_code_by_name(self->gi, input);
+      if (country)
+        entry->country_code = g_strdup(country);
+      g_static_mutex_unlock(&self->lock);
+      return;
+    }
+
+  if (record->country_code)
+    entry->country_code = g_strdup(record->country_code);
+  entry->latitude = g_strdup_printf("%f", record->latitude);
+  entry->longitude = g_strdup_printf("%f", record->longitude);
+
+  GeoIPRecord_delete(record);
+  g_static_mutex_unlock(&self->lock);
+}
+
+static void
+geoip_parser_apply_entry(GeoIPParser *self, LogMessage *msg, GeoIPCacheEntry *entry)
+{
+  if (entry->country_code)
+    log_msg_set_value_by_name(msg, self->dest.country_code,
+                              entry->country_code,
+                              strlen(entry->country_code));
+  if (entry->latitude)
+    log_msg_set_value_by_name(msg, self->dest.latitude,
+                              entry->latitude,
+                              strlen(entry->latitude));
+  if (entry->longitude)
+    log_msg_set_value_by_name(msg, self->dest.longitude,
+                              entry->longitude,
+                              strlen(entry->longitude));
+}
+
 static gboolean
 geoip_parser_process(LogParser *s, LogMessage **pmsg,
                      const LogPathOptions *path_options,
@@ -80,51 +262,46 @@ geoip_parser_process(LogParser *s, LogMessage **pmsg,
 {
   GeoIPParser *self = (GeoIPParser *) s;
   LogMessage *msg = log_msg_make_writable(pmsg, path_options);
-  GeoIPRecord *record;
-  SBGString *value;
+  GeoIPCache *cache;
+  GeoIPCacheEntry *entry;
+  gchar *key;
 
   if (!self->dest.country_code &&
       !self->dest.latitude &&
       !self->dest.longitude)
     return TRUE;
 
-  record = GeoIP_record_by_name(self->gi, input);
+  geoip_parser_check_database(self);
 
-  if (!record)
+  cache = geoip_cache_get();
+  key = g_strdup_printf("%p/%s", self, input);
+  entry = (GeoIPCacheEntry *) g_hash_table_lookup(cache->entries, key);
+  if (entry)
     {
-      const char *country;
-
-      country = GeoIP_country_code_by_name(self->gi, input);
-      if (country)
-        log_msg_set_value_by_name(msg, self->dest.country_code,
-                                  country,
-                                  strlen(country));
-
+      g_free(key);
+      g_queue_unlink(cache->lru, entry->lru_link);
+      g_queue_push_head_link(cache->lru, entry->lru_link);
+      stats_counter_inc(self->cache_hits);
+      geoip_parser_apply_entry(self, msg, entry);
       return TRUE;
     }
 
-  if (record->country_code)
-    log_msg_set_value_by_name(msg, self->dest.country_code,
-                              record->country_code,
-                              strlen(record->country_code));
-
-  value = sb_gstring_acquire();
-
-  g_string_printf(sb_gstring_string(value), "%f",
-                  record->latitude);
-  log_msg_set_value_by_name(msg, self->dest.latitude,
-                            sb_gstring_string(value)->str,
-                            sb_gstring_string(value)->len);
+  if (g_hash_table_size(cache->entries) >= GEOIP_CACHE_SIZE)
+    {
+      GeoIPCacheEntry *victim = (GeoIPCacheEntry *) g_queue_pop_tail(cache->lru);
 
-  g_string_printf(sb_gstring_string(value), "%f",
-                  record->longitude);
-  log_msg_set_value_by_name(msg, self->dest.longitude,
-                            sb_gstring_string(value)->str,
-                            sb_gstring_string(value)->len);
+      g_hash_table_remove(cache->entries, victim->key);
+    }
 
-  GeoIPRecord_delete(record);
-  sb_gstring_release(value);
+  entry = g_new0(GeoIPCacheEntry, 1);
+  entry->key = key;
+  geoip_parser_resolve(self, input, entry);
+  g_hash_table_insert(cache->entries, entry->key, entry);
+  g_queue_push_head(cache->lru, entry);
+  entry->lru_link = cache->lru->head;
+  stats_counter_inc(self->cache_misses);
 
+  geoip_parser_apply_entry(self, msg, entry);
   return TRUE;
 }
 
@@ -154,7 +331,14 @@ geoip_parser_free(LogPipe *s)
   g_free(self->database);
   g_free(self->prefix);
 
-  GeoIP_delete(self->gi);
+  if (self->gi)
+    GeoIP_delete(self->gi);
+  g_static_mutex_free(&self->lock);
+
+  stats_lock();
+  stats_unregister_counter(SCS_GLOBAL, "geoip_cache_hits", NULL, SC_TYPE_PROCESSED, &self->cache_hits);
+  stats_unregister_counter(SCS_GLOBAL, "geoip_cache_misses", NULL, SC_TYPE_PROCESSED, &self->cache_misses);
+  stats_unlock();
 
   log_parser_free_method(s);
 }
@@ -163,6 +347,7 @@ static gboolean
 geoip_parser_init(LogPipe *s)
 {
   GeoIPParser *self = (GeoIPParser *) s;
+  struct stat st;
 
   geoip_parser_reset_fields(self);
 
@@ -170,6 +355,11 @@ geoip_parser_init(LogPipe *s)
 
   if (!self->gi)
     return FALSE;
+
+  if (stat(self->database, &st) == 0)
+    self->db_mtime = st.st_mtime;
+  self->db_last_check = cached_g_current_time_sec();
+
   return log_parser_init_method(s);
 }
 
@@ -183,6 +373,12 @@ geoip_parser_new(GlobalConfig *cfg)
   self->super.super.free_fn = geoip_parser_free;
   self->super.super.clone = geoip_parser_clone;
   self->super.process = geoip_parser_process;
+  g_static_mutex_init(&self->lock);
+
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "geoip_cache_hits", NULL, SC_TYPE_PROCESSED, &self->cache_hits);
+  stats_register_counter(0, SCS_GLOBAL, "geoip_cache_misses", NULL, SC_TYPE_PROCESSED, &self->cache_misses);
+  stats_unlock();
 
   geoip_parser_set_database(&self->super, "/usr/share/GeoIP/GeoIP.dat");
   geoip_parser_set_prefix(&self->super, ".geoip.");
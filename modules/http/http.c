@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <curl/curl.h>
+
+#include <string.h>
+
+#include "http.h"
+#include "http-parser.h"
+#include "plugin.h"
+#include "messages.h"
+#include "misc.h"
+#include "stats/stats-registry.h"
+#include "logqueue.h"
+#include "driver.h"
+#include "plugin-types.h"
+#include "logthrdestdrv.h"
+
+/*
+ * This driver batches messages into a single request body and POSTs the
+ * batch over a persistent keep-alive connection: worker.insert() only
+ * appends the formatted message and returns QUEUED, the request is
+ * performed by worker.flush() when the queue drains or the flow-control
+ * window fills up.  Compared to a request per message this amortizes the
+ * request/response round-trip and the connection handshake over the whole
+ * batch.  A failed request makes the framework rewind and resend the
+ * unconfirmed batch, so delivery is at-least-once.
+ *
+ * With bulk_index() set the body is assembled in the Elasticsearch _bulk
+ * format: each message is preceded by an index action line and the
+ * batch is newline delimited.  The document itself comes from the body()
+ * template, $(format-json) produces suitable output.
+ */
+
+typedef struct
+{
+  LogThrDestDriver super;
+
+  LogTemplateOptions template_options;
+  LogTemplate *url;
+  LogTemplate *body;
+  LogTemplate *bulk_index;
+  LogTemplate *bulk_type;
+  GList *headers;
+  gchar *user;
+  gchar *password;
+
+  GString *url_str;
+  GString *body_str;
+  GString *scratch_str;
+
+  /* the request body accumulated for the current batch and the URL it
+   * is going to be POSTed to; messages formatting a different URL force
+   * the pending batch out first */
+  GString *request_body;
+  gchar *batch_url;
+
+  CURL *curl;
+  struct curl_slist *curl_headers;
+} HTTPDestDriver;
+
+/*
+ * Configuration
+ */
+
+void
+http_dd_set_url(LogDriver *d, LogTemplate *url)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->url);
+  self->url = url;
+}
+
+void
+http_dd_set_headers(LogDriver *d, GList *headers)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  string_list_free(self->headers);
+  self->headers = headers;
+}
+
+void
+http_dd_set_user(LogDriver *d, const gchar *user)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->user);
+  self->user = g_strdup(user);
+}
+
+void
+http_dd_set_password(LogDriver *d, const gchar *password)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->password);
+  self->password = g_strdup(password);
+}
+
+void
+http_dd_set_body(LogDriver *d, LogTemplate *body)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->body);
+  self->body = body;
+}
+
+void
+http_dd_set_bulk_index(LogDriver *d, LogTemplate *index)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->bulk_index);
+  self->bulk_index = index;
+}
+
+void
+http_dd_set_bulk_type(LogDriver *d, LogTemplate *type)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->bulk_type);
+  self->bulk_type = type;
+}
+
+LogTemplateOptions *
+http_dd_get_template_options(LogDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  return &self->template_options;
+}
+
+/*
+ * Utilities
+ */
+
+static gchar *
+http_dd_format_stats_instance(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "http,%s", self->url ? self->url->template : "");
+  return persist_name;
+}
+
+static gchar *
+http_dd_format_persist_name(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "http(%s)", self->url ? self->url->template : "");
+  return persist_name;
+}
+
+/* the response body is not interesting, but without a write callback
+ * libcurl would dump it to stdout */
+static size_t
+http_dd_discard_response(char *ptr, size_t size, size_t nmemb, void *user_data)
+{
+  return size * nmemb;
+}
+
+static void
+http_dd_append_json_escaped(GString *dest, const gchar *str)
+{
+  const gchar *p;
+
+  for (p = str; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        {
+          g_string_append_c(dest, '\\');
+          g_string_append_c(dest, *p);
+        }
+      else if ((guchar) *p < 0x20)
+        g_string_append_printf(dest, "\\u%04x", (guchar) *p);
+      else
+        g_string_append_c(dest, *p);
+    }
+}
+
+static gboolean
+http_dd_connect(HTTPDestDriver *self)
+{
+  GList *l;
+
+  if (self->curl)
+    return TRUE;
+
+  self->curl = curl_easy_init();
+  if (!self->curl)
+    {
+      msg_error("HTTP handle initialization failed, suspending",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      return FALSE;
+    }
+
+  curl_easy_setopt(self->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(self->curl, CURLOPT_WRITEFUNCTION, http_dd_discard_response);
+
+  if (self->bulk_index)
+    self->curl_headers = curl_slist_append(self->curl_headers, "Content-Type: application/json");
+  /* an Expect: 100-continue round-trip would stall every batch */
+  self->curl_headers = curl_slist_append(self->curl_headers, "Expect:");
+  for (l = self->headers; l; l = l->next)
+    self->curl_headers = curl_slist_append(self->curl_headers, (gchar *) l->data);
+  curl_easy_setopt(self->curl, CURLOPT_HTTPHEADER, self->curl_headers);
+
+  if (self->user)
+    {
+      gchar *userpwd = g_strdup_printf("%s:%s", self->user, self->password ? : "");
+
+      curl_easy_setopt(self->curl, CURLOPT_USERPWD, userpwd);
+      g_free(userpwd);
+    }
+
+  msg_debug("HTTP connection handle created",
+            evt_tag_str("driver", self->super.super.super.id),
+            evt_tag_str("url", self->url->template),
+            NULL);
+  return TRUE;
+}
+
+static void
+http_dd_disconnect(LogThrDestDriver *s)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+
+  if (self->curl)
+    {
+      curl_easy_cleanup(self->curl);
+      self->curl = NULL;
+    }
+  if (self->curl_headers)
+    {
+      curl_slist_free_all(self->curl_headers);
+      self->curl_headers = NULL;
+    }
+  /* the batch is rewound by the framework, drop our copy of it */
+  if (self->request_body)
+    g_string_truncate(self->request_body, 0);
+  g_free(self->batch_url);
+  self->batch_url = NULL;
+}
+
+/*
+ * Worker thread
+ */
+
+static worker_insert_result_t
+http_dd_send_batch(HTTPDestDriver *self)
+{
+  CURLcode ret;
+  glong http_code = 0;
+
+  if (self->request_body->len == 0)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  curl_easy_setopt(self->curl, CURLOPT_URL, self->batch_url);
+  curl_easy_setopt(self->curl, CURLOPT_POSTFIELDS, self->request_body->str);
+  curl_easy_setopt(self->curl, CURLOPT_POSTFIELDSIZE, (long) self->request_body->len);
+
+  ret = curl_easy_perform(self->curl);
+  if (ret != CURLE_OK)
+    {
+      msg_error("HTTP request failed, rewinding the unconfirmed batch",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("url", self->batch_url),
+                evt_tag_str("error", curl_easy_strerror(ret)),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  curl_easy_getinfo(self->curl, CURLINFO_RESPONSE_CODE, &http_code);
+  if (http_code / 100 != 2)
+    {
+      msg_error("HTTP server returned an error status, rewinding the unconfirmed batch",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("url", self->batch_url),
+                evt_tag_int("status", http_code),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  msg_debug("HTTP batch sent",
+            evt_tag_str("driver", self->super.super.super.id),
+            evt_tag_str("url", self->batch_url),
+            evt_tag_int("body_size", self->request_body->len),
+            NULL);
+
+  g_string_truncate(self->request_body, 0);
+  g_free(self->batch_url);
+  self->batch_url = NULL;
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
+static worker_insert_result_t
+http_worker_insert(LogThrDestDriver *s, LogMessage *msg)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+
+  if (!http_dd_connect(self))
+    return WORKER_INSERT_RESULT_NOT_CONNECTED;
+
+  log_template_format(self->url, msg, &self->template_options, LTZ_SEND,
+                      self->super.seq_num, NULL, self->url_str);
+
+  if (self->batch_url && strcmp(self->batch_url, self->url_str->str) != 0)
+    {
+      /* the URL changed mid-batch, the pending requests cannot share a
+       * request body with this message */
+      if (http_dd_send_batch(self) != WORKER_INSERT_RESULT_SUCCESS)
+        return WORKER_INSERT_RESULT_ERROR;
+    }
+  if (!self->batch_url)
+    self->batch_url = g_strdup(self->url_str->str);
+
+  if (self->bulk_index)
+    {
+      log_template_format(self->bulk_index, msg, &self->template_options, LTZ_SEND,
+                          self->super.seq_num, NULL, self->scratch_str);
+      g_string_append(self->request_body, "{\"index\":{\"_index\":\"");
+      http_dd_append_json_escaped(self->request_body, self->scratch_str->str);
+      if (self->bulk_type)
+        {
+          log_template_format(self->bulk_type, msg, &self->template_options, LTZ_SEND,
+                              self->super.seq_num, NULL, self->scratch_str);
+          g_string_append(self->request_body, "\",\"_type\":\"");
+          http_dd_append_json_escaped(self->request_body, self->scratch_str->str);
+        }
+      g_string_append(self->request_body, "\"}}\n");
+    }
+
+  log_template_format(self->body, msg, &self->template_options, LTZ_SEND,
+                      self->super.seq_num, NULL, self->body_str);
+  g_string_append_len(self->request_body, self->body_str->str, self->body_str->len);
+  g_string_append_c(self->request_body, '\n');
+
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+static worker_insert_result_t
+http_worker_flush(LogThrDestDriver *s)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+  worker_insert_result_t result;
+
+  result = http_dd_send_batch(self);
+  if (result == WORKER_INSERT_RESULT_SUCCESS && s->queued_messages > 0)
+    msg_debug("HTTP batch confirmed",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_int("batch_size", s->queued_messages),
+              NULL);
+  return result;
+}
+
+static void
+http_worker_thread_init(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  msg_debug("Worker thread started",
+            evt_tag_str("driver", self->super.super.super.id),
+            NULL);
+
+  self->url_str = g_string_sized_new(128);
+  self->body_str = g_string_sized_new(1024);
+  self->scratch_str = g_string_sized_new(64);
+  self->request_body = g_string_sized_new(32768);
+
+  http_dd_connect(self);
+}
+
+static void
+http_worker_thread_deinit(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  http_dd_disconnect(d);
+  g_string_free(self->url_str, TRUE);
+  g_string_free(self->body_str, TRUE);
+  g_string_free(self->scratch_str, TRUE);
+  g_string_free(self->request_body, TRUE);
+  self->request_body = NULL;
+}
+
+/*
+ * Main thread
+ */
+
+static gboolean
+http_dd_init(LogPipe *s)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_dest_driver_init_method(s))
+    return FALSE;
+
+  if (!self->url)
+    {
+      msg_error("Error initializing HTTP destination, the url() argument is required",
+                evt_tag_str("driver", self->super.super.super.id),
+                NULL);
+      return FALSE;
+    }
+
+  if (self->bulk_type && !self->bulk_index)
+    {
+      msg_error("Error initializing HTTP destination, bulk_type() requires bulk_index()",
+                evt_tag_str("driver", self->super.super.super.id),
+                NULL);
+      return FALSE;
+    }
+
+  if (!self->body)
+    {
+      self->body = log_template_new(cfg, NULL);
+      log_template_compile(self->body, "$ISODATE $HOST $MSGHDR$MSG", NULL);
+    }
+
+  log_template_options_init(&self->template_options, cfg);
+
+  msg_verbose("Initializing HTTP destination",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("url", self->url->template),
+              NULL);
+
+  return log_threaded_dest_driver_start(s);
+}
+
+static void
+http_dd_free(LogPipe *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_options_destroy(&self->template_options);
+
+  log_template_unref(self->url);
+  log_template_unref(self->body);
+  log_template_unref(self->bulk_index);
+  log_template_unref(self->bulk_type);
+  string_list_free(self->headers);
+  g_free(self->user);
+  g_free(self->password);
+
+  log_threaded_dest_driver_free(d);
+}
+
+/*
+ * Plugin glue.
+ */
+
+LogDriver *
+http_dd_new(GlobalConfig *cfg)
+{
+  HTTPDestDriver *self = g_new0(HTTPDestDriver, 1);
+
+  log_threaded_dest_driver_init_instance(&self->super, cfg);
+  self->super.super.super.super.init = http_dd_init;
+  self->super.super.super.super.free_fn = http_dd_free;
+
+  self->super.worker.thread_init = http_worker_thread_init;
+  self->super.worker.thread_deinit = http_worker_thread_deinit;
+  self->super.worker.disconnect = http_dd_disconnect;
+  self->super.worker.insert = http_worker_insert;
+  self->super.worker.flush = http_worker_flush;
+
+  self->super.format.stats_instance = http_dd_format_stats_instance;
+  self->super.format.persist_name = http_dd_format_persist_name;
+  self->super.stats_source = SCS_HTTP;
+
+  log_template_options_defaults(&self->template_options);
+
+  return (LogDriver *)self;
+}
+
+static Plugin http_plugin =
+{
+  .type = LL_CONTEXT_DESTINATION,
+  .name = "http",
+  .parser = &http_parser,
+};
+
+gboolean
+http_module_init(GlobalConfig *cfg, CfgArgs *args)
+{
+  curl_global_init(CURL_GLOBAL_ALL);
+  plugin_register(cfg, &http_plugin, 1);
+
+  return TRUE;
+}
+
+const ModuleInfo module_info =
+{
+  .canonical_name = "http",
+  .version = SYSLOG_NG_VERSION,
+  .description = "The http module provides an HTTP destination with batched requests for syslog-ng.",
+  .core_revision = SYSLOG_NG_SOURCE_REVISION,
+  .plugins = &http_plugin,
+  .plugins_len = 1,
+};
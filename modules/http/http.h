@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef HTTP_H_INCLUDED
+#define HTTP_H_INCLUDED
+
+#include "driver.h"
+#include "template/templates.h"
+
+LogDriver *http_dd_new(GlobalConfig *cfg);
+
+void http_dd_set_url(LogDriver *d, LogTemplate *url);
+void http_dd_set_headers(LogDriver *d, GList *headers);
+void http_dd_set_user(LogDriver *d, const gchar *user);
+void http_dd_set_password(LogDriver *d, const gchar *password);
+void http_dd_set_body(LogDriver *d, LogTemplate *body);
+void http_dd_set_bulk_index(LogDriver *d, LogTemplate *index);
+void http_dd_set_bulk_type(LogDriver *d, LogTemplate *type);
+LogTemplateOptions *http_dd_get_template_options(LogDriver *d);
+
+#endif
@@ -163,6 +163,9 @@ void
 java_dd_close(LogThrDestDriver *s)
 {
   JavaDestDriver *self = (JavaDestDriver *)s;
+
+  /* queued messages are rewound and inserted again after a reconnect */
+  java_destination_proxy_batch_reset(self->proxy);
   if (java_destination_proxy_is_opened(self->proxy))
     {
       java_destination_proxy_close(self->proxy);
@@ -179,10 +182,33 @@ java_worker_insert(LogThrDestDriver *s, LogMessage *msg)
       return WORKER_INSERT_RESULT_NOT_CONNECTED;
     }
 
+  if (s->pipeline_depth >= 2 && java_destination_proxy_is_batching(self->proxy))
+    {
+      if (!java_destination_proxy_batch_add(self->proxy, msg))
+        {
+          /* the batch buffer is full, push it out before this message */
+          if (!java_destination_proxy_batch_flush(self->proxy))
+            return WORKER_INSERT_RESULT_ERROR;
+          if (!java_destination_proxy_batch_add(self->proxy, msg))
+            return WORKER_INSERT_RESULT_ERROR;
+        }
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
   gboolean sent = java_dd_send_to_object(self, msg);
   return sent ? WORKER_INSERT_RESULT_SUCCESS : WORKER_INSERT_RESULT_ERROR;
 }
 
+static worker_insert_result_t
+java_worker_flush(LogThrDestDriver *s)
+{
+  JavaDestDriver *self = (JavaDestDriver *)s;
+
+  if (!java_destination_proxy_batch_flush(self->proxy))
+    return WORKER_INSERT_RESULT_ERROR;
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
 static void
 java_worker_message_queue_empty(LogThrDestDriver *d)
 {
@@ -251,6 +277,7 @@ java_dd_new(GlobalConfig *cfg)
 
   self->super.worker.thread_deinit = java_worker_thread_deinit;
   self->super.worker.insert = java_worker_insert;
+  self->super.worker.flush = java_worker_flush;
   self->super.worker.connect = java_dd_open;
   self->super.worker.disconnect = java_dd_close;
   self->super.worker.worker_message_queue_empty = java_worker_message_queue_empty;
@@ -37,6 +37,7 @@ typedef struct _JavaDestinationImpl
   jmethodID mi_deinit;
   jmethodID mi_send;
   jmethodID mi_send_msg;
+  jmethodID mi_send_batch;
   jmethodID mi_open;
   jmethodID mi_close;
   jmethodID mi_is_opened;
@@ -50,24 +51,43 @@ struct _JavaDestinationProxy
   jclass loaded_class;
   JavaDestinationImpl dest_impl;
   LogTemplate *template;
-  GString *formatted_message; 
+  GString *formatted_message;
   JavaLogMessageProxy *msg_builder;
   gchar *name_by_uniq_options;
+
+  /* batched send support: formatted messages are length prefixed into a
+   * native buffer that is exposed to Java as a direct ByteBuffer, so an
+   * entire batch crosses the JNI boundary with a single method call */
+  gchar *batch_data;
+  gsize batch_capacity;
+  gsize batch_pos;
+  gint batch_count;
+  jobject batch_buffer;
 };
 
+#define JAVA_DESTINATION_PROXY_BATCH_BUFFER_SIZE (256 * 1024)
+
 static gboolean
 __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, const gchar *class_path, gpointer handle)
 {
   JNIEnv *java_env = NULL;
+  jclass loaded_class;
+  jobject dest_object;
+
   java_env = java_machine_get_env(self->java_machine, &java_env);
-  self->loaded_class = java_machine_load_class(self->java_machine, class_name, class_path);
-  if (!self->loaded_class) {
+  loaded_class = java_machine_load_class(self->java_machine, class_name, class_path);
+  if (!loaded_class) {
       msg_error("Can't find class",
                 evt_tag_str("class_name", class_name),
                 NULL);
       return FALSE;
   }
 
+  /* the class and the destination object are used from the worker thread
+   * for the whole lifetime of the driver, hold them as global references */
+  self->loaded_class = CALL_JAVA_FUNCTION(java_env, NewGlobalRef, loaded_class);
+  CALL_JAVA_FUNCTION(java_env, DeleteLocalRef, loaded_class);
+
   self->dest_impl.mi_constructor = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "<init>", "(J)V");
   if (!self->dest_impl.mi_constructor) {
       msg_error("Can't find default constructor for class",
@@ -93,6 +113,9 @@ __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, c
 
   self->dest_impl.mi_send = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendProxy", "(Ljava/lang/String;)Z");
   self->dest_impl.mi_send_msg = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendProxy", "(Lorg/syslog_ng/LogMessage;)Z");
+  self->dest_impl.mi_send_batch = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendBatchProxy", "(Ljava/nio/ByteBuffer;I)Z");
+  /* the send methods are optional, don't leave a NoSuchMethodError pending */
+  CALL_JAVA_FUNCTION(java_env, ExceptionClear);
 
   if (!self->dest_impl.mi_send_msg && !self->dest_impl.mi_send)
     {
@@ -136,14 +159,16 @@ __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, c
           evt_tag_str("method", "boolean isOpened()"), NULL);
     }
 
-  self->dest_impl.dest_object = CALL_JAVA_FUNCTION(java_env, NewObject, self->loaded_class, self->dest_impl.mi_constructor, handle);
-  if (!self->dest_impl.dest_object)
+  dest_object = CALL_JAVA_FUNCTION(java_env, NewObject, self->loaded_class, self->dest_impl.mi_constructor, handle);
+  if (!dest_object)
     {
       msg_error("Can't create object",
                 evt_tag_str("class_name", class_name),
                 NULL);
       return FALSE;
     }
+  self->dest_impl.dest_object = CALL_JAVA_FUNCTION(java_env, NewGlobalRef, dest_object);
+  CALL_JAVA_FUNCTION(java_env, DeleteLocalRef, dest_object);
 
   self->dest_impl.mi_get_name_by_uniq_options = CALL_JAVA_FUNCTION(java_env,
                                                                    GetMethodID,
@@ -169,14 +194,20 @@ java_destination_proxy_free(JavaDestinationProxy *self)
   env = java_machine_get_env(self->java_machine, &env);
   if (self->dest_impl.dest_object)
     {
-      CALL_JAVA_FUNCTION(env, DeleteLocalRef, self->dest_impl.dest_object);
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->dest_impl.dest_object);
     }
 
   if (self->loaded_class)
     {
-      CALL_JAVA_FUNCTION(env, DeleteLocalRef, self->loaded_class);
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->loaded_class);
     }
 
+  if (self->batch_buffer)
+    {
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch_buffer);
+    }
+  g_free(self->batch_data);
+
   if (self->msg_builder)
     {
       java_log_message_proxy_free(self->msg_builder);
@@ -254,6 +285,109 @@ java_destination_proxy_send(JavaDestinationProxy *self, LogMessage *msg)
     }
 }
 
+gboolean
+java_destination_proxy_is_batching(JavaDestinationProxy *self)
+{
+  /* batching is only available on the formatted message path, native
+   * LogMessage objects cannot be serialized into the batch buffer */
+  return self->dest_impl.mi_send_batch != 0 && self->dest_impl.mi_send_msg == 0;
+}
+
+static gboolean
+__batch_reserve(JavaDestinationProxy *self, JNIEnv *env, gsize needed)
+{
+  if (!self->batch_data)
+    {
+      jobject buffer;
+
+      self->batch_capacity = JAVA_DESTINATION_PROXY_BATCH_BUFFER_SIZE;
+      while (self->batch_capacity < needed)
+        self->batch_capacity *= 2;
+      self->batch_data = g_malloc(self->batch_capacity);
+
+      buffer = CALL_JAVA_FUNCTION(env, NewDirectByteBuffer, self->batch_data, self->batch_capacity);
+      if (!buffer)
+        {
+          g_free(self->batch_data);
+          self->batch_data = NULL;
+          return FALSE;
+        }
+      self->batch_buffer = CALL_JAVA_FUNCTION(env, NewGlobalRef, buffer);
+      CALL_JAVA_FUNCTION(env, DeleteLocalRef, buffer);
+      return TRUE;
+    }
+
+  if (self->batch_capacity - self->batch_pos >= needed)
+    return TRUE;
+
+  if (self->batch_count == 0)
+    {
+      /* a single message larger than the buffer: grow and re-wrap it */
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch_buffer);
+      self->batch_buffer = NULL;
+      g_free(self->batch_data);
+      self->batch_data = NULL;
+      return __batch_reserve(self, env, needed);
+    }
+
+  return FALSE;
+}
+
+/*
+ * Append the formatted message to the batch buffer as a 32 bit big endian
+ * length followed by the UTF-8 payload, matching what sendBatchProxy()
+ * decodes with ByteBuffer.getInt(). Returns FALSE if the buffer is full,
+ * in which case the caller has to flush the batch first.
+ */
+gboolean
+java_destination_proxy_batch_add(JavaDestinationProxy *self, LogMessage *msg)
+{
+  JNIEnv *env = java_machine_get_env(self->java_machine, &env);
+  guint32 len;
+  guchar *pos;
+
+  log_template_format(self->template, msg, NULL, LTZ_LOCAL, 0, NULL, self->formatted_message);
+  len = self->formatted_message->len;
+  if (!__batch_reserve(self, env, (gsize) len + 4))
+    return FALSE;
+
+  pos = (guchar *) self->batch_data + self->batch_pos;
+  pos[0] = (len >> 24) & 0xff;
+  pos[1] = (len >> 16) & 0xff;
+  pos[2] = (len >> 8) & 0xff;
+  pos[3] = len & 0xff;
+  memcpy(pos + 4, self->formatted_message->str, len);
+  self->batch_pos += len + 4;
+  self->batch_count++;
+  return TRUE;
+}
+
+gboolean
+java_destination_proxy_batch_flush(JavaDestinationProxy *self)
+{
+  JNIEnv *env = java_machine_get_env(self->java_machine, &env);
+  jboolean res;
+
+  if (self->batch_count == 0)
+    return TRUE;
+
+  res = CALL_JAVA_FUNCTION(env, CallBooleanMethod,
+                           self->dest_impl.dest_object,
+                           self->dest_impl.mi_send_batch,
+                           self->batch_buffer,
+                           self->batch_count);
+  self->batch_pos = 0;
+  self->batch_count = 0;
+  return !!(res);
+}
+
+void
+java_destination_proxy_batch_reset(JavaDestinationProxy *self)
+{
+  self->batch_pos = 0;
+  self->batch_count = 0;
+}
+
 gchar *
 java_destination_proxy_get_name_by_uniq_options(JavaDestinationProxy *self)
 {
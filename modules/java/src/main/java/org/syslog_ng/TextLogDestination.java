@@ -38,4 +38,29 @@ public abstract class TextLogDestination extends LogDestination {
 			return false;
 		}
 	}
+
+	protected boolean sendBatch(String[] formattedMessages) {
+		for (String formattedMessage: formattedMessages) {
+			if (!send(formattedMessage))
+				return false;
+		}
+		return true;
+	}
+
+	public boolean sendBatchProxy(java.nio.ByteBuffer buffer, int count) {
+		try {
+			String[] formattedMessages = new String[count];
+			buffer.rewind();
+			for (int i = 0; i < count; i++) {
+				byte[] message = new byte[buffer.getInt()];
+				buffer.get(message);
+				formattedMessages[i] = new String(message, "UTF-8");
+			}
+			return sendBatch(formattedMessages);
+		}
+		catch (Exception e) {
+			sendExceptionMessage(e);
+			return false;
+		}
+	}
 }
\ No newline at end of file
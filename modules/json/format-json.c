@@ -32,12 +32,27 @@
 #include "syslog-ng.h"
 #include "utf8utils.h"
 
+/* pre-rendered "key": segments are cached beyond this many distinct
+ * keys, dynamic key sets (e.g. SDATA globs) shouldn't grow without bounds */
+#define TF_JSON_KEY_CACHE_LIMIT 1024
+
 typedef struct _TFJsonState
 {
   TFSimpleFuncState super;
   ValuePairs *vp;
+  /* maps key name to its pre-rendered, escaped '"name":' segment; the
+   * same compiled template may be evaluated from multiple writer
+   * threads, hence the lock */
+  GStaticMutex key_cache_lock;
+  GHashTable *key_cache;
 } TFJsonState;
 
+static void
+tf_json_key_segment_free(GString *segment)
+{
+  g_string_free(segment, TRUE);
+}
+
 static gboolean
 tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
 		gint argc, gchar *argv[],
@@ -50,6 +65,9 @@ tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
   if (!state->vp)
     return FALSE;
 
+  g_static_mutex_init(&state->key_cache_lock);
+  state->key_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) tf_json_key_segment_free);
+
   /* Always replace a leading dot with an underscore. */
   vpts = value_pairs_transform_set_new(".*");
   value_pairs_transform_set_add_func(vpts, value_pairs_new_transform_replace_prefix(".", "_"));
@@ -63,6 +81,7 @@ typedef struct
   gboolean need_comma;
   GString *buffer;
   const LogTemplateOptions *template_options;
+  TFJsonState *tf_state;
 } json_state_t;
 
 static inline void
@@ -71,6 +90,40 @@ g_string_append_escaped(GString *dest, const char *str)
   append_unsafe_utf8_as_escaped_text(dest, str, "\"");
 }
 
+/* append the pre-rendered '"name":' segment, escaping the key only the
+ * first time it is seen */
+static void
+tf_json_append_key(json_state_t *state, const gchar *name)
+{
+  TFJsonState *tf_state = state->tf_state;
+  GString *segment;
+
+  g_static_mutex_lock(&tf_state->key_cache_lock);
+  segment = g_hash_table_lookup(tf_state->key_cache, name);
+  if (!segment && g_hash_table_size(tf_state->key_cache) < TF_JSON_KEY_CACHE_LIMIT)
+    {
+      segment = g_string_sized_new(strlen(name) + 4);
+      g_string_append_c(segment, '"');
+      g_string_append_escaped(segment, name);
+      g_string_append(segment, "\":");
+      g_hash_table_insert(tf_state->key_cache, g_strdup(name), segment);
+    }
+  g_static_mutex_unlock(&tf_state->key_cache_lock);
+
+  /* cached segments are never removed, so the pointer stays valid after
+   * the lock is dropped */
+  if (segment)
+    {
+      g_string_append_len(state->buffer, segment->str, segment->len);
+    }
+  else
+    {
+      g_string_append_c(state->buffer, '"');
+      g_string_append_escaped(state->buffer, name);
+      g_string_append(state->buffer, "\":");
+    }
+}
+
 static gboolean
 tf_json_obj_start(const gchar *name,
                   const gchar *prefix, gpointer *prefix_data,
@@ -84,9 +137,8 @@ tf_json_obj_start(const gchar *name,
 
   if (name)
     {
-      g_string_append_c(state->buffer, '"');
-      g_string_append_escaped(state->buffer, name);
-      g_string_append(state->buffer, "\":{");
+      tf_json_append_key(state, name);
+      g_string_append_c(state->buffer, '{');
     }
   else
     g_string_append_c(state->buffer, '{');
@@ -118,13 +170,10 @@ tf_json_append_value(const gchar *name, const gchar *value,
   if (state->need_comma)
     g_string_append_c(state->buffer, ',');
 
-  g_string_append_c(state->buffer, '"');
-  g_string_append_escaped(state->buffer, name);
+  tf_json_append_key(state, name);
 
   if (quoted)
-    g_string_append(state->buffer, "\":\"");
-  else
-    g_string_append(state->buffer, "\":");
+    g_string_append_c(state->buffer, '"');
 
   g_string_append_escaped(state->buffer, value);
 
@@ -196,7 +245,7 @@ tf_json_value(const gchar *name, const gchar *prefix,
 }
 
 static gboolean
-tf_json_append(GString *result, ValuePairs *vp, LogMessage *msg,
+tf_json_append(GString *result, TFJsonState *tf_state, ValuePairs *vp, LogMessage *msg,
                const LogTemplateOptions *template_options, gint32 seq_num, gint time_zone_mode)
 {
   json_state_t state;
@@ -204,6 +253,7 @@ tf_json_append(GString *result, ValuePairs *vp, LogMessage *msg,
   state.need_comma = FALSE;
   state.buffer = result;
   state.template_options = template_options;
+  state.tf_state = tf_state;
 
   return value_pairs_walk(vp,
                           tf_json_obj_start, tf_json_value, tf_json_obj_end,
@@ -222,7 +272,7 @@ tf_json_call(LogTemplateFunction *self, gpointer s,
   gsize orig_size = result->len;
 
   for (i = 0; i < args->num_messages; i++)
-    r &= tf_json_append(result, state->vp, args->messages[i], args->opts, args->seq_num, args->tz);
+    r &= tf_json_append(result, state, state->vp, args->messages[i], args->opts, args->seq_num, args->tz);
 
   if (!r && (args->opts->on_error & ON_ERROR_DROP_MESSAGE))
     g_string_set_size(result, orig_size);
@@ -235,6 +285,9 @@ tf_json_free_state(gpointer s)
 
   if (state->vp)
     value_pairs_unref(state->vp);
+  if (state->key_cache)
+    g_hash_table_destroy(state->key_cache);
+  g_static_mutex_free(&state->key_cache_lock);
   tf_simple_func_free_state(&state->super);
 }
 
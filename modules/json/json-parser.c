@@ -26,6 +26,7 @@
 
 #include <string.h>
 #include <ctype.h>
+#include <stdlib.h>
 
 #include <json.h>
 #include <json_object_private.h>
@@ -202,6 +203,399 @@ json_tokener_error_desc(enum json_tokener_error err)
 }
 #endif
 
+/*
+ * Streaming fast path: a single pass over the input that stages each
+ * scalar leaf and then writes them straight into the message, without
+ * building the intermediate json_object tree.  Key names and value
+ * formatting are kept identical to the json-c based walk above.  Any
+ * construct the scanner does not digest makes it bail out, in which
+ * case the full json-c parse runs instead (this also covers error
+ * reporting and the extract-prefix() subtree mode).
+ */
+
+/* matches the default tokener depth of json-c */
+#define JSON_SCANNER_MAX_DEPTH 32
+
+typedef struct _JSONScanner
+{
+  const gchar *p, *end;
+  /* dotted name of the member being parsed, including the configured prefix */
+  GString *key;
+  /* scratch buffer for the current scalar value */
+  GString *value;
+  /* leaf values are staged here as packed "key NUL value NUL" records
+   * and only written into the message once the whole input scanned
+   * cleanly, so a syntax error halfway through doesn't leave partially
+   * extracted fields behind */
+  GString *kv;
+} JSONScanner;
+
+static gboolean json_scanner_parse_value(JSONScanner *self, gint depth);
+
+static void
+json_scanner_skip_ws(JSONScanner *self)
+{
+  while (self->p < self->end &&
+         (*self->p == ' ' || *self->p == '\t' || *self->p == '\n' || *self->p == '\r'))
+    self->p++;
+}
+
+static void
+json_scanner_emit(JSONScanner *self)
+{
+  /* the terminating NUL of GString->str is part of the record */
+  g_string_append_len(self->kv, self->key->str, self->key->len + 1);
+  g_string_append_len(self->kv, self->value->str, self->value->len + 1);
+}
+
+static gboolean
+json_scanner_parse_hex4(JSONScanner *self, gunichar *code)
+{
+  gunichar value = 0;
+  gint i;
+
+  if (self->end - self->p < 4)
+    return FALSE;
+  for (i = 0; i < 4; i++)
+    {
+      gchar c = self->p[i];
+
+      value <<= 4;
+      if (c >= '0' && c <= '9')
+        value |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        value |= c - 'A' + 10;
+      else
+        return FALSE;
+    }
+  self->p += 4;
+  *code = value;
+  return TRUE;
+}
+
+/* self->p points at the 'u' of a \u escape */
+static gboolean
+json_scanner_parse_unicode_escape(JSONScanner *self, GString *target)
+{
+  gunichar code, low;
+  gchar utf8_buf[6];
+
+  self->p++;
+  if (!json_scanner_parse_hex4(self, &code))
+    return FALSE;
+  if (code >= 0xD800 && code <= 0xDBFF)
+    {
+      /* high surrogate, must be followed by a low one */
+      if (self->end - self->p < 2 || self->p[0] != '\\' || self->p[1] != 'u')
+        return FALSE;
+      self->p += 2;
+      if (!json_scanner_parse_hex4(self, &low))
+        return FALSE;
+      if (low < 0xDC00 || low > 0xDFFF)
+        return FALSE;
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+  else if (code >= 0xDC00 && code <= 0xDFFF)
+    return FALSE;
+  if (code == 0)
+    {
+      /* an embedded NUL would desync the NUL-delimited staging buffer
+       * walked in json_parser_process_streaming(); bail out so the
+       * message falls through to the json-c parser instead */
+      return FALSE;
+    }
+  g_string_append_len(target, utf8_buf, g_unichar_to_utf8(code, utf8_buf));
+  return TRUE;
+}
+
+/* NOTE: single quoted strings are accepted just as by the non-strict
+ * json-c tokener */
+static gboolean
+json_scanner_parse_string(JSONScanner *self, GString *target)
+{
+  gchar quote;
+
+  g_string_truncate(target, 0);
+  if (self->p >= self->end || (*self->p != '"' && *self->p != '\''))
+    return FALSE;
+  quote = *self->p++;
+  while (self->p < self->end && *self->p != quote)
+    {
+      if (*self->p == '\\')
+        {
+          self->p++;
+          if (self->p >= self->end)
+            return FALSE;
+          switch (*self->p)
+            {
+            case '"':
+            case '\'':
+            case '\\':
+            case '/':
+              g_string_append_c(target, *self->p);
+              break;
+            case 'b':
+              g_string_append_c(target, '\b');
+              break;
+            case 'f':
+              g_string_append_c(target, '\f');
+              break;
+            case 'n':
+              g_string_append_c(target, '\n');
+              break;
+            case 'r':
+              g_string_append_c(target, '\r');
+              break;
+            case 't':
+              g_string_append_c(target, '\t');
+              break;
+            case 'u':
+              if (!json_scanner_parse_unicode_escape(self, target))
+                return FALSE;
+              continue;
+            default:
+              return FALSE;
+            }
+          self->p++;
+        }
+      else
+        g_string_append_c(target, *self->p++);
+    }
+  if (self->p >= self->end)
+    return FALSE;
+  self->p++;
+  return TRUE;
+}
+
+static gboolean
+json_scanner_parse_number(JSONScanner *self)
+{
+  const gchar *start = self->p;
+  gboolean is_double = FALSE;
+  gchar num[64];
+  gsize len;
+
+  if (self->p < self->end && *self->p == '-')
+    self->p++;
+  while (self->p < self->end &&
+         (g_ascii_isdigit(*self->p) ||
+          *self->p == '.' || *self->p == 'e' || *self->p == 'E' ||
+          *self->p == '+' || *self->p == '-'))
+    {
+      if (*self->p == '.' || *self->p == 'e' || *self->p == 'E')
+        is_double = TRUE;
+      self->p++;
+    }
+  len = self->p - start;
+  if (len == 0 || len >= sizeof(num))
+    return FALSE;
+  memcpy(num, start, len);
+  num[len] = 0;
+
+  /* format exactly as the json-c based walk would */
+  if (is_double)
+    g_string_printf(self->value, "%f", g_ascii_strtod(num, NULL));
+  else
+    {
+      glong l = strtol(num, NULL, 10);
+
+      if (l > G_MAXINT)
+        l = G_MAXINT;
+      else if (l < G_MININT)
+        l = G_MININT;
+      g_string_printf(self->value, "%i", (gint) l);
+    }
+  return TRUE;
+}
+
+static gboolean
+json_scanner_parse_literal(JSONScanner *self, const gchar *literal, const gchar *value)
+{
+  gsize len = strlen(literal);
+
+  if ((gsize) (self->end - self->p) < len || memcmp(self->p, literal, len) != 0)
+    return FALSE;
+  self->p += len;
+  if (value)
+    {
+      g_string_assign(self->value, value);
+      json_scanner_emit(self);
+    }
+  return TRUE;
+}
+
+/* self->p points at the '{'; the caller already appended the trailing
+ * dot to self->key if this is a nested object */
+static gboolean
+json_scanner_parse_object(JSONScanner *self, gint depth)
+{
+  gsize key_len = self->key->len;
+
+  self->p++;
+  json_scanner_skip_ws(self);
+  if (self->p < self->end && *self->p == '}')
+    {
+      self->p++;
+      return TRUE;
+    }
+  while (1)
+    {
+      json_scanner_skip_ws(self);
+      g_string_truncate(self->key, key_len);
+      if (!json_scanner_parse_string(self, self->value))
+        return FALSE;
+      g_string_append_len(self->key, self->value->str, self->value->len);
+      json_scanner_skip_ws(self);
+      if (self->p >= self->end || *self->p != ':')
+        return FALSE;
+      self->p++;
+      if (!json_scanner_parse_value(self, depth))
+        return FALSE;
+      json_scanner_skip_ws(self);
+      if (self->p >= self->end)
+        return FALSE;
+      if (*self->p == ',')
+        {
+          self->p++;
+          continue;
+        }
+      if (*self->p == '}')
+        {
+          self->p++;
+          g_string_truncate(self->key, key_len);
+          return TRUE;
+        }
+      return FALSE;
+    }
+}
+
+static gboolean
+json_scanner_parse_array(JSONScanner *self, gint depth)
+{
+  gsize key_len = self->key->len;
+  gint i = 0;
+
+  self->p++;
+  json_scanner_skip_ws(self);
+  if (self->p < self->end && *self->p == ']')
+    {
+      self->p++;
+      return TRUE;
+    }
+  while (1)
+    {
+      g_string_truncate(self->key, key_len);
+      g_string_append_printf(self->key, "[%d]", i);
+      if (!json_scanner_parse_value(self, depth))
+        return FALSE;
+      json_scanner_skip_ws(self);
+      if (self->p >= self->end)
+        return FALSE;
+      if (*self->p == ',')
+        {
+          self->p++;
+          i++;
+          continue;
+        }
+      if (*self->p == ']')
+        {
+          self->p++;
+          g_string_truncate(self->key, key_len);
+          return TRUE;
+        }
+      return FALSE;
+    }
+}
+
+static gboolean
+json_scanner_parse_value(JSONScanner *self, gint depth)
+{
+  if (depth >= JSON_SCANNER_MAX_DEPTH)
+    return FALSE;
+
+  json_scanner_skip_ws(self);
+  if (self->p >= self->end)
+    return FALSE;
+
+  switch (*self->p)
+    {
+    case '{':
+      g_string_append_c(self->key, '.');
+      return json_scanner_parse_object(self, depth + 1);
+    case '[':
+      return json_scanner_parse_array(self, depth + 1);
+    case '"':
+    case '\'':
+      if (!json_scanner_parse_string(self, self->value))
+        return FALSE;
+      json_scanner_emit(self);
+      return TRUE;
+    case 't':
+      return json_scanner_parse_literal(self, "true", "true");
+    case 'f':
+      return json_scanner_parse_literal(self, "false", "false");
+    case 'n':
+      return json_scanner_parse_literal(self, "null", NULL);
+    default:
+      if (!json_scanner_parse_number(self))
+        return FALSE;
+      json_scanner_emit(self);
+      return TRUE;
+    }
+}
+
+static gboolean
+json_parser_process_streaming(JSONParser *self, LogMessage *msg, const gchar *input, gsize input_len)
+{
+  JSONScanner scanner;
+  SBGString *key, *value, *kv;
+  gboolean success;
+
+  key = sb_gstring_acquire();
+  value = sb_gstring_acquire();
+  kv = sb_gstring_acquire();
+
+  scanner.p = input;
+  scanner.end = input + input_len;
+  scanner.key = sb_gstring_string(key);
+  scanner.value = sb_gstring_string(value);
+  scanner.kv = sb_gstring_string(kv);
+  g_string_truncate(scanner.key, 0);
+  g_string_truncate(scanner.kv, 0);
+  if (self->prefix)
+    g_string_assign(scanner.key, self->prefix);
+
+  json_scanner_skip_ws(&scanner);
+  success = (scanner.p < scanner.end && *scanner.p == '{') &&
+    json_scanner_parse_object(&scanner, 0);
+
+  if (success)
+    {
+      const gchar *record = scanner.kv->str;
+      const gchar *kv_end = scanner.kv->str + scanner.kv->len;
+
+      while (record < kv_end)
+        {
+          const gchar *name = record;
+          const gchar *record_value;
+          gsize value_len;
+
+          record += strlen(name) + 1;
+          record_value = record;
+          value_len = strlen(record_value);
+          record += value_len + 1;
+          log_msg_set_value_by_name(msg, name, record_value, value_len);
+        }
+    }
+
+  sb_gstring_release(key);
+  sb_gstring_release(value);
+  sb_gstring_release(kv);
+  return success;
+}
+
 static gboolean
 json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
 {
@@ -211,12 +605,25 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
 
   if (self->marker)
     {
+      const gchar *unskipped_input = input;
+
       if (strncmp(input, self->marker, self->marker_len) != 0)
         return FALSE;
       input += self->marker_len;
 
       while (isspace(*input))
         input++;
+      input_len -= input - unskipped_input;
+    }
+
+  if (!self->extract_prefix)
+    {
+      log_msg_make_writable(pmsg, path_options);
+      if (json_parser_process_streaming(self, *pmsg, input, input_len))
+        return TRUE;
+
+      /* the scanner bailed out, retry with the full json-c parse, which
+       * also takes care of reporting parse errors */
     }
 
   tok = json_tokener_new();
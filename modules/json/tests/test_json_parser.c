@@ -151,6 +151,31 @@ test_json_parser_validate_type_representation(void)
   log_msg_unref(msg);
 }
 
+static void
+test_json_parser_unescapes_strings(void)
+{
+  LogMessage *msg;
+
+  msg = parse_json_into_log_message("{'tab': 'foo\\tbar', 'unicode': '\\u00e1'}");
+  assert_log_message_value(msg, log_msg_get_value_handle("tab"), "foo\tbar");
+  assert_log_message_value(msg, log_msg_get_value_handle("unicode"), "\xc3\xa1");
+  log_msg_unref(msg);
+}
+
+static void
+test_json_parser_embedded_nul_does_not_desync_pairs(void)
+{
+  LogMessage *msg;
+
+  /* a \u0000 escape is refused by the streaming scanner, such input
+   * ends up at the json-c parser, which truncates the value at the NUL
+   * instead of fabricating pairs out of the bytes behind it */
+  msg = parse_json_into_log_message("{'a': 'x\\u0000y', 'b': 'c'}");
+  assert_log_message_value(msg, log_msg_get_value_handle("a"), "x");
+  assert_log_message_value(msg, log_msg_get_value_handle("b"), "c");
+  log_msg_unref(msg);
+}
+
 static void
 test_json_parser_fails_for_non_object_top_element(void)
 {
@@ -178,6 +203,8 @@ test_json_parser(void)
   JSON_PARSER_TESTCASE(test_json_parser_fails_when_marker_is_not_present);
   JSON_PARSER_TESTCASE(test_json_parser_fails_for_invalid_json);
   JSON_PARSER_TESTCASE(test_json_parser_validate_type_representation);
+  JSON_PARSER_TESTCASE(test_json_parser_unescapes_strings);
+  JSON_PARSER_TESTCASE(test_json_parser_embedded_nul_does_not_desync_pairs);
   JSON_PARSER_TESTCASE(test_json_parser_fails_for_non_object_top_element);
   JSON_PARSER_TESTCASE(test_json_parser_extracts_subobjects_if_extract_prefix_is_specified);
 }
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <librdkafka/rdkafka.h>
+
+#include <errno.h>
+
+#include "kafka.h"
+#include "kafka-parser.h"
+#include "plugin.h"
+#include "messages.h"
+#include "misc.h"
+#include "stats/stats-registry.h"
+#include "logqueue.h"
+#include "driver.h"
+#include "plugin-types.h"
+#include "logthrdestdrv.h"
+
+/*
+ * This driver hands messages to the librdkafka producer, whose internal
+ * batching does the actual wire-level work.  Deliveries are confirmed
+ * asynchronously through delivery reports: worker.insert() returns
+ * QUEUED, and worker.flush() polls until all produced messages are
+ * reported, so the flow-control window is only released once the broker
+ * acknowledged the batch.  All librdkafka callbacks are served from
+ * rd_kafka_poll() invoked on the worker thread, thus the driver state
+ * needs no locking.
+ */
+
+typedef struct
+{
+  gchar *name;
+  gchar *value;
+} KafkaProperty;
+
+typedef struct
+{
+  LogThrDestDriver super;
+
+  gchar *bootstrap_servers;
+  GList *config;
+  gint flush_timeout;
+
+  LogTemplateOptions template_options;
+  LogTemplate *topic;
+  LogTemplate *key;
+  LogTemplate *message;
+
+  GString *topic_str;
+  GString *key_str;
+  GString *message_str;
+
+  rd_kafka_t *kafka;
+  /* formatted topic name -> rd_kafka_topic_t, topics are created lazily
+   * as template expansion produces new names */
+  GHashTable *topics;
+
+  /* messages produced but not yet confirmed by a delivery report; only
+   * touched from the worker thread */
+  gint outstanding;
+  gint failed;
+} KafkaDriver;
+
+/*
+ * Configuration
+ */
+
+void
+kafka_dd_set_bootstrap_servers(LogDriver *d, const gchar *servers)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  g_free(self->bootstrap_servers);
+  self->bootstrap_servers = g_strdup(servers);
+}
+
+void
+kafka_dd_set_topic(LogDriver *d, LogTemplate *topic)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  log_template_unref(self->topic);
+  self->topic = topic;
+}
+
+void
+kafka_dd_set_key(LogDriver *d, LogTemplate *key)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  log_template_unref(self->key);
+  self->key = key;
+}
+
+void
+kafka_dd_set_message(LogDriver *d, LogTemplate *message)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  log_template_unref(self->message);
+  self->message = message;
+}
+
+void
+kafka_dd_add_property(LogDriver *d, const gchar *name, const gchar *value)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+  KafkaProperty *prop = g_new0(KafkaProperty, 1);
+
+  prop->name = g_strdup(name);
+  prop->value = g_strdup(value);
+  self->config = g_list_append(self->config, prop);
+}
+
+void
+kafka_dd_set_flush_timeout(LogDriver *d, gint flush_timeout)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  self->flush_timeout = flush_timeout;
+}
+
+LogTemplateOptions *
+kafka_dd_get_template_options(LogDriver *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  return &self->template_options;
+}
+
+static void
+kafka_property_free(KafkaProperty *prop)
+{
+  g_free(prop->name);
+  g_free(prop->value);
+  g_free(prop);
+}
+
+/*
+ * Utilities
+ */
+
+static gchar *
+kafka_dd_format_stats_instance(LogThrDestDriver *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "kafka,%s,%s", self->bootstrap_servers,
+             self->topic ? self->topic->template : "");
+  return persist_name;
+}
+
+static gchar *
+kafka_dd_format_persist_name(LogThrDestDriver *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "kafka(%s,%s)", self->bootstrap_servers,
+             self->topic ? self->topic->template : "");
+  return persist_name;
+}
+
+/* invoked from rd_kafka_poll() on the worker thread for every produced
+ * message once its fate is settled by the broker */
+static void
+kafka_delivery_report_cb(rd_kafka_t *rk, const rd_kafka_message_t *rkmessage, void *opaque)
+{
+  KafkaDriver *self = (KafkaDriver *) opaque;
+
+  self->outstanding--;
+  if (rkmessage->err != RD_KAFKA_RESP_ERR_NO_ERROR)
+    {
+      self->failed++;
+      msg_debug("Kafka message delivery failed",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("topic", rd_kafka_topic_name(rkmessage->rkt)),
+                evt_tag_str("error", rd_kafka_err2str(rkmessage->err)),
+                NULL);
+    }
+}
+
+static gboolean
+kafka_dd_connect(KafkaDriver *self)
+{
+  rd_kafka_conf_t *conf;
+  gchar errbuf[256];
+  GList *l;
+
+  if (self->kafka)
+    return TRUE;
+
+  conf = rd_kafka_conf_new();
+  rd_kafka_conf_set_opaque(conf, self);
+  rd_kafka_conf_set_dr_msg_cb(conf, kafka_delivery_report_cb);
+
+  /* metadata.broker.list is the canonical name of bootstrap.servers */
+  if (rd_kafka_conf_set(conf, "metadata.broker.list", self->bootstrap_servers,
+                        errbuf, sizeof(errbuf)) != RD_KAFKA_CONF_OK)
+    {
+      msg_error("Kafka producer setup error, suspending",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("error", errbuf),
+                NULL);
+      rd_kafka_conf_destroy(conf);
+      return FALSE;
+    }
+
+  for (l = self->config; l; l = l->next)
+    {
+      KafkaProperty *prop = l->data;
+
+      if (rd_kafka_conf_set(conf, prop->name, prop->value,
+                            errbuf, sizeof(errbuf)) != RD_KAFKA_CONF_OK)
+        {
+          msg_error("Kafka producer setup error, suspending",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("property", prop->name),
+                    evt_tag_str("value", prop->value),
+                    evt_tag_str("error", errbuf),
+                    NULL);
+          rd_kafka_conf_destroy(conf);
+          return FALSE;
+        }
+    }
+
+  self->kafka = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errbuf, sizeof(errbuf));
+  if (!self->kafka)
+    {
+      msg_error("Kafka producer creation failed, suspending",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("error", errbuf),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      rd_kafka_conf_destroy(conf);
+      return FALSE;
+    }
+
+  msg_debug("Kafka producer created",
+            evt_tag_str("driver", self->super.super.super.id),
+            evt_tag_str("bootstrap_servers", self->bootstrap_servers),
+            NULL);
+  return TRUE;
+}
+
+static gboolean
+kafka_dd_remove_topic(gpointer key, gpointer value, gpointer user_data)
+{
+  return TRUE;
+}
+
+static void
+kafka_dd_disconnect(LogThrDestDriver *s)
+{
+  KafkaDriver *self = (KafkaDriver *)s;
+
+  /* NOTE: messages already handed to librdkafka may still reach the
+   * broker while we tear the producer down; together with the rewind of
+   * the unconfirmed batch this makes delivery at-least-once */
+  if (self->topics)
+    g_hash_table_foreach_remove(self->topics, kafka_dd_remove_topic, NULL);
+  if (self->kafka)
+    {
+      rd_kafka_destroy(self->kafka);
+      self->kafka = NULL;
+    }
+  self->outstanding = 0;
+  self->failed = 0;
+}
+
+static rd_kafka_topic_t *
+kafka_dd_get_topic(KafkaDriver *self, const gchar *name)
+{
+  rd_kafka_topic_t *topic;
+
+  topic = g_hash_table_lookup(self->topics, name);
+  if (!topic)
+    {
+      topic = rd_kafka_topic_new(self->kafka, name, NULL);
+      if (!topic)
+        return NULL;
+      g_hash_table_insert(self->topics, g_strdup(name), topic);
+    }
+  return topic;
+}
+
+/*
+ * Worker thread
+ */
+
+static worker_insert_result_t
+kafka_worker_insert(LogThrDestDriver *s, LogMessage *msg)
+{
+  KafkaDriver *self = (KafkaDriver *)s;
+  rd_kafka_topic_t *topic;
+
+  if (!kafka_dd_connect(self))
+    return WORKER_INSERT_RESULT_NOT_CONNECTED;
+
+  log_template_format(self->topic, msg, &self->template_options, LTZ_SEND,
+                      self->super.seq_num, NULL, self->topic_str);
+  log_template_format(self->message, msg, &self->template_options, LTZ_SEND,
+                      self->super.seq_num, NULL, self->message_str);
+  if (self->key)
+    log_template_format(self->key, msg, &self->template_options, LTZ_SEND,
+                        self->super.seq_num, NULL, self->key_str);
+
+  topic = kafka_dd_get_topic(self, self->topic_str->str);
+  if (!topic)
+    {
+      msg_error("Kafka topic creation failed, suspending",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("topic", self->topic_str->str),
+                evt_tag_str("error", rd_kafka_err2str(rd_kafka_errno2err(errno))),
+                NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  if (rd_kafka_produce(topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
+                       self->message_str->str, self->message_str->len,
+                       self->key ? self->key_str->str : NULL,
+                       self->key ? self->key_str->len : 0,
+                       NULL) < 0)
+    {
+      rd_kafka_resp_err_t err = rd_kafka_errno2err(errno);
+
+      if (err == RD_KAFKA_RESP_ERR__QUEUE_FULL)
+        {
+          /* the producer queue is backed up, serve pending delivery
+           * reports and have the message retried */
+          rd_kafka_poll(self->kafka, 100);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+
+      msg_error("Kafka produce failed, suspending",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("topic", self->topic_str->str),
+                evt_tag_str("error", rd_kafka_err2str(err)),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+  self->outstanding++;
+
+  /* serve delivery report callbacks without blocking, the confirmation
+   * itself is deferred until the flush */
+  rd_kafka_poll(self->kafka, 0);
+
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+static worker_insert_result_t
+kafka_worker_flush(LogThrDestDriver *s)
+{
+  KafkaDriver *self = (KafkaDriver *)s;
+  gint slept = 0;
+
+  /* wait for the delivery report of every message produced so far; the
+   * wait is bounded, a wedged broker must not block the worker forever */
+  while (self->outstanding > 0 && slept < self->flush_timeout)
+    {
+      rd_kafka_poll(self->kafka, 100);
+      slept += 100;
+    }
+
+  if (self->outstanding > 0 || self->failed > 0)
+    {
+      msg_error("Kafka delivery confirmation failed, rewinding the unconfirmed batch",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_int("outstanding", self->outstanding),
+                evt_tag_int("failed", self->failed),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  msg_debug("Kafka batch confirmed",
+            evt_tag_str("driver", self->super.super.super.id),
+            evt_tag_int("batch_size", s->queued_messages),
+            NULL);
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
+static void
+kafka_worker_thread_init(LogThrDestDriver *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  msg_debug("Worker thread started",
+            evt_tag_str("driver", self->super.super.super.id),
+            NULL);
+
+  self->topic_str = g_string_sized_new(64);
+  self->key_str = g_string_sized_new(64);
+  self->message_str = g_string_sized_new(1024);
+  self->topics = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, (GDestroyNotify) rd_kafka_topic_destroy);
+
+  kafka_dd_connect(self);
+}
+
+static void
+kafka_worker_thread_deinit(LogThrDestDriver *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  kafka_dd_disconnect(d);
+  g_hash_table_destroy(self->topics);
+  self->topics = NULL;
+  g_string_free(self->topic_str, TRUE);
+  g_string_free(self->key_str, TRUE);
+  g_string_free(self->message_str, TRUE);
+}
+
+/*
+ * Main thread
+ */
+
+static gboolean
+kafka_dd_init(LogPipe *s)
+{
+  KafkaDriver *self = (KafkaDriver *)s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_dest_driver_init_method(s))
+    return FALSE;
+
+  if (!self->topic)
+    {
+      msg_error("Error initializing Kafka destination, the topic() argument is required",
+                evt_tag_str("driver", self->super.super.super.id),
+                NULL);
+      return FALSE;
+    }
+
+  if (!self->message)
+    {
+      self->message = log_template_new(cfg, NULL);
+      log_template_compile(self->message, "$ISODATE $HOST $MSGHDR$MSG", NULL);
+    }
+
+  log_template_options_init(&self->template_options, cfg);
+
+  msg_verbose("Initializing Kafka destination",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("bootstrap_servers", self->bootstrap_servers),
+              evt_tag_str("topic", self->topic->template),
+              NULL);
+
+  return log_threaded_dest_driver_start(s);
+}
+
+static void
+kafka_dd_free(LogPipe *d)
+{
+  KafkaDriver *self = (KafkaDriver *)d;
+
+  log_template_options_destroy(&self->template_options);
+
+  g_free(self->bootstrap_servers);
+  log_template_unref(self->topic);
+  log_template_unref(self->key);
+  log_template_unref(self->message);
+  g_list_foreach(self->config, (GFunc) kafka_property_free, NULL);
+  g_list_free(self->config);
+
+  log_threaded_dest_driver_free(d);
+}
+
+/*
+ * Plugin glue.
+ */
+
+LogDriver *
+kafka_dd_new(GlobalConfig *cfg)
+{
+  KafkaDriver *self = g_new0(KafkaDriver, 1);
+
+  log_threaded_dest_driver_init_instance(&self->super, cfg);
+  self->super.super.super.super.init = kafka_dd_init;
+  self->super.super.super.super.free_fn = kafka_dd_free;
+
+  self->super.worker.thread_init = kafka_worker_thread_init;
+  self->super.worker.thread_deinit = kafka_worker_thread_deinit;
+  self->super.worker.disconnect = kafka_dd_disconnect;
+  self->super.worker.insert = kafka_worker_insert;
+  self->super.worker.flush = kafka_worker_flush;
+
+  self->super.format.stats_instance = kafka_dd_format_stats_instance;
+  self->super.format.persist_name = kafka_dd_format_persist_name;
+  self->super.stats_source = SCS_KAFKA;
+
+  kafka_dd_set_bootstrap_servers((LogDriver *)self, "127.0.0.1:9092");
+  self->flush_timeout = 10000;
+
+  log_template_options_defaults(&self->template_options);
+
+  return (LogDriver *)self;
+}
+
+static Plugin kafka_plugin =
+{
+  .type = LL_CONTEXT_DESTINATION,
+  .name = "kafka",
+  .parser = &kafka_parser,
+};
+
+gboolean
+kafka_module_init(GlobalConfig *cfg, CfgArgs *args)
+{
+  plugin_register(cfg, &kafka_plugin, 1);
+
+  return TRUE;
+}
+
+const ModuleInfo module_info =
+{
+  .canonical_name = "kafka",
+  .version = SYSLOG_NG_VERSION,
+  .description = "The kafka module provides a native Kafka destination for syslog-ng.",
+  .core_revision = SYSLOG_NG_SOURCE_REVISION,
+  .plugins = &kafka_plugin,
+  .plugins_len = 1,
+};
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2015 BalaBit IT Ltd, Budapest, Hungary
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef KAFKA_H_INCLUDED
+#define KAFKA_H_INCLUDED
+
+#include "driver.h"
+#include "template/templates.h"
+
+LogDriver *kafka_dd_new(GlobalConfig *cfg);
+
+void kafka_dd_set_bootstrap_servers(LogDriver *d, const gchar *servers);
+void kafka_dd_set_topic(LogDriver *d, LogTemplate *topic);
+void kafka_dd_set_key(LogDriver *d, LogTemplate *key);
+void kafka_dd_set_message(LogDriver *d, LogTemplate *message);
+void kafka_dd_add_property(LogDriver *d, const gchar *name, const gchar *value);
+void kafka_dd_set_flush_timeout(LogDriver *d, gint flush_timeout);
+LogTemplateOptions *kafka_dd_get_template_options(LogDriver *d);
+
+#endif
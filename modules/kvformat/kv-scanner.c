@@ -78,6 +78,16 @@ _kv_scanner_extract_key(KVScanner *self)
   return TRUE;
 }
 
+/* bytes that terminate or alter an unquoted value: NUL, space, quotes
+ * and the comma of a possible ", " separator; runs of anything else are
+ * copied in one go */
+static const guint8 kv_scanner_value_stop_chars[256] =
+{
+  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x00 */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x10 */
+  1, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0,  /* 0x20: space, '"', '\'' and ',' */
+};
+
 static gboolean
 _kv_scanner_extract_value(KVScanner *self)
 {
@@ -90,6 +100,26 @@ _kv_scanner_extract_value(KVScanner *self)
   cur = &self->input[self->input_pos];
   while (*cur && self->quote_state != KV_QUOTE_FINISH)
     {
+      const gchar *run_start = cur;
+
+      /* fast path: copy the run of characters without special meaning in
+       * the current state at once, the character-wise state machine below
+       * only deals with the interesting bytes */
+      if (self->quote_state == KV_QUOTE_INITIAL)
+        {
+          while (!kv_scanner_value_stop_chars[*(const guchar *) cur])
+            cur++;
+        }
+      else if (self->quote_state == KV_QUOTE_STRING)
+        {
+          while (*cur && *cur != self->quote_char && *cur != '\\')
+            cur++;
+        }
+      if (cur != run_start)
+        g_string_append_len(self->value, run_start, cur - run_start);
+      if (!*cur)
+        break;
+
       switch (self->quote_state)
         {
         case KV_QUOTE_INITIAL:
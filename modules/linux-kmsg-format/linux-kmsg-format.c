@@ -35,6 +35,8 @@ static NVHandle KMSG_LM_V_DEV_MAJOR;
 static NVHandle KMSG_LM_V_DEV_NAME;
 static NVHandle KMSG_LM_V_NETDEV_INDEX;
 static NVHandle KMSG_LM_V_TIMESTAMP;
+static GHashTable *kmsg_kv_handles;
+static GStaticMutex kmsg_kv_handles_lock = G_STATIC_MUTEX_INIT;
 static struct timeval boot_time;
 
 /*
@@ -264,12 +266,59 @@ kmsg_parse_device_key_value_pair(const guchar *value, gsize length,
     }
 }
 
+static NVHandle
+kmsg_lookup_kv_handle_slow(const guchar *name, gsize name_len)
+{
+  SBGString *full_name;
+  NVHandle handle;
+
+  full_name = sb_gstring_acquire();
+
+  g_string_assign(sb_gstring_string(full_name), ".linux.");
+  g_string_append_len(sb_gstring_string(full_name), (const gchar *) name, name_len);
+  handle = log_msg_get_value_handle(sb_gstring_string(full_name)->str);
+  sb_gstring_release(full_name);
+  return handle;
+}
+
+/* The same few key names (SUBSYSTEM, DEVICE, ...) repeat in every record,
+ * but turning a name into an NVHandle means assembling the ".linux."
+ * prefixed string and searching the registry, for every pair of every
+ * record.  Cache the handles by key name instead; handles live for the
+ * entire process, so the cache never needs invalidation. */
+static NVHandle
+kmsg_get_kv_handle(const guchar *name, gsize name_len)
+{
+  gchar key[64];
+  NVHandle handle;
+
+  if (name_len >= sizeof(key))
+    return kmsg_lookup_kv_handle_slow(name, name_len);
+
+  memcpy(key, name, name_len);
+  key[name_len] = 0;
+
+  g_static_mutex_lock(&kmsg_kv_handles_lock);
+  handle = GPOINTER_TO_UINT(g_hash_table_lookup(kmsg_kv_handles, key));
+  g_static_mutex_unlock(&kmsg_kv_handles_lock);
+  if (handle)
+    return handle;
+
+  handle = kmsg_lookup_kv_handle_slow(name, name_len);
+
+  /* a concurrent insert of the same name simply replaces the key with an
+   * identical handle, no harm done */
+  g_static_mutex_lock(&kmsg_kv_handles_lock);
+  g_hash_table_insert(kmsg_kv_handles, g_strdup(key), GUINT_TO_POINTER(handle));
+  g_static_mutex_unlock(&kmsg_kv_handles_lock);
+  return handle;
+}
+
 static gsize
 kmsg_parse_key_value_pair(const guchar *data, gsize pos, gsize length,
                           LogMessage *msg)
 {
   gsize name_start, name_len, value_start, value_len;
-  SBGString *name;
 
   while (pos < length && (data[pos] == ' ' || data[pos] == '\t'))
     pos++;
@@ -297,15 +346,9 @@ kmsg_parse_key_value_pair(const guchar *data, gsize pos, gsize length,
       return pos;
     }
 
-  name = sb_gstring_acquire();
-
-  g_string_assign(sb_gstring_string(name), ".linux.");
-  g_string_append_len(sb_gstring_string(name), (const gchar *)data + name_start, name_len);
-
   log_msg_set_value(msg,
-                    log_msg_get_value_handle(sb_gstring_string(name)->str),
+                    kmsg_get_kv_handle(data + name_start, name_len),
                     (const gchar *)data + value_start, value_len);
-  sb_gstring_release(name);
 
   return pos;
 }
@@ -447,6 +490,7 @@ linux_msg_format_init(void)
       KMSG_LM_V_DEV_NAME = log_msg_get_value_handle(".linux.DEVICE.name");
       KMSG_LM_V_NETDEV_INDEX = log_msg_get_value_handle(".linux.DEVICE.index");
       KMSG_LM_V_TIMESTAMP = log_msg_get_value_handle(".linux.timestamp");
+      kmsg_kv_handles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
 #ifdef __linux__
       kmsg_init_boot_time();
@@ -46,12 +46,17 @@ typedef struct
   GHashTable *options;
   ValuePairs *vp;
 
+  /* messages deferred for the next flush, so the GIL is only taken once
+   * per batch; only used with pipeline() */
+  GPtrArray *batch;
+
   struct
   {
     PyObject *class;
     PyObject *instance;
     PyObject *is_opened;
     PyObject *send;
+    PyObject *send_batch;
   } py;
 } PythonDestDriver;
 
@@ -322,6 +327,7 @@ _py_init_bindings(PythonDestDriver *self)
   /* these are fast paths, store references to be faster */
   self->py.is_opened = _py_get_attr_or_null(self->py.instance, "is_opened");
   self->py.send = _py_get_attr_or_null(self->py.instance, "send");
+  self->py.send_batch = _py_get_attr_or_null(self->py.instance, "send_batch");
   if (!self->py.send)
     {
       msg_error("Error initializing Python destination, class does not have a send() method",
@@ -339,6 +345,7 @@ _py_free_bindings(PythonDestDriver *self)
   Py_CLEAR(self->py.instance);
   Py_CLEAR(self->py.is_opened);
   Py_CLEAR(self->py.send);
+  Py_CLEAR(self->py.send_batch);
 }
 
 static gboolean
@@ -355,6 +362,91 @@ _py_init_object(PythonDestDriver *self)
   return TRUE;
 }
 
+static void
+python_dd_drop_batch(PythonDestDriver *self)
+{
+  guint i;
+
+  for (i = 0; i < self->batch->len; i++)
+    log_msg_unref(g_ptr_array_index(self->batch, i));
+  g_ptr_array_set_size(self->batch, 0);
+}
+
+static worker_insert_result_t
+python_dd_flush(LogThrDestDriver *d)
+{
+  PythonDestDriver *self = (PythonDestDriver *)d;
+  worker_insert_result_t result = WORKER_INSERT_RESULT_ERROR;
+  PyGILState_STATE gstate;
+  PyObject *list = NULL;
+  gboolean success;
+  guint i;
+
+  if (self->batch->len == 0)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  gstate = PyGILState_Ensure();
+  if (!_py_invoke_is_opened(self))
+    goto exit;
+
+  list = PyList_New(0);
+  for (i = 0; i < self->batch->len; i++)
+    {
+      LogMessage *msg = g_ptr_array_index(self->batch, i);
+      PyObject *msg_object;
+
+      if (self->vp)
+        {
+          success = py_value_pairs_apply(self->vp, &self->template_options, self->super.seq_num, msg, &msg_object);
+          if (!success)
+            {
+              if (self->template_options.on_error & ON_ERROR_DROP_MESSAGE)
+                continue;
+              goto exit;
+            }
+        }
+      else
+        {
+          msg_object = py_log_message_new(msg);
+        }
+      PyList_Append(list, msg_object);
+      Py_DECREF(msg_object);
+    }
+
+  if (self->py.send_batch)
+    {
+      success = _py_invoke_bool_function(self, self->py.send_batch, list);
+    }
+  else
+    {
+      /* no send_batch() in the class: call send() per message, but still
+       * under a single GIL acquisition for the whole batch */
+      success = TRUE;
+      for (i = 0; success && i < (guint) PyList_GET_SIZE(list); i++)
+        success = _py_invoke_send(self, PyList_GET_ITEM(list, i));
+    }
+
+  if (success)
+    {
+      result = WORKER_INSERT_RESULT_SUCCESS;
+    }
+  else
+    {
+      msg_error("Python send() method returned failure, suspending destination for time_reopen()",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("class", self->class),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+    }
+
+ exit:
+  Py_XDECREF(list);
+  PyGILState_Release(gstate);
+  /* on failure the driver rewinds its backlog and inserts the batch again */
+  python_dd_drop_batch(self);
+  return result;
+}
+
 static worker_insert_result_t
 python_dd_insert(LogThrDestDriver *d, LogMessage *msg)
 {
@@ -364,6 +456,14 @@ python_dd_insert(LogThrDestDriver *d, LogMessage *msg)
   PyObject *msg_object;
   PyGILState_STATE gstate;
 
+  if (d->pipeline_depth >= 2)
+    {
+      /* defer all Python work to the flush, so the GIL is taken once per
+       * batch instead of once per message */
+      g_ptr_array_add(self->batch, log_msg_ref(msg));
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
   gstate = PyGILState_Ensure();
   if (!_py_invoke_is_opened(self))
     {
@@ -447,6 +547,7 @@ python_dd_disconnect(LogThrDestDriver *d)
 {
   PythonDestDriver *self = (PythonDestDriver *) d;
 
+  python_dd_drop_batch(self);
   python_dd_close(self);
 }
 
@@ -519,6 +620,9 @@ python_dd_free(LogPipe *d)
 
   g_free(self->class);
 
+  python_dd_drop_batch(self);
+  g_ptr_array_free(self->batch, TRUE);
+
   if (self->vp)
     value_pairs_free(self->vp);
 
@@ -544,12 +648,14 @@ python_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_deinit = python_dd_worker_deinit;
   self->super.worker.disconnect = python_dd_disconnect;
   self->super.worker.insert = python_dd_insert;
+  self->super.worker.flush = python_dd_flush;
 
   self->super.format.stats_instance = python_dd_format_stats_instance;
   self->super.format.persist_name = python_dd_format_persist_name;
   self->super.stats_source = SCS_PYTHON;
 
   self->options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->batch = g_ptr_array_new();
 
   return (LogDriver *)self;
 }
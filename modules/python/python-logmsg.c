@@ -37,15 +37,48 @@ py_log_message_getattr(PyLogMessage *self, gchar *name)
 {
   NVHandle handle;
   const gchar *value;
+  gssize value_len = 0;
 
   handle = log_msg_get_value_handle(name);
-  value = log_msg_get_value(self->msg, handle, NULL);
+  value = log_msg_get_value(self->msg, handle, &value_len);
   if (!value)
     {
       PyErr_SetString(PyExc_AttributeError, "No such attribute");
       return NULL;
     }
-  return PyBytes_FromString(value);
+  return PyBytes_FromStringAndSize(value, value_len);
+}
+
+/*
+ * Subscript access is the zero-copy fast path: msg['MSG'] returns a
+ * read-only memoryview straight over the NVTable entry, no bytes are
+ * copied. The view keeps the proxy (and thus the message) alive, but is
+ * only valid as long as the value is not rewritten.
+ */
+static PyObject *
+py_log_message_subscript(PyLogMessage *self, PyObject *key)
+{
+  gchar *name;
+  NVHandle handle;
+  const gchar *value;
+  gssize value_len = 0;
+  Py_buffer view;
+
+  name = PyBytes_AsString(key);
+  if (!name)
+    return NULL;
+
+  handle = log_msg_get_value_handle(name);
+  value = log_msg_get_value(self->msg, handle, &value_len);
+  if (!value)
+    {
+      PyErr_SetObject(PyExc_KeyError, key);
+      return NULL;
+    }
+
+  if (PyBuffer_FillInfo(&view, (PyObject *) self, (void *) value, value_len, 1, PyBUF_FULL_RO) < 0)
+    return NULL;
+  return PyMemoryView_FromBuffer(&view);
 }
 
 static void
@@ -68,6 +101,13 @@ py_log_message_new(LogMessage *msg)
   return (PyObject *) self;
 }
 
+static PyMappingMethods py_log_message_mapping =
+{
+  .mp_length = NULL,
+  .mp_subscript = (binaryfunc) py_log_message_subscript,
+  .mp_ass_subscript = NULL,
+};
+
 static PyTypeObject py_log_message_type =
 {
   PyObject_HEAD_INIT(&PyType_Type)
@@ -76,6 +116,7 @@ static PyTypeObject py_log_message_type =
   .tp_dealloc = (destructor) py_log_message_free,
   .tp_getattr = (getattrfunc) py_log_message_getattr,
   .tp_setattr = (setattrfunc) NULL,
+  .tp_as_mapping = &py_log_message_mapping,
   .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
   .tp_doc = "LogMessage class encapsulating a syslog-ng log message",
   .tp_new = PyType_GenericNew,
@@ -223,6 +223,29 @@ redis_worker_insert(LogThrDestDriver *s, LogMessage *msg)
       argc++;
     }
 
+  if (self->super.pipeline_depth > 1)
+    {
+      if (redisAppendCommandArgv(self->c, argc, argv, argvlen) != REDIS_OK)
+        {
+          msg_error("REDIS server error, suspending",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("command", self->command->str),
+                    evt_tag_str("key", self->key_str->str),
+                    evt_tag_str("error", self->c->errstr),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+
+      msg_debug("REDIS command appended to the pipeline",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("command", self->command->str),
+                evt_tag_str("key", self->key_str->str),
+                NULL);
+
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
   reply = redisCommandArgv(self->c, argc, argv, argvlen);
 
   if (!reply)
@@ -251,6 +274,36 @@ redis_worker_insert(LogThrDestDriver *s, LogMessage *msg)
   return WORKER_INSERT_RESULT_SUCCESS;
 }
 
+static worker_insert_result_t
+redis_worker_flush(LogThrDestDriver *s)
+{
+  RedisDriver *self = (RedisDriver *)s;
+  redisReply *reply;
+  gint i;
+
+  for (i = 0; i < s->queued_messages; i++)
+    {
+      /* the first redisGetReply() call also flushes the output buffer */
+      if (redisGetReply(self->c, (void **) &reply) != REDIS_OK)
+        {
+          msg_error("REDIS server error while reading pipelined replies, suspending",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("error", self->c->errstr),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+      freeReplyObject(reply);
+    }
+
+  msg_debug("REDIS pipeline flushed",
+            evt_tag_str("driver", self->super.super.super.id),
+            evt_tag_int("replies", s->queued_messages),
+            NULL);
+
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
 static void
 redis_worker_thread_init(LogThrDestDriver *d)
 {
@@ -336,6 +389,7 @@ redis_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_deinit = redis_worker_thread_deinit;
   self->super.worker.disconnect = redis_dd_disconnect;
   self->super.worker.insert = redis_worker_insert;
+  self->super.worker.flush = redis_worker_flush;
 
   self->super.format.stats_instance = redis_dd_format_stats_instance;
   self->super.format.persist_name = redis_dd_format_persist_name;
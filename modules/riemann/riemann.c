@@ -256,9 +256,18 @@ static void
 riemann_dd_disconnect(LogThrDestDriver *s)
 {
   RiemannDestDriver *self = (RiemannDestDriver *)s;
+  gint i;
 
   riemann_client_disconnect(self->client);
   self->client = NULL;
+
+  /* unsent events are rewound onto the queue backlog by the caller and
+   * re-inserted after reconnecting, drop the stale copies */
+  g_static_mutex_lock(&self->event.lock);
+  for (i = 0; i < self->event.n; i++)
+    riemann_event_free(self->event.list[i]);
+  self->event.n = 0;
+  g_static_mutex_unlock(&self->event.lock);
 }
 
 static void
@@ -353,6 +362,11 @@ riemann_worker_init(LogPipe *s)
   self->event.list = (riemann_event_t **)malloc (sizeof (riemann_event_t *) *
                                                  self->event.batch_size_max);
 
+  /* flush-lines() is the batch trigger: accepted events are only
+   * confirmed towards the queue once their batch was sent, and a
+   * draining queue flushes partial batches right away */
+  self->super.pipeline_depth = self->event.batch_size_max;
+
   msg_verbose("Initializing Riemann destination",
               evt_tag_str("driver", self->super.super.super.id),
               evt_tag_str("server", self->server),
@@ -553,17 +567,21 @@ riemann_worker_insert_one(RiemannDestDriver *self, LogMessage *msg)
     return WORKER_INSERT_RESULT_DROP;
 
   if (success)
-    return WORKER_INSERT_RESULT_SUCCESS;
+    return WORKER_INSERT_RESULT_QUEUED;
   else
     return WORKER_INSERT_RESULT_ERROR;
 }
 
 static worker_insert_result_t
-riemann_worker_batch_flush(RiemannDestDriver *self)
+riemann_worker_flush(LogThrDestDriver *s)
 {
+  RiemannDestDriver *self = (RiemannDestDriver *)s;
   riemann_message_t *message;
   int r;
 
+  if (self->event.n == 0)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
   if (!riemann_dd_connect(self, TRUE))
     return WORKER_INSERT_RESULT_ERROR;
 
@@ -585,34 +603,17 @@ riemann_worker_batch_flush(RiemannDestDriver *self)
   g_static_mutex_unlock(&self->event.lock);
 
   if (r != 0)
-    return WORKER_INSERT_RESULT_DROP;
+    return WORKER_INSERT_RESULT_ERROR;
   else
     return WORKER_INSERT_RESULT_SUCCESS;
 }
 
 static worker_insert_result_t
 riemann_worker_insert(LogThrDestDriver *s, LogMessage *msg)
-{
-  RiemannDestDriver *self = (RiemannDestDriver *)s;
-  worker_insert_result_t result;
-
-  result = riemann_worker_insert_one(self, msg);
-
-  if (self->event.n < self->event.batch_size_max)
-    return result;
-
-  if (result != WORKER_INSERT_RESULT_SUCCESS)
-    return result;
-
-  return riemann_worker_batch_flush(self);
-}
-
-static void
-riemann_worker_thread_deinit(LogThrDestDriver *s)
 {
   RiemannDestDriver *self = (RiemannDestDriver *)s;
 
-  riemann_worker_batch_flush(self);
+  return riemann_worker_insert_one(self, msg);
 }
 
 /*
@@ -658,7 +659,7 @@ riemann_dd_new(GlobalConfig *cfg)
 
   self->super.worker.disconnect = riemann_dd_disconnect;
   self->super.worker.insert = riemann_worker_insert;
-  self->super.worker.thread_deinit = riemann_worker_thread_deinit;
+  self->super.worker.flush = riemann_worker_flush;
 
   self->super.format.stats_instance = riemann_dd_format_stats_instance;
   self->super.format.persist_name = riemann_dd_format_persist_name;
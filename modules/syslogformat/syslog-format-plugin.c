@@ -29,7 +29,8 @@
 
 static MsgFormatHandler syslog_handler =
 {
-  .parse = &syslog_format_handler
+  .parse = &syslog_format_handler,
+  .select_parse = &syslog_format_select_parse
 };
 
 static MsgFormatHandler *
@@ -39,6 +39,58 @@ static const char repeat_msg_string[] = "last message repeated";
 static NVHandle is_synced;
 static NVHandle cisco_seqid;
 
+/* Chatty applications repeat the same '<PRI>timestamp hostname
+ * program[pid]:' prefix for long runs of consecutive messages.  The last
+ * successfully parsed legacy header is cached together with its parse
+ * results, and when the next message starts with the very same raw bytes
+ * the parsed values are copied instead of re-parsed.
+ *
+ * The cache lives per worker thread: a reader drains its connection in
+ * batches, so back to back messages of one connection are parsed on the
+ * same thread.  Correctness never depends on the cache belonging to the
+ * "right" connection though, a hit is validated by comparing the raw
+ * bytes, so identical headers from unrelated connections match safely.
+ * Since the date heuristics (year inference, future timestamps) depend on
+ * the receive time, a cached parse is only reused within the wallclock
+ * second it was created in. */
+
+#define LEGACY_HEADER_CACHE_MAX_HEADER 256
+
+/* decisions in the header parser peek at most this many bytes beyond
+ * their current position (the AIX forward and "last message repeated"
+ * probes); a cached parse is only stored/reused when this many bytes
+ * beyond the header are available and identical, making those probes
+ * come out the same way */
+#define LEGACY_HEADER_CACHE_LOOKAHEAD 32
+
+/* name-value outputs a legacy header parse can produce, LEGACY_MSGHDR
+ * deliberately last: replaying PROGRAM/PID clears LF_LEGACY_MSGHDR */
+#define LEGACY_HEADER_CACHE_VALUES 6
+
+typedef struct _LegacyHeaderCache
+{
+  /* the options the cached parse ran with; the fields that steer header
+   * parsing are compared one by one, the same MsgFormatOptions instance
+   * may be reinitialized with different settings (config reload) */
+  const MsgFormatOptions *parse_options;
+  guint32 parse_flags;
+  guint16 default_pri;
+  regex_t *bad_hostname;
+  TimeZoneInfo *recv_time_zone_info;
+  gchar header[LEGACY_HEADER_CACHE_MAX_HEADER + LEGACY_HEADER_CACHE_LOOKAHEAD];
+  gint match_len;
+  gint header_len;
+  time_t recvd_sec;
+  guint16 pri;
+  gboolean legacy_msghdr;
+  LogStamp stamp;
+  gchar values[768];
+  guint16 value_ofs[LEGACY_HEADER_CACHE_VALUES];
+  gint16 value_len[LEGACY_HEADER_CACHE_VALUES];
+} LegacyHeaderCache;
+
+static GStaticPrivate priv_legacy_header_cache = G_STATIC_PRIVATE_INIT;
+
 static gboolean
 log_msg_parse_pri(LogMessage *self, const guchar **data, gint *length, guint flags, guint16 default_pri)
 {
@@ -405,7 +457,7 @@ __set_zone_offset(LogStamp * const timestamp, glong const assumed_timezone)
     }
   if (timestamp->zone_offset == -1)
     {
-      timestamp->zone_offset = get_local_timezone_ofs(timestamp->tv_sec);
+      timestamp->zone_offset = cached_get_local_timezone_ofs(timestamp->tv_sec);
     }
 }
 
@@ -691,6 +743,7 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
    */
 
   gboolean ret = FALSE;
+  gboolean lazy = !!(options->flags & LP_LAZY_SDATA);
   const guchar *src = *data;
   /* ASCII string */
   gchar sd_id_name[33];
@@ -753,7 +806,8 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
           strncpy(sd_value_name + logmsg_sd_prefix_len, sd_id_name, sizeof(sd_value_name) - logmsg_sd_prefix_len);
           if (*src == ']')
             {
-              log_msg_set_value_by_name(self, sd_value_name, "", 0);
+              if (!lazy)
+                log_msg_set_value_by_name(self, sd_value_name, "", 0);
             }
           else
             {
@@ -847,7 +901,8 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
                   goto error;
                 }
 
-              log_msg_set_value_by_name(self, sd_value_name, sd_param_value, sd_param_value_len);
+              if (!lazy)
+                log_msg_set_value_by_name(self, sd_value_name, sd_param_value, sd_param_value_len);
             }
 
           if (left && *src == ']')
@@ -869,6 +924,15 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
             }
         }
       while (left && open_sd != 0);
+
+      if (lazy)
+        {
+          /* the SD string is structurally valid, store it in one piece
+           * and let the .SDATA.* entries be materialized when something
+           * asks for them, see LF_LAZY_SDATA */
+          log_msg_set_value(self, LM_V_RAWSD, (gchar *) *data, src - *data);
+          self->flags |= LF_LAZY_SDATA;
+        }
     }
   ret = TRUE;
  error:
@@ -893,15 +957,56 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
  * Parse an RFC3164 formatted log message and store the parsed information
  * in @self. Parsing is affected by the bits set @flags argument.
  **/
+static void
+log_msg_parse_legacy_message(const MsgFormatOptions *parse_options,
+                             const guchar *src, gint left,
+                             LogMessage *self)
+{
+  if (parse_options->flags & LP_SANITIZE_UTF8 && !validate_utf8((gchar *) src, left))
+    {
+      GString sanitized_message;
+      gchar buf[left * 6 + 1];
+
+      /* avoid GString allocation */
+      sanitized_message.str = buf;
+      sanitized_message.len = 0;
+      sanitized_message.allocated_len = sizeof(buf);
+
+      append_unsafe_utf8_as_escaped_binary(&sanitized_message, (const gchar *) src, NULL);
+
+      /* MUST NEVER BE REALLOCATED */
+      g_assert(sanitized_message.str == buf);
+      log_msg_set_value(self, LM_V_MESSAGE, sanitized_message.str, sanitized_message.len);
+      self->flags |= LF_UTF8;
+    }
+  else
+    {
+      log_msg_set_value(self, LM_V_MESSAGE, (gchar *) src, left);
+
+      /* we don't need revalidation if sanitize already said it was valid utf8 */
+      if ((parse_options->flags & LP_VALIDATE_UTF8) &&
+          ((parse_options->flags & LP_SANITIZE_UTF8) == 0) &&
+          validate_utf8((gchar *) src, left))
+        self->flags |= LF_UTF8;
+    }
+}
+
+/* NOTE: @header_len, when non-NULL, is set to the number of bytes the
+ * header part consumed, or -1 when the parse took a path that is not
+ * reproducible from the header bytes alone (e.g. no timestamp, in which
+ * case $STAMP is the per-message receive time) */
 static gboolean
 log_msg_parse_legacy(const MsgFormatOptions *parse_options,
                      const guchar *data, gint length,
-                     LogMessage *self)
+                     LogMessage *self, gint *header_len)
 {
   const guchar *src;
   gint left;
   GTimeVal now;
 
+  if (header_len)
+    *header_len = -1;
+
   src = (const guchar *) data;
   left = length;
 
@@ -960,6 +1065,9 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
         {
           log_msg_set_value(self, LM_V_HOST, (gchar *) hostname_start, hostname_len);
         }
+
+      if (header_len)
+        *header_len = src - data;
     }
   else
     {
@@ -981,35 +1089,91 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
       self->timestamps[LM_TS_STAMP] = self->timestamps[LM_TS_RECVD];
     }
 
-  if (parse_options->flags & LP_SANITIZE_UTF8 && !g_utf8_validate((gchar *) src, left, NULL))
+  log_msg_parse_legacy_message(parse_options, src, left, self);
+  return TRUE;
+}
+
+static gboolean
+log_msg_header_cache_apply(LegacyHeaderCache *cache, const MsgFormatOptions *parse_options,
+                           const guchar *data, gint length, LogMessage *self)
+{
+  NVHandle handles[LEGACY_HEADER_CACHE_VALUES] = { LM_V_HOST, LM_V_PROGRAM, LM_V_PID, 0, 0, LM_V_LEGACY_MSGHDR };
+  gint i;
+
+  handles[3] = cisco_seqid;
+  handles[4] = is_synced;
+
+  if (cache->header_len < 0 ||
+      cache->parse_options != parse_options ||
+      cache->parse_flags != parse_options->flags ||
+      cache->default_pri != parse_options->default_pri ||
+      cache->bad_hostname != parse_options->bad_hostname ||
+      cache->recv_time_zone_info != parse_options->recv_time_zone_info ||
+      cache->recvd_sec != self->timestamps[LM_TS_RECVD].tv_sec ||
+      length < cache->match_len ||
+      memcmp(data, cache->header, cache->match_len) != 0)
+    return FALSE;
+
+  self->pri = cache->pri;
+  self->timestamps[LM_TS_STAMP] = cache->stamp;
+  for (i = 0; i < LEGACY_HEADER_CACHE_VALUES; i++)
     {
-      GString sanitized_message;
-      gchar buf[left * 6 + 1];
+      if (cache->value_len[i] >= 0)
+        log_msg_set_value(self, handles[i], cache->values + cache->value_ofs[i], cache->value_len[i]);
+    }
+  if (cache->legacy_msghdr)
+    self->flags |= LF_LEGACY_MSGHDR;
+  return TRUE;
+}
 
-      /* avoid GString allocation */
-      sanitized_message.str = buf;
-      sanitized_message.len = 0;
-      sanitized_message.allocated_len = sizeof(buf);
+static void
+log_msg_header_cache_store(LegacyHeaderCache *cache, const MsgFormatOptions *parse_options,
+                           const guchar *data, gint length, gint header_len, LogMessage *self)
+{
+  NVHandle handles[LEGACY_HEADER_CACHE_VALUES] = { LM_V_HOST, LM_V_PROGRAM, LM_V_PID, 0, 0, LM_V_LEGACY_MSGHDR };
+  guint16 ofs = 0;
+  gint i;
 
-      append_unsafe_utf8_as_escaped_binary(&sanitized_message, (const gchar *) src, NULL);
+  handles[3] = cisco_seqid;
+  handles[4] = is_synced;
 
-      /* MUST NEVER BE REALLOCATED */
-      g_assert(sanitized_message.str == buf);
-      log_msg_set_value(self, LM_V_MESSAGE, sanitized_message.str, sanitized_message.len);
-      self->flags |= LF_UTF8;
-    }
-  else
-    {
-      log_msg_set_value(self, LM_V_MESSAGE, (gchar *) src, left);
+  cache->header_len = -1;
+  if (header_len < 0 ||
+      header_len > LEGACY_HEADER_CACHE_MAX_HEADER ||
+      length < header_len + LEGACY_HEADER_CACHE_LOOKAHEAD)
+    return;
 
-      /* we don't need revalidation if sanitize already said it was valid utf8 */
-      if ((parse_options->flags & LP_VALIDATE_UTF8) &&
-          ((parse_options->flags & LP_SANITIZE_UTF8) == 0) &&
-          g_utf8_validate((gchar *) src, left, NULL))
-        self->flags |= LF_UTF8;
+  for (i = 0; i < LEGACY_HEADER_CACHE_VALUES; i++)
+    {
+      if (nv_table_is_value_set(self->payload, handles[i]))
+        {
+          const gchar *value;
+          gssize value_len;
+
+          value = log_msg_get_value(self, handles[i], &value_len);
+          if (ofs + value_len > sizeof(cache->values))
+            return;
+          memcpy(cache->values + ofs, value, value_len);
+          cache->value_ofs[i] = ofs;
+          cache->value_len[i] = value_len;
+          ofs += value_len;
+        }
+      else
+        cache->value_len[i] = -1;
     }
 
-  return TRUE;
+  cache->match_len = header_len + LEGACY_HEADER_CACHE_LOOKAHEAD;
+  memcpy(cache->header, data, cache->match_len);
+  cache->parse_options = parse_options;
+  cache->parse_flags = parse_options->flags;
+  cache->default_pri = parse_options->default_pri;
+  cache->bad_hostname = parse_options->bad_hostname;
+  cache->recv_time_zone_info = parse_options->recv_time_zone_info;
+  cache->recvd_sec = self->timestamps[LM_TS_RECVD].tv_sec;
+  cache->pri = self->pri;
+  cache->legacy_msghdr = (self->flags & LF_LEGACY_MSGHDR) != 0;
+  cache->stamp = self->timestamps[LM_TS_STAMP];
+  cache->header_len = header_len;
 }
 
 /**
@@ -1042,7 +1206,7 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
   if (!log_msg_parse_pri(self, &src, &left, parse_options->flags, parse_options->default_pri) ||
       !log_msg_parse_version(self, &src, &left))
     {
-      return log_msg_parse_legacy(parse_options, data, length, self);
+      return log_msg_parse_legacy(parse_options, data, length, self, NULL);
     }
 
   if (!log_msg_parse_skip_space(self, &src, &left))
@@ -1107,7 +1271,7 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
       src += 3;
       left -= 3;
     }
-  else if ((parse_options->flags & LP_VALIDATE_UTF8) && g_utf8_validate((gchar *) src, left, NULL))
+  else if ((parse_options->flags & LP_VALIDATE_UTF8) && validate_utf8((gchar *) src, left))
     {
       self->flags |= LF_UTF8;
     }
@@ -1116,36 +1280,30 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
 }
 
 
-void
-syslog_format_handler(const MsgFormatOptions *parse_options,
-                      const guchar *data, gsize length,
-                      LogMessage *self)
+static inline gsize
+syslog_format_strip_trailing_newlines(const guchar *data, gsize length)
 {
-  gboolean success;
-  gchar *p;
-
   while (length > 0 && (data[length - 1] == '\n' || data[length - 1] == '\0'))
     length--;
+  return length;
+}
 
-  if (parse_options->flags & LP_NOPARSE)
-    {
-      log_msg_set_value(self, LM_V_MESSAGE, (gchar *) data, length);
-      self->pri = parse_options->default_pri;
-      return;
-    }
-
+static inline void
+syslog_format_preprocess_flags(const MsgFormatOptions *parse_options, LogMessage *self)
+{
   if (parse_options->flags & LP_ASSUME_UTF8)
     self->flags |= LF_UTF8;
 
   if (parse_options->flags & LP_LOCAL)
     self->flags |= LF_LOCAL;
+}
 
-  self->initial_parse = TRUE;
-  if (parse_options->flags & LP_SYSLOG_PROTOCOL)
-    success = log_msg_parse_syslog_proto(parse_options, data, length, self);
-  else
-    success = log_msg_parse_legacy(parse_options, data, length, self);
-  self->initial_parse = FALSE;
+static inline void
+syslog_format_postprocess(const MsgFormatOptions *parse_options,
+                          const guchar *data, gsize length,
+                          LogMessage *self, gboolean success)
+{
+  gchar *p;
 
   if (G_UNLIKELY(!success))
     {
@@ -1168,6 +1326,94 @@ syslog_format_handler(const MsgFormatOptions *parse_options,
     }
 }
 
+static void
+syslog_format_handler_no_parse(const MsgFormatOptions *parse_options,
+                               const guchar *data, gsize length,
+                               LogMessage *self)
+{
+  length = syslog_format_strip_trailing_newlines(data, length);
+  log_msg_set_value(self, LM_V_MESSAGE, (gchar *) data, length);
+  self->pri = parse_options->default_pri;
+  self->flags |= LF_RAW_FRAME;
+}
+
+static void
+syslog_format_handler_syslog_proto(const MsgFormatOptions *parse_options,
+                                   const guchar *data, gsize length,
+                                   LogMessage *self)
+{
+  gboolean success;
+
+  length = syslog_format_strip_trailing_newlines(data, length);
+  syslog_format_preprocess_flags(parse_options, self);
+
+  self->initial_parse = TRUE;
+  success = log_msg_parse_syslog_proto(parse_options, data, length, self);
+  self->initial_parse = FALSE;
+
+  syslog_format_postprocess(parse_options, data, length, self, success);
+}
+
+static void
+syslog_format_handler_legacy(const MsgFormatOptions *parse_options,
+                             const guchar *data, gsize length,
+                             LogMessage *self)
+{
+  LegacyHeaderCache *cache;
+  gboolean success;
+  gint header_len = -1;
+
+  length = syslog_format_strip_trailing_newlines(data, length);
+  syslog_format_preprocess_flags(parse_options, self);
+
+  cache = g_static_private_get(&priv_legacy_header_cache);
+  if (!cache)
+    {
+      cache = g_new0(LegacyHeaderCache, 1);
+      cache->header_len = -1;
+      g_static_private_set(&priv_legacy_header_cache, cache, g_free);
+    }
+
+  self->initial_parse = TRUE;
+  if (log_msg_header_cache_apply(cache, parse_options, data, length, self))
+    {
+      log_msg_parse_legacy_message(parse_options, data + cache->header_len, length - cache->header_len, self);
+      success = TRUE;
+    }
+  else
+    {
+      success = log_msg_parse_legacy(parse_options, data, length, self, &header_len);
+      if (success)
+        log_msg_header_cache_store(cache, parse_options, data, length, header_len, self);
+    }
+  self->initial_parse = FALSE;
+
+  syslog_format_postprocess(parse_options, data, length, self, success);
+}
+
+/* config time specialization: the flag bits deciding which parser runs
+ * never change once the options are initialized, so pick the matching
+ * variant up front instead of testing them for every message */
+MsgFormatParseFunc
+syslog_format_select_parse(const MsgFormatOptions *parse_options)
+{
+  if (parse_options->flags & LP_NOPARSE)
+    return syslog_format_handler_no_parse;
+  if (parse_options->flags & LP_SYSLOG_PROTOCOL)
+    return syslog_format_handler_syslog_proto;
+  return syslog_format_handler_legacy;
+}
+
+/* generic entry point for callers that dispatch on flags per message
+ * (e.g. syslog-parser invocations on uninitialized options) */
+void
+syslog_format_handler(const MsgFormatOptions *parse_options,
+                      const guchar *data, gsize length,
+                      LogMessage *self)
+{
+  syslog_format_select_parse(parse_options)(parse_options, data, length, self);
+}
+
 void
 syslog_format_init(void)
 {
@@ -29,6 +29,7 @@
 void syslog_format_handler(const MsgFormatOptions *parse_options,
                            const guchar *data, gsize length,
                            LogMessage *self);
+MsgFormatParseFunc syslog_format_select_parse(const MsgFormatOptions *parse_options);
 
 void syslog_format_init(void);
 
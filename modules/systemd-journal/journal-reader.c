@@ -149,15 +149,37 @@ __reader_wakeup(LogSource *s)
     iv_event_post(&self->schedule_wakeup);
 }
 
-static void
-__handle_data(gchar *key, gchar *value, gpointer user_data)
+/* the fields the source itself consumes to build the syslog parts of the
+ * message; these are always fetched, even when a fields() allowlist is
+ * set.  _COMM must precede SYSLOG_IDENTIFIER, the latter only fills
+ * $PROGRAM when the former did not. */
+static const gchar *builtin_journal_fields[] =
+{
+  "MESSAGE",
+  "_HOSTNAME",
+  "_PID",
+  "_COMM",
+  "SYSLOG_IDENTIFIER",
+  "SYSLOG_FACILITY",
+  "PRIORITY",
+};
+
+static gint
+__parse_number(const gchar *value, gssize value_len)
 {
-  gpointer *args = user_data;
+  gchar buf[16];
 
-  LogMessage *msg = args[0];
-  JournalReaderOptions *options = args[1];
-  gssize value_len = MIN(strlen(value), options->max_field_size);
+  /* the value is not necessarily NUL terminated when it points into the
+   * journal's data object */
+  value_len = MIN(value_len, (gssize) sizeof(buf) - 1);
+  memcpy(buf, value, value_len);
+  buf[value_len] = 0;
+  return atoi(buf);
+}
 
+static void
+__map_field(LogMessage *msg, JournalReaderOptions *options, const gchar *key, const gchar *value, gssize value_len)
+{
   if (strcmp(key, "MESSAGE") == 0)
     {
       log_msg_set_value(msg, LM_V_MESSAGE, value, value_len);
@@ -188,11 +210,11 @@ __handle_data(gchar *key, gchar *value, gpointer user_data)
     }
   else if (strcmp(key, "SYSLOG_FACILITY") == 0)
     {
-      msg->pri = (msg->pri & 7) | atoi(value) << 3;
+      msg->pri = (msg->pri & 7) | __parse_number(value, value_len) << 3;
     }
   else if (strcmp(key, "PRIORITY") == 0)
     {
-      msg->pri = (msg->pri & ~7) | atoi(value);
+      msg->pri = (msg->pri & ~7) | __parse_number(value, value_len);
     }
   else
     {
@@ -209,6 +231,46 @@ __handle_data(gchar *key, gchar *value, gpointer user_data)
     }
 }
 
+static void
+__handle_data(gchar *key, gchar *value, gpointer user_data)
+{
+  gpointer *args = user_data;
+
+  LogMessage *msg = args[0];
+  JournalReaderOptions *options = args[1];
+
+  __map_field(msg, options, key, value, MIN(strlen(value), options->max_field_size));
+}
+
+static void
+__collect_fields_by_lookup(JournalReader *self, LogMessage *msg)
+{
+  JournalReaderOptions *options = self->options;
+  gint i;
+
+  for (i = 0; i < options->num_resolved_fields; i++)
+    {
+      JournalReaderField *field = &options->resolved_fields[i];
+      const void *data;
+      gsize length;
+      const gchar *value;
+      gssize value_len;
+
+      if (journald_get_data(self->journal, field->name, &data, &length) < 0)
+        continue;
+
+      /* the data object is "NAME=value" without NUL termination, the
+       * value part can be used in place as the lengths are tracked all
+       * the way into the payload */
+      value = (const gchar *) data + field->name_len + 1;
+      value_len = MIN(length - field->name_len - 1, options->max_field_size);
+      if (field->handle)
+        log_msg_set_value(msg, field->handle, value, value_len);
+      else
+        __map_field(msg, options, field->name, value, value_len);
+    }
+}
+
 static void
 __set_message_timestamp(JournalReader *self, LogMessage *msg)
 {
@@ -231,9 +293,16 @@ __handle_message(JournalReader *self)
 
   msg->pri = self->options->default_pri;
 
-  gpointer args[] = {msg, self->options};
+  if (self->options->resolved_fields)
+    {
+      __collect_fields_by_lookup(self, msg);
+    }
+  else
+    {
+      gpointer args[] = {msg, self->options};
 
-  journald_foreach_data(self->journal, __handle_data, args);
+      journald_foreach_data(self->journal, __handle_data, args);
+    }
   __set_message_timestamp(self, msg);
 
   log_source_post(&self->super, msg);
@@ -583,6 +652,60 @@ journal_reader_new(GlobalConfig *cfg, Journald *journal)
   return self;
 }
 
+static gboolean
+__is_builtin_field(const gchar *name)
+{
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS(builtin_journal_fields); i++)
+    {
+      if (strcmp(name, builtin_journal_fields[i]) == 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static void
+__resolve_field_list(JournalReaderOptions *options)
+{
+  gint num = G_N_ELEMENTS(builtin_journal_fields) + g_list_length(options->fields);
+  JournalReaderField *fields = g_new0(JournalReaderField, num);
+  gint n = 0;
+  gint i;
+  GList *l;
+
+  for (i = 0; i < G_N_ELEMENTS(builtin_journal_fields); i++)
+    {
+      fields[n].name = g_strdup(builtin_journal_fields[i]);
+      fields[n].name_len = strlen(fields[n].name);
+      /* a zero handle routes the field through __map_field() */
+      n++;
+    }
+
+  for (l = options->fields; l; l = l->next)
+    {
+      const gchar *name = (const gchar *) l->data;
+
+      if (__is_builtin_field(name))
+        continue;
+      fields[n].name = g_strdup(name);
+      fields[n].name_len = strlen(name);
+      if (options->prefix)
+        {
+          gchar *prefixed_key = g_strdup_printf("%s%s", options->prefix, name);
+          fields[n].handle = log_msg_get_value_handle(prefixed_key);
+          g_free(prefixed_key);
+        }
+      else
+        {
+          fields[n].handle = log_msg_get_value_handle(name);
+        }
+      n++;
+    }
+  options->resolved_fields = fields;
+  options->num_resolved_fields = n;
+}
+
 void
 journal_reader_options_init(JournalReaderOptions *options, GlobalConfig *cfg, const gchar *group_name)
 {
@@ -598,6 +721,9 @@ journal_reader_options_init(JournalReaderOptions *options, GlobalConfig *cfg, co
   if (options->recv_time_zone_info == NULL)
     options->recv_time_zone_info = time_zone_info_new(options->recv_time_zone);
 
+  if (options->fields)
+    __resolve_field_list(options);
+
   options->initialized = TRUE;
 }
 
@@ -629,5 +755,21 @@ journal_reader_options_destroy(JournalReaderOptions *options)
       time_zone_info_free(options->recv_time_zone_info);
       options->recv_time_zone_info = NULL;
     }
+  if (options->fields)
+    {
+      g_list_foreach(options->fields, (GFunc) g_free, NULL);
+      g_list_free(options->fields);
+      options->fields = NULL;
+    }
+  if (options->resolved_fields)
+    {
+      gint i;
+
+      for (i = 0; i < options->num_resolved_fields; i++)
+        g_free(options->resolved_fields[i].name);
+      g_free(options->resolved_fields);
+      options->resolved_fields = NULL;
+      options->num_resolved_fields = 0;
+    }
   options->initialized = FALSE;
 }
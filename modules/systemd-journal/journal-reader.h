@@ -30,6 +30,16 @@
 
 typedef struct _JournalReader JournalReader;
 
+/* an allowlisted journal field resolved at init time: the name is looked
+ * up directly in the journal entry instead of enumerating all fields and
+ * the target handle (with prefix() already applied) is computed once
+ * instead of per message */
+typedef struct _JournalReaderField {
+  gchar *name;
+  gsize name_len;
+  NVHandle handle;
+} JournalReaderField;
+
 typedef struct _JournalReaderOptions {
   LogSourceOptions super;
   gboolean initialized;
@@ -40,6 +50,9 @@ typedef struct _JournalReaderOptions {
   TimeZoneInfo *recv_time_zone_info;
   gchar *prefix;
   guint32 max_field_size;
+  GList *fields;
+  JournalReaderField *resolved_fields;
+  gint num_resolved_fields;
 } JournalReaderOptions;
 
 JournalReader *journal_reader_new(GlobalConfig *cfg, Journald *journal);
@@ -72,6 +72,8 @@ typedef void
 typedef int
 (*SD_JOURNAL_ENUMERATE_DATA)(sd_journal *j, const void **data, size_t *length);
 typedef int
+(*SD_JOURNAL_GET_DATA)(sd_journal *j, const char *field, const void **data, size_t *length);
+typedef int
 (*SD_JOURNAL_SEEK_CURSOR)(sd_journal *j, const char *cursor);
 typedef int
 (*SD_JOURNAL_GET_FD)(sd_journal *j);
@@ -88,6 +90,7 @@ SD_JOURNAL_GET_CURSOR sd_journal_get_cursor;
 SD_JOURNAL_NEXT sd_journal_next;
 SD_JOURNAL_RESTART_DATA sd_journal_restart_data;
 SD_JOURNAL_ENUMERATE_DATA sd_journal_enumerate_data;
+SD_JOURNAL_GET_DATA sd_journal_get_data;
 SD_JOURNAL_SEEK_CURSOR sd_journal_seek_cursor;
 SD_JOURNAL_GET_FD sd_journal_get_fd;
 SD_JOURNAL_PROCESS sd_journal_process;
@@ -135,6 +138,10 @@ load_journald_subsystem()
         {
           goto error;
         }
+      if (!LOAD_SYMBOL(journald_module, sd_journal_get_data))
+        {
+          goto error;
+        }
       if (!LOAD_SYMBOL(journald_module, sd_journal_seek_cursor))
         {
           goto error;
@@ -209,6 +216,12 @@ journald_enumerate_data(Journald *self, const void **data, gsize *length)
   return sd_journal_enumerate_data(self->journal, data, length);
 }
 
+int
+journald_get_data(Journald *self, const gchar *field, const void **data, gsize *length)
+{
+  return sd_journal_get_data(self->journal, field, data, length);
+}
+
 int
 journald_seek_cursor(Journald *self, const gchar *cursor)
 {
@@ -60,6 +60,7 @@ int journald_get_cursor(Journald *self, gchar **cursor);
 int journald_next(Journald *self);
 void journald_restart_data(Journald *self);
 int journald_enumerate_data(Journald *self, const void **data, gsize *length);
+int journald_get_data(Journald *self, const gchar *field, const void **data, gsize *length);
 int journald_seek_cursor(Journald *self, const gchar *cursor);
 int journald_get_fd(Journald *self);
 int journald_process(Journald *self);
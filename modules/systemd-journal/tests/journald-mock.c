@@ -121,6 +121,27 @@ journald_enumerate_data(Journald *self, const void **data, gsize *length)
   return 1;
 }
 
+int
+journald_get_data(Journald *self, const gchar *field, const void **data, gsize *length)
+{
+  g_assert(self->opened);
+  MockEntry *entry = (MockEntry *)self->current_pos->data;
+  gsize field_len = strlen(field);
+  gint i;
+
+  for (i = 0; i < entry->data->len; i++)
+    {
+      gchar *item = entry->data->pdata[i];
+      if (strncmp(item, field, field_len) == 0 && item[field_len] == '=')
+        {
+          *data = item;
+          *length = strlen(item);
+          return 0;
+        }
+    }
+  return -ENOENT;
+}
+
 static gint
 _compare_mock_entries(gconstpointer a, gconstpointer b)
 {
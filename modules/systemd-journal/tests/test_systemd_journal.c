@@ -407,6 +407,33 @@ _test_field_size_test(TestCase *self, TestSource *src, LogMessage *msg)
   test_source_finish_tc(src);
 }
 
+void
+_test_fields_init(TestCase *self, TestSource *src, Journald *journal, JournalReader *reader, JournalReaderOptions *options)
+{
+  MockEntry *entry = __create_real_entry(journal, "fields_test");
+  options->fields = g_list_append(NULL, g_strdup("_CMDLINE"));
+  journald_mock_add_entry(journal, entry);
+}
+
+void
+_test_fields_test(TestCase *self, TestSource *src, LogMessage *msg)
+{
+  gssize value_len;
+  const gchar *value = log_msg_get_value_by_name(msg, "_CMDLINE", &value_len);
+  assert_string(value, "sshd: foo_user [priv]", ASSERTION_ERROR("Bad value for allowlisted field"));
+
+  log_msg_get_value_by_name(msg, "_EXE", &value_len);
+  assert_gint(value_len, 0, ASSERTION_ERROR("Field outside the allowlist got stored"));
+
+  assert_string(log_msg_get_value(msg, LM_V_MESSAGE, NULL),
+                "pam_unix(sshd:session): session opened for user foo_user by (uid=0)",
+                ASSERTION_ERROR("Bad message"));
+  assert_string(log_msg_get_value(msg, LM_V_PROGRAM, NULL), "sshd", ASSERTION_ERROR("Bad program name"));
+  assert_gint(msg->pri, (10 << 3) | 6, ASSERTION_ERROR("Bad prio from allowlisted builtin fields"));
+
+  test_source_finish_tc(src);
+}
+
 void
 _test_timezone_init(TestCase *self, TestSource *src, Journald *journal, JournalReader *reader, JournalReaderOptions *options)
 {
@@ -507,6 +534,7 @@ test_journal_reader()
   TestCase tc_default_working = { _test_default_working_init, _test_default_working_test, NULL, NULL };
   TestCase tc_prefix = { _test_prefix_init, _test_prefix_test, NULL, "this.is.a.prefix." };
   TestCase tc_max_field_size = { _test_field_size_init, _test_field_size_test, NULL, GINT_TO_POINTER(10)};
+  TestCase tc_fields = { _test_fields_init, _test_fields_test, NULL, NULL };
   TestCase tc_timezone = { _test_timezone_init, _test_timezone_test, NULL, NULL };
   TestCase tc_default_level =  { _test_default_level_init, _test_default_level_test, NULL, GINT_TO_POINTER(LOG_ERR) };
   TestCase tc_default_facility = { _test_default_facility_init, _test_default_facility_test, NULL, GINT_TO_POINTER(LOG_AUTH) };
@@ -515,6 +543,7 @@ test_journal_reader()
   test_source_add_test_case(src, &tc_default_working);
   test_source_add_test_case(src, &tc_prefix);
   test_source_add_test_case(src, &tc_max_field_size);
+  test_source_add_test_case(src, &tc_fields);
   test_source_add_test_case(src, &tc_timezone);
   test_source_add_test_case(src, &tc_default_level);
   test_source_add_test_case(src, &tc_default_facility);
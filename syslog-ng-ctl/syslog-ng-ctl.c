@@ -132,6 +132,21 @@ slng_stats(int argc, char *argv[], const gchar *mode)
   return 0;
 }
 
+static gint
+slng_show_queues(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp = slng_run_command("SHOW_QUEUES\n");
+
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
 static gint
 slng_stop(int argc, char *argv[], const gchar *mode)
 {
@@ -162,6 +177,74 @@ slng_reload(int argc, char *argv[], const gchar *mode)
   return 0;
 }
 
+static gboolean profile_options_stop_is_set = FALSE;
+static gint profile_options_freq = 0;
+
+static GOptionEntry profile_options[] =
+{
+  { "stop", 's', 0, G_OPTION_ARG_NONE, &profile_options_stop_is_set, "stop sampling and dump the folded stacks", NULL },
+  { "freq", 'F', 0, G_OPTION_ARG_INT, &profile_options_freq, "sampling frequency in Hz", "<freq>" },
+  { NULL,   0,   0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+static gint
+slng_profile(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp;
+  gchar buff[256];
+
+  if (profile_options_stop_is_set)
+    snprintf(buff, 255, "PROFILE STOP\n");
+  else if (profile_options_freq)
+    snprintf(buff, 255, "PROFILE START %d\n", profile_options_freq);
+  else
+    snprintf(buff, 255, "PROFILE START\n");
+
+  rsp = slng_run_command(buff);
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
+static gboolean config_profile_options_stop_is_set = FALSE;
+static gboolean config_profile_options_dump_is_set = FALSE;
+
+static GOptionEntry config_profile_options[] =
+{
+  { "stop", 's', 0, G_OPTION_ARG_NONE, &config_profile_options_stop_is_set, "stop profiling and dump the per-element costs", NULL },
+  { "dump", 'd', 0, G_OPTION_ARG_NONE, &config_profile_options_dump_is_set, "dump the costs collected so far, profiling stays enabled", NULL },
+  { NULL,   0,   0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+static gint
+slng_config_profile(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp;
+  const gchar *cmd;
+
+  if (config_profile_options_stop_is_set)
+    cmd = "CONFIG_PROFILE STOP\n";
+  else if (config_profile_options_dump_is_set)
+    cmd = "CONFIG_PROFILE DUMP\n";
+  else
+    cmd = "CONFIG_PROFILE START\n";
+
+  rsp = slng_run_command(cmd);
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
 static GOptionEntry no_options[] =
 {
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
@@ -202,9 +285,12 @@ static struct
 } modes[] =
 {
   { "stats", stats_options, "Query/reset syslog-ng statistics", slng_stats },
+  { "show-queues", no_options, "Show live queue depths, high-watermarks and drop counts", slng_show_queues },
   { "verbose", verbose_options, "Enable/query verbose messages", slng_verbose },
   { "debug", verbose_options, "Enable/query debug messages", slng_verbose },
   { "trace", verbose_options, "Enable/query trace messages", slng_verbose },
+  { "profile", profile_options, "Start/stop the sampling profiler, dumping folded stacks", slng_profile },
+  { "config-profile", config_profile_options, "Per config element execution counters, sorted by cost", slng_config_profile },
   { "stop", no_options, "Stop syslog-ng process", slng_stop },
   { "reload", no_options, "Reload syslog-ng", slng_reload },
   { NULL, NULL },
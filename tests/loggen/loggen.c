@@ -59,6 +59,21 @@ int dont_parse = 0;
 static gint display_version;
 char *sdata_value = NULL;
 int permanent = 0;
+int rate_ramp = 0;
+int busy_pacing = 0;
+int batch_size = 1;
+int latency_port = 0;
+int latency_sample = 1024;
+
+/* round-trip latency measurement: thread 0 records the send time of every
+ * latency_sample-th message here, the listener thread matches the looped
+ * back sequence numbers against the table and accumulates the results */
+#define LATENCY_SLOTS 4096
+static struct timeval latency_sent_time[LATENCY_SLOTS];
+static unsigned long latency_sent_seq[LATENCY_SLOTS];
+static guint64 latency_count;
+static double latency_sum_usec;
+static unsigned long latency_min_usec, latency_max_usec;
 
 /* results */
 guint64 sum_count;
@@ -351,6 +366,11 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
   int rc, hdr_len = 0;
   gint64 sum_linelen = 0;
   char *testsdata = NULL;
+  char *batchbuf = NULL;
+  int batch_pos = 0, batch_msgs = 0;
+  /* datagram transports need one message per send to keep the framing,
+   * batching is only available on stream sockets */
+  int batching = (batch_size > 1 && sock_type == SOCK_STREAM);
 
   gettimeofday(&start, NULL);
   now = start;
@@ -370,6 +390,9 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
        testsdata = strdup("-");
      }
 
+  if (batching)
+    batchbuf = g_malloc(batch_size * (MAX_MESSAGE_LENGTH + 1));
+
   if (!readfrom)
     {
       if (syslog_proto)
@@ -419,11 +442,22 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
         {
           /* check rate every 0.1sec */
           long new_buckets;
+          long effective_rate = rate;
+
+          if (rate_ramp > 0)
+            {
+              /* linear ramp from zero to the target rate during the first
+               * rate_ramp seconds of the run */
+              double ramp_factor = time_val_diff_in_usec(&now, &start) / (rate_ramp * (double) USEC_PER_SEC);
 
-          new_buckets = (rate * diff_usec) / USEC_PER_SEC;
+              if (ramp_factor < 1.0)
+                effective_rate = rate * ramp_factor + 1;
+            }
+
+          new_buckets = (effective_rate * diff_usec) / USEC_PER_SEC;
           if (new_buckets)
             {
-              buckets = MIN(rate, buckets + new_buckets);
+              buckets = MIN(effective_rate, buckets + new_buckets);
               last_throttle_check = now;
             }
         }
@@ -433,6 +467,14 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
           struct timespec tspec;
           long msec = (1000 / rate) + 1;
 
+          if (busy_pacing)
+            {
+              /* burn the core instead of sleeping: nanosleep() easily
+               * oversleeps by a scheduler tick, which makes the effective
+               * rate lag behind the requested one at high rates */
+              continue;
+            }
+
           tspec.tv_sec = msec / 1000;
           tspec.tv_nsec = (msec % 1000) * 1e6;
           while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
@@ -492,9 +534,31 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
           /* add sequence number */
           snprintf(intbuf, sizeof(intbuf), "%010ld", count);
           memcpy(&linebuf[pos_seq], intbuf, 10);
+
+          if (latency_port && thread_id == 0 && (count % latency_sample) == 0)
+            {
+              int slot = (count / latency_sample) % LATENCY_SLOTS;
+
+              gettimeofday(&latency_sent_time[slot], NULL);
+              latency_sent_seq[slot] = count;
+            }
         }
 
-      rc = write_chunk(send_func, send_func_ud, linebuf, linelen);
+      if (batching)
+        {
+          memcpy(batchbuf + batch_pos, linebuf, linelen);
+          batch_pos += linelen;
+          batch_msgs++;
+          rc = linelen;
+          if (batch_msgs >= batch_size || buckets <= 1)
+            {
+              rc = write_chunk(send_func, send_func_ud, batchbuf, batch_pos);
+              batch_pos = 0;
+              batch_msgs = 0;
+            }
+        }
+      else
+        rc = write_chunk(send_func, send_func_ud, linebuf, linelen);
       if (rc < 0)
         {
           fprintf(stderr, "Send error %s, results may be skewed.\n", strerror(errno));
@@ -504,6 +568,13 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
       count++;
     }
 
+  if (batching)
+    {
+      if (batch_pos)
+        write_chunk(send_func, send_func_ud, batchbuf, batch_pos);
+      g_free(batchbuf);
+    }
+
   gettimeofday(&now, NULL);
   diff_usec = time_val_diff_in_usec(&now, &start);
   time_val_diff_in_timeval(&diff_tv, &now, &start);
@@ -576,6 +647,93 @@ gint active_finished;
 gint connect_finished;
 guint64 sum_count;
 
+/* Accept a single connection looped back from the server under test and
+ * match the sequence numbers of thread 0 against the recorded send times.
+ * Configure the server to forward the generated messages to this port with
+ * template("$MSG\n") so the embedded "seq:" field survives. */
+gpointer
+latency_thread(gpointer st)
+{
+  int lsock, csock, on = 1;
+  struct sockaddr_in listen_addr;
+  char buf[65536];
+  int buflen = 0;
+  int rc;
+
+  lsock = socket(AF_INET, SOCK_STREAM, 0);
+  if (lsock < 0)
+    {
+      fprintf(stderr, "Error creating latency listener socket: %s\n", g_strerror(errno));
+      return NULL;
+    }
+  setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  memset(&listen_addr, 0, sizeof(listen_addr));
+  listen_addr.sin_family = AF_INET;
+  listen_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  listen_addr.sin_port = htons(latency_port);
+  if (bind(lsock, (struct sockaddr *) &listen_addr, sizeof(listen_addr)) < 0 || listen(lsock, 1) < 0)
+    {
+      fprintf(stderr, "Error binding latency listener socket: %s\n", g_strerror(errno));
+      close(lsock);
+      return NULL;
+    }
+
+  csock = accept(lsock, NULL, NULL);
+  if (csock < 0)
+    {
+      close(lsock);
+      return NULL;
+    }
+
+  while ((rc = recv(csock, buf + buflen, sizeof(buf) - buflen - 1, 0)) > 0)
+    {
+      char *p = buf, *q;
+      int tail;
+
+      buflen += rc;
+      buf[buflen] = 0;
+
+      /* the field looks like "seq: 0000000042, thread: 0000", 29 bytes */
+      while ((q = strstr(p, "seq: ")) != NULL && q + 29 <= buf + buflen)
+        {
+          unsigned long seq = strtoul(q + 5, NULL, 10);
+
+          p = q + 29;
+          if (strncmp(q + 17, "thread: 0000", 12) != 0 || (seq % latency_sample) != 0)
+            continue;
+
+          if (latency_sent_seq[(seq / latency_sample) % LATENCY_SLOTS] == seq)
+            {
+              struct timeval recv_time;
+              unsigned long delta;
+
+              gettimeofday(&recv_time, NULL);
+              delta = time_val_diff_in_usec(&recv_time, &latency_sent_time[(seq / latency_sample) % LATENCY_SLOTS]);
+              g_mutex_lock(thread_lock);
+              latency_count++;
+              latency_sum_usec += delta;
+              if (latency_min_usec == 0 || delta < latency_min_usec)
+                latency_min_usec = delta;
+              if (delta > latency_max_usec)
+                latency_max_usec = delta;
+              g_mutex_unlock(thread_lock);
+            }
+        }
+
+      /* keep the unscanned tail so a field split by the recv() boundary is
+       * found on the next round */
+      tail = buf + buflen - p;
+      if (tail > 63)
+        tail = 63;
+      memmove(buf, buf + buflen - tail, tail);
+      buflen = tail;
+    }
+
+  close(csock);
+  close(lsock);
+  return NULL;
+}
+
 gpointer
 idle_thread(gpointer st)
 {
@@ -678,6 +836,11 @@ error:
 
 static GOptionEntry loggen_options[] = {
   { "rate", 'r', 0, G_OPTION_ARG_INT, &rate, "Number of messages to generate per second", "<msg/sec/active connection>" },
+  { "rate-ramp", 0, 0, G_OPTION_ARG_INT, &rate_ramp, "Ramp up to the target rate linearly during this many seconds (default = 0, start at full rate)", "<sec>" },
+  { "busy-pacing", 0, 0, G_OPTION_ARG_NONE, &busy_pacing, "Busy-poll instead of sleeping when ahead of the rate, more accurate pacing at high rates", NULL },
+  { "batch-size", 0, 0, G_OPTION_ARG_INT, &batch_size, "Coalesce this many messages into a single send on stream sockets (default = 1)", "<number>" },
+  { "latency-port", 0, 0, G_OPTION_ARG_INT, &latency_port, "Measure round-trip latency: listen on this TCP port for the messages looped back by the server", "<port>" },
+  { "latency-sample", 0, 0, G_OPTION_ARG_INT, &latency_sample, "Measure the round-trip of every Nth message (default = 1024)", "<number>" },
   { "inet", 'i', 0, G_OPTION_ARG_NONE, &unix_socket_i, "Use IP-based transport (TCP, UDP)", NULL },
   { "unix", 'x', 0, G_OPTION_ARG_NONE, &unix_socket_x, "Use UNIX domain socket transport", NULL },
   { "stream", 'S', 0, G_OPTION_ARG_NONE, &sock_type_s, "Use stream socket (TCP and unix-stream)", NULL },
@@ -884,6 +1047,22 @@ main(int argc, char *argv[])
       printf("ThreadId;Time;Rate;Count\n");
     }
 
+  if (batch_size < 1)
+    batch_size = 1;
+  if (latency_sample < 1)
+    latency_sample = 1;
+
+  if (latency_port)
+    {
+      if (read_file != NULL)
+        {
+          fprintf(stderr, "Warning: round-trip latency needs the generated message format, disabling it for read-file input\n");
+          latency_port = 0;
+        }
+      else if (!g_thread_create_full(latency_thread, NULL, 1024 * 64, FALSE, FALSE, G_THREAD_PRIORITY_NORMAL, NULL))
+        goto stop_and_exit;
+    }
+
   for (i = 0; i < idle_connections; i++)
     {
       if (!g_thread_create_full(idle_thread, NULL, 1024 * 64, FALSE, FALSE, G_THREAD_PRIORITY_NORMAL, NULL))
@@ -921,6 +1100,19 @@ main(int argc, char *argv[])
     (double) sum_count * USEC_PER_SEC / diff_usec, sum_count, sum_time.tv_sec, sum_time.tv_usec / 1000, raw_message_length,
     (double) sum_count * raw_message_length * (USEC_PER_SEC / 1024) / diff_usec);
 
+  if (latency_port)
+    {
+      /* give the loopback path a moment to deliver the last samples */
+      g_usleep(USEC_PER_SEC / 2);
+      g_mutex_lock(thread_lock);
+      if (latency_count)
+        fprintf(stderr, "round-trip latency of %"G_GUINT64_FORMAT" sampled messages: avg=%.0lf usec, min=%lu usec, max=%lu usec\n",
+                latency_count, latency_sum_usec / latency_count, latency_min_usec, latency_max_usec);
+      else
+        fprintf(stderr, "round-trip latency: no looped back samples received, check the loopback configuration\n");
+      g_mutex_unlock(thread_lock);
+    }
+
 stop_and_exit:
   threads_start = TRUE;
   threads_stop = TRUE;
@@ -0,0 +1,224 @@
+/*
+ * Microbenchmarks for the primitives on the message hot path.  Each
+ * benchmark prints a single JSON line so that successive runs can be
+ * diffed by the build machinery; pass a scale factor as the first
+ * argument to multiply the iteration counts on faster hardware.
+ *
+ * These are not correctness tests and are deliberately kept out of
+ * `make check': absolute numbers are only comparable on the same host.
+ */
+
+#include "syslog-ng.h"
+#include "logmsg.h"
+#include "nvtable.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "plugin.h"
+#include "template/templates.h"
+#include "filter/filter-expr.h"
+#include "filter/filter-pri.h"
+#include "logproto/logproto-server.h"
+#include "str-format.h"
+#include "radix.h"
+#include "msg_parse_lib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_BASE_ITERATIONS 1000000
+
+static const gchar *sample_syslog_msg =
+  "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog 3535 ID47 "
+  "[exampleSDID@0 iut=\"3\" eventSource=\"Application\" eventID=\"1011\"] "
+  "An application event log entry...";
+
+typedef void (*BenchFunc)(gint iterations);
+
+static void
+run_benchmark(const gchar *name, BenchFunc func, gint iterations)
+{
+  GTimer *timer = g_timer_new();
+  gdouble elapsed;
+
+  /* a short warmup run to fault in code and data */
+  func(iterations / 16 + 1);
+
+  g_timer_start(timer);
+  func(iterations);
+  elapsed = g_timer_elapsed(timer, NULL);
+
+  printf("{\"benchmark\": \"%s\", \"iterations\": %d, \"elapsed_sec\": %.6f, \"ns_per_iter\": %.1f}\n",
+         name, iterations, elapsed, elapsed * 1e9 / iterations);
+  g_timer_destroy(timer);
+}
+
+static void
+bench_nv_table_add_value(gint iterations)
+{
+  NVHandle dyn_handle = log_msg_get_value_handle("BENCH.VALUE");
+  gssize name_len;
+  const gchar *name = log_msg_get_value_name(dyn_handle, &name_len);
+  gchar value[64];
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      NVTable *tab = nv_table_new(LM_V_MAX, 16, 1024);
+      gint len = g_snprintf(value, sizeof(value), "value-%07d", i);
+
+      nv_table_add_value(tab, LM_V_MESSAGE, NULL, 0, value, len, NULL);
+      nv_table_add_value(tab, dyn_handle, name, name_len, value, len, NULL);
+      nv_table_unref(tab);
+    }
+}
+
+static void
+bench_log_template_format(gint iterations)
+{
+  LogTemplate *templ = log_template_new(configuration, "bench");
+  LogMessage *msg;
+  GString *res = g_string_sized_new(256);
+  GError *error = NULL;
+  gint i;
+
+  g_assert(log_template_compile(templ, "<$PRI>$DATE $HOST $MSGHDR$MSG\n", &error));
+  msg = log_msg_new(sample_syslog_msg, strlen(sample_syslog_msg), NULL, &parse_options);
+
+  for (i = 0; i < iterations; i++)
+    log_template_format(templ, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+
+  g_string_free(res, TRUE);
+  log_msg_unref(msg);
+  log_template_unref(templ);
+}
+
+static void
+bench_msg_parse(gint iterations)
+{
+  gsize msg_len = strlen(sample_syslog_msg);
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      LogMessage *msg = log_msg_new(sample_syslog_msg, msg_len, NULL, &parse_options);
+
+      log_msg_unref(msg);
+    }
+}
+
+static void
+bench_r_find_node(gint iterations)
+{
+  RNode *root = r_new_node((guint8 *) "", NULL);
+  gchar key[64];
+  gint i;
+
+  /* a corpus resembling program names as used by the pattern database */
+  for (i = 0; i < 100; i++)
+    {
+      g_snprintf(key, sizeof(key), "program-%02d", i);
+      r_insert_node(root, (guint8 *) key, g_strdup(key), NULL);
+    }
+
+  for (i = 0; i < iterations; i++)
+    {
+      gint len = g_snprintf(key, sizeof(key), "program-%02d", i % 100);
+
+      r_find_node(root, (guint8 *) key, len, NULL);
+    }
+  r_free_node(root, g_free);
+}
+
+static void
+bench_find_eom(gint iterations)
+{
+  GString *buf = g_string_sized_new(8192);
+  gint i;
+
+  for (i = 0; i < 64; i++)
+    g_string_append(buf, "Feb 11 10:34:56 bzorp syslog-ng[23323]: message payload of typical length\n");
+
+  for (i = 0; i < iterations; i++)
+    {
+      const guchar *sol = (guchar *) buf->str;
+      const guchar *eom;
+
+      while ((eom = find_eom(sol, buf->len - (sol - (guchar *) buf->str))))
+        sol = eom + 1;
+    }
+  g_string_free(buf, TRUE);
+}
+
+static void
+bench_format_uint(gint iterations)
+{
+  GString *res = g_string_sized_new(64);
+  gint i;
+
+  /* the mix a timestamp + PID formatting produces per message: a couple
+   * of fixed-width date components and two variable width integers */
+  for (i = 0; i < iterations; i++)
+    {
+      g_string_truncate(res, 0);
+      format_uint32_2digits(res, i % 60);
+      format_uint32_2digits(res, (i / 60) % 60);
+      format_uint32_3digits(res, i % 1000);
+      format_uint32_padded(res, 0, 0, 10, (guint32) i);
+      format_uint64_padded(res, 0, 0, 10, (guint64) i * 1000003);
+    }
+  g_string_free(res, TRUE);
+}
+
+static void
+bench_filter_expr_eval(gint iterations)
+{
+  FilterExprNode *level_filter = filter_level_new(0x0f);
+  FilterExprNode *facility_filter = filter_facility_new(0xffffffff);
+  LogMessage *msg;
+  gint i;
+
+  filter_expr_init(level_filter, configuration);
+  filter_expr_init(facility_filter, configuration);
+  msg = log_msg_new(sample_syslog_msg, strlen(sample_syslog_msg), NULL, &parse_options);
+
+  for (i = 0; i < iterations; i++)
+    {
+      filter_expr_eval(level_filter, msg);
+      filter_expr_eval(facility_filter, msg);
+    }
+
+  log_msg_unref(msg);
+  filter_expr_unref(level_filter);
+  filter_expr_unref(facility_filter);
+}
+
+int
+main(int argc, char *argv[])
+{
+  gint scale = 1;
+  gint iterations;
+
+  if (argc > 1)
+    scale = atoi(argv[1]);
+  if (scale < 1)
+    scale = 1;
+  iterations = BENCH_BASE_ITERATIONS * scale;
+
+  app_startup();
+  init_and_load_syslogformat_module();
+  parse_options.flags |= LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(&parse_options, configuration);
+
+  run_benchmark("nv_table_add_value", bench_nv_table_add_value, iterations);
+  run_benchmark("log_template_format", bench_log_template_format, iterations);
+  run_benchmark("msg_parse", bench_msg_parse, iterations / 10);
+  run_benchmark("r_find_node", bench_r_find_node, iterations);
+  run_benchmark("find_eom", bench_find_eom, iterations / 10);
+  run_benchmark("format_uint", bench_format_uint, iterations);
+  run_benchmark("filter_expr_eval", bench_filter_expr_eval, iterations);
+
+  deinit_syslogformat_module();
+  app_shutdown();
+  return 0;
+}
@@ -43,7 +43,7 @@ set_new_log_message_attributes(LogMessage *log_message)
 void
 test_cloning_with_log_message(gchar *msg)
 {
-  LogMessage *original_log_message, *log_message, *cloned_log_message;
+  LogMessage *original_log_message, *log_message, *cloned_log_message, *second_clone;
   regex_t bad_hostname;
   GSockAddr *addr = g_sockaddr_inet_new("10.10.10.10", 1010);
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
@@ -52,6 +52,7 @@ test_cloning_with_log_message(gchar *msg)
 
   parse_options.flags = LP_SYSLOG_PROTOCOL;
   parse_options.bad_hostname = &bad_hostname;
+  msg_format_options_init(&parse_options, configuration);
 
   original_log_message = log_msg_new(msg, strlen(msg), addr, &parse_options);
   log_message = log_msg_new(msg, strlen(msg), addr, &parse_options);
@@ -68,6 +69,13 @@ test_cloning_with_log_message(gchar *msg)
   assert_new_log_message_attributes(cloned_log_message);
   assert_log_message_has_tag(cloned_log_message, "newtag");
 
+  /* cloning the modified clone write protects it, which folds the payload
+   * overlay holding the values above into its own payload */
+  second_clone = log_msg_clone_cow(cloned_log_message, &path_options);
+  assert_new_log_message_attributes(cloned_log_message);
+  assert_new_log_message_attributes(second_clone);
+  log_msg_unref(second_clone);
+
   log_msg_unref(cloned_log_message);
   log_msg_unref(log_message);
   log_msg_unref(original_log_message);
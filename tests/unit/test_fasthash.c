@@ -0,0 +1,45 @@
+#include "fasthash.h"
+#include "apphook.h"
+#include <string.h>
+#include <stdio.h>
+
+#define TEST_ASSERT(x)  \
+  do { \
+   if (!(x)) \
+     { \
+       fprintf(stderr, "test assertion failed: " #x " line: %d\n", __LINE__); \
+       return 1; \
+     } \
+  } while (0)
+
+int
+main()
+{
+  const gchar *str = "almafa";
+  gchar buf[256];
+  gint i;
+
+  app_startup();
+
+  /* deterministic within a process */
+  TEST_ASSERT(fast_hash(str, strlen(str)) == fast_hash(str, strlen(str)));
+  TEST_ASSERT(fast_hash_str(str) == fast_hash(str, strlen(str)));
+  TEST_ASSERT(fast_hash_g_str(str) == fast_hash_str(str));
+
+  /* a one byte difference anywhere must change the value */
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = 'x';
+  for (i = 0; i < sizeof(buf); i++)
+    {
+      buf[i] = 'y';
+      TEST_ASSERT(fast_hash(buf, sizeof(buf)) != fast_hash(buf + 1, sizeof(buf) - 1));
+      TEST_ASSERT(fast_hash(buf, i + 1) != fast_hash(buf, i));
+      buf[i] = 'x';
+    }
+
+  /* length is part of the hash, a shared prefix is not enough */
+  TEST_ASSERT(fast_hash("almafa", 6) != fast_hash("almafa", 5));
+
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "testutils.h"
+#include "msg_parse_lib.h"
+#include "syslog-ng.h"
+#include "logmsg.h"
+#include "serialize.h"
+#include "apphook.h"
+#include "gsockaddr.h"
+#include "cfg.h"
+#include "plugin.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static LogMessage *
+serialize_and_read_back(LogMessage *msg)
+{
+  GString *stream = g_string_new("");
+  SerializeArchive *sa;
+  LogMessage *result;
+
+  sa = serialize_string_archive_new(stream);
+  assert_true(log_msg_write(msg, sa), "log_msg_write() failed");
+  serialize_archive_free(sa);
+
+  result = log_msg_new_empty();
+  sa = serialize_string_archive_new(stream);
+  assert_true(log_msg_read(result, sa), "log_msg_read() failed");
+  serialize_archive_free(sa);
+
+  g_string_free(stream, TRUE);
+  return result;
+}
+
+static void
+test_serialize_with_log_message(gchar *msg)
+{
+  LogMessage *log_message, *read_message;
+  GSockAddr *addr = g_sockaddr_inet_new("10.10.10.10", 1010);
+
+  testcase_begin("Testing log message serialization; msg='%s'", msg);
+
+  parse_options.flags = LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(&parse_options, configuration);
+
+  log_message = log_msg_new(msg, strlen(msg), addr, &parse_options);
+  log_msg_set_value_by_name(log_message, "dynamic.value", "value", -1);
+  log_msg_set_tag_by_name(log_message, "serialized-tag");
+  /* an indirect entry borrowing a chunk of $MSG, like $1 after a match */
+  log_msg_set_match_indirect(log_message, 1, LM_V_MESSAGE, 0, 3, 10);
+
+  read_message = serialize_and_read_back(log_message);
+
+  assert_log_messages_equal(read_message, log_message);
+  assert_log_message_values_equal(read_message, log_message, log_msg_get_value_handle("dynamic.value"));
+  assert_log_message_values_equal(read_message, log_message, log_msg_get_value_handle("1"));
+  assert_log_message_has_tag(read_message, "serialized-tag");
+
+  log_msg_unref(read_message);
+  log_msg_unref(log_message);
+  g_sockaddr_unref(addr);
+
+  testcase_end();
+}
+
+static void
+test_corrupt_frame_is_rejected(void)
+{
+  GString *stream = g_string_new("");
+  SerializeArchive *sa;
+  LogMessage *msg;
+
+  testcase_begin("Testing that a truncated frame is rejected");
+
+  g_string_append_len(stream, "\x02\x00\x01", 3);
+  msg = log_msg_new_empty();
+  sa = serialize_string_archive_new(stream);
+  sa->silent = TRUE;
+  assert_false(log_msg_read(msg, sa), "log_msg_read() accepted a truncated frame");
+  serialize_archive_free(sa);
+
+  log_msg_unref(msg);
+  g_string_free(stream, TRUE);
+  testcase_end();
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+
+  init_and_load_syslogformat_module();
+
+  test_serialize_with_log_message(
+      "<7>1 2006-10-29T01:59:59.156+01:00 mymachine.example.com evntslog - ID47 [exampleSDID@0 iut=\"3\" eventSource=\"Application\" eventID=\"1011\"][examplePriority@0 class=\"high\"] BOMAn application event log entry...");
+  test_serialize_with_log_message(
+      "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\"] An application event log entry...");
+  test_corrupt_frame_is_rejected();
+
+  deinit_syslogformat_module();
+  app_shutdown();
+  return 0;
+}
@@ -1,14 +1,17 @@
 #include "logqueue.h"
 #include "logqueue-fifo.h"
+#include "logqueue-disk.h"
 #include "logpipe.h"
 #include "apphook.h"
 #include "plugin.h"
 #include "mainloop.h"
 #include "tls-support.h"
 #include "mainloop-io-worker.h"
+#include "libtest/persist_lib.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <iv.h>
 #include <iv_list.h>
 #include <iv_thread.h>
@@ -127,6 +130,195 @@ testcase_zero_diskbuf_alternating_send_acks()
   log_queue_unref(q);
 }
 
+void
+testcase_prio_lane()
+{
+  LogQueue *q;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg;
+  LogTagId prio_tag;
+  char *msg_str = "<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: prio";
+  GSockAddr *sa;
+  gint i;
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_fifo_set_prio_tag(q, "prio");
+  prio_tag = log_tags_get_by_name("prio");
+
+  /* bulk traffic first, then a single tagged message */
+  feed_some_messages(&q, 10);
+
+  sa = g_sockaddr_inet_new("10.10.10.10", 1010);
+  msg = log_msg_new(msg_str, strlen(msg_str), sa, &parse_options);
+  g_sockaddr_unref(sa);
+  log_msg_set_tag_by_id(msg, prio_tag);
+  log_queue_push_tail(q, msg, &path_options);
+
+  /* the tagged message must overtake the bulk messages queued before it */
+  msg = log_queue_pop_head(q, &path_options);
+  if (!msg || !log_msg_is_tag_by_id(msg, prio_tag))
+    {
+      fprintf(stderr, "prio tagged message did not overtake the bulk traffic\n");
+      exit(1);
+    }
+  log_msg_unref(msg);
+
+  for (i = 0; i < 10; i++)
+    {
+      msg = log_queue_pop_head(q, &path_options);
+      if (!msg || log_msg_is_tag_by_id(msg, prio_tag))
+        {
+          fprintf(stderr, "unexpected message while draining the normal lane\n");
+          exit(1);
+        }
+      log_msg_unref(msg);
+    }
+  log_queue_unref(q);
+}
+
+/* the disk queue testcases push messages carrying a sequence number so
+ * both ordering and the serialization round-trip can be verified */
+static void
+feed_numbered_messages(LogQueue *q, gint *seq, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gchar buf[32];
+  gint i;
+
+  for (i = 0; i < n; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      g_snprintf(buf, sizeof(buf), "%d", (*seq)++);
+      log_msg_set_value(msg, LM_V_MESSAGE, buf, -1);
+      log_queue_push_tail(q, msg, &path_options);
+    }
+}
+
+static void
+expect_numbered_messages(LogQueue *q, gint *seq, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gchar buf[32];
+  gint i;
+
+  for (i = 0; i < n; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      g_snprintf(buf, sizeof(buf), "%d", (*seq)++);
+      if (!msg)
+        {
+          fprintf(stderr, "disk queue ran empty, expected message %s\n", buf);
+          exit(1);
+        }
+      if (strcmp(log_msg_get_value(msg, LM_V_MESSAGE, NULL), buf) != 0)
+        {
+          fprintf(stderr, "disk queue message out of order, expected %s, got %s\n",
+                  buf, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+          exit(1);
+        }
+      log_msg_unref(msg);
+    }
+}
+
+void
+testcase_diskq_spill_and_refill()
+{
+  LogQueue *q;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint feed_seq = 0, expect_seq = 0;
+
+  unlink("test_logqueue_disk.qf");
+  q = log_queue_disk_new(5, 256 * 1024, "test_logqueue_disk.qf", NULL);
+
+  /* 5 stay in the memory window, the rest spills to disk */
+  feed_numbered_messages(q, &feed_seq, 100);
+  if (log_queue_get_length(q) != 100)
+    {
+      fprintf(stderr, "disk queue misaccounts spilled messages, length=%d\n", (gint) log_queue_get_length(q));
+      exit(1);
+    }
+
+  /* popping refills the memory window from disk, in order */
+  expect_numbered_messages(q, &expect_seq, 100);
+  if (log_queue_pop_head(q, &path_options) != NULL)
+    {
+      fprintf(stderr, "disk queue returned a message while supposedly empty\n");
+      exit(1);
+    }
+
+  log_queue_unref(q);
+  unlink("test_logqueue_disk.qf");
+}
+
+void
+testcase_diskq_wraparound()
+{
+  LogQueue *q;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint feed_seq = 0, expect_seq = 0;
+  gint i;
+
+  unlink("test_logqueue_disk.qf");
+  /* small enough ring that the alternating feed/drain below laps it
+   * several times while the resident messages always fit */
+  q = log_queue_disk_new(1, 64 * 1024, "test_logqueue_disk.qf", NULL);
+
+  feed_numbered_messages(q, &feed_seq, 25);
+  for (i = 0; i < 200; i++)
+    {
+      expect_numbered_messages(q, &expect_seq, 5);
+      feed_numbered_messages(q, &feed_seq, 5);
+    }
+  expect_numbered_messages(q, &expect_seq, 25);
+  if (log_queue_pop_head(q, &path_options) != NULL)
+    {
+      fprintf(stderr, "disk queue returned a message while supposedly empty\n");
+      exit(1);
+    }
+
+  log_queue_unref(q);
+  unlink("test_logqueue_disk.qf");
+}
+
+void
+testcase_diskq_restart_recovery()
+{
+  LogQueue *q;
+  PersistState *state;
+  gint feed_seq = 0, expect_seq = 0;
+
+  unlink("test_logqueue_disk.qf");
+  state = clean_and_create_persist_state_for_test("test_logqueue_disk.persist");
+
+  q = log_queue_disk_new(1, 64 * 1024, "test_logqueue_disk.qf", "test_logqueue_disk");
+  feed_numbered_messages(q, &feed_seq, 10);
+  /* drain the memory window; only messages on disk survive a restart */
+  expect_numbered_messages(q, &expect_seq, 1);
+  log_queue_save_state(q, state);
+  log_queue_unref(q);
+
+  state = restart_persist_state(state);
+
+  q = log_queue_disk_new(1, 64 * 1024, "test_logqueue_disk.qf", "test_logqueue_disk");
+  if (!log_queue_load_state(q, state))
+    {
+      fprintf(stderr, "could not restore disk queue state from the persist file\n");
+      exit(1);
+    }
+  if (log_queue_get_length(q) != 9)
+    {
+      fprintf(stderr, "unexpected disk queue length after restart, length=%d\n", (gint) log_queue_get_length(q));
+      exit(1);
+    }
+  expect_numbered_messages(q, &expect_seq, 9);
+  log_queue_unref(q);
+
+  commit_and_destroy_persist_state(state);
+  unlink("test_logqueue_disk.qf");
+}
+
 #define FEEDERS 1
 #define MESSAGES_PER_FEEDER 30000
 #define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
@@ -307,6 +499,14 @@ main()
   testcase_zero_diskbuf_alternating_send_acks();
   fprintf(stderr,"Start testcase_zero_diskbuf_and_normal_acks\n");
   testcase_zero_diskbuf_and_normal_acks();
+  fprintf(stderr,"Start testcase_prio_lane\n");
+  testcase_prio_lane();
+  fprintf(stderr,"Start testcase_diskq_spill_and_refill\n");
+  testcase_diskq_spill_and_refill();
+  fprintf(stderr,"Start testcase_diskq_wraparound\n");
+  testcase_diskq_wraparound();
+  fprintf(stderr,"Start testcase_diskq_restart_recovery\n");
+  testcase_diskq_restart_recovery();
 #endif
   return 0;
 }
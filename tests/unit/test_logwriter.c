@@ -28,6 +28,7 @@ init_msg(gchar *msg_string, gboolean use_syslog_protocol)
     parse_options.flags |= LP_SYSLOG_PROTOCOL;
   else
     parse_options.flags &= ~LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(&parse_options, configuration);
   sa = g_sockaddr_inet_new("10.10.10.10", 1010);
   msg = log_msg_new(msg_string, strlen(msg_string), sa, &parse_options);
   g_sockaddr_unref(sa);
@@ -77,6 +77,7 @@ parse_log_message(gchar *raw_message_str, gint parse_flags, gchar *bad_hostname_
 
   parse_options.flags = parse_flags;
   parse_options.sdata_param_value_max = 255;
+  msg_format_options_init(&parse_options, configuration);
 
   if (bad_hostname_re)
     {
@@ -17,6 +17,7 @@ testcase_update_sdata(const gchar *msg, const gchar *expected_sd_str, gchar *ele
   gchar *elem, *param, *value;
 
   parse_options.flags |= LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(&parse_options, configuration);
 
   va_start(va, elem_name1);
 
@@ -44,6 +45,96 @@ testcase_update_sdata(const gchar *msg, const gchar *expected_sd_str, gchar *ele
   log_msg_unref(logmsg);
 }
 
+void
+testcase_lazy_sdata_materialize_on_access(void)
+{
+  const gchar *msg = "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\" eventSource=\"App\\\"lication\" eventID=\"1011\"][examplePriority@0 class=\"high\"] An application event log entry...";
+  LogMessage *logmsg;
+  GString *sd_str = g_string_new("");
+  const gchar *value;
+  gssize value_len;
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA;
+  msg_format_options_init(&parse_options, configuration);
+
+  logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+  assert_true(!!(logmsg->flags & LF_LAZY_SDATA), "freshly parsed message is not lazy");
+
+  /* the first access to an SDATA value on an exclusively owned message
+   * materializes the individual entries */
+  value = log_msg_get_value_by_name(logmsg, ".SDATA.exampleSDID@0.eventSource", &value_len);
+  assert_nstring(value, value_len, "App\"lication", -1, "lazy sdata value lookup failed");
+  assert_false(!!(logmsg->flags & LF_LAZY_SDATA), "first access did not materialize sdata");
+
+  log_msg_format_sdata(logmsg, sd_str, 0);
+  assert_string(sd_str->str, "[exampleSDID@0 iut=\"3\" eventSource=\"App\\\"lication\" eventID=\"1011\"][examplePriority@0 class=\"high\"]",
+                "materialized sdata does not round-trip");
+
+  parse_options.flags &= ~(LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA);
+  g_string_free(sd_str, TRUE);
+  log_msg_unref(logmsg);
+}
+
+void
+testcase_lazy_sdata_shared_message(void)
+{
+  const gchar *msg = "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\" eventSource=\"Application\"][examplePriority@0 class=\"high\"] An application event log entry...";
+  LogMessage *logmsg;
+  GString *sd_str = g_string_new("");
+  const gchar *value;
+  gssize value_len;
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA;
+  msg_format_options_init(&parse_options, configuration);
+
+  logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+  log_msg_write_protect(logmsg);
+
+  /* a write protected message may be read by several threads, values are
+   * served from the raw form without materializing anything */
+  value = log_msg_get_value_by_name(logmsg, ".SDATA.examplePriority@0.class", &value_len);
+  assert_nstring(value, value_len, "high", -1, "lazy sdata lookup on a shared message failed");
+  value = log_msg_get_value_by_name(logmsg, ".SDATA.exampleSDID@0.nosuch", &value_len);
+  assert_nstring(value, value_len, "", -1, "missing lazy sdata value is not empty");
+  assert_true(!!(logmsg->flags & LF_LAZY_SDATA), "reading a shared message materialized sdata");
+
+  log_msg_format_sdata(logmsg, sd_str, 0);
+  assert_string(sd_str->str, "[exampleSDID@0 iut=\"3\" eventSource=\"Application\"][examplePriority@0 class=\"high\"]",
+                "raw sdata is not emitted verbatim");
+
+  log_msg_format_sdata(logmsg, sd_str, 11);
+  assert_string(sd_str->str, "[exampleSDID@0 iut=\"3\" eventSource=\"Application\"][examplePriority@0 class=\"high\"][meta sequenceId=\"11\"]",
+                "sequenceId is not appended to raw sdata");
+
+  log_msg_write_unprotect(logmsg);
+  parse_options.flags &= ~(LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA);
+  g_string_free(sd_str, TRUE);
+  log_msg_unref(logmsg);
+}
+
+void
+testcase_lazy_sdata_materialize_on_update(void)
+{
+  const gchar *msg = "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\"] An application event log entry...";
+  LogMessage *logmsg;
+  GString *sd_str = g_string_new("");
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA;
+  msg_format_options_init(&parse_options, configuration);
+
+  logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+  log_msg_set_value_by_name(logmsg, ".SDATA.syslog-ng.param", "value", -1);
+  assert_false(!!(logmsg->flags & LF_LAZY_SDATA), "setting an sdata value did not materialize the raw form");
+
+  log_msg_format_sdata(logmsg, sd_str, 0);
+  assert_string(sd_str->str, "[exampleSDID@0 iut=\"3\"][syslog-ng param=\"value\"]",
+                "sdata update on a lazy message failed");
+
+  parse_options.flags &= ~(LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA);
+  g_string_free(sd_str, TRUE);
+  log_msg_unref(logmsg);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -56,6 +147,10 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
                   "syslog-ng", "param", "value",
                   NULL, NULL, NULL);
 
+  testcase_lazy_sdata_materialize_on_access();
+  testcase_lazy_sdata_shared_message();
+  testcase_lazy_sdata_materialize_on_update();
+
   deinit_syslogformat_module();
   app_shutdown();
   return 0;
@@ -307,7 +307,9 @@ test_nvtable_direct()
  *        - value that fits into the current entry
  *        - value that doesn't fit into the current entry, but fits into NVTable
  *        - value that doesn't fit into the current entry and neither to NVTable
- *    - set/get dynamic NV entries that refer to indirect entry, they become direct entries
+ *    - set/get dynamic NV entries that refer to indirect entry, the
+ *      reference is rebased onto the direct entry the referenced one
+ *      points into, staying zero-copy
  *      - new NV entry
  *        - entries that fit into the current NVTable
  *        - entries that do not fit into the current NVTable
@@ -475,7 +477,8 @@ test_nvtable_indirect()
   TEST_NVTABLE_ASSERT(tab, handle, value + 2, 122);
   nv_table_unref(tab);
 
-  /* one that is too large */
+  /* one that would have been too large as a copy: the reference is
+   * rebased onto the direct entry, so only an indirect entry is stored */
   tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 192);
   success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, 4, value, 128, NULL);
   TEST_ASSERT(success == TRUE);
@@ -483,10 +486,10 @@ test_nvtable_indirect()
   TEST_ASSERT(success == TRUE);
 
   success = nv_table_add_value_indirect(tab, handle, name, strlen(name), DYN_HANDLE, 0, 1, 122, NULL);
-  TEST_ASSERT(success == FALSE);
+  TEST_ASSERT(success == TRUE);
   TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 128);
   TEST_NVTABLE_ASSERT(tab, DYN_HANDLE, value + 1, 126);
-  TEST_NVTABLE_ASSERT(tab, handle, "", 0);
+  TEST_NVTABLE_ASSERT(tab, handle, value + 2, 122);
   nv_table_unref(tab);
 
   /*************************************************************/
@@ -527,13 +530,14 @@ test_nvtable_indirect()
   success = nv_table_add_value_indirect(tab, handle, name, strlen(name), DYN_HANDLE, 0, 1, 16, NULL);
   TEST_ASSERT(success == TRUE);
 
-  TEST_ASSERT(tab->used > used);
+  /* the rebased reference fits into the old indirect entry */
+  TEST_ASSERT(tab->used == used);
   TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 128);
   TEST_NVTABLE_ASSERT(tab, DYN_HANDLE, value + 1, 126);
   TEST_NVTABLE_ASSERT(tab, handle, value + 2, 16);
   nv_table_unref(tab);
 
-  /* one that is too large */
+  /* a large reference: rebasing keeps it a fixed-size indirect entry */
 
   tab = nv_table_new(STATIC_VALUES, 4, 256);
   success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, 4, value, 128, NULL);
@@ -545,12 +549,12 @@ test_nvtable_indirect()
   used = tab->used;
 
   success = nv_table_add_value_indirect(tab, handle, name, strlen(name), DYN_HANDLE, 0, 1, 124, NULL);
-  TEST_ASSERT(success == FALSE);
+  TEST_ASSERT(success == TRUE);
 
   TEST_ASSERT(tab->used == used);
   TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 128);
   TEST_NVTABLE_ASSERT(tab, DYN_HANDLE, value + 1, 126);
-  TEST_NVTABLE_ASSERT(tab, handle, value + 1, 126);
+  TEST_NVTABLE_ASSERT(tab, handle, value + 2, 124);
   nv_table_unref(tab);
 
   /*************************************************************/
@@ -592,13 +596,14 @@ test_nvtable_indirect()
   success = nv_table_add_value_indirect(tab, handle, name, strlen(name), DYN_HANDLE, 0, 1, 32, NULL);
   TEST_ASSERT(success == TRUE);
 
-  TEST_ASSERT(tab->used > used);
+  /* the rebased reference fits into the old direct entry */
+  TEST_ASSERT(tab->used == used);
   TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 128);
   TEST_NVTABLE_ASSERT(tab, DYN_HANDLE, value + 1, 126);
   TEST_NVTABLE_ASSERT(tab, handle, value + 2, 32);
   nv_table_unref(tab);
 
-  /* one that is too large */
+  /* a large reference over a direct entry: rebased in place */
 
   tab = nv_table_new(STATIC_VALUES, 4, 256);
   success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, 4, value, 128, NULL);
@@ -610,12 +615,12 @@ test_nvtable_indirect()
   used = tab->used;
 
   success = nv_table_add_value_indirect(tab, handle, name, strlen(name), DYN_HANDLE, 0, 1, 124, NULL);
-  TEST_ASSERT(success == FALSE);
+  TEST_ASSERT(success == TRUE);
 
   TEST_ASSERT(tab->used == used);
   TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 128);
   TEST_NVTABLE_ASSERT(tab, DYN_HANDLE, value + 1, 126);
-  TEST_NVTABLE_ASSERT(tab, handle, value, 16);
+  TEST_NVTABLE_ASSERT(tab, handle, value + 2, 124);
   nv_table_unref(tab);
 
   /*************************************************************/
@@ -689,6 +694,98 @@ test_nvtable_others(void)
   nv_table_unref(tab);
 }
 
+/*
+ *  - NVTable interned values
+ *    - add an interned value, read it back (static & dynamic handles)
+ *    - the same value interned twice maps to the same pool id
+ *    - too long values fall back to direct storage
+ *    - overwrite an interned entry with a direct value and vice versa
+ *    - indirect reference over an interned entry
+ *    - materializing a table converts interned entries to direct ones
+ */
+static void
+test_nvtable_interned(void)
+{
+  NVTable *tab, *mat;
+  NVHandle handle;
+  NVDynValue *dyn_slot;
+  NVEntry *entry;
+  gchar value[1024], name[16];
+  gboolean success;
+  guint32 id1, id2;
+  gint i;
+
+  for (i = 0; i < sizeof(value); i++)
+    value[i] = 'A' + (i % 26);
+
+  handle = DYN_HANDLE+1;
+  g_snprintf(name, sizeof(name), "VAL%d", handle);
+  fprintf(stderr, "Testing interned values, name: %s, handle: %d\n", name, handle);
+
+  /* interning the same bytes twice returns the same id */
+  id1 = nv_intern_string("localhost", 9);
+  id2 = nv_intern_string("localhost", 9);
+  TEST_ASSERT(id1 != 0);
+  TEST_ASSERT(id1 == id2);
+  TEST_ASSERT(strcmp(nv_intern_lookup(id1), "localhost") == 0);
+
+  /* values over the intern limit are refused */
+  TEST_ASSERT(nv_intern_string(value, 512) == 0);
+
+  /* interned static & dynamic entries */
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  success = nv_table_add_value_interned(tab, STATIC_HANDLE, STATIC_NAME, 4, "localhost", 9, NULL);
+  TEST_ASSERT(success == TRUE);
+  success = nv_table_add_value_interned(tab, handle, name, strlen(name), "su", 2, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, "localhost", 9);
+  TEST_NVTABLE_ASSERT(tab, handle, "su", 2);
+
+  entry = nv_table_get_entry(tab, STATIC_HANDLE, &dyn_slot);
+  TEST_ASSERT(entry->interned == 1);
+
+  /* a too long value falls back to direct storage through the same call */
+  success = nv_table_add_value_interned(tab, handle, name, strlen(name), value, 512, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_NVTABLE_ASSERT(tab, handle, value, 512);
+  entry = nv_table_get_entry(tab, handle, &dyn_slot);
+  TEST_ASSERT(entry->interned == 0);
+
+  /* overwrite interned -> direct -> interned */
+  success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, 4, value, 32, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, value, 32);
+  success = nv_table_add_value_interned(tab, STATIC_HANDLE, STATIC_NAME, 4, "localhost", 9, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_NVTABLE_ASSERT(tab, STATIC_HANDLE, "localhost", 9);
+  nv_table_unref(tab);
+
+  /* indirect reference over an interned entry */
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 256);
+  success = nv_table_add_value_interned(tab, STATIC_HANDLE, STATIC_NAME, 4, "localhost", 9, NULL);
+  TEST_ASSERT(success == TRUE);
+  success = nv_table_add_value_indirect(tab, handle, name, strlen(name), STATIC_HANDLE, 0, 5, 4, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_NVTABLE_ASSERT(tab, handle, "host", 4);
+
+  /* materializing inlines the interned values */
+  mat = nv_table_materialize_interned(tab);
+  TEST_ASSERT(mat != NULL);
+  TEST_NVTABLE_ASSERT(mat, STATIC_HANDLE, "localhost", 9);
+  TEST_NVTABLE_ASSERT(mat, handle, "host", 4);
+  entry = nv_table_get_entry(mat, STATIC_HANDLE, &dyn_slot);
+  TEST_ASSERT(entry->interned == 0);
+  nv_table_unref(mat);
+  nv_table_unref(tab);
+
+  /* nothing to materialize */
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 256);
+  success = nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, 4, value, 32, NULL);
+  TEST_ASSERT(success == TRUE);
+  TEST_ASSERT(nv_table_materialize_interned(tab) == NULL);
+  nv_table_unref(tab);
+}
+
 static void
 test_nvtable_lookup()
 {
@@ -879,6 +976,7 @@ test_nvtable(void)
 {
   test_nvtable_direct();
   test_nvtable_indirect();
+  test_nvtable_interned();
   test_nvtable_others();
   test_nvtable_lookup();
   test_nvtable_clone();
@@ -126,6 +126,7 @@ main(int argc, char *argv[])
   msg_format_options_defaults(&parse_options);
   msg_format_options_init(&parse_options, configuration);
   parse_options.flags |= LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(&parse_options, configuration);
 
   testcase("rfc3164", NULL, "DATE,FACILITY,HOST,MESSAGE,PID,PRIORITY,PROGRAM", NULL);
   testcase("core", NULL, "DATE,FACILITY,HOST,MESSAGE,PID,PRIORITY,PROGRAM", NULL);